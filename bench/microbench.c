@@ -0,0 +1,242 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Microbenchmarks of the lookup code used on hot paths: glob matching as
+ * used by window rules and view queries, and the integer map used for
+ * keybind and surface lookups. Also the cost of debug messages which are
+ * filtered out, see common/log.h. Run with 'meson test --benchmark'.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "common/int-map.h"
+#include "common/macros.h"
+#include "common/match.h"
+#include "common/mem.h"
+
+#define MIN_RUN_NSEC (200 * 1000 * 1000)
+
+static const int sizes[] = { 10, 100, 1000 };
+
+/* Patterns in the forms window rules typically use */
+static const char *const pattern_forms[] = {
+	"org.example.app%d",
+	"org.example.*%d",
+	"*.app%d",
+	"*",
+	"org.*.app%d?",
+};
+
+static int64_t
+now_nsec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static char **
+make_strings(int count, bool patterns)
+{
+	char **strings = znew_n(char *, count);
+	for (int i = 0; i < count; i++) {
+		char buf[64];
+		if (patterns) {
+			snprintf(buf, sizeof(buf),
+				pattern_forms[i % ARRAY_SIZE(pattern_forms)], i);
+		} else {
+			snprintf(buf, sizeof(buf), "org.example.app%d", i);
+		}
+		strings[i] = xstrdup(buf);
+	}
+	return strings;
+}
+
+static void
+free_strings(char **strings, int count)
+{
+	for (int i = 0; i < count; i++) {
+		free(strings[i]);
+	}
+	free(strings);
+}
+
+/* Matches every pattern against every string, like rules against views */
+static void
+bench_match(int count)
+{
+	char **patterns = make_strings(count, true);
+	char **strings = make_strings(count, false);
+	struct match_pattern *compiled = znew_n(struct match_pattern, count);
+	for (int i = 0; i < count; i++) {
+		match_pattern_compile(&compiled[i], patterns[i]);
+	}
+
+	uint64_t calls = 0, matches = 0;
+	int64_t start = now_nsec();
+	do {
+		for (int i = 0; i < count; i++) {
+			for (int j = 0; j < count; j++) {
+				matches += match_glob(patterns[i], strings[j]);
+			}
+		}
+		calls += (uint64_t)count * count;
+	} while (now_nsec() - start < MIN_RUN_NSEC);
+	double glob_ns = (double)(now_nsec() - start) / calls;
+
+	calls = 0;
+	start = now_nsec();
+	do {
+		for (int i = 0; i < count; i++) {
+			for (int j = 0; j < count; j++) {
+				matches += match_pattern(&compiled[i], strings[j]);
+			}
+		}
+		calls += (uint64_t)count * count;
+	} while (now_nsec() - start < MIN_RUN_NSEC);
+	double pattern_ns = (double)(now_nsec() - start) / calls;
+
+	printf("  %-24s %6d %10.1f ns/match\n", "match_glob", count, glob_ns);
+	printf("  %-24s %6d %10.1f ns/match\n", "match_pattern", count,
+		pattern_ns);
+	/* Keep the compiler from dropping the loops */
+	if (!matches) {
+		printf("  (no matches)\n");
+	}
+
+	free(compiled);
+	free_strings(patterns, count);
+	free_strings(strings, count);
+}
+
+/* Keys spread like pointers, as for the surface and keycode maps */
+static uint64_t
+key_at(int i)
+{
+	return 0x7f0000000000ULL + (uint64_t)i * 48;
+}
+
+static void
+bench_int_map(int count)
+{
+	uint64_t calls = 0, found = 0;
+	int64_t start = now_nsec();
+	do {
+		struct int_map map = {0};
+		for (int i = 0; i < count; i++) {
+			int_map_insert(&map, key_at(i), &map);
+		}
+		int_map_finish(&map);
+		calls += count;
+	} while (now_nsec() - start < MIN_RUN_NSEC);
+	double insert_ns = (double)(now_nsec() - start) / calls;
+
+	struct int_map map = {0};
+	for (int i = 0; i < count; i++) {
+		int_map_insert(&map, key_at(i), &map);
+	}
+	calls = 0;
+	start = now_nsec();
+	do {
+		/* Half of the lookups miss */
+		for (int i = 0; i < 2 * count; i++) {
+			found += !!int_map_lookup(&map, key_at(i));
+		}
+		calls += 2 * count;
+	} while (now_nsec() - start < MIN_RUN_NSEC);
+	double lookup_ns = (double)(now_nsec() - start) / calls;
+	int_map_finish(&map);
+
+	printf("  %-24s %6d %10.1f ns/insert\n", "int_map_insert", count,
+		insert_ns);
+	printf("  %-24s %6d %10.1f ns/lookup\n", "int_map_lookup", count,
+		lookup_ns);
+	if (!found) {
+		printf("  (nothing found)\n");
+	}
+}
+
+/*
+ * Models wlr_log() of a message below the verbosity: _wlr_log() passes
+ * the arguments on to the log callback, which then drops the message.
+ */
+enum { MODEL_ERROR = 1, MODEL_DEBUG = 3 };
+static int model_verbosity = MODEL_ERROR;
+
+static void
+model_callback(int importance, const char *fmt, va_list args)
+{
+	if (importance > model_verbosity) {
+		return;
+	}
+	vfprintf(stderr, fmt, args);
+}
+
+static void (*volatile model_log_callback)(int, const char *, va_list) =
+	model_callback;
+
+__attribute__((noinline)) static void
+model_wlr_log(int importance, const char *fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	model_log_callback(importance, fmt, args);
+	va_end(args);
+}
+
+/* Like wlr_log_get_verbosity(), which lives in another library */
+__attribute__((noinline)) static int
+model_get_verbosity(void)
+{
+	return model_verbosity;
+}
+
+static const char *const model_names[] = { "Execute", "Focus", "Raise" };
+
+static void
+bench_filtered_log(void)
+{
+	uint64_t calls = 0;
+	int64_t start = now_nsec();
+	do {
+		for (unsigned int i = 0; i < 1000; i++) {
+			model_wlr_log(MODEL_DEBUG, "Handling action %u: %s", i,
+				model_names[i % ARRAY_SIZE(model_names)]);
+		}
+		calls += 1000;
+	} while (now_nsec() - start < MIN_RUN_NSEC);
+	double wlr_log_ns = (double)(now_nsec() - start) / calls;
+
+	calls = 0;
+	start = now_nsec();
+	do {
+		for (unsigned int i = 0; i < 1000; i++) {
+			if (model_get_verbosity() >= MODEL_DEBUG) {
+				model_wlr_log(MODEL_DEBUG,
+					"Handling action %u: %s", i,
+					model_names[i % ARRAY_SIZE(model_names)]);
+			}
+		}
+		calls += 1000;
+	} while (now_nsec() - start < MIN_RUN_NSEC);
+	double lab_log_ns = (double)(now_nsec() - start) / calls;
+
+	printf("  %-24s %6s %10.1f ns/call\n", "wlr_log (filtered)", "-",
+		wlr_log_ns);
+	printf("  %-24s %6s %10.1f ns/call\n", "lab_log_debug (filtered)", "-",
+		lab_log_ns);
+}
+
+int
+main(void)
+{
+	printf("  %-24s %6s\n", "function", "size");
+	for (size_t i = 0; i < ARRAY_SIZE(sizes); i++) {
+		bench_match(sizes[i]);
+		bench_int_map(sizes[i]);
+	}
+	bench_filtered_log();
+	return EXIT_SUCCESS;
+}
@@ -7,6 +7,8 @@
 
 struct view;
 struct server;
+struct action_arg;
+struct arena;
 
 struct action {
 	struct wl_list link; /*
@@ -16,10 +18,24 @@ struct action {
 			      */
 
 	uint32_t type;        /* enum action_type */
-	struct wl_list args;  /* struct action_arg.link */
+
+	/*
+	 * Arguments indexed by enum action_arg_key (private to action.c).
+	 * NULL if the action has no arguments.
+	 */
+	struct action_arg **args;
+
+	/* Owner of the action and its arguments, NULL for the heap */
+	struct arena *arena;
 };
 
-struct action *action_create(const char *action_name);
+/**
+ * action_create() - create an action without arguments
+ * @arena: arena to allocate the action and its arguments from, or NULL
+ * to allocate them from the heap. action_free() ignores arena actions.
+ * @action_name: name as used in rc.xml
+ */
+struct action *action_create(struct arena *arena, const char *action_name);
 
 bool action_is_valid(struct action *action);
 
@@ -27,8 +27,11 @@
 #define LABWC_BUFFER_H
 
 #include <cairo.h>
+#include <pixman.h>
 #include <wlr/types/wlr_buffer.h>
 
+struct wlr_renderer;
+
 struct lab_data_buffer {
 	struct wlr_buffer base;
 
@@ -39,14 +42,84 @@ struct lab_data_buffer {
 	bool free_on_destroy;
 	uint32_t unscaled_width;
 	uint32_t unscaled_height;
+	/* Pool bucket of the pixel memory of cairo buffers, or -1 */
+	int pixel_bucket;
+	/*
+	 * Part known to be fully opaque in unscaled coordinates, empty by
+	 * default. Applied to the scene by scaled_scene_buffer so that the
+	 * scene skips rendering what is hidden behind it.
+	 */
+	pixman_region32_t opaque_region;
+
+	/* Allocation accounting, see buffer_get_stats() */
+	size_t accounted_bytes;
+	struct buffer_site_stats *site;
+};
+
+/*
+ * Pixel memory owned by lab_data_buffers, by the source file which
+ * created them. Keeping it up to date costs a few additions per buffer.
+ */
+struct buffer_site_stats {
+	const char *site;
+	size_t count;
+	size_t bytes;
+	size_t peak_bytes;
+};
+
+struct buffer_stats {
+	size_t count;
+	size_t bytes;
+	size_t peak_bytes;
+	const struct buffer_site_stats *sites;
+	size_t nr_sites;
 };
 
+/* Counters across all lab_data_buffers, shown by the debug dump */
+void buffer_get_stats(struct buffer_stats *stats);
+
+/* Free the pixel memory kept for reuse by destroyed cairo buffers */
+void buffer_pool_finish(void);
+
+/*
+ * The creation functions are wrapped by macros which pass the calling
+ * source file for the allocation accounting.
+ */
+
 /* Create a buffer which creates a new cairo CAIRO_FORMAT_ARGB32 surface */
-struct lab_data_buffer *buffer_create_cairo(uint32_t width, uint32_t height,
-	float scale, bool free_on_destroy);
+#define buffer_create_cairo(width, height, scale, free_on_destroy) \
+	buffer_create_cairo_at(__FILE__, width, height, scale, free_on_destroy)
+struct lab_data_buffer *buffer_create_cairo_at(const char *site,
+	uint32_t width, uint32_t height, float scale, bool free_on_destroy);
 
 /* Create a buffer which wraps a given DRM_FORMAT_ARGB8888 pointer */
-struct lab_data_buffer *buffer_create_wrap(void *pixel_data, uint32_t width,
-	uint32_t height, uint32_t stride, bool free_on_destroy);
+#define buffer_create_wrap(pixel_data, width, height, stride, free_on_destroy) \
+	buffer_create_wrap_at(__FILE__, pixel_data, width, height, stride, \
+		free_on_destroy)
+struct lab_data_buffer *buffer_create_wrap_at(const char *site,
+	void *pixel_data, uint32_t width, uint32_t height, uint32_t stride,
+	bool free_on_destroy);
+
+/*
+ * wlr_scene uploads a separate texture for every wlr_scene_buffer showing
+ * a non-client buffer. buffer_share_texture() uploads @buffer once and
+ * buffer_get_shared() returns a buffer wrapping that texture, which can
+ * then be used by any number of scene nodes. The texture is released
+ * once @buffer and all nodes using it are gone.
+ */
+void buffer_share_texture(struct wlr_buffer *buffer,
+	struct wlr_renderer *renderer);
+
+/*
+ * Like buffer_share_texture(), but also frees the pixel memory of @buffer
+ * if the renderer keeps its own copy in the texture, which is the case for
+ * all renderers but pixman. @buffer must only be shown through
+ * buffer_get_shared() afterwards and cannot be drawn to anymore.
+ */
+void buffer_share_texture_only(struct lab_data_buffer *buffer,
+	struct wlr_renderer *renderer);
+
+/* Return the shared variant of @buffer or @buffer itself (may be NULL) */
+struct wlr_buffer *buffer_get_shared(struct wlr_buffer *buffer);
 
 #endif /* LABWC_BUFFER_H */
@@ -0,0 +1,32 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_BUTTON_CACHE_H
+#define LABWC_BUTTON_CACHE_H
+
+#include <cairo.h>
+
+/*
+ * On-disk cache of rasterized button images in $XDG_CACHE_HOME/labwc.
+ * Entries are keyed by source filename, size and scale and are only used while
+ * the modification time and size of the source file are unchanged.
+ *
+ * Only plain cairo image surfaces are handled, so that the cache can be
+ * used from worker threads.
+ */
+
+/**
+ * button_cache_load() - load a previously rasterized button
+ * @filename: full path of the source image
+ * @size: size the image was rendered at, in logical pixels
+ * @scale: output scale the image was rendered for
+ *
+ * Return: a new image surface with the device scale set to @scale, or NULL
+ * if there is no valid cache entry
+ */
+cairo_surface_t *button_cache_load(const char *filename, int size,
+	double scale);
+
+/* Store a rasterized button, errors are logged and otherwise ignored */
+void button_cache_store(const char *filename, int size, double scale,
+	cairo_surface_t *surface);
+
+#endif /* LABWC_BUTTON_CACHE_H */
@@ -2,9 +2,33 @@
 #ifndef LABWC_BUTTON_SVG_H
 #define LABWC_BUTTON_SVG_H
 
+#include <cairo.h>
+#include <stddef.h>
+
 struct lab_data_buffer;
 
+/*
+ * Render an SVG button of @size x @size logical pixels for an output
+ * @scale, so that it is not upscaled on HiDPI outputs
+ */
 void button_svg_load(const char *button_name, struct lab_data_buffer **buffer,
-	int size);
+	int size, double scale);
+
+struct button_svg_job {
+	char name[64];
+	struct lab_data_buffer **buffer;
+	int size;
+	double scale;
+	/* Private to button_svg_load_all() */
+	char *filename;
+	cairo_surface_t *surface;
+};
+
+/*
+ * Load several SVG buttons using a few worker threads and wait for all of
+ * them to finish. The workers only rasterize, the buffers are created on
+ * the calling thread afterwards. Each job must target a different buffer.
+ */
+void button_svg_load_all(struct button_svg_job *jobs, size_t nr_jobs);
 
 #endif /* LABWC_BUTTON_SVG_H */
@@ -0,0 +1,60 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_CLIENT_STATS_H
+#define LABWC_CLIENT_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+struct histogram;
+struct wl_client;
+struct wlr_compositor;
+
+/*
+ * Per-client resource and commit accounting, to find the client behind
+ * a session slowed down by runaway animations or leaking buffers.
+ *
+ * A client is tracked from its first surface until it disconnects. All
+ * X11 clients share the Xwayland connection and are accounted together.
+ *
+ * Exceeding LABWC_CLIENT_MAX_COMMIT_RATE commits per second or
+ * LABWC_CLIENT_MAX_BUFFER_MIB MiB of attached buffers is logged once
+ * per client.
+ */
+
+struct client_stats_info {
+	pid_t pid;
+	const char *name;
+	uint64_t commits;
+	/* Commits during the last full second and the highest seen */
+	uint32_t commit_rate;
+	uint32_t peak_commit_rate;
+	/* Sum of the damage of all commits, in buffer pixels */
+	uint64_t damage_pixels;
+	/* Size of the buffers currently attached to its surfaces */
+	size_t buffer_bytes;
+	size_t peak_buffer_bytes;
+	uint32_t surfaces;
+	uint32_t popups;
+	/* Configure response times in usec */
+	struct histogram *configure;
+};
+
+void client_stats_init(struct wlr_compositor *compositor);
+
+/* Commits per second of @client during the last full second */
+uint32_t client_stats_get_commit_rate(struct wl_client *client);
+
+/* Record the time @client took to respond to a configure */
+void client_stats_configure_acked(struct wl_client *client, uint32_t usec);
+
+/* Print per-client statistics to stdout */
+void client_stats_dump(void);
+
+/* Call @fn for each tracked client */
+void client_stats_for_each(void (*fn)(const struct client_stats_info *info,
+	void *data), void *data);
+
+void client_stats_finish(void);
+
+#endif /* LABWC_CLIENT_STATS_H */
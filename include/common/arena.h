@@ -0,0 +1,42 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_ARENA_H
+#define LABWC_ARENA_H
+
+#include <stddef.h>
+
+struct arena_chunk;
+
+/*
+ * Bump allocator for objects which are all freed together, such as
+ * everything parsed from rc.xml. Individual allocations cannot be freed;
+ * arena_release() frees all of them at once. A zero-initialized struct
+ * arena is empty.
+ */
+struct arena {
+	struct arena_chunk *chunks;
+	size_t used;  /* in the first chunk */
+};
+
+/**
+ * arena_alloc() - allocate zero-filled memory
+ * @arena: arena to allocate from, or NULL to allocate from the heap
+ * @size: number of bytes
+ *
+ * Calls exit() on error. With a NULL @arena this is xzalloc(), which lets
+ * code shared between arena and heap owned objects use the same calls.
+ */
+void *arena_alloc(struct arena *arena, size_t size);
+
+/* Like xstrdup(), but allocates from @arena unless it is NULL */
+char *arena_strdup(struct arena *arena, const char *str);
+
+/* Free all memory allocated from @arena and make it empty again */
+void arena_release(struct arena *arena);
+
+/* Like znew() and znew_n(), see common/mem.h */
+#define arena_new(arena, expr) \
+	((__typeof__(expr) *)arena_alloc((arena), sizeof(expr)))
+#define arena_new_n(arena, expr, n) \
+	((__typeof__(expr) *)arena_alloc((arena), (n) * sizeof(expr)))
+
+#endif /* LABWC_ARENA_H */
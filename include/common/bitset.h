@@ -0,0 +1,38 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_BITSET_H
+#define LABWC_BITSET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Set of small non-negative integers such as output indices. The first 64
+ * bits are stored inline, so the common case needs no allocation; higher
+ * bits spill into a heap array which is kept for reuse once allocated.
+ * A zero-initialized struct bitset is an empty set.
+ */
+struct bitset {
+	uint64_t bits;
+	uint64_t *overflow; /* bits 64 and up */
+	size_t nr_overflow; /* in words */
+};
+
+void bitset_set(struct bitset *set, size_t bit);
+bool bitset_test(const struct bitset *set, size_t bit);
+
+/* Remove all bits, keeping allocated memory */
+void bitset_clear(struct bitset *set);
+
+/* Make @dst contain the same bits as @src */
+void bitset_copy(struct bitset *dst, const struct bitset *src);
+
+bool bitset_equal(const struct bitset *a, const struct bitset *b);
+
+/* Returns true if @a and @b have at least one bit in common */
+bool bitset_intersects(const struct bitset *a, const struct bitset *b);
+
+/* Free allocated memory and make @set empty */
+void bitset_finish(struct bitset *set);
+
+#endif /* LABWC_BITSET_H */
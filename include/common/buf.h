@@ -50,6 +50,14 @@ void buf_expand_shell_variables(struct buf *s);
  */
 void buf_add(struct buf *s, const char *data);
 
+/**
+ * buf_add_n - add the first @len bytes of @data to C string buffer
+ * @s: buffer
+ * @data: data to be added, need not be NUL-terminated
+ * @len: number of bytes to add
+ */
+void buf_add_n(struct buf *s, const char *data, int len);
+
 /**
  * buf_add_char - add single char to C string buffer
  * @s: buffer
@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_DEFER_H
+#define LABWC_DEFER_H
+
+#include <stdbool.h>
+
+struct wl_event_loop;
+struct wl_event_source;
+
+/*
+ * Coalesces requests to recompute some state into a single run from an
+ * idle callback, i.e. after all events currently pending on the event
+ * loop have been handled. Subsystems which are asked to update several
+ * times while handling one batch of events then update only once.
+ * A zero-initialized struct defer has nothing scheduled.
+ */
+struct defer {
+	struct wl_event_source *idle;
+	void (*run)(void *data);
+	void *data;
+};
+
+/**
+ * defer_schedule() - run @run(@data) once the event loop is idle
+ *
+ * Does nothing if @defer is already scheduled, so all callers of one
+ * struct defer must pass the same @run and @data.
+ */
+void defer_schedule(struct defer *defer, struct wl_event_loop *loop,
+	void (*run)(void *data), void *data);
+
+/* Run a scheduled @defer right away, for callers needing the result */
+void defer_flush(struct defer *defer);
+
+/* Drop a scheduled run, e.g. before its data is destroyed */
+void defer_cancel(struct defer *defer);
+
+static inline bool
+defer_is_scheduled(struct defer *defer)
+{
+	return defer->idle;
+}
+
+#endif /* LABWC_DEFER_H */
@@ -5,4 +5,7 @@
 void increase_nofile_limit(void);
 void restore_nofile_limit(void);
 
+/* Undo restore_nofile_limit() after spawning a child */
+void reapply_nofile_limit(void);
+
 #endif /* LABWC_FD_UTIL_H */
@@ -2,6 +2,8 @@
 #ifndef LABWC_FONT_H
 #define LABWC_FONT_H
 
+#include <stddef.h>
+
 struct lab_data_buffer;
 
 enum font_slant {
@@ -35,6 +37,15 @@ int font_height(struct font *font);
  */
 int font_width(struct font *font, const char *string);
 
+/**
+ * font_measure_widths - get horizontal extents of many strings at once
+ * @widths: filled with what font_width() would return for each string
+ * Note: unlike font_width() this does not use the shared cache, so it can
+ * be called from threads other than the main one
+ */
+void font_measure_widths(struct font *font, const char *const *strings,
+	size_t nr, int *widths);
+
 /**
  * font_buffer_create - Create ARGB8888 lab_data_buffer using pango
  * @buffer: buffer pointer
@@ -49,6 +60,12 @@ void font_buffer_create(struct lab_data_buffer **buffer, int max_width,
 	const char *text, struct font *font, const float *color,
 	const float *bg_color, const char *arrow, double scale);
 
+/**
+ * font_shed_caches - drop cached text extents and glyphs
+ * Note: they are filled again as text is measured and rendered
+ */
+void font_shed_caches(void);
+
 /**
  * font_finish - free some font related resources
  * Note: use on exit
@@ -0,0 +1,33 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_GLYPH_CACHE_H
+#define LABWC_GLYPH_CACHE_H
+
+#include <cairo.h>
+
+struct _PangoLayout;
+
+/*
+ * Cache of rasterized glyph images, enabled by <theme><glyphCache>.
+ *
+ * Text drawn through it is still shaped by Pango, but each glyph is only
+ * rasterized once per font, scale and color. Drawing a string afterwards
+ * just copies the cached images, so frequently changing window titles
+ * no longer rasterize the same glyphs again and again. Glyphs are always
+ * rendered with grayscale antialiasing as they are cached independently
+ * of the background.
+ */
+
+/**
+ * glyph_cache_show_layout() - draw @layout at the current point of @cairo
+ * @cairo: target with its scale already applied
+ * @layout: layout to draw, updated for @cairo
+ * @color: foreground color in rgba format
+ * @scale: scale of @cairo, glyphs are cached per scale
+ */
+void glyph_cache_show_layout(cairo_t *cairo, struct _PangoLayout *layout,
+	const float *color, double scale);
+
+/* Free all cached glyphs */
+void glyph_cache_finish(void);
+
+#endif /* LABWC_GLYPH_CACHE_H */
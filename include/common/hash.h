@@ -0,0 +1,48 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_HASH_H
+#define LABWC_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 64-bit FNV-1a, used for the keys of caches and lookup maps. Start from
+ * HASH_INIT and mix in each part of the key:
+ *
+ *	uint64_t hash = HASH_INIT;
+ *	hash = hash_str(hash, name);
+ *	hash = hash_value(hash, size);
+ */
+
+#define HASH_INIT 0xcbf29ce484222325ULL
+#define HASH_PRIME 0x100000001b3ULL
+
+/* Mix @len bytes of @data into @hash */
+static inline uint64_t
+hash_bytes(uint64_t hash, const void *data, size_t len)
+{
+	const unsigned char *bytes = data;
+	for (size_t i = 0; i < len; i++) {
+		hash = (hash ^ bytes[i]) * HASH_PRIME;
+	}
+	return hash;
+}
+
+/* Mix the bytes of @str, without the terminator */
+static inline uint64_t
+hash_str(uint64_t hash, const char *str)
+{
+	for (const unsigned char *p = (const unsigned char *)str; *p; p++) {
+		hash = (hash ^ *p) * HASH_PRIME;
+	}
+	return hash;
+}
+
+/* Mix a whole integer in one step, same as one byte for values < 256 */
+static inline uint64_t
+hash_value(uint64_t hash, uint64_t value)
+{
+	return (hash ^ value) * HASH_PRIME;
+}
+
+#endif /* LABWC_HASH_H */
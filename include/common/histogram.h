@@ -0,0 +1,49 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_HISTOGRAM_H
+#define LABWC_HISTOGRAM_H
+
+#include <stdint.h>
+
+/*
+ * Each power of two is split into HISTOGRAM_SUB_BUCKETS linear buckets
+ * which keeps the relative error of reported percentiles below 25% while
+ * covering the full uint32_t range in a small, fixed amount of memory.
+ */
+#define HISTOGRAM_SUB_BUCKETS 4
+#define HISTOGRAM_NR_BUCKETS (32 * HISTOGRAM_SUB_BUCKETS)
+
+/*
+ * Log-linear histogram used for latency statistics. Values are unitless;
+ * callers typically record microseconds.
+ */
+struct histogram {
+	uint64_t count;
+	uint64_t sum;
+	uint32_t max;
+	uint32_t buckets[HISTOGRAM_NR_BUCKETS];
+};
+
+/**
+ * histogram_add() - record a value
+ * @hist: histogram to add to
+ * @value: value to record
+ */
+void histogram_add(struct histogram *hist, uint32_t value);
+
+/**
+ * histogram_percentile() - estimate a percentile
+ * @hist: histogram to query
+ * @percentile: percentile in the range [0, 100]
+ *
+ * Return: the upper bound of the bucket holding the requested percentile,
+ * clamped to the largest recorded value, or 0 if the histogram is empty.
+ */
+uint32_t histogram_percentile(struct histogram *hist, double percentile);
+
+/**
+ * histogram_reset() - remove all recorded values
+ * @hist: histogram to reset
+ */
+void histogram_reset(struct histogram *hist);
+
+#endif /* LABWC_HISTOGRAM_H */
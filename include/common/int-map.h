@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_INT_MAP_H
+#define LABWC_INT_MAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct int_map_entry {
+	uint64_t key;
+	void *value;
+};
+
+/*
+ * Open-addressing hash map from 64-bit integer keys to non-NULL pointers.
+ * Used to turn linear scans over config lists into constant-time lookups.
+ * A zero-initialized struct int_map is an empty map.
+ */
+struct int_map {
+	struct int_map_entry *entries;
+	size_t capacity;
+	size_t count;
+};
+
+/**
+ * int_map_insert() - add a key unless it already exists
+ * @map: map to add to
+ * @key: key
+ * @value: non-NULL value
+ *
+ * Return: true if added, false if @key was already present (in which
+ * case the existing value is kept)
+ */
+bool int_map_insert(struct int_map *map, uint64_t key, void *value);
+
+/**
+ * int_map_lookup() - find value for key
+ * Return: the value, or NULL if @key is not present
+ */
+void *int_map_lookup(struct int_map *map, uint64_t key);
+
+/**
+ * int_map_remove() - remove a key
+ * Return: the value which was removed, or NULL if @key was not present
+ */
+void *int_map_remove(struct int_map *map, uint64_t key);
+
+/**
+ * int_map_finish() - free all memory and leave an empty map
+ */
+void int_map_finish(struct int_map *map);
+
+#endif /* LABWC_INT_MAP_H */
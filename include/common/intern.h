@@ -0,0 +1,27 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_INTERN_H
+#define LABWC_INTERN_H
+
+/*
+ * Reference counted string interning. Equal strings share one copy, so
+ * interned strings can be compared by pointer and storing the same
+ * title or font name many times costs a reference instead of a copy.
+ *
+ * Interned strings must not be modified and are released with
+ * intern_release() once for every intern_string() or intern_ref().
+ */
+
+/**
+ * intern_string() - get the shared copy of a string
+ * @str: string to look up or add, may be NULL
+ * Return: the interned string with one more reference, or NULL
+ */
+const char *intern_string(const char *str);
+
+/* Take another reference on @interned, which may be NULL */
+const char *intern_ref(const char *interned);
+
+/* Drop a reference on @interned, which may be NULL */
+void intern_release(const char *interned);
+
+#endif /* LABWC_INTERN_H */
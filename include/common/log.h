@@ -0,0 +1,33 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_LOG_H
+#define LABWC_LOG_H
+
+#include <wlr/util/log.h>
+#include "config.h"
+
+/*
+ * wlr_log() evaluates and passes on its arguments even if the message is
+ * then filtered out by the verbosity. Debug messages on hot paths, i.e.
+ * for every input event, action or commit, use lab_log_debug() instead,
+ * which checks the verbosity first.
+ *
+ * Built with -Dhot-path-debug-log=false, lab_log_debug() compiles to
+ * nothing. The arguments are still type-checked and count as used.
+ */
+#if HAVE_HOT_PATH_DEBUG_LOG
+#define lab_log_debug(fmt, ...) \
+	do { \
+		if (wlr_log_get_verbosity() >= WLR_DEBUG) { \
+			wlr_log(WLR_DEBUG, fmt, ##__VA_ARGS__); \
+		} \
+	} while (0)
+#else
+#define lab_log_debug(fmt, ...) \
+	do { \
+		if (0) { \
+			wlr_log(WLR_DEBUG, fmt, ##__VA_ARGS__); \
+		} \
+	} while (0)
+#endif
+
+#endif /* LABWC_LOG_H */
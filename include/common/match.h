@@ -3,6 +3,7 @@
 #define LABWC_MATCH_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
 /**
  * match_glob() - Pattern match using '*' wildcards and '?' jokers.
@@ -12,4 +13,37 @@
  */
 bool match_glob(const char *pattern, const char *string);
 
+enum match_kind {
+	LAB_MATCH_GLOB = 0,
+	LAB_MATCH_ANY,
+	LAB_MATCH_LITERAL,
+	LAB_MATCH_PREFIX,
+	LAB_MATCH_SUFFIX,
+};
+
+/*
+ * A glob pattern pre-classified so that the common forms "foo", "foo*",
+ * "*foo" and "*" can be matched without fnmatch(). The pattern string is
+ * borrowed, not copied.
+ */
+struct match_pattern {
+	enum match_kind kind;
+	const char *pattern;
+	/* The part of the pattern without wildcards for the fast paths */
+	const char *text;
+	size_t len;
+};
+
+/**
+ * match_pattern_compile() - classify a glob pattern
+ * @match: Compiled pattern to fill in.
+ * @pattern: Pattern as given to match_glob(). Must outlive @match.
+ */
+void match_pattern_compile(struct match_pattern *match, const char *pattern);
+
+/**
+ * match_pattern() - same as match_glob() with a compiled pattern
+ */
+bool match_pattern(const struct match_pattern *match, const char *string);
+
 #endif /* LABWC_MATCH_H */
@@ -0,0 +1,48 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_PHASE_TIMER_H
+#define LABWC_PHASE_TIMER_H
+
+#include <stdint.h>
+
+/*
+ * Times the steps of a longer operation such as startup or reconfigure.
+ * Only one operation is timed at a time, marking phases while none is
+ * being timed does nothing. Phase names must be string literals.
+ */
+
+/**
+ * phase_timer_begin() - start timing an operation
+ * @operation: name of the operation, e.g. "startup"
+ */
+void phase_timer_begin(const char *operation);
+
+/**
+ * phase_timer_mark() - record the end of a phase
+ * @phase: name of the phase which took the time since the previous mark
+ */
+void phase_timer_mark(const char *phase);
+
+/**
+ * phase_timer_end() - stop timing and log a summary of all phases
+ *
+ * The summary is logged at info level. Each phase is also logged at debug
+ * level when it is marked.
+ */
+void phase_timer_end(void);
+
+/*
+ * Work started during an operation which it does not wait for, such as
+ * child processes. It is counted in the summary of the operation and its
+ * completion is logged on its own, usually after phase_timer_end().
+ */
+struct phase_timer_task {
+	const char *name;
+	const char *operation; /* NULL if started outside of an operation */
+	int64_t operation_start_nsec;
+	int64_t start_nsec;
+};
+
+void phase_timer_task_begin(struct phase_timer_task *task, const char *name);
+void phase_timer_task_end(struct phase_timer_task *task);
+
+#endif /* LABWC_PHASE_TIMER_H */
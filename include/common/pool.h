@@ -0,0 +1,34 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_POOL_H
+#define LABWC_POOL_H
+
+#include <stddef.h>
+
+/*
+ * Free-list allocator for small fixed-size objects which are created and
+ * destroyed in large numbers, such as the node descriptors and ssd parts
+ * of every decorated view. Freed objects are kept for reuse up to
+ * POOL_MAX_FREE, so mapping and unmapping views does not go through
+ * malloc() once the pool has warmed up.
+ */
+#define POOL_MAX_FREE 512
+
+struct pool {
+	size_t size;
+	void *free;       /* singly linked through the first word */
+	size_t nr_free;
+};
+
+/* Static initializer, e.g. static struct pool parts = POOL_INIT(struct ssd_part) */
+#define POOL_INIT(type) { .size = sizeof(type) }
+
+/* Return a zero-filled object; calls exit() on error */
+void *pool_alloc(struct pool *pool);
+
+/* Give @obj back to @pool; does nothing if @obj is NULL */
+void pool_free(struct pool *pool, void *obj);
+
+/* Free the objects kept for reuse, e.g. on exit to keep leak checkers quiet */
+void pool_finish(struct pool *pool);
+
+#endif /* LABWC_POOL_H */
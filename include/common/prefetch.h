@@ -0,0 +1,24 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_PREFETCH_H
+#define LABWC_PREFETCH_H
+
+/*
+ * Reads files on a helper thread, so that they are in the page cache by
+ * the time the main thread parses them. Used at startup to overlap
+ * reading the theme and menu files with starting the backend.
+ *
+ * Only the contents are read ahead, nothing is parsed on the helper
+ * thread, so no state needs to be shared with it.
+ */
+
+/**
+ * prefetch_start() - start reading files in the background
+ * @paths: NULL-terminated paths of files, or of directories whose regular
+ *         files are all read. Copied, missing files are ignored.
+ */
+void prefetch_start(const char *const *paths);
+
+/* Waits for the helper thread, if any */
+void prefetch_finish(void);
+
+#endif /* LABWC_PREFETCH_H */
@@ -13,13 +13,14 @@ struct scaled_font_buffer {
 	int width;   /* unscaled, read only */
 	int height;  /* unscaled, read only */
 
-	/* Private */
-	char *text;
+	/* Private, strings are interned (see common/intern.h) */
+	const char *text;
 	int max_width;
 	float color[4];
 	float bg_color[4];
-	char *arrow;
+	const char *arrow;
 	struct font font;
+	int lazy_height; /* expected height, 0 unless lazy */
 	struct scaled_scene_buffer *scaled_buffer;
 };
 
@@ -34,6 +35,15 @@ struct scaled_font_buffer {
  */
 struct scaled_font_buffer *scaled_font_buffer_create(struct wlr_scene_tree *parent);
 
+/**
+ * Like scaled_font_buffer_create() but the text is only rendered once the
+ * buffer is shown on an output, e.g. for menu items that may never be
+ * displayed. Until then, width and height are set to max_width and the
+ * expected @height of the text.
+ */
+struct scaled_font_buffer *scaled_font_buffer_create_lazy(
+	struct wlr_scene_tree *parent, int height);
+
 /**
  * Update an existing auto scaling font buffer.
  *
@@ -58,4 +68,7 @@ void scaled_font_buffer_update(struct scaled_font_buffer *self, const char *text
  */
 void scaled_font_buffer_set_max_width(struct scaled_font_buffer *self, int max_width);
 
+/* Release the rendered text shared between font buffers, used on exit */
+void scaled_font_buffer_finish_cache(void);
+
 #endif /* LABWC_SCALED_FONT_BUFFER_H */
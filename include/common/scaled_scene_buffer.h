@@ -2,10 +2,10 @@
 #ifndef LABWC_SCALED_SCENE_BUFFER_H
 #define LABWC_SCALED_SCENE_BUFFER_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include <wayland-server-core.h>
 
-#define LAB_SCALED_BUFFER_MAX_CACHE 2
-
 struct wlr_buffer;
 struct wlr_scene_tree;
 struct lab_data_buffer;
@@ -44,9 +44,10 @@ struct scaled_scene_buffer {
  * implementation->create_buffer(self, scale) to get a new lab_data_buffer
  * optimized for the new scale.
  *
- * Up to LAB_SCALED_BUFFER_MAX_CACHE (2) buffers are cached in an LRU fashion
- * to handle the majority of use cases where a view is moved between no more
- * than two different scales.
+ * Buffers for previously used scales are kept in a cache shared by all
+ * instances. Once the cached buffers exceed <core><bufferCacheSize>, those
+ * displayed least recently are evicted. The buffer an instance currently
+ * shows is never evicted.
  *
  * scaled_scene_buffer will clean up automatically once the internal
  * wlr_scene_buffer is being destroyed. If implementation->destroy is set
@@ -55,7 +56,7 @@ struct scaled_scene_buffer {
  *
  * All requested lab_data_buffers via impl->create_buffer() will be locked
  * during the lifetime of the buffer in the internal cache and unlocked
- * when being evacuated from the cache (due to LAB_SCALED_BUFFER_MAX_CACHE
+ * when being evacuated from the cache (due to the cache size limit
  * or the internal wlr_scene_buffer being destroyed).
  *
  * If drop_buffer was set during creation of the scaled_scene_buffer, the
@@ -84,10 +85,45 @@ struct scaled_scene_buffer *scaled_scene_buffer_create(
 /* Clear the cache of existing buffers, useful in case the content changes */
 void scaled_scene_buffer_invalidate_cache(struct scaled_scene_buffer *self);
 
+/*
+ * Like scaled_scene_buffer_invalidate_cache() but if the buffer is not
+ * shown on any output, only render once it enters one. Until then the
+ * node keeps the expected unscaled @width and @height.
+ */
+void scaled_scene_buffer_invalidate_lazy(struct scaled_scene_buffer *self,
+	int width, int height);
+
+/*
+ * Render the buffers for @scale of all enabled scaled_scene_buffers below
+ * @tree ahead of time, so that entering an output with that scale later
+ * only has to switch buffers.
+ */
+void scaled_scene_buffer_prerender_tree(struct wlr_scene_tree *tree,
+	double scale);
+
+struct scaled_scene_buffer_stats {
+	size_t bytes;  /* currently cached */
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+};
+
+/* Counters across all instances, shown by the debug dump */
+void scaled_scene_buffer_get_stats(struct scaled_scene_buffer_stats *stats);
+
+/*
+ * Drop all cached buffers that are not currently displayed, like the
+ * variants for other scales. Returns the number of bytes released.
+ */
+size_t scaled_scene_buffer_shed_cache(void);
+
 /* Private */
 struct scaled_scene_buffer_cache_entry {
 	struct wl_list link;   /* struct scaled_scene_buffer.cache */
+	struct wl_list lru_link;
+	struct scaled_scene_buffer *owner;
 	struct wlr_buffer *buffer;
+	size_t bytes;
 	double scale;
 };
 
@@ -3,6 +3,7 @@
 #define LABWC_SCENE_HELPERS_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 struct wlr_scene_node;
 struct wlr_surface;
@@ -17,7 +18,30 @@ struct wlr_surface *lab_wlr_surface_from_node(struct wlr_scene_node *node);
  */
 struct wlr_scene_node *lab_wlr_scene_get_prev_node(struct wlr_scene_node *node);
 
-/* A variant of wlr_scene_output_commit() that respects wlr_output->pending */
-bool lab_wlr_scene_output_commit(struct wlr_scene_output *scene_output);
+/**
+ * lab_wlr_scene_node_get_size - get the size of a rect or buffer node in
+ * layout coordinates, the same way wlr_scene does for hit-testing
+ * @node: node to get the size of
+ * Sets width and height to 0 for trees and buffer nodes without buffer.
+ */
+void lab_wlr_scene_node_get_size(struct wlr_scene_node *node,
+	int *width, int *height);
+
+/* Durations measured by lab_wlr_scene_output_commit() */
+struct lab_scene_commit_timing {
+	int64_t build_state_nsec;
+	int64_t commit_nsec;
+};
+
+/**
+ * lab_wlr_scene_output_commit() - a variant of wlr_scene_output_commit()
+ * that respects wlr_output->pending
+ * @scene_output: scene output to commit
+ * @timing: optional, receives the time spent building and committing
+ *          the output state. Durations of steps which were not
+ *          reached are set to 0.
+ */
+bool lab_wlr_scene_output_commit(struct wlr_scene_output *scene_output,
+	struct lab_scene_commit_timing *timing);
 
 #endif /* LABWC_SCENE_HELPERS_H */
@@ -4,6 +4,35 @@
 
 #include <sys/types.h>
 
+struct spawn_piped_child;
+struct wl_event_loop;
+
+/**
+ * spawn_helper_init - fork the launcher helper process
+ *
+ * Must be called early, before the compositor allocates much memory.
+ * spawn_async_no_shell() and spawn_piped() then let the helper start
+ * commands. They fall back to spawning directly if it is not available.
+ */
+void spawn_helper_init(void);
+
+/**
+ * spawn_helper_attach - handle the replies of the helper in @loop
+ *
+ * spawn_piped() only uses the helper once it is attached.
+ */
+void spawn_helper_attach(struct wl_event_loop *loop);
+
+/**
+ * spawn_helper_detach - stop handling replies, before @loop is destroyed
+ */
+void spawn_helper_detach(void);
+
+/**
+ * spawn_helper_finish - close the connection, letting the helper exit
+ */
+void spawn_helper_finish(void);
+
 /**
  * spawn_primary_client - execute asynchronously
  * @command: command to be executed
@@ -22,20 +51,36 @@ void spawn_async_no_shell(char const *command);
  * @pipe_fd: set to the read end of a pipe
  *           connected to stdout of the command
  *
+ * Returns a handle of the child or NULL on failure.
+ *
  * Notes:
- * The returned pid_t has to be waited for to
- * not produce zombies and the pipe_fd has to
- * be closed. spawn_piped_close() can be used
- * to ensure both.
+ * The handle and the pipe_fd have to be released
+ * with spawn_piped_close(). The child is reaped
+ * by the generic SIGCHLD handler or the helper.
+ */
+struct spawn_piped_child *spawn_piped(const char *command, int *pipe_fd);
+
+/**
+ * spawn_piped_pid - pid of a spawn_piped() child, for logging
+ *
+ * 0 until the launcher helper has replied, -1 if it never will.
+ */
+pid_t spawn_piped_pid(struct spawn_piped_child *child);
+
+/**
+ * spawn_piped_kill - send @signal to a spawn_piped() child
+ *
+ * Nothing is sent once it has exited, even if its pid was reused.
+ * If the helper has not replied yet, the signal is sent on its reply.
  */
-pid_t spawn_piped(const char *command, int *pipe_fd);
+void spawn_piped_kill(struct spawn_piped_child *child, int signal);
 
 /**
  * spawn_piped_close - clean up a previous
  *                     spawn_piped() process
- * @pid: will be waitpid()'d for
+ * @child: will be released
  * @pipe_fd: will be close()'d
  */
-void spawn_piped_close(pid_t pid, int pipe_fd);
+void spawn_piped_close(struct spawn_piped_child *child, int pipe_fd);
 
 #endif /* LABWC_SPAWN_H */
@@ -0,0 +1,28 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_TIME_HELPERS_H
+#define LABWC_TIME_HELPERS_H
+
+#include <stdint.h>
+
+struct timespec;
+
+/**
+ * timespec_to_nsec() - convert a timespec to nanoseconds
+ * @ts: time to convert
+ */
+int64_t timespec_to_nsec(const struct timespec *ts);
+
+/**
+ * time_now_nsec() - get the current CLOCK_MONOTONIC time in nanoseconds
+ */
+int64_t time_now_nsec(void);
+
+/**
+ * nsec_to_usec() - convert a duration to microseconds for statistics
+ * @nsec: duration in nanoseconds, clamped to 0 if negative
+ *
+ * Saturates at UINT32_MAX, which is more than an hour.
+ */
+uint32_t nsec_to_usec(int64_t nsec);
+
+#endif /* LABWC_TIME_HELPERS_H */
@@ -0,0 +1,40 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_TRACE_H
+#define LABWC_TRACE_H
+
+#include "config.h"
+
+/*
+ * Static tracepoints (USDT) for perf, bpftrace and other tools reading
+ * SystemTap probes, built with -Dtracepoints=enabled. Otherwise the
+ * macros expand to nothing.
+ *
+ * TRACE_FUNC() at the start of a function fires labwc:func_entry and,
+ * whichever way the function returns, labwc:func_return, both with the
+ * function name as argument. For example:
+ *
+ *   bpftrace -e 'usdt:labwc:func_entry { @t[tid] = nsecs; }
+ *     usdt:labwc:func_return /@t[tid]/ {
+ *       @usec[str(arg0)] = hist((nsecs - @t[tid]) / 1000); }'
+ *
+ * The probes are a single nop instruction each while not being traced.
+ */
+#if HAVE_TRACEPOINTS
+#include <sys/sdt.h>
+
+static inline void
+trace_func_return(const char **func)
+{
+	DTRACE_PROBE1(labwc, func_return, *func);
+}
+
+#define TRACE_FUNC() \
+	DTRACE_PROBE1(labwc, func_entry, __func__); \
+	__attribute__((cleanup(trace_func_return), unused)) \
+	const char *trace_func_ = __func__
+
+#else
+#define TRACE_FUNC() do { } while (0)
+#endif
+
+#endif /* LABWC_TRACE_H */
@@ -37,5 +37,35 @@ uint32_t parse_modifier(const char *symname);
 
 bool keybind_the_same(struct keybind *a, struct keybind *b);
 
+/* Equal for keybinds which are keybind_the_same() */
+uint64_t keybind_hash(struct keybind *keybind);
+
+/**
+ * keybind_update_keycodes - map keysyms of all keybinds to the keycodes of
+ * the current keymap and rebuild the keybind lookup maps
+ */
 void keybind_update_keycodes(struct server *server);
+
+/**
+ * keybind_lookup - find the keybind for a key press
+ * @modifiers: active modifiers
+ * @sym: keysym to match, or XKB_KEY_NoSymbol to match @keycode instead
+ * @keycode: xkb keycode of the physical key
+ * @inhibited: only consider keybinds containing ToggleKeybinds
+ */
+struct keybind *keybind_lookup(uint32_t modifiers, xkb_keysym_t sym,
+	xkb_keycode_t keycode, bool inhibited);
+
+/**
+ * keybind_may_match - cheap check done before translating a key press
+ * @modifiers: active modifiers
+ * @keycode: xkb keycode of the physical key
+ *
+ * Returns false if no keybind can match the key with the keymap that
+ * keybind_update_keycodes() was last called for.
+ */
+bool keybind_may_match(uint32_t modifiers, xkb_keycode_t keycode);
+
+/* Empties the lookup maps; must be called before freeing keybinds */
+void keybind_finish_lookup(void);
 #endif /* LABWC_KEYBIND_H */
@@ -49,5 +49,30 @@ uint32_t mousebind_button_from_str(const char *str, uint32_t *modifiers);
 enum direction mousebind_direction_from_str(const char *str, uint32_t *modifiers);
 struct mousebind *mousebind_create(const char *context);
 bool mousebind_the_same(struct mousebind *a, struct mousebind *b);
+/* Equal for mousebinds which are mousebind_the_same() */
+uint64_t mousebind_hash(struct mousebind *m);
+
+/*
+ * Compile rc.mousebinds into lookup maps so that button and scroll events
+ * do not need to walk the whole list. Called at the end of rcxml_read().
+ */
+void mousebind_build_lookup(void);
+void mousebind_finish_lookup(void);
+
+/*
+ * The lookup functions return an array of struct mousebind pointers in
+ * rc.mousebinds order, or NULL if nothing matches.
+ */
+
+/* Button mousebinds (any event but scroll) whose context contains @type */
+struct wl_array *mousebind_lookup(enum ssd_part_type type, uint32_t button,
+	uint32_t modifiers);
+
+/* Scroll mousebinds whose context contains @type */
+struct wl_array *mousebind_lookup_scroll(enum ssd_part_type type,
+	enum direction direction, uint32_t modifiers);
+
+/* All mousebinds using @button regardless of context and modifiers */
+struct wl_array *mousebind_lookup_button(uint32_t button);
 
 #endif /* LABWC_MOUSEBIND_H */
@@ -3,9 +3,11 @@
 #define LABWC_RCXML_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <wayland-server-core.h>
 
+#include "common/arena.h"
 #include "common/border.h"
 #include "common/buf.h"
 #include "common/font.h"
@@ -25,6 +27,24 @@ enum adaptive_sync_mode {
 	LAB_ADAPTIVE_SYNC_DISABLED,
 	LAB_ADAPTIVE_SYNC_ENABLED,
 	LAB_ADAPTIVE_SYNC_FULLSCREEN,
+	LAB_ADAPTIVE_SYNC_CONTENT,
+};
+
+enum tearing_mode {
+	LAB_TEARING_DISABLED,
+	LAB_TEARING_ENABLED,
+	LAB_TEARING_FULLSCREEN,
+};
+
+enum reduced_effects_mode {
+	LAB_REDUCED_EFFECTS_AUTO = 0,
+	LAB_REDUCED_EFFECTS_ENABLED,
+	LAB_REDUCED_EFFECTS_DISABLED,
+};
+
+enum window_switcher_order {
+	LAB_WINDOW_SWITCHER_ORDER_STACKING = 0,
+	LAB_WINDOW_SWITCHER_ORDER_FOCUS,
 };
 
 enum tiling_events_mode {
@@ -35,6 +55,30 @@ enum tiling_events_mode {
 		(LAB_TILING_EVENTS_REGION | LAB_TILING_EVENTS_EDGE),
 };
 
+/* Determine <core><maxRenderTime> from measured render durations */
+#define LAB_MAX_RENDER_TIME_AUTO (-1)
+
+/*
+ * Top-level elements of rc.xml whose content is hashed, so that reconfigure
+ * only updates the subsystems configured by elements which changed
+ */
+enum rc_section {
+	LAB_RC_SECTION_OTHER = 0,
+	LAB_RC_SECTION_CORE,
+	LAB_RC_SECTION_THEME,
+	LAB_RC_SECTION_KEYBOARD,
+	LAB_RC_SECTION_MOUSE,
+	LAB_RC_SECTION_LIBINPUT,
+	LAB_RC_SECTION_TOUCH,
+	LAB_RC_SECTION_TABLET,
+	LAB_RC_SECTION_SNAPPING,
+	LAB_RC_SECTION_RESIZE,
+	LAB_RC_SECTION_DESKTOPS,
+	LAB_RC_SECTION_REGIONS,
+
+	LAB_RC_SECTION_COUNT
+};
+
 struct usable_area_override {
 	struct border margin;
 	char *output;
@@ -51,9 +95,24 @@ struct rcxml {
 	bool xdg_shell_server_side_deco;
 	int gap;
 	enum adaptive_sync_mode adaptive_sync;
-	bool allow_tearing;
+	enum tearing_mode allow_tearing;
+	char *tearing_outputs; /* NULL means all outputs */
 	bool reuse_output_mode;
+	int max_render_time; /* in ms, 0 means disabled */
+	int trim_hidden_views; /* in seconds, 0 means disabled */
+	int background_frame_rate; /* in Hz, 0 means disabled */
+	int commit_rate_limit; /* in Hz, 0 means disabled */
+	int output_change_delay; /* in ms, 0 means disabled */
+	int buffer_cache_size; /* in MiB */
+	bool trim_heap;
+	bool memory_pressure;
+	int idle_refresh_rate; /* in Hz, 0 means disabled */
+	int idle_refresh_delay; /* in ms */
+	bool idle_refresh_battery_only;
+	int xwayland_prewarm; /* in seconds, 0 means disabled */
+	enum reduced_effects_mode reduced_effects;
 	enum view_placement_policy placement_policy;
+	int placement_memory_size; /* apps remembered, 0 means disabled */
 
 	/* focus */
 	bool focus_follow_mouse;
@@ -65,6 +124,7 @@ struct rcxml {
 	int corner_radius;
 	bool ssd_keep_border;
 	bool shadows_enabled;
+	bool glyph_cache;
 	struct font font_activewindow;
 	struct font font_inactivewindow;
 	struct font font_menuitem;
@@ -87,6 +147,7 @@ struct rcxml {
 	long doubleclick_time;     /* in ms */
 	struct wl_list mousebinds; /* struct mousebind.link */
 	double scroll_factor;
+	bool coalesce_motion;
 
 	/* touch tablet */
 	struct wl_list touch_configs;
@@ -116,10 +177,13 @@ struct rcxml {
 	enum tiling_events_mode snap_tiling_events_mode;
 
 	enum resize_indicator_mode resize_indicator;
+	bool resize_pacing;
 
 	struct {
 		int popuptime;
 		int min_nr_workspaces;
+		/* Touchpad swipes with this many fingers switch workspaces */
+		int swipe_fingers;
 		char *prefix;
 		struct wl_list workspaces;  /* struct workspace.link */
 	} workspace_config;
@@ -132,6 +196,9 @@ struct rcxml {
 		bool show;
 		bool preview;
 		bool outlines;
+		bool thumbnails;
+		bool filter;
+		enum window_switcher_order order;
 		uint32_t criteria;
 		struct wl_list fields;  /* struct window_switcher_field.link */
 	} window_switcher;
@@ -140,6 +207,16 @@ struct rcxml {
 
 	/* Menu */
 	unsigned int menu_ignore_button_release_period;
+
+	/* Content hashes of the elements read, indexed by enum rc_section */
+	uint64_t section_hashes[LAB_RC_SECTION_COUNT];
+
+	/*
+	 * Owns the keybinds, mousebinds, window rules, regions and window
+	 * switcher fields including their actions, all freed at once by
+	 * rcxml_finish()
+	 */
+	struct arena arena;
 };
 
 extern struct rcxml rc;
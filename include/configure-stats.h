@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_CONFIGURE_STATS_H
+#define LABWC_CONFIGURE_STATS_H
+
+#include <stdint.h>
+
+struct histogram;
+struct view;
+
+/*
+ * Per-application statistics of the time clients take to respond to
+ * configure events, keyed by app_id (xdg-shell) or class (XWayland).
+ *
+ * They make the configure timeout adaptive: once enough responses have
+ * been seen, an application is given its 99th percentile response time
+ * plus a margin instead of a fixed timeout. A timeout is recorded as a
+ * response taking the full timeout, so slow applications get longer
+ * timeouts over time.
+ */
+
+/**
+ * configure_stats_sent() - note that a configure was sent to @view
+ * Return: the number of milliseconds to wait for the response
+ */
+int configure_stats_sent(struct view *view);
+
+/* Called when @view has responded to the last configure sent */
+void configure_stats_acked(struct view *view);
+
+/**
+ * configure_stats_timed_out() - record a missed response
+ * Return: milliseconds since the configure was sent
+ */
+int configure_stats_timed_out(struct view *view);
+
+/* Print per-application response times to stdout */
+void configure_stats_dump(void);
+
+/* Call @fn for each application with its response times in usec */
+void configure_stats_for_each(void (*fn)(const char *name,
+	struct histogram *response, uint64_t timeouts, void *data), void *data);
+
+void configure_stats_finish(void);
+
+#endif /* LABWC_CONFIGURE_STATS_H */
@@ -2,8 +2,68 @@
 #ifndef LABWC_DEBUG_H
 #define LABWC_DEBUG_H
 
+#include <pixman.h>
+#include <stdint.h>
+
+struct buf;
+struct histogram;
+struct output;
 struct server;
+struct view;
 
 void debug_dump_scene(struct server *server);
 
+/**
+ * debug_dump_scene_stats() - print the number of scene nodes by type and
+ * the memory of the buffers drawn by labwc, per part of the compositor
+ * (views, decorations, menus, OSD, layer-shell clients) to stdout.
+ * Unlike debug_dump_scene(), this includes the subtrees not printed there.
+ */
+void debug_dump_scene_stats(struct server *server);
+
+struct debug_scene_stats {
+	uint32_t trees;
+	uint32_t rects;
+	uint32_t buffers;
+	uint32_t surfaces;
+	/* Compositor-drawn buffers, each one counted once */
+	uint64_t buffer_bytes;
+};
+
+/* Count the nodes of the whole scene, as totalled by the dump above */
+void debug_get_scene_stats(struct server *server,
+	struct debug_scene_stats *total);
+
+/**
+ * debug_dump_output_stats() - print per-output frame timing statistics
+ * (latency percentiles of building, committing and sending frame-done
+ * events, as well as missed vblanks) to stdout.
+ */
+void debug_dump_output_stats(struct server *server);
+
+/* Print a table header and rows of histogram percentiles to stdout */
+void debug_dump_histogram_header(const char *unit);
+void debug_dump_histogram(const char *name, struct histogram *hist);
+
+/**
+ * debug_get_scanout_blockers() - describe the scene nodes which are shown
+ * above the surface of a fullscreen view and thus prevent direct scanout
+ * @output: output showing @view
+ * @view: fullscreen view
+ * @out: buffer to append a comma separated list of node names to
+ */
+void debug_get_scanout_blockers(struct output *output, struct view *view,
+	struct buf *out);
+
+/**
+ * debug_highlight_damage() - visualize damage when running with
+ * LABWC_DEBUG_DAMAGE=highlight by drawing fading rectangles into
+ * output->osd_tree. Does nothing otherwise.
+ * @output: output that is about to be rendered
+ * @damage: damage of the upcoming frame in output-local logical
+ *          coordinates. The areas of existing highlight rectangles are
+ *          removed from it, as their damage is caused by this function.
+ */
+void debug_highlight_damage(struct output *output, pixman_region32_t *damage);
+
 #endif /* LABWC_DEBUG_H */
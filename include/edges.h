@@ -121,4 +121,37 @@ void edges_adjust_resize_geom(struct view *view, struct border edges,
 bool edges_traverse_edge(struct edge current, struct edge target, struct edge edge);
 
 void edges_calculate_visibility(struct server *server, struct view *ignored_view);
+
+/*
+ * edges_find_neighbors() uses an index of window edges and
+ * edges_calculate_visibility() updates view->edges_visible incrementally.
+ * Both rely on being told about changes:
+ *
+ * edges_update_view() - the view was moved or resized
+ * edges_invalidate_view() - the view was mapped, unmapped, restacked,
+ *   moved to another workspace, or its decorations or shading changed
+ * edges_invalidate_all() - the workspace or the output layout changed
+ * edges_invalidate_outputs() - the usable area of an output changed
+ */
+void edges_update_view(struct view *view);
+void edges_invalidate_view(struct view *view);
+void edges_invalidate_all(struct server *server);
+void edges_invalidate_outputs(struct server *server);
+void edges_finish(struct server *server);
+
+/*
+ * Snapshot the edges of other views and the usable output areas once for
+ * an interactive move/resize of @view instead of gathering them on every
+ * motion event. The snapshot follows the edges_*() notifications above.
+ */
+void edges_begin_session(struct view *view);
+void edges_end_session(struct server *server);
+
+/**
+ * edges_calculate_occlusion() - set view->occluded for all views which
+ * are currently rendered, i.e. not minimized and on the current workspace.
+ * A view is occluded if the opaque parts of the views above it (and the
+ * space outside of all outputs) cover it completely.
+ */
+void edges_calculate_occlusion(struct server *server);
 #endif /* LABWC_EDGES_H */
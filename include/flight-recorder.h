@@ -0,0 +1,71 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_FLIGHT_RECORDER_H
+#define LABWC_FLIGHT_RECORDER_H
+
+#include <stdint.h>
+
+struct server;
+
+/*
+ * Always-on ring buffer of the most recent compositor events, to see what
+ * led up to a rare hitch or crash without running with debug logging.
+ * Recording an event stores a timestamp and three integers and does not
+ * allocate or lock, so it is kept enabled in production.
+ *
+ * The buffer is written as text to $XDG_RUNTIME_DIR/labwc-flight-recorder.
+ * <pid> with the Debug action, on SIGUSR1, on a stall reported by the
+ * watchdog and on crashes. LABWC_FLIGHT_RECORDER may be set to another
+ * path, or to "off" to disable recording altogether.
+ */
+
+enum flight_event_type {
+	/* a: enum wlr_input_device_type, b: timestamp of the event in ms */
+	FLIGHT_EVENT_INPUT,
+	/* a: enum action_type, b: view, c: name of the action */
+	FLIGHT_EVENT_ACTION,
+	/* b: view */
+	FLIGHT_EVENT_CONFIGURE_SENT,
+	/* b: view, c: response time in us */
+	FLIGHT_EVENT_CONFIGURE_ACKED,
+	/* b: view, c: time waited in ms */
+	FLIGHT_EVENT_CONFIGURE_TIMEOUT,
+	/* a: scene output index, b: build time in us, c: commit time in us */
+	FLIGHT_EVENT_OUTPUT_COMMIT,
+	/* b: view */
+	FLIGHT_EVENT_VIEW_MAP,
+	FLIGHT_EVENT_VIEW_UNMAP,
+	/* b: operation, c: phase, see phase-timer.h */
+	FLIGHT_EVENT_PHASE,
+	/* b: duration of the event loop dispatch in us */
+	FLIGHT_EVENT_STALL,
+	FLIGHT_EVENT_COUNT,
+};
+
+/*
+ * Fields documented as names hold an index from flight_recorder_string(),
+ * which is looked up when the buffer is written out.
+ */
+void flight_record(enum flight_event_type type, uint32_t a, uint64_t b,
+	uint64_t c);
+
+#define FLIGHT_STRING_NONE UINT32_MAX
+
+/*
+ * Returns the index of @literal in the table of names, adding it if
+ * needed, or FLIGHT_STRING_NONE if the table is full. @literal must stay
+ * valid for the lifetime of the compositor. Only call from the main
+ * thread.
+ */
+uint32_t flight_recorder_string(const char *literal);
+
+void flight_recorder_init(struct server *server);
+
+/* Writes the buffer to the dump file, async-signal-safe */
+void flight_recorder_dump(const char *reason);
+
+/* Same as flight_recorder_dump(), but logs where the dump went */
+void flight_recorder_save(const char *reason);
+
+void flight_recorder_finish(void);
+
+#endif /* LABWC_FLIGHT_RECORDER_H */
@@ -0,0 +1,33 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_HEAP_TRIM_H
+#define LABWC_HEAP_TRIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct server;
+
+/*
+ * With <core><trimHeap>, memory freed after a reconfigure, a large pipe
+ * menu or a window switcher render is handed back to the system with
+ * malloc_trim(). The allocator otherwise keeps it for reuse, so the
+ * resident size of labwc only ever grows.
+ *
+ * Trimming runs from a timer a few seconds after the last call to
+ * heap_trim_schedule(), so a burst of work is only trimmed once and not
+ * while it is still in progress. Without malloc_trim() (e.g. on musl)
+ * this does nothing.
+ */
+void heap_trim_schedule(struct server *server);
+
+struct heap_trim_stats {
+	uint64_t runs;
+	/* Decrease of the resident size over all runs */
+	size_t reclaimed_bytes;
+};
+
+void heap_trim_get_stats(struct heap_trim_stats *stats);
+
+void heap_trim_finish(void);
+
+#endif /* LABWC_HEAP_TRIM_H */
@@ -0,0 +1,36 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_IDLE_REFRESH_H
+#define LABWC_IDLE_REFRESH_H
+
+#include <stdbool.h>
+
+struct output;
+struct server;
+
+/*
+ * With <core><idleRefresh rate="">, outputs which have not been damaged
+ * for a while are switched to a mode of the same size with a lower
+ * refresh rate, by default only while running on battery. The full rate
+ * is restored with the first damaged frame or input event. Outputs with
+ * adaptive sync enabled are left alone, as they already drop to the
+ * minimum refresh rate of the panel when nothing is committed.
+ */
+void idle_refresh_init(struct server *server);
+
+/* Called for every frame event of a usable output */
+void idle_refresh_record_frame(struct output *output, bool damaged);
+
+/* Adds a pending mode change to the pending state of the frame */
+void idle_refresh_apply(struct output *output);
+
+/* Restores the full rate of all outputs on input */
+void idle_refresh_notify_activity(void);
+
+/* Forgets the lowered rate when the mode was set by an output config */
+void idle_refresh_reset(struct output *output);
+
+void idle_refresh_reconfigure(struct server *server);
+
+void idle_refresh_finish(void);
+
+#endif /* LABWC_IDLE_REFRESH_H */
@@ -2,10 +2,15 @@
 #ifndef LABWC_IDLE_H
 #define LABWC_IDLE_H
 
+#include <stdint.h>
+
 struct wl_display;
 struct wlr_seat;
 
 void idle_manager_create(struct wl_display *display, struct wlr_seat *wlr_seat);
 void idle_manager_notify_activity(struct wlr_seat *seat);
 
+/* Number of input events seen so far, including throttled ones */
+uint64_t idle_manager_get_activity_count(void);
+
 #endif /* LABWC_IDLE_H */
@@ -105,21 +105,55 @@ enum lab_cursors cursor_get_from_edge(uint32_t resize_edges);
  * This can be used to give the mouse focus to the surface under the cursor
  * or to force an update of the cursor icon by sending an exit and enter
  * event to an already focused surface.
+ *
+ * The update is done once the event loop becomes idle, so a single action
+ * changing the stacking order several times only hit-tests the scene once.
  */
 void cursor_update_focus(struct server *server);
 
+/**
+ * cursor_settle_focus - run a pending cursor_update_focus() right away
+ * @server - server
+ *
+ * For callers which depend on state that is about to change.
+ */
+void cursor_settle_focus(struct server *server);
+
 /**
  * cursor_update_image - re-set the labwc cursor image
  * @seat - seat
  *
  * This can be used to update the cursor image on output scale changes.
  * If the current cursor image was not set by labwc but some client
- * this is a no-op.
+ * this is a no-op. It also does nothing unless the usable outputs or
+ * their scales changed since the last call; clear seat->cursor_image_key
+ * to force an update.
  */
 void cursor_update_image(struct seat *seat);
 
+/**
+ * cursor_check_hardware - log outputs which fell back to a software
+ * cursor, or went back to the hardware cursor plane, since the last check
+ * @seat - seat
+ * @cause - what changed the cursor image, for the log message
+ */
+void cursor_check_hardware(struct seat *seat, const char *cause);
+
+/**
+ * cursor_flush_motion - process pointer motion and axis events deferred
+ * by <mouse><coalesceMotion>, if any
+ * @seat - seat
+ *
+ * Called once per output frame and before any pointer event which
+ * depends on the cursor position, like button presses.
+ */
+void cursor_flush_motion(struct seat *seat);
+
 void cursor_init(struct seat *seat);
 void cursor_reload(struct seat *seat);
+
+/* Load the cursor theme for the scales of all outputs */
+void cursor_load_output_scales(struct seat *seat);
 void cursor_emulate_move_absolute(struct seat *seat,
 		struct wlr_input_device *device,
 		double x, double y, uint32_t time_msec);
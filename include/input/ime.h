@@ -31,6 +31,15 @@ struct input_method_relay {
 
 	struct wlr_input_popup_surface_v2 *popup_surface;
 	struct wlr_scene_tree *popup_tree;
+	/* Inputs of the last popup placement, see update_popup_position() */
+	struct {
+		bool valid;
+		struct wlr_surface *focused_surface;
+		struct wlr_box cursor_rect; /* in layout coordinates */
+		int width, height;
+		uint64_t usable_area_generation;
+		struct wlr_box output_box;
+	} popup_placement;
 
 	struct wl_listener new_text_input;
 	struct wl_listener new_input_method;
@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_LATENCY_H
+#define LABWC_LATENCY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct output;
+struct wlr_input_device;
+struct wlr_output_event_present;
+
+/*
+ * End-to-end input latency tracing, enabled by LABWC_DEBUG_LATENCY=1.
+ *
+ * The first event of each input device that has not yet been rendered is
+ * remembered along with its timestamp. The next output commit is taken as
+ * the frame which first reflects it, and the presentation event of that
+ * commit completes the sample. All functions are cheap no-ops when
+ * tracing is disabled.
+ */
+
+bool latency_tracing_enabled(void);
+
+/**
+ * latency_input_event() - record an input event
+ * @device: device which generated the event
+ * @time_msec: event timestamp (CLOCK_MONOTONIC, as passed by wlroots)
+ */
+void latency_input_event(struct wlr_input_device *device, uint32_t time_msec);
+
+/* Called after a successful commit of @output */
+void latency_output_commit(struct output *output);
+
+/* Called from the present event of @output */
+void latency_output_present(struct output *output,
+	struct wlr_output_event_present *event);
+
+void latency_output_destroy(struct output *output);
+
+/* Print per-device latency histograms to stdout */
+void latency_dump(void);
+
+void latency_finish(void);
+
+#endif /* LABWC_LATENCY_H */
@@ -43,6 +43,8 @@
 #include <wlr/types/wlr_text_input_v3.h>
 #include <wlr/types/wlr_input_method_v2.h>
 #include <wlr/util/log.h>
+#include "common/defer.h"
+#include "common/histogram.h"
 #include "config/keybind.h"
 #include "config/rcxml.h"
 #include "input/cursor.h"
@@ -67,9 +69,13 @@ enum input_mode {
 	LAB_INPUT_STATE_MENU,
 };
 
+struct libinput_state;
+
 struct input {
 	struct wlr_input_device *wlr_input_device;
 	struct seat *seat;
+	/* Applied libinput configuration, see configure_libinput() */
+	struct libinput_state *libinput;
 	struct wl_listener destroy;
 	struct wl_list link; /* seat.inputs */
 };
@@ -96,6 +102,11 @@ struct seat {
 	struct wlr_seat *seat;
 	struct server *server;
 	struct wlr_keyboard_group *keyboard_group;
+	/*
+	 * Bumped when the keymap changes, which invalidates the layouts
+	 * stored per view for <keyboard><layoutScope>window
+	 */
+	uint32_t keyboard_layout_generation;
 
 	struct wl_list touch_points; /* struct touch_point.link */
 
@@ -105,12 +116,34 @@ struct seat {
 	 * (in that case the client is expected to set its own cursor image).
 	 */
 	enum lab_cursors server_cursor;
+	/* Usable outputs and scales at the last cursor_update_image() */
+	uint64_t cursor_image_key;
 	struct wlr_cursor *cursor;
+	/* cursor_context_cache.lookup_serial of the last SSD hover update */
+	uint32_t hover_lookup_serial;
 	struct wlr_xcursor_manager *xcursor_manager;
 	struct {
 		double x, y;
 	} smooth_scroll_offset;
 
+	/* Deferred pointer motion, see <mouse><coalesceMotion> */
+	bool motion_pending;
+	uint32_t motion_pending_msec;
+
+	/* Deferred axis events, indexed by enum wlr_axis_orientation */
+	struct pending_axis {
+		bool pending;
+		uint32_t time_msec;
+		double delta;
+		int32_t delta_discrete;
+		enum wlr_axis_source source;
+		/* Only compared, the deltas are dropped if focus changes */
+		struct wlr_surface *surface;
+	} axis_pending[2];
+
+	/* Pending cursor_update_focus() */
+	struct defer focus_update;
+
 	struct wlr_pointer_constraint_v1 *current_constraint;
 
 	/* In support for ToggleKeybinds */
@@ -181,6 +214,8 @@ struct seat {
 	struct wl_listener swipe_begin;
 	struct wl_listener swipe_update;
 	struct wl_listener swipe_end;
+	/* The current swipe switches workspaces instead of going to clients */
+	bool swipe_switches_workspace;
 
 	struct wl_listener request_cursor;
 	struct wl_listener request_set_shape;
@@ -204,12 +239,17 @@ struct seat {
 
 struct lab_data_buffer;
 struct workspace;
+struct edge_index;
+struct edge_visibility;
+struct placement_cache;
+struct perf_hud;
 
 struct server {
 	struct wl_display *wl_display;
 	struct wl_event_loop *wl_event_loop;  /* Can be used for timer events */
 	struct wlr_renderer *renderer;
 	struct wlr_allocator *allocator;
+	struct wlr_linux_dmabuf_v1 *linux_dmabuf; /* NULL without dmabuf support */
 	struct wlr_backend *backend;
 	struct headless {
 		struct wlr_backend *backend;
@@ -228,6 +268,13 @@ struct server {
 	struct wlr_xwayland *xwayland;
 	struct wl_listener xwayland_xwm_ready;
 	struct wl_listener xwayland_new_surface;
+	/* Xwayland is started lazily, see xwayland_server_init() */
+	struct wl_listener xwayland_server_start;
+	struct wl_event_source *xwayland_prewarm_timer;
+	struct defer xwayland_stacking_update;
+	int64_t xwayland_start_nsec;
+	/* Our idea of the X11 stacking order, topmost first */
+	struct wl_list xwayland_stack; /* struct xwayland_view.stack_link */
 #endif
 
 	struct wlr_input_inhibit_manager *input_inhibit;
@@ -238,7 +285,27 @@ struct server {
 	struct wl_listener xdg_activation_request;
 
 	struct wl_list views;
+	struct wl_list views_always_on_top; /* struct view.workspace_link */
+	/* Mapped views, most recently focused first */
+	struct wl_list views_focus_history; /* struct view.focus_link */
+	int64_t view_stack_top;
+	int64_t view_stack_bottom;
 	struct wl_list unmanaged_surfaces;
+	/* Mapped unmanaged surfaces which may take focus, latest last */
+	struct wl_list unmanaged_focus_candidates;
+	struct defer occlusion_update;
+	struct defer top_layer_update;
+	struct edge_index *edge_index;
+	struct edge_visibility *edge_visibility;
+	struct placement_cache *placement_cache;
+
+	/* See transaction.h */
+	struct transaction {
+		int depth;
+		int nr_pending;
+		int64_t hold_start_nsec;
+		struct wl_event_source *timeout;
+	} transaction;
 
 	struct seat seat;
 	struct wlr_scene *scene;
@@ -247,10 +314,20 @@ struct server {
 	/* cursor interactive */
 	enum input_mode input_mode;
 	struct view *grabbed_view;
+	/* See view_flush_move_update() */
+	bool move_update_pending;
 	double grab_x, grab_y;
 	struct wlr_box grab_box;
 	uint32_t resize_edges;
 
+	/*
+	 * With <resize><pacing>, the latest interactive resize geometry is
+	 * held back here while the grabbed view has a configure in flight
+	 * and sent by interactive_resize_flush() once the client commits.
+	 */
+	bool resize_pending;
+	struct wlr_box resize_pending_geo;
+
 	/*
 	 * 'active_view' is generally the view with keyboard-focus, updated with
 	 * each "focus change". This view is drawn with "active" SSD coloring.
@@ -266,7 +343,31 @@ struct server {
 	 */
 	struct view *last_raised_view;
 
+	/*
+	 * Result of the last get_cursor_context() call and the box in
+	 * layout coordinates within which it stays valid as long as
+	 * the scene does not change.
+	 */
+	struct cursor_context_cache {
+		struct cursor_context ctx;
+		struct wlr_scene_node *leaf; /* node hit by wlr_scene_node_at() */
+		int leaf_lx, leaf_ly;
+		struct wlr_box box;
+		uint64_t generation;
+		struct wl_listener leaf_destroy;
+		/* Surface of the leaf, if any, its commits reset the cache */
+		struct wlr_surface *surface;
+		struct wl_listener surface_commit;
+		/*
+		 * Incremented for each result not served from the cache,
+		 * i.e. whenever the node under the cursor may have changed
+		 */
+		uint32_t lookup_serial;
+	} cursor_context_cache;
+
 	struct ssd_hover_state *ssd_hover_state;
+	struct wl_list ssd_title_updates; /* struct ssd.title_update_link */
+	struct wl_list ssd_geometry_updates; /* struct ssd.geometry_update_link */
 
 	/* Tree for all non-layer xdg/xwayland-shell surfaces */
 	struct wlr_scene_tree *view_tree;
@@ -295,6 +396,19 @@ struct server {
 	struct wl_list outputs;
 	struct wl_listener new_output;
 	struct wlr_output_layout *output_layout;
+	/*
+	 * Bumped when the output layout or any usable area changes.
+	 * Never zero, so that zero marks caches as invalid.
+	 */
+	uint64_t usable_area_generation;
+	/* Outputs in the layout, for output_nearest_to() */
+	struct output_index {
+		uint64_t generation;
+		struct output **outputs;
+		struct wlr_box *boxes; /* in layout coordinates */
+		size_t count;
+		size_t capacity;
+	} output_index;
 
 	struct wl_listener output_layout_change;
 	struct wlr_output_manager_v1 *output_manager;
@@ -306,8 +420,13 @@ struct server {
 	 * to be ignored (to prevent, for example, moving views in a
 	 * transitory layout state).  Once the counter reaches zero,
 	 * do_output_layout_change() must be called explicitly.
+	 *
+	 * do_output_layout_change() itself defers the change by
+	 * <core><outputChangeDelay> using the timer below, so that bursts
+	 * of hotplug events from docks and KVMs are processed only once.
 	 */
 	int pending_output_layout_change;
+	struct wl_event_source *output_layout_change_timer;
 
 	struct wlr_gamma_control_manager_v1 *gamma_control_manager_v1;
 	struct wl_listener gamma_control_set_gamma;
@@ -329,6 +448,8 @@ struct server {
 	struct wlr_tearing_control_manager_v1 *tearing_control;
 	struct wl_listener tearing_new_object;
 
+	struct wlr_content_type_manager_v1 *content_type_manager;
+
 	struct wlr_input_method_manager_v2 *input_method_manager;
 	struct wlr_text_input_manager_v3 *text_input_manager;
 
@@ -340,6 +461,10 @@ struct server {
 		struct wlr_scene_tree *preview_parent;
 		struct wlr_scene_node *preview_anchor;
 		struct multi_rect *preview_outline;
+		/* Views listed by the window switcher, see osd_update() */
+		struct wl_array views;
+		/* Typed to narrow down the views, lowercase */
+		char filter[64];
 	} osd_state;
 
 	struct theme *theme;
@@ -363,17 +488,153 @@ struct output {
 	struct wlr_scene_tree *session_lock_tree;
 	struct wlr_scene_buffer *workspace_osd;
 	struct wlr_box usable_area;
+	/*
+	 * Bumped when the usable area or the position of the output in the
+	 * layout changes, see output_update_all_usable_areas()
+	 */
+	uint64_t usable_area_generation;
+	struct wlr_box usable_area_layout_box;
+	/* Cached output_usable_area_in_layout_coords() */
+	struct wlr_box usable_area_in_layout;
+	uint64_t usable_area_in_layout_generation;
+	/* Cached snapping geometry, see output_get_edge_snap() */
+	struct output_edge_snap {
+		uint64_t generation;
+		int gap;
+		/* Indexed by enum view_edge, in layout coordinates */
+		struct wlr_box overlay[VIEW_EDGE_CENTER + 1];
+		/* Snapped geometry including gaps, before adding margins */
+		struct wlr_box target[VIEW_EDGE_CENTER + 1];
+		/* Bitmask (1 << edge) of edges with another output beyond */
+		uint32_t adjacent;
+	} edge_snap;
+	/* Visible fullscreen views, which hide the top layer */
+	int nr_fullscreen_views;
+
+	/*
+	 * Bitmask of layers (1 << layer) with surfaces that changed since
+	 * the last layers_arrange(), which only re-arranges those layers
+	 * and the ones depending on them. Zero arranges all layers.
+	 */
+	uint32_t layers_changed;
+	/* Areas from the last layers_arrange(), to arrange incrementally */
+	struct output_layers_cache {
+		struct wlr_box full_area;
+		/* usable area with <margin> overrides applied */
+		struct wlr_box base_area;
+		/* usable area left by the exclusive zones of each layer */
+		struct wlr_box usable_area[LAB_NR_LAYERS];
+	} layers_cache;
+
+	/* State at the last arrange, see desktop_arrange_changed_views() */
+	struct output_arranged {
+		bool usable;
+		bool changed;
+		struct wlr_box layout_box;
+		struct wlr_box usable_area;
+	} arranged;
 
 	struct wl_list regions;  /* struct region.link */
+	struct region_grid region_grid;
+	struct wl_list views;  /* struct view.output_link */
+
+	/* Only used with LABWC_DEBUG_DAMAGE=highlight */
+	struct wl_list damage_highlights;  /* struct damage_highlight.link */
 
+	/* Window switcher rows and the highlight moved across them */
 	struct lab_data_buffer *osd_buffer;
+	struct lab_data_buffer *osd_highlight_buffer;
+	struct wlr_scene_buffer *osd_highlight;
+	struct wlr_scene_tree *osd_thumbnail_highlight;
+	char *osd_content; /* what osd_buffer was rendered from */
+
+	/* Only set while the performance HUD is shown, see perf-hud.h */
+	struct perf_hud *perf_hud;
 
 	struct wl_listener destroy;
 	struct wl_listener frame;
 	struct wl_listener request_state;
+	struct wl_listener present;
+
+	/* Used to delay rendering, see <core><maxRenderTime> */
+	struct wl_event_source *repaint_timer;
+	/* Set while repaint_timer is armed, frame events are ignored */
+	bool repaint_delayed;
+	/* Sends frame-done to throttled views, see <core><backgroundFrameRate> */
+	struct wl_event_source *frame_done_timer;
+	int64_t last_present_nsec;
+	int refresh_nsec;
+	int64_t render_time_estimate_nsec;
+
+	/* Only set for virtual outputs, see output_virtual_add() */
+	int max_refresh;  /* in Hz, 0 means uncapped */
+	bool render_on_damage_only;
+	int64_t last_repaint_nsec;
 
 	bool leased;
 	bool gamma_lut_changed;
+	/*
+	 * The cursor was rendered in software at the last check, so that
+	 * the fallback is only logged once, see cursor_check_hardware()
+	 */
+	bool software_cursor;
+	/*
+	 * Adaptive sync state wanted by a fullscreen view, applied with the
+	 * next frame, see output_set_adaptive_sync()
+	 */
+	bool adaptive_sync_pending;
+	bool adaptive_sync_wanted;
+	enum {
+		LAB_ADAPTIVE_SYNC_SUPPORT_UNKNOWN = 0,
+		LAB_ADAPTIVE_SYNC_SUPPORTED,
+		LAB_ADAPTIVE_SYNC_UNSUPPORTED,
+	} adaptive_sync_support;
+	/* Refresh rate lowered while nothing changes, see idle-refresh.h */
+	struct output_idle_refresh {
+		/* Mode to return to, NULL unless the rate is lowered */
+		struct wlr_output_mode *full_mode;
+		/* Mode committed with the next frame */
+		struct wlr_output_mode *pending_mode;
+		/* No lower mode, or it failed the test commit */
+		bool unsupported;
+		int64_t last_damage_nsec;
+	} idle_refresh;
+	/*
+	 * Set from locking the session until a frame with the blanked
+	 * output has been committed. Such a frame is rendered straight
+	 * away, without render delay or waiting for transactions.
+	 */
+	bool session_lock_pending;
+
+	/* Frame timing statistics, see debug_dump_output_stats() */
+	struct output_frame_stats {
+		/* Durations in microseconds */
+		struct histogram build_state;
+		struct histogram commit;
+		struct histogram frame_done;
+		/* Damaged area per frame in logical pixels */
+		struct histogram damage_area;
+		uint64_t frames_fully_damaged;
+		uint64_t frames_committed;
+		uint64_t missed_vblanks;
+		int64_t last_frame_nsec;
+		bool last_frame_committed;
+
+		/* Composition path of frames showing a fullscreen view */
+		uint64_t frames_scanout;
+		uint64_t frames_composited;
+		/* Only used for comparison, never dereferenced */
+		struct view *last_fullscreen_view;
+		bool last_scanout;
+
+		/* Frames composited with the cursor, see software_cursor */
+		uint64_t frames_software_cursor;
+
+		/* Frames committed with tearing and actually presented torn */
+		uint64_t frames_tearing;
+		uint64_t frames_torn;
+		bool last_commit_tearing;
+	} frame_stats;
 };
 
 #undef LAB_NR_LAYERS
@@ -387,8 +648,26 @@ struct constraint {
 void xdg_popup_create(struct view *view, struct wlr_xdg_popup *wlr_popup);
 void xdg_shell_init(struct server *server);
 
+enum foreign_toplevel_update {
+	LAB_TOPLEVEL_UPDATE_TITLE = 1 << 0,
+	LAB_TOPLEVEL_UPDATE_APP_ID = 1 << 1,
+	LAB_TOPLEVEL_UPDATE_OUTPUTS = 1 << 2,
+	LAB_TOPLEVEL_UPDATE_ACTIVATED = 1 << 3,
+	LAB_TOPLEVEL_UPDATE_MINIMIZED = 1 << 4,
+	LAB_TOPLEVEL_UPDATE_MAXIMIZED = 1 << 5,
+	LAB_TOPLEVEL_UPDATE_FULLSCREEN = 1 << 6,
+
+	LAB_TOPLEVEL_UPDATE_ALL = (1 << 7) - 1,
+};
+
 void foreign_toplevel_handle_create(struct view *view);
-void foreign_toplevel_update_outputs(struct view *view);
+
+/*
+ * Queue changes of the view to be sent to taskbar clients. The current
+ * state of the view is relayed once per event loop iteration, so that
+ * several changes end up in a single update.
+ */
+void foreign_toplevel_schedule_update(struct view *view, uint32_t updates);
 
 /*
  * desktop.c routines deal with a collection of views
@@ -424,15 +703,37 @@ void desktop_focus_view_or_surface(struct seat *seat, struct view *view,
 	struct wlr_surface *surface, bool raise);
 
 void desktop_arrange_all_views(struct server *server);
+
+/**
+ * desktop_arrange_changed_views() - like desktop_arrange_all_views(), but
+ * only adjusts views on or intersecting outputs which were added, removed,
+ * moved or resized, or whose usability or usable area changed since the
+ * last arrange.
+ */
+void desktop_arrange_changed_views(struct server *server);
+
+/* Remember the area of a destroyed output for the next arrange */
+void desktop_forget_output(struct output *output);
 void desktop_focus_output(struct output *output);
 struct view *desktop_topmost_focusable_view(struct server *server);
 
 /**
- * Toggles the (output local) visibility of the layershell top layer
- * based on the existence of a fullscreen window on the current workspace.
+ * Schedules toggling the (output local) visibility of the layershell top
+ * layer based on the existence of a fullscreen window on the current
+ * workspace. Like desktop_update_occlusion(), several calls while handling
+ * one batch of events result in a single update.
  */
 void desktop_update_top_layer_visiblity(struct server *server);
 
+/**
+ * Schedules an update of the suspended state of all views, which is sent
+ * to views that are minimized, on another workspace or completely covered
+ * by other views so that they can stop rendering. Should be called
+ * whenever the stacking order, geometry or visibility of a view changes.
+ * The actual update is done once the event loop becomes idle.
+ */
+void desktop_update_occlusion(struct server *server);
+
 enum lab_cycle_dir {
 	LAB_CYCLE_DIR_NONE,
 	LAB_CYCLE_DIR_FORWARD,
@@ -478,6 +779,7 @@ void seat_output_layout_changed(struct seat *seat);
 void interactive_begin(struct view *view, enum input_mode mode, uint32_t edges);
 void interactive_finish(struct view *view);
 void interactive_cancel(struct view *view);
+void interactive_resize_flush(struct view *view);
 /* Possibly returns VIEW_EDGE_CENTER if <topMaximize> is yes */
 enum view_edge edge_from_cursor(struct seat *seat, struct output **dest_output);
 
@@ -489,17 +791,39 @@ struct output *output_from_name(struct server *server, const char *name);
 struct output *output_nearest_to(struct server *server, int lx, int ly);
 struct output *output_nearest_to_cursor(struct server *server);
 bool output_is_usable(struct output *output);
+
+/**
+ * output_get_fullscreen_view() - return the topmost fullscreen view shown
+ * on @output (on the current workspace and not minimized), or NULL
+ */
+struct view *output_get_fullscreen_view(struct output *output);
+
+/**
+ * output_get_software_cursor() - return the cursor shown on @output if
+ * it is composited into the frames rather than shown on the hardware
+ * cursor plane, otherwise NULL
+ */
+struct wlr_output_cursor *output_get_software_cursor(struct output *output);
 void output_update_usable_area(struct output *output);
 void output_update_all_usable_areas(struct server *server, bool layout_changed);
 struct wlr_box output_usable_area_in_layout_coords(struct output *output);
 struct wlr_box output_usable_area_scaled(struct output *output);
+/*
+ * Snap targets and overlay boxes for each edge of @output. They are only
+ * recomputed after the layout, a usable area or the gap changed.
+ */
+const struct output_edge_snap *output_get_edge_snap(struct output *output);
 void handle_output_power_manager_set_mode(struct wl_listener *listener,
 	void *data);
 void output_enable_adaptive_sync(struct wlr_output *output, bool enabled);
+void output_set_adaptive_sync(struct output *output, bool enabled);
 void new_tearing_hint(struct wl_listener *listener, void *data);
 
 void server_init(struct server *server);
 void server_start(struct server *server);
+/* Run the event loop until server_terminate() is called */
+void server_run(struct server *server);
+void server_terminate(struct server *server);
 void server_finish(struct server *server);
 
 /*
@@ -13,6 +13,8 @@ struct lab_layer_surface {
 	struct server *server;
 
 	bool mapped;
+	/* State the surface was last arranged with */
+	struct wlr_layer_surface_v1_state arranged_state;
 
 	struct wl_listener map;
 	struct wl_listener unmap;
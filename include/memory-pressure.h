@@ -0,0 +1,36 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_MEMORY_PRESSURE_H
+#define LABWC_MEMORY_PRESSURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct server;
+
+/*
+ * With <core><memoryPressure>, labwc subscribes to memory pressure
+ * notifications of the kernel (PSI) and drops caches that can be rebuilt
+ * when the system runs short of memory. In order:
+ *
+ *  - decoration buffers of minimized views and views on other workspaces
+ *  - cached buffers not currently displayed, like other scale variants
+ *  - scene nodes of closed menus
+ *  - text measurement and glyph caches
+ *
+ * If labwc is run as a systemd service with MemoryPressureWatch= the
+ * trigger configured there is used, otherwise a default one on
+ * /proc/pressure/memory.
+ */
+void memory_pressure_init(struct server *server);
+
+struct memory_pressure_stats {
+	uint64_t events;
+	/* Cached buffers released, decorations and menus not included */
+	size_t shed_bytes;
+};
+
+void memory_pressure_get_stats(struct memory_pressure_stats *stats);
+
+void memory_pressure_finish(void);
+
+#endif /* LABWC_MEMORY_PRESSURE_H */
@@ -29,14 +29,18 @@ struct menu_scene {
 
 struct menuitem {
 	struct wl_list actions;
+	char *text; /* NULL for separators */
+	bool arrow;
 	char *execute;
 	char *id; /* needed for pipemenus */
+	int cache_time; /* seconds to keep pipemenu output, 0 to disable */
 	struct menu *parent;
 	struct menu *submenu;
 	bool selectable;
 	int height;
 	int native_width;
-	struct wlr_scene_tree *tree;
+	int y; /* relative to the first item */
+	struct wlr_scene_tree *tree; /* NULL while scrolled out of view */
 	struct menu_scene normal;
 	struct menu_scene selected;
 	struct wl_list link; /* menu.menuitems */
@@ -55,12 +59,27 @@ struct menu {
 	} size;
 	struct wl_list menuitems;
 	struct server *server;
+
+	/*
+	 * Menus taller than the usable area of their output are scrolled.
+	 * Only items in view, and a few around them, have scene nodes.
+	 */
+	struct {
+		int offset; /* y of the first item in view */
+		int height; /* height of the view, 0 when not scrolling */
+	} scroll;
+
+	/* Selectable items sorted by label for type-ahead search */
+	struct menuitem **search_index; /* NULL until first searched */
+	int search_index_len;
 	struct {
 		struct menu *menu;
 		struct menuitem *item;
 	} selection;
 	struct wlr_scene_tree *scene_tree;
 	bool is_pipemenu;
+	/* Items were added or re-measured, see post_processing() */
+	bool needs_post_processing;
 	enum menu_align align;
 
 	/* Used to match a window-menu to the view that triggered it. */
@@ -75,6 +94,15 @@ void menu_submenu_enter(struct server *server);
 void menu_submenu_leave(struct server *server);
 bool menu_call_selected_actions(struct server *server);
 
+/**
+ * menu_type_ahead - select the next item whose label starts with the text
+ * typed so far
+ *
+ * @text UTF-8 text of a key press, appended to the text typed before unless
+ * the previous key press was more than a second ago
+ */
+void menu_type_ahead(struct server *server, const char *text);
+
 void menu_init(struct server *server);
 void menu_finish(struct server *server);
 
@@ -103,6 +131,15 @@ void menu_open_root(struct menu *menu, int x, int y);
  */
 void menu_process_cursor_motion(struct wlr_scene_node *node);
 
+/**
+ * menu_process_scroll - scroll the menu containing @node
+ *
+ * @delta number of items to scroll by, negative to scroll up
+ *
+ * Does nothing for menus which fit on their output.
+ */
+void menu_process_scroll(struct wlr_scene_node *node, int delta);
+
 /**
  * menu_call_actions - call actions associated with a menu node
  *
@@ -125,6 +162,14 @@ bool menu_call_actions(struct wlr_scene_node *node);
  */
 void menu_close_root(struct server *server);
 
+/**
+ * menu_shed_scenes - destroy the scene nodes of all closed menus
+ *
+ * They are created again once a menu is shown. Returns the number of
+ * menus that had scene nodes.
+ */
+size_t menu_shed_scenes(struct server *server);
+
 /* menu_reconfigure - reload theme and content */
 void menu_reconfigure(struct server *server);
 
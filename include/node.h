@@ -80,4 +80,9 @@ struct menuitem *node_menuitem_from_node(
 struct ssd_button *node_ssd_button_from_node(
 	struct wlr_scene_node *wlr_scene_node);
 
+/**
+ * node_descriptors_finish - free the pool of released node descriptors
+ */
+void node_descriptors_finish(void);
+
 #endif /* LABWC_NODE_DESCRIPTOR_H */
@@ -32,9 +32,20 @@ struct window_switcher_field {
 	struct wl_list link; /* struct rcxml.window_switcher.fields */
 };
 
+/* Per-view state, see osd_field.c */
+struct osd_field_cache {
+	char **contents; /* one per entry of rc.window_switcher.fields */
+	size_t nr_fields;
+	/* Lowercase app_id and title the window switcher filter matches */
+	char *search_key;
+	uint32_t generation;
+};
+
+struct arena;
 struct buf;
 struct view;
 struct server;
+struct wlr_scene_tree;
 
 /* Updates onscreen display 'alt-tab' buffer */
 void osd_update(struct server *server);
@@ -42,21 +53,64 @@ void osd_update(struct server *server);
 /* Closes the OSD */
 void osd_finish(struct server *server);
 
+/* Drops scene nodes kept between window cycles which depend on the theme */
+void osd_reconfigure(struct server *server);
+
 /* Moves preview views back into their original stacking order and state */
 void osd_preview_restore(struct server *server);
 
 /* Notify OSD about a destroying view */
 void osd_on_view_destroy(struct view *view);
 
+/* Selects the next or previous view listed by the window switcher */
+void osd_cycle(struct server *server, bool forwards);
+
+/*
+ * Type-to-filter: only views whose app_id or title contain the typed
+ * characters in order are listed. Typing a character which would leave
+ * no view is ignored. Extending the filter only checks the views which
+ * are already listed.
+ */
+void osd_filter_append(struct server *server, const char *text);
+void osd_filter_backspace(struct server *server);
+
 /* Used by osd.c internally to render window switcher fields */
 void osd_field_get_content(struct window_switcher_field *field,
 	struct buf *buf, struct view *view);
 
-/* Used by rcxml.c when parsing the config */
-struct window_switcher_field *osd_field_create(void);
-void osd_field_arg_from_xml_node(struct window_switcher_field *field,
-	const char *nodename, const char *content);
+/* Cached lowercase "app_id title" of @view, used by the filter */
+const char *osd_field_get_search_key(struct view *view);
+
+/*
+ * The contents of the fields are cached per view. The cache of a view is
+ * dropped with osd_field_invalidate() when its title, app_id, workspace,
+ * output or state changes, and for all views when the fields or outputs
+ * change.
+ */
+void osd_field_invalidate(struct view *view);
+void osd_field_invalidate_all(void);
+void osd_field_view_finish(struct view *view);
+
+/**
+ * osd_thumbnail_create() - create a live thumbnail of a view
+ * @parent: tree to add the thumbnail to
+ * @max_width: maximum width of the thumbnail
+ * @max_height: maximum height of the thumbnail
+ *
+ * The thumbnail references the buffers of the view's surfaces and follows
+ * their commits. It is destroyed together with @parent.
+ */
+struct wlr_scene_tree *osd_thumbnail_create(struct wlr_scene_tree *parent,
+	struct view *view, int max_width, int max_height);
+
+/*
+ * Used by rcxml.c when parsing the config. Fields are allocated from
+ * @arena and freed together with it.
+ */
+struct window_switcher_field *osd_field_create(struct arena *arena);
+void osd_field_arg_from_xml_node(struct arena *arena,
+	struct window_switcher_field *field, const char *nodename,
+	const char *content);
 bool osd_field_validate(struct window_switcher_field *field);
-void osd_field_free(struct window_switcher_field *field);
 
 #endif // LABWC_OSD_H
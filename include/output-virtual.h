@@ -2,10 +2,21 @@
 #ifndef LABWC_OUTPUT_VIRTUAL_H
 #define LABWC_OUTPUT_VIRTUAL_H
 
+#include <stdbool.h>
+
 struct server;
 struct wlr_output;
 
+/**
+ * output_virtual_add() - add a virtual output on the headless backend
+ * @output_name: name of the output, may be NULL
+ * @max_refresh: maximum number of frames per second, 0 means uncapped
+ * @render_on_damage_only: only render and send frame events to clients
+ *                         when something on the output has changed
+ * @store_wlr_output: set to the new wlr_output, may be NULL
+ */
 void output_virtual_add(struct server *server, const char *output_name,
+		int max_refresh, bool render_on_damage_only,
 		struct wlr_output **store_wlr_output);
 void output_virtual_remove(struct server *server, const char *output_name);
 void output_virtual_update_fallback(struct server *server);
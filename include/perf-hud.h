@@ -0,0 +1,41 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_PERF_HUD_H
+#define LABWC_PERF_HUD_H
+
+#include <pixman.h>
+
+struct lab_scene_commit_timing;
+struct output;
+struct server;
+
+/*
+ * Small on-screen overlay in the top left corner of each output, toggled
+ * by the TogglePerformanceHud action. It shows the frame rate, the time
+ * spent building and committing frames, the damaged area and dropped
+ * frames of the last second, plus a sparkline of the slowest frame of
+ * each update interval over the last few seconds.
+ *
+ * The overlay is re-rendered at most four times per second and only if
+ * something changed. Frames caused by nothing but its own updates are not
+ * counted, so an idle output stays idle and shows 0 fps.
+ */
+
+void perf_hud_toggle(struct server *server);
+
+/**
+ * perf_hud_record_damage() - account the damage of the upcoming frame
+ * @output: output that is about to be rendered
+ * @damage: damage in output-local logical coordinates. The area of the
+ *          overlay is removed from it, as that damage is caused by it.
+ */
+void perf_hud_record_damage(struct output *output, pixman_region32_t *damage);
+
+/* Account a committed frame, after perf_hud_record_damage() */
+void perf_hud_record_commit(struct output *output,
+	struct lab_scene_commit_timing *timing);
+
+void perf_hud_output_destroy(struct output *output);
+
+void perf_hud_finish(void);
+
+#endif /* LABWC_PERF_HUD_H */
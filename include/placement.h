@@ -7,5 +7,22 @@
 #include "view.h"
 
 bool placement_find_best(struct view *view, struct wlr_box *geometry);
+void placement_finish(struct server *server);
+
+/*
+ * With <placement><memory>, the position of the last window of each app
+ * is remembered across sessions, keyed by app_id, and its next window is
+ * placed there without running the placement policy. See
+ * placement-memory.c.
+ */
+
+/* Returns true if @view was placed where the app's last window was */
+bool placement_memory_place(struct view *view);
+
+/* Remembers the position of @view, called when it is unmapped */
+void placement_memory_record(struct view *view);
+
+/* Writes pending changes */
+void placement_memory_finish(void);
 
 #endif /* LABWC_PLACEMENT_H */
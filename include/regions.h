@@ -2,6 +2,7 @@
 #ifndef LABWC_REGIONS_H
 #define LABWC_REGIONS_H
 
+#include <stdint.h>
 #include <wlr/util/box.h>
 
 struct seat;
@@ -25,6 +26,21 @@ struct region {
 	} center;
 };
 
+/*
+ * Coarse grid over the regions of an output, built by
+ * regions_update_geometry(). Each cell lists the regions overlapping it,
+ * so that regions_from_cursor() only tests a few candidates instead of
+ * all regions of the output.
+ */
+struct region_grid {
+	struct wlr_box box; /* bounding box of all regions */
+	int cols;
+	int rows;
+	/* Regions of cell i are candidates[cell_start[i]..cell_start[i + 1]) */
+	uint32_t *cell_start;
+	struct region **candidates;
+};
+
 /* Returns true if we should show the region overlay or snap to region */
 bool regions_should_snap(struct server *server);
 
@@ -61,6 +77,8 @@ void regions_evacuate_output(struct output *output);
 /* Free all regions in given wl_list pointer */
 void regions_destroy(struct seat *seat, struct wl_list *regions);
 
+void regions_grid_finish(struct region_grid *grid);
+
 /* Get output local region from cursor or name, may be NULL */
 struct region *regions_from_cursor(struct server *server);
 struct region *regions_from_name(const char *region_name, struct output *output);
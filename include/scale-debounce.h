@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_SCALE_DEBOUNCE_H
+#define LABWC_SCALE_DEBOUNCE_H
+
+struct view;
+
+/*
+ * While a view is dragged across outputs, the scene would send its
+ * surfaces wl_surface.enter/leave and fractional scale events whenever
+ * the outputs below them change, and clients re-render at each new scale.
+ * During an interactive move those events are held back instead, and only
+ * sent once the outputs of the view have not changed for a short time or
+ * the move ends.
+ */
+void scale_debounce_begin(struct view *view);
+
+/* Called once per frame while the grabbed view moves */
+void scale_debounce_update(struct view *view);
+
+/* Sends what was held back and hands notifications back to the scene */
+void scale_debounce_end(struct view *view);
+
+#endif /* LABWC_SCALE_DEBOUNCE_H */
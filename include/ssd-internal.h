@@ -5,6 +5,7 @@
 #include <wlr/util/box.h>
 #include "common/macros.h"
 #include "ssd.h"
+#include "theme.h"
 #include "view.h"
 
 #define FOR_EACH(tmp, ...) \
@@ -37,6 +38,35 @@ struct ssd_sub_tree {
 struct ssd_state_title_width {
 	int width;
 	bool truncated;
+	/* Needs re-rendering before it is shown again */
+	bool stale;
+	/* What the title was last positioned for, -1 if not positioned */
+	int positioned_bg_width;
+	int positioned_buffer_width;
+	int positioned_buffer_height;
+};
+
+/* Titlebar parts of one state which are moved or resized with the view */
+struct ssd_titlebar_parts {
+	struct wlr_scene_rect *title_bg;
+	struct wlr_scene_node *iconify;
+	struct wlr_scene_node *maximize;
+	struct wlr_scene_node *close;
+	/* NULL until the title is rendered and while trimmed */
+	struct ssd_part *title;
+};
+
+/*
+ * Positions of the titlebar parts for a view width, only recomputed when
+ * the width changes. The decoration is re-created when the theme changes,
+ * so this never outlives the theme it was computed with.
+ */
+struct ssd_titlebar_layout {
+	int width;
+	int title_bg_width;
+	int iconify_x;
+	int maximize_x;
+	int close_x;
 };
 
 struct ssd {
@@ -50,9 +80,12 @@ struct ssd {
 	 */
 	struct {
 		bool was_maximized;   /* To un-round corner buttons and toggle icon on maximize */
+		bool active;
+		/* Title buffers dropped while hidden, see ssd_set_trimmed() */
+		bool trimmed;
 		struct wlr_box geometry;
 		struct ssd_state_title {
-			char *text;
+			const char *text; /* interned */
 			struct ssd_state_title_width active;
 			struct ssd_state_title_width inactive;
 		} title;
@@ -67,6 +100,9 @@ struct ssd {
 		struct wlr_scene_tree *tree;
 		struct ssd_sub_tree active;
 		struct ssd_sub_tree inactive;
+		struct ssd_titlebar_parts active_parts;
+		struct ssd_titlebar_parts inactive_parts;
+		struct ssd_titlebar_layout layout;
 	} titlebar;
 
 	/* Borders allow resizing as well */
@@ -88,6 +124,18 @@ struct ssd {
 	 * For xdg-shell views with CSD, this margin is zero.
 	 */
 	struct border margin;
+
+	/* Title changed, re-render on the next output frame */
+	bool title_update_pending;
+	struct wl_list title_update_link; /* server.ssd_title_updates */
+
+	/* Geometry changed, update the parts on the next output frame */
+	bool geometry_update_pending;
+	struct wl_list geometry_update_link; /* server.ssd_geometry_updates */
+
+	/* See ssd_prerender_nearby_scales() */
+	struct wl_event_source *prerender_idle;
+	double prerender_scale;
 };
 
 struct ssd_part {
@@ -135,12 +183,13 @@ void add_toggled_icon(struct ssd_button *button, struct wl_list *part_list,
 struct ssd_part *add_scene_button_corner(
 	struct wl_list *part_list, enum ssd_part_type type,
 	enum ssd_part_type corner_type, struct wlr_scene_tree *parent,
-	struct wlr_buffer *corner_buffer, struct wlr_buffer *icon_buffer,
+	enum theme_corner corner, struct wlr_buffer *icon_buffer,
 	struct wlr_buffer *hover_buffer, int x, struct view *view);
 
 /* SSD internal helpers */
 struct ssd_part *ssd_get_part(
 	struct wl_list *part_list, enum ssd_part_type type);
+void ssd_destroy_part(struct ssd_part *part);
 void ssd_destroy_parts(struct wl_list *list);
 
 /* SSD internal */
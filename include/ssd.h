@@ -52,6 +52,7 @@ enum ssd_part_type {
 struct ssd;
 struct ssd_button;
 struct ssd_hover_state;
+struct server;
 struct view;
 struct wlr_scene;
 struct wlr_scene_node;
@@ -66,11 +67,17 @@ struct wlr_scene_node;
  * NULL scene/view arguments are not allowed.
  */
 struct ssd *ssd_create(struct view *view, bool active);
-struct border ssd_get_margin(const struct ssd *ssd);
+struct border ssd_get_margin(struct view *view);
 void ssd_update_margin(struct ssd *ssd);
 void ssd_set_active(struct ssd *ssd, bool active);
 void ssd_update_title(struct ssd *ssd);
+void ssd_schedule_title_update(struct ssd *ssd);
+void ssd_set_trimmed(struct ssd *ssd, bool trimmed);
+void ssd_prerender_nearby_scales(struct ssd *ssd);
+bool ssd_is_trimmed(struct ssd *ssd);
+void ssd_flush_title_updates(struct server *server);
 void ssd_update_geometry(struct ssd *ssd);
+void ssd_flush_geometry_updates(struct server *server);
 void ssd_destroy(struct ssd *ssd);
 void ssd_titlebar_hide(struct ssd *ssd);
 
@@ -97,8 +104,13 @@ bool ssd_part_contains(enum ssd_part_type whole, enum ssd_part_type candidate);
 struct border ssd_thickness(struct view *view);
 struct wlr_box ssd_max_extents(struct view *view);
 
+/* Free the pools of released ssd parts and buttons */
+void ssd_finish(void);
+
 /* SSD debug helpers */
 bool ssd_debug_is_root_node(const struct ssd *ssd, struct wlr_scene_node *node);
+bool ssd_debug_is_shadow_node(const struct ssd *ssd,
+	struct wlr_scene_node *node);
 const char *ssd_debug_get_node_name(const struct ssd *ssd,
 	struct wlr_scene_node *node);
 
@@ -0,0 +1,17 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_STATS_SOCKET_H
+#define LABWC_STATS_SOCKET_H
+
+struct server;
+
+/*
+ * Optional unix socket for runtime statistics, enabled by setting
+ * LABWC_STATS_SOCKET to the path to listen on. Every client connecting
+ * is sent a single JSON document with the current counters and the
+ * connection is then closed, so the statistics can be sampled while
+ * labwc is running without the Debug action or a debugger.
+ */
+void stats_socket_init(struct server *server);
+void stats_socket_finish(struct server *server);
+
+#endif /* LABWC_STATS_SOCKET_H */
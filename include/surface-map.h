@@ -0,0 +1,37 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_SURFACE_MAP_H
+#define LABWC_SURFACE_MAP_H
+
+#include <stdbool.h>
+
+struct view;
+struct wlr_surface;
+
+/*
+ * Compositor-wide map from the surfaces of mapped views (the main surface
+ * as well as its subsurfaces and xdg-popups) to the view owning them.
+ * Surfaces are dropped from the map when they are destroyed or when the
+ * view is unmapped.
+ */
+
+/* Add view->surface and its subsurfaces; called on map */
+void surface_map_add_view(struct view *view);
+
+/* Add the surface of an xdg-popup (and its subsurfaces) of @view */
+void surface_map_add_popup(struct view *view, struct wlr_surface *surface);
+
+/* Drop all surfaces of @view; called on unmap and destroy */
+void surface_map_remove_view(struct view *view);
+
+/**
+ * surface_map_get_view() - find the view owning a surface
+ * @surface: main surface, subsurface or popup surface of a view
+ * @is_main: set to true if @surface is view->surface (may be NULL)
+ *
+ * Return: the view, or NULL if @surface does not belong to a mapped view
+ */
+struct view *surface_map_get_view(struct wlr_surface *surface, bool *is_main);
+
+void surface_map_finish(void);
+
+#endif /* LABWC_SURFACE_MAP_H */
@@ -9,6 +9,7 @@
 #define LABWC_THEME_H
 
 #include <stdio.h>
+#include <wayland-server-core.h>
 #include <wlr/render/wlr_renderer.h>
 
 enum lab_justification {
@@ -129,6 +130,12 @@ struct theme {
 	struct lab_data_buffer *corner_top_right_active_normal;
 	struct lab_data_buffer *corner_top_left_inactive_normal;
 	struct lab_data_buffer *corner_top_right_inactive_normal;
+	/* Corners rendered for other output scales, see theme_get_corner() */
+	struct wl_array scaled_corners;
+	/* Buttons rendered for other output scales, see theme_get_button() */
+	struct wl_array scalable_buttons;
+	struct wl_array scaled_buttons;
+	struct wlr_renderer *renderer;
 
 	struct lab_data_buffer *shadow_corner_top_active;
 	struct lab_data_buffer *shadow_corner_bottom_active;
@@ -143,6 +150,43 @@ struct theme {
 
 struct server;
 
+enum theme_corner {
+	THEME_CORNER_TOP_LEFT_ACTIVE = 0,
+	THEME_CORNER_TOP_RIGHT_ACTIVE,
+	THEME_CORNER_TOP_LEFT_INACTIVE,
+	THEME_CORNER_TOP_RIGHT_INACTIVE,
+	THEME_CORNER_COUNT,
+};
+
+/**
+ * theme_get_corner - get a rounded titlebar corner
+ * @theme: theme data
+ * @corner: which corner
+ * @scale: output scale the buffer will be shown at
+ *
+ * Corners are rendered once for each scale in use and shared by all views.
+ * The buffers are owned by the theme and released by theme_finish().
+ */
+struct lab_data_buffer *theme_get_corner(struct theme *theme,
+	enum theme_corner corner, double scale);
+
+/**
+ * theme_get_button - get a button icon
+ * @theme: theme data
+ * @button: one of the button buffers of @theme
+ * @scale: output scale the buffer will be shown at
+ *
+ * Buttons loaded from SVG files, and hover fallbacks drawn from them, are
+ * rendered once for each scale in use like corners. Other buttons are
+ * bitmaps and returned as is.
+ */
+struct lab_data_buffer *theme_get_button(struct theme *theme,
+	struct lab_data_buffer *button, double scale);
+
+/* Whether theme_get_button() renders @button for each scale */
+bool theme_button_is_scalable(struct theme *theme,
+	struct lab_data_buffer *button);
+
 /**
  * theme_init - read openbox theme and generate button textures
  * @theme: theme data
@@ -152,6 +196,15 @@ struct server;
  */
 void theme_init(struct theme *theme, struct server *server, const char *theme_name);
 
+/**
+ * theme_settings_equal - compare the settings read from themerc files
+ * @a: theme data
+ * @b: theme data, may be a copy of an older state of a theme
+ *
+ * Textures are not compared, they are generated from these settings.
+ */
+bool theme_settings_equal(const struct theme *a, const struct theme *b);
+
 /**
  * theme_finish - free button textures
  * @theme: theme data
@@ -0,0 +1,41 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_TRANSACTION_H
+#define LABWC_TRANSACTION_H
+
+#include <stdbool.h>
+
+struct server;
+struct view;
+
+/*
+ * Transactions batch geometry changes of several views so that the new
+ * layout is presented in a single frame. Between transaction_begin() and
+ * transaction_end() views are configured as usual; transaction_end() then
+ * holds back output repaints until every view which has been sent a
+ * configure in between has committed or TRANSACTION_TIMEOUT_MS has passed.
+ * Transactions which end while another one is still being waited for add
+ * their views to it, for at most TRANSACTION_MAX_HOLD_MS in total.
+ *
+ * Transactions nest; only the outermost transaction_end() takes effect.
+ */
+void transaction_begin(struct server *server);
+void transaction_end(struct server *server);
+
+/* Called whenever a configure is sent to a view */
+void transaction_view_configured(struct view *view);
+
+/*
+ * Called whenever a view may have responded to its configure. Does nothing
+ * while the view still has a configure in flight.
+ */
+void transaction_view_ready(struct view *view);
+
+/* Stops waiting for @view, whether or not its configure is in flight */
+void transaction_view_destroy(struct view *view);
+
+/* Returns true while output repaints are being held back */
+bool transaction_is_blocking(struct server *server);
+
+void transaction_finish(struct server *server);
+
+#endif /* LABWC_TRANSACTION_H */
@@ -3,7 +3,11 @@
 #define LABWC_VIEW_H
 
 #include "config.h"
+#include "common/bitset.h"
+#include "common/match.h"
+#include "osd.h"
 #include "ssd.h"
+#include "window-rules.h"
 #include <stdbool.h>
 #include <stdint.h>
 #include <wayland-util.h>
@@ -53,6 +57,14 @@ enum view_edge {
 	VIEW_EDGE_CENTER,
 };
 
+/* Content type hints, same values as enum wp_content_type_v1_type */
+enum view_content_type {
+	LAB_CONTENT_TYPE_NONE = 0,
+	LAB_CONTENT_TYPE_PHOTO,
+	LAB_CONTENT_TYPE_VIDEO,
+	LAB_CONTENT_TYPE_GAME,
+};
+
 enum view_wants_focus {
 	/* View does not want focus */
 	VIEW_WANTS_FOCUS_NEVER = 0,
@@ -116,6 +128,8 @@ struct view_impl {
 	void (*map)(struct view *view);
 	void (*set_activated)(struct view *view, bool activated);
 	void (*set_fullscreen)(struct view *view, bool fullscreen);
+	/* optional, tells the client that it does not need to render */
+	void (*set_suspended)(struct view *view, bool suspended);
 	void (*notify_tiled)(struct view *view);
 	/*
 	 * client_request is true if the client unmapped its own
@@ -130,7 +144,6 @@ struct view_impl {
 	void (*move_to_back)(struct view *view);
 	void (*shade)(struct view *view, bool shaded);
 	struct view *(*get_root)(struct view *self);
-	void (*append_children)(struct view *self, struct wl_array *children);
 	struct view_size_hints (*get_size_hints)(struct view *self);
 	/* if not implemented, VIEW_WANTS_FOCUS_ALWAYS is assumed */
 	enum view_wants_focus (*wants_focus)(struct view *self);
@@ -144,11 +157,36 @@ struct view_impl {
 };
 
 struct view {
+	/*
+	 * Fields read when walking all views (criteria filtering, stacking,
+	 * placement and edge math) are grouped here so that each pass
+	 * touches as few cache lines per view as possible. Keep rarely used
+	 * state further down.
+	 */
 	struct server *server;
-	enum view_type type;
 	const struct view_impl *impl;
 	struct wl_list link;
 
+	/* Stacking order, decreasing along server.views */
+	int64_t stack_seq;
+	/*
+	 * struct workspace.views or server.views_always_on_top (none for
+	 * always-on-bottom views), both kept in stacking order
+	 */
+	struct wl_list workspace_link;
+	struct wl_list *workspace_list;
+	/* struct workspace.mapped_views, see view_stack_update_mapped() */
+	struct wl_list mapped_link;
+	struct wl_list *mapped_list;
+	/*
+	 * Transient windows (dialogs and their dialogs) are linked into
+	 * family_root->family, so that subviews can be found without
+	 * walking all views. See view_update_family().
+	 */
+	struct view *family_root;
+	struct wl_list family;
+	struct wl_list family_link;
+
 	/*
 	 * The primary output that the view is displayed on. Specifically:
 	 *
@@ -165,41 +203,32 @@ struct view {
 	 * by calling view_set_output() beforehand.
 	 */
 	struct output *output;
-
-	/*
-	 * The outputs that the view is displayed on.
-	 * This is used to notify the foreign toplevel
-	 * implementation and to update the SSD invisible
-	 * resize area.
-	 * It is a bitset of output->scene_output->index.
-	 */
-	uint64_t outputs;
-
 	struct workspace *workspace;
-	struct wlr_surface *surface;
 	struct wlr_scene_tree *scene_tree;
-	struct wlr_scene_node *scene_node;
+	struct ssd *ssd;
+
+	enum view_type type;
+	enum view_axis maximized;
+	enum view_edge tiled;
+	uint32_t edges_visible;  /* enum wlr_edges bitset */
 
 	bool mapped;
-	bool been_mapped;
-	bool ssd_enabled;
-	bool ssd_titlebar_hidden;
-	enum ssd_preference ssd_preference;
-	bool shaded;
 	bool minimized;
-	enum view_axis maximized;
+	bool shaded;
 	bool fullscreen;
-	bool tearing_hint;
 	bool visible_on_all_workspaces;
-	enum view_edge tiled;
-	uint32_t edges_visible;  /* enum wlr_edges bitset */
+	bool ssd_enabled;
+	bool ssd_titlebar_hidden;
+	bool occluded;  /* see edges_calculate_occlusion() */
+	bool suspended;
+	bool been_mapped;
+	bool tearing_hint;
+	enum view_content_type content_type;  /* see content-type-v1 */
 	bool inhibits_keybinds;
-	xkb_layout_index_t keyboard_layout;
-
-	/* Pointer to an output owned struct region, may be NULL */
-	struct region *tiled_region;
-	/* Set to region->name when tiled_region is free'd by a destroying output */
-	char *tiled_region_evacuate;
+	/* Configured within the open transaction, see transaction.h */
+	bool transaction_configured;
+	/* Awaited by the current transaction */
+	bool transaction_pending;
 
 	/*
 	 * Geometry of the wlr_surface contained within the view, as
@@ -213,6 +242,53 @@ struct view {
 	 * move/resize requests are pending.
 	 */
 	struct wlr_box pending;
+	/* Last extents used by edges_calculate_visibility() */
+	struct wlr_box visibility_box;
+
+	/* End of the frequently accessed fields */
+
+	/*
+	 * The outputs that the view is displayed on.
+	 * This is used to notify the foreign toplevel
+	 * implementation and to update the SSD invisible
+	 * resize area.
+	 * It is a bitset of output->scene_output->index.
+	 */
+	struct bitset outputs;
+	struct wl_list output_link; /* struct output.views */
+	struct wl_list focus_link; /* struct server.views_focus_history */
+
+	struct wlr_surface *surface;
+	struct wl_list owned_surfaces; /* see surface-map.c */
+	struct window_rule_cache window_rules;
+	struct view_query_cache queries;
+	struct osd_field_cache osd_fields;
+	struct wlr_scene_node *scene_node;
+
+	/*
+	 * Usable area (in layout coordinates) popups of the view were
+	 * last constrained to, valid while usable_area_generation of the
+	 * server is unchanged. See popup_unconstrain().
+	 */
+	struct wlr_box popup_usable_area;
+	uint64_t popup_usable_area_generation;
+
+	enum ssd_preference ssd_preference;
+	/* Only valid if the generation matches the seat's */
+	xkb_layout_index_t keyboard_layout;
+	uint32_t keyboard_layout_generation;
+	/* Armed while hidden, see view_set_hidden() */
+	struct wl_event_source *trim_timer;
+	/* Last frame-done, see <core><backgroundFrameRate> */
+	int64_t last_frame_done_nsec;
+	/* Limited until activated again, see <core><commitRateLimit> */
+	bool commit_rate_exceeded;
+
+	/* Pointer to an output owned struct region, may be NULL */
+	struct region *tiled_region;
+	/* Set to region->name when tiled_region is free'd by a destroying output */
+	char *tiled_region_evacuate;
+
 	/*
 	 * Saved geometry which will be restored when the view returns
 	 * to normal/floating state after being maximized/fullscreen/
@@ -228,17 +304,24 @@ struct view {
 	 */
 	struct wlr_box last_layout_geometry;
 
-	/* used by xdg-shell views */
+	/*
+	 * The serial is only used by xdg-shell views. The timeout is
+	 * armed by both xdg-shell and XWayland views while a configure
+	 * that changes the size is in flight.
+	 */
 	uint32_t pending_configure_serial;
 	struct wl_event_source *pending_configure_timeout;
+	/* When the configure in flight was sent, see configure-stats.c */
+	int64_t configure_sent_nsec;
 
-	struct ssd *ssd;
 	struct resize_indicator {
 		int width, height;
 		struct wlr_scene_tree *tree;
 		struct wlr_scene_rect *border;
 		struct wlr_scene_rect *background;
 		struct scaled_font_buffer *text;
+		/* Currently rendered label, empty to force a render */
+		char label[32];
 	} resize_indicator;
 
 	struct foreign_toplevel {
@@ -249,6 +332,11 @@ struct view {
 		struct wl_listener activate;
 		struct wl_listener close;
 		struct wl_listener destroy;
+
+		/* See foreign_toplevel_schedule_update() */
+		uint32_t pending_updates;
+		bool activated;
+		struct wl_event_source *idle;
 	} toplevel;
 
 	struct mappable mappable;
@@ -268,6 +356,23 @@ struct view_query {
 	struct wl_list link;
 	char *identifier;
 	char *title;
+
+	/* Set up on first use by view_matches_query() */
+	struct match_pattern identifier_match;
+	struct match_pattern title_match;
+	uint32_t generation;
+	uint32_t index;
+};
+
+/*
+ * Per-view results of view_matches_query(), as bitmaps indexed by
+ * view_query.index. Dropped when the title or app_id changes.
+ */
+struct view_query_cache {
+	uint64_t *known;
+	uint64_t *matches;
+	size_t nr_words;
+	uint32_t generation;
 };
 
 struct xdg_toplevel_view {
@@ -276,6 +381,7 @@ struct xdg_toplevel_view {
 
 	/* Events unique to xdg-toplevel views */
 	struct wl_listener set_app_id;
+	struct wl_listener set_parent;
 	struct wl_listener new_popup;
 };
 
@@ -312,6 +418,14 @@ struct view *view_from_wlr_surface(struct wlr_surface *surface);
  */
 void view_query_free(struct view_query *view);
 
+/**
+ * view_queries_reset() - forget the cached results of all view queries
+ *
+ * Must be called when the view queries of the config are freed, so that
+ * the queries parsed next can reuse the cache slots.
+ */
+void view_queries_reset(void);
+
 /**
  * view_matches_query() - Check if view matches the given criteria
  * @view: View to checked.
@@ -359,6 +473,33 @@ struct view *view_next_no_head_stop(struct wl_list *head, struct view *from,
 struct view *view_prev_no_head_stop(struct wl_list *head, struct view *from,
 	enum lab_view_criteria criteria);
 
+/**
+ * for_each_view_on_output() - iterate over views on an output which match
+ * criteria, in stacking order
+ * @view: Iterator.
+ * @output: Output whose views (those with view->output == @output) to
+ *	    iterate over.
+ * @criteria: Criteria to match against.
+ */
+#define for_each_view_on_output(view, output, criteria)		\
+	for (view = view_next_on_output(output, NULL, criteria);	\
+	     view;							\
+	     view = view_next_on_output(output, view, criteria))
+
+struct view *view_next_on_output(struct output *output, struct view *view,
+	enum lab_view_criteria criteria);
+
+/*
+ * Add a new view to the top of server->views and the lists derived from it,
+ * and move it to the top or bottom of all of them
+ */
+void view_stack_add(struct view *view);
+void view_stack_raise(struct view *view);
+void view_stack_lower(struct view *view);
+
+/* Keep struct workspace.mapped_views in sync, call when mapping/unmapping */
+void view_stack_update_mapped(struct view *view);
+
 /**
  * view_array_append() - Append views that match criteria to array
  * @server: server context
@@ -385,9 +526,38 @@ struct view *view_prev_no_head_stop(struct wl_list *head, struct view *from,
 void view_array_append(struct server *server, struct wl_array *views,
 	enum lab_view_criteria criteria);
 
+/* Like view_array_append(), but in most recently focused order */
+void view_array_append_focus_history(struct server *server,
+	struct wl_array *views, enum lab_view_criteria criteria);
+
+/**
+ * view_cycle_focus_history() - next view matching @criteria after @from
+ * in most recently focused order, wrapping around
+ * @from: view to start from, or NULL to start at the ends of the list
+ * @forwards: true to go to less recently focused views
+ *
+ * Return: the found view, or @from if there is no other match
+ */
+struct view *view_cycle_focus_history(struct server *server,
+	struct view *from, enum lab_view_criteria criteria, bool forwards);
+
+/* Keep server.views_focus_history up to date, called on map and unmap */
+void view_focus_history_add(struct view *view);
+void view_focus_history_remove(struct view *view);
+
 enum view_wants_focus view_wants_focus(struct view *view);
 bool view_contains_window_type(struct view *view, enum window_type window_type);
 
+/**
+ * view_update_content_type() - pick up the content-type-v1 hint of @view
+ * Called on commit. Window rules and the adaptive sync policy are
+ * re-evaluated when the hint changes.
+ */
+void view_update_content_type(struct view *view);
+
+/* Returns true if the client hints at showing a game or video */
+bool view_shows_media(struct view *view);
+
 /**
  * view_edge_invert() - select the opposite of a provided edge
  *
@@ -438,6 +608,15 @@ void view_move_relative(struct view *view, int x, int y);
 void view_move(struct view *view, int x, int y);
 void view_move_to_cursor(struct view *view);
 void view_moved(struct view *view);
+
+/**
+ * view_flush_move_update() - catch up with an interactive move
+ * While the grabbed view is moved interactively, view_moved() only sets
+ * the position of the view and leaves output discovery, the output set
+ * and the edge index to this function, which runs from the frame
+ * handlers and before the grab ends.
+ */
+void view_flush_move_update(struct server *server);
 void view_minimize(struct view *view, bool minimized);
 bool view_compute_centered_position(struct view *view,
 	const struct wlr_box *ref, int w, int h, int *x, int *y);
@@ -470,6 +649,13 @@ void view_set_untiled(struct view *view);
 void view_maximize(struct view *view, enum view_axis axis,
 	bool store_natural_geometry);
 void view_set_fullscreen(struct view *view, bool fullscreen);
+void view_set_suspended(struct view *view, bool suspended);
+void view_set_hidden(struct view *view, bool hidden);
+/*
+ * Release the decoration buffers of a hidden view right away instead of
+ * after <core><trimHiddenViews>. Returns false if there was nothing to do.
+ */
+bool view_trim_if_hidden(struct view *view);
 void view_toggle_maximize(struct view *view, enum view_axis axis);
 void view_toggle_decorations(struct view *view);
 
@@ -483,6 +669,12 @@ void view_toggle_visible_on_all_workspaces(struct view *view);
 bool view_is_tiled(struct view *view);
 bool view_is_floating(struct view *view);
 void view_move_to_workspace(struct view *view, struct workspace *workspace);
+/*
+ * Same as view_move_to_workspace() for omnipresent views on a workspace
+ * switch, leaving occlusion and edges to be updated once by the caller
+ */
+void view_follow_workspace_switch(struct view *view,
+	struct workspace *workspace);
 void view_set_decorations(struct view *view, bool decorations);
 void view_toggle_fullscreen(struct view *view);
 void view_invalidate_last_layout_geometry(struct view *view);
@@ -498,6 +690,15 @@ void view_move_to_output(struct view *view, struct output *output);
 void view_move_to_front(struct view *view);
 void view_move_to_back(struct view *view);
 struct view *view_get_root(struct view *view);
+
+/**
+ * view_update_family() - re-link a view into the family of its root
+ * Called on map and whenever the parent of a view changes. Views below
+ * this one are moved along.
+ */
+void view_update_family(struct view *view);
+
+/* Append the mapped or minimized subviews of a root, bottom-most first */
 void view_append_children(struct view *view, struct wl_array *children);
 bool view_on_output(struct view *view, struct output *output);
 
@@ -0,0 +1,26 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_WATCHDOG_H
+#define LABWC_WATCHDOG_H
+
+/*
+ * Event loop stall watchdog, enabled by setting LABWC_WATCHDOG to a
+ * threshold in milliseconds, e.g. 16 for one frame at 60 Hz.
+ *
+ * A helper thread checks every threshold whether the current event loop
+ * dispatch has been running for longer. If so, the main thread is sent
+ * a signal which prints its backtrace to stderr, which shows the handler
+ * it is stuck in, and the flight recorder is dumped. Once the dispatch
+ * has finished, its total duration is logged and recorded as well.
+ *
+ * Disabled, marking a dispatch costs a branch.
+ */
+
+void watchdog_init(void);
+
+/* Called around each dispatch of the event loop, see server_run() */
+void watchdog_dispatch_begin(void);
+void watchdog_dispatch_end(void);
+
+void watchdog_finish(void);
+
+#endif /* LABWC_WATCHDOG_H */
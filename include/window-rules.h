@@ -3,7 +3,10 @@
 #define LABWC_WINDOW_RULES_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <wayland-util.h>
+#include "common/match.h"
 
 enum window_rule_event {
 	LAB_WINDOW_RULE_EVENT_ON_FIRST_MAP = 0,
@@ -16,6 +19,20 @@ enum property {
 	LAB_PROP_TRUE,
 };
 
+enum window_rule_property {
+	LAB_WINDOW_RULE_PROP_SERVER_DECORATION = 0,
+	LAB_WINDOW_RULE_PROP_SKIP_TASKBAR,
+	LAB_WINDOW_RULE_PROP_SKIP_WINDOW_SWITCHER,
+	LAB_WINDOW_RULE_PROP_IGNORE_FOCUS_REQUEST,
+	LAB_WINDOW_RULE_PROP_IGNORE_CONFIGURE_REQUEST,
+	LAB_WINDOW_RULE_PROP_FIXED_POSITION,
+	LAB_WINDOW_RULE_PROP_ALLOW_TEARING,
+	LAB_WINDOW_RULE_PROP_THROTTLE_FRAMES,
+	LAB_WINDOW_RULE_PROP_LIMIT_COMMIT_RATE,
+
+	LAB_WINDOW_RULE_PROP_COUNT
+};
+
 /*
  * 'identifier' represents:
  *   - 'app_id' for native Wayland windows
@@ -25,24 +42,54 @@ struct window_rule {
 	char *identifier;
 	char *title;
 	int window_type;
+	int content_type; /* enum view_content_type, -1 if unset */
 	bool match_once;
 
 	enum window_rule_event event;
 	struct wl_list actions;
 
-	enum property server_decoration;
-	enum property skip_taskbar;
-	enum property skip_window_switcher;
-	enum property ignore_focus_request;
-	enum property ignore_configure_request;
-	enum property fixed_position;
+	enum property properties[LAB_WINDOW_RULE_PROP_COUNT];
+
+	/* Set up by window_rules_compile() */
+	struct match_pattern identifier_match;
+	struct match_pattern title_match;
+	size_t index;
 
 	struct wl_list link; /* struct rcxml.window_rules */
 };
 
+/* Per-view state, see window-rules.c */
+struct window_rule_cache {
+	uint64_t *matches;
+	uint32_t generation;
+	uint32_t counted;
+	/* Bitmask of the entries of props[] which are resolved */
+	uint32_t resolved;
+	enum property props[LAB_WINDOW_RULE_PROP_COUNT];
+};
+
 struct view;
 
 void window_rules_apply(struct view *view, enum window_rule_event event);
-enum property window_rules_get_property(struct view *view, const char *property);
+enum property window_rules_get_property(struct view *view,
+	enum window_rule_property property);
+
+/*
+ * Prepare rc.window_rules for matching after the config has been loaded.
+ * Which rules match a view is cached per view; the cache is dropped
+ * with window_rules_invalidate() when the app_id, title, window type or
+ * content type of a view changes, and for all views when the rules are
+ * recompiled.
+ */
+void window_rules_compile(void);
+void window_rules_finish(void);
+void window_rules_invalidate(struct view *view);
+
+/*
+ * Called when a view is added to and removed from server->views, to keep
+ * the per-rule instance counts used for 'matchOnce' up to date.
+ */
+void window_rules_view_add(struct view *view);
+void window_rules_view_finish(struct view *view);
 
 #endif /* LABWC_WINDOW_RULES_H */
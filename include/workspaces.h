@@ -18,10 +18,21 @@ struct workspace {
 	struct server *server;
 
 	char *name;
+	/* Created on first use, see workspaces_get_tree() */
 	struct wlr_scene_tree *tree;
+	struct wl_list views; /* struct view.workspace_link */
+	/*
+	 * The mapped ones of views in stacking order, see
+	 * desktop_topmost_focusable_view()
+	 */
+	struct wl_list mapped_views; /* struct view.mapped_link */
+
+	/* Rendered OSD, one struct workspace_osd_buffer per output scale */
+	struct wl_array osd_buffers;
 };
 
 void workspaces_init(struct server *server);
+struct wlr_scene_tree *workspaces_get_tree(struct workspace *workspace);
 void workspaces_switch_to(struct workspace *target, bool update_focus);
 void workspaces_destroy(struct server *server);
 void workspaces_osd_hide(struct seat *seat);
@@ -29,4 +40,18 @@ struct workspace *workspaces_find(struct workspace *anchor, const char *name,
 	bool wrap);
 void workspaces_reconfigure(struct server *server);
 
+/*
+ * Switch workspaces by a touchpad swipe. While the fingers move, the
+ * current workspace and the one next to it slide along with them, by
+ * moving their scene trees once per frame. At the end of the swipe the
+ * neighbor is switched to if it was pulled in far enough.
+ *
+ * workspaces_swipe_begin() returns false if there is nothing to swipe to.
+ */
+bool workspaces_swipe_begin(struct server *server);
+void workspaces_swipe_update(struct server *server, double dx);
+void workspaces_swipe_end(struct server *server, bool cancelled);
+/* Called before rendering a frame */
+void workspaces_flush_swipe(struct server *server);
+
 #endif /* LABWC_WORKSPACES_H */
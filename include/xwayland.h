@@ -15,6 +15,8 @@ struct xwayland_unmanaged {
 	struct wlr_xwayland_surface *xwayland_surface;
 	struct wlr_scene_node *node;
 	struct wl_list link;
+	/* server.unmanaged_focus_candidates, empty if not a candidate */
+	struct wl_list focus_link;
 
 	struct mappable mappable;
 
@@ -36,9 +38,35 @@ struct xwayland_unmanaged {
 	bool ever_grabbed_focus;
 };
 
+/* _NET_WM_SYNC_REQUEST state of a mapped view, see xwayland-sync.c */
+struct xwayland_sync {
+	/* Sequence number of the X11 reply being waited for, 0 if none */
+	unsigned int request;
+	/* XSync counter and alarm ids, zero if unsupported by the client */
+	uint32_t counter;
+	uint32_t alarm;
+	/* Last value requested */
+	uint64_t value;
+	/* A configure waits for the counter to reach value */
+	bool pending;
+};
+
 struct xwayland_view {
 	struct view base;
 	struct wlr_xwayland_surface *xwayland_surface;
+	struct wl_list stack_link; /* server.xwayland_stack */
+	/* Used by xwayland_adjust_stacking_order() */
+	bool stack_visible;
+
+	/*
+	 * Latest geometry requested by the client. Bursts of configure
+	 * requests are collapsed and only the last one is applied, from
+	 * an idle callback.
+	 */
+	struct wlr_box requested_geometry;
+	struct wl_event_source *configure_request_idle;
+
+	struct xwayland_sync sync;
 
 	/* Events unique to XWayland views */
 	struct wl_listener associate;
@@ -48,6 +76,7 @@ struct xwayland_view {
 	struct wl_listener set_class;
 	struct wl_listener set_decorations;
 	struct wl_listener set_override_redirect;
+	struct wl_listener set_parent;
 	struct wl_listener set_strut_partial;
 	struct wl_listener set_window_type;
 	struct wl_listener focus_in;
@@ -64,10 +93,31 @@ void xwayland_unmanaged_create(struct server *server,
 void xwayland_view_create(struct server *server,
 	struct wlr_xwayland_surface *xsurface, bool mapped);
 
+/*
+ * Schedules restacking the X11 windows to match our stacking order,
+ * done once the event loop becomes idle.
+ */
 void xwayland_adjust_stacking_order(struct server *server);
 
 struct wlr_xwayland_surface *xwayland_surface_from_view(struct view *view);
 
+/* Open and close the X11 connection used for sync requests */
+void xwayland_sync_connect(struct server *server);
+void xwayland_sync_disconnect(void);
+
+/* Set up sync requests for a view on map, undone on unmap */
+void xwayland_sync_init(struct xwayland_view *xwayland_view);
+void xwayland_sync_finish(struct xwayland_view *xwayland_view);
+
+/**
+ * xwayland_sync_request() - announce a configure to the client
+ * Must be called right before the configure is sent.
+ * Return: true if the client will tell when it has redrawn, which is
+ * reported by xwayland_view_sync_done()
+ */
+bool xwayland_sync_request(struct xwayland_view *xwayland_view);
+void xwayland_view_sync_done(struct view *view);
+
 void xwayland_server_init(struct server *server,
 	struct wlr_compositor *compositor);
 void xwayland_server_finish(struct server *server);
@@ -0,0 +1,62 @@
+#!/usr/bin/env bash
+#
+# Run labwc on the headless backend, open some clients, replay the input
+# traces in scripts/bench/traces and print the compositor's frame timing,
+# input latency and CPU usage.
+#
+# Usage: scripts/bench/benchmark.sh <build-dir> [trace...]
+#
+# Requires wlrctl (virtual pointer/keyboard) and a client which keeps
+# drawing, weston-simple-shm by default.
+#
+# Environment:
+#   LABWC_BENCH_OUTPUTS  number of headless outputs (default 2)
+#   LABWC_BENCH_CLIENTS  number of clients to open (default 6)
+#   LABWC_BENCH_CLIENT   client command (default weston-simple-shm)
+
+: ${LABWC_BENCH_OUTPUTS:=2}
+: ${LABWC_BENCH_CLIENTS:=6}
+: ${LABWC_BENCH_CLIENT:=weston-simple-shm}
+
+if ! test -x "$1/labwc"; then
+	echo "$1/labwc not found"
+	exit 1
+fi
+labwc="$1/labwc"
+shift
+
+for tool in wlrctl ${LABWC_BENCH_CLIENT%% *}; do
+	if ! command -v "$tool" >/dev/null; then
+		echo "$tool not found"
+		exit 1
+	fi
+done
+
+traces=("$@")
+if test ${#traces[@]} -eq 0; then
+	traces=(scripts/bench/traces/*.trace)
+fi
+
+export XDG_RUNTIME_DIR=$(mktemp -d)
+export WLR_BACKENDS=headless
+export WLR_HEADLESS_OUTPUTS=$LABWC_BENCH_OUTPUTS
+export WLR_RENDERER=${WLR_RENDERER:-pixman}
+export LABWC_DEBUG_LATENCY=1
+export LABWC_BENCH_CLIENTS LABWC_BENCH_CLIENT
+export LABWC_BENCH_TRACES="$(realpath "${traces[@]}" | tr '\n' ' ')"
+export LABWC_BENCH_REPORT="$XDG_RUNTIME_DIR/report"
+
+log="$XDG_RUNTIME_DIR/labwc.log"
+"$labwc" -C scripts/bench >"$log" 2>&1
+ret=$?
+
+cat "$LABWC_BENCH_REPORT" 2>/dev/null
+echo
+# Everything printed by the Debug action after the scene tree
+sed -n '/^ scene nodes and buffers/,$p' "$log"
+rm -rf "$XDG_RUNTIME_DIR"
+
+if test $ret -ne 0; then
+	echo "labwc terminated with return code $ret"
+fi
+exit $ret
@@ -0,0 +1,71 @@
+#!/usr/bin/env bash
+#
+# Run via autostart when labwc is started by benchmark.sh. Opens the
+# clients, replays each trace and asks labwc to print its statistics
+# before terminating it.
+
+if test -z "$LABWC_PID"; then
+	echo "LABWC_PID not set" >&2
+	exit 1
+fi
+
+# User and system time of labwc in clock ticks
+cpu_ticks() {
+	local stat
+	read -r -a stat </proc/$LABWC_PID/stat
+	echo $((stat[13] + stat[14]))
+}
+
+ticks_per_sec=$(getconf CLK_TCK)
+
+# Trace lines are wlrctl arguments, optionally prefixed by "repeat <n>",
+# or "sleep <seconds>". Empty lines and lines starting with '#' are ignored.
+run_trace() {
+	local cmd n
+	while read -r -a cmd; do
+		case "${cmd[0]}" in
+		''|'#'*)
+			;;
+		sleep)
+			sleep "${cmd[1]}"
+			;;
+		repeat)
+			n=${cmd[1]}
+			cmd=("${cmd[@]:2}")
+			for ((i = 0; i < n; i++)); do
+				wlrctl "${cmd[@]}"
+			done
+			;;
+		*)
+			wlrctl "${cmd[@]}"
+			;;
+		esac
+	done <"$1"
+}
+
+pids=()
+for ((i = 0; i < LABWC_BENCH_CLIENTS; i++)); do
+	$LABWC_BENCH_CLIENT >/dev/null 2>&1 &
+	pids+=($!)
+done
+sleep 2
+
+{
+	printf " %-20s %10s %10s\n" "trace" "wall ms" "cpu ms"
+	for trace in $LABWC_BENCH_TRACES; do
+		start_ticks=$(cpu_ticks)
+		start_ns=$(date +%s%N)
+		run_trace "$trace"
+		wall_ms=$((($(date +%s%N) - start_ns) / 1000000))
+		cpu_ms=$((($(cpu_ticks) - start_ticks) * 1000 / ticks_per_sec))
+		printf " %-20s %10d %10d\n" "$(basename "$trace" .trace)" \
+			$wall_ms $cpu_ms
+	done
+} >"$LABWC_BENCH_REPORT"
+
+# Print statistics, see the Debug keybind in rc.xml
+wlrctl keyboard type d modifiers SUPER
+sleep 1
+
+kill "${pids[@]}" 2>/dev/null
+kill -s TERM $LABWC_PID
@@ -0,0 +1,548 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Client opening many xdg-shell toplevels and X11 windows, to find out how
+ * compositor operations scale with the number of windows.
+ *
+ * Windows can update their titles at a given total rate, acknowledge
+ * configure events with a delay, and be unmapped and mapped again in
+ * bursts. All windows show the same small buffer, so thousands of them
+ * cost next to nothing on the client side.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client.h>
+#include <xcb/xcb.h>
+#include "xdg-shell-client-protocol.h"
+
+#define BUFFER_SIZE 64
+#define NSEC_PER_MSEC 1000000LL
+#define NSEC_PER_SEC 1000000000LL
+
+struct window {
+	int index;
+	struct wl_surface *surface;
+	struct xdg_surface *xdg_surface;
+	struct xdg_toplevel *toplevel;
+	/* Whether the window should currently be shown */
+	bool shown;
+	bool ack_pending;
+	uint32_t pending_serial;
+	int64_t ack_due_nsec;
+};
+
+struct x11_window {
+	xcb_window_t id;
+	bool shown;
+};
+
+static struct {
+	/* Options */
+	int nr_windows;
+	int nr_x11_windows;
+	double title_rate;
+	int configure_delay_ms;
+	int burst_size;
+	int burst_interval_ms;
+	int runtime_sec;
+
+	struct wl_display *display;
+	struct wl_compositor *compositor;
+	struct wl_shm *shm;
+	struct xdg_wm_base *wm_base;
+	struct wl_buffer *buffer;
+	struct window *windows;
+
+	xcb_connection_t *xcb;
+	xcb_screen_t *screen;
+	struct x11_window *x11_windows;
+
+	uint64_t configures;
+	uint64_t title_updates;
+	uint64_t bursts;
+} state = {
+	.nr_windows = 100,
+	.burst_interval_ms = 1000,
+};
+
+static volatile sig_atomic_t running = 1;
+
+static int64_t
+now_nsec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void
+die(const char *msg)
+{
+	fprintf(stderr, "stress-client: %s\n", msg);
+	exit(EXIT_FAILURE);
+}
+
+static struct wl_buffer *
+create_buffer(void)
+{
+	int stride = BUFFER_SIZE * 4;
+	int size = stride * BUFFER_SIZE;
+	int fd = memfd_create("stress-client", MFD_CLOEXEC);
+	if (fd < 0 || ftruncate(fd, size) < 0) {
+		die("cannot create shm file");
+	}
+	uint32_t *pixels = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		MAP_SHARED, fd, 0);
+	if (pixels == MAP_FAILED) {
+		die("cannot map shm file");
+	}
+	for (int i = 0; i < BUFFER_SIZE * BUFFER_SIZE; i++) {
+		pixels[i] = 0xff3070a0;
+	}
+	munmap(pixels, size);
+
+	struct wl_shm_pool *pool = wl_shm_create_pool(state.shm, fd, size);
+	struct wl_buffer *buffer = wl_shm_pool_create_buffer(pool, 0,
+		BUFFER_SIZE, BUFFER_SIZE, stride, WL_SHM_FORMAT_ARGB8888);
+	wl_shm_pool_destroy(pool);
+	close(fd);
+	return buffer;
+}
+
+static void
+ack_configure(struct window *window)
+{
+	xdg_surface_ack_configure(window->xdg_surface, window->pending_serial);
+	window->ack_pending = false;
+	if (window->shown) {
+		wl_surface_attach(window->surface, state.buffer, 0, 0);
+		wl_surface_damage_buffer(window->surface, 0, 0,
+			BUFFER_SIZE, BUFFER_SIZE);
+	}
+	wl_surface_commit(window->surface);
+}
+
+static void
+handle_xdg_surface_configure(void *data, struct xdg_surface *xdg_surface,
+		uint32_t serial)
+{
+	struct window *window = data;
+	state.configures++;
+	window->pending_serial = serial;
+	window->ack_pending = true;
+	window->ack_due_nsec = now_nsec()
+		+ state.configure_delay_ms * NSEC_PER_MSEC;
+	if (!state.configure_delay_ms) {
+		ack_configure(window);
+	}
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+	.configure = handle_xdg_surface_configure,
+};
+
+static void
+handle_toplevel_configure(void *data, struct xdg_toplevel *toplevel,
+		int32_t width, int32_t height, struct wl_array *states)
+{
+	/* The buffer keeps its size, which xdg-shell allows */
+}
+
+static void window_set_shown(struct window *window, bool shown);
+
+static void
+handle_toplevel_close(void *data, struct xdg_toplevel *toplevel)
+{
+	window_set_shown(data, false);
+}
+
+static const struct xdg_toplevel_listener toplevel_listener = {
+	.configure = handle_toplevel_configure,
+	.close = handle_toplevel_close,
+};
+
+static void
+window_set_shown(struct window *window, bool shown)
+{
+	if (window->shown == shown) {
+		return;
+	}
+	window->shown = shown;
+	if (!shown) {
+		/* Unmap, mapping again needs a new initial commit */
+		window->ack_pending = false;
+		wl_surface_attach(window->surface, NULL, 0, 0);
+	}
+	wl_surface_commit(window->surface);
+}
+
+static void
+window_set_title(struct window *window)
+{
+	char title[64];
+	snprintf(title, sizeof(title), "stress %d (%llu)", window->index,
+		(unsigned long long)state.title_updates);
+	xdg_toplevel_set_title(window->toplevel, title);
+}
+
+static void
+window_create(struct window *window, int index)
+{
+	window->index = index;
+	window->surface = wl_compositor_create_surface(state.compositor);
+	window->xdg_surface =
+		xdg_wm_base_get_xdg_surface(state.wm_base, window->surface);
+	xdg_surface_add_listener(window->xdg_surface, &xdg_surface_listener,
+		window);
+	window->toplevel = xdg_surface_get_toplevel(window->xdg_surface);
+	xdg_toplevel_add_listener(window->toplevel, &toplevel_listener, window);
+	xdg_toplevel_set_app_id(window->toplevel, "labwc-stress");
+	window_set_title(window);
+	window->shown = true;
+	wl_surface_commit(window->surface);
+}
+
+static void
+handle_wm_base_ping(void *data, struct xdg_wm_base *wm_base, uint32_t serial)
+{
+	xdg_wm_base_pong(wm_base, serial);
+}
+
+static const struct xdg_wm_base_listener wm_base_listener = {
+	.ping = handle_wm_base_ping,
+};
+
+static void
+handle_global(void *data, struct wl_registry *registry, uint32_t name,
+		const char *interface, uint32_t version)
+{
+	if (!strcmp(interface, wl_compositor_interface.name)) {
+		state.compositor = wl_registry_bind(registry, name,
+			&wl_compositor_interface, 4);
+	} else if (!strcmp(interface, wl_shm_interface.name)) {
+		state.shm = wl_registry_bind(registry, name,
+			&wl_shm_interface, 1);
+	} else if (!strcmp(interface, xdg_wm_base_interface.name)) {
+		state.wm_base = wl_registry_bind(registry, name,
+			&xdg_wm_base_interface, 1);
+		xdg_wm_base_add_listener(state.wm_base, &wm_base_listener,
+			NULL);
+	}
+}
+
+static void
+handle_global_remove(void *data, struct wl_registry *registry,
+		uint32_t name)
+{
+	/* nop */
+}
+
+static const struct wl_registry_listener registry_listener = {
+	.global = handle_global,
+	.global_remove = handle_global_remove,
+};
+
+static void
+wayland_init(void)
+{
+	state.display = wl_display_connect(NULL);
+	if (!state.display) {
+		die("cannot connect to the Wayland display");
+	}
+	struct wl_registry *registry = wl_display_get_registry(state.display);
+	wl_registry_add_listener(registry, &registry_listener, NULL);
+	wl_display_roundtrip(state.display);
+	if (!state.compositor || !state.shm || !state.wm_base) {
+		die("missing wl_compositor, wl_shm or xdg_wm_base");
+	}
+
+	state.buffer = create_buffer();
+	state.windows = calloc(state.nr_windows, sizeof(*state.windows));
+	if (!state.windows) {
+		die("out of memory");
+	}
+	for (int i = 0; i < state.nr_windows; i++) {
+		window_create(&state.windows[i], i);
+	}
+}
+
+static void
+x11_set_title(struct x11_window *window, int index)
+{
+	char title[64];
+	int len = snprintf(title, sizeof(title), "stress x11 %d (%llu)", index,
+		(unsigned long long)state.title_updates);
+	xcb_change_property(state.xcb, XCB_PROP_MODE_REPLACE, window->id,
+		XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 8, len, title);
+}
+
+static void
+x11_set_shown(struct x11_window *window, bool shown)
+{
+	if (window->shown == shown) {
+		return;
+	}
+	window->shown = shown;
+	if (shown) {
+		xcb_map_window(state.xcb, window->id);
+	} else {
+		xcb_unmap_window(state.xcb, window->id);
+	}
+}
+
+static void
+x11_init(void)
+{
+	state.xcb = xcb_connect(NULL, NULL);
+	if (xcb_connection_has_error(state.xcb)) {
+		die("cannot connect to the X server");
+	}
+	state.screen = xcb_setup_roots_iterator(xcb_get_setup(state.xcb)).data;
+	state.x11_windows = calloc(state.nr_x11_windows,
+		sizeof(*state.x11_windows));
+	if (!state.x11_windows) {
+		die("out of memory");
+	}
+
+	uint32_t values[] = { state.screen->white_pixel };
+	for (int i = 0; i < state.nr_x11_windows; i++) {
+		struct x11_window *window = &state.x11_windows[i];
+		window->id = xcb_generate_id(state.xcb);
+		xcb_create_window(state.xcb, XCB_COPY_FROM_PARENT, window->id,
+			state.screen->root, 0, 0, BUFFER_SIZE, BUFFER_SIZE, 0,
+			XCB_WINDOW_CLASS_INPUT_OUTPUT,
+			state.screen->root_visual, XCB_CW_BACK_PIXEL, values);
+		x11_set_title(window, i);
+		x11_set_shown(window, true);
+	}
+	xcb_flush(state.xcb);
+}
+
+static void
+update_next_title(void)
+{
+	static int next;
+	int total = state.nr_windows + state.nr_x11_windows;
+	int index = next++ % total;
+	state.title_updates++;
+	if (index < state.nr_windows) {
+		window_set_title(&state.windows[index]);
+	} else {
+		index -= state.nr_windows;
+		x11_set_title(&state.x11_windows[index], index);
+	}
+}
+
+/* Unmap the next few shown windows, or map them if they are hidden */
+static void
+toggle_next_burst(void)
+{
+	static int next;
+	int total = state.nr_windows + state.nr_x11_windows;
+	state.bursts++;
+	for (int i = 0; i < state.burst_size && i < total; i++) {
+		int index = next++ % total;
+		if (index < state.nr_windows) {
+			struct window *window = &state.windows[index];
+			window_set_shown(window, !window->shown);
+		} else {
+			struct x11_window *window =
+				&state.x11_windows[index - state.nr_windows];
+			x11_set_shown(window, !window->shown);
+		}
+	}
+}
+
+/* Returns the time of the next pending acknowledgement, or INT64_MAX */
+static int64_t
+ack_due_configures(int64_t now)
+{
+	int64_t next = INT64_MAX;
+	for (int i = 0; i < state.nr_windows; i++) {
+		struct window *window = &state.windows[i];
+		if (!window->ack_pending) {
+			continue;
+		}
+		if (window->ack_due_nsec <= now) {
+			ack_configure(window);
+		} else if (window->ack_due_nsec < next) {
+			next = window->ack_due_nsec;
+		}
+	}
+	return next;
+}
+
+static void
+handle_signal(int signal)
+{
+	running = 0;
+}
+
+static void
+usage(void)
+{
+	printf("Usage: stress-client [options]\n"
+		"  -w <count>  xdg-shell toplevels (default 100)\n"
+		"  -x <count>  X11 windows (default 0)\n"
+		"  -t <rate>   title updates per second across all windows\n"
+		"  -d <ms>     delay before acknowledging configure events\n"
+		"  -b <count>  windows to unmap or map again in each burst\n"
+		"  -i <ms>     interval between bursts (default 1000)\n"
+		"  -r <sec>    run time, 0 runs until interrupted (default)\n");
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int c;
+	while ((c = getopt(argc, argv, "w:x:t:d:b:i:r:h")) != -1) {
+		switch (c) {
+		case 'w':
+			state.nr_windows = atoi(optarg);
+			break;
+		case 'x':
+			state.nr_x11_windows = atoi(optarg);
+			break;
+		case 't':
+			state.title_rate = atof(optarg);
+			break;
+		case 'd':
+			state.configure_delay_ms = atoi(optarg);
+			break;
+		case 'b':
+			state.burst_size = atoi(optarg);
+			break;
+		case 'i':
+			state.burst_interval_ms = atoi(optarg);
+			break;
+		case 'r':
+			state.runtime_sec = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (state.nr_windows < 0 || state.nr_x11_windows < 0
+			|| state.nr_windows + state.nr_x11_windows == 0
+			|| state.burst_interval_ms <= 0) {
+		usage();
+	}
+
+	signal(SIGINT, handle_signal);
+	signal(SIGTERM, handle_signal);
+
+	if (state.nr_windows) {
+		wayland_init();
+	}
+	if (state.nr_x11_windows) {
+		x11_init();
+	}
+
+	int64_t start = now_nsec();
+	int64_t end = state.runtime_sec
+		? start + state.runtime_sec * NSEC_PER_SEC : INT64_MAX;
+	int64_t title_interval = state.title_rate > 0
+		? (int64_t)(NSEC_PER_SEC / state.title_rate) : 0;
+	int64_t next_title = title_interval ? start + title_interval : INT64_MAX;
+	int64_t next_burst = state.burst_size
+		? start + state.burst_interval_ms * NSEC_PER_MSEC : INT64_MAX;
+
+	while (running) {
+		int64_t now = now_nsec();
+		if (now >= end) {
+			break;
+		}
+		while (now >= next_title) {
+			update_next_title();
+			next_title += title_interval;
+		}
+		if (now >= next_burst) {
+			toggle_next_burst();
+			next_burst += state.burst_interval_ms * NSEC_PER_MSEC;
+		}
+		int64_t next = end;
+		next = next_title < next ? next_title : next;
+		next = next_burst < next ? next_burst : next;
+		if (state.display) {
+			int64_t next_ack = ack_due_configures(now);
+			next = next_ack < next ? next_ack : next;
+		}
+
+		int timeout = -1;
+		if (next != INT64_MAX) {
+			timeout = (next - now + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC;
+		}
+
+		struct pollfd fds[2];
+		int nfds = 0;
+		if (state.display) {
+			while (wl_display_prepare_read(state.display) != 0) {
+				wl_display_dispatch_pending(state.display);
+			}
+			wl_display_flush(state.display);
+			fds[nfds++] = (struct pollfd){
+				.fd = wl_display_get_fd(state.display),
+				.events = POLLIN,
+			};
+		}
+		if (state.xcb) {
+			xcb_flush(state.xcb);
+			fds[nfds++] = (struct pollfd){
+				.fd = xcb_get_file_descriptor(state.xcb),
+				.events = POLLIN,
+			};
+		}
+
+		int ret = poll(fds, nfds, timeout);
+		if (ret < 0 && errno != EINTR) {
+			die("poll failed");
+		}
+		if (state.display) {
+			if (ret > 0 && (fds[0].revents & POLLIN)) {
+				if (wl_display_read_events(state.display) < 0) {
+					die("lost the Wayland connection");
+				}
+			} else {
+				wl_display_cancel_read(state.display);
+			}
+			if (wl_display_dispatch_pending(state.display) < 0) {
+				die("lost the Wayland connection");
+			}
+		}
+		if (state.xcb) {
+			xcb_generic_event_t *event;
+			while ((event = xcb_poll_for_event(state.xcb))) {
+				free(event);
+			}
+			if (xcb_connection_has_error(state.xcb)) {
+				die("lost the X11 connection");
+			}
+		}
+	}
+
+	double seconds = (double)(now_nsec() - start) / NSEC_PER_SEC;
+	printf("%.1f s: %llu configures, %llu title updates, %llu bursts\n",
+		seconds, (unsigned long long)state.configures,
+		(unsigned long long)state.title_updates,
+		(unsigned long long)state.bursts);
+
+	if (state.xcb) {
+		xcb_disconnect(state.xcb);
+	}
+	if (state.display) {
+		wl_display_disconnect(state.display);
+	}
+	return EXIT_SUCCESS;
+}
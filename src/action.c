@@ -7,20 +7,26 @@
 #include <unistd.h>
 #include <wlr/util/log.h>
 #include "action.h"
+#include "common/arena.h"
 #include "common/macros.h"
 #include "common/list.h"
+#include "common/log.h"
 #include "common/mem.h"
 #include "common/parse-bool.h"
 #include "common/spawn.h"
 #include "common/string-helpers.h"
+#include "common/trace.h"
 #include "debug.h"
+#include "flight-recorder.h"
 #include "labwc.h"
 #include "menu/menu.h"
 #include "osd.h"
 #include "output-virtual.h"
+#include "perf-hud.h"
 #include "placement.h"
 #include "regions.h"
 #include "ssd.h"
+#include "transaction.h"
 #include "view.h"
 #include "workspaces.h"
 
@@ -32,10 +38,75 @@ enum action_arg_type {
 	LAB_ACTION_ARG_ACTION_LIST,
 };
 
-struct action_arg {
-	struct wl_list link;        /* struct action.args */
+/*
+ * Every argument key known to any action. Arguments are looked up by key
+ * in actions_run() for each execution, so they are stored in a per-action
+ * table indexed by this enum rather than being matched by name.
+ */
+enum action_arg_key {
+	ACTION_KEY_INVALID = -1,
+	ACTION_KEY_COMMAND = 0,
+	ACTION_KEY_DIRECTION,
+	ACTION_KEY_SNAP_WINDOWS,
+	ACTION_KEY_MENU,
+	ACTION_KEY_AT_CURSOR,
+	ACTION_KEY_LEFT,
+	ACTION_KEY_RIGHT,
+	ACTION_KEY_TOP,
+	ACTION_KEY_BOTTOM,
+	ACTION_KEY_X,
+	ACTION_KEY_Y,
+	ACTION_KEY_WIDTH,
+	ACTION_KEY_HEIGHT,
+	ACTION_KEY_FOLLOW,
+	ACTION_KEY_TO,
+	ACTION_KEY_WRAP,
+	ACTION_KEY_REGION,
+	ACTION_KEY_OUTPUT,
+	ACTION_KEY_MAX_REFRESH,
+	ACTION_KEY_RENDER_ON_DAMAGE,
+	ACTION_KEY_OUTPUT_NAME,
+	ACTION_KEY_QUERY,
+	ACTION_KEY_THEN,
+	ACTION_KEY_ELSE,
+	ACTION_KEY_NONE,
+
+	ACTION_KEY_COUNT
+};
+
+static const char * const action_key_names[] = {
+	[ACTION_KEY_COMMAND] = "command",
+	[ACTION_KEY_DIRECTION] = "direction",
+	[ACTION_KEY_SNAP_WINDOWS] = "snapWindows",
+	[ACTION_KEY_MENU] = "menu",
+	[ACTION_KEY_AT_CURSOR] = "atCursor",
+	[ACTION_KEY_LEFT] = "left",
+	[ACTION_KEY_RIGHT] = "right",
+	[ACTION_KEY_TOP] = "top",
+	[ACTION_KEY_BOTTOM] = "bottom",
+	[ACTION_KEY_X] = "x",
+	[ACTION_KEY_Y] = "y",
+	[ACTION_KEY_WIDTH] = "width",
+	[ACTION_KEY_HEIGHT] = "height",
+	[ACTION_KEY_FOLLOW] = "follow",
+	[ACTION_KEY_TO] = "to",
+	[ACTION_KEY_WRAP] = "wrap",
+	[ACTION_KEY_REGION] = "region",
+	[ACTION_KEY_OUTPUT] = "output",
+	[ACTION_KEY_MAX_REFRESH] = "max_refresh",
+	[ACTION_KEY_RENDER_ON_DAMAGE] = "render_on_damage",
+	[ACTION_KEY_OUTPUT_NAME] = "output_name",
+	[ACTION_KEY_QUERY] = "query",
+	[ACTION_KEY_THEN] = "then",
+	[ACTION_KEY_ELSE] = "else",
+	[ACTION_KEY_NONE] = "none",
+};
 
-	char *key;                  /* May be NULL if there is just one arg */
+static_assert(ARRAY_SIZE(action_key_names) == ACTION_KEY_COUNT,
+	"action_key_names out of sync with enum action_arg_key");
+
+struct action_arg {
+	enum action_arg_key key;
 	enum action_arg_type type;
 };
 
@@ -110,6 +181,7 @@ enum action_type {
 	ACTION_TYPE_SHADE,
 	ACTION_TYPE_UNSHADE,
 	ACTION_TYPE_TOGGLE_SHADE,
+	ACTION_TYPE_TOGGLE_PERFORMANCE_HUD,
 };
 
 const char *action_names[] = {
@@ -163,56 +235,103 @@ const char *action_names[] = {
 	"Shade",
 	"Unshade",
 	"ToggleShade",
+	"TogglePerformanceHud",
 	NULL
 };
 
-void
-action_arg_add_str(struct action *action, const char *key, const char *value)
+static enum action_arg_key
+action_key_from_str(const char *key)
 {
-	assert(action);
 	assert(key);
+	for (size_t i = 0; i < ACTION_KEY_COUNT; i++) {
+		if (!strcasecmp(key, action_key_names[i])) {
+			return i;
+		}
+	}
+	return ACTION_KEY_INVALID;
+}
+
+static void arg_free(struct action_arg *arg);
+
+/* Takes ownership of arg; the first argument given for a key wins */
+static void
+action_arg_insert(struct action *action, struct action_arg *arg)
+{
+	assert(action);
+	assert(arg->key > ACTION_KEY_INVALID && arg->key < ACTION_KEY_COUNT);
+	if (!action->args) {
+		action->args = arena_new_n(action->arena, struct action_arg *,
+			ACTION_KEY_COUNT);
+	}
+	if (action->args[arg->key]) {
+		wlr_log(WLR_DEBUG, "Ignoring duplicate argument for action %s: '%s'",
+			action_names[action->type], action_key_names[arg->key]);
+		if (!action->arena) {
+			arg_free(arg);
+		}
+		return;
+	}
+	action->args[arg->key] = arg;
+}
+
+static void
+action_arg_add_str_by_key(struct action *action, enum action_arg_key key,
+		const char *value)
+{
 	assert(value && "Tried to add NULL action string argument");
-	struct action_arg_str *arg = znew(*arg);
+	struct action_arg_str *arg = arena_new(action->arena, *arg);
 	arg->base.type = LAB_ACTION_ARG_STR;
-	arg->base.key = xstrdup(key);
-	arg->value = xstrdup(value);
-	wl_list_append(&action->args, &arg->base.link);
+	arg->base.key = key;
+	arg->value = arena_strdup(action->arena, value);
+	action_arg_insert(action, &arg->base);
+}
+
+void
+action_arg_add_str(struct action *action, const char *key, const char *value)
+{
+	enum action_arg_key k = action_key_from_str(key);
+	if (k == ACTION_KEY_INVALID) {
+		wlr_log(WLR_ERROR, "Invalid argument for action %s: '%s'",
+			action_names[action->type], key);
+		return;
+	}
+	action_arg_add_str_by_key(action, k, value);
 }
 
 static void
-action_arg_add_bool(struct action *action, const char *key, bool value)
+action_arg_add_bool(struct action *action, enum action_arg_key key, bool value)
 {
-	assert(action);
-	assert(key);
-	struct action_arg_bool *arg = znew(*arg);
+	struct action_arg_bool *arg = arena_new(action->arena, *arg);
 	arg->base.type = LAB_ACTION_ARG_BOOL;
-	arg->base.key = xstrdup(key);
+	arg->base.key = key;
 	arg->value = value;
-	wl_list_append(&action->args, &arg->base.link);
+	action_arg_insert(action, &arg->base);
 }
 
 static void
-action_arg_add_int(struct action *action, const char *key, int value)
+action_arg_add_int(struct action *action, enum action_arg_key key, int value)
 {
-	assert(action);
-	assert(key);
-	struct action_arg_int *arg = znew(*arg);
+	struct action_arg_int *arg = arena_new(action->arena, *arg);
 	arg->base.type = LAB_ACTION_ARG_INT;
-	arg->base.key = xstrdup(key);
+	arg->base.key = key;
 	arg->value = value;
-	wl_list_append(&action->args, &arg->base.link);
+	action_arg_insert(action, &arg->base);
 }
 
 static void
 action_arg_add_list(struct action *action, const char *key, enum action_arg_type type)
 {
-	assert(action);
-	assert(key);
-	struct action_arg_list *arg = znew(*arg);
+	enum action_arg_key k = action_key_from_str(key);
+	if (k == ACTION_KEY_INVALID) {
+		wlr_log(WLR_ERROR, "Invalid argument for action %s: '%s'",
+			action_names[action->type], key);
+		return;
+	}
+	struct action_arg_list *arg = arena_new(action->arena, *arg);
 	arg->base.type = type;
-	arg->base.key = xstrdup(key);
+	arg->base.key = k;
 	wl_list_init(&arg->value);
-	wl_list_append(&action->args, &arg->base.link);
+	action_arg_insert(action, &arg->base);
 }
 
 void
@@ -228,52 +347,62 @@ action_arg_add_actionlist(struct action *action, const char *key)
 }
 
 static void *
-action_get_arg(struct action *action, const char *key, enum action_arg_type type)
+action_get_arg(struct action *action, enum action_arg_key key, enum action_arg_type type)
 {
 	assert(action);
-	assert(key);
-	struct action_arg *arg;
-	wl_list_for_each(arg, &action->args, link) {
-		if (!strcasecmp(key, arg->key) && arg->type == type) {
-			return arg;
-		}
+	if (!action->args) {
+		return NULL;
 	}
-	return NULL;
+	struct action_arg *arg = action->args[key];
+	return arg && arg->type == type ? arg : NULL;
 }
 
 static const char *
-action_get_str(struct action *action, const char *key, const char *default_value)
+action_get_str(struct action *action, enum action_arg_key key, const char *default_value)
 {
 	struct action_arg_str *arg = action_get_arg(action, key, LAB_ACTION_ARG_STR);
 	return arg ? arg->value : default_value;
 }
 
 static bool
-action_get_bool(struct action *action, const char *key, bool default_value)
+action_get_bool(struct action *action, enum action_arg_key key, bool default_value)
 {
 	struct action_arg_bool *arg = action_get_arg(action, key, LAB_ACTION_ARG_BOOL);
 	return arg ? arg->value : default_value;
 }
 
 static int
-action_get_int(struct action *action, const char *key, int default_value)
+action_get_int(struct action *action, enum action_arg_key key, int default_value)
 {
 	struct action_arg_int *arg = action_get_arg(action, key, LAB_ACTION_ARG_INT);
 	return arg ? arg->value : default_value;
 }
 
+static struct wl_list *
+action_get_list(struct action *action, enum action_arg_key key, enum action_arg_type type)
+{
+	struct action_arg_list *arg = action_get_arg(action, key, type);
+	return arg ? &arg->value : NULL;
+}
+
 struct wl_list *
 action_get_querylist(struct action *action, const char *key)
 {
-	struct action_arg_list *arg = action_get_arg(action, key, LAB_ACTION_ARG_QUERY_LIST);
-	return arg ? &arg->value : NULL;
+	enum action_arg_key k = action_key_from_str(key);
+	if (k == ACTION_KEY_INVALID) {
+		return NULL;
+	}
+	return action_get_list(action, k, LAB_ACTION_ARG_QUERY_LIST);
 }
 
 struct wl_list *
 action_get_actionlist(struct action *action, const char *key)
 {
-	struct action_arg_list *arg = action_get_arg(action, key, LAB_ACTION_ARG_ACTION_LIST);
-	return arg ? &arg->value : NULL;
+	enum action_arg_key k = action_key_from_str(key);
+	if (k == ACTION_KEY_INVALID) {
+		return NULL;
+	}
+	return action_get_list(action, k, LAB_ACTION_ARG_ACTION_LIST);
 }
 
 void
@@ -292,13 +421,14 @@ action_arg_from_xml_node(struct action *action, const char *nodename, const char
 		 * compatibility with old openbox-menu generators
 		 */
 		if (!strcmp(argument, "command") || !strcmp(argument, "execute")) {
-			action_arg_add_str(action, "command", content);
+			action_arg_add_str_by_key(action, ACTION_KEY_COMMAND, content);
 			goto cleanup;
 		}
 		break;
 	case ACTION_TYPE_MOVE_TO_EDGE:
 		if (!strcasecmp(argument, "snapWindows")) {
-			action_arg_add_bool(action, argument, parse_bool(content, true));
+			action_arg_add_bool(action, ACTION_KEY_SNAP_WINDOWS,
+				parse_bool(content, true));
 			goto cleanup;
 		}
 		/* Falls through */
@@ -312,18 +442,19 @@ action_arg_from_xml_node(struct action *action, const char *nodename, const char
 				wlr_log(WLR_ERROR, "Invalid argument for action %s: '%s' (%s)",
 					action_names[action->type], argument, content);
 			} else {
-				action_arg_add_int(action, argument, edge);
+				action_arg_add_int(action, ACTION_KEY_DIRECTION, edge);
 			}
 			goto cleanup;
 		}
 		break;
 	case ACTION_TYPE_SHOW_MENU:
 		if (!strcmp(argument, "menu")) {
-			action_arg_add_str(action, argument, content);
+			action_arg_add_str_by_key(action, ACTION_KEY_MENU, content);
 			goto cleanup;
 		}
 		if (!strcasecmp(argument, "atCursor")) {
-			action_arg_add_bool(action, argument, parse_bool(content, true));
+			action_arg_add_bool(action, ACTION_KEY_AT_CURSOR,
+				parse_bool(content, true));
 			goto cleanup;
 		}
 		break;
@@ -335,7 +466,7 @@ action_arg_from_xml_node(struct action *action, const char *nodename, const char
 				wlr_log(WLR_ERROR, "Invalid argument for action %s: '%s' (%s)",
 					action_names[action->type], argument, content);
 			} else {
-				action_arg_add_int(action, argument, axis);
+				action_arg_add_int(action, ACTION_KEY_DIRECTION, axis);
 			}
 			goto cleanup;
 		}
@@ -343,54 +474,59 @@ action_arg_from_xml_node(struct action *action, const char *nodename, const char
 	case ACTION_TYPE_RESIZE_RELATIVE:
 		if (!strcmp(argument, "left") || !strcmp(argument, "right") ||
 				!strcmp(argument, "top") || !strcmp(argument, "bottom")) {
-			action_arg_add_int(action, argument, atoi(content));
+			action_arg_add_int(action, action_key_from_str(argument),
+				atoi(content));
 			goto cleanup;
 		}
 		break;
 	case ACTION_TYPE_MOVETO:
 	case ACTION_TYPE_MOVE_RELATIVE:
 		if (!strcmp(argument, "x") || !strcmp(argument, "y")) {
-			action_arg_add_int(action, argument, atoi(content));
+			action_arg_add_int(action, action_key_from_str(argument),
+				atoi(content));
 			goto cleanup;
 		}
 		break;
 	case ACTION_TYPE_RESIZETO:
 		if (!strcmp(argument, "width") || !strcmp(argument, "height")) {
-			action_arg_add_int(action, argument, atoi(content));
+			action_arg_add_int(action, action_key_from_str(argument),
+				atoi(content));
 			goto cleanup;
 		}
 		break;
 	case ACTION_TYPE_SEND_TO_DESKTOP:
 		if (!strcmp(argument, "follow")) {
-			action_arg_add_bool(action, argument, parse_bool(content, true));
+			action_arg_add_bool(action, ACTION_KEY_FOLLOW,
+				parse_bool(content, true));
 			goto cleanup;
 		}
 		/* Falls through to GoToDesktop */
 	case ACTION_TYPE_GO_TO_DESKTOP:
 		if (!strcmp(argument, "to")) {
-			action_arg_add_str(action, argument, content);
+			action_arg_add_str_by_key(action, ACTION_KEY_TO, content);
 			goto cleanup;
 		}
 		if (!strcmp(argument, "wrap")) {
-			action_arg_add_bool(action, argument, parse_bool(content, true));
+			action_arg_add_bool(action, ACTION_KEY_WRAP,
+				parse_bool(content, true));
 			goto cleanup;
 		}
 		break;
 	case ACTION_TYPE_SNAP_TO_REGION:
 		if (!strcmp(argument, "region")) {
-			action_arg_add_str(action, argument, content);
+			action_arg_add_str_by_key(action, ACTION_KEY_REGION, content);
 			goto cleanup;
 		}
 		break;
 	case ACTION_TYPE_FOCUS_OUTPUT:
 		if (!strcmp(argument, "output")) {
-			action_arg_add_str(action, argument, content);
+			action_arg_add_str_by_key(action, ACTION_KEY_OUTPUT, content);
 			goto cleanup;
 		}
 		break;
 	case ACTION_TYPE_MOVE_TO_OUTPUT:
 		if (!strcmp(argument, "output")) {
-			action_arg_add_str(action, argument, content);
+			action_arg_add_str_by_key(action, ACTION_KEY_OUTPUT, content);
 			goto cleanup;
 		}
 		if (!strcmp(argument, "direction")) {
@@ -399,19 +535,30 @@ action_arg_from_xml_node(struct action *action, const char *nodename, const char
 				wlr_log(WLR_ERROR, "Invalid argument for action %s: '%s' (%s)",
 					action_names[action->type], argument, content);
 			} else {
-				action_arg_add_int(action, argument, edge);
+				action_arg_add_int(action, ACTION_KEY_DIRECTION, edge);
 			}
 			goto cleanup;
 		}
 		if (!strcmp(argument, "wrap")) {
-			action_arg_add_bool(action, argument, parse_bool(content, false));
+			action_arg_add_bool(action, ACTION_KEY_WRAP,
+				parse_bool(content, false));
 			goto cleanup;
 		}
 		break;
 	case ACTION_TYPE_VIRTUAL_OUTPUT_ADD:
+		if (!strcmp(argument, "max_refresh")) {
+			action_arg_add_int(action, ACTION_KEY_MAX_REFRESH, atoi(content));
+			goto cleanup;
+		}
+		if (!strcmp(argument, "render_on_damage")) {
+			action_arg_add_bool(action, ACTION_KEY_RENDER_ON_DAMAGE,
+				parse_bool(content, false));
+			goto cleanup;
+		}
+		/* Falls through to VirtualOutputRemove */
 	case ACTION_TYPE_VIRTUAL_OUTPUT_REMOVE:
 		if (!strcmp(argument, "output_name")) {
-			action_arg_add_str(action, argument, content);
+			action_arg_add_str_by_key(action, ACTION_KEY_OUTPUT_NAME, content);
 			goto cleanup;
 		}
 		break;
@@ -437,7 +584,7 @@ action_type_from_str(const char *action_name)
 }
 
 struct action *
-action_create(const char *action_name)
+action_create(struct arena *arena, const char *action_name)
 {
 	if (!action_name) {
 		wlr_log(WLR_ERROR, "action name not specified");
@@ -449,9 +596,9 @@ action_create(const char *action_name)
 		return NULL;
 	}
 
-	struct action *action = znew(*action);
+	struct action *action = arena_new(arena, *action);
 	action->type = action_type;
-	wl_list_init(&action->args);
+	action->arena = arena;
 	return action;
 }
 
@@ -485,42 +632,46 @@ action_list_is_valid(struct wl_list *actions)
 bool
 action_is_valid(struct action *action)
 {
-	const char *arg_name = NULL;
+	enum action_arg_key arg_key = ACTION_KEY_INVALID;
 	enum action_arg_type arg_type = LAB_ACTION_ARG_STR;
 
 	switch (action->type) {
 	case ACTION_TYPE_EXECUTE:
-		arg_name = "command";
+		arg_key = ACTION_KEY_COMMAND;
 		break;
 	case ACTION_TYPE_MOVE_TO_EDGE:
 	case ACTION_TYPE_SNAP_TO_EDGE:
 	case ACTION_TYPE_GROW_TO_EDGE:
 	case ACTION_TYPE_SHRINK_TO_EDGE:
-		arg_name = "direction";
+		arg_key = ACTION_KEY_DIRECTION;
 		arg_type = LAB_ACTION_ARG_INT;
 		break;
 	case ACTION_TYPE_SHOW_MENU:
-		arg_name = "menu";
+		arg_key = ACTION_KEY_MENU;
 		break;
 	case ACTION_TYPE_GO_TO_DESKTOP:
 	case ACTION_TYPE_SEND_TO_DESKTOP:
-		arg_name = "to";
+		arg_key = ACTION_KEY_TO;
 		break;
 	case ACTION_TYPE_SNAP_TO_REGION:
-		arg_name = "region";
+		arg_key = ACTION_KEY_REGION;
 		break;
 	case ACTION_TYPE_FOCUS_OUTPUT:
-		arg_name = "output";
+		arg_key = ACTION_KEY_OUTPUT;
 		break;
 	case ACTION_TYPE_IF:
 	case ACTION_TYPE_FOR_EACH:
 		; /* works around "a label can only be part of a statement" */
-		static const char * const branches[] = { "then", "else", "none" };
+		static const enum action_arg_key branches[] = {
+			ACTION_KEY_THEN, ACTION_KEY_ELSE, ACTION_KEY_NONE
+		};
 		for (size_t i = 0; i < ARRAY_SIZE(branches); i++) {
-			struct wl_list *children = action_get_actionlist(action, branches[i]);
+			struct wl_list *children = action_get_list(action,
+				branches[i], LAB_ACTION_ARG_ACTION_LIST);
 			if (children && !action_list_is_valid(children)) {
 				wlr_log(WLR_ERROR, "Invalid action in %s '%s' branch",
-					action_names[action->type], branches[i]);
+					action_names[action->type],
+					action_key_names[branches[i]]);
 				return false;
 			}
 		}
@@ -530,37 +681,50 @@ action_is_valid(struct action *action)
 		return true;
 	}
 
-	if (action_get_arg(action, arg_name, arg_type)) {
+	if (action_get_arg(action, arg_key, arg_type)) {
 		return true;
 	}
 
 	wlr_log(WLR_ERROR, "Missing required argument for %s: %s",
-		action_names[action->type], arg_name);
+		action_names[action->type], action_key_names[arg_key]);
 	return false;
 }
 
+static void
+arg_free(struct action_arg *arg)
+{
+	if (arg->type == LAB_ACTION_ARG_STR) {
+		struct action_arg_str *str_arg = (struct action_arg_str *)arg;
+		zfree(str_arg->value);
+	} else if (arg->type == LAB_ACTION_ARG_ACTION_LIST) {
+		struct action_arg_list *list_arg = (struct action_arg_list *)arg;
+		action_list_free(&list_arg->value);
+	} else if (arg->type == LAB_ACTION_ARG_QUERY_LIST) {
+		struct action_arg_list *list_arg = (struct action_arg_list *)arg;
+		struct view_query *elm, *next;
+		wl_list_for_each_safe(elm, next, &list_arg->value, link) {
+			view_query_free(elm);
+		}
+	}
+	zfree(arg);
+}
+
 void
 action_free(struct action *action)
 {
+	/* Arena actions are freed together with their arena */
+	if (action->arena) {
+		return;
+	}
+
 	/* Free args */
-	struct action_arg *arg, *arg_tmp;
-	wl_list_for_each_safe(arg, arg_tmp, &action->args, link) {
-		wl_list_remove(&arg->link);
-		zfree(arg->key);
-		if (arg->type == LAB_ACTION_ARG_STR) {
-			struct action_arg_str *str_arg = (struct action_arg_str *)arg;
-			zfree(str_arg->value);
-		} else if (arg->type == LAB_ACTION_ARG_ACTION_LIST) {
-			struct action_arg_list *list_arg = (struct action_arg_list *)arg;
-			action_list_free(&list_arg->value);
-		} else if (arg->type == LAB_ACTION_ARG_QUERY_LIST) {
-			struct action_arg_list *list_arg = (struct action_arg_list *)arg;
-			struct view_query *elm, *next;
-			wl_list_for_each_safe(elm, next, &list_arg->value, link) {
-				view_query_free(elm);
+	if (action->args) {
+		for (size_t i = 0; i < ACTION_KEY_COUNT; i++) {
+			if (action->args[i]) {
+				arg_free(action->args[i]);
 			}
 		}
-		zfree(arg);
+		zfree(action->args);
 	}
 	zfree(action);
 }
@@ -641,40 +805,48 @@ run_if_action(struct view *view, struct server *server, struct action *action)
 {
 	struct view_query *query;
 	struct wl_list *queries, *actions;
-	const char *branch = "then";
+	enum action_arg_key branch = ACTION_KEY_THEN;
 
-	queries = action_get_querylist(action, "query");
+	queries = action_get_list(action, ACTION_KEY_QUERY, LAB_ACTION_ARG_QUERY_LIST);
 	if (queries) {
-		branch = "else";
+		branch = ACTION_KEY_ELSE;
 		/* All queries are OR'ed */
 		wl_list_for_each(query, queries, link) {
 			if (view_matches_query(view, query)) {
-				branch = "then";
+				branch = ACTION_KEY_THEN;
 				break;
 			}
 		}
 	}
 
-	actions = action_get_actionlist(action, branch);
+	actions = action_get_list(action, branch, LAB_ACTION_ARG_ACTION_LIST);
 	if (actions) {
 		actions_run(view, server, actions, 0);
 	}
-	return !strcmp(branch, "then");
+	return branch == ACTION_KEY_THEN;
 }
 
 void
 actions_run(struct view *activator, struct server *server,
 	struct wl_list *actions, uint32_t resize_edges)
 {
+	TRACE_FUNC();
 	if (!actions) {
 		wlr_log(WLR_ERROR, "empty actions");
 		return;
 	}
 
+	/*
+	 * Present the views changed by the whole list, including nested
+	 * If and ForEach lists, in one frame. Restacking, focus and
+	 * occlusion updates are deferred to the idle callbacks anyway.
+	 */
+	transaction_begin(server);
+
 	struct view *view;
 	struct action *action;
 	wl_list_for_each(action, actions, link) {
-		wlr_log(WLR_DEBUG, "Handling action %u: %s", action->type,
+		lab_log_debug("Handling action %u: %s", action->type,
 			action_names[action->type]);
 
 		/*
@@ -683,6 +855,8 @@ actions_run(struct view *activator, struct server *server,
 		 */
 		view = view_for_action(activator, server, action,
 			&resize_edges);
+		flight_record(FLIGHT_EVENT_ACTION, action->type, (uintptr_t)view,
+			flight_recorder_string(action_names[action->type]));
 
 		switch (action->type) {
 		case ACTION_TYPE_CLOSE:
@@ -704,31 +878,34 @@ actions_run(struct view *activator, struct server *server,
 			break;
 		case ACTION_TYPE_DEBUG:
 			debug_dump_scene(server);
+			debug_dump_scene_stats(server);
+			debug_dump_output_stats(server);
+			flight_recorder_save("Debug action");
 			break;
 		case ACTION_TYPE_EXECUTE:
 			{
 				struct buf cmd = BUF_INIT;
-				buf_add(&cmd, action_get_str(action, "command", NULL));
+				buf_add(&cmd, action_get_str(action, ACTION_KEY_COMMAND, NULL));
 				buf_expand_tilde(&cmd);
 				spawn_async_no_shell(cmd.data);
 				buf_reset(&cmd);
 			}
 			break;
 		case ACTION_TYPE_EXIT:
-			wl_display_terminate(server->wl_display);
+			server_terminate(server);
 			break;
 		case ACTION_TYPE_MOVE_TO_EDGE:
 			if (view) {
 				/* Config parsing makes sure that direction is a valid direction */
-				enum view_edge edge = action_get_int(action, "direction", 0);
-				bool snap_to_windows = action_get_bool(action, "snapWindows", true);
+				enum view_edge edge = action_get_int(action, ACTION_KEY_DIRECTION, 0);
+				bool snap_to_windows = action_get_bool(action, ACTION_KEY_SNAP_WINDOWS, true);
 				view_move_to_edge(view, edge, snap_to_windows);
 			}
 			break;
 		case ACTION_TYPE_SNAP_TO_EDGE:
 			if (view) {
 				/* Config parsing makes sure that direction is a valid direction */
-				enum view_edge edge = action_get_int(action, "direction", 0);
+				enum view_edge edge = action_get_int(action, ACTION_KEY_DIRECTION, 0);
 				view_snap_to_edge(view, edge,
 					/*across_outputs*/ true,
 					/*store_natural_geometry*/ true);
@@ -737,14 +914,14 @@ actions_run(struct view *activator, struct server *server,
 		case ACTION_TYPE_GROW_TO_EDGE:
 			if (view) {
 				/* Config parsing makes sure that direction is a valid direction */
-				enum view_edge edge = action_get_int(action, "direction", 0);
+				enum view_edge edge = action_get_int(action, ACTION_KEY_DIRECTION, 0);
 				view_grow_to_edge(view, edge);
 			}
 			break;
 		case ACTION_TYPE_SHRINK_TO_EDGE:
 			if (view) {
 				/* Config parsing makes sure that direction is a valid direction */
-				enum view_edge edge = action_get_int(action, "direction", 0);
+				enum view_edge edge = action_get_int(action, ACTION_KEY_DIRECTION, 0);
 				view_shrink_to_edge(view, edge);
 			}
 			break;
@@ -763,20 +940,20 @@ actions_run(struct view *activator, struct server *server,
 			break;
 		case ACTION_TYPE_SHOW_MENU:
 			show_menu(server, view,
-				action_get_str(action, "menu", NULL),
-				action_get_bool(action, "atCursor", true));
+				action_get_str(action, ACTION_KEY_MENU, NULL),
+				action_get_bool(action, ACTION_KEY_AT_CURSOR, true));
 			break;
 		case ACTION_TYPE_TOGGLE_MAXIMIZE:
 			if (view) {
 				enum view_axis axis = action_get_int(action,
-					"direction", VIEW_AXIS_BOTH);
+					ACTION_KEY_DIRECTION, VIEW_AXIS_BOTH);
 				view_toggle_maximize(view, axis);
 			}
 			break;
 		case ACTION_TYPE_MAXIMIZE:
 			if (view) {
 				enum view_axis axis = action_get_int(action,
-					"direction", VIEW_AXIS_BOTH);
+					ACTION_KEY_DIRECTION, VIEW_AXIS_BOTH);
 				view_maximize(view, axis,
 					/*store_natural_geometry*/ true);
 			}
@@ -842,24 +1019,24 @@ actions_run(struct view *activator, struct server *server,
 			break;
 		case ACTION_TYPE_RESIZE_RELATIVE:
 			if (view) {
-				int left = action_get_int(action, "left", 0);
-				int right = action_get_int(action, "right", 0);
-				int top = action_get_int(action, "top", 0);
-				int bottom = action_get_int(action, "bottom", 0);
+				int left = action_get_int(action, ACTION_KEY_LEFT, 0);
+				int right = action_get_int(action, ACTION_KEY_RIGHT, 0);
+				int top = action_get_int(action, ACTION_KEY_TOP, 0);
+				int bottom = action_get_int(action, ACTION_KEY_BOTTOM, 0);
 				view_resize_relative(view, left, right, top, bottom);
 			}
 			break;
 		case ACTION_TYPE_MOVETO:
 			if (view) {
-				int x = action_get_int(action, "x", 0);
-				int y = action_get_int(action, "y", 0);
+				int x = action_get_int(action, ACTION_KEY_X, 0);
+				int y = action_get_int(action, ACTION_KEY_Y, 0);
 				view_move(view, x, y);
 			}
 			break;
 		case ACTION_TYPE_RESIZETO:
 			if (view) {
-				int width = action_get_int(action, "width", 0);
-				int height = action_get_int(action, "height", 0);
+				int width = action_get_int(action, ACTION_KEY_WIDTH, 0);
+				int height = action_get_int(action, ACTION_KEY_HEIGHT, 0);
 
 				/*
 				 * To support only setting one of width/height
@@ -878,8 +1055,8 @@ actions_run(struct view *activator, struct server *server,
 			break;
 		case ACTION_TYPE_MOVE_RELATIVE:
 			if (view) {
-				int x = action_get_int(action, "x", 0);
-				int y = action_get_int(action, "y", 0);
+				int x = action_get_int(action, ACTION_KEY_X, 0);
+				int y = action_get_int(action, ACTION_KEY_Y, 0);
 				view_move_relative(view, x, y);
 			}
 			break;
@@ -896,8 +1073,8 @@ actions_run(struct view *activator, struct server *server,
 		case ACTION_TYPE_GO_TO_DESKTOP:
 			{
 				bool follow = true;
-				bool wrap = action_get_bool(action, "wrap", true);
-				const char *to = action_get_str(action, "to", NULL);
+				bool wrap = action_get_bool(action, ACTION_KEY_WRAP, true);
+				const char *to = action_get_str(action, ACTION_KEY_TO, NULL);
 				/*
 				 * `to` is always != NULL here because otherwise we would have
 				 * removed the action during the initial parsing step as it is
@@ -910,7 +1087,7 @@ actions_run(struct view *activator, struct server *server,
 				}
 				if (action->type == ACTION_TYPE_SEND_TO_DESKTOP) {
 					view_move_to_workspace(view, target);
-					follow = action_get_bool(action, "follow", true);
+					follow = action_get_bool(action, ACTION_KEY_FOLLOW, true);
 				}
 				if (follow) {
 					workspaces_switch_to(target,
@@ -922,13 +1099,13 @@ actions_run(struct view *activator, struct server *server,
 			if (!view) {
 				break;
 			}
-			const char *output_name = action_get_str(action, "output", NULL);
+			const char *output_name = action_get_str(action, ACTION_KEY_OUTPUT, NULL);
 			struct output *target = NULL;
 			if (output_name) {
 				target = output_from_name(view->server, output_name);
 			} else {
-				enum view_edge edge = action_get_int(action, "direction", 0);
-				bool wrap = action_get_bool(action, "wrap", false);
+				enum view_edge edge = action_get_int(action, ACTION_KEY_DIRECTION, 0);
+				bool wrap = action_get_bool(action, ACTION_KEY_WRAP, false);
 				target = view_get_adjacent_output(view, edge, wrap);
 			}
 			if (!target) {
@@ -956,7 +1133,7 @@ actions_run(struct view *activator, struct server *server,
 			if (!output) {
 				break;
 			}
-			const char *region_name = action_get_str(action, "region", NULL);
+			const char *region_name = action_get_str(action, ACTION_KEY_REGION, NULL);
 			struct region *region = regions_from_name(region_name, output);
 			if (region) {
 				view_snap_to_region(view, region,
@@ -972,7 +1149,7 @@ actions_run(struct view *activator, struct server *server,
 			break;
 		case ACTION_TYPE_FOCUS_OUTPUT:
 			{
-				const char *output_name = action_get_str(action, "output", NULL);
+				const char *output_name = action_get_str(action, ACTION_KEY_OUTPUT, NULL);
 				desktop_focus_output(output_from_name(server, output_name));
 			}
 			break;
@@ -994,7 +1171,8 @@ actions_run(struct view *activator, struct server *server,
 				wl_array_release(&views);
 				if (!matches) {
 					struct wl_list *actions;
-					actions = action_get_actionlist(action, "none");
+					actions = action_get_list(action, ACTION_KEY_NONE,
+						LAB_ACTION_ARG_ACTION_LIST);
 					if (actions) {
 						actions_run(view, server, actions, 0);
 					}
@@ -1003,15 +1181,17 @@ actions_run(struct view *activator, struct server *server,
 			break;
 		case ACTION_TYPE_VIRTUAL_OUTPUT_ADD:
 			{
-				const char *output_name = action_get_str(action, "output_name",
+				const char *output_name = action_get_str(action, ACTION_KEY_OUTPUT_NAME,
 						NULL);
 				output_virtual_add(server, output_name,
+					action_get_int(action, ACTION_KEY_MAX_REFRESH, 0),
+					action_get_bool(action, ACTION_KEY_RENDER_ON_DAMAGE, false),
 					/*store_wlr_output*/ NULL);
 			}
 			break;
 		case ACTION_TYPE_VIRTUAL_OUTPUT_REMOVE:
 			{
-				const char *output_name = action_get_str(action, "output_name",
+				const char *output_name = action_get_str(action, ACTION_KEY_OUTPUT_NAME,
 						NULL);
 				output_virtual_remove(server, output_name);
 			}
@@ -1046,6 +1226,9 @@ actions_run(struct view *activator, struct server *server,
 				view_set_shade(view, false);
 			}
 			break;
+		case ACTION_TYPE_TOGGLE_PERFORMANCE_HUD:
+			perf_hud_toggle(server);
+			break;
 		case ACTION_TYPE_INVALID:
 			wlr_log(WLR_ERROR, "Not executing unknown action");
 			break;
@@ -1060,4 +1243,6 @@ actions_run(struct view *activator, struct server *server,
 				" This is a BUG. Please report.", action->type);
 		}
 	}
+
+	transaction_end(server);
 }
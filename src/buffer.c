@@ -25,14 +25,166 @@
  */
 
 #include <assert.h>
+#include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
 #include <drm_fourcc.h>
 #include <wlr/interfaces/wlr_buffer.h>
+#include <wlr/render/pixman.h>
+#include <wlr/util/addon.h>
+#include <wlr/util/log.h>
 #include "buffer.h"
+#include "common/macros.h"
 #include "common/mem.h"
 
+/* There are only a handful of files creating buffers */
+#define MAX_SITES 32
+
+/*
+ * Pixel memory of destroyed cairo buffers is kept for reuse in power of
+ * two sized buckets from 4 KiB to 8 MiB, so re-rendering the window
+ * switcher, titles or the workspace OSD does not go through malloc()
+ * and fresh page faults every time. Larger buffers are not pooled.
+ * The free-lists are shared by all threads creating buffers, so they are
+ * only touched with the lock held.
+ */
+#define PIXEL_POOL_MIN_SHIFT 12
+#define PIXEL_POOL_NR_BUCKETS 12
+#define PIXEL_POOL_MAX_FREE 4
+#define PIXEL_POOL_MAX_BYTES (16 * 1024 * 1024)
+
 static const struct wlr_buffer_impl data_buffer_impl;
 
+static struct buffer_site_stats sites[MAX_SITES];
+static size_t nr_sites;
+static struct buffer_stats totals;
+
+static struct {
+	pthread_mutex_t lock;
+	void *free[PIXEL_POOL_NR_BUCKETS]; /* linked through the first word */
+	size_t nr_free[PIXEL_POOL_NR_BUCKETS];
+	size_t bytes;
+} pixel_pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/* Returns the bucket for @size or -1 if it is too large to be pooled */
+static int
+pixel_pool_bucket(size_t size)
+{
+	for (int i = 0; i < PIXEL_POOL_NR_BUCKETS; i++) {
+		if (size <= (size_t)1 << (PIXEL_POOL_MIN_SHIFT + i)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/* Zero-filled memory of at least @size bytes from bucket @bucket */
+static void *
+pixel_pool_alloc(int bucket, size_t size)
+{
+	size_t capacity = (size_t)1 << (PIXEL_POOL_MIN_SHIFT + bucket);
+	pthread_mutex_lock(&pixel_pool.lock);
+	void *pixels = pixel_pool.free[bucket];
+	if (pixels) {
+		pixel_pool.free[bucket] = *(void **)pixels;
+		pixel_pool.nr_free[bucket]--;
+		pixel_pool.bytes -= capacity;
+	}
+	pthread_mutex_unlock(&pixel_pool.lock);
+	if (!pixels) {
+		return xzalloc(capacity);
+	}
+	memset(pixels, 0, size);
+	return pixels;
+}
+
+static void
+pixel_pool_free(int bucket, void *pixels)
+{
+	size_t capacity = (size_t)1 << (PIXEL_POOL_MIN_SHIFT + bucket);
+	pthread_mutex_lock(&pixel_pool.lock);
+	if (pixel_pool.nr_free[bucket] >= PIXEL_POOL_MAX_FREE
+			|| pixel_pool.bytes + capacity > PIXEL_POOL_MAX_BYTES) {
+		pthread_mutex_unlock(&pixel_pool.lock);
+		free(pixels);
+		return;
+	}
+	*(void **)pixels = pixel_pool.free[bucket];
+	pixel_pool.free[bucket] = pixels;
+	pixel_pool.nr_free[bucket]++;
+	pixel_pool.bytes += capacity;
+	pthread_mutex_unlock(&pixel_pool.lock);
+}
+
+void
+buffer_pool_finish(void)
+{
+	pthread_mutex_lock(&pixel_pool.lock);
+	for (int i = 0; i < PIXEL_POOL_NR_BUCKETS; i++) {
+		while (pixel_pool.free[i]) {
+			void *pixels = pixel_pool.free[i];
+			pixel_pool.free[i] = *(void **)pixels;
+			free(pixels);
+		}
+		pixel_pool.nr_free[i] = 0;
+	}
+	pixel_pool.bytes = 0;
+	pthread_mutex_unlock(&pixel_pool.lock);
+}
+
+static struct buffer_site_stats *
+get_site(const char *file)
+{
+	const char *slash = strrchr(file, '/');
+	const char *name = slash ? slash + 1 : file;
+	for (size_t i = 0; i < nr_sites; i++) {
+		/* Usually the very same string literal */
+		if (sites[i].site == name || !strcmp(sites[i].site, name)) {
+			return &sites[i];
+		}
+	}
+	if (nr_sites == MAX_SITES) {
+		/* Lump any further files together with the last one */
+		return &sites[MAX_SITES - 1];
+	}
+	sites[nr_sites].site = name;
+	return &sites[nr_sites++];
+}
+
+static void
+account_alloc(struct lab_data_buffer *buffer, const char *file, size_t bytes)
+{
+	struct buffer_site_stats *site = get_site(file);
+	buffer->site = site;
+	buffer->accounted_bytes = bytes;
+
+	site->count++;
+	site->bytes += bytes;
+	site->peak_bytes = MAX(site->peak_bytes, site->bytes);
+	totals.count++;
+	totals.bytes += bytes;
+	totals.peak_bytes = MAX(totals.peak_bytes, totals.bytes);
+}
+
+static void
+account_free(struct lab_data_buffer *buffer)
+{
+	buffer->site->count--;
+	buffer->site->bytes -= buffer->accounted_bytes;
+	totals.count--;
+	totals.bytes -= buffer->accounted_bytes;
+}
+
+void
+buffer_get_stats(struct buffer_stats *stats)
+{
+	*stats = totals;
+	stats->sites = sites;
+	stats->nr_sites = nr_sites;
+}
+
 static struct lab_data_buffer *
 data_buffer_from_buffer(struct wlr_buffer *buffer)
 {
@@ -44,6 +196,8 @@ static void
 data_buffer_destroy(struct wlr_buffer *wlr_buffer)
 {
 	struct lab_data_buffer *buffer = data_buffer_from_buffer(wlr_buffer);
+	account_free(buffer);
+	pixman_region32_fini(&buffer->opaque_region);
 	if (!buffer->free_on_destroy) {
 		free(buffer);
 		return;
@@ -52,6 +206,9 @@ data_buffer_destroy(struct wlr_buffer *wlr_buffer)
 		cairo_surface_t *surf = cairo_get_target(buffer->cairo);
 		cairo_destroy(buffer->cairo);
 		cairo_surface_destroy(surf);
+		if (buffer->pixel_bucket >= 0) {
+			pixel_pool_free(buffer->pixel_bucket, buffer->data);
+		}
 	} else if (buffer->data) {
 		free(buffer->data);
 		buffer->data = NULL;
@@ -65,7 +222,10 @@ data_buffer_begin_data_ptr_access(struct wlr_buffer *wlr_buffer, uint32_t flags,
 {
 	struct lab_data_buffer *buffer =
 		wl_container_of(wlr_buffer, buffer, base);
-	assert(buffer->data);
+	if (!buffer->data) {
+		/* Released by buffer_share_texture_only() */
+		return false;
+	}
 	*data = (void *)buffer->data;
 	*format = buffer->format;
 	*stride = buffer->stride;
@@ -85,19 +245,35 @@ static const struct wlr_buffer_impl data_buffer_impl = {
 };
 
 struct lab_data_buffer *
-buffer_create_cairo(uint32_t width, uint32_t height, float scale,
-	bool free_on_destroy)
+buffer_create_cairo_at(const char *site, uint32_t width, uint32_t height,
+	float scale, bool free_on_destroy)
 {
 	struct lab_data_buffer *buffer = znew(*buffer);
 	buffer->unscaled_width = width;
 	buffer->unscaled_height = height;
+	pixman_region32_init(&buffer->opaque_region);
 	width *= scale;
 	height *= scale;
 
 	/* Allocate the buffer with the scaled size */
 	wlr_buffer_init(&buffer->base, &data_buffer_impl, width, height);
-	cairo_surface_t *surf =
-		cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+	int stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, width);
+	size_t size = (size_t)stride * height;
+	/* Pixels of buffers not freed on destroy belong to the caller */
+	buffer->pixel_bucket = free_on_destroy && stride > 0 && size
+		? pixel_pool_bucket(size) : -1;
+	cairo_surface_t *surf;
+	if (buffer->pixel_bucket >= 0) {
+		void *pixels = pixel_pool_alloc(buffer->pixel_bucket, size);
+		surf = cairo_image_surface_create_for_data(pixels,
+			CAIRO_FORMAT_ARGB32, width, height, stride);
+		if (cairo_surface_status(surf) != CAIRO_STATUS_SUCCESS) {
+			pixel_pool_free(buffer->pixel_bucket, pixels);
+		}
+	} else {
+		surf = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+			width, height);
+	}
 
 	/**
 	 * Tell cairo about the device scale so we can keep drawing in unscaled
@@ -117,23 +293,116 @@ buffer_create_cairo(uint32_t width, uint32_t height, float scale,
 	if (!buffer->data) {
 		cairo_destroy(buffer->cairo);
 		cairo_surface_destroy(surf);
+		pixman_region32_fini(&buffer->opaque_region);
 		free(buffer);
-		buffer = NULL;
+		return NULL;
 	}
+	account_alloc(buffer, site, buffer->stride * height);
 	return buffer;
 }
 
 struct lab_data_buffer *
-buffer_create_wrap(void *pixel_data, uint32_t width, uint32_t height,
-	uint32_t stride, bool free_on_destroy)
+buffer_create_wrap_at(const char *site, void *pixel_data, uint32_t width,
+	uint32_t height, uint32_t stride, bool free_on_destroy)
 {
 	struct lab_data_buffer *buffer = znew(*buffer);
 	wlr_buffer_init(&buffer->base, &data_buffer_impl, width, height);
 	buffer->unscaled_width = width;
 	buffer->unscaled_height = height;
 	buffer->data = pixel_data;
+	buffer->pixel_bucket = -1;
+	pixman_region32_init(&buffer->opaque_region);
 	buffer->format = DRM_FORMAT_ARGB8888;
 	buffer->stride = stride;
 	buffer->free_on_destroy = free_on_destroy;
+	/* Wrapped pixels only count if the buffer takes ownership */
+	account_alloc(buffer, site, free_on_destroy ? (size_t)stride * height : 0);
 	return buffer;
 }
+
+struct shared_texture {
+	struct wlr_addon addon;
+	struct wlr_client_buffer *client_buffer;
+};
+
+static void
+shared_texture_destroy(struct wlr_addon *addon)
+{
+	struct shared_texture *shared = wl_container_of(addon, shared, addon);
+	wlr_addon_finish(addon);
+	/* Scene nodes still showing it hold their own locks */
+	wlr_buffer_unlock(&shared->client_buffer->base);
+	free(shared);
+}
+
+static const struct wlr_addon_interface shared_texture_impl = {
+	.name = "labwc_shared_texture",
+	.destroy = shared_texture_destroy,
+};
+
+void
+buffer_share_texture(struct wlr_buffer *buffer, struct wlr_renderer *renderer)
+{
+	if (!buffer || wlr_addon_find(&buffer->addons, buffer,
+			&shared_texture_impl)) {
+		return;
+	}
+	struct wlr_client_buffer *client_buffer =
+		wlr_client_buffer_create(buffer, renderer);
+	if (!client_buffer) {
+		wlr_log(WLR_ERROR, "failed to upload shared texture");
+		return;
+	}
+	struct shared_texture *shared = znew(*shared);
+	shared->client_buffer = client_buffer;
+	wlr_addon_init(&shared->addon, &buffer->addons, buffer,
+		&shared_texture_impl);
+}
+
+void
+buffer_share_texture_only(struct lab_data_buffer *buffer,
+		struct wlr_renderer *renderer)
+{
+	if (!buffer) {
+		return;
+	}
+	buffer_share_texture(&buffer->base, renderer);
+	if (!wlr_addon_find(&buffer->base.addons, &buffer->base,
+			&shared_texture_impl)) {
+		return;
+	}
+	/* The pixman renderer samples the pixels in place */
+	if (wlr_renderer_is_pixman(renderer) || !buffer->free_on_destroy
+			|| !buffer->cairo) {
+		return;
+	}
+
+	cairo_surface_t *surf = cairo_get_target(buffer->cairo);
+	cairo_destroy(buffer->cairo);
+	cairo_surface_destroy(surf);
+	if (buffer->pixel_bucket >= 0) {
+		pixel_pool_free(buffer->pixel_bucket, buffer->data);
+	}
+	buffer->cairo = NULL;
+	buffer->data = NULL;
+	buffer->pixel_bucket = -1;
+
+	buffer->site->bytes -= buffer->accounted_bytes;
+	totals.bytes -= buffer->accounted_bytes;
+	buffer->accounted_bytes = 0;
+}
+
+struct wlr_buffer *
+buffer_get_shared(struct wlr_buffer *buffer)
+{
+	if (!buffer) {
+		return NULL;
+	}
+	struct wlr_addon *addon = wlr_addon_find(&buffer->addons, buffer,
+		&shared_texture_impl);
+	if (!addon) {
+		return buffer;
+	}
+	struct shared_texture *shared = wl_container_of(addon, shared, addon);
+	return &shared->client_buffer->base;
+}
@@ -0,0 +1,195 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <cairo.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <wlr/util/log.h>
+#include "button/button-cache.h"
+#include "common/hash.h"
+#include "common/string-helpers.h"
+
+#define CACHE_MAGIC 0x6e74626c /* "lbtn" */
+#define CACHE_VERSION 3
+
+struct cache_header {
+	uint32_t magic;
+	uint32_t version;
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+	int64_t file_size;
+	int32_t size;
+	int32_t width;
+	int32_t height;
+	uint32_t name_len;
+	uint32_t scale_permille;
+	/* Zero, headers are written and compared as a whole */
+	uint32_t reserved;
+};
+
+static_assert(sizeof(struct cache_header) == 56,
+	"struct cache_header must not have padding");
+
+static uint32_t
+scale_permille(double scale)
+{
+	return (uint32_t)(scale * 1000 + 0.5);
+}
+
+static bool
+cache_dir(char *buf, size_t len)
+{
+	const char *base = getenv("XDG_CACHE_HOME");
+	const char *suffix = "labwc";
+	if (string_null_or_empty(base)) {
+		base = getenv("HOME");
+		suffix = ".cache/labwc";
+	}
+	if (string_null_or_empty(base)) {
+		return false;
+	}
+	int ret = snprintf(buf, len, "%s/%s", base, suffix);
+	return ret > 0 && (size_t)ret < len;
+}
+
+static bool
+cache_path(const char *filename, int size, double scale, char *buf,
+		size_t len)
+{
+	char dir[4096];
+	if (!cache_dir(dir, sizeof(dir))) {
+		return false;
+	}
+
+	uint64_t hash = hash_str(HASH_INIT, filename);
+	hash = hash_value(hash, (uint32_t)size);
+	hash = hash_value(hash, scale_permille(scale));
+
+	int ret = snprintf(buf, len, "%s/button-%016llx", dir,
+		(unsigned long long)hash);
+	return ret > 0 && (size_t)ret < len;
+}
+
+static void
+fill_header(struct cache_header *header, const struct stat *st,
+		const char *filename, int size, double scale)
+{
+	memset(header, 0, sizeof(*header));
+	*header = (struct cache_header){
+		.magic = CACHE_MAGIC,
+		.version = CACHE_VERSION,
+		.mtime_sec = st->st_mtim.tv_sec,
+		.mtime_nsec = st->st_mtim.tv_nsec,
+		.file_size = st->st_size,
+		.size = size,
+		.name_len = strlen(filename),
+		.scale_permille = scale_permille(scale),
+	};
+}
+
+cairo_surface_t *
+button_cache_load(const char *filename, int size, double scale)
+{
+	struct stat st;
+	char path[4096];
+	if (stat(filename, &st) || !cache_path(filename, size, scale, path,
+			sizeof(path))) {
+		return NULL;
+	}
+	FILE *fp = fopen(path, "rb");
+	if (!fp) {
+		return NULL;
+	}
+
+	cairo_surface_t *surface = NULL;
+	char *name = NULL;
+	struct cache_header expected, header;
+	fill_header(&expected, &st, filename, size, scale);
+	if (fread(&header, sizeof(header), 1, fp) != 1) {
+		goto out;
+	}
+	expected.width = header.width;
+	expected.height = header.height;
+	if (memcmp(&header, &expected, sizeof(header))) {
+		goto out;
+	}
+
+	/* Guard against hash collisions */
+	name = malloc(header.name_len);
+	if (!name || fread(name, header.name_len, 1, fp) != 1
+			|| memcmp(name, filename, header.name_len)) {
+		goto out;
+	}
+
+	/* The same size button_svg_load() renders at */
+	if (header.width != (int)(size * scale)
+			|| header.height != (int)(size * scale)) {
+		goto out;
+	}
+	surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+		header.width, header.height);
+	unsigned char *data = cairo_image_surface_get_data(surface);
+	int stride = cairo_image_surface_get_stride(surface);
+	for (int y = 0; data && y < header.height; y++) {
+		if (fread(data + y * stride, 4 * header.width, 1, fp) != 1) {
+			data = NULL;
+		}
+	}
+	if (!data) {
+		cairo_surface_destroy(surface);
+		surface = NULL;
+		goto out;
+	}
+	cairo_surface_mark_dirty(surface);
+	cairo_surface_set_device_scale(surface, scale, scale);
+out:
+	free(name);
+	fclose(fp);
+	return surface;
+}
+
+void
+button_cache_store(const char *filename, int size, double scale,
+		cairo_surface_t *surface)
+{
+	struct stat st;
+	char dir[4096], path[4096], tmp[4096 + 8];
+	if (!surface || stat(filename, &st)
+			|| !cache_dir(dir, sizeof(dir))
+			|| !cache_path(filename, size, scale, path, sizeof(path))) {
+		return;
+	}
+	if (mkdir(dir, 0700) && errno != EEXIST) {
+		wlr_log_errno(WLR_DEBUG, "cannot create %s", dir);
+		return;
+	}
+
+	cairo_surface_flush(surface);
+	struct cache_header header;
+	fill_header(&header, &st, filename, size, scale);
+	header.width = cairo_image_surface_get_width(surface);
+	header.height = cairo_image_surface_get_height(surface);
+	unsigned char *data = cairo_image_surface_get_data(surface);
+	int stride = cairo_image_surface_get_stride(surface);
+
+	/* Write to a temporary file so readers never see partial entries */
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	FILE *fp = fopen(tmp, "wb");
+	if (!fp) {
+		wlr_log_errno(WLR_DEBUG, "cannot write %s", tmp);
+		return;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1
+		&& fwrite(filename, header.name_len, 1, fp) == 1;
+	for (int y = 0; ok && y < header.height; y++) {
+		ok = fwrite(data + y * stride, 4 * header.width, 1, fp) == 1;
+	}
+	if (fclose(fp) || !ok || rename(tmp, path)) {
+		wlr_log(WLR_DEBUG, "failed to store button cache %s", path);
+		remove(tmp);
+	}
+}
@@ -3,7 +3,6 @@
  * Copyright (C) Johan Malm 2023
  */
 #define _POSIX_C_SOURCE 200809L
-#include <cairo.h>
 #include <png.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -12,6 +11,7 @@
 #include "buffer.h"
 #include "button/button-png.h"
 #include "button/common.h"
+#include "common/mem.h"
 #include "common/string-helpers.h"
 #include "labwc.h"
 
@@ -43,6 +43,21 @@ ispng(const char *filename)
 
 #undef PNG_BYTES_TO_CHECK
 
+/* Buffers hold pre-multiplied alpha, like cairo image surfaces */
+static void
+premultiply(unsigned char *pixels, size_t len)
+{
+	for (size_t i = 0; i < len; i += 4) {
+		unsigned int alpha = pixels[i + 3];
+		if (alpha == 255) {
+			continue;
+		}
+		for (size_t c = 0; c < 3; c++) {
+			pixels[i + c] = (pixels[i + c] * alpha + 127) / 255;
+		}
+	}
+}
+
 void
 button_png_load(const char *button_name, struct lab_data_buffer **buffer)
 {
@@ -60,18 +75,28 @@ button_png_load(const char *button_name, struct lab_data_buffer **buffer)
 		return;
 	}
 
-	cairo_surface_t *image = cairo_image_surface_create_from_png(path);
-	if (cairo_surface_status(image)) {
-		wlr_log(WLR_ERROR, "error reading png button '%s'", path);
-		cairo_surface_destroy(image);
+	png_image image = { .version = PNG_IMAGE_VERSION };
+	if (!png_image_begin_read_from_file(&image, path)) {
+		wlr_log(WLR_ERROR, "error reading png button '%s': %s", path,
+			image.message);
 		return;
 	}
-	cairo_surface_flush(image);
 
-	double w = cairo_image_surface_get_width(image);
-	double h = cairo_image_surface_get_height(image);
-	*buffer = buffer_create_cairo((int)w, (int)h, 1.0, true);
-	cairo_t *cairo = (*buffer)->cairo;
-	cairo_set_source_surface(cairo, image, 0, 0);
-	cairo_paint_with_alpha(cairo, 1.0);
+	/*
+	 * Decoded straight into the pixels of the buffer. DRM_FORMAT_ARGB8888
+	 * is stored as B, G, R, A bytes.
+	 */
+	image.format = PNG_FORMAT_BGRA;
+	uint32_t stride = PNG_IMAGE_ROW_STRIDE(image);
+	size_t len = (size_t)stride * image.height;
+	unsigned char *pixels = xmalloc(len);
+	if (!png_image_finish_read(&image, NULL, pixels, stride, NULL)) {
+		wlr_log(WLR_ERROR, "error reading png button '%s': %s", path,
+			image.message);
+		free(pixels);
+		return;
+	}
+	premultiply(pixels, len);
+	*buffer = buffer_create_wrap(pixels, image.width, image.height, stride,
+		/* free_on_destroy */ true);
 }
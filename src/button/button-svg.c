@@ -5,30 +5,53 @@
 #define _POSIX_C_SOURCE 200809L
 #include <cairo.h>
 #include <librsvg/rsvg.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <wlr/util/log.h>
 #include "buffer.h"
+#include "button/button-cache.h"
 #include "button/button-svg.h"
 #include "button/common.h"
+#include "common/macros.h"
+#include "common/mem.h"
 #include "common/string-helpers.h"
 #include "labwc.h"
 
-void
-button_svg_load(const char *button_name, struct lab_data_buffer **buffer,
-		int size)
+#define MAX_WORKERS 4
+
+/*
+ * Looks the button up in the theme directories, main thread only as
+ * paths_theme_create() builds the paths in a static buffer
+ */
+static char *
+find_svg(const char *button_name)
 {
-	if (*buffer) {
-		wlr_buffer_drop(&(*buffer)->base);
-		*buffer = NULL;
-	}
 	if (string_null_or_empty(button_name)) {
-		return;
+		return NULL;
 	}
-
 	char filename[4096] = { 0 };
 	button_filename(button_name, filename, sizeof(filename));
+	return *filename ? xstrdup(filename) : NULL;
+}
+
+/*
+ * Rasterizes into a plain image surface and touches no global state, so
+ * that it can run on the worker threads of button_svg_load_all()
+ */
+static cairo_surface_t *
+render_svg(const char *filename, int size, double scale)
+{
+	if (!filename) {
+		return NULL;
+	}
+	cairo_surface_t *surface = button_cache_load(filename, size, scale);
+	if (surface) {
+		return surface;
+	}
 
 	GError *err = NULL;
 	RsvgRectangle viewport = { .width = size, .height = size };
@@ -40,34 +63,129 @@ button_svg_load(const char *button_name, struct lab_data_buffer **buffer,
 		 * rsvg_handle_new_from_file() returns NULL if an error occurs,
 		 * so there is no need to free svg here.
 		 */
-		return;
+		return NULL;
 	}
 
-	cairo_surface_t *image = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, size, size);
-	cairo_t *cr = cairo_create(image);
+	/*
+	 * The device scale makes the viewport cover all pixels at the
+	 * resolution of the output, like buffer_create_cairo() does
+	 */
+	surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+		size * scale, size * scale);
+	cairo_surface_set_device_scale(surface, scale, scale);
+	cairo_t *cairo = cairo_create(surface);
 
-	rsvg_handle_render_document(svg, cr, &viewport, &err);
+	rsvg_handle_render_document(svg, cairo, &viewport, &err);
+	cairo_destroy(cairo);
+	g_object_unref(svg);
 	if (err) {
 		wlr_log(WLR_ERROR, "error rendering svg %s-%s\n", filename, err->message);
 		g_error_free(err);
 		goto error;
 	}
 
-	if (cairo_surface_status(image)) {
+	if (cairo_surface_status(surface)) {
 		wlr_log(WLR_ERROR, "error reading svg button '%s'", filename);
 		goto error;
 	}
-	cairo_surface_flush(image);
+	cairo_surface_flush(surface);
+	button_cache_store(filename, size, scale, surface);
+	return surface;
 
-	double w = cairo_image_surface_get_width(image);
-	double h = cairo_image_surface_get_height(image);
-	*buffer = buffer_create_cairo((int)w, (int)h, 1.0, /* free_on_destroy */ true);
+error:
+	cairo_surface_destroy(surface);
+	return NULL;
+}
+
+/* Copies a rendered surface into a new buffer, main thread only */
+static void
+wrap_surface(struct lab_data_buffer **buffer, cairo_surface_t *surface,
+		int size, double scale)
+{
+	if (*buffer) {
+		wlr_buffer_drop(&(*buffer)->base);
+		*buffer = NULL;
+	}
+	if (!surface) {
+		return;
+	}
+	*buffer = buffer_create_cairo(size, size, scale, /* free_on_destroy */ true);
 	cairo_t *cairo = (*buffer)->cairo;
-	cairo_set_source_surface(cairo, image, 0, 0);
-	cairo_paint_with_alpha(cairo, 1.0);
+	cairo_save(cairo);
+	cairo_set_operator(cairo, CAIRO_OPERATOR_SOURCE);
+	cairo_set_source_surface(cairo, surface, 0, 0);
+	cairo_paint(cairo);
+	cairo_restore(cairo);
+	cairo_surface_flush(cairo_get_target(cairo));
+	cairo_surface_destroy(surface);
+}
 
-error:
-	cairo_destroy(cr);
-	cairo_surface_destroy(image);
-	g_object_unref(svg);
+void
+button_svg_load(const char *button_name, struct lab_data_buffer **buffer,
+		int size, double scale)
+{
+	char *filename = find_svg(button_name);
+	wrap_surface(buffer, render_svg(filename, size, scale), size, scale);
+	free(filename);
+}
+
+struct job_queue {
+	struct button_svg_job *jobs;
+	size_t nr_jobs;
+	atomic_size_t next;
+};
+
+static void *
+worker(void *data)
+{
+	struct job_queue *queue = data;
+	size_t i;
+	while ((i = atomic_fetch_add(&queue->next, 1)) < queue->nr_jobs) {
+		struct button_svg_job *job = &queue->jobs[i];
+		job->surface = render_svg(job->filename, job->size, job->scale);
+	}
+	return NULL;
+}
+
+/*
+ * Every job parses its own file into its own RsvgHandle and image surface,
+ * so the workers share nothing but the job counter. Filenames are looked
+ * up before the workers are started, and buffers are only created, and
+ * accounted for, on the calling thread once all workers have been joined. The calling thread takes part in the rendering as well and
+ * falls back to doing all the work if no thread can be started.
+ */
+void
+button_svg_load_all(struct button_svg_job *jobs, size_t nr_jobs)
+{
+	struct job_queue queue = {
+		.jobs = jobs,
+		.nr_jobs = nr_jobs,
+	};
+	atomic_init(&queue.next, 0);
+	for (size_t i = 0; i < nr_jobs; i++) {
+		jobs[i].filename = find_svg(jobs[i].name);
+	}
+
+	long nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t nr_workers = MIN((size_t)MAX(nr_cpus, 1), MAX_WORKERS);
+	nr_workers = MIN(nr_workers, nr_jobs) - (nr_jobs > 0);
+
+	pthread_t threads[MAX_WORKERS];
+	size_t started = 0;
+	for (; started < nr_workers; started++) {
+		if (pthread_create(&threads[started], NULL, worker, &queue)) {
+			break;
+		}
+	}
+	worker(&queue);
+	for (size_t i = 0; i < started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	for (size_t i = 0; i < nr_jobs; i++) {
+		wrap_surface(jobs[i].buffer, jobs[i].surface, jobs[i].size,
+			jobs[i].scale);
+		jobs[i].surface = NULL;
+		zfree(jobs[i].filename);
+	}
 }
@@ -0,0 +1,354 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/util/log.h>
+#include "client-stats.h"
+#include "common/histogram.h"
+#include "common/macros.h"
+#include "common/mem.h"
+#include "common/time-helpers.h"
+#include "debug.h"
+
+#define NSEC_PER_SEC 1000000000LL
+
+struct client_stats {
+	struct wl_client *client;
+	struct wl_listener destroy;
+	pid_t pid;
+	char *name;
+
+	struct wl_list surfaces; /* tracked_surface.link */
+	uint64_t commits;
+	uint64_t damage_pixels;
+	size_t buffer_bytes;
+	size_t peak_buffer_bytes;
+	struct histogram configure;
+
+	/* Commits counted in the current one second window */
+	int64_t window_start_nsec;
+	uint32_t window_commits;
+	uint32_t commit_rate;
+	uint32_t peak_commit_rate;
+
+	bool warned_commit_rate;
+	bool warned_buffer_bytes;
+	struct wl_list link;
+};
+
+struct tracked_surface {
+	struct wlr_surface *surface;
+	/* NULL once the client has started to disconnect */
+	struct client_stats *stats;
+	size_t buffer_bytes;
+	struct wl_listener commit;
+	struct wl_listener destroy;
+	struct wl_list link;
+};
+
+static struct wl_list clients = { &clients, &clients };
+static struct wl_listener new_surface;
+static uint32_t max_commit_rate;
+static size_t max_buffer_bytes;
+
+static char *
+read_comm(pid_t pid)
+{
+	char path[64];
+	char comm[64] = "";
+	snprintf(path, sizeof(path), "/proc/%d/comm", (int)pid);
+	FILE *file = fopen(path, "r");
+	if (file) {
+		if (fgets(comm, sizeof(comm), file)) {
+			comm[strcspn(comm, "\n")] = '\0';
+		}
+		fclose(file);
+	}
+	return xstrdup(*comm ? comm : "unknown");
+}
+
+static void
+handle_client_destroy(struct wl_listener *listener, void *data)
+{
+	struct client_stats *stats = wl_container_of(listener, stats, destroy);
+	/* Emitted before the resources of the client are destroyed */
+	struct tracked_surface *tracked, *tmp;
+	wl_list_for_each_safe(tracked, tmp, &stats->surfaces, link) {
+		tracked->stats = NULL;
+		wl_list_remove(&tracked->link);
+		wl_list_init(&tracked->link);
+	}
+	wl_list_remove(&stats->destroy.link);
+	wl_list_remove(&stats->link);
+	free(stats->name);
+	free(stats);
+}
+
+static struct client_stats *
+get_stats(struct wl_client *client)
+{
+	struct wl_listener *listener =
+		wl_client_get_destroy_listener(client, handle_client_destroy);
+	if (listener) {
+		struct client_stats *stats =
+			wl_container_of(listener, stats, destroy);
+		return stats;
+	}
+
+	struct client_stats *stats = znew(*stats);
+	stats->client = client;
+	wl_client_get_credentials(client, &stats->pid, NULL, NULL);
+	stats->name = read_comm(stats->pid);
+	wl_list_init(&stats->surfaces);
+	stats->destroy.notify = handle_client_destroy;
+	wl_client_add_destroy_listener(client, &stats->destroy);
+	wl_list_append(&clients, &stats->link);
+	return stats;
+}
+
+static void
+count_commit(struct client_stats *stats)
+{
+	stats->commits++;
+
+	int64_t now = time_now_nsec();
+	if (now - stats->window_start_nsec >= NSEC_PER_SEC) {
+		/* A window without any commits in between means 0/s */
+		bool consecutive =
+			now - stats->window_start_nsec < 2 * NSEC_PER_SEC;
+		stats->commit_rate = consecutive ? stats->window_commits : 0;
+		stats->peak_commit_rate =
+			MAX(stats->peak_commit_rate, stats->commit_rate);
+		stats->window_start_nsec = now;
+		stats->window_commits = 0;
+	}
+	stats->window_commits++;
+
+	if (max_commit_rate && !stats->warned_commit_rate
+			&& stats->commit_rate > max_commit_rate) {
+		wlr_log(WLR_INFO, "client %s (pid %d) commits %u times per second",
+			stats->name, (int)stats->pid, stats->commit_rate);
+		stats->warned_commit_rate = true;
+	}
+}
+
+static void
+set_buffer_bytes(struct tracked_surface *tracked, size_t bytes)
+{
+	struct client_stats *stats = tracked->stats;
+	stats->buffer_bytes += bytes - tracked->buffer_bytes;
+	tracked->buffer_bytes = bytes;
+	stats->peak_buffer_bytes =
+		MAX(stats->peak_buffer_bytes, stats->buffer_bytes);
+
+	if (max_buffer_bytes && !stats->warned_buffer_bytes
+			&& stats->buffer_bytes > max_buffer_bytes) {
+		wlr_log(WLR_INFO, "client %s (pid %d) has %zu MiB of buffers attached",
+			stats->name, (int)stats->pid,
+			stats->buffer_bytes / (1024 * 1024));
+		stats->warned_buffer_bytes = true;
+	}
+}
+
+static void
+handle_commit(struct wl_listener *listener, void *data)
+{
+	struct tracked_surface *tracked =
+		wl_container_of(listener, tracked, commit);
+	if (!tracked->stats) {
+		return;
+	}
+	struct wlr_surface *surface = tracked->surface;
+
+	count_commit(tracked->stats);
+
+	int nrects;
+	pixman_box32_t *rects =
+		pixman_region32_rectangles(&surface->buffer_damage, &nrects);
+	for (int i = 0; i < nrects; i++) {
+		tracked->stats->damage_pixels += (uint64_t)
+			(rects[i].x2 - rects[i].x1) * (rects[i].y2 - rects[i].y1);
+	}
+
+	/* Assumes 4 bytes per pixel, which nearly all clients use */
+	set_buffer_bytes(tracked, (size_t)surface->current.buffer_width
+		* surface->current.buffer_height * 4);
+}
+
+static void
+handle_surface_destroy(struct wl_listener *listener, void *data)
+{
+	struct tracked_surface *tracked =
+		wl_container_of(listener, tracked, destroy);
+	if (tracked->stats) {
+		set_buffer_bytes(tracked, 0);
+	}
+	wl_list_remove(&tracked->commit.link);
+	wl_list_remove(&tracked->destroy.link);
+	wl_list_remove(&tracked->link);
+	free(tracked);
+}
+
+static void
+handle_new_surface(struct wl_listener *listener, void *data)
+{
+	struct wlr_surface *surface = data;
+	struct client_stats *stats =
+		get_stats(wl_resource_get_client(surface->resource));
+
+	struct tracked_surface *tracked = znew(*tracked);
+	tracked->surface = surface;
+	tracked->stats = stats;
+	wl_list_append(&stats->surfaces, &tracked->link);
+
+	tracked->commit.notify = handle_commit;
+	wl_signal_add(&surface->events.commit, &tracked->commit);
+	tracked->destroy.notify = handle_surface_destroy;
+	wl_signal_add(&surface->events.destroy, &tracked->destroy);
+}
+
+static size_t
+getenv_uint(const char *name)
+{
+	const char *value = getenv(name);
+	if (!value || !*value) {
+		return 0;
+	}
+	char *end;
+	unsigned long result = strtoul(value, &end, 10);
+	if (*end) {
+		wlr_log(WLR_ERROR, "ignoring invalid %s=%s", name, value);
+		return 0;
+	}
+	return result;
+}
+
+void
+client_stats_init(struct wlr_compositor *compositor)
+{
+	max_commit_rate = getenv_uint("LABWC_CLIENT_MAX_COMMIT_RATE");
+	max_buffer_bytes = getenv_uint("LABWC_CLIENT_MAX_BUFFER_MIB")
+		* 1024 * 1024;
+
+	new_surface.notify = handle_new_surface;
+	wl_signal_add(&compositor->events.new_surface, &new_surface);
+}
+
+static uint32_t
+commit_rate(struct client_stats *stats)
+{
+	/* The rate is only updated by commits, so it may be stale */
+	bool idle = time_now_nsec() - stats->window_start_nsec
+		>= 2 * NSEC_PER_SEC;
+	return idle ? 0 : stats->commit_rate;
+}
+
+uint32_t
+client_stats_get_commit_rate(struct wl_client *client)
+{
+	struct wl_listener *listener =
+		wl_client_get_destroy_listener(client, handle_client_destroy);
+	if (!listener) {
+		return 0;
+	}
+	struct client_stats *stats = wl_container_of(listener, stats, destroy);
+	return commit_rate(stats);
+}
+
+void
+client_stats_configure_acked(struct wl_client *client, uint32_t usec)
+{
+	struct wl_listener *listener =
+		wl_client_get_destroy_listener(client, handle_client_destroy);
+	if (listener) {
+		struct client_stats *stats =
+			wl_container_of(listener, stats, destroy);
+		histogram_add(&stats->configure, usec);
+	}
+}
+
+static void
+get_info(struct client_stats *stats, struct client_stats_info *info)
+{
+	*info = (struct client_stats_info){
+		.pid = stats->pid,
+		.name = stats->name,
+		.commits = stats->commits,
+		.commit_rate = commit_rate(stats),
+		.peak_commit_rate = stats->peak_commit_rate,
+		.damage_pixels = stats->damage_pixels,
+		.buffer_bytes = stats->buffer_bytes,
+		.peak_buffer_bytes = stats->peak_buffer_bytes,
+		.configure = &stats->configure,
+	};
+	struct tracked_surface *tracked;
+	wl_list_for_each(tracked, &stats->surfaces, link) {
+		info->surfaces++;
+		const struct wlr_surface_role *role = tracked->surface->role;
+		if (role && role->name && !strcmp(role->name, "xdg_popup")) {
+			info->popups++;
+		}
+	}
+}
+
+void
+client_stats_dump(void)
+{
+	if (wl_list_empty(&clients)) {
+		return;
+	}
+	printf(" clients\n");
+	printf("   %-16s %7s %10s %6s %6s %12s %9s %8s %6s\n", "name", "pid",
+		"commits", "rate", "peak", "damage-px", "buf-KiB",
+		"surfaces", "popups");
+	struct client_stats *stats;
+	wl_list_for_each(stats, &clients, link) {
+		struct client_stats_info info;
+		get_info(stats, &info);
+		printf("   %-16s %7d %10llu %6u %6u %12llu %9zu %8u %6u\n",
+			info.name, (int)info.pid,
+			(unsigned long long)info.commits, info.commit_rate,
+			info.peak_commit_rate,
+			(unsigned long long)info.damage_pixels,
+			info.buffer_bytes / 1024, info.surfaces, info.popups);
+	}
+	printf(" client configure response times\n");
+	debug_dump_histogram_header("usec");
+	wl_list_for_each(stats, &clients, link) {
+		if (stats->configure.count) {
+			debug_dump_histogram(stats->name, &stats->configure);
+		}
+	}
+	printf("\n");
+}
+
+void
+client_stats_for_each(void (*fn)(const struct client_stats_info *info,
+	void *data), void *data)
+{
+	struct client_stats *stats;
+	wl_list_for_each(stats, &clients, link) {
+		struct client_stats_info info;
+		get_info(stats, &info);
+		fn(&info, data);
+	}
+}
+
+void
+client_stats_finish(void)
+{
+	if (new_surface.notify) {
+		wl_list_remove(&new_surface.link);
+		new_surface.notify = NULL;
+	}
+	/* Clients are gone by now, see server_finish() */
+	struct client_stats *stats, *tmp;
+	wl_list_for_each_safe(stats, tmp, &clients, link) {
+		handle_client_destroy(&stats->destroy, NULL);
+	}
+}
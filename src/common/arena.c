@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common/arena.h"
+#include "common/mem.h"
+
+/*
+ * A typical rc.xml with default bindings needs a few dozen KiB, so this
+ * keeps the number of chunks small without wasting much on tiny configs.
+ */
+#define ARENA_CHUNK_SIZE (16 * 1024)
+
+#define ARENA_ALIGN(size) \
+	(((size) + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1))
+
+struct arena_chunk {
+	struct arena_chunk *next;
+	size_t size;
+	max_align_t data[];
+};
+
+static struct arena_chunk *
+chunk_create(size_t size)
+{
+	struct arena_chunk *chunk = xzalloc(sizeof(*chunk) + size);
+	chunk->size = size;
+	return chunk;
+}
+
+void *
+arena_alloc(struct arena *arena, size_t size)
+{
+	if (!arena) {
+		return xzalloc(size);
+	}
+	if (!size) {
+		return NULL;
+	}
+	size = ARENA_ALIGN(size);
+
+	struct arena_chunk *chunk = arena->chunks;
+	if (chunk && chunk->size - arena->used >= size) {
+		void *ptr = (char *)chunk->data + arena->used;
+		arena->used += size;
+		return ptr;
+	}
+
+	if (size > ARENA_CHUNK_SIZE / 4) {
+		/*
+		 * Large allocations get a chunk of their own behind the
+		 * current one, which is thereby not abandoned half-used.
+		 */
+		struct arena_chunk *large = chunk_create(size);
+		if (chunk) {
+			large->next = chunk->next;
+			chunk->next = large;
+		} else {
+			arena->chunks = large;
+			arena->used = size;
+		}
+		return large->data;
+	}
+
+	/* Chunks are zero-filled, so allocations need no memset() */
+	chunk = chunk_create(ARENA_CHUNK_SIZE);
+	chunk->next = arena->chunks;
+	arena->chunks = chunk;
+	arena->used = size;
+	return chunk->data;
+}
+
+char *
+arena_strdup(struct arena *arena, const char *str)
+{
+	if (!arena) {
+		return xstrdup(str);
+	}
+	size_t len = strlen(str) + 1;
+	char *copy = arena_alloc(arena, len);
+	memcpy(copy, str, len);
+	return copy;
+}
+
+void
+arena_release(struct arena *arena)
+{
+	struct arena_chunk *chunk = arena->chunks;
+	while (chunk) {
+		struct arena_chunk *next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
+	arena->chunks = NULL;
+	arena->used = 0;
+}
@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <string.h>
+#include "common/bitset.h"
+#include "common/macros.h"
+#include "common/mem.h"
+
+#define BITS_PER_WORD 64
+
+static void
+grow_overflow(struct bitset *set, size_t nr)
+{
+	if (nr <= set->nr_overflow) {
+		return;
+	}
+	set->overflow = xrealloc(set->overflow, nr * sizeof(uint64_t));
+	memset(set->overflow + set->nr_overflow, 0,
+		(nr - set->nr_overflow) * sizeof(uint64_t));
+	set->nr_overflow = nr;
+}
+
+void
+bitset_set(struct bitset *set, size_t bit)
+{
+	if (bit < BITS_PER_WORD) {
+		set->bits |= 1ull << bit;
+		return;
+	}
+	size_t word = bit / BITS_PER_WORD - 1;
+	grow_overflow(set, word + 1);
+	set->overflow[word] |= 1ull << (bit % BITS_PER_WORD);
+}
+
+bool
+bitset_test(const struct bitset *set, size_t bit)
+{
+	if (bit < BITS_PER_WORD) {
+		return set->bits & (1ull << bit);
+	}
+	size_t word = bit / BITS_PER_WORD - 1;
+	return word < set->nr_overflow
+		&& (set->overflow[word] & (1ull << (bit % BITS_PER_WORD)));
+}
+
+void
+bitset_clear(struct bitset *set)
+{
+	set->bits = 0;
+	if (set->nr_overflow) {
+		memset(set->overflow, 0, set->nr_overflow * sizeof(uint64_t));
+	}
+}
+
+void
+bitset_copy(struct bitset *dst, const struct bitset *src)
+{
+	bitset_clear(dst);
+	dst->bits = src->bits;
+	for (size_t i = 0; i < src->nr_overflow; i++) {
+		if (src->overflow[i]) {
+			grow_overflow(dst, i + 1);
+			dst->overflow[i] = src->overflow[i];
+		}
+	}
+}
+
+bool
+bitset_equal(const struct bitset *a, const struct bitset *b)
+{
+	if (a->bits != b->bits) {
+		return false;
+	}
+	size_t n = MAX(a->nr_overflow, b->nr_overflow);
+	for (size_t i = 0; i < n; i++) {
+		uint64_t wa = i < a->nr_overflow ? a->overflow[i] : 0;
+		uint64_t wb = i < b->nr_overflow ? b->overflow[i] : 0;
+		if (wa != wb) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool
+bitset_intersects(const struct bitset *a, const struct bitset *b)
+{
+	if (a->bits & b->bits) {
+		return true;
+	}
+	size_t n = MIN(a->nr_overflow, b->nr_overflow);
+	for (size_t i = 0; i < n; i++) {
+		if (a->overflow[i] & b->overflow[i]) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void
+bitset_finish(struct bitset *set)
+{
+	zfree(set->overflow);
+	set->nr_overflow = 0;
+	set->bits = 0;
+}
@@ -8,30 +8,77 @@
 #include "common/mem.h"
 #include "common/string-helpers.h"
 
-void
-buf_expand_tilde(struct buf *s)
+static void
+buf_expand(struct buf *s, int new_alloc)
 {
-	struct buf new = BUF_INIT;
-	for (int i = 0 ; i < s->len ; i++) {
-		if (s->data[i] == '~') {
-			buf_add(&new, getenv("HOME"));
-		} else {
-			buf_add_char(&new, s->data[i]);
-		}
+	/*
+	 * "s->alloc &&" ensures that s->data is always allocated after
+	 * returning (even if new_alloc == 0). The extra check is not
+	 * really necessary but makes it easier for analyzers to see
+	 * that we never overwrite a string literal.
+	 */
+	if (s->alloc && new_alloc <= s->alloc) {
+		return;
 	}
-	buf_move(s, &new);
+	new_alloc = MAX(new_alloc, 256);
+	new_alloc = MAX(new_alloc, s->alloc * 3 / 2);
+	if (s->alloc) {
+		assert(s->data);
+		s->data = xrealloc(s->data, new_alloc);
+	} else {
+		assert(!s->len);
+		s->data = xmalloc(new_alloc);
+		s->data[0] = '\0';
+	}
+	s->alloc = new_alloc;
 }
 
-static void
-strip_curly_braces(char *s)
+/*
+ * Both expansions below first work out the length of the result, so that
+ * the buffer is grown at most once, and then copy whole spans rather than
+ * single characters. Strings without anything to expand are left alone.
+ */
+
+void
+buf_expand_tilde(struct buf *s)
 {
-	size_t len = strlen(s);
-	if (s[0] != '{' || s[len - 1] != '}') {
+	int nr_tildes = 0;
+	for (int i = 0; i < s->len; i++) {
+		nr_tildes += s->data[i] == '~';
+	}
+	if (!nr_tildes) {
 		return;
 	}
-	len -= 2;
-	memmove(s, s + 1, len);
-	s[len] = 0;
+
+	const char *home = getenv("HOME");
+	int home_len = home ? strlen(home) : 0;
+	int old_len = s->len;
+	int new_len = old_len + nr_tildes * (home_len - 1);
+	buf_expand(s, new_len + 1);
+	char *data = s->data;
+
+	if (home_len >= 1) {
+		/* Growing (or same size): fill in place from the end */
+		int j = new_len;
+		for (int i = old_len - 1; i >= 0; i--) {
+			if (data[i] == '~') {
+				j -= home_len;
+				memcpy(data + j, home, home_len);
+			} else {
+				data[--j] = data[i];
+			}
+		}
+	} else {
+		/* HOME unset or empty: just drop the tildes */
+		int j = 0;
+		for (int i = 0; i < old_len; i++) {
+			if (data[i] != '~') {
+				data[j++] = data[i];
+			}
+		}
+	}
+	s->len = new_len;
+	data[new_len] = '\0';
 }
 
 static bool
@@ -40,59 +87,83 @@ isvalid(char p)
 	return isalnum(p) || p == '_' || p == '{' || p == '}';
 }
 
+/*
+ * Looks up the variable named at @p, which follows a '$'. Sets @len to the
+ * number of characters making up the name including optional braces.
+ * The name is NUL-terminated temporarily to avoid copying it.
+ */
+static const char *
+lookup_variable(char *p, int *len)
+{
+	int n = 0;
+	while (isvalid(p[n])) {
+		n++;
+	}
+	*len = n;
+
+	char *name = p;
+	char *end = p + n;
+	if (n >= 2 && p[0] == '{' && p[n - 1] == '}') {
+		name++;
+		end--;
+	}
+	char saved = *end;
+	*end = '\0';
+	const char *value = getenv(name);
+	*end = saved;
+	return value;
+}
+
 void
 buf_expand_shell_variables(struct buf *s)
 {
-	struct buf new = BUF_INIT;
-	struct buf environment_variable = BUF_INIT;
-
-	for (int i = 0 ; i < s->len ; i++) {
-		if (s->data[i] == '$' && isvalid(s->data[i+1])) {
-			/* expand environment variable */
-			buf_clear(&environment_variable);
-			buf_add(&environment_variable, s->data + i + 1);
-			char *p = environment_variable.data;
-			while (isvalid(*p)) {
-				++p;
-			}
-			*p = '\0';
-			i += strlen(environment_variable.data);
-			strip_curly_braces(environment_variable.data);
-			p = getenv(environment_variable.data);
-			if (p) {
-				buf_add(&new, p);
-			}
+	/* First pass: length of the result */
+	int new_len = 0;
+	bool found = false;
+	for (int i = 0; i < s->len; i++) {
+		if (s->data[i] == '$' && isvalid(s->data[i + 1])) {
+			int name_len;
+			const char *value = lookup_variable(s->data + i + 1, &name_len);
+			new_len += value ? strlen(value) : 0;
+			i += name_len;
+			found = true;
 		} else {
-			buf_add_char(&new, s->data[i]);
+			new_len++;
 		}
 	}
-	buf_reset(&environment_variable);
+	if (!found) {
+		return;
+	}
+
+	/* Second pass: copy literal spans and values */
+	struct buf new = BUF_INIT;
+	buf_expand(&new, new_len + 1);
+	int start = 0;
+	for (int i = 0; i < s->len; i++) {
+		if (s->data[i] != '$' || !isvalid(s->data[i + 1])) {
+			continue;
+		}
+		buf_add_n(&new, s->data + start, i - start);
+		int name_len;
+		const char *value = lookup_variable(s->data + i + 1, &name_len);
+		buf_add(&new, value);
+		i += name_len;
+		start = i + 1;
+	}
+	buf_add_n(&new, s->data + start, s->len - start);
 	buf_move(s, &new);
 }
 
-static void
-buf_expand(struct buf *s, int new_alloc)
+void
+buf_add_n(struct buf *s, const char *data, int len)
 {
-	/*
-	 * "s->alloc &&" ensures that s->data is always allocated after
-	 * returning (even if new_alloc == 0). The extra check is not
-	 * really necessary but makes it easier for analyzers to see
-	 * that we never overwrite a string literal.
-	 */
-	if (s->alloc && new_alloc <= s->alloc) {
+	if (len <= 0) {
 		return;
 	}
-	new_alloc = MAX(new_alloc, 256);
-	new_alloc = MAX(new_alloc, s->alloc * 3 / 2);
-	if (s->alloc) {
-		assert(s->data);
-		s->data = xrealloc(s->data, new_alloc);
-	} else {
-		assert(!s->len);
-		s->data = xmalloc(new_alloc);
-		s->data[0] = '\0';
-	}
-	s->alloc = new_alloc;
+	buf_expand(s, s->len + len + 1);
+	memcpy(s->data + s->len, data, len);
+	s->len += len;
+	s->data[s->len] = 0;
 }
 
 void
@@ -101,11 +172,7 @@ buf_add(struct buf *s, const char *data)
 	if (string_null_or_empty(data)) {
 		return;
 	}
-	int len = strlen(data);
-	buf_expand(s, s->len + len + 1);
-	memcpy(s->data + s->len, data, len);
-	s->len += len;
-	s->data[s->len] = 0;
+	buf_add_n(s, data, strlen(data));
 }
 
 void
@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <wayland-server-core.h>
+#include "common/defer.h"
+
+static void
+handle_idle(void *data)
+{
+	struct defer *defer = data;
+	defer->idle = NULL;
+	defer->run(defer->data);
+}
+
+void
+defer_schedule(struct defer *defer, struct wl_event_loop *loop,
+		void (*run)(void *data), void *data)
+{
+	if (defer->idle) {
+		return;
+	}
+	defer->run = run;
+	defer->data = data;
+	defer->idle = wl_event_loop_add_idle(loop, handle_idle, defer);
+}
+
+void
+defer_flush(struct defer *defer)
+{
+	if (defer->idle) {
+		wl_event_source_remove(defer->idle);
+		handle_idle(defer);
+	}
+}
+
+void
+defer_cancel(struct defer *defer)
+{
+	if (defer->idle) {
+		wl_event_source_remove(defer->idle);
+		defer->idle = NULL;
+	}
+}
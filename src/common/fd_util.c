@@ -7,6 +7,7 @@
 #include "common/fd_util.h"
 
 static struct rlimit original_nofile_rlimit = {0};
+static struct rlimit increased_nofile_rlimit = {0};
 
 void
 increase_nofile_limit(void)
@@ -25,7 +26,9 @@ increase_nofile_limit(void)
 
 		wlr_log(WLR_INFO, "Running with %d max open files",
 			(int)original_nofile_rlimit.rlim_cur);
+		return;
 	}
+	increased_nofile_rlimit = new_rlimit;
 }
 
 void
@@ -40,3 +43,16 @@ restore_nofile_limit(void)
 			"Failed to restore max open files limit: setrlimit(NOFILE) failed");
 	}
 }
+
+void
+reapply_nofile_limit(void)
+{
+	if (increased_nofile_rlimit.rlim_cur == 0) {
+		return;
+	}
+
+	if (setrlimit(RLIMIT_NOFILE, &increased_nofile_rlimit) != 0) {
+		wlr_log_errno(WLR_ERROR,
+			"Failed to bump max open files limit: setrlimit(NOFILE) failed");
+	}
+}
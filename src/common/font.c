@@ -2,11 +2,16 @@
 #include <cairo.h>
 #include <drm_fourcc.h>
 #include <pango/pangocairo.h>
+#include <stdint.h>
+#include <string.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/util/box.h>
 #include <wlr/util/log.h>
 #include "common/font.h"
+#include "common/glyph-cache.h"
 #include "common/graphic-helpers.h"
+#include "common/hash.h"
+#include "common/int-map.h"
 #include "common/string-helpers.h"
 #include "labwc.h"
 #include "buffer.h"
@@ -26,38 +31,185 @@ font_to_pango_desc(struct font *font)
 	return desc;
 }
 
-static PangoRectangle
-font_extents(struct font *font, const char *string)
-{
-	PangoRectangle rect = { 0 };
-	if (!string) {
-		return rect;
-	}
+/*
+ * Text is measured for menu widths, OSD layout and every font buffer, often
+ * for the same strings again (e.g. when menus are re-created). Measuring
+ * uses one persistent layout and a few cached font descriptions, and the
+ * results are kept in a small LRU cache.
+ */
+#define FONT_DESC_CACHE_SIZE 8
+#define EXTENTS_CACHE_SIZE 256
+
+struct cached_desc {
+	char *name;
+	int size;
+	enum font_slant slant;
+	enum font_weight weight;
+	PangoFontDescription *desc;
+};
+
+struct cached_extents {
+	uint64_t hash;
+	struct font font; /* name is owned */
+	char *text;
+	PangoRectangle rect;
+	struct wl_list link; /* most recently used first */
+};
+
+static struct {
 	cairo_surface_t *surface;
-	cairo_t *c;
+	cairo_t *cairo;
 	PangoLayout *layout;
+	struct cached_desc descs[FONT_DESC_CACHE_SIZE];
+	size_t next_desc; /* replaced next when all are in use */
+	struct int_map extents; /* keyed by hash */
+	struct wl_list lru;
+	size_t nr_extents;
+} measure = {
+	.lru = { &measure.lru, &measure.lru },
+};
 
-	surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
-	c = cairo_create(surface);
-	layout = pango_cairo_create_layout(c);
-	PangoFontDescription *desc = font_to_pango_desc(font);
+static bool
+font_equal(struct font *a, struct font *b)
+{
+	return a->size == b->size && a->slant == b->slant
+		&& a->weight == b->weight
+		&& (a->name == b->name
+			|| (a->name && b->name && !strcmp(a->name, b->name)));
+}
 
-	pango_layout_set_font_description(layout, desc);
-	pango_layout_set_text(layout, string, -1);
+static PangoFontDescription *
+get_font_desc(struct font *font)
+{
+	for (size_t i = 0; i < FONT_DESC_CACHE_SIZE; i++) {
+		struct cached_desc *cached = &measure.descs[i];
+		struct font key = {
+			.name = cached->name,
+			.size = cached->size,
+			.slant = cached->slant,
+			.weight = cached->weight,
+		};
+		if (cached->desc && font_equal(&key, font)) {
+			return cached->desc;
+		}
+	}
+
+	struct cached_desc *cached = &measure.descs[measure.next_desc];
+	measure.next_desc = (measure.next_desc + 1) % FONT_DESC_CACHE_SIZE;
+	if (cached->desc) {
+		pango_font_description_free(cached->desc);
+		g_free(cached->name);
+	}
+	cached->name = g_strdup(font->name);
+	cached->size = font->size;
+	cached->slant = font->slant;
+	cached->weight = font->weight;
+	cached->desc = font_to_pango_desc(font);
+	return cached->desc;
+}
+
+static uint64_t
+hash_extents_key(struct font *font, const char *string)
+{
+	uint64_t hash = HASH_INIT;
+	const char *strings[] = { font->name ? font->name : "", string };
+	for (size_t i = 0; i < 2; i++) {
+		/* Include the terminator so that "ab" + "c" != "a" + "bc" */
+		hash = hash_bytes(hash, strings[i], strlen(strings[i]) + 1);
+	}
+	int values[] = { font->size, font->slant, font->weight };
+	for (size_t i = 0; i < 3; i++) {
+		hash = hash_value(hash, (uint32_t)values[i]);
+	}
+	return hash;
+}
+
+static void
+cached_extents_destroy(struct cached_extents *entry)
+{
+	int_map_remove(&measure.extents, entry->hash);
+	wl_list_remove(&entry->link);
+	g_free(entry->font.name);
+	g_free(entry->text);
+	g_free(entry);
+	measure.nr_extents--;
+}
+
+static PangoLayout *
+create_measure_layout(cairo_t *cairo)
+{
+	PangoLayout *layout = pango_cairo_create_layout(cairo);
 	pango_layout_set_single_paragraph_mode(layout, TRUE);
 	pango_layout_set_width(layout, -1);
 	pango_layout_set_ellipsize(layout, PANGO_ELLIPSIZE_MIDDLE);
+	return layout;
+}
+
+static PangoRectangle
+layout_extents(PangoLayout *layout, const char *string)
+{
+	PangoRectangle rect = { 0 };
+	pango_layout_set_text(layout, string, -1);
 	pango_layout_get_extents(layout, NULL, &rect);
 	pango_extents_to_pixels(&rect, NULL);
 
 	/* we put a 2 px edge on each side - because Openbox does it :) */
 	/* TODO: remove the 4 pixel addition and always do the padding by the caller */
 	rect.width += 4;
+	return rect;
+}
 
-	cairo_destroy(c);
-	cairo_surface_destroy(surface);
-	pango_font_description_free(desc);
-	g_object_unref(layout);
+static PangoRectangle
+measure_text(struct font *font, const char *string)
+{
+	if (!measure.layout) {
+		measure.surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
+		measure.cairo = cairo_create(measure.surface);
+		measure.layout = create_measure_layout(measure.cairo);
+	}
+
+	/* Does nothing if the description is the same as last time */
+	pango_layout_set_font_description(measure.layout, get_font_desc(font));
+	return layout_extents(measure.layout, string);
+}
+
+static PangoRectangle
+font_extents(struct font *font, const char *string)
+{
+	PangoRectangle rect = { 0 };
+	if (!string) {
+		return rect;
+	}
+
+	uint64_t hash = hash_extents_key(font, string);
+	struct cached_extents *entry = int_map_lookup(&measure.extents, hash);
+	if (entry && font_equal(&entry->font, font)
+			&& !strcmp(entry->text, string)) {
+		wl_list_remove(&entry->link);
+		wl_list_insert(&measure.lru, &entry->link);
+		return entry->rect;
+	}
+	if (entry) {
+		/* Hash collision, the newer string wins */
+		cached_extents_destroy(entry);
+	}
+
+	rect = measure_text(font, string);
+
+	if (measure.nr_extents >= EXTENTS_CACHE_SIZE) {
+		struct cached_extents *oldest =
+			wl_container_of(measure.lru.prev, oldest, link);
+		cached_extents_destroy(oldest);
+	}
+	entry = g_new0(struct cached_extents, 1);
+	entry->hash = hash;
+	entry->font = *font;
+	entry->font.name = g_strdup(font->name);
+	entry->text = g_strdup(string);
+	entry->rect = rect;
+	wl_list_insert(&measure.lru, &entry->link);
+	int_map_insert(&measure.extents, hash, entry);
+	measure.nr_extents++;
 	return rect;
 }
 
@@ -75,6 +227,31 @@ font_width(struct font *font, const char *string)
 	return rectangle.width;
 }
 
+void
+font_measure_widths(struct font *font, const char *const *strings, size_t nr,
+		int *widths)
+{
+	if (!nr) {
+		return;
+	}
+	/* Pango objects must not be shared with the main thread */
+	cairo_surface_t *surface =
+		cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
+	cairo_t *cairo = cairo_create(surface);
+	PangoLayout *layout = create_measure_layout(cairo);
+	PangoFontDescription *desc = font_to_pango_desc(font);
+	pango_layout_set_font_description(layout, desc);
+	pango_font_description_free(desc);
+
+	for (size_t i = 0; i < nr; i++) {
+		widths[i] = layout_extents(layout, strings[i]).width;
+	}
+
+	g_object_unref(layout);
+	cairo_destroy(cairo);
+	cairo_surface_destroy(surface);
+}
+
 void
 font_buffer_create(struct lab_data_buffer **buffer, int max_width,
 	const char *text, struct font *font, const float *color,
@@ -128,9 +305,14 @@ font_buffer_create(struct lab_data_buffer **buffer, int max_width,
 	 * (about 0.996) but leave some margin for rounding errors.
 	 */
 	bool opaque_bg = (bg_color[3] > 0.999f);
+	/* Cached glyphs are drawn on top of any background */
+	bool use_glyph_cache = rc.glyph_cache;
 	if (opaque_bg) {
 		set_cairo_color(cairo, bg_color);
 		cairo_paint(cairo);
+		pixman_region32_union_rect(&(*buffer)->opaque_region,
+			&(*buffer)->opaque_region, 0, 0,
+			(*buffer)->unscaled_width, (*buffer)->unscaled_height);
 	}
 
 	set_cairo_color(cairo, color);
@@ -141,7 +323,7 @@ font_buffer_create(struct lab_data_buffer **buffer, int max_width,
 	pango_layout_set_text(layout, text, -1);
 	pango_layout_set_ellipsize(layout, PANGO_ELLIPSIZE_END);
 
-	if (!opaque_bg) {
+	if (!opaque_bg || use_glyph_cache) {
 		/* disable subpixel rendering */
 		cairo_font_options_t *opts = cairo_font_options_create();
 		cairo_font_options_set_antialias(opts, CAIRO_ANTIALIAS_GRAY);
@@ -154,13 +336,21 @@ font_buffer_create(struct lab_data_buffer **buffer, int max_width,
 	pango_layout_set_font_description(layout, desc);
 	pango_font_description_free(desc);
 	pango_cairo_update_layout(cairo, layout);
-	pango_cairo_show_layout(cairo, layout);
+	if (use_glyph_cache) {
+		glyph_cache_show_layout(cairo, layout, color, scale);
+	} else {
+		pango_cairo_show_layout(cairo, layout);
+	}
 
 	if (arrow) {
 		cairo_move_to(cairo, text_extents.width, 0);
 		pango_layout_set_width(layout, arrow_extents.width * PANGO_SCALE);
 		pango_layout_set_text(layout, arrow, -1);
-		pango_cairo_show_layout(cairo, layout);
+		if (use_glyph_cache) {
+			glyph_cache_show_layout(cairo, layout, color, scale);
+		} else {
+			pango_cairo_show_layout(cairo, layout);
+		}
 	}
 
 	g_object_unref(layout);
@@ -168,8 +358,39 @@ font_buffer_create(struct lab_data_buffer **buffer, int max_width,
 	cairo_surface_flush(surf);
 }
 
+void
+font_shed_caches(void)
+{
+	struct cached_extents *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &measure.lru, link) {
+		cached_extents_destroy(entry);
+	}
+	int_map_finish(&measure.extents);
+	glyph_cache_finish();
+}
+
 void
 font_finish(void)
 {
+	struct cached_extents *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &measure.lru, link) {
+		cached_extents_destroy(entry);
+	}
+	int_map_finish(&measure.extents);
+	for (size_t i = 0; i < FONT_DESC_CACHE_SIZE; i++) {
+		struct cached_desc *cached = &measure.descs[i];
+		if (cached->desc) {
+			pango_font_description_free(cached->desc);
+			g_free(cached->name);
+		}
+		*cached = (struct cached_desc){0};
+	}
+	if (measure.layout) {
+		g_object_unref(measure.layout);
+		cairo_destroy(measure.cairo);
+		cairo_surface_destroy(measure.surface);
+		measure.layout = NULL;
+	}
+	glyph_cache_finish();
 	pango_cairo_font_map_set_default(NULL);
 }
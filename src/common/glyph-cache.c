@@ -0,0 +1,205 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <cairo.h>
+#include <math.h>
+#include <pango/pangocairo.h>
+#include <stdint.h>
+#include <string.h>
+#include <wayland-util.h>
+#include "common/glyph-cache.h"
+#include "common/graphic-helpers.h"
+#include "common/hash.h"
+#include "common/int-map.h"
+
+/* Enough for the glyphs of a few fonts in a few colors and scales */
+#define GLYPH_CACHE_SIZE 2048
+
+struct cached_glyph {
+	uint64_t hash;
+	PangoFont *font; /* referenced */
+	PangoGlyph glyph;
+	double scale;
+	float color[4];
+	/* NULL for glyphs without ink, e.g. spaces */
+	cairo_surface_t *surface;
+	/* Offset of the image from the glyph origin in device pixels */
+	int x, y;
+	struct wl_list link; /* most recently used first */
+};
+
+static struct {
+	struct int_map glyphs; /* keyed by hash */
+	struct wl_list lru;
+	size_t nr_glyphs;
+} cache = {
+	.lru = { &cache.lru, &cache.lru },
+};
+
+static uint64_t
+hash_key(PangoFont *font, PangoGlyph glyph, double scale, const float *color)
+{
+	uint64_t hash = HASH_INIT;
+	hash = hash_bytes(hash, &font, sizeof(font));
+	hash = hash_bytes(hash, &glyph, sizeof(glyph));
+	hash = hash_bytes(hash, &scale, sizeof(scale));
+	return hash_bytes(hash, color, 4 * sizeof(*color));
+}
+
+static void
+cached_glyph_destroy(struct cached_glyph *entry)
+{
+	int_map_remove(&cache.glyphs, entry->hash);
+	wl_list_remove(&entry->link);
+	if (entry->surface) {
+		cairo_surface_destroy(entry->surface);
+	}
+	g_object_unref(entry->font);
+	g_free(entry);
+	cache.nr_glyphs--;
+}
+
+static void
+rasterize_glyph(struct cached_glyph *entry)
+{
+	PangoRectangle ink;
+	pango_font_get_glyph_extents(entry->font, entry->glyph, &ink, NULL);
+	if (ink.width <= 0 || ink.height <= 0) {
+		return;
+	}
+
+	/* Ink extents in device pixels plus a pixel for antialiasing */
+	double s = entry->scale / PANGO_SCALE;
+	int x0 = (int)floor(ink.x * s) - 1;
+	int y0 = (int)floor(ink.y * s) - 1;
+	int x1 = (int)ceil((ink.x + ink.width) * s) + 1;
+	int y1 = (int)ceil((ink.y + ink.height) * s) + 1;
+
+	cairo_surface_t *surface = cairo_image_surface_create(
+		CAIRO_FORMAT_ARGB32, x1 - x0, y1 - y0);
+	cairo_t *cairo = cairo_create(surface);
+	cairo_translate(cairo, -x0, -y0);
+	cairo_scale(cairo, entry->scale, entry->scale);
+	cairo_move_to(cairo, 0, 0);
+	set_cairo_color(cairo, entry->color);
+
+	PangoGlyphString *glyphs = pango_glyph_string_new();
+	pango_glyph_string_set_size(glyphs, 1);
+	glyphs->glyphs[0] = (PangoGlyphInfo){ .glyph = entry->glyph };
+	pango_cairo_show_glyph_string(cairo, entry->font, glyphs);
+	pango_glyph_string_free(glyphs);
+
+	cairo_destroy(cairo);
+	cairo_surface_flush(surface);
+	entry->surface = surface;
+	entry->x = x0;
+	entry->y = y0;
+}
+
+static struct cached_glyph *
+get_glyph(PangoFont *font, PangoGlyph glyph, double scale, const float *color)
+{
+	uint64_t hash = hash_key(font, glyph, scale, color);
+	struct cached_glyph *entry = int_map_lookup(&cache.glyphs, hash);
+	if (entry && entry->font == font && entry->glyph == glyph
+			&& entry->scale == scale
+			&& !memcmp(entry->color, color, sizeof(entry->color))) {
+		wl_list_remove(&entry->link);
+		wl_list_insert(&cache.lru, &entry->link);
+		return entry;
+	}
+	if (entry) {
+		/* Hash collision, the newer glyph wins */
+		cached_glyph_destroy(entry);
+	}
+	if (cache.nr_glyphs >= GLYPH_CACHE_SIZE) {
+		struct cached_glyph *oldest =
+			wl_container_of(cache.lru.prev, oldest, link);
+		cached_glyph_destroy(oldest);
+	}
+
+	entry = g_new0(struct cached_glyph, 1);
+	entry->hash = hash;
+	/* Keeps the pointer unique for as long as it is part of the key */
+	entry->font = g_object_ref(font);
+	entry->glyph = glyph;
+	entry->scale = scale;
+	memcpy(entry->color, color, sizeof(entry->color));
+	rasterize_glyph(entry);
+
+	wl_list_insert(&cache.lru, &entry->link);
+	int_map_insert(&cache.glyphs, hash, entry);
+	cache.nr_glyphs++;
+	return entry;
+}
+
+static void
+show_run(cairo_t *cairo, PangoLayoutRun *run, double x, double y,
+		const float *color, double scale)
+{
+	PangoFont *font = run->item->analysis.font;
+	PangoGlyphString *glyphs = run->glyphs;
+	for (int i = 0; i < glyphs->num_glyphs; i++) {
+		PangoGlyphInfo *info = &glyphs->glyphs[i];
+		double gx = x + (double)info->geometry.x_offset / PANGO_SCALE * scale;
+		double gy = y + (double)info->geometry.y_offset / PANGO_SCALE * scale;
+		x += (double)info->geometry.width / PANGO_SCALE * scale;
+		if (info->glyph == PANGO_GLYPH_EMPTY) {
+			continue;
+		}
+
+		struct cached_glyph *entry =
+			get_glyph(font, info->glyph, scale, color);
+		if (!entry->surface) {
+			continue;
+		}
+		/* Glyph origins are rounded to whole device pixels */
+		int dx = (int)lround(gx) + entry->x;
+		int dy = (int)lround(gy) + entry->y;
+		cairo_set_source_surface(cairo, entry->surface, dx, dy);
+		cairo_rectangle(cairo, dx, dy,
+			cairo_image_surface_get_width(entry->surface),
+			cairo_image_surface_get_height(entry->surface));
+		cairo_fill(cairo);
+	}
+}
+
+void
+glyph_cache_show_layout(cairo_t *cairo, PangoLayout *layout,
+		const float *color, double scale)
+{
+	/* The layout's top left corner in device pixels */
+	double origin_x, origin_y;
+	cairo_get_current_point(cairo, &origin_x, &origin_y);
+	cairo_user_to_device(cairo, &origin_x, &origin_y);
+
+	cairo_save(cairo);
+	cairo_identity_matrix(cairo);
+
+	PangoLayoutIter *iter = pango_layout_get_iter(layout);
+	do {
+		PangoLayoutRun *run = pango_layout_iter_get_run_readonly(iter);
+		if (!run) {
+			/* End of a line */
+			continue;
+		}
+		PangoRectangle logical;
+		pango_layout_iter_get_run_extents(iter, NULL, &logical);
+		int baseline = pango_layout_iter_get_baseline(iter);
+		show_run(cairo, run,
+			origin_x + (double)logical.x / PANGO_SCALE * scale,
+			origin_y + (double)baseline / PANGO_SCALE * scale,
+			color, scale);
+	} while (pango_layout_iter_next_run(iter));
+	pango_layout_iter_free(iter);
+
+	cairo_restore(cairo);
+}
+
+void
+glyph_cache_finish(void)
+{
+	struct cached_glyph *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &cache.lru, link) {
+		cached_glyph_destroy(entry);
+	}
+	int_map_finish(&cache.glyphs);
+}
@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <assert.h>
+#include <string.h>
+#include "common/histogram.h"
+#include "common/macros.h"
+
+/* log2(HISTOGRAM_SUB_BUCKETS) */
+#define SUB_BUCKET_BITS 2
+
+static uint32_t
+most_significant_bit(uint32_t value)
+{
+	uint32_t msb = 0;
+	while (value >>= 1) {
+		msb++;
+	}
+	return msb;
+}
+
+static uint32_t
+bucket_index(uint32_t value)
+{
+	if (value < HISTOGRAM_SUB_BUCKETS) {
+		return value;
+	}
+	uint32_t msb = most_significant_bit(value);
+	uint32_t shift = msb - SUB_BUCKET_BITS;
+	uint32_t sub = (value >> shift) & (HISTOGRAM_SUB_BUCKETS - 1);
+	return (shift + 1) * HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+static uint32_t
+bucket_upper_bound(uint32_t index)
+{
+	if (index < HISTOGRAM_SUB_BUCKETS) {
+		return index;
+	}
+	uint32_t shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+	uint32_t sub = index % HISTOGRAM_SUB_BUCKETS;
+	uint64_t lower = (uint64_t)(HISTOGRAM_SUB_BUCKETS + sub) << shift;
+	uint64_t upper = lower + ((uint64_t)1 << shift) - 1;
+	return upper > UINT32_MAX ? UINT32_MAX : (uint32_t)upper;
+}
+
+void
+histogram_add(struct histogram *hist, uint32_t value)
+{
+	uint32_t index = bucket_index(value);
+	assert(index < ARRAY_SIZE(hist->buckets));
+	hist->buckets[index]++;
+	hist->count++;
+	hist->sum += value;
+	hist->max = MAX(hist->max, value);
+}
+
+uint32_t
+histogram_percentile(struct histogram *hist, double percentile)
+{
+	if (!hist->count) {
+		return 0;
+	}
+	uint64_t target = (uint64_t)(hist->count * percentile / 100.0 + 0.5);
+	target = MAX(target, 1);
+
+	uint64_t seen = 0;
+	for (uint32_t i = 0; i < ARRAY_SIZE(hist->buckets); i++) {
+		seen += hist->buckets[i];
+		if (seen >= target) {
+			return MIN(bucket_upper_bound(i), hist->max);
+		}
+	}
+	return hist->max;
+}
+
+void
+histogram_reset(struct histogram *hist)
+{
+	memset(hist, 0, sizeof(*hist));
+}
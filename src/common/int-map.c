@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <assert.h>
+#include <stdlib.h>
+#include "common/int-map.h"
+#include "common/mem.h"
+
+#define INT_MAP_MIN_CAPACITY 16
+
+static uint64_t
+hash(uint64_t key)
+{
+	/* splitmix64 finalizer */
+	key ^= key >> 30;
+	key *= 0xbf58476d1ce4e5b9ULL;
+	key ^= key >> 27;
+	key *= 0x94d049bb133111ebULL;
+	key ^= key >> 31;
+	return key;
+}
+
+static struct int_map_entry *
+find_slot(struct int_map_entry *entries, size_t capacity, uint64_t key)
+{
+	/* capacity is a power of two and never full */
+	size_t i = hash(key) & (capacity - 1);
+	while (entries[i].value && entries[i].key != key) {
+		i = (i + 1) & (capacity - 1);
+	}
+	return &entries[i];
+}
+
+static void
+grow(struct int_map *map)
+{
+	size_t capacity = map->capacity ? map->capacity * 2 : INT_MAP_MIN_CAPACITY;
+	struct int_map_entry *entries = znew_n(*entries, capacity);
+	for (size_t i = 0; i < map->capacity; i++) {
+		struct int_map_entry *entry = &map->entries[i];
+		if (entry->value) {
+			*find_slot(entries, capacity, entry->key) = *entry;
+		}
+	}
+	free(map->entries);
+	map->entries = entries;
+	map->capacity = capacity;
+}
+
+bool
+int_map_insert(struct int_map *map, uint64_t key, void *value)
+{
+	assert(value);
+
+	/* Keep the load factor below 3/4 */
+	if ((map->count + 1) * 4 > map->capacity * 3) {
+		grow(map);
+	}
+	struct int_map_entry *slot = find_slot(map->entries, map->capacity, key);
+	if (slot->value) {
+		return false;
+	}
+	slot->key = key;
+	slot->value = value;
+	map->count++;
+	return true;
+}
+
+void *
+int_map_lookup(struct int_map *map, uint64_t key)
+{
+	if (!map->count) {
+		return NULL;
+	}
+	return find_slot(map->entries, map->capacity, key)->value;
+}
+
+void *
+int_map_remove(struct int_map *map, uint64_t key)
+{
+	if (!map->count) {
+		return NULL;
+	}
+	size_t mask = map->capacity - 1;
+	struct int_map_entry *slot = find_slot(map->entries, map->capacity, key);
+	void *value = slot->value;
+	if (!value) {
+		return NULL;
+	}
+	slot->value = NULL;
+	map->count--;
+
+	/*
+	 * Shift back following entries of the probe sequence which would
+	 * otherwise become unreachable through the freed slot
+	 */
+	size_t i = slot - map->entries;
+	size_t j = i;
+	while (true) {
+		j = (j + 1) & mask;
+		if (!map->entries[j].value) {
+			break;
+		}
+		size_t home = hash(map->entries[j].key) & mask;
+		/* Entries whose home slot lies within (i, j] can stay */
+		bool in_place = i <= j ? (i < home && home <= j)
+			: (i < home || home <= j);
+		if (in_place) {
+			continue;
+		}
+		map->entries[i] = map->entries[j];
+		map->entries[j].value = NULL;
+		i = j;
+	}
+	return value;
+}
+
+void
+int_map_finish(struct int_map *map)
+{
+	zfree(map->entries);
+	map->capacity = 0;
+	map->count = 0;
+}
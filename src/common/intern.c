@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common/hash.h"
+#include "common/int-map.h"
+#include "common/intern.h"
+#include "common/mem.h"
+
+struct interned {
+	uint64_t hash;
+	uint32_t refs;
+	struct interned *next; /* same hash */
+	char str[];
+};
+
+/* Keyed by hash, values are chains of struct interned */
+static struct int_map strings;
+
+static struct interned *
+interned_from_str(const char *str)
+{
+	return (struct interned *)(str - offsetof(struct interned, str));
+}
+
+const char *
+intern_string(const char *str)
+{
+	if (!str) {
+		return NULL;
+	}
+	uint64_t hash = hash_str(HASH_INIT, str);
+	struct interned *head = int_map_lookup(&strings, hash);
+	for (struct interned *entry = head; entry; entry = entry->next) {
+		if (!strcmp(entry->str, str)) {
+			entry->refs++;
+			return entry->str;
+		}
+	}
+
+	size_t len = strlen(str) + 1;
+	struct interned *entry = xzalloc(sizeof(*entry) + len);
+	entry->hash = hash;
+	entry->refs = 1;
+	memcpy(entry->str, str, len);
+	if (head) {
+		entry->next = head->next;
+		head->next = entry;
+	} else {
+		int_map_insert(&strings, hash, entry);
+	}
+	return entry->str;
+}
+
+const char *
+intern_ref(const char *interned)
+{
+	if (interned) {
+		interned_from_str(interned)->refs++;
+	}
+	return interned;
+}
+
+void
+intern_release(const char *interned)
+{
+	if (!interned) {
+		return;
+	}
+	struct interned *entry = interned_from_str(interned);
+	assert(entry->refs > 0);
+	if (--entry->refs) {
+		return;
+	}
+
+	struct interned *head = int_map_lookup(&strings, entry->hash);
+	if (head == entry) {
+		int_map_remove(&strings, entry->hash);
+		if (entry->next) {
+			int_map_insert(&strings, entry->hash, entry->next);
+		}
+	} else {
+		while (head->next != entry) {
+			head = head->next;
+		}
+		head->next = entry->next;
+	}
+	free(entry);
+	if (!strings.count) {
+		int_map_finish(&strings);
+	}
+}
@@ -1,6 +1,8 @@
 // SPDX-License-Identifier: GPL-2.0-only
 
 #include <fnmatch.h>
+#include <string.h>
+#include <strings.h>
 #include "common/match.h"
 
 bool
@@ -8,3 +10,69 @@ match_glob(const char *pattern, const char *string)
 {
 	return fnmatch(pattern, string, FNM_CASEFOLD) == 0;
 }
+
+static bool
+is_plain(const char *text, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		unsigned char c = text[i];
+		/*
+		 * Leave anything special to fnmatch() as well as non-ASCII
+		 * characters, whose case folding depends on the locale.
+		 */
+		if (c == '*' || c == '?' || c == '[' || c == '\\' || c >= 0x80) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void
+match_pattern_compile(struct match_pattern *match, const char *pattern)
+{
+	size_t len = strlen(pattern);
+
+	*match = (struct match_pattern){
+		.kind = LAB_MATCH_GLOB,
+		.pattern = pattern,
+	};
+
+	if (len == 1 && pattern[0] == '*') {
+		match->kind = LAB_MATCH_ANY;
+	} else if (is_plain(pattern, len)) {
+		match->kind = LAB_MATCH_LITERAL;
+		match->text = pattern;
+		match->len = len;
+	} else if (len > 1 && pattern[len - 1] == '*'
+			&& is_plain(pattern, len - 1)) {
+		match->kind = LAB_MATCH_PREFIX;
+		match->text = pattern;
+		match->len = len - 1;
+	} else if (len > 1 && pattern[0] == '*'
+			&& is_plain(pattern + 1, len - 1)) {
+		match->kind = LAB_MATCH_SUFFIX;
+		match->text = pattern + 1;
+		match->len = len - 1;
+	}
+}
+
+bool
+match_pattern(const struct match_pattern *match, const char *string)
+{
+	switch (match->kind) {
+	case LAB_MATCH_ANY:
+		return true;
+	case LAB_MATCH_LITERAL:
+		return !strcasecmp(match->text, string);
+	case LAB_MATCH_PREFIX:
+		return !strncasecmp(match->text, string, match->len);
+	case LAB_MATCH_SUFFIX: {
+		size_t len = strlen(string);
+		return len >= match->len
+			&& !strcasecmp(match->text, string + len - match->len);
+	}
+	case LAB_MATCH_GLOB:
+		break;
+	}
+	return match_glob(match->pattern, string);
+}
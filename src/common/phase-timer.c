@@ -0,0 +1,121 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <stdint.h>
+#include <stdio.h>
+#include <wlr/util/log.h>
+#include "common/phase-timer.h"
+#include "common/time-helpers.h"
+#include "flight-recorder.h"
+
+#define MAX_PHASES 32
+
+static struct {
+	const char *operation; /* NULL when not timing */
+	int64_t start_nsec;
+	int64_t last_nsec;
+	int nr_phases;
+	int nr_tasks;
+	struct {
+		const char *name;
+		int64_t duration_nsec;
+	} phases[MAX_PHASES];
+} timer;
+
+static double
+nsec_to_msec(int64_t nsec)
+{
+	return (double)nsec / 1000000;
+}
+
+void
+phase_timer_begin(const char *operation)
+{
+	timer.operation = operation;
+	timer.start_nsec = time_now_nsec();
+	timer.last_nsec = timer.start_nsec;
+	timer.nr_phases = 0;
+	timer.nr_tasks = 0;
+	flight_record(FLIGHT_EVENT_PHASE, 0, flight_recorder_string(operation),
+		flight_recorder_string("begin"));
+}
+
+void
+phase_timer_mark(const char *phase)
+{
+	if (!timer.operation) {
+		return;
+	}
+	int64_t now = time_now_nsec();
+	int64_t duration = now - timer.last_nsec;
+	timer.last_nsec = now;
+	flight_record(FLIGHT_EVENT_PHASE, 0,
+		flight_recorder_string(timer.operation),
+		flight_recorder_string(phase));
+	wlr_log(WLR_DEBUG, "%s: %s took %.2f ms", timer.operation, phase,
+		nsec_to_msec(duration));
+
+	if (timer.nr_phases < MAX_PHASES) {
+		timer.phases[timer.nr_phases].name = phase;
+		timer.phases[timer.nr_phases].duration_nsec = duration;
+		timer.nr_phases++;
+	}
+}
+
+void
+phase_timer_end(void)
+{
+	if (!timer.operation) {
+		return;
+	}
+
+	char summary[1024] = { 0 };
+	size_t len = 0;
+	for (int i = 0; i < timer.nr_phases && len < sizeof(summary); i++) {
+		int ret = snprintf(summary + len, sizeof(summary) - len,
+			"%s%s %.1f", i ? ", " : "", timer.phases[i].name,
+			nsec_to_msec(timer.phases[i].duration_nsec));
+		if (ret < 0) {
+			break;
+		}
+		len += ret;
+	}
+	if (timer.nr_tasks && len < sizeof(summary)) {
+		snprintf(summary + len, sizeof(summary) - len,
+			"%s%d in background", len ? ", " : "", timer.nr_tasks);
+	}
+	wlr_log(WLR_INFO, "%s took %.2f ms (%s)", timer.operation,
+		nsec_to_msec(timer.last_nsec - timer.start_nsec), summary);
+	flight_record(FLIGHT_EVENT_PHASE, 0,
+		flight_recorder_string(timer.operation),
+		flight_recorder_string("end"));
+	timer.operation = NULL;
+}
+
+void
+phase_timer_task_begin(struct phase_timer_task *task, const char *name)
+{
+	task->name = name;
+	task->operation = timer.operation;
+	task->operation_start_nsec = timer.start_nsec;
+	task->start_nsec = time_now_nsec();
+	if (timer.operation) {
+		timer.nr_tasks++;
+		wlr_log(WLR_DEBUG, "%s: %s started in background",
+			timer.operation, name);
+	}
+}
+
+void
+phase_timer_task_end(struct phase_timer_task *task)
+{
+	int64_t now = time_now_nsec();
+	if (!task->operation) {
+		wlr_log(WLR_DEBUG, "%s took %.2f ms", task->name,
+			nsec_to_msec(now - task->start_nsec));
+		return;
+	}
+	wlr_log(WLR_INFO, "%s: %s took %.2f ms in background, done %.2f ms "
+		"after %s began", task->operation, task->name,
+		nsec_to_msec(now - task->start_nsec),
+		nsec_to_msec(now - task->operation_start_nsec),
+		task->operation);
+}
@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common/mem.h"
+#include "common/pool.h"
+
+void *
+pool_alloc(struct pool *pool)
+{
+	assert(pool->size >= sizeof(void *));
+	void *obj = pool->free;
+	if (!obj) {
+		return xzalloc(pool->size);
+	}
+	pool->free = *(void **)obj;
+	pool->nr_free--;
+	memset(obj, 0, pool->size);
+	return obj;
+}
+
+void
+pool_free(struct pool *pool, void *obj)
+{
+	if (!obj) {
+		return;
+	}
+	if (pool->nr_free >= POOL_MAX_FREE) {
+		free(obj);
+		return;
+	}
+	*(void **)obj = pool->free;
+	pool->free = obj;
+	pool->nr_free++;
+}
+
+void
+pool_finish(struct pool *pool)
+{
+	while (pool->free) {
+		void *obj = pool->free;
+		pool->free = *(void **)obj;
+		free(obj);
+	}
+	pool->nr_free = 0;
+}
@@ -0,0 +1,121 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "common/mem.h"
+#include "common/prefetch.h"
+
+/* Larger files, e.g. big images, are not worth holding up the thread */
+#define PREFETCH_MAX_FILE_SIZE (4 * 1024 * 1024)
+
+static bool running;
+static pthread_t thread;
+
+static void
+read_file(int dir_fd, const char *name)
+{
+	int fd = openat(dir_fd, name, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return;
+	}
+	struct stat st;
+	if (fstat(fd, &st) || !S_ISREG(st.st_mode)
+			|| st.st_size > PREFETCH_MAX_FILE_SIZE) {
+		close(fd);
+		return;
+	}
+	char buf[16384];
+	while (read(fd, buf, sizeof(buf)) > 0) {
+		/* Just fill the page cache */
+	}
+	close(fd);
+}
+
+static void
+read_dir(const char *path)
+{
+	DIR *dir = opendir(path);
+	if (!dir) {
+		return;
+	}
+	struct dirent *entry;
+	while ((entry = readdir(dir))) {
+		if (entry->d_name[0] != '.') {
+			read_file(dirfd(dir), entry->d_name);
+		}
+	}
+	closedir(dir);
+}
+
+static void *
+prefetch_thread(void *data)
+{
+	char **paths = data;
+	for (char **path = paths; *path; path++) {
+		struct stat st;
+		if (stat(*path, &st)) {
+			continue;
+		}
+		if (S_ISDIR(st.st_mode)) {
+			read_dir(*path);
+		} else {
+			read_file(AT_FDCWD, *path);
+		}
+	}
+	for (char **path = paths; *path; path++) {
+		free(*path);
+	}
+	free(paths);
+	return NULL;
+}
+
+void
+prefetch_start(const char *const *paths)
+{
+	prefetch_finish();
+
+	size_t nr_paths = 0;
+	while (paths[nr_paths]) {
+		nr_paths++;
+	}
+	char **copy = znew_n(char *, nr_paths + 1);
+	for (size_t i = 0; i < nr_paths; i++) {
+		copy[i] = xstrdup(paths[i]);
+	}
+
+	/* Signals are handled by the event loop of the main thread */
+	sigset_t mask, old_mask;
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, &old_mask);
+	int ret = pthread_create(&thread, NULL, prefetch_thread, copy);
+	pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+	if (ret) {
+		wlr_log(WLR_ERROR, "failed to start prefetch thread: %s",
+			strerror(ret));
+		/* Freed by the thread otherwise */
+		for (size_t i = 0; i < nr_paths; i++) {
+			free(copy[i]);
+		}
+		free(copy);
+		return;
+	}
+	running = true;
+}
+
+void
+prefetch_finish(void)
+{
+	if (!running) {
+		return;
+	}
+	pthread_join(thread, NULL);
+	running = false;
+}
@@ -1,25 +1,210 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <wayland-server-core.h>
+#include <wlr/types/wlr_buffer.h>
 #include <wlr/util/log.h>
 #include "buffer.h"
 #include "common/font.h"
+#include "common/hash.h"
+#include "common/int-map.h"
+#include "common/intern.h"
 #include "common/mem.h"
 #include "common/scaled_scene_buffer.h"
 #include "common/scaled_font_buffer.h"
 
+/*
+ * Rendered text is shared between all font buffers showing the same text
+ * with the same font, colors, max_width and scale - for example the titles
+ * of many terminal windows or menu items repeated across menus.
+ *
+ * Cached buffers hold one lock of their own, all other locks belong to
+ * consumers (the scaled_scene_buffer caches and wlr_scene). Up to
+ * TEXT_CACHE_MAX_UNUSED buffers only locked by the cache are kept, so that
+ * e.g. menu items re-created on Reconfigure don't have to be rendered
+ * again. The least recently used of them are dropped first.
+ */
+#define TEXT_CACHE_MAX_UNUSED 256
+
+struct cached_text {
+	uint64_t hash;
+	/* Interned like those of struct scaled_font_buffer */
+	const char *text;
+	const char *arrow;
+	struct font font;
+	float color[4];
+	float bg_color[4];
+	int max_width;
+	double scale;
+	struct lab_data_buffer *buffer;
+	uint64_t last_used;
+	struct cached_text *next; /* same hash */
+};
+
+/* Keyed by hash, values are chains of struct cached_text */
+static struct int_map text_cache;
+static uint64_t use_counter;
+
+/* Strings are interned, so hashing and comparing their addresses will do */
+static uint64_t
+hash_key(struct scaled_font_buffer *self, double scale)
+{
+	uint64_t hash = HASH_INIT;
+	hash = hash_bytes(hash, &self->text, sizeof(self->text));
+	hash = hash_bytes(hash, &self->arrow, sizeof(self->arrow));
+	hash = hash_bytes(hash, &self->font.name, sizeof(self->font.name));
+	hash = hash_bytes(hash, &self->font.size, sizeof(self->font.size));
+	hash = hash_bytes(hash, &self->font.slant, sizeof(self->font.slant));
+	hash = hash_bytes(hash, &self->font.weight, sizeof(self->font.weight));
+	hash = hash_bytes(hash, self->color, sizeof(self->color));
+	hash = hash_bytes(hash, self->bg_color, sizeof(self->bg_color));
+	hash = hash_bytes(hash, &self->max_width, sizeof(self->max_width));
+	return hash_bytes(hash, &scale, sizeof(scale));
+}
+
+static bool
+key_equal(struct cached_text *entry, struct scaled_font_buffer *self,
+		double scale)
+{
+	return entry->text == self->text
+		&& entry->arrow == self->arrow
+		&& entry->font.name == self->font.name
+		&& entry->font.size == self->font.size
+		&& entry->font.slant == self->font.slant
+		&& entry->font.weight == self->font.weight
+		&& !memcmp(entry->color, self->color, sizeof(entry->color))
+		&& !memcmp(entry->bg_color, self->bg_color, sizeof(entry->bg_color))
+		&& entry->max_width == self->max_width
+		&& !memcmp(&entry->scale, &scale, sizeof(scale));
+}
+
+static void
+cached_text_free(struct cached_text *entry)
+{
+	/* Freed once the last consumer lets go of it */
+	wlr_buffer_unlock(&entry->buffer->base);
+	wlr_buffer_drop(&entry->buffer->base);
+
+	intern_release(entry->text);
+	intern_release(entry->arrow);
+	intern_release(entry->font.name);
+	free(entry);
+}
+
+static void
+cached_text_destroy(struct cached_text *entry)
+{
+	struct cached_text *head = int_map_lookup(&text_cache, entry->hash);
+	if (head == entry) {
+		int_map_remove(&text_cache, entry->hash);
+		if (entry->next) {
+			int_map_insert(&text_cache, entry->hash, entry->next);
+		}
+	} else {
+		while (head->next != entry) {
+			head = head->next;
+		}
+		head->next = entry->next;
+	}
+	cached_text_free(entry);
+}
+
+static int
+compare_last_used(const void *a, const void *b)
+{
+	const struct cached_text *entry_a = *(struct cached_text *const *)a;
+	const struct cached_text *entry_b = *(struct cached_text *const *)b;
+	return (entry_a->last_used > entry_b->last_used)
+		- (entry_a->last_used < entry_b->last_used);
+}
+
+static void
+prune_text_cache(void)
+{
+	/*
+	 * Collect first, the map must not be modified while iterating it.
+	 * The common case is none or just a few unused entries.
+	 */
+	struct cached_text **unused = NULL;
+	size_t nr_unused = 0;
+	for (size_t i = 0; i < text_cache.capacity; i++) {
+		struct cached_text *entry = text_cache.entries[i].value;
+		for (; entry; entry = entry->next) {
+			if (entry->buffer->base.n_locks > 1) {
+				continue;
+			}
+			unused = xrealloc(unused, (nr_unused + 1) * sizeof(*unused));
+			unused[nr_unused++] = entry;
+		}
+	}
+	if (nr_unused > TEXT_CACHE_MAX_UNUSED) {
+		qsort(unused, nr_unused, sizeof(*unused), compare_last_used);
+		for (size_t i = 0; i < nr_unused - TEXT_CACHE_MAX_UNUSED; i++) {
+			cached_text_destroy(unused[i]);
+		}
+	}
+	free(unused);
+}
+
+static void
+cache_buffer(struct scaled_font_buffer *self, double scale, uint64_t hash,
+		struct lab_data_buffer *buffer)
+{
+	struct cached_text *entry = znew(*entry);
+	entry->hash = hash;
+	entry->text = intern_ref(self->text);
+	entry->arrow = intern_ref(self->arrow);
+	entry->font = self->font;
+	intern_ref(entry->font.name);
+	memcpy(entry->color, self->color, sizeof(entry->color));
+	memcpy(entry->bg_color, self->bg_color, sizeof(entry->bg_color));
+	entry->max_width = self->max_width;
+	entry->scale = scale;
+	entry->buffer = buffer;
+	entry->last_used = ++use_counter;
+	wlr_buffer_lock(&buffer->base);
+
+	struct cached_text *head = int_map_lookup(&text_cache, hash);
+	if (head) {
+		entry->next = head->next;
+		head->next = entry;
+	} else {
+		int_map_insert(&text_cache, hash, entry);
+	}
+}
+
+static struct lab_data_buffer *
+lookup_buffer(struct scaled_font_buffer *self, double scale, uint64_t hash)
+{
+	struct cached_text *entry = int_map_lookup(&text_cache, hash);
+	for (; entry; entry = entry->next) {
+		if (key_equal(entry, self, scale)) {
+			entry->last_used = ++use_counter;
+			return entry->buffer;
+		}
+	}
+	return NULL;
+}
+
 static struct lab_data_buffer *
 _create_buffer(struct scaled_scene_buffer *scaled_buffer, double scale)
 {
-	struct lab_data_buffer *buffer;
 	struct scaled_font_buffer *self = scaled_buffer->data;
 
-	/* Buffer gets free'd automatically along the backing wlr_buffer */
-	font_buffer_create(&buffer, self->max_width, self->text,
-		&self->font, self->color, self->bg_color, self->arrow, scale);
+	uint64_t hash = hash_key(self, scale);
+	struct lab_data_buffer *buffer = lookup_buffer(self, scale, hash);
+	if (!buffer) {
+		prune_text_cache();
+		font_buffer_create(&buffer, self->max_width, self->text,
+			&self->font, self->color, self->bg_color, self->arrow,
+			scale);
+		if (buffer) {
+			cache_buffer(self, scale, hash, buffer);
+		}
+	}
 
 	self->width = buffer ? buffer->unscaled_width : 0;
 	self->height = buffer ? buffer->unscaled_height : 0;
@@ -32,9 +217,9 @@ _destroy(struct scaled_scene_buffer *scaled_buffer)
 	struct scaled_font_buffer *self = scaled_buffer->data;
 	scaled_buffer->data = NULL;
 
-	zfree(self->text);
-	zfree(self->font.name);
-	zfree(self->arrow);
+	intern_release(self->text);
+	intern_release(self->font.name);
+	intern_release(self->arrow);
 	free(self);
 }
 
@@ -43,14 +228,29 @@ static const struct scaled_scene_buffer_impl impl = {
 	.destroy = _destroy
 };
 
+static void
+invalidate(struct scaled_font_buffer *self)
+{
+	if (!self->lazy_height) {
+		scaled_scene_buffer_invalidate_cache(self->scaled_buffer);
+		return;
+	}
+	scaled_scene_buffer_invalidate_lazy(self->scaled_buffer,
+		self->max_width, self->lazy_height);
+	/* Either the rendered or the expected size */
+	self->width = self->scaled_buffer->width;
+	self->height = self->scaled_buffer->height;
+}
+
 /* Public API */
 struct scaled_font_buffer *
 scaled_font_buffer_create(struct wlr_scene_tree *parent)
 {
 	assert(parent);
 	struct scaled_font_buffer *self = znew(*self);
+	/* Buffers are shared, dropping them is left to the text cache */
 	struct scaled_scene_buffer *scaled_buffer =
-		scaled_scene_buffer_create(parent, &impl, /* drop_buffer */ true);
+		scaled_scene_buffer_create(parent, &impl, /* drop_buffer */ false);
 	if (!scaled_buffer) {
 		free(self);
 		return NULL;
@@ -62,6 +262,17 @@ scaled_font_buffer_create(struct wlr_scene_tree *parent)
 	return self;
 }
 
+struct scaled_font_buffer *
+scaled_font_buffer_create_lazy(struct wlr_scene_tree *parent, int height)
+{
+	assert(height > 0);
+	struct scaled_font_buffer *self = scaled_font_buffer_create(parent);
+	if (self) {
+		self->lazy_height = height;
+	}
+	return self;
+}
+
 void
 scaled_font_buffer_update(struct scaled_font_buffer *self, const char *text,
 		int max_width, struct font *font, const float *color,
@@ -72,31 +283,45 @@ scaled_font_buffer_update(struct scaled_font_buffer *self, const char *text,
 	assert(font);
 	assert(color);
 
-	/* Clean up old internal state */
-	zfree(self->text);
-	zfree(self->font.name);
-	zfree(self->arrow);
-
-	/* Update internal state */
-	self->text = xstrdup(text);
+	/* Update internal state, interning before releasing the old strings */
+	const char *old_text = self->text;
+	const char *old_font_name = self->font.name;
+	const char *old_arrow = self->arrow;
+	self->text = intern_string(text);
 	self->max_width = max_width;
-	if (font->name) {
-		self->font.name = xstrdup(font->name);
-	}
+	/* struct font is shared with the config, the name is not modified */
+	self->font.name = (char *)intern_string(font->name);
 	self->font.size = font->size;
 	self->font.slant = font->slant;
 	self->font.weight = font->weight;
 	memcpy(self->color, color, sizeof(self->color));
 	memcpy(self->bg_color, bg_color, sizeof(self->bg_color));
-	self->arrow = arrow ? xstrdup(arrow) : NULL;
+	self->arrow = intern_string(arrow);
+	intern_release(old_text);
+	intern_release(old_font_name);
+	intern_release(old_arrow);
 
 	/* Invalidate cache and force a new render */
-	scaled_scene_buffer_invalidate_cache(self->scaled_buffer);
+	invalidate(self);
 }
 
 void
 scaled_font_buffer_set_max_width(struct scaled_font_buffer *self, int max_width)
 {
 	self->max_width = max_width;
-	scaled_scene_buffer_invalidate_cache(self->scaled_buffer);
+	invalidate(self);
+}
+
+void
+scaled_font_buffer_finish_cache(void)
+{
+	for (size_t i = 0; i < text_cache.capacity; i++) {
+		struct cached_text *entry = text_cache.entries[i].value;
+		while (entry) {
+			struct cached_text *next = entry->next;
+			cached_text_free(entry);
+			entry = next;
+		}
+	}
+	int_map_finish(&text_cache);
 }
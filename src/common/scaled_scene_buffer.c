@@ -10,6 +10,7 @@
 #include "buffer.h"
 #include "common/mem.h"
 #include "common/scaled_scene_buffer.h"
+#include "config/rcxml.h"
 
 /**
  * TODO
@@ -34,11 +35,21 @@
  * See wlroots/types/scene/wlr_scene.c scene_buffer_update_outputs()
  */
 
+/*
+ * All cache entries of all instances, most recently displayed first. Entries
+ * not currently displayed are evicted from the end once the cached buffers
+ * exceed <core><bufferCacheSize>.
+ */
+static struct wl_list lru = { &lru, &lru };
+static struct scaled_scene_buffer_stats stats;
+
 /* Internal API */
 static void
 _cache_entry_destroy(struct scaled_scene_buffer_cache_entry *cache_entry, bool drop_buffer)
 {
 	wl_list_remove(&cache_entry->link);
+	wl_list_remove(&cache_entry->lru_link);
+	stats.bytes -= cache_entry->bytes;
 	if (cache_entry->buffer) {
 		/* Allow the buffer to get dropped if there are no further consumers */
 		wlr_buffer_unlock(cache_entry->buffer);
@@ -49,6 +60,55 @@ _cache_entry_destroy(struct scaled_scene_buffer_cache_entry *cache_entry, bool d
 	free(cache_entry);
 }
 
+static bool
+is_displayed(struct scaled_scene_buffer_cache_entry *cache_entry)
+{
+	/* The first entry of each instance is the one it currently shows */
+	return cache_entry->owner->cache.next == &cache_entry->link;
+}
+
+static void
+evict_to(size_t budget)
+{
+	struct scaled_scene_buffer_cache_entry *cache_entry, *tmp;
+	wl_list_for_each_reverse_safe(cache_entry, tmp, &lru, lru_link) {
+		if (stats.bytes <= budget) {
+			break;
+		}
+		if (is_displayed(cache_entry)) {
+			continue;
+		}
+		_cache_entry_destroy(cache_entry, cache_entry->owner->drop_buffer);
+		stats.evictions++;
+	}
+}
+
+static void
+evict(void)
+{
+	evict_to((size_t)rc.buffer_cache_size * 1024 * 1024);
+}
+
+static void
+set_buffer(struct scaled_scene_buffer *self, struct wlr_buffer *buffer)
+{
+	wlr_scene_buffer_set_buffer(self->scene_buffer,
+		buffer_get_shared(buffer));
+
+	/* Buffers from impl->create_buffer() are always lab_data_buffers */
+	struct lab_data_buffer *data_buffer = buffer
+		? wl_container_of(buffer, data_buffer, base) : NULL;
+	if (data_buffer) {
+		wlr_scene_buffer_set_opaque_region(self->scene_buffer,
+			&data_buffer->opaque_region);
+	} else {
+		pixman_region32_t empty;
+		pixman_region32_init(&empty);
+		wlr_scene_buffer_set_opaque_region(self->scene_buffer, &empty);
+		pixman_region32_fini(&empty);
+	}
+}
+
 static void
 _update_buffer(struct scaled_scene_buffer *self, double scale)
 {
@@ -61,12 +121,16 @@ _update_buffer(struct scaled_scene_buffer *self, double scale)
 			/* LRU cache, recently used in front */
 			wl_list_remove(&cache_entry->link);
 			wl_list_insert(&self->cache, &cache_entry->link);
-			wlr_scene_buffer_set_buffer(self->scene_buffer, cache_entry->buffer);
+			wl_list_remove(&cache_entry->lru_link);
+			wl_list_insert(&lru, &cache_entry->lru_link);
+			stats.hits++;
+			set_buffer(self, cache_entry->buffer);
 			return;
 		}
 	}
 
 	/* Create new buffer, will get destroyed along the backing wlr_buffer */
+	stats.misses++;
 	struct lab_data_buffer *buffer = self->impl->create_buffer(self, scale);
 	if (buffer) {
 		/* Ensure the buffer doesn't get deleted behind our back */
@@ -75,28 +139,19 @@ _update_buffer(struct scaled_scene_buffer *self, double scale)
 	self->width = buffer ? buffer->unscaled_width : 0;
 	self->height = buffer ? buffer->unscaled_height : 0;
 
-	/* Create or reuse cache entry */
-	if (wl_list_length(&self->cache) < LAB_SCALED_BUFFER_MAX_CACHE) {
-		cache_entry = znew(*cache_entry);
-	} else {
-		cache_entry = wl_container_of(self->cache.prev, cache_entry, link);
-		if (cache_entry->buffer) {
-			/* Allow the old buffer to get dropped if there are no further consumers */
-			wlr_buffer_unlock(cache_entry->buffer);
-			if (self->drop_buffer) {
-				wlr_buffer_drop(cache_entry->buffer);
-			}
-		}
-		wl_list_remove(&cache_entry->link);
-	}
-
-	/* Update the cache entry */
+	/* Add the cache entry */
+	cache_entry = znew(*cache_entry);
+	cache_entry->owner = self;
 	cache_entry->scale = scale;
 	cache_entry->buffer = buffer ? &buffer->base : NULL;
+	cache_entry->bytes = buffer ? (size_t)buffer->stride * buffer->base.height : 0;
 	wl_list_insert(&self->cache, &cache_entry->link);
+	wl_list_insert(&lru, &cache_entry->lru_link);
+	stats.bytes += cache_entry->bytes;
+	evict();
 
 	/* And finally update the wlr_scene_buffer itself */
-	wlr_scene_buffer_set_buffer(self->scene_buffer, cache_entry->buffer);
+	set_buffer(self, cache_entry->buffer);
 	wlr_scene_buffer_set_dest_size(self->scene_buffer, self->width, self->height);
 }
 
@@ -202,3 +257,95 @@ scaled_scene_buffer_invalidate_cache(struct scaled_scene_buffer *self)
 	assert(wl_list_empty(&self->cache));
 	_update_buffer(self, self->active_scale);
 }
+
+void
+scaled_scene_buffer_invalidate_lazy(struct scaled_scene_buffer *self,
+		int width, int height)
+{
+	assert(self);
+	struct wlr_scene_output *primary = self->scene_buffer->primary_output;
+	if (primary) {
+		self->active_scale = primary->output->scale;
+		scaled_scene_buffer_invalidate_cache(self);
+		return;
+	}
+
+	struct scaled_scene_buffer_cache_entry *cache_entry, *cache_entry_tmp;
+	wl_list_for_each_safe(cache_entry, cache_entry_tmp, &self->cache, link) {
+		_cache_entry_destroy(cache_entry, self->drop_buffer);
+	}
+
+	/* No scale matches, so the next output_enter renders */
+	self->active_scale = 0;
+	self->width = width;
+	self->height = height;
+	wlr_scene_buffer_set_buffer(self->scene_buffer, NULL);
+	wlr_scene_buffer_set_dest_size(self->scene_buffer, width, height);
+}
+
+static void
+prerender(struct scaled_scene_buffer *self, double scale)
+{
+	if (wl_list_empty(&self->cache)) {
+		/* Nothing rendered yet, the content may not be set up */
+		return;
+	}
+	struct scaled_scene_buffer_cache_entry *cache_entry;
+	wl_list_for_each(cache_entry, &self->cache, link) {
+		if (cache_entry->scale == scale) {
+			return;
+		}
+	}
+
+	stats.misses++;
+	struct lab_data_buffer *buffer = self->impl->create_buffer(self, scale);
+	if (!buffer) {
+		return;
+	}
+	wlr_buffer_lock(&buffer->base);
+
+	/* Keep the displayed entry in front */
+	cache_entry = znew(*cache_entry);
+	cache_entry->owner = self;
+	cache_entry->scale = scale;
+	cache_entry->buffer = &buffer->base;
+	cache_entry->bytes = (size_t)buffer->stride * buffer->base.height;
+	wl_list_insert(self->cache.next, &cache_entry->link);
+	wl_list_insert(&lru, &cache_entry->lru_link);
+	stats.bytes += cache_entry->bytes;
+	evict();
+}
+
+static void
+prerender_iter(struct wlr_scene_buffer *scene_buffer, int sx, int sy,
+		void *data)
+{
+	struct wl_listener *listener = wl_signal_get(
+		&scene_buffer->node.events.destroy, _handle_node_destroy);
+	if (listener) {
+		struct scaled_scene_buffer *self =
+			wl_container_of(listener, self, destroy);
+		prerender(self, *(double *)data);
+	}
+}
+
+void
+scaled_scene_buffer_prerender_tree(struct wlr_scene_tree *tree, double scale)
+{
+	assert(tree);
+	wlr_scene_node_for_each_buffer(&tree->node, prerender_iter, &scale);
+}
+
+void
+scaled_scene_buffer_get_stats(struct scaled_scene_buffer_stats *out)
+{
+	*out = stats;
+}
+
+size_t
+scaled_scene_buffer_shed_cache(void)
+{
+	size_t bytes = stats.bytes;
+	evict_to(0);
+	return bytes - stats.bytes;
+}
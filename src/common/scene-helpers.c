@@ -5,6 +5,8 @@
 #include <wlr/types/wlr_scene.h>
 #include <wlr/util/log.h>
 #include "common/scene-helpers.h"
+#include "common/time-helpers.h"
+#include "common/trace.h"
 
 struct wlr_surface *
 lab_wlr_surface_from_node(struct wlr_scene_node *node)
@@ -34,27 +36,71 @@ lab_wlr_scene_get_prev_node(struct wlr_scene_node *node)
 	return prev;
 }
 
+void
+lab_wlr_scene_node_get_size(struct wlr_scene_node *node,
+		int *width, int *height)
+{
+	*width = 0;
+	*height = 0;
+
+	switch (node->type) {
+	case WLR_SCENE_NODE_TREE:
+		return;
+	case WLR_SCENE_NODE_RECT: {
+		struct wlr_scene_rect *rect = wlr_scene_rect_from_node(node);
+		*width = rect->width;
+		*height = rect->height;
+		return;
+	}
+	case WLR_SCENE_NODE_BUFFER: {
+		struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(node);
+		if (buffer->dst_width > 0 && buffer->dst_height > 0) {
+			*width = buffer->dst_width;
+			*height = buffer->dst_height;
+		} else if (buffer->buffer) {
+			bool rotated = buffer->transform & WL_OUTPUT_TRANSFORM_90;
+			*width = rotated ? buffer->buffer->height : buffer->buffer->width;
+			*height = rotated ? buffer->buffer->width : buffer->buffer->height;
+		}
+		return;
+	}
+	}
+}
+
 /*
  * This is a copy of wlr_scene_output_commit()
  * as it doesn't use the pending state at all.
  */
 bool
-lab_wlr_scene_output_commit(struct wlr_scene_output *scene_output)
+lab_wlr_scene_output_commit(struct wlr_scene_output *scene_output,
+		struct lab_scene_commit_timing *timing)
 {
+	TRACE_FUNC();
 	assert(scene_output);
 	struct wlr_output *wlr_output = scene_output->output;
 	struct wlr_output_state *state = &wlr_output->pending;
+	struct lab_scene_commit_timing unused;
+	if (!timing) {
+		timing = &unused;
+	}
+	*timing = (struct lab_scene_commit_timing){0};
 
 	if (!wlr_output->needs_frame && !pixman_region32_not_empty(
 			&scene_output->damage_ring.current)) {
 		return false;
 	}
-	if (!wlr_scene_output_build_state(scene_output, state, NULL)) {
+	int64_t start = time_now_nsec();
+	bool built = wlr_scene_output_build_state(scene_output, state, NULL);
+	int64_t built_at = time_now_nsec();
+	timing->build_state_nsec = built_at - start;
+	if (!built) {
 		wlr_log(WLR_ERROR, "Failed to build output state for %s",
 			wlr_output->name);
 		return false;
 	}
-	if (!wlr_output_commit(wlr_output)) {
+	bool committed = wlr_output_commit(wlr_output);
+	timing->commit_nsec = time_now_nsec() - built_at;
+	if (!committed) {
 		wlr_log(WLR_INFO, "Failed to commit output %s",
 			wlr_output->name);
 		return false;
@@ -1,28 +1,534 @@
 // SPDX-License-Identifier: GPL-2.0-only
-#define _POSIX_C_SOURCE 200809L
+/* For POSIX_SPAWN_SETSID */
+#define _GNU_SOURCE
 #include <assert.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <glib.h>
 #include <signal.h>
+#include <spawn.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include <wayland-server-core.h>
 #include <wlr/util/log.h>
+#include "common/buf.h"
 #include "common/spawn.h"
 #include "common/fd_util.h"
+#include "common/mem.h"
+
+extern char **environ;
+
+struct spawn_piped_child {
+	pid_t pid; /* 0 while waiting for the helper, -1 if unknown */
+	int pidfd; /* -1 if not supported */
+	int pending_signal;
+	bool awaiting_reply;
+	bool closed; /* by the owner while still awaiting the reply */
+	struct wl_list link; /* pending_replies */
+};
+
+/*
+ * pidfds keep referring to the same process after it has been reaped,
+ * so signals are never sent to an unrelated process reusing the pid
+ */
+static int
+lab_pidfd_open(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+	return syscall(SYS_pidfd_open, pid, 0);
+#else
+	return -1;
+#endif
+}
 
 static void
-reset_signals_and_limits(void)
+lab_pidfd_send_signal(int pidfd, int signal)
 {
-	restore_nofile_limit();
+#ifdef SYS_pidfd_send_signal
+	syscall(SYS_pidfd_send_signal, pidfd, signal, NULL, 0);
+#endif
+}
+
+/*
+ * Start a process with posix_spawn() rather than fork(). On Linux this
+ * uses clone() with CLONE_VM and CLONE_VFORK, so the page tables of the
+ * compositor are not copied and the event loop is only held up until the
+ * child has called exec. Children are reaped by the generic SIGCHLD
+ * handler in src/server.c.
+ *
+ * Returns the pid of the child or -1 on failure.
+ */
+static pid_t
+spawn_env(const char *file, char *const argv[], char *const envp[],
+		bool search_path, bool new_session,
+		const posix_spawn_file_actions_t *file_actions)
+{
+	posix_spawnattr_t attr;
+	posix_spawnattr_init(&attr);
+
+	short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+#ifdef POSIX_SPAWN_SETSID
+	if (new_session) {
+		flags |= POSIX_SPAWN_SETSID;
+	}
+#endif
+	posix_spawnattr_setflags(&attr, flags);
 
 	sigset_t set;
 	sigemptyset(&set);
-	sigprocmask(SIG_SETMASK, &set, NULL);
+	posix_spawnattr_setsigmask(&attr, &set);
 
 	/* Restore ignored signals */
-	signal(SIGPIPE, SIG_DFL);
+	sigaddset(&set, SIGPIPE);
+	sigaddset(&set, SIGCHLD);
+	posix_spawnattr_setsigdefault(&attr, &set);
+
+	/*
+	 * Resource limits cannot be set through posix_spawn() attributes,
+	 * so drop back to the original open files limit just while the
+	 * child is created for it to inherit that one.
+	 */
+	restore_nofile_limit();
+
+	pid_t pid;
+	int err = search_path
+		? posix_spawnp(&pid, file, file_actions, &attr, argv, envp)
+		: posix_spawn(&pid, file, file_actions, &attr, argv, envp);
+
+	reapply_nofile_limit();
+	posix_spawnattr_destroy(&attr);
+
+	if (err) {
+		errno = err;
+		wlr_log_errno(WLR_ERROR, "Failed to execute %s", file);
+		return -1;
+	}
+	return pid;
+}
+
+static pid_t
+spawn(const char *file, char *const argv[], bool search_path,
+		bool new_session, const posix_spawn_file_actions_t *file_actions)
+{
+	return spawn_env(file, argv, environ, search_path, new_session,
+		file_actions);
+}
+
+static void
+file_actions_add_piped(posix_spawn_file_actions_t *file_actions, int write_fd,
+		int close_fd)
+{
+	/*
+	 * Replace stdin and stderr with /dev/null
+	 * and stdout with the write end of the pipe
+	 */
+	posix_spawn_file_actions_adddup2(file_actions, write_fd, STDOUT_FILENO);
+	if (close_fd >= 0) {
+		posix_spawn_file_actions_addclose(file_actions, close_fd);
+	}
+	posix_spawn_file_actions_addclose(file_actions, write_fd);
+	posix_spawn_file_actions_addopen(file_actions, STDIN_FILENO,
+		"/dev/null", O_RDWR, 0);
+	posix_spawn_file_actions_adddup2(file_actions, STDIN_FILENO, STDERR_FILENO);
+}
+
+/*
+ * Launcher helper
+ *
+ * A small process forked by spawn_helper_init() early in main(), while the
+ * compositor is still small, which spawns commands on its behalf. Each
+ * request is one message on a SOCK_SEQPACKET socketpair: a header followed
+ * by the NUL-terminated arguments and the environment of the compositor,
+ * which keeps changing after the helper has been forked. For piped
+ * requests the write end of the pipe is attached as SCM_RIGHTS and the
+ * helper replies with the pid of the child and a pidfd for it. Replies
+ * are handled from the event loop, see spawn_helper_attach(), so that a
+ * slow helper never blocks the compositor.
+ *
+ * The helper reaps its children from a SIGCHLD handler, which is blocked
+ * until the pidfd of a new child has been opened. If the helper is not
+ * running or a request fails to be sent, commands are spawned directly by
+ * the compositor.
+ */
+enum spawn_helper_kind {
+	SPAWN_HELPER_ASYNC = 0,
+	SPAWN_HELPER_PIPED,
+};
+
+struct spawn_helper_header {
+	uint32_t kind;
+	uint32_t nr_args;
+	uint32_t nr_env;
+};
+
+#define SPAWN_HELPER_MAX_MSG (128 * 1024)
+
+static int helper_fd = -1;
+static struct wl_event_source *helper_source;
+/* Piped children in the order of their requests */
+static struct wl_list pending_replies = {
+	.prev = &pending_replies,
+	.next = &pending_replies,
+};
+
+/* Splits @nr NUL-terminated strings from @data into a NULL-terminated array */
+static char **
+helper_unpack(char **data, char *end, uint32_t nr)
+{
+	if (nr > (size_t)(end - *data)) {
+		return NULL;
+	}
+	char **strv = znew_n(char *, nr + 1);
+	for (uint32_t i = 0; i < nr; i++) {
+		char *nul = memchr(*data, '\0', end - *data);
+		if (!nul) {
+			free(strv);
+			return NULL;
+		}
+		strv[i] = *data;
+		*data = nul + 1;
+	}
+	return strv;
+}
+
+/* Sends @pid and a pidfd for it, the child cannot be reaped meanwhile */
+static void
+helper_reply(int sock, pid_t pid)
+{
+	int pidfd = pid > 0 ? lab_pidfd_open(pid) : -1;
+	struct iovec iov = { .iov_base = &pid, .iov_len = sizeof(pid) };
+	struct msghdr hdr = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+	};
+	char control[CMSG_SPACE(sizeof(int))] = {0};
+	if (pidfd >= 0) {
+		hdr.msg_control = control;
+		hdr.msg_controllen = sizeof(control);
+		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(cmsg), &pidfd, sizeof(pidfd));
+	}
+	sendmsg(sock, &hdr, MSG_NOSIGNAL);
+	if (pidfd >= 0) {
+		close(pidfd);
+	}
+}
+
+static void
+helper_handle_request(int sock, char *msg, size_t len, int fd)
+{
+	struct spawn_helper_header header;
+	if (len < sizeof(header)) {
+		return;
+	}
+	memcpy(&header, msg, sizeof(header));
+	char *data = msg + sizeof(header);
+	char *end = msg + len;
+
+	char **argv = helper_unpack(&data, end, header.nr_args);
+	char **envp = argv ? helper_unpack(&data, end, header.nr_env) : NULL;
+	pid_t pid = -1;
+	if (!envp || !argv[0]) {
+		goto out;
+	}
+
+	if (header.kind == SPAWN_HELPER_PIPED && fd >= 0) {
+		posix_spawn_file_actions_t file_actions;
+		posix_spawn_file_actions_init(&file_actions);
+		file_actions_add_piped(&file_actions, fd, -1);
+		pid = spawn_env(argv[0], argv, envp, /*search_path*/ false,
+			/*new_session*/ false, &file_actions);
+		posix_spawn_file_actions_destroy(&file_actions);
+	} else if (header.kind == SPAWN_HELPER_ASYNC) {
+		spawn_env(argv[0], argv, envp, /*search_path*/ true,
+			/*new_session*/ true, /*file_actions*/ NULL);
+	}
+
+out:
+	if (header.kind == SPAWN_HELPER_PIPED) {
+		helper_reply(sock, pid);
+	}
+	free(argv);
+	free(envp);
+}
+
+static void
+helper_handle_sigchld(int signal)
+{
+	int saved_errno = errno;
+	while (waitpid(-1, NULL, WNOHANG) > 0) {
+		/* Reap all exited children */
+	}
+	errno = saved_errno;
+}
+
+static void __attribute__((noreturn))
+helper_run(int sock)
+{
+	struct sigaction sa = {
+		.sa_handler = helper_handle_sigchld,
+		.sa_flags = SA_RESTART | SA_NOCLDSTOP,
+	};
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGCHLD, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	char *msg = xmalloc(SPAWN_HELPER_MAX_MSG);
+	while (1) {
+		char control[CMSG_SPACE(sizeof(int))];
+		struct iovec iov = {
+			.iov_base = msg,
+			.iov_len = SPAWN_HELPER_MAX_MSG,
+		};
+		struct msghdr hdr = {
+			.msg_iov = &iov,
+			.msg_iovlen = 1,
+			.msg_control = control,
+			.msg_controllen = sizeof(control),
+		};
+		ssize_t len = recvmsg(sock, &hdr, MSG_CMSG_CLOEXEC);
+		if (len < 0 && errno == EINTR) {
+			continue;
+		}
+		if (len <= 0) {
+			/* The compositor has exited */
+			_exit(0);
+		}
+
+		int fd = -1;
+		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+		if (cmsg && cmsg->cmsg_level == SOL_SOCKET
+				&& cmsg->cmsg_type == SCM_RIGHTS) {
+			memcpy(&fd, CMSG_DATA(cmsg), sizeof(fd));
+		}
+
+		/* Keep new children around until their pidfd is open */
+		sigset_t chld, old;
+		sigemptyset(&chld);
+		sigaddset(&chld, SIGCHLD);
+		sigprocmask(SIG_BLOCK, &chld, &old);
+		helper_handle_request(sock, msg, len, fd);
+		sigprocmask(SIG_SETMASK, &old, NULL);
+		if (fd >= 0) {
+			close(fd);
+		}
+	}
+}
+
+void
+spawn_helper_init(void)
+{
+	int sv[2];
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to create launcher helper socket");
+		return;
+	}
+
+	pid_t pid = fork();
+	if (pid < 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to fork launcher helper");
+		close(sv[0]);
+		close(sv[1]);
+		return;
+	}
+	if (pid == 0) {
+		close(sv[0]);
+		helper_run(sv[1]);
+	}
+	close(sv[1]);
+
+	helper_fd = sv[0];
+	wlr_log(WLR_DEBUG, "started launcher helper %ld", (long)pid);
+}
+
+static void
+child_destroy(struct spawn_piped_child *child)
+{
+	if (child->pidfd >= 0) {
+		close(child->pidfd);
+	}
+	free(child);
+}
+
+/* Handles the reply for the oldest pending piped child */
+static void
+child_set_pid(pid_t pid, int pidfd)
+{
+	if (wl_list_empty(&pending_replies)) {
+		if (pidfd >= 0) {
+			close(pidfd);
+		}
+		return;
+	}
+	struct spawn_piped_child *child =
+		wl_container_of(pending_replies.next, child, link);
+	wl_list_remove(&child->link);
+	wl_list_init(&child->link);
+	child->awaiting_reply = false;
+	child->pid = pid > 0 ? pid : -1;
+	child->pidfd = pidfd;
+	if (child->pending_signal) {
+		spawn_piped_kill(child, child->pending_signal);
+	}
+	if (child->closed) {
+		child_destroy(child);
+	}
+}
+
+/* Pending piped children will never learn their pid */
+static void
+fail_pending_replies(void)
+{
+	while (!wl_list_empty(&pending_replies)) {
+		child_set_pid(-1, -1);
+	}
+}
+
+void
+spawn_helper_detach(void)
+{
+	if (helper_source) {
+		wl_event_source_remove(helper_source);
+		helper_source = NULL;
+	}
+	fail_pending_replies();
+}
+
+void
+spawn_helper_finish(void)
+{
+	spawn_helper_detach();
+	if (helper_fd >= 0) {
+		close(helper_fd);
+		helper_fd = -1;
+	}
+}
+
+static void
+helper_disable(void)
+{
+	wlr_log(WLR_ERROR, "launcher helper failed, spawning directly");
+	spawn_helper_finish();
+}
+
+static int
+handle_helper_readable(int fd, uint32_t mask, void *data)
+{
+	while (true) {
+		pid_t pid;
+		char control[CMSG_SPACE(sizeof(int))];
+		struct iovec iov = { .iov_base = &pid, .iov_len = sizeof(pid) };
+		struct msghdr hdr = {
+			.msg_iov = &iov,
+			.msg_iovlen = 1,
+			.msg_control = control,
+			.msg_controllen = sizeof(control),
+		};
+		ssize_t len = recvmsg(fd, &hdr, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+		if (len < 0 && errno == EINTR) {
+			continue;
+		}
+		if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			return 0;
+		}
+		if (len != sizeof(pid)) {
+			helper_disable();
+			return 0;
+		}
+
+		int pidfd = -1;
+		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+		if (cmsg && cmsg->cmsg_level == SOL_SOCKET
+				&& cmsg->cmsg_type == SCM_RIGHTS) {
+			memcpy(&pidfd, CMSG_DATA(cmsg), sizeof(pidfd));
+		}
+		child_set_pid(pid, pidfd);
+	}
+}
+
+void
+spawn_helper_attach(struct wl_event_loop *loop)
+{
+	if (helper_fd < 0 || helper_source) {
+		return;
+	}
+	helper_source = wl_event_loop_add_fd(loop, helper_fd,
+		WL_EVENT_READABLE, handle_helper_readable, NULL);
+}
+
+/* Returns false if the request could not be sent */
+static bool
+helper_send(enum spawn_helper_kind kind, char *const argv[], int fd)
+{
+	if (helper_fd < 0) {
+		return false;
+	}
+
+	struct spawn_helper_header header = { .kind = kind };
+	struct buf data = BUF_INIT;
+	for (char *const *arg = argv; *arg; arg++) {
+		buf_add(&data, *arg);
+		buf_add_char(&data, '\0');
+		header.nr_args++;
+	}
+	for (char **var = environ; *var; var++) {
+		buf_add(&data, *var);
+		buf_add_char(&data, '\0');
+		header.nr_env++;
+	}
+
+	struct iovec iov[2] = {
+		{ .iov_base = &header, .iov_len = sizeof(header) },
+		{ .iov_base = data.data, .iov_len = data.len },
+	};
+	struct msghdr hdr = {
+		.msg_iov = iov,
+		.msg_iovlen = 2,
+	};
+	char control[CMSG_SPACE(sizeof(int))] = {0};
+	if (fd >= 0) {
+		hdr.msg_control = control;
+		hdr.msg_controllen = sizeof(control);
+		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(cmsg), &fd, sizeof(fd));
+	}
+
+	bool ok = sizeof(header) + data.len <= SPAWN_HELPER_MAX_MSG;
+	if (ok && sendmsg(helper_fd, &hdr, MSG_NOSIGNAL) < 0) {
+		ok = false;
+		if (errno != EMSGSIZE) {
+			helper_disable();
+		}
+	}
+	buf_reset(&data);
+	return ok;
+}
+
+/* The pid is only known once the helper has replied */
+static struct spawn_piped_child *
+helper_spawn_piped(char *const argv[], int write_fd)
+{
+	if (!helper_source || !helper_send(SPAWN_HELPER_PIPED, argv, write_fd)) {
+		return NULL;
+	}
+	struct spawn_piped_child *child = znew(*child);
+	child->pidfd = -1;
+	child->awaiting_reply = true;
+	wl_list_insert(pending_replies.prev, &child->link);
+	return child;
 }
 
 static bool
@@ -60,33 +566,13 @@ spawn_async_no_shell(char const *command)
 	}
 
 	/*
-	 * Avoid zombie processes by using a double-fork, whereby the
-	 * grandchild becomes orphaned & the responsibility of the OS.
+	 * Run in a new session so that the command is not affected by
+	 * signals sent to the process group of the compositor.
 	 */
-	pid_t child = 0, grandchild = 0;
-
-	child = fork();
-	switch (child) {
-	case -1:
-		wlr_log(WLR_ERROR, "unable to fork()");
-		goto out;
-	case 0:
-		reset_signals_and_limits();
-
-		setsid();
-		grandchild = fork();
-		if (grandchild == 0) {
-			execvp(argv[0], argv);
-			_exit(0);
-		} else if (grandchild < 0) {
-			wlr_log(WLR_ERROR, "unable to fork()");
-		}
-		_exit(0);
-	default:
-		break;
+	if (!helper_send(SPAWN_HELPER_ASYNC, argv, -1)) {
+		spawn(argv[0], argv, /*search_path*/ true, /*new_session*/ true,
+			/*file_actions*/ NULL);
 	}
-	waitpid(child, NULL, 0);
-out:
 	g_strfreev(argv);
 }
 
@@ -106,26 +592,22 @@ spawn_primary_client(const char *command)
 		return -1;
 	}
 
-	pid_t child = fork();
-	switch (child) {
-	case -1:
-		wlr_log_errno(WLR_ERROR, "Failed to fork");
-		g_strfreev(argv);
-		return -1;
-	case 0:
-		/* child */
-		close(STDIN_FILENO);
-		reset_signals_and_limits();
-		execvp(argv[0], argv);
-		wlr_log_errno(WLR_ERROR, "Failed to execute primary client %s", command);
-		_exit(1);
-	default:
-		g_strfreev(argv);
-		return child;
+	posix_spawn_file_actions_t file_actions;
+	posix_spawn_file_actions_init(&file_actions);
+	posix_spawn_file_actions_addclose(&file_actions, STDIN_FILENO);
+
+	pid_t child = spawn(argv[0], argv, /*search_path*/ true,
+		/*new_session*/ false, &file_actions);
+	if (child < 0) {
+		wlr_log(WLR_ERROR, "Failed to execute primary client %s", command);
 	}
+
+	posix_spawn_file_actions_destroy(&file_actions);
+	g_strfreev(argv);
+	return child;
 }
 
-pid_t
+struct spawn_piped_child *
 spawn_piped(const char *command, int *pipe_fd)
 {
 	assert(command);
@@ -133,50 +615,28 @@ spawn_piped(const char *command, int *pipe_fd)
 	int pipe_rw[2];
 	if (pipe(pipe_rw) != 0) {
 		wlr_log(WLR_ERROR, "unable to pipe()");
-		return -1;
-	}
-
-	pid_t pid = fork();
-	if (pid < 0) {
-		close(pipe_rw[0]);
-		close(pipe_rw[1]);
-		wlr_log(WLR_ERROR, "unable to fork()");
-		return pid;
+		return NULL;
 	}
 
-	if (pid == 0) {
-		/* child */
-		reset_signals_and_limits();
-
-		/*
-		 * replace stdin and stderr with /dev/null
-		 * and stdout with the write end of the pipe
-		 */
-		dup2(pipe_rw[1], STDOUT_FILENO);
-		close(pipe_rw[0]);
-		close(pipe_rw[1]);
-
-		int dev_null = open("/dev/null", O_RDWR);
-		if (dev_null < 0) {
-			wlr_log_errno(WLR_ERROR, "opening /dev/null failed");
-			/*
-			 * Just close stdin and stderr and
-			 * hope $command can deal with that.
-			 */
-			close(STDIN_FILENO);
-			close(STDERR_FILENO);
-		} else {
-			dup2(dev_null, STDIN_FILENO);
-			dup2(dev_null, STDERR_FILENO);
-			close(dev_null);
+	char *argv[] = { "/bin/sh", "-c", (char *)command, NULL };
+	struct spawn_piped_child *child = helper_spawn_piped(argv, pipe_rw[1]);
+	if (!child) {
+		posix_spawn_file_actions_t file_actions;
+		posix_spawn_file_actions_init(&file_actions);
+		file_actions_add_piped(&file_actions, pipe_rw[1], pipe_rw[0]);
+		pid_t pid = spawn("/bin/sh", argv, /*search_path*/ false,
+			/*new_session*/ false, &file_actions);
+		posix_spawn_file_actions_destroy(&file_actions);
+		if (pid < 0) {
+			close(pipe_rw[0]);
+			close(pipe_rw[1]);
+			return NULL;
 		}
-
-		execl("/bin/sh", "sh", "-c", command, NULL);
-		/*
-		 * Our stderr points to /dev/null or is closed
-		 * at this point so logging is pretty useless.
-		 */
-		_exit(1);
+		/* Not reaped before the SIGCHLD handler runs from the loop */
+		child = znew(*child);
+		child->pid = pid;
+		child->pidfd = lab_pidfd_open(pid);
+		wl_list_init(&child->link);
 	}
 
 	/* labwc */
@@ -189,12 +649,36 @@ spawn_piped(const char *command, int *pipe_fd)
 	set_cloexec(pipe_rw[0]);
 
 	*pipe_fd = pipe_rw[0];
-	return pid;
+	return child;
+}
+
+pid_t
+spawn_piped_pid(struct spawn_piped_child *child)
+{
+	return child->pid;
 }
 
 void
-spawn_piped_close(pid_t pid, int pipe_fd)
+spawn_piped_kill(struct spawn_piped_child *child, int signal)
+{
+	if (child->awaiting_reply) {
+		child->pending_signal = signal;
+	} else if (child->pidfd >= 0) {
+		lab_pidfd_send_signal(child->pidfd, signal);
+	} else if (child->pid > 0) {
+		kill(child->pid, signal);
+	}
+}
+
+void
+spawn_piped_close(struct spawn_piped_child *child, int pipe_fd)
 {
 	close(pipe_fd);
 	/* waitpid() is done in a generic SIGCHLD handler in src/server.c */
+	if (child->awaiting_reply) {
+		/* Freed once the helper has replied */
+		child->closed = true;
+		return;
+	}
+	child_destroy(child);
 }
@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <time.h>
+#include "common/time-helpers.h"
+
+int64_t
+timespec_to_nsec(const struct timespec *ts)
+{
+	return (int64_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+int64_t
+time_now_nsec(void)
+{
+	struct timespec now = { 0 };
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return timespec_to_nsec(&now);
+}
+
+uint32_t
+nsec_to_usec(int64_t nsec)
+{
+	if (nsec <= 0) {
+		return 0;
+	}
+	return nsec / 1000 > UINT32_MAX ? UINT32_MAX : nsec / 1000;
+}
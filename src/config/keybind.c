@@ -6,12 +6,42 @@
 #include <stdlib.h>
 #include <string.h>
 #include <wlr/util/log.h>
+#include "action.h"
+#include "common/arena.h"
+#include "common/bitset.h"
+#include "common/hash.h"
+#include "common/int-map.h"
 #include "common/list.h"
 #include "common/mem.h"
 #include "config/keybind.h"
 #include "config/rcxml.h"
 #include "labwc.h"
 
+/*
+ * Keybinds compiled into hash maps keyed by (modifiers, keycode) and
+ * (modifiers, lowercase keysym). Each key maps to the first keybind in
+ * rc.keybinds which matches it. The toggle maps only hold keybinds that
+ * contain ToggleKeybinds, which are the only ones usable while keybinds
+ * are inhibited.
+ *
+ * The prefilter holds, for each modifier mask used by any keybind, the
+ * keycodes which could match a keybind with that mask in any layout and
+ * at any shift level. It is a superset of what the maps can match.
+ */
+struct prefilter_entry {
+	uint32_t modifiers;
+	struct bitset keycodes;
+};
+
+static struct {
+	struct int_map keycodes;
+	struct int_map keysyms;
+	struct int_map toggle_keycodes;
+	struct int_map toggle_keysyms;
+	struct prefilter_entry *prefilter;
+	size_t prefilter_len;
+} lookup;
+
 uint32_t
 parse_modifier(const char *symname)
 {
@@ -48,55 +78,259 @@ keybind_the_same(struct keybind *a, struct keybind *b)
 	return true;
 }
 
+uint64_t
+keybind_hash(struct keybind *keybind)
+{
+	assert(keybind);
+	/* Over what keybind_the_same() compares */
+	uint64_t hash = hash_value(HASH_INIT, keybind->modifiers);
+	for (size_t i = 0; i < keybind->keysyms_len; i++) {
+		hash = hash_value(hash, keybind->keysyms[i]);
+	}
+	return hash;
+}
+
+/* One (keysym, keycode) pair of a layout of the keymap */
+struct sym_keycode {
+	xkb_keysym_t sym;
+	xkb_keycode_t keycode;
+};
+
+/*
+ * Keysym to keycode multimap for one layout: pairs sorted by keysym and
+ * keycode, plus a map from each keysym to its first pair.
+ */
+struct sym_keycodes {
+	xkb_layout_index_t layout;
+	struct sym_keycode *pairs;
+	size_t len;
+	size_t capacity;
+	struct int_map first;
+};
+
 static void
-update_keycodes_iter(struct xkb_keymap *keymap, xkb_keycode_t key, void *data)
+collect_keycodes_iter(struct xkb_keymap *keymap, xkb_keycode_t key, void *data)
 {
-	struct keybind *keybind;
+	struct sym_keycodes *map = data;
 	const xkb_keysym_t *syms;
-	xkb_layout_index_t layout = *(xkb_layout_index_t *)data;
-	int nr_syms = xkb_keymap_key_get_syms_by_level(keymap, key, layout, 0, &syms);
-	if (!nr_syms) {
+	int nr_syms = xkb_keymap_key_get_syms_by_level(keymap, key,
+		map->layout, 0, &syms);
+	for (int i = 0; i < nr_syms; i++) {
+		if (map->len == map->capacity) {
+			map->capacity = map->capacity ? map->capacity * 2 : 256;
+			map->pairs = xrealloc(map->pairs,
+				map->capacity * sizeof(*map->pairs));
+		}
+		map->pairs[map->len++] = (struct sym_keycode){
+			.sym = syms[i],
+			.keycode = key,
+		};
+	}
+}
+
+static int
+compare_sym_keycodes(const void *a, const void *b)
+{
+	const struct sym_keycode *x = a, *y = b;
+	if (x->sym != y->sym) {
+		return x->sym < y->sym ? -1 : 1;
+	}
+	if (x->keycode != y->keycode) {
+		return x->keycode < y->keycode ? -1 : 1;
+	}
+	return 0;
+}
+
+static void
+sym_keycodes_build(struct sym_keycodes *map, struct xkb_keymap *keymap,
+		xkb_layout_index_t layout)
+{
+	map->layout = layout;
+	map->len = 0;
+	int_map_finish(&map->first);
+
+	xkb_keymap_key_for_each(keymap, collect_keycodes_iter, map);
+	qsort(map->pairs, map->len, sizeof(*map->pairs), compare_sym_keycodes);
+	for (size_t i = 0; i < map->len; i++) {
+		/* Keeps the first pair of each keysym */
+		int_map_insert(&map->first, map->pairs[i].sym, &map->pairs[i]);
+	}
+}
+
+static void
+keybind_add_keycode(struct keybind *keybind, xkb_keycode_t key,
+		xkb_layout_index_t layout)
+{
+	for (size_t k = 0; k < keybind->keycodes_len; k++) {
+		if (keybind->keycodes[k] == key) {
+			return;
+		}
+	}
+	if (keybind->keycodes_len == MAX_KEYCODES) {
+		wlr_log(WLR_ERROR, "Already stored %lu keycodes for keybind",
+			keybind->keycodes_len);
+		return;
+	}
+	keybind->keycodes[keybind->keycodes_len++] = key;
+	keybind->keycodes_layout = layout;
+}
+
+static void
+keybind_resolve_keycodes(struct keybind *keybind, struct sym_keycodes *map)
+{
+	if (keybind->use_syms_only) {
+		return;
+	}
+	if (keybind->keycodes_layout >= 0
+			&& (xkb_layout_index_t)keybind->keycodes_layout != map->layout) {
+		/* Prevent storing keycodes from multiple layouts */
 		return;
 	}
+	struct sym_keycode *end = map->pairs + map->len;
+	for (size_t j = 0; j < keybind->keysyms_len; j++) {
+		xkb_keysym_t sym = keybind->keysyms[j];
+		struct sym_keycode *pair = int_map_lookup(&map->first, sym);
+		for (; pair && pair < end && pair->sym == sym; pair++) {
+			keybind_add_keycode(keybind, pair->keycode, map->layout);
+		}
+	}
+}
+
+static uint64_t
+lookup_key(uint32_t modifiers, uint32_t value)
+{
+	return ((uint64_t)modifiers << 32) | value;
+}
+
+static void
+lookup_add(struct int_map *map, uint32_t modifiers, uint32_t value,
+		struct keybind *keybind, bool toggle, struct int_map *toggle_map)
+{
+	/* An earlier keybind takes precedence */
+	int_map_insert(map, lookup_key(modifiers, value), keybind);
+	if (toggle) {
+		int_map_insert(toggle_map, lookup_key(modifiers, value), keybind);
+	}
+}
+
+static void
+lookup_build(void)
+{
+	keybind_finish_lookup();
+
+	struct keybind *keybind;
+	wl_list_for_each(keybind, &rc.keybinds, link) {
+		bool toggle = actions_contain_toggle_keybinds(&keybind->actions);
+		for (size_t i = 0; i < keybind->keycodes_len; i++) {
+			lookup_add(&lookup.keycodes, keybind->modifiers,
+				keybind->keycodes[i], keybind, toggle,
+				&lookup.toggle_keycodes);
+		}
+		for (size_t i = 0; i < keybind->keysyms_len; i++) {
+			lookup_add(&lookup.keysyms, keybind->modifiers,
+				keybind->keysyms[i], keybind, toggle,
+				&lookup.toggle_keysyms);
+		}
+	}
+}
+
+static struct prefilter_entry *
+prefilter_find(uint32_t modifiers)
+{
+	for (size_t i = 0; i < lookup.prefilter_len; i++) {
+		if (lookup.prefilter[i].modifiers == modifiers) {
+			return &lookup.prefilter[i];
+		}
+	}
+	return NULL;
+}
+
+static void
+prefilter_add_syms(xkb_keycode_t key, const xkb_keysym_t *syms, int nr_syms)
+{
+	for (int i = 0; i < nr_syms; i++) {
+		xkb_keysym_t sym = xkb_keysym_to_lower(syms[i]);
+		for (size_t j = 0; j < lookup.prefilter_len; j++) {
+			struct prefilter_entry *entry = &lookup.prefilter[j];
+			if (int_map_lookup(&lookup.keysyms,
+					lookup_key(entry->modifiers, sym))) {
+				bitset_set(&entry->keycodes, key);
+			}
+		}
+	}
+}
+
+static void
+prefilter_build(struct xkb_keymap *keymap)
+{
+	struct keybind *keybind;
 	wl_list_for_each(keybind, &rc.keybinds, link) {
-		if (keybind->keycodes_layout >= 0
-				&& (xkb_layout_index_t)keybind->keycodes_layout != layout) {
-			/* Prevent storing keycodes from multiple layouts */
-			continue;
+		struct prefilter_entry *entry = prefilter_find(keybind->modifiers);
+		if (!entry) {
+			lookup.prefilter = xrealloc(lookup.prefilter,
+				(lookup.prefilter_len + 1) * sizeof(*entry));
+			entry = &lookup.prefilter[lookup.prefilter_len++];
+			*entry = (struct prefilter_entry){
+				.modifiers = keybind->modifiers,
+			};
 		}
-		if (keybind->use_syms_only) {
-			continue;
+		for (size_t i = 0; i < keybind->keycodes_len; i++) {
+			bitset_set(&entry->keycodes, keybind->keycodes[i]);
 		}
-		for (int i = 0; i < nr_syms; i++) {
-			xkb_keysym_t sym = syms[i];
-			for (size_t j = 0; j < keybind->keysyms_len; j++) {
-				if (sym != keybind->keysyms[j]) {
-					continue;
-				}
-				/* Found keycode for sym */
-				if (keybind->keycodes_len == MAX_KEYCODES) {
-					wlr_log(WLR_ERROR,
-						"Already stored %lu keycodes for keybind",
-						keybind->keycodes_len);
-					break;
-				}
-				bool keycode_exists = false;
-				for (size_t k = 0; k < keybind->keycodes_len; k++) {
-					if (keybind->keycodes[k] == key) {
-						keycode_exists = true;
-						break;
-					}
-				}
-				if (keycode_exists) {
-					continue;
-				}
-				keybind->keycodes[keybind->keycodes_len++] = key;
-				keybind->keycodes_layout = layout;
+	}
+
+	/* Keys producing a bound keysym with any layout and level */
+	xkb_keycode_t min = xkb_keymap_min_keycode(keymap);
+	xkb_keycode_t max = xkb_keymap_max_keycode(keymap);
+	xkb_layout_index_t layouts = xkb_keymap_num_layouts(keymap);
+	for (xkb_keycode_t key = min; key <= max; key++) {
+		for (xkb_layout_index_t layout = 0; layout < layouts; layout++) {
+			xkb_level_index_t levels =
+				xkb_keymap_num_levels_for_key(keymap, key, layout);
+			for (xkb_level_index_t level = 0; level < levels; level++) {
+				const xkb_keysym_t *syms;
+				int nr_syms = xkb_keymap_key_get_syms_by_level(
+					keymap, key, layout, level, &syms);
+				prefilter_add_syms(key, syms, nr_syms);
 			}
 		}
 	}
 }
 
+bool
+keybind_may_match(uint32_t modifiers, xkb_keycode_t keycode)
+{
+	struct prefilter_entry *entry = prefilter_find(modifiers);
+	return entry && bitset_test(&entry->keycodes, keycode);
+}
+
+struct keybind *
+keybind_lookup(uint32_t modifiers, xkb_keysym_t sym, xkb_keycode_t keycode,
+		bool inhibited)
+{
+	if (sym == XKB_KEY_NoSymbol) {
+		return int_map_lookup(inhibited ? &lookup.toggle_keycodes
+			: &lookup.keycodes, lookup_key(modifiers, keycode));
+	}
+	return int_map_lookup(inhibited ? &lookup.toggle_keysyms
+		: &lookup.keysyms,
+		lookup_key(modifiers, xkb_keysym_to_lower(sym)));
+}
+
+void
+keybind_finish_lookup(void)
+{
+	int_map_finish(&lookup.keycodes);
+	int_map_finish(&lookup.keysyms);
+	int_map_finish(&lookup.toggle_keycodes);
+	int_map_finish(&lookup.toggle_keysyms);
+	for (size_t i = 0; i < lookup.prefilter_len; i++) {
+		bitset_finish(&lookup.prefilter[i].keycodes);
+	}
+	zfree(lookup.prefilter);
+	lookup.prefilter_len = 0;
+}
+
 void
 keybind_update_keycodes(struct server *server)
 {
@@ -108,18 +342,34 @@ keybind_update_keycodes(struct server *server)
 		keybind->keycodes_len = 0;
 		keybind->keycodes_layout = -1;
 	}
+
+	/*
+	 * Build a keysym to keycode map per layout with one pass over the
+	 * keymap, then resolve the keysyms of each keybind by lookup.
+	 */
+	struct sym_keycodes map = {0};
 	xkb_layout_index_t layouts = xkb_keymap_num_layouts(keymap);
 	for (xkb_layout_index_t i = 0; i < layouts; i++) {
 		wlr_log(WLR_DEBUG, "Found layout %s", xkb_keymap_layout_get_name(keymap, i));
-		xkb_keymap_key_for_each(keymap, update_keycodes_iter, &i);
+		sym_keycodes_build(&map, keymap, i);
+		wl_list_for_each(keybind, &rc.keybinds, link) {
+			keybind_resolve_keycodes(keybind, &map);
+		}
 	}
+	int_map_finish(&map.first);
+	free(map.pairs);
+
+	lookup_build();
+	prefilter_build(keymap);
 }
 
 struct keybind *
 keybind_create(const char *keybind)
 {
 	xkb_keysym_t sym;
-	struct keybind *k = znew(*k);
+	/* Parsed on the stack as arena memory cannot be given back */
+	struct keybind parsed = {0};
+	struct keybind *k = &parsed;
 	xkb_keysym_t keysyms[MAX_KEYSYMS];
 	gchar **symnames = g_strsplit(keybind, "-", -1);
 	for (size_t i = 0; symnames[i]; i++) {
@@ -145,7 +395,6 @@ keybind_create(const char *keybind)
 			sym = xkb_keysym_to_lower(sym);
 			if (sym == XKB_KEY_NoSymbol) {
 				wlr_log(WLR_ERROR, "unknown keybind (%s)", symname);
-				free(k);
 				k = NULL;
 				break;
 			}
@@ -163,8 +412,10 @@ keybind_create(const char *keybind)
 	if (!k) {
 		return NULL;
 	}
+	k = arena_new(&rc.arena, *k);
+	*k = parsed;
 	wl_list_append(&rc.keybinds, &k->link);
-	k->keysyms = xmalloc(k->keysyms_len * sizeof(xkb_keysym_t));
+	k->keysyms = arena_new_n(&rc.arena, xkb_keysym_t, k->keysyms_len);
 	memcpy(k->keysyms, keysyms, k->keysyms_len * sizeof(xkb_keysym_t));
 	wl_list_init(&k->actions);
 	return k;
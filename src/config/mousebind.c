@@ -5,11 +5,125 @@
 #include <strings.h>
 #include <unistd.h>
 #include <wlr/util/log.h>
+#include "common/arena.h"
+#include "common/hash.h"
+#include "common/int-map.h"
 #include "common/list.h"
+#include "common/macros.h"
 #include "common/mem.h"
 #include "config/mousebind.h"
 #include "config/rcxml.h"
 
+/*
+ * Mousebinds compiled by mousebind_build_lookup(). One map holds, for each
+ * (part type under the cursor, button or scroll direction, modifiers), the
+ * mousebinds whose context contains that part type. The other maps each
+ * button to all mousebinds using it. Both keep rc.mousebinds order.
+ */
+struct mousebind_set {
+	struct wl_array binds; /* struct mousebind * */
+	struct wl_list link;
+};
+
+static struct {
+	struct int_map by_part;
+	struct int_map by_button;
+	struct wl_list sets; /* struct mousebind_set.link */
+} lookup = {
+	.sets = { &lookup.sets, &lookup.sets },
+};
+
+#define LOOKUP_SCROLL 0x80000000u
+
+static uint64_t
+lookup_key(enum ssd_part_type type, uint32_t code, uint32_t modifiers)
+{
+	return ((uint64_t)type << 48) | ((uint64_t)(modifiers & 0xffff) << 32)
+		| code;
+}
+
+static void
+lookup_add(struct int_map *map, uint64_t key, struct mousebind *mousebind)
+{
+	struct mousebind_set *set = int_map_lookup(map, key);
+	if (!set) {
+		set = znew(*set);
+		wl_array_init(&set->binds);
+		wl_list_append(&lookup.sets, &set->link);
+		int_map_insert(map, key, set);
+	}
+	struct mousebind **bind = wl_array_add(&set->binds, sizeof(*bind));
+	*bind = mousebind;
+}
+
+void
+mousebind_build_lookup(void)
+{
+	mousebind_finish_lookup();
+
+	struct mousebind *m;
+	wl_list_for_each(m, &rc.mousebinds, link) {
+		lookup_add(&lookup.by_button, m->button, m);
+
+		uint32_t code;
+		if (m->mouse_event == MOUSE_ACTION_SCROLL) {
+			code = LOOKUP_SCROLL | m->direction;
+		} else if (m->mouse_event != MOUSE_ACTION_NONE) {
+			code = m->button;
+		} else {
+			continue;
+		}
+		for (enum ssd_part_type type = LAB_SSD_NONE;
+				type < LAB_SSD_END_MARKER; type++) {
+			if (ssd_part_contains(m->context, type)) {
+				lookup_add(&lookup.by_part,
+					lookup_key(type, code, m->modifiers), m);
+			}
+		}
+	}
+}
+
+static struct wl_array *
+lookup_find(struct int_map *map, uint64_t key)
+{
+	struct mousebind_set *set = int_map_lookup(map, key);
+	return set ? &set->binds : NULL;
+}
+
+struct wl_array *
+mousebind_lookup(enum ssd_part_type type, uint32_t button, uint32_t modifiers)
+{
+	return lookup_find(&lookup.by_part,
+		lookup_key(type, button, modifiers));
+}
+
+struct wl_array *
+mousebind_lookup_scroll(enum ssd_part_type type, enum direction direction,
+		uint32_t modifiers)
+{
+	return lookup_find(&lookup.by_part,
+		lookup_key(type, LOOKUP_SCROLL | direction, modifiers));
+}
+
+struct wl_array *
+mousebind_lookup_button(uint32_t button)
+{
+	return lookup_find(&lookup.by_button, button);
+}
+
+void
+mousebind_finish_lookup(void)
+{
+	int_map_finish(&lookup.by_part);
+	int_map_finish(&lookup.by_button);
+	struct mousebind_set *set, *tmp;
+	wl_list_for_each_safe(set, tmp, &lookup.sets, link) {
+		wl_list_remove(&set->link);
+		wl_array_release(&set->binds);
+		zfree(set);
+	}
+}
+
 uint32_t
 mousebind_button_from_str(const char *str, uint32_t *modifiers)
 {
@@ -158,6 +272,19 @@ mousebind_the_same(struct mousebind *a, struct mousebind *b)
 		&& a->modifiers == b->modifiers;
 }
 
+uint64_t
+mousebind_hash(struct mousebind *m)
+{
+	assert(m);
+	uint64_t hash = HASH_INIT;
+	uint32_t values[] = { m->context, m->button, m->direction,
+		m->mouse_event, m->modifiers };
+	for (size_t i = 0; i < ARRAY_SIZE(values); i++) {
+		hash = hash_value(hash, values[i]);
+	}
+	return hash;
+}
+
 struct mousebind *
 mousebind_create(const char *context)
 {
@@ -165,7 +292,7 @@ mousebind_create(const char *context)
 		wlr_log(WLR_ERROR, "mousebind context not specified");
 		return NULL;
 	}
-	struct mousebind *m = znew(*m);
+	struct mousebind *m = arena_new(&rc.arena, *m);
 	m->context = context_from_str(context);
 	if (m->context != LAB_SSD_NONE) {
 		wl_list_append(&rc.mousebinds, &m->link);
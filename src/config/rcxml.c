@@ -16,6 +16,8 @@
 #include <wlr/util/log.h>
 #include "action.h"
 #include "common/dir.h"
+#include "common/hash.h"
+#include "common/int-map.h"
 #include "common/list.h"
 #include "common/macros.h"
 #include "common/mem.h"
@@ -116,6 +118,23 @@ parse_window_type(const char *type)
 	}
 }
 
+static int
+parse_content_type(const char *type)
+{
+	if (!strcasecmp(type, "none")) {
+		return LAB_CONTENT_TYPE_NONE;
+	} else if (!strcasecmp(type, "photo")) {
+		return LAB_CONTENT_TYPE_PHOTO;
+	} else if (!strcasecmp(type, "video")) {
+		return LAB_CONTENT_TYPE_VIDEO;
+	} else if (!strcasecmp(type, "game")) {
+		return LAB_CONTENT_TYPE_GAME;
+	} else {
+		wlr_log(WLR_ERROR, "invalid contentType '%s'", type);
+		return -1;
+	}
+}
+
 static void
 fill_usable_area_override(char *nodename, char *content)
 {
@@ -165,8 +184,9 @@ static void
 fill_window_rule(char *nodename, char *content)
 {
 	if (!strcasecmp(nodename, "windowRule.windowRules")) {
-		current_window_rule = znew(*current_window_rule);
+		current_window_rule = arena_new(&rc.arena, *current_window_rule);
 		current_window_rule->window_type = -1; // Window types are >= 0
+		current_window_rule->content_type = -1;
 		wl_list_append(&rc.window_rules, &current_window_rule->link);
 		wl_list_init(&current_window_rule->actions);
 		return;
@@ -180,13 +200,13 @@ fill_window_rule(char *nodename, char *content)
 
 	/* Criteria */
 	} else if (!strcmp(nodename, "identifier")) {
-		free(current_window_rule->identifier);
-		current_window_rule->identifier = xstrdup(content);
+		current_window_rule->identifier = arena_strdup(&rc.arena, content);
 	} else if (!strcmp(nodename, "title")) {
-		free(current_window_rule->title);
-		current_window_rule->title = xstrdup(content);
+		current_window_rule->title = arena_strdup(&rc.arena, content);
 	} else if (!strcmp(nodename, "type")) {
 		current_window_rule->window_type = parse_window_type(content);
+	} else if (!strcasecmp(nodename, "contentType")) {
+		current_window_rule->content_type = parse_content_type(content);
 	} else if (!strcasecmp(nodename, "matchOnce")) {
 		set_bool(content, &current_window_rule->match_once);
 
@@ -202,21 +222,36 @@ fill_window_rule(char *nodename, char *content)
 
 	/* Properties */
 	} else if (!strcasecmp(nodename, "serverDecoration")) {
-		set_property(content, &current_window_rule->server_decoration);
+		set_property(content, &current_window_rule->properties[
+			LAB_WINDOW_RULE_PROP_SERVER_DECORATION]);
 	} else if (!strcasecmp(nodename, "skipTaskbar")) {
-		set_property(content, &current_window_rule->skip_taskbar);
+		set_property(content, &current_window_rule->properties[
+			LAB_WINDOW_RULE_PROP_SKIP_TASKBAR]);
 	} else if (!strcasecmp(nodename, "skipWindowSwitcher")) {
-		set_property(content, &current_window_rule->skip_window_switcher);
+		set_property(content, &current_window_rule->properties[
+			LAB_WINDOW_RULE_PROP_SKIP_WINDOW_SWITCHER]);
 	} else if (!strcasecmp(nodename, "ignoreFocusRequest")) {
-		set_property(content, &current_window_rule->ignore_focus_request);
+		set_property(content, &current_window_rule->properties[
+			LAB_WINDOW_RULE_PROP_IGNORE_FOCUS_REQUEST]);
 	} else if (!strcasecmp(nodename, "ignoreConfigureRequest")) {
-		set_property(content, &current_window_rule->ignore_configure_request);
+		set_property(content, &current_window_rule->properties[
+			LAB_WINDOW_RULE_PROP_IGNORE_CONFIGURE_REQUEST]);
 	} else if (!strcasecmp(nodename, "fixedPosition")) {
-		set_property(content, &current_window_rule->fixed_position);
+		set_property(content, &current_window_rule->properties[
+			LAB_WINDOW_RULE_PROP_FIXED_POSITION]);
+	} else if (!strcasecmp(nodename, "allowTearing")) {
+		set_property(content, &current_window_rule->properties[
+			LAB_WINDOW_RULE_PROP_ALLOW_TEARING]);
+	} else if (!strcasecmp(nodename, "throttleFrames")) {
+		set_property(content, &current_window_rule->properties[
+			LAB_WINDOW_RULE_PROP_THROTTLE_FRAMES]);
+	} else if (!strcasecmp(nodename, "limitCommitRate")) {
+		set_property(content, &current_window_rule->properties[
+			LAB_WINDOW_RULE_PROP_LIMIT_COMMIT_RATE]);
 
 	/* Actions */
 	} else if (!strcmp(nodename, "name.action")) {
-		current_window_rule_action = action_create(content);
+		current_window_rule_action = action_create(&rc.arena, content);
 		if (current_window_rule_action) {
 			wl_list_append(&current_window_rule->actions,
 				&current_window_rule_action->link);
@@ -233,7 +268,7 @@ static void
 fill_window_switcher_field(char *nodename, char *content)
 {
 	if (!strcasecmp(nodename, "field.fields.windowswitcher")) {
-		current_field = osd_field_create();
+		current_field = osd_field_create(&rc.arena);
 		wl_list_append(&rc.window_switcher.fields, &current_field->link);
 		return;
 	}
@@ -244,7 +279,8 @@ fill_window_switcher_field(char *nodename, char *content)
 	} else if (!current_field) {
 		wlr_log(WLR_ERROR, "no <field>");
 	} else {
-		osd_field_arg_from_xml_node(current_field, nodename, content);
+		osd_field_arg_from_xml_node(&rc.arena, current_field, nodename,
+			content);
 	}
 }
 
@@ -254,7 +290,7 @@ fill_region(char *nodename, char *content)
 	string_truncate_at_pattern(nodename, ".region.regions");
 
 	if (!strcasecmp(nodename, "region.regions")) {
-		current_region = znew(*current_region);
+		current_region = arena_new(&rc.arena, *current_region);
 		wl_list_append(&rc.regions, &current_region->link);
 	} else if (!content) {
 		/* intentionally left empty */
@@ -262,16 +298,15 @@ fill_region(char *nodename, char *content)
 		wlr_log(WLR_ERROR, "Expecting <region name=\"\" before %s='%s'",
 			nodename, content);
 	} else if (!strcasecmp(nodename, "name")) {
-		/* Prevent leaking memory if config contains multiple names */
+		/* The first name wins if config contains multiple names */
 		if (!current_region->name) {
-			current_region->name = xstrdup(content);
+			current_region->name = arena_strdup(&rc.arena, content);
 		}
 	} else if (strstr("xywidtheight", nodename) && !strchr(content, '%')) {
 		wlr_log(WLR_ERROR, "Removing invalid region '%s': %s='%s' misses"
 			" a trailing %%", current_region->name, nodename, content);
 		wl_list_remove(&current_region->link);
-		zfree(current_region->name);
-		zfree(current_region);
+		current_region = NULL;
 	} else if (!strcmp(nodename, "x")) {
 		current_region->percentage.x = atoi(content);
 	} else if (!strcmp(nodename, "y")) {
@@ -308,14 +343,14 @@ fill_action_query(char *nodename, char *content, struct action *action)
 			action_arg_add_querylist(action, "query");
 			queries = action_get_querylist(action, "query");
 		}
-		current_view_query = znew(*current_view_query);
+		current_view_query = arena_new(&rc.arena, *current_view_query);
 		wl_list_append(queries, &current_view_query->link);
 	}
 
 	if (!strcasecmp(nodename, "identifier")) {
-		current_view_query->identifier = xstrdup(content);
+		current_view_query->identifier = arena_strdup(&rc.arena, content);
 	} else if (!strcasecmp(nodename, "title")) {
-		current_view_query->title = xstrdup(content);
+		current_view_query->title = arena_strdup(&rc.arena, content);
 	}
 }
 
@@ -348,7 +383,7 @@ fill_child_action(char *nodename, char *content, struct action *parent,
 			wlr_log(WLR_ERROR, "action '%s' cannot be a child action", content);
 			return;
 		}
-		current_child_action = action_create(content);
+		current_child_action = action_create(&rc.arena, content);
 		if (current_child_action) {
 			wl_list_append(siblings, &current_child_action->link);
 		}
@@ -384,7 +419,7 @@ fill_keybind(char *nodename, char *content)
 	} else if (!strcasecmp(nodename, "layoutDependent")) {
 		set_bool(content, &current_keybind->use_syms_only);
 	} else if (!strcmp(nodename, "name.action")) {
-		current_keybind_action = action_create(content);
+		current_keybind_action = action_create(&rc.arena, content);
 		if (current_keybind_action) {
 			wl_list_append(&current_keybind->actions,
 				&current_keybind_action->link);
@@ -444,7 +479,7 @@ fill_mousebind(char *nodename, char *content)
 		current_mousebind->mouse_event =
 			mousebind_event_from_str(content);
 	} else if (!strcmp(nodename, "name.action")) {
-		current_mousebind_action = action_create(content);
+		current_mousebind_action = action_create(&rc.arena, content);
 		if (current_mousebind_action) {
 			wl_list_append(&current_mousebind->actions,
 				&current_mousebind_action->link);
@@ -736,6 +771,8 @@ set_adaptive_sync_mode(const char *str, enum adaptive_sync_mode *variable)
 {
 	if (!strcasecmp(str, "fullscreen")) {
 		*variable = LAB_ADAPTIVE_SYNC_FULLSCREEN;
+	} else if (!strcasecmp(str, "content")) {
+		*variable = LAB_ADAPTIVE_SYNC_CONTENT;
 	} else {
 		int ret = parse_bool(str, -1);
 		if (ret == 1) {
@@ -746,6 +783,18 @@ set_adaptive_sync_mode(const char *str, enum adaptive_sync_mode *variable)
 	}
 }
 
+static void
+set_tearing_mode(const char *str, enum tearing_mode *variable)
+{
+	if (!strcasecmp(str, "fullscreen")) {
+		*variable = LAB_TEARING_FULLSCREEN;
+	} else if (parse_bool(str, -1) == 1) {
+		*variable = LAB_TEARING_ENABLED;
+	} else {
+		*variable = LAB_TEARING_DISABLED;
+	}
+}
+
 static void
 entry(xmlNode *node, char *nodename, char *content)
 {
@@ -860,16 +909,103 @@ entry(xmlNode *node, char *nodename, char *content)
 	} else if (!strcasecmp(nodename, "adaptiveSync.core")) {
 		set_adaptive_sync_mode(content, &rc.adaptive_sync);
 	} else if (!strcasecmp(nodename, "allowTearing.core")) {
-		set_bool(content, &rc.allow_tearing);
+		set_tearing_mode(content, &rc.allow_tearing);
 		if (rc.allow_tearing) {
 			char *no_atomic_env = getenv("WLR_DRM_NO_ATOMIC");
 			if (!no_atomic_env || strcmp(no_atomic_env, "1") != 0) {
-				rc.allow_tearing = false;
+				rc.allow_tearing = LAB_TEARING_DISABLED;
 				wlr_log(WLR_ERROR, "tearing requires WLR_DRM_NO_ATOMIC=1");
 			}
 		}
+	} else if (!strcasecmp(nodename, "outputs.allowTearing.core")) {
+		zfree(rc.tearing_outputs);
+		rc.tearing_outputs = xstrdup(content);
 	} else if (!strcasecmp(nodename, "reuseOutputMode.core")) {
 		set_bool(content, &rc.reuse_output_mode);
+	} else if (!strcasecmp(nodename, "maxRenderTime.core")) {
+		if (!strcasecmp(content, "auto")) {
+			rc.max_render_time = LAB_MAX_RENDER_TIME_AUTO;
+		} else if (!strcasecmp(content, "off")) {
+			rc.max_render_time = 0;
+		} else if (atoi(content) >= 0) {
+			rc.max_render_time = atoi(content);
+		} else {
+			wlr_log(WLR_ERROR, "invalid value for <maxRenderTime>");
+		}
+	} else if (!strcasecmp(nodename, "trimHiddenViews.core")) {
+		if (!strcasecmp(content, "off")) {
+			rc.trim_hidden_views = 0;
+		} else if (atoi(content) >= 0) {
+			rc.trim_hidden_views = atoi(content);
+		} else {
+			wlr_log(WLR_ERROR, "invalid value for <trimHiddenViews>");
+		}
+	} else if (!strcasecmp(nodename, "backgroundFrameRate.core")) {
+		if (!strcasecmp(content, "off")) {
+			rc.background_frame_rate = 0;
+		} else if (atoi(content) >= 0) {
+			rc.background_frame_rate = atoi(content);
+		} else {
+			wlr_log(WLR_ERROR, "invalid value for <backgroundFrameRate>");
+		}
+	} else if (!strcasecmp(nodename, "commitRateLimit.core")) {
+		if (!strcasecmp(content, "off")) {
+			rc.commit_rate_limit = 0;
+		} else if (atoi(content) >= 0) {
+			rc.commit_rate_limit = atoi(content);
+		} else {
+			wlr_log(WLR_ERROR, "invalid value for <commitRateLimit>");
+		}
+	} else if (!strcasecmp(nodename, "outputChangeDelay.core")) {
+		if (atoi(content) >= 0) {
+			rc.output_change_delay = atoi(content);
+		} else {
+			wlr_log(WLR_ERROR, "invalid value for <outputChangeDelay>");
+		}
+	} else if (!strcasecmp(nodename, "bufferCacheSize.core")) {
+		if (atoi(content) >= 0) {
+			rc.buffer_cache_size = atoi(content);
+		} else {
+			wlr_log(WLR_ERROR, "invalid value for <bufferCacheSize>");
+		}
+	} else if (!strcasecmp(nodename, "xwaylandPrewarm.core")) {
+		if (!strcasecmp(content, "off")) {
+			rc.xwayland_prewarm = 0;
+		} else if (atoi(content) >= 0) {
+			rc.xwayland_prewarm = atoi(content);
+		} else {
+			wlr_log(WLR_ERROR, "invalid value for <xwaylandPrewarm>");
+		}
+	} else if (!strcasecmp(nodename, "trimHeap.core")) {
+		set_bool(content, &rc.trim_heap);
+	} else if (!strcasecmp(nodename, "memoryPressure.core")) {
+		set_bool(content, &rc.memory_pressure);
+	} else if (!strcasecmp(nodename, "rate.idleRefresh.core")) {
+		if (!strcasecmp(content, "off")) {
+			rc.idle_refresh_rate = 0;
+		} else if (atoi(content) >= 0) {
+			rc.idle_refresh_rate = atoi(content);
+		} else {
+			wlr_log(WLR_ERROR, "invalid value for <idleRefresh rate>");
+		}
+	} else if (!strcasecmp(nodename, "delay.idleRefresh.core")) {
+		if (atoi(content) > 0) {
+			rc.idle_refresh_delay = atoi(content);
+		} else {
+			wlr_log(WLR_ERROR, "invalid value for <idleRefresh delay>");
+		}
+	} else if (!strcasecmp(nodename, "batteryOnly.idleRefresh.core")) {
+		set_bool(content, &rc.idle_refresh_battery_only);
+	} else if (!strcasecmp(nodename, "reducedEffects.core")) {
+		if (!strcasecmp(content, "auto")) {
+			rc.reduced_effects = LAB_REDUCED_EFFECTS_AUTO;
+		} else if (parse_bool(content, -1) == 1) {
+			rc.reduced_effects = LAB_REDUCED_EFFECTS_ENABLED;
+		} else if (parse_bool(content, -1) == 0) {
+			rc.reduced_effects = LAB_REDUCED_EFFECTS_DISABLED;
+		} else {
+			wlr_log(WLR_ERROR, "invalid value for <reducedEffects>");
+		}
 	} else if (!strcmp(nodename, "policy.placement")) {
 		if (!strcmp(content, "automatic")) {
 			rc.placement_policy = LAB_PLACE_AUTOMATIC;
@@ -878,6 +1014,8 @@ entry(xmlNode *node, char *nodename, char *content)
 		} else {
 			rc.placement_policy = LAB_PLACE_CENTER;
 		}
+	} else if (!strcmp(nodename, "memory.placement")) {
+		rc.placement_memory_size = MAX(atoi(content), 0);
 	} else if (!strcmp(nodename, "name.theme")) {
 		rc.theme_name = xstrdup(content);
 	} else if (!strcmp(nodename, "cornerradius.theme")) {
@@ -886,6 +1024,8 @@ entry(xmlNode *node, char *nodename, char *content)
 		set_bool(content, &rc.ssd_keep_border);
 	} else if (!strcasecmp(nodename, "dropShadows.theme")) {
 		set_bool(content, &rc.shadows_enabled);
+	} else if (!strcasecmp(nodename, "glyphCache.theme")) {
+		set_bool(content, &rc.glyph_cache);
 	} else if (!strcmp(nodename, "name.font.theme")) {
 		fill_font(nodename, content, font_place);
 	} else if (!strcmp(nodename, "size.font.theme")) {
@@ -909,6 +1049,8 @@ entry(xmlNode *node, char *nodename, char *content)
 		}
 	} else if (!strcasecmp(nodename, "scrollFactor.mouse")) {
 		set_double(content, &rc.scroll_factor);
+	} else if (!strcasecmp(nodename, "coalesceMotion.mouse")) {
+		set_bool(content, &rc.coalesce_motion);
 	} else if (!strcasecmp(nodename, "name.context.mouse")) {
 		current_mouse_context = content;
 		current_mousebind = NULL;
@@ -952,13 +1094,29 @@ entry(xmlNode *node, char *nodename, char *content)
 			wlr_log(WLR_ERROR, "ignoring invalid value for notifyClient");
 		}
 
-	/* <windowSwitcher show="" preview="" outlines="" /> */
+	/*
+	 * <windowSwitcher show="" preview="" outlines="" thumbnails=""
+	 *   filter="" order="" />
+	 */
 	} else if (!strcasecmp(nodename, "show.windowSwitcher")) {
 		set_bool(content, &rc.window_switcher.show);
 	} else if (!strcasecmp(nodename, "preview.windowSwitcher")) {
 		set_bool(content, &rc.window_switcher.preview);
 	} else if (!strcasecmp(nodename, "outlines.windowSwitcher")) {
 		set_bool(content, &rc.window_switcher.outlines);
+	} else if (!strcasecmp(nodename, "thumbnails.windowSwitcher")) {
+		set_bool(content, &rc.window_switcher.thumbnails);
+	} else if (!strcasecmp(nodename, "filter.windowSwitcher")) {
+		set_bool(content, &rc.window_switcher.filter);
+	} else if (!strcasecmp(nodename, "order.windowSwitcher")) {
+		if (!strcasecmp(content, "focus")) {
+			rc.window_switcher.order = LAB_WINDOW_SWITCHER_ORDER_FOCUS;
+		} else if (!strcasecmp(content, "stacking")) {
+			rc.window_switcher.order = LAB_WINDOW_SWITCHER_ORDER_STACKING;
+		} else {
+			wlr_log(WLR_ERROR, "invalid windowSwitcher order '%s'",
+				content);
+		}
 	} else if (!strcasecmp(nodename, "allWorkspaces.windowSwitcher")) {
 		if (parse_bool(content, -1) == true) {
 			rc.window_switcher.criteria &=
@@ -1001,6 +1159,8 @@ entry(xmlNode *node, char *nodename, char *content)
 		rc.workspace_config.min_nr_workspaces = MAX(1, atoi(content));
 	} else if (!strcasecmp(nodename, "prefix.desktops")) {
 		rc.workspace_config.prefix = xstrdup(content);
+	} else if (!strcasecmp(nodename, "fingers.swipe.desktops")) {
+		rc.workspace_config.swipe_fingers = MAX(0, atoi(content));
 	} else if (!strcasecmp(nodename, "popupShow.resize")) {
 		if (!strcasecmp(content, "Always")) {
 			rc.resize_indicator = LAB_RESIZE_INDICATOR_ALWAYS;
@@ -1011,6 +1171,8 @@ entry(xmlNode *node, char *nodename, char *content)
 		} else {
 			wlr_log(WLR_ERROR, "Invalid value for <resize popupShow />");
 		}
+	} else if (!strcasecmp(nodename, "pacing.resize")) {
+		set_bool(content, &rc.resize_pacing);
 	} else if (!strcasecmp(nodename, "mapToOutput.tablet")) {
 		rc.tablet.output_name = xstrdup(content);
 	} else if (!strcasecmp(nodename, "rotate.tablet")) {
@@ -1152,17 +1314,103 @@ xml_tree_walk(xmlNode *node)
 }
 
 /* Exposed in header file to allow unit tests to parse buffers */
-void
-rcxml_parse_xml(struct buf *b)
+static enum rc_section
+section_from_name(const char *name)
+{
+	static const char *const names[LAB_RC_SECTION_COUNT] = {
+		[LAB_RC_SECTION_CORE] = "core",
+		[LAB_RC_SECTION_THEME] = "theme",
+		[LAB_RC_SECTION_KEYBOARD] = "keyboard",
+		[LAB_RC_SECTION_MOUSE] = "mouse",
+		[LAB_RC_SECTION_LIBINPUT] = "libinput",
+		[LAB_RC_SECTION_TOUCH] = "touch",
+		[LAB_RC_SECTION_TABLET] = "tablet",
+		[LAB_RC_SECTION_SNAPPING] = "snapping",
+		[LAB_RC_SECTION_RESIZE] = "resize",
+		[LAB_RC_SECTION_DESKTOPS] = "desktops",
+		[LAB_RC_SECTION_REGIONS] = "regions",
+	};
+	for (size_t i = 1; i < ARRAY_SIZE(names); i++) {
+		if (!strcasecmp(name, names[i])) {
+			return i;
+		}
+	}
+	return LAB_RC_SECTION_OTHER;
+}
+
+/* Add the content of each top-level element to the hash of its section */
+static void
+hash_sections(xmlDoc *doc)
+{
+	xmlNode *root = xmlDocGetRootElement(doc);
+	if (!root) {
+		return;
+	}
+	xmlBuffer *buf = xmlBufferCreate();
+	for (xmlNode *n = root->children; n; n = n->next) {
+		if (n->type != XML_ELEMENT_NODE) {
+			continue;
+		}
+		xmlBufferEmpty(buf);
+		xmlNodeDump(buf, doc, n, 0, 0);
+		uint64_t *hash = &rc.section_hashes[
+			section_from_name((char *)n->name)];
+		*hash = hash_bytes(*hash, xmlBufferContent(buf),
+			xmlBufferLength(buf));
+	}
+	xmlBufferFree(buf);
+}
+
+static void
+parse_memory(const char *data, size_t len)
 {
-	xmlDoc *d = xmlParseMemory(b->data, b->len);
+	xmlDoc *d = xmlReadMemory(data, len, NULL, NULL, 0);
 	if (!d) {
 		wlr_log(WLR_ERROR, "error parsing config file");
 		return;
 	}
+	hash_sections(d);
 	xml_tree_walk(xmlDocGetRootElement(d));
 	xmlFreeDoc(d);
-	xmlCleanupParser();
+}
+
+void
+rcxml_parse_xml(struct buf *b)
+{
+	parse_memory(b->data, b->len);
+}
+
+/*
+ * Parse a config file read in one go. It is not mapped, as that would
+ * fault if the file was truncated by an editor while being parsed.
+ */
+static bool
+parse_file(const char *filename)
+{
+	gchar *data = NULL;
+	gsize size = 0;
+	GError *err = NULL;
+	if (!g_file_get_contents(filename, &data, &size, &err)) {
+		if (!g_error_matches(err, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+			wlr_log(WLR_ERROR, "failed to read config file %s: %s",
+				filename, err->message);
+		}
+		g_error_free(err);
+		return false;
+	}
+
+	wlr_log(WLR_INFO, "read config file %s", filename);
+
+	/* Join lines in place, values spread over lines rely on it */
+	size_t len = 0;
+	for (gsize i = 0; i < size; i++) {
+		if (data[i] != '\n') {
+			data[len++] = data[i];
+		}
+	}
+	parse_memory(data, len);
+	g_free(data);
+	return true;
 }
 
 static void
@@ -1191,12 +1439,31 @@ rcxml_init(void)
 	}
 	has_run = true;
 
+	for (size_t i = 0; i < ARRAY_SIZE(rc.section_hashes); i++) {
+		rc.section_hashes[i] = HASH_INIT;
+	}
+
 	rc.placement_policy = LAB_PLACE_CENTER;
+	rc.placement_memory_size = 0;
+	rc.max_render_time = 0;
+	rc.trim_hidden_views = 0;
+	rc.background_frame_rate = 0;
+	rc.commit_rate_limit = 0;
+	rc.output_change_delay = 0;
+	rc.buffer_cache_size = 32;
+	rc.xwayland_prewarm = 0;
+	rc.trim_heap = false;
+	rc.memory_pressure = false;
+	rc.idle_refresh_rate = 0;
+	rc.idle_refresh_delay = 5000;
+	rc.idle_refresh_battery_only = true;
+	rc.reduced_effects = LAB_REDUCED_EFFECTS_AUTO;
 
 	rc.xdg_shell_server_side_deco = true;
 	rc.ssd_keep_border = true;
 	rc.corner_radius = 8;
 	rc.shadows_enabled = false;
+	rc.glyph_cache = false;
 
 	init_font_defaults(&rc.font_activewindow);
 	init_font_defaults(&rc.font_inactivewindow);
@@ -1209,6 +1476,7 @@ rcxml_init(void)
 
 	rc.doubleclick_time = 500;
 	rc.scroll_factor = 1.0;
+	rc.coalesce_motion = false;
 
 	rc.tablet.output_name = NULL;
 	rc.tablet.rotation = 0;
@@ -1232,14 +1500,19 @@ rcxml_init(void)
 	rc.window_switcher.show = true;
 	rc.window_switcher.preview = true;
 	rc.window_switcher.outlines = true;
+	rc.window_switcher.thumbnails = false;
+	rc.window_switcher.filter = false;
+	rc.window_switcher.order = LAB_WINDOW_SWITCHER_ORDER_STACKING;
 	rc.window_switcher.criteria = LAB_VIEW_CRITERIA_CURRENT_WORKSPACE
 		| LAB_VIEW_CRITERIA_ROOT_TOPLEVEL
 		| LAB_VIEW_CRITERIA_NO_SKIP_WINDOW_SWITCHER;
 
 	rc.resize_indicator = LAB_RESIZE_INDICATOR_NEVER;
+	rc.resize_pacing = true;
 
 	rc.workspace_config.popuptime = INT_MIN;
 	rc.workspace_config.min_nr_workspaces = 1;
+	rc.workspace_config.swipe_fingers = 0;
 
 	rc.menu_ignore_button_release_period = 250;
 }
@@ -1256,7 +1529,7 @@ load_default_key_bindings(void)
 			continue;
 		}
 
-		action = action_create(current->action);
+		action = action_create(&rc.arena, current->action);
 		wl_list_append(&k->actions, &action->link);
 
 		for (size_t j = 0; j < ARRAY_SIZE(current->attributes); j++) {
@@ -1296,7 +1569,7 @@ load_default_mouse_bindings(void)
 			count++;
 		}
 
-		action = action_create(current->action);
+		action = action_create(&rc.arena, current->action);
 		wl_list_append(&m->actions, &action->link);
 
 		for (size_t j = 0; j < ARRAY_SIZE(current->attributes); j++) {
@@ -1317,25 +1590,36 @@ deduplicate_mouse_bindings(void)
 {
 	uint32_t replaced = 0;
 	uint32_t cleared = 0;
-	struct mousebind *current, *tmp, *existing;
-	wl_list_for_each_safe(existing, tmp, &rc.mousebinds, link) {
-		wl_list_for_each_reverse(current, &rc.mousebinds, link) {
-			if (existing == current) {
-				break;
+	struct mousebind *current, *tmp, *later;
+	/* The last of equal bindings wins, so walk backwards */
+	struct int_map seen = {0};
+	wl_list_for_each_reverse_safe(current, tmp, &rc.mousebinds, link) {
+		uint64_t hash = mousebind_hash(current);
+		later = int_map_lookup(&seen, hash);
+		if (!later) {
+			int_map_insert(&seen, hash, current);
+			continue;
+		}
+		if (!mousebind_the_same(current, later)) {
+			/* Hash collision, compare with all later bindings */
+			for (later = wl_container_of(current->link.next, later, link);
+					&later->link != &rc.mousebinds;
+					later = wl_container_of(later->link.next, later, link)) {
+				if (mousebind_the_same(current, later)) {
+					break;
+				}
 			}
-			if (mousebind_the_same(existing, current)) {
-				wl_list_remove(&existing->link);
-				action_list_free(&existing->actions);
-				free(existing);
-				replaced++;
-				break;
+			if (&later->link == &rc.mousebinds) {
+				continue;
 			}
 		}
+		wl_list_remove(&current->link);
+		replaced++;
 	}
+	int_map_finish(&seen);
 	wl_list_for_each_safe(current, tmp, &rc.mousebinds, link) {
 		if (wl_list_empty(&current->actions)) {
 			wl_list_remove(&current->link);
-			free(current);
 			cleared++;
 		}
 	}
@@ -1352,25 +1636,36 @@ deduplicate_key_bindings(void)
 {
 	uint32_t replaced = 0;
 	uint32_t cleared = 0;
-	struct keybind *current, *tmp, *existing;
-	wl_list_for_each_safe(existing, tmp, &rc.keybinds, link) {
-		wl_list_for_each_reverse(current, &rc.keybinds, link) {
-			if (existing == current) {
-				break;
+	struct keybind *current, *tmp, *later;
+	/* The last of equal bindings wins, so walk backwards */
+	struct int_map seen = {0};
+	wl_list_for_each_reverse_safe(current, tmp, &rc.keybinds, link) {
+		uint64_t hash = keybind_hash(current);
+		later = int_map_lookup(&seen, hash);
+		if (!later) {
+			int_map_insert(&seen, hash, current);
+			continue;
+		}
+		if (!keybind_the_same(current, later)) {
+			/* Hash collision, compare with all later bindings */
+			for (later = wl_container_of(current->link.next, later, link);
+					&later->link != &rc.keybinds;
+					later = wl_container_of(later->link.next, later, link)) {
+				if (keybind_the_same(current, later)) {
+					break;
+				}
 			}
-			if (keybind_the_same(existing, current)) {
-				wl_list_remove(&existing->link);
-				action_list_free(&existing->actions);
-				free(existing);
-				replaced++;
-				break;
+			if (&later->link == &rc.keybinds) {
+				continue;
 			}
 		}
+		wl_list_remove(&current->link);
+		replaced++;
 	}
+	int_map_finish(&seen);
 	wl_list_for_each_safe(current, tmp, &rc.keybinds, link) {
 		if (wl_list_empty(&current->actions)) {
 			wl_list_remove(&current->link);
-			free(current);
 			cleared++;
 		}
 	}
@@ -1398,7 +1693,7 @@ load_default_window_switcher_fields(void)
 	struct window_switcher_field *field;
 
 	for (int i = 0; fields[i].content != LAB_FIELD_NONE; i++) {
-		field = znew(*field);
+		field = osd_field_create(&rc.arena);
 		field->content = fields[i].content;
 		field->width = fields[i].width;
 		wl_list_append(&rc.window_switcher.fields, &field->link);
@@ -1470,16 +1765,6 @@ post_processing(void)
 	}
 }
 
-static void
-rule_destroy(struct window_rule *rule)
-{
-	wl_list_remove(&rule->link);
-	zfree(rule->identifier);
-	zfree(rule->title);
-	action_list_free(&rule->actions);
-	zfree(rule);
-}
-
 static void
 validate_actions(void)
 {
@@ -1490,7 +1775,6 @@ validate_actions(void)
 		wl_list_for_each_safe(action, action_tmp, &keybind->actions, link) {
 			if (!action_is_valid(action)) {
 				wl_list_remove(&action->link);
-				action_free(action);
 				wlr_log(WLR_ERROR, "Removed invalid keybind action");
 			}
 		}
@@ -1501,7 +1785,6 @@ validate_actions(void)
 		wl_list_for_each_safe(action, action_tmp, &mousebind->actions, link) {
 			if (!action_is_valid(action)) {
 				wl_list_remove(&action->link);
-				action_free(action);
 				wlr_log(WLR_ERROR, "Removed invalid mousebind action");
 			}
 		}
@@ -1512,7 +1795,6 @@ validate_actions(void)
 		wl_list_for_each_safe(action, action_tmp, &rule->actions, link) {
 			if (!action_is_valid(action)) {
 				wl_list_remove(&action->link);
-				action_free(action);
 				wlr_log(WLR_ERROR, "Removed invalid window rule action");
 			}
 		}
@@ -1536,17 +1818,16 @@ validate(void)
 				"Removing invalid region '%s': %d%% x %d%% @ %d%%,%d%%",
 				region->name, box.width, box.height, box.x, box.y);
 			wl_list_remove(&region->link);
-			zfree(region->name);
-			free(region);
 		}
 	}
 
 	/* Window-rule criteria */
 	struct window_rule *rule, *rule_tmp;
 	wl_list_for_each_safe(rule, rule_tmp, &rc.window_rules, link) {
-		if (!rule->identifier && !rule->title && rule->window_type < 0) {
+		if (!rule->identifier && !rule->title && rule->window_type < 0
+				&& rule->content_type < 0) {
 			wlr_log(WLR_ERROR, "Deleting rule %p as it has no criteria", rule);
-			rule_destroy(rule);
+			wl_list_remove(&rule->link);
 		}
 	}
 
@@ -1558,7 +1839,7 @@ validate(void)
 		if (!osd_field_validate(field)) {
 			wlr_log(WLR_ERROR, "Deleting invalid window switcher field %p", field);
 			wl_list_remove(&field->link);
-			osd_field_free(field);
+			osd_field_invalidate_all();
 		}
 	}
 }
@@ -1580,7 +1861,6 @@ rcxml_read(const char *filename)
 		paths_config_create(&paths, "rc.xml");
 	}
 
-	/* Reading file into buffer before parsing - better for unit tests */
 	bool should_merge_config = rc.merge_config;
 	struct wl_list *(*iter)(struct wl_list *list);
 	iter = should_merge_config ? paths_get_prev : paths_get_next;
@@ -1597,27 +1877,9 @@ rcxml_read(const char *filename)
 	 */
 	for (struct wl_list *elm = iter(&paths); elm != &paths; elm = iter(elm)) {
 		struct path *path = wl_container_of(elm, path, link);
-		FILE *stream = fopen(path->string, "r");
-		if (!stream) {
+		if (!parse_file(path->string)) {
 			continue;
 		}
-
-		wlr_log(WLR_INFO, "read config file %s", path->string);
-
-		struct buf b = BUF_INIT;
-		char *line = NULL;
-		size_t len = 0;
-		while (getline(&line, &len, stream) != -1) {
-			char *p = strrchr(line, '\n');
-			if (p) {
-				*p = '\0';
-			}
-			buf_add(&b, line);
-		}
-		zfree(line);
-		fclose(stream);
-		rcxml_parse_xml(&b);
-		buf_reset(&b);
 		if (!should_merge_config) {
 			break;
 		}
@@ -1625,6 +1887,8 @@ rcxml_read(const char *filename)
 	paths_destroy(&paths);
 	post_processing();
 	validate();
+	mousebind_build_lookup();
+	window_rules_compile();
 }
 
 void
@@ -1644,20 +1908,8 @@ rcxml_finish(void)
 		zfree(area);
 	}
 
-	struct keybind *k, *k_tmp;
-	wl_list_for_each_safe(k, k_tmp, &rc.keybinds, link) {
-		wl_list_remove(&k->link);
-		action_list_free(&k->actions);
-		zfree(k->keysyms);
-		zfree(k);
-	}
-
-	struct mousebind *m, *m_tmp;
-	wl_list_for_each_safe(m, m_tmp, &rc.mousebinds, link) {
-		wl_list_remove(&m->link);
-		action_list_free(&m->actions);
-		zfree(m);
-	}
+	keybind_finish_lookup();
+	mousebind_finish_lookup();
 
 	struct touch_config_entry *touch_config, *touch_config_tmp;
 	wl_list_for_each_safe(touch_config, touch_config_tmp, &rc.touch_configs, link) {
@@ -1668,6 +1920,7 @@ rcxml_finish(void)
 	}
 
 	zfree(rc.tablet.output_name);
+	zfree(rc.tearing_outputs);
 
 	struct libinput_category *l, *l_tmp;
 	wl_list_for_each_safe(l, l_tmp, &rc.libinput_categories, link) {
@@ -1683,18 +1936,17 @@ rcxml_finish(void)
 		zfree(w);
 	}
 
-	regions_destroy(NULL, &rc.regions);
-
-	struct window_switcher_field *field, *field_tmp;
-	wl_list_for_each_safe(field, field_tmp, &rc.window_switcher.fields, link) {
-		wl_list_remove(&field->link);
-		osd_field_free(field);
-	}
+	osd_field_invalidate_all();
+	window_rules_finish();
+	view_queries_reset();
 
-	struct window_rule *rule, *rule_tmp;
-	wl_list_for_each_safe(rule, rule_tmp, &rc.window_rules, link) {
-		rule_destroy(rule);
-	}
+	/* Keybinds, mousebinds, regions, switcher fields and window rules */
+	arena_release(&rc.arena);
+	wl_list_init(&rc.keybinds);
+	wl_list_init(&rc.mousebinds);
+	wl_list_init(&rc.regions);
+	wl_list_init(&rc.window_switcher.fields);
+	wl_list_init(&rc.window_rules);
 
 	/* Reset state vars for starting fresh when Reload is triggered */
 	current_usable_area_override = NULL;
@@ -8,6 +8,7 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 #include <wlr/backend/drm.h>
 #include <wlr/backend/multi.h>
 #include <wlr/util/log.h>
@@ -16,6 +17,7 @@
 #include "common/file-helpers.h"
 #include "common/mem.h"
 #include "common/parse-bool.h"
+#include "common/phase-timer.h"
 #include "common/spawn.h"
 #include "common/string-helpers.h"
 #include "config/session.h"
@@ -32,6 +34,20 @@ static const char *const env_vars[] = {
 	NULL
 };
 
+/* Command updating the activation environment, see update_activation_env() */
+struct activation_cmd {
+	struct spawn_piped_child *child;
+	int pipe_fd;
+	struct wl_event_source *source;
+	struct phase_timer_task task;
+	struct wl_list link; /* activation_cmds */
+};
+
+static struct wl_list activation_cmds = {
+	.prev = &activation_cmds,
+	.next = &activation_cmds,
+};
+
 static void
 process_line(char *line)
 {
@@ -185,6 +201,54 @@ should_update_activation(struct server *server)
 	return have_drm;
 }
 
+static void
+activation_cmd_destroy(struct activation_cmd *cmd)
+{
+	wl_event_source_remove(cmd->source);
+	spawn_piped_close(cmd->child, cmd->pipe_fd);
+	wl_list_remove(&cmd->link);
+	free(cmd);
+}
+
+static int
+handle_activation_cmd_output(int fd, uint32_t mask, void *data)
+{
+	struct activation_cmd *cmd = data;
+	char buf[256];
+	if ((mask & WL_EVENT_READABLE) && read(fd, buf, sizeof(buf)) > 0) {
+		/* Output is discarded, the command is done at end of file */
+		return 0;
+	}
+	phase_timer_task_end(&cmd->task);
+	activation_cmd_destroy(cmd);
+	return 0;
+}
+
+/*
+ * Run @command without blocking the event loop, its completion is
+ * reported by the phase timer. @name must be a string literal.
+ */
+static void
+spawn_activation_cmd(struct server *server, const char *command,
+		const char *name)
+{
+	struct activation_cmd *cmd = znew(*cmd);
+	cmd->child = spawn_piped(command, &cmd->pipe_fd);
+	if (!cmd->child) {
+		free(cmd);
+		return;
+	}
+	cmd->source = wl_event_loop_add_fd(server->wl_event_loop, cmd->pipe_fd,
+		WL_EVENT_READABLE, handle_activation_cmd_output, cmd);
+	if (!cmd->source) {
+		spawn_piped_close(cmd->child, cmd->pipe_fd);
+		free(cmd);
+		return;
+	}
+	phase_timer_task_begin(&cmd->task, name);
+	wl_list_insert(&activation_cmds, &cmd->link);
+}
+
 static void
 update_activation_env(struct server *server, bool initialize)
 {
@@ -204,15 +268,28 @@ update_activation_env(struct server *server, bool initialize)
 	char *env_keys = str_join(env_vars, "%s", " ");
 	char *env_unset_keys = initialize ? NULL : str_join(env_vars, "%s=", " ");
 
+	/*
+	 * Neither command is waited for. At startup they are watched from
+	 * the event loop to report when they are done, on shutdown the
+	 * event loop is no longer running.
+	 */
 	char *cmd =
 		strdup_printf("dbus-update-activation-environment %s",
 			initialize ? env_keys : env_unset_keys);
-	spawn_async_no_shell(cmd);
+	if (initialize) {
+		spawn_activation_cmd(server, cmd, "dbus activation environment");
+	} else {
+		spawn_async_no_shell(cmd);
+	}
 	free(cmd);
 
 	cmd = strdup_printf("systemctl --user %s %s",
 		initialize ? "import-environment" : "unset-environment", env_keys);
-	spawn_async_no_shell(cmd);
+	if (initialize) {
+		spawn_activation_cmd(server, cmd, "systemd activation environment");
+	} else {
+		spawn_async_no_shell(cmd);
+	}
 	free(cmd);
 
 	free(env_keys);
@@ -301,6 +378,12 @@ session_shutdown(struct server *server)
 {
 	run_session_script("shutdown");
 
+	/* Stop watching commands from startup which are still running */
+	struct activation_cmd *cmd, *tmp;
+	wl_list_for_each_safe(cmd, tmp, &activation_cmds, link) {
+		activation_cmd_destroy(cmd);
+	}
+
 	/* Clear the dbus and systemd user environment, each may fail gracefully */
 	update_activation_env(server, /* initialize */ false);
 }
@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <wlr/types/wlr_compositor.h>
+#include "client-stats.h"
+#include "common/histogram.h"
+#include "common/list.h"
+#include "common/macros.h"
+#include "common/mem.h"
+#include "common/time-helpers.h"
+#include "configure-stats.h"
+#include "debug.h"
+#include "flight-recorder.h"
+#include "view.h"
+
+#define CONFIGURE_TIMEOUT_DEFAULT_MS 100
+#define CONFIGURE_TIMEOUT_MIN_MS 50
+#define CONFIGURE_TIMEOUT_MAX_MS 1000
+/* Extra time on top of the 99th percentile, about one frame */
+#define CONFIGURE_TIMEOUT_MARGIN_MS 16
+/* Responses needed before the percentile is trusted */
+#define CONFIGURE_STATS_MIN_SAMPLES 20
+
+struct configure_stats {
+	char *name;
+	/* Response times in microseconds */
+	struct histogram response;
+	uint64_t timeouts;
+	struct wl_list link;
+};
+
+static struct wl_list apps = { &apps, &apps };
+
+static const char *
+view_app_name(struct view *view)
+{
+	const char *name = view_get_string_prop(view,
+		view->type == LAB_XWAYLAND_VIEW ? "class" : "app_id");
+	return name && *name ? name : "unknown";
+}
+
+static struct configure_stats *
+get_stats(struct view *view)
+{
+	const char *name = view_app_name(view);
+	struct configure_stats *stats;
+	wl_list_for_each(stats, &apps, link) {
+		if (!strcmp(stats->name, name)) {
+			return stats;
+		}
+	}
+	stats = znew(*stats);
+	stats->name = xstrdup(name);
+	wl_list_append(&apps, &stats->link);
+	return stats;
+}
+
+static int
+timeout_ms(struct configure_stats *stats)
+{
+	if (stats->response.count < CONFIGURE_STATS_MIN_SAMPLES) {
+		return CONFIGURE_TIMEOUT_DEFAULT_MS;
+	}
+	int p99_ms = histogram_percentile(&stats->response, 99) / 1000;
+	int timeout = p99_ms + p99_ms / 2 + CONFIGURE_TIMEOUT_MARGIN_MS;
+	return MIN(MAX(timeout, CONFIGURE_TIMEOUT_MIN_MS),
+		CONFIGURE_TIMEOUT_MAX_MS);
+}
+
+static uint32_t
+elapsed_usec(struct view *view)
+{
+	return nsec_to_usec(time_now_nsec() - view->configure_sent_nsec);
+}
+
+int
+configure_stats_sent(struct view *view)
+{
+	view->configure_sent_nsec = time_now_nsec();
+	flight_record(FLIGHT_EVENT_CONFIGURE_SENT, 0, (uintptr_t)view, 0);
+	return timeout_ms(get_stats(view));
+}
+
+void
+configure_stats_acked(struct view *view)
+{
+	if (!view->configure_sent_nsec) {
+		return;
+	}
+	uint32_t usec = elapsed_usec(view);
+	flight_record(FLIGHT_EVENT_CONFIGURE_ACKED, 0, (uintptr_t)view, usec);
+	histogram_add(&get_stats(view)->response, usec);
+	if (view->surface && view->surface->resource) {
+		client_stats_configure_acked(
+			wl_resource_get_client(view->surface->resource), usec);
+	}
+	view->configure_sent_nsec = 0;
+}
+
+int
+configure_stats_timed_out(struct view *view)
+{
+	if (!view->configure_sent_nsec) {
+		return 0;
+	}
+	uint32_t usec = elapsed_usec(view);
+	flight_record(FLIGHT_EVENT_CONFIGURE_TIMEOUT, 0, (uintptr_t)view,
+		usec / 1000);
+	struct configure_stats *stats = get_stats(view);
+	histogram_add(&stats->response, usec);
+	stats->timeouts++;
+	view->configure_sent_nsec = 0;
+	return usec / 1000;
+}
+
+void
+configure_stats_dump(void)
+{
+	if (wl_list_empty(&apps)) {
+		return;
+	}
+	printf(" configure response times\n");
+	debug_dump_histogram_header("usec");
+	struct configure_stats *stats;
+	wl_list_for_each(stats, &apps, link) {
+		debug_dump_histogram(stats->name, &stats->response);
+	}
+	wl_list_for_each(stats, &apps, link) {
+		if (stats->timeouts) {
+			printf("   %s: %llu timeouts, now waiting %d ms\n",
+				stats->name, (unsigned long long)stats->timeouts,
+				timeout_ms(stats));
+		}
+	}
+	printf("\n");
+}
+
+void
+configure_stats_for_each(void (*fn)(const char *name,
+	struct histogram *response, uint64_t timeouts, void *data), void *data)
+{
+	struct configure_stats *stats;
+	wl_list_for_each(stats, &apps, link) {
+		fn(stats->name, &stats->response, stats->timeouts, data);
+	}
+}
+
+void
+configure_stats_finish(void)
+{
+	struct configure_stats *stats, *tmp;
+	wl_list_for_each_safe(stats, tmp, &apps, link) {
+		wl_list_remove(&stats->link);
+		zfree(stats->name);
+		zfree(stats);
+	}
+}
@@ -1,11 +1,26 @@
 // SPDX-License-Identifier: GPL-2.0-only
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 #include <wlr/types/wlr_layer_shell_v1.h>
+#include <wlr/types/wlr_output_layout.h>
 #include <wlr/types/wlr_scene.h>
+#include "buffer.h"
+#include "client-stats.h"
+#include "common/buf.h"
 #include "common/graphic-helpers.h"
+#include "common/int-map.h"
+#include "common/macros.h"
+#include "common/mem.h"
+#include "common/scaled_scene_buffer.h"
 #include "common/scene-helpers.h"
+#include "common/time-helpers.h"
+#include "configure-stats.h"
 #include "debug.h"
 #include "input/ime.h"
+#include "input/latency.h"
 #include "labwc.h"
+#include "layers.h"
 #include "node.h"
 #include "ssd.h"
 #include "view.h"
@@ -21,8 +36,47 @@
 #define IGNORE_OSD_PREVIEW_OUTLINE true
 #define IGNORE_SNAPPING_PREVIEW_OUTLINE true
 
+#define DAMAGE_HIGHLIGHT_MSEC 250
+#define DAMAGE_HIGHLIGHT_ALPHA 0.4f
+#define DAMAGE_HIGHLIGHT_MAX_RECTS 64
+
 static struct view *last_view;
 
+/* Parts of the compositor that scene nodes are accounted to */
+enum scene_owner {
+	OWNER_VIEW = 0,
+	OWNER_SSD_TITLE,
+	OWNER_SSD_BUTTON,
+	OWNER_SSD_SHADOW,
+	OWNER_SSD_FRAME,
+	OWNER_MENU,
+	OWNER_OSD,
+	OWNER_LAYERS,
+	OWNER_OTHER,
+
+	OWNER_COUNT
+};
+
+static const char *const scene_owner_names[] = {
+	[OWNER_VIEW] = "views",
+	[OWNER_SSD_TITLE] = "ssd-titles",
+	[OWNER_SSD_BUTTON] = "ssd-buttons",
+	[OWNER_SSD_SHADOW] = "ssd-shadows",
+	[OWNER_SSD_FRAME] = "ssd-other",
+	[OWNER_MENU] = "menus",
+	[OWNER_OSD] = "osd",
+	[OWNER_LAYERS] = "layers",
+	[OWNER_OTHER] = "other",
+};
+
+static_assert(ARRAY_SIZE(scene_owner_names) == OWNER_COUNT,
+	"scene_owner_names must cover all owners");
+
+struct scene_stats {
+	struct debug_scene_stats owners[OWNER_COUNT];
+	struct int_map seen_buffers;
+};
+
 static const char *
 get_node_type(struct wlr_scene_node *node)
 {
@@ -107,7 +161,7 @@ get_special(struct server *server, struct wlr_scene_node *node)
 	if (node->parent == server->view_tree) {
 		struct workspace *workspace;
 		wl_list_for_each(workspace, &server->workspaces, link) {
-			if (&workspace->tree->node == node) {
+			if (workspace->tree && &workspace->tree->node == node) {
 				return workspace->name;
 			}
 		}
@@ -263,3 +317,441 @@ debug_dump_scene(struct server *server)
 	 */
 	last_view = NULL;
 }
+
+static enum scene_owner
+get_node_owner(struct server *server, struct wlr_scene_node *node,
+		enum scene_owner owner, struct view **view)
+{
+	if (node == &server->menu_tree->node) {
+		return OWNER_MENU;
+	}
+	if (server->osd_state.preview_outline
+			&& node == &server->osd_state.preview_outline->tree->node) {
+		return OWNER_OSD;
+	}
+	if (node->parent == &server->scene->tree) {
+		struct output *output;
+		wl_list_for_each(output, &server->outputs, link) {
+			if (node == &output->osd_tree->node) {
+				return OWNER_OSD;
+			}
+			if (node == &output->layer_popup_tree->node) {
+				return OWNER_LAYERS;
+			}
+			for (size_t i = 0; i < ARRAY_SIZE(output->layer_tree); i++) {
+				if (node == &output->layer_tree[i]->node) {
+					return OWNER_LAYERS;
+				}
+			}
+		}
+	}
+
+	struct node_descriptor *desc = node->data;
+	if (desc && desc->type == LAB_NODE_DESC_VIEW) {
+		*view = desc->data;
+		return OWNER_VIEW;
+	}
+	if (desc && desc->type == LAB_NODE_DESC_XDG_POPUP) {
+		return OWNER_VIEW;
+	}
+	if (!*view || owner > OWNER_SSD_FRAME) {
+		return owner;
+	}
+
+	struct ssd *ssd = (*view)->ssd;
+	if (ssd_debug_is_root_node(ssd, node)) {
+		return OWNER_SSD_FRAME;
+	}
+	if (owner != OWNER_SSD_FRAME) {
+		return owner;
+	}
+	if (ssd_debug_is_shadow_node(ssd, node)) {
+		return OWNER_SSD_SHADOW;
+	}
+	if (desc && desc->type == LAB_NODE_DESC_SSD_BUTTON) {
+		return OWNER_SSD_BUTTON;
+	}
+	if (node->type == WLR_SCENE_NODE_BUFFER
+			&& ssd_get_part_type(ssd, node) == LAB_SSD_PART_TITLE) {
+		return OWNER_SSD_TITLE;
+	}
+	return owner;
+}
+
+static void
+collect_scene_stats(struct server *server, struct scene_stats *stats,
+		struct wlr_scene_node *node, enum scene_owner owner,
+		struct view *view)
+{
+	owner = get_node_owner(server, node, owner, &view);
+	struct debug_scene_stats *owner_stats = &stats->owners[owner];
+
+	switch (node->type) {
+	case WLR_SCENE_NODE_TREE: {
+		owner_stats->trees++;
+		struct wlr_scene_tree *tree = wlr_scene_tree_from_node(node);
+		struct wlr_scene_node *child;
+		wl_list_for_each(child, &tree->children, link) {
+			collect_scene_stats(server, stats, child, owner, view);
+		}
+		break;
+	}
+	case WLR_SCENE_NODE_RECT:
+		owner_stats->rects++;
+		break;
+	case WLR_SCENE_NODE_BUFFER: {
+		if (lab_wlr_surface_from_node(node)) {
+			owner_stats->surfaces++;
+			break;
+		}
+		owner_stats->buffers++;
+		struct wlr_buffer *buffer = wlr_scene_buffer_from_node(node)->buffer;
+		if (buffer && int_map_insert(&stats->seen_buffers,
+				(uintptr_t)buffer, buffer)) {
+			/* Estimated, all our buffers are 32 bits per pixel */
+			owner_stats->buffer_bytes +=
+				(uint64_t)buffer->width * buffer->height * 4;
+		}
+		break;
+	}
+	}
+}
+
+static void
+get_scene_stats(struct server *server, struct scene_stats *stats,
+		struct debug_scene_stats *total)
+{
+	collect_scene_stats(server, stats, &server->scene->tree.node,
+		OWNER_OTHER, NULL);
+	int_map_finish(&stats->seen_buffers);
+
+	*total = (struct debug_scene_stats){0};
+	for (int i = 0; i < OWNER_COUNT; i++) {
+		struct debug_scene_stats *s = &stats->owners[i];
+		total->trees += s->trees;
+		total->rects += s->rects;
+		total->buffers += s->buffers;
+		total->surfaces += s->surfaces;
+		total->buffer_bytes += s->buffer_bytes;
+	}
+}
+
+void
+debug_get_scene_stats(struct server *server, struct debug_scene_stats *total)
+{
+	struct scene_stats stats = {0};
+	get_scene_stats(server, &stats, total);
+}
+
+void
+debug_dump_scene_stats(struct server *server)
+{
+	struct scene_stats stats = {0};
+	struct debug_scene_stats total;
+	get_scene_stats(server, &stats, &total);
+
+	printf(" scene nodes and buffers\n");
+	printf("   %-12s %8s %8s %8s %8s %10s\n", "owner", "trees", "rects",
+		"buffers", "surfaces", "KiB");
+	for (int i = 0; i < OWNER_COUNT; i++) {
+		struct debug_scene_stats *s = &stats.owners[i];
+		printf("   %-12s %8u %8u %8u %8u %10llu\n", scene_owner_names[i],
+			s->trees, s->rects, s->buffers, s->surfaces,
+			(unsigned long long)s->buffer_bytes / 1024);
+	}
+	printf("   %-12s %8u %8u %8u %8u %10llu\n\n", "total",
+		total.trees, total.rects, total.buffers, total.surfaces,
+		(unsigned long long)total.buffer_bytes / 1024);
+}
+
+struct scanout_blockers {
+	struct server *server;
+	struct wlr_box output_box;
+	struct wlr_scene_node *fullscreen_node;
+	bool above_fullscreen_node;
+	struct buf *out;
+};
+
+static const char *
+describe_node(struct server *server, struct wlr_scene_node *node,
+		char *buf, size_t size)
+{
+	struct wlr_scene_node *n = node;
+	for (; n; n = n->parent ? &n->parent->node : NULL) {
+		struct node_descriptor *desc = n->data;
+		if (desc && desc->type == LAB_NODE_DESC_VIEW) {
+			struct view *view = desc->data;
+			const char *app_id = view_get_string_prop(view, "app_id");
+			const char *part = NULL;
+			for (struct wlr_scene_node *p = node; p && !part && p != n;
+					p = p->parent ? &p->parent->node : NULL) {
+				part = ssd_debug_get_node_name(view->ssd, p);
+			}
+			snprintf(buf, size, "view (%s) %s",
+				app_id ? app_id : "?", part ? part : "surface");
+			return buf;
+		}
+		if (desc && desc->type == LAB_NODE_DESC_LAYER_SURFACE) {
+			struct lab_layer_surface *layer = desc->data;
+			snprintf(buf, size, "layer-surface (%s)",
+				layer->scene_layer_surface->layer_surface->namespace);
+			return buf;
+		}
+		if (desc && desc->type == LAB_NODE_DESC_XDG_POPUP) {
+			return "xdg-popup";
+		}
+		if (desc && desc->type == LAB_NODE_DESC_LAYER_POPUP) {
+			return "layer-popup";
+		}
+		if (desc && desc->type == LAB_NODE_DESC_IME_POPUP) {
+			return "ime-popup";
+		}
+		if (desc && desc->type == LAB_NODE_DESC_MENUITEM) {
+			return "menu";
+		}
+		if (n->parent == &server->scene->tree) {
+			return get_special(server, n);
+		}
+	}
+	return get_node_type(node);
+}
+
+static void
+add_blocker(struct scanout_blockers *blockers, struct wlr_scene_node *node)
+{
+	char name[LEFT_COL_SPACE + 32];
+	if (blockers->out->len) {
+		buf_add(blockers->out, ", ");
+	}
+	buf_add(blockers->out,
+		describe_node(blockers->server, node, name, sizeof(name)));
+}
+
+static void
+find_scanout_blockers(struct scanout_blockers *blockers,
+		struct wlr_scene_node *node, int lx, int ly)
+{
+	if (!node->enabled) {
+		return;
+	}
+	if (node == blockers->fullscreen_node) {
+		/* Everything from now on is stacked above the view */
+		blockers->above_fullscreen_node = true;
+		return;
+	}
+
+	if (node->type == WLR_SCENE_NODE_TREE) {
+		struct wlr_scene_tree *tree = wlr_scene_tree_from_node(node);
+		struct wlr_scene_node *child;
+		wl_list_for_each(child, &tree->children, link) {
+			find_scanout_blockers(blockers, child,
+				lx + child->x, ly + child->y);
+		}
+		return;
+	}
+	if (node->type == WLR_SCENE_NODE_RECT
+			&& wlr_scene_rect_from_node(node)->color[3] == 0) {
+		return;
+	}
+	if (node->type == WLR_SCENE_NODE_BUFFER
+			&& !wlr_scene_buffer_from_node(node)->buffer) {
+		return;
+	}
+
+	struct wlr_box box = { .x = lx, .y = ly };
+	lab_wlr_scene_node_get_size(node, &box.width, &box.height);
+
+	struct wlr_box intersection;
+	if (blockers->above_fullscreen_node && wlr_box_intersection(
+			&intersection, &box, &blockers->output_box)) {
+		add_blocker(blockers, node);
+	}
+}
+
+void
+debug_get_scanout_blockers(struct output *output, struct view *view,
+		struct buf *out)
+{
+	struct server *server = output->server;
+	struct scanout_blockers blockers = {
+		.server = server,
+		.fullscreen_node = view->scene_node,
+		.out = out,
+	};
+	wlr_output_layout_get_box(server->output_layout, output->wlr_output,
+		&blockers.output_box);
+	find_scanout_blockers(&blockers, &server->scene->tree.node, 0, 0);
+}
+
+struct damage_highlight {
+	struct wlr_scene_rect *rect;
+	int64_t created_nsec;
+	struct wl_list link; /* output.damage_highlights */
+	struct wl_listener destroy;
+};
+
+static void
+handle_damage_highlight_destroy(struct wl_listener *listener, void *data)
+{
+	struct damage_highlight *highlight =
+		wl_container_of(listener, highlight, destroy);
+	wl_list_remove(&highlight->link);
+	wl_list_remove(&highlight->destroy.link);
+	free(highlight);
+}
+
+static void
+add_damage_highlight(struct output *output, int64_t now,
+		const pixman_box32_t *rect, int ox, int oy)
+{
+	const float color[4] = { DAMAGE_HIGHLIGHT_ALPHA, 0, 0,
+		DAMAGE_HIGHLIGHT_ALPHA };
+	struct damage_highlight *highlight = znew(*highlight);
+	highlight->rect = wlr_scene_rect_create(output->osd_tree,
+		rect->x2 - rect->x1, rect->y2 - rect->y1, color);
+	wlr_scene_node_set_position(&highlight->rect->node,
+		ox + rect->x1, oy + rect->y1);
+	highlight->created_nsec = now;
+	wl_list_insert(&output->damage_highlights, &highlight->link);
+	highlight->destroy.notify = handle_damage_highlight_destroy;
+	wl_signal_add(&highlight->rect->node.events.destroy,
+		&highlight->destroy);
+}
+
+void
+debug_highlight_damage(struct output *output, pixman_region32_t *damage)
+{
+	static int enabled = -1;
+	if (enabled < 0) {
+		const char *env = getenv("LABWC_DEBUG_DAMAGE");
+		enabled = env && !strcmp(env, "highlight");
+	}
+	if (!enabled) {
+		return;
+	}
+
+	struct wlr_box box;
+	wlr_output_layout_get_box(output->server->output_layout,
+		output->wlr_output, &box);
+	int ox = box.x;
+	int oy = box.y;
+
+	/* Fade out existing highlights and ignore the damage they cause */
+	int64_t now = time_now_nsec();
+	struct damage_highlight *highlight, *tmp;
+	wl_list_for_each_safe(highlight, tmp, &output->damage_highlights, link) {
+		struct wlr_scene_node *node = &highlight->rect->node;
+		pixman_region32_subtract_rect(damage, damage, node->x - ox,
+			node->y - oy, highlight->rect->width,
+			highlight->rect->height);
+
+		int64_t age_msec = (now - highlight->created_nsec) / 1000000;
+		if (age_msec >= DAMAGE_HIGHLIGHT_MSEC) {
+			wlr_scene_node_destroy(node);
+			continue;
+		}
+		float alpha = DAMAGE_HIGHLIGHT_ALPHA
+			* (DAMAGE_HIGHLIGHT_MSEC - age_msec) / DAMAGE_HIGHLIGHT_MSEC;
+		const float color[4] = { alpha, 0, 0, alpha };
+		wlr_scene_rect_set_color(highlight->rect, color);
+	}
+
+	int nrects = 0;
+	pixman_box32_t *rects = pixman_region32_rectangles(damage, &nrects);
+	if (nrects > DAMAGE_HIGHLIGHT_MAX_RECTS) {
+		add_damage_highlight(output, now,
+			pixman_region32_extents(damage), ox, oy);
+		return;
+	}
+	for (int i = 0; i < nrects; i++) {
+		add_damage_highlight(output, now, &rects[i], ox, oy);
+	}
+}
+
+void
+debug_dump_histogram_header(const char *unit)
+{
+	printf("   %-12s %10s %8s %8s %8s %8s\n", unit, "samples",
+		"p50", "p99", "max", "avg");
+}
+
+void
+debug_dump_histogram(const char *name, struct histogram *hist)
+{
+	printf("   %-12s %10llu %8u %8u %8u %8u\n", name,
+		(unsigned long long)hist->count,
+		histogram_percentile(hist, 50), histogram_percentile(hist, 99),
+		hist->max, hist->count ? (uint32_t)(hist->sum / hist->count) : 0);
+}
+
+void
+debug_dump_output_stats(struct server *server)
+{
+	printf("\n");
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		struct output_frame_stats *stats = &output->frame_stats;
+		printf(" %s: %llu frames committed, %llu missed vblanks\n",
+			output->wlr_output->name,
+			(unsigned long long)stats->frames_committed,
+			(unsigned long long)stats->missed_vblanks);
+		debug_dump_histogram_header("usec");
+		debug_dump_histogram("build-state", &stats->build_state);
+		debug_dump_histogram("commit", &stats->commit);
+		debug_dump_histogram("frame-done", &stats->frame_done);
+		debug_dump_histogram_header("pixels");
+		debug_dump_histogram("damage", &stats->damage_area);
+		printf("   %llu frames fully damaged\n",
+			(unsigned long long)stats->frames_fully_damaged);
+		printf("   cursor: %s, %llu frames with software cursor\n",
+			output_get_software_cursor(output)
+				? "software" : "hardware plane",
+			(unsigned long long)stats->frames_software_cursor);
+		if (stats->frames_tearing) {
+			printf("   tearing: %llu frames committed, %llu presented torn\n",
+				(unsigned long long)stats->frames_tearing,
+				(unsigned long long)stats->frames_torn);
+		}
+
+		struct view *view = output_get_fullscreen_view(output);
+		if (!view && !stats->frames_scanout
+				&& !stats->frames_composited) {
+			continue;
+		}
+		printf("   fullscreen: %llu frames direct scanout,"
+			" %llu frames composited\n",
+			(unsigned long long)stats->frames_scanout,
+			(unsigned long long)stats->frames_composited);
+		if (view) {
+			struct buf blockers = BUF_INIT;
+			debug_get_scanout_blockers(output, view, &blockers);
+			printf("   nodes above fullscreen view: %s\n",
+				blockers.len ? blockers.data : "none");
+			buf_reset(&blockers);
+		}
+	}
+	printf("\n");
+	latency_dump();
+	configure_stats_dump();
+	client_stats_dump();
+
+	struct scaled_scene_buffer_stats scaled;
+	scaled_scene_buffer_get_stats(&scaled);
+	printf(" scaled buffers: %zu KiB cached, %llu hits, %llu misses,"
+		" %llu evictions\n\n", scaled.bytes / 1024,
+		(unsigned long long)scaled.hits,
+		(unsigned long long)scaled.misses,
+		(unsigned long long)scaled.evictions);
+
+	struct buffer_stats buffers;
+	buffer_get_stats(&buffers);
+	printf(" data buffers: %zu, %zu KiB, at most %zu KiB\n",
+		buffers.count, buffers.bytes / 1024, buffers.peak_bytes / 1024);
+	for (size_t i = 0; i < buffers.nr_sites; i++) {
+		const struct buffer_site_stats *site = &buffers.sites[i];
+		printf("   %-20s %6zu buffers %8zu KiB, at most %8zu KiB\n",
+			site->site, site->count, site->bytes / 1024,
+			site->peak_bytes / 1024);
+	}
+	printf("\n");
+}
@@ -1,14 +1,18 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include "config.h"
 #include <assert.h>
+#include <pixman.h>
+#include <wlr/types/wlr_output_layout.h>
 #include "common/scene-helpers.h"
 #include "common/surface-helpers.h"
-#include "dnd.h"
+#include "common/trace.h"
+#include "edges.h"
 #include "labwc.h"
 #include "layers.h"
 #include "node.h"
 #include "osd.h"
 #include "ssd.h"
+#include "transaction.h"
 #include "view.h"
 #include "window-rules.h"
 #include "workspaces.h"
@@ -18,9 +22,112 @@
 #include <wlr/xwayland.h>
 #endif
 
+/*
+ * Layout areas changed since the last arrange, i.e. the old and new boxes
+ * of changed outputs. Views outside of them are not affected.
+ */
+static struct {
+	bool valid;
+	pixman_region32_t region;
+} changed_area;
+
+static void
+add_changed_box(struct wlr_box *box)
+{
+	if (!changed_area.valid) {
+		pixman_region32_init(&changed_area.region);
+		changed_area.valid = true;
+	}
+	if (!wlr_box_empty(box)) {
+		pixman_region32_union_rect(&changed_area.region,
+			&changed_area.region, box->x, box->y,
+			box->width, box->height);
+	}
+}
+
+static bool
+changed_area_intersects(struct wlr_box *box)
+{
+	if (!changed_area.valid || wlr_box_empty(box)) {
+		return false;
+	}
+	pixman_box32_t rect = {
+		.x1 = box->x,
+		.y1 = box->y,
+		.x2 = box->x + box->width,
+		.y2 = box->y + box->height,
+	};
+	return pixman_region32_contains_rectangle(&changed_area.region, &rect)
+		!= PIXMAN_REGION_OUT;
+}
+
 void
-desktop_arrange_all_views(struct server *server)
+desktop_forget_output(struct output *output)
+{
+	if (output->arranged.usable) {
+		add_changed_box(&output->arranged.layout_box);
+	}
+}
+
+/*
+ * Compare outputs to their state at the last arrange, returns true if
+ * any changed
+ */
+static bool
+update_arranged_outputs(struct server *server)
+{
+	bool any_changed = false;
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		struct output_arranged *arranged = &output->arranged;
+		struct wlr_box layout_box = {0};
+		struct wlr_box usable_area = {0};
+		bool usable = output_is_usable(output);
+		if (usable) {
+			wlr_output_layout_get_box(server->output_layout,
+				output->wlr_output, &layout_box);
+			usable_area = output->usable_area;
+		}
+		arranged->changed = usable != arranged->usable
+			|| !wlr_box_equal(&layout_box, &arranged->layout_box)
+			|| !wlr_box_equal(&usable_area, &arranged->usable_area);
+		if (arranged->changed) {
+			add_changed_box(&arranged->layout_box);
+			add_changed_box(&layout_box);
+			any_changed = true;
+		}
+		arranged->usable = usable;
+		arranged->layout_box = layout_box;
+		arranged->usable_area = usable_area;
+	}
+	return any_changed;
+}
+
+static bool
+view_needs_arrange(struct view *view)
+{
+	if (!output_is_usable(view->output) || view->output->arranged.changed) {
+		return true;
+	}
+	/* The view or its last-layout geometry may cover a changed output */
+	return changed_area_intersects(&view->pending)
+		|| changed_area_intersects(&view->last_layout_geometry);
+}
+
+static void
+arrange_views(struct server *server, bool all)
 {
+	bool changed = update_arranged_outputs(server);
+	if (changed_area.valid
+			&& pixman_region32_not_empty(&changed_area.region)) {
+		/* Includes outputs destroyed since the last arrange */
+		changed = true;
+	}
+	if (!all && !changed) {
+		/* e.g. a panel was remapped with the same exclusive zone */
+		return;
+	}
+
 	/*
 	 * Adjust window positions/sizes. Skip views with no size since
 	 * we can't do anything useful with them; they will presumably
@@ -31,12 +138,31 @@ desktop_arrange_all_views(struct server *server)
 	 * still unmapped. We do want to adjust the geometry of those
 	 * views.
 	 */
+	transaction_begin(server);
 	struct view *view;
 	wl_list_for_each(view, &server->views, link) {
-		if (!wlr_box_empty(&view->pending)) {
+		if (!wlr_box_empty(&view->pending)
+				&& (all || view_needs_arrange(view))) {
 			view_adjust_for_layout_change(view);
 		}
 	}
+	transaction_end(server);
+
+	if (changed_area.valid) {
+		pixman_region32_clear(&changed_area.region);
+	}
+}
+
+void
+desktop_arrange_all_views(struct server *server)
+{
+	arrange_views(server, /* all */ true);
+}
+
+void
+desktop_arrange_changed_views(struct server *server)
+{
+	arrange_views(server, /* all */ false);
 }
 
 void
@@ -118,6 +244,18 @@ desktop_cycle_view(struct server *server, struct view *start_view,
 	/* Make sure to have all nodes in their actual ordering */
 	osd_preview_restore(server);
 
+	if (rc.window_switcher.order == LAB_WINDOW_SWITCHER_ORDER_FOCUS) {
+		/* The most recent view is usually focused, so skip it */
+		bool forwards = dir == LAB_CYCLE_DIR_FORWARD;
+		enum lab_view_criteria criteria = rc.window_switcher.criteria;
+		if (!start_view && forwards) {
+			start_view = view_cycle_focus_history(server, NULL,
+				criteria, forwards);
+		}
+		return view_cycle_focus_history(server, start_view, criteria,
+			forwards);
+	}
+
 	struct view *(*iter)(struct wl_list *head, struct view *view,
 		enum lab_view_criteria criteria);
 	bool forwards = dir == LAB_CYCLE_DIR_FORWARD;
@@ -146,16 +284,10 @@ struct view *
 desktop_topmost_focusable_view(struct server *server)
 {
 	struct view *view;
-	struct wl_list *node_list;
-	struct wlr_scene_node *node;
-	node_list = &server->workspace_current->tree->children;
-	wl_list_for_each_reverse(node, node_list, link) {
-		if (!node->data) {
-			/* We found some non-view, most likely the region overlay */
-			continue;
-		}
-		view = node_view_from_node(node);
-		if (view->mapped && view_is_focusable(view)) {
+	struct workspace *workspace = server->workspace_current;
+	/* Usually the first view, as only mapped ones are listed */
+	wl_list_for_each(view, &workspace->mapped_views, mapped_link) {
+		if (view_is_focusable(view)) {
 			return view;
 		}
 	}
@@ -186,9 +318,10 @@ desktop_focus_output(struct output *output)
 	}
 	struct view *view;
 	struct wlr_scene_node *node;
-	struct wlr_output_layout *layout = output->server->output_layout;
+	struct server *server = output->server;
+	struct wlr_output_layout *layout = server->output_layout;
 	struct wl_list *list_head =
-		&output->server->workspace_current->tree->children;
+		&workspaces_get_tree(server->workspace_current)->children;
 	wl_list_for_each_reverse(node, list_head, link) {
 		if (!node->data) {
 			continue;
@@ -200,10 +333,10 @@ desktop_focus_output(struct output *output)
 		if (wlr_output_layout_intersects(layout,
 				output->wlr_output, &view->current)) {
 			desktop_focus_view(view, /*raise*/ false);
-			wlr_cursor_warp(output->server->seat.cursor, NULL,
+			wlr_cursor_warp(server->seat.cursor, NULL,
 				view->current.x + view->current.width / 2,
 				view->current.y + view->current.height / 2);
-			cursor_update_focus(output->server);
+			cursor_update_focus(server);
 			return;
 		}
 	}
@@ -217,22 +350,17 @@ desktop_focus_output(struct output *output)
 	cursor_update_focus(output->server);
 }
 
-void
-desktop_update_top_layer_visiblity(struct server *server)
+static void
+update_top_layer_visibility(void *data)
 {
+	struct server *server = data;
 	struct view *view;
 	struct output *output;
 	uint32_t top = ZWLR_LAYER_SHELL_V1_LAYER_TOP;
 
-	/* Enable all top layers */
 	wl_list_for_each(output, &server->outputs, link) {
-		if (!output_is_usable(output)) {
-			continue;
-		}
-		wlr_scene_node_set_enabled(&output->layer_tree[top]->node, true);
+		output->nr_fullscreen_views = 0;
 	}
-
-	/* And disable them again when there is a view in fullscreen */
 	enum lab_view_criteria criteria =
 		LAB_VIEW_CRITERIA_CURRENT_WORKSPACE | LAB_VIEW_CRITERIA_FULLSCREEN;
 	for_each_view(view, &server->views, criteria) {
@@ -242,10 +370,59 @@ desktop_update_top_layer_visiblity(struct server *server)
 		if (!output_is_usable(view->output)) {
 			continue;
 		}
-		wlr_scene_node_set_enabled(&view->output->layer_tree[top]->node, false);
+		view->output->nr_fullscreen_views++;
+	}
+
+	/*
+	 * Only touch the top layers whose state changes, enabling all of
+	 * them first would damage every output on each update
+	 */
+	wl_list_for_each(output, &server->outputs, link) {
+		if (!output_is_usable(output)) {
+			continue;
+		}
+		wlr_scene_node_set_enabled(&output->layer_tree[top]->node,
+			!output->nr_fullscreen_views);
 	}
 }
 
+void
+desktop_update_top_layer_visiblity(struct server *server)
+{
+	defer_schedule(&server->top_layer_update, server->wl_event_loop,
+		update_top_layer_visibility, server);
+}
+
+static void
+update_occlusion(void *data)
+{
+	struct server *server = data;
+	edges_calculate_occlusion(server);
+
+	struct view *view;
+	wl_list_for_each(view, &server->views, link) {
+		if (!view->mapped && !view->minimized) {
+			continue;
+		}
+		/* The content of shaded views is hidden as well */
+		int lx, ly;
+		bool rendered = !view->minimized && !view->shaded
+			&& wlr_scene_node_coords(&view->scene_tree->node,
+				&lx, &ly);
+		view_set_suspended(view, !rendered || view->occluded);
+		view_set_hidden(view, view->minimized
+			|| !wlr_scene_node_coords(&view->scene_tree->node,
+				&lx, &ly));
+	}
+}
+
+void
+desktop_update_occlusion(struct server *server)
+{
+	defer_schedule(&server->occlusion_update, server->wl_event_loop,
+		update_occlusion, server);
+}
+
 static struct wlr_surface *
 get_surface_from_layer_node(struct wlr_scene_node *node)
 {
@@ -263,26 +440,224 @@ get_surface_from_layer_node(struct wlr_scene_node *node)
 	return NULL;
 }
 
+/*
+ * wlroots does not notify about scene changes, but most changes that
+ * can alter the result of hit-testing at the cursor position damage the
+ * output the cursor is on. So the scene is unchanged as long as no output
+ * has pending damage and no output has committed a new frame. Surface
+ * commits which only change the input region cause no damage, those of
+ * the cached surface are watched by cursor_context_cache_update().
+ *
+ * Returns false if there is pending damage, i.e. the scene has changed
+ * since the last frame.
+ */
+static bool
+get_scene_generation(struct server *server, uint64_t *generation)
+{
+	uint64_t gen = 0;
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (!output->scene_output) {
+			continue;
+		}
+		if (pixman_region32_not_empty(
+				&output->scene_output->damage_ring.current)) {
+			return false;
+		}
+		gen = gen * 31 + output->frame_stats.frames_committed + 1;
+	}
+	*generation = gen;
+	return true;
+}
+
+static void
+cursor_context_cache_reset(struct cursor_context_cache *cache)
+{
+	if (cache->leaf) {
+		wl_list_remove(&cache->leaf_destroy.link);
+		cache->leaf = NULL;
+	}
+	if (cache->surface) {
+		wl_list_remove(&cache->surface_commit.link);
+		cache->surface = NULL;
+	}
+}
+
+static void
+handle_cursor_context_leaf_destroy(struct wl_listener *listener, void *data)
+{
+	struct cursor_context_cache *cache =
+		wl_container_of(listener, cache, leaf_destroy);
+	cursor_context_cache_reset(cache);
+}
+
+static void
+handle_cursor_context_surface_commit(struct wl_listener *listener, void *data)
+{
+	struct cursor_context_cache *cache =
+		wl_container_of(listener, cache, surface_commit);
+	cursor_context_cache_reset(cache);
+}
+
+/*
+ * Shrink @box so that it does not intersect with any node stacked above
+ * @leaf while still containing the point (@x, @y). @above is set once
+ * @leaf has been passed in rendering order.
+ */
+static void
+exclude_nodes_above(struct wlr_scene_node *node, int lx, int ly,
+		struct wlr_scene_node *leaf, bool *above, struct wlr_box *box,
+		double x, double y)
+{
+	if (!node->enabled || wlr_box_empty(box)) {
+		return;
+	}
+	if (node == leaf) {
+		*above = true;
+		return;
+	}
+	if (node->type == WLR_SCENE_NODE_TREE) {
+		struct wlr_scene_tree *tree = wlr_scene_tree_from_node(node);
+		struct wlr_scene_node *child;
+		wl_list_for_each(child, &tree->children, link) {
+			exclude_nodes_above(child, lx + child->x, ly + child->y,
+				leaf, above, box, x, y);
+		}
+		return;
+	}
+	if (!*above) {
+		return;
+	}
+
+	struct wlr_box other = { .x = lx, .y = ly };
+	lab_wlr_scene_node_get_size(node, &other.width, &other.height);
+	struct wlr_box intersection;
+	if (!wlr_box_intersection(&intersection, box, &other)) {
+		return;
+	}
+	/* Keep the part of the box on the cursor's side of the node */
+	if (other.x + other.width <= x) {
+		box->width -= other.x + other.width - box->x;
+		box->x = other.x + other.width;
+	} else if (other.x > x) {
+		box->width = other.x - box->x;
+	} else if (other.y + other.height <= y) {
+		box->height -= other.y + other.height - box->y;
+		box->y = other.y + other.height;
+	} else if (other.y > y) {
+		box->height = other.y - box->y;
+	} else {
+		/* The node covers the cursor but does not accept input */
+		*box = (struct wlr_box){0};
+	}
+}
+
+static void
+cursor_context_cache_update(struct server *server,
+		struct cursor_context *ctx, struct wlr_scene_node *leaf,
+		uint64_t generation)
+{
+	struct cursor_context_cache *cache = &server->cursor_context_cache;
+	cursor_context_cache_reset(cache);
+
+	int lx, ly;
+	if (!leaf || !wlr_scene_node_coords(leaf, &lx, &ly)) {
+		return;
+	}
+	struct wlr_box box = { .x = lx, .y = ly };
+	lab_wlr_scene_node_get_size(leaf, &box.width, &box.height);
+
+	struct wlr_surface *surface = NULL;
+	if (leaf->type == WLR_SCENE_NODE_BUFFER) {
+		struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(leaf);
+		surface = lab_wlr_surface_from_node(leaf);
+		if (surface) {
+			/* Limit to the input region rectangle under the cursor */
+			pixman_box32_t rect;
+			if (!pixman_region32_contains_point(&surface->input_region,
+					ctx->sx, ctx->sy, &rect)) {
+				return;
+			}
+			struct wlr_box input = {
+				.x = lx + rect.x1,
+				.y = ly + rect.y1,
+				.width = rect.x2 - rect.x1,
+				.height = rect.y2 - rect.y1,
+			};
+			wlr_box_intersection(&box, &box, &input);
+		} else if (buffer->point_accepts_input) {
+			return;
+		}
+	}
+
+	double x = server->seat.cursor->x;
+	double y = server->seat.cursor->y;
+	bool above = false;
+	exclude_nodes_above(&server->scene->tree.node, 0, 0, leaf, &above,
+		&box, x, y);
+	if (!wlr_box_contains_point(&box, x, y)) {
+		return;
+	}
+
+	cache->ctx = *ctx;
+	cache->leaf = leaf;
+	cache->leaf_lx = lx;
+	cache->leaf_ly = ly;
+	cache->box = box;
+	cache->generation = generation;
+	cache->leaf_destroy.notify = handle_cursor_context_leaf_destroy;
+	wl_signal_add(&leaf->events.destroy, &cache->leaf_destroy);
+	if (surface) {
+		/* May change the input region without any damage */
+		cache->surface = surface;
+		cache->surface_commit.notify =
+			handle_cursor_context_surface_commit;
+		wl_signal_add(&surface->events.commit, &cache->surface_commit);
+	}
+}
+
+/*
+ * Like wlr_scene_node_at() on the whole scene, but skips the drag icons
+ * which would otherwise always be found under the cursor. Hit-testing the
+ * top level trees one by one leaves the scene untouched, whereas hiding
+ * the icons would damage them on every motion event of a drag.
+ */
+static struct wlr_scene_node *
+scene_node_at_below_drag_icons(struct server *server, double lx, double ly,
+		double *sx, double *sy)
+{
+	struct wlr_scene_node *icons = &server->seat.drag.icons->node;
+	struct wlr_scene_node *child;
+	wl_list_for_each_reverse(child, &server->scene->tree.children, link) {
+		if (child == icons) {
+			continue;
+		}
+		struct wlr_scene_node *node =
+			wlr_scene_node_at(child, lx, ly, sx, sy);
+		if (node) {
+			return node;
+		}
+	}
+	return NULL;
+}
+
 /* TODO: make this less big and scary */
-struct cursor_context
-get_cursor_context(struct server *server)
+static struct cursor_context
+find_cursor_context(struct server *server, struct wlr_scene_node **leaf)
 {
 	struct cursor_context ret = {.type = LAB_SSD_NONE};
 	struct wlr_cursor *cursor = server->seat.cursor;
 
-	/* Prevent drag icons to be on top of the hitbox detection */
+	struct wlr_scene_node *node;
 	if (server->seat.drag.active) {
-		dnd_icons_show(&server->seat, false);
-	}
-
-	struct wlr_scene_node *node =
-		wlr_scene_node_at(&server->scene->tree.node,
+		node = scene_node_at_below_drag_icons(server,
+			cursor->x, cursor->y, &ret.sx, &ret.sy);
+	} else {
+		node = wlr_scene_node_at(&server->scene->tree.node,
 			cursor->x, cursor->y, &ret.sx, &ret.sy);
-
-	if (server->seat.drag.active) {
-		dnd_icons_show(&server->seat, true);
 	}
 
+	*leaf = node;
 	ret.node = node;
 	if (!node) {
 		ret.type = LAB_SSD_ROOT;
@@ -382,3 +757,37 @@ get_cursor_context(struct server *server)
 	return ret;
 }
 
+struct cursor_context
+get_cursor_context(struct server *server)
+{
+	TRACE_FUNC();
+	struct cursor_context_cache *cache = &server->cursor_context_cache;
+	struct wlr_cursor *cursor = server->seat.cursor;
+
+	/*
+	 * Pointer motion is far more frequent than scene changes, so
+	 * return the previous result while the cursor stays within the
+	 * area where it is known to be valid.
+	 */
+	uint64_t generation = 0;
+	bool cacheable = !server->seat.drag.active
+		&& get_scene_generation(server, &generation);
+	if (cacheable && cache->leaf && cache->generation == generation
+			&& wlr_box_contains_point(&cache->box, cursor->x, cursor->y)) {
+		struct cursor_context ret = cache->ctx;
+		ret.sx = cursor->x - cache->leaf_lx;
+		ret.sy = cursor->y - cache->leaf_ly;
+		return ret;
+	}
+
+	struct wlr_scene_node *leaf = NULL;
+	struct cursor_context ret = find_cursor_context(server, &leaf);
+	cache->lookup_serial++;
+	if (cacheable) {
+		cursor_context_cache_update(server, &ret, leaf, generation);
+	} else {
+		cursor_context_cache_reset(cache);
+	}
+	return ret;
+}
+
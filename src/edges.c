@@ -2,10 +2,12 @@
 #include <assert.h>
 #include <limits.h>
 #include <pixman.h>
+#include <stdlib.h>
 #include <wlr/util/edges.h>
 #include <wlr/util/box.h>
 #include "common/border.h"
 #include "common/macros.h"
+#include "common/mem.h"
 #include "config/rcxml.h"
 #include "edges.h"
 #include "labwc.h"
@@ -16,7 +18,7 @@ static void
 edges_for_target_geometry(struct border *edges, struct view *view,
 		struct wlr_box target)
 {
-	struct border border = ssd_get_margin(view->ssd);
+	struct border border = ssd_get_margin(view);
 
 	/* Use the effective height to properly handle shaded views */
 	int eff_height = view->shaded ? 0 : target.height;
@@ -243,8 +245,9 @@ validate_output_edges(struct border *valid_edges,
 
 /* Test if parts of the current view is covered by the remaining space in the region */
 static void
-subtract_view_from_space(struct view *view, pixman_region32_t *available)
+subtract_view_from_space(struct view *view, void *data)
 {
+	pixman_region32_t *available = data;
 	struct wlr_box view_size = ssd_max_extents(view);
 	pixman_box32_t view_rect = {
 		.x1 = view_size.x,
@@ -302,9 +305,56 @@ subtract_view_from_space(struct view *view, pixman_region32_t *available)
 	pixman_region32_fini(&view_region);
 }
 
+/*
+ * Test if the current view is completely covered by the views above it
+ * and subtract its opaque parts from the remaining space afterwards.
+ *
+ * Unlike for snapping, translucent views must not be treated as
+ * covering the views below them, so only the opaque region of the
+ * main surface and the server-side decorations are subtracted.
+ */
 static void
-subtract_node_tree(struct wlr_scene_tree *tree, pixman_region32_t *available,
-		struct view *ignored_view)
+subtract_opaque_view_from_space(struct view *view, void *data)
+{
+	pixman_region32_t *available = data;
+	struct wlr_box extents = ssd_max_extents(view);
+	pixman_box32_t view_rect = {
+		.x1 = extents.x,
+		.x2 = extents.x + extents.width,
+		.y1 = extents.y,
+		.y2 = extents.y + extents.height
+	};
+	view->occluded = pixman_region32_contains_rectangle(available,
+		&view_rect) == PIXMAN_REGION_OUT;
+
+	pixman_region32_t opaque;
+	pixman_region32_init_rect(&opaque, extents.x, extents.y,
+		extents.width, extents.height);
+	/* Everything but the decorations */
+	pixman_region32_subtract_rect(&opaque, &opaque, view->current.x,
+		view->current.y, view->current.width,
+		view_effective_height(view, /* use_pending */ false));
+
+	int lx, ly;
+	if (view->surface && !view->shaded
+			&& wlr_scene_node_coords(view->scene_node, &lx, &ly)) {
+		pixman_region32_t surface_opaque;
+		pixman_region32_init(&surface_opaque);
+		pixman_region32_copy(&surface_opaque,
+			&view->surface->opaque_region);
+		pixman_region32_translate(&surface_opaque, lx, ly);
+		pixman_region32_union(&opaque, &opaque, &surface_opaque);
+		pixman_region32_fini(&surface_opaque);
+	}
+
+	pixman_region32_subtract(available, available, &opaque);
+	pixman_region32_fini(&opaque);
+}
+
+/* Calls fn() for each rendered view from top to bottom */
+static void
+for_each_rendered_view(struct wlr_scene_tree *tree, struct view *ignored_view,
+		void (*fn)(struct view *, void *), void *data)
 {
 	struct view *view;
 	struct wlr_scene_node *node;
@@ -324,30 +374,19 @@ subtract_node_tree(struct wlr_scene_tree *tree, pixman_region32_t *available,
 		if (node_desc && node_desc->type == LAB_NODE_DESC_VIEW) {
 			view = node_view_from_node(node);
 			if (view != ignored_view) {
-				subtract_view_from_space(view, available);
+				fn(view, data);
 			}
 		} else if (node->type == WLR_SCENE_NODE_TREE) {
-			subtract_node_tree(wlr_scene_tree_from_node(node),
-				available, ignored_view);
+			for_each_rendered_view(wlr_scene_tree_from_node(node),
+				ignored_view, fn, data);
 		}
 	}
 }
 
-void
-edges_calculate_visibility(struct server *server, struct view *ignored_view)
+static void
+init_layout_region(struct server *server, pixman_region32_t *region)
 {
-	/*
-	 * The region stores the available output layout space
-	 * and subtracts the window geometries in reverse rendering
-	 * order, e.g. a window rendered on top is subtracted first.
-	 *
-	 * This allows to detect if a window is actually visible.
-	 * If there is no overlap of its geometry and the remaining
-	 * region it must be completely covered by other windows.
-	 *
-	 */
-	pixman_region32_t region;
-	pixman_region32_init(&region);
+	pixman_region32_init(region);
 
 	/*
 	 * Initialize the region with each individual output.
@@ -365,15 +404,549 @@ edges_calculate_visibility(struct server *server, struct view *ignored_view)
 		}
 		wlr_output_layout_get_box(server->output_layout,
 			output->wlr_output, &layout_box);
-		pixman_region32_union_rect(&region, &region,
+		pixman_region32_union_rect(region, region,
 			layout_box.x, layout_box.y, layout_box.width, layout_box.height);
 	}
+}
+
+/*
+ * State for incremental updates of view->edges_visible. As the visibility
+ * of a view only depends on the views above it, a change confined to an
+ * area (a view moved, raised, mapped or unmapped) can only affect views
+ * intersecting that area. Such areas are collected in 'damage' and only
+ * the views touching it are recomputed.
+ */
+struct edge_visibility {
+	bool valid;
+	/* Only used for comparison, never dereferenced */
+	struct view *ignored_view;
+	pixman_region32_t layout;
+	pixman_region32_t damage;
+};
+
+static struct edge_visibility *
+get_visibility(struct server *server)
+{
+	if (!server->edge_visibility) {
+		server->edge_visibility = znew(*server->edge_visibility);
+		pixman_region32_init(&server->edge_visibility->layout);
+		pixman_region32_init(&server->edge_visibility->damage);
+	}
+	return server->edge_visibility;
+}
 
-	subtract_node_tree(&server->scene->tree, &region, ignored_view);
+static void
+damage_box(pixman_region32_t *damage, struct wlr_box *box)
+{
+	if (!wlr_box_empty(box)) {
+		pixman_region32_union_rect(damage, damage,
+			box->x, box->y, box->width, box->height);
+	}
+}
 
+static void
+visibility_damage_view(struct view *view)
+{
+	struct edge_visibility *vis = view->server->edge_visibility;
+	if (!vis || !vis->valid) {
+		return;
+	}
+	/* Both the area the view left and the one it covers now */
+	damage_box(&vis->damage, &view->visibility_box);
+	view->visibility_box = ssd_max_extents(view);
+	damage_box(&vis->damage, &view->visibility_box);
+}
+
+static void
+subtract_recorded_view_from_space(struct view *view, void *data)
+{
+	view->visibility_box = ssd_max_extents(view);
+	subtract_view_from_space(view, data);
+}
+
+static void
+collect_view(struct view *view, void *data)
+{
+	struct view **entry = wl_array_add(data, sizeof(*entry));
+	*entry = view;
+}
+
+static void
+update_visibility(struct server *server, struct edge_visibility *vis)
+{
+	struct wl_array views;
+	wl_array_init(&views);
+	for_each_rendered_view(&server->scene->tree, vis->ignored_view,
+		collect_view, &views);
+
+	struct view **views_data = views.data;
+	size_t nr_views = views.size / sizeof(struct view *);
+	pixman_region32_t available;
+	pixman_region32_init(&available);
+	for (size_t i = 0; i < nr_views; i++) {
+		struct view *view = views_data[i];
+		struct wlr_box *box = &view->visibility_box;
+		*box = ssd_max_extents(view);
+		pixman_box32_t rect = {
+			.x1 = box->x,
+			.y1 = box->y,
+			.x2 = box->x + box->width,
+			.y2 = box->y + box->height,
+		};
+		if (pixman_region32_contains_rectangle(&vis->damage, &rect)
+				== PIXMAN_REGION_OUT) {
+			continue;
+		}
+
+		/* Only views above which overlap this one matter */
+		pixman_region32_intersect_rect(&available, &vis->layout,
+			box->x, box->y, box->width, box->height);
+		for (size_t j = 0; j < i; j++) {
+			struct wlr_box *above = &views_data[j]->visibility_box;
+			struct wlr_box overlap;
+			if (wlr_box_intersection(&overlap, box, above)) {
+				pixman_region32_subtract_rect(&available,
+					&available, overlap.x, overlap.y,
+					overlap.width, overlap.height);
+			}
+		}
+		subtract_view_from_space(view, &available);
+	}
+	pixman_region32_fini(&available);
+	wl_array_release(&views);
+}
+
+void
+edges_calculate_visibility(struct server *server, struct view *ignored_view)
+{
+	struct edge_visibility *vis = get_visibility(server);
+
+	if (vis->valid && vis->ignored_view != ignored_view) {
+		/* A different view is now treated as transparent */
+		struct view *view;
+		wl_list_for_each(view, &server->views, link) {
+			if (view == vis->ignored_view || view == ignored_view) {
+				damage_box(&vis->damage, &view->visibility_box);
+			}
+		}
+		vis->ignored_view = ignored_view;
+	}
+
+	if (vis->valid) {
+		if (pixman_region32_not_empty(&vis->damage)) {
+			update_visibility(server, vis);
+			pixman_region32_clear(&vis->damage);
+		}
+		return;
+	}
+
+	/*
+	 * The region stores the available output layout space
+	 * and subtracts the window geometries in reverse rendering
+	 * order, e.g. a window rendered on top is subtracted first.
+	 *
+	 * This allows to detect if a window is actually visible.
+	 * If there is no overlap of its geometry and the remaining
+	 * region it must be completely covered by other windows.
+	 *
+	 */
+	pixman_region32_fini(&vis->layout);
+	init_layout_region(server, &vis->layout);
+	pixman_region32_t region;
+	pixman_region32_init(&region);
+	pixman_region32_copy(&region, &vis->layout);
+	for_each_rendered_view(&server->scene->tree, ignored_view,
+		subtract_recorded_view_from_space, &region);
+	pixman_region32_fini(&region);
+
+	vis->ignored_view = ignored_view;
+	pixman_region32_clear(&vis->damage);
+	vis->valid = true;
+}
+
+void
+edges_calculate_occlusion(struct server *server)
+{
+	pixman_region32_t region;
+	init_layout_region(server, &region);
+	for_each_rendered_view(&server->scene->tree, NULL,
+		subtract_opaque_view_from_space, &region);
 	pixman_region32_fini(&region);
 }
 
+/*
+ * Index of the window edges of all views on the current workspace, kept
+ * as one array per edge (left, right, top, bottom) sorted by position.
+ * This allows edges_find_neighbors() to only look at views which have an
+ * edge near the path of a moving edge rather than at every view.
+ *
+ * The index is rebuilt lazily after edges_invalidate_view() or
+ * edges_invalidate_all() and updated in place when a single view moves,
+ * which keeps interactive moves cheap.
+ *
+ * During an interactive move/resize the grabbed view is left out of the
+ * index, so its own motion never touches it, and the usable areas of all
+ * outputs are snapshotted for edges_find_outputs(). See
+ * edges_begin_session().
+ */
+enum {
+	INDEX_LEFT = 0,
+	INDEX_RIGHT,
+	INDEX_TOP,
+	INDEX_BOTTOM,
+	INDEX_COUNT
+};
+
+struct edge_key {
+	int offset;
+	struct view *view;
+};
+
+struct session_output {
+	struct output *output;
+	struct wlr_box usable;
+};
+
+struct edge_index {
+	struct edge_key *keys[INDEX_COUNT];
+	size_t len;
+	size_t capacity;
+	bool valid;
+
+	/* View being moved or resized interactively, if any */
+	struct view *grabbed;
+	struct wl_array outputs; /* struct session_output */
+	bool outputs_valid;
+};
+
+static struct border
+view_window_edges(struct view *v)
+{
+	struct border border = ssd_get_margin(v);
+	return (struct border){
+		.top = v->current.y - border.top,
+		.left = v->current.x - border.left,
+		.bottom = v->current.y + border.bottom
+			+ view_effective_height(v, /* use_pending */ false),
+		.right = v->current.x + v->current.width + border.right,
+	};
+}
+
+static int
+index_offset(struct border edges, int i)
+{
+	switch (i) {
+	case INDEX_LEFT:
+		return edges.left;
+	case INDEX_RIGHT:
+		return edges.right;
+	case INDEX_TOP:
+		return edges.top;
+	default:
+		return edges.bottom;
+	}
+}
+
+static bool
+view_is_indexed(struct view *v)
+{
+	return !v->minimized && output_is_usable(v->output);
+}
+
+static int
+compare_keys(const void *a, const void *b)
+{
+	const struct edge_key *ka = a;
+	const struct edge_key *kb = b;
+	return (ka->offset > kb->offset) - (ka->offset < kb->offset);
+}
+
+static struct edge_index *
+get_index(struct server *server)
+{
+	if (!server->edge_index) {
+		server->edge_index = znew(*server->edge_index);
+		wl_array_init(&server->edge_index->outputs);
+	}
+	return server->edge_index;
+}
+
+static void
+index_rebuild(struct server *server)
+{
+	struct edge_index *index = get_index(server);
+
+	size_t count = 0;
+	struct view *v;
+	for_each_view(v, &server->views, LAB_VIEW_CRITERIA_CURRENT_WORKSPACE) {
+		count++;
+	}
+	if (count > index->capacity) {
+		for (int i = 0; i < INDEX_COUNT; i++) {
+			zfree(index->keys[i]);
+			index->keys[i] = znew_n(struct edge_key, count);
+		}
+		index->capacity = count;
+	}
+
+	index->len = 0;
+	for_each_view(v, &server->views, LAB_VIEW_CRITERIA_CURRENT_WORKSPACE) {
+		if (!view_is_indexed(v) || v == index->grabbed) {
+			continue;
+		}
+		struct border edges = view_window_edges(v);
+		for (int i = 0; i < INDEX_COUNT; i++) {
+			index->keys[i][index->len] = (struct edge_key){
+				.offset = index_offset(edges, i),
+				.view = v,
+			};
+		}
+		index->len++;
+	}
+	for (int i = 0; i < INDEX_COUNT; i++) {
+		qsort(index->keys[i], index->len, sizeof(struct edge_key),
+			compare_keys);
+	}
+	index->valid = true;
+}
+
+static void
+index_invalidate(struct server *server)
+{
+	if (server->edge_index) {
+		server->edge_index->valid = false;
+	}
+}
+
+void
+edges_invalidate_view(struct view *view)
+{
+	index_invalidate(view->server);
+	visibility_damage_view(view);
+}
+
+static void
+outputs_rebuild(struct edge_index *index, struct server *server)
+{
+	index->outputs.size = 0;
+	struct output *o;
+	wl_list_for_each(o, &server->outputs, link) {
+		if (!output_is_usable(o)) {
+			continue;
+		}
+		struct session_output *entry =
+			wl_array_add(&index->outputs, sizeof(*entry));
+		if (!entry) {
+			index->outputs_valid = false;
+			return;
+		}
+		entry->output = o;
+		entry->usable = output_usable_area_in_layout_coords(o);
+	}
+	index->outputs_valid = true;
+}
+
+void
+edges_begin_session(struct view *view)
+{
+	struct server *server = view->server;
+	struct edge_index *index = get_index(server);
+	index->grabbed = view;
+	index_rebuild(server);
+	outputs_rebuild(index, server);
+}
+
+void
+edges_end_session(struct server *server)
+{
+	struct edge_index *index = server->edge_index;
+	if (!index || !index->grabbed) {
+		return;
+	}
+	/* The grabbed view has to be indexed again */
+	index->grabbed = NULL;
+	index->valid = false;
+	index->outputs_valid = false;
+}
+
+void
+edges_invalidate_outputs(struct server *server)
+{
+	if (server->edge_index) {
+		server->edge_index->outputs_valid = false;
+	}
+}
+
+void
+edges_invalidate_all(struct server *server)
+{
+	index_invalidate(server);
+	edges_invalidate_outputs(server);
+	if (server->edge_visibility) {
+		server->edge_visibility->valid = false;
+	}
+}
+
+/* Move a single key to its sorted position after its offset changed */
+static bool
+index_update_key(struct edge_key *keys, size_t len, struct view *view,
+		int offset)
+{
+	size_t pos = 0;
+	while (pos < len && keys[pos].view != view) {
+		pos++;
+	}
+	if (pos == len) {
+		return false;
+	}
+	keys[pos].offset = offset;
+	while (pos > 0 && keys[pos - 1].offset > offset) {
+		struct edge_key tmp = keys[pos - 1];
+		keys[pos - 1] = keys[pos];
+		keys[pos--] = tmp;
+	}
+	while (pos + 1 < len && keys[pos + 1].offset < offset) {
+		struct edge_key tmp = keys[pos + 1];
+		keys[pos + 1] = keys[pos];
+		keys[pos++] = tmp;
+	}
+	return true;
+}
+
+void
+edges_update_view(struct view *view)
+{
+	visibility_damage_view(view);
+
+	struct edge_index *index = view->server->edge_index;
+	if (!index || !index->valid || view == index->grabbed) {
+		return;
+	}
+	struct border edges = view_window_edges(view);
+	for (int i = 0; i < INDEX_COUNT; i++) {
+		if (!index_update_key(index->keys[i], index->len, view,
+				index_offset(edges, i))) {
+			/* Not indexed yet (e.g. moved to a usable output) */
+			index->valid = false;
+			return;
+		}
+	}
+}
+
+void
+edges_finish(struct server *server)
+{
+	struct edge_visibility *vis = server->edge_visibility;
+	if (vis) {
+		pixman_region32_fini(&vis->layout);
+		pixman_region32_fini(&vis->damage);
+		zfree(server->edge_visibility);
+	}
+
+	struct edge_index *index = server->edge_index;
+	if (!index) {
+		return;
+	}
+	for (int i = 0; i < INDEX_COUNT; i++) {
+		zfree(index->keys[i]);
+	}
+	wl_array_release(&index->outputs);
+	zfree(server->edge_index);
+}
+
+/* Returns the first key with an offset of at least @offset */
+static size_t
+index_lower_bound(struct edge_key *keys, size_t len, int offset)
+{
+	size_t lo = 0;
+	size_t hi = len;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (keys[mid].offset < offset) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+struct neighbor_search {
+	struct border *nearest_edges;
+	struct view *view;
+	struct border view_edges;
+	struct border target_edges;
+	struct output *output;
+	edge_validator_t validator;
+	bool ignore_hidden;
+};
+
+static void
+check_neighbor(struct neighbor_search *search, struct view *v)
+{
+	struct view *view = search->view;
+	if (v == view) {
+		return;
+	}
+
+	uint32_t edges_visible = search->ignore_hidden ? v->edges_visible :
+		WLR_EDGE_TOP | WLR_EDGE_LEFT
+			| WLR_EDGE_BOTTOM | WLR_EDGE_RIGHT;
+
+	if (edges_visible == 0) {
+		return;
+	}
+
+	if (search->output && search->output != v->output
+			&& !view_on_output(v, search->output)) {
+		return;
+	}
+
+	/* Both view and v must share a common output */
+	if (view->output != v->output
+			&& !bitset_intersects(&view->outputs, &v->outputs)) {
+		return;
+	}
+
+	validate_edges(search->nearest_edges, search->view_edges,
+		search->target_edges, view_window_edges(v), edges_visible,
+		search->validator);
+}
+
+/*
+ * Check all views having an edge of one orientation (left/right or
+ * top/bottom) which may be encountered by a moving edge travelling from
+ * @from to @to. Validating a view more than once (when it is found through
+ * several edges) is harmless since validators only ever pick the best edge.
+ */
+static void
+search_axis(struct neighbor_search *search, struct edge_index *index,
+		int lesser, int greater, int from, int to)
+{
+	if (from == to) {
+		/* Validators ignore non-moving edges */
+		return;
+	}
+
+	/*
+	 * Opposing edges are compared directly, aligned edges with rc.gap
+	 * padding. Resistance may also act within the window edge strength
+	 * beyond the target.
+	 */
+	int slack = abs(rc.window_edge_strength) + abs(rc.gap);
+	int lo = clipped_sub(MIN(from, to), slack);
+	int hi = clipped_add(MAX(from, to), slack);
+
+	int indices[] = { lesser, greater };
+	for (size_t i = 0; i < ARRAY_SIZE(indices); i++) {
+		struct edge_key *keys = index->keys[indices[i]];
+		for (size_t k = index_lower_bound(keys, index->len, lo);
+				k < index->len && keys[k].offset <= hi; k++) {
+			check_neighbor(search, keys[k].view);
+		}
+	}
+}
+
 void
 edges_find_neighbors(struct border *nearest_edges, struct view *view,
 		struct wlr_box origin, struct wlr_box target,
@@ -394,42 +967,51 @@ edges_find_neighbors(struct border *nearest_edges, struct view *view,
 	edges_for_target_geometry(&view_edges, view, origin);
 	edges_for_target_geometry(&target_edges, view, target);
 
-	struct view *v;
-	for_each_view(v, &view->server->views, LAB_VIEW_CRITERIA_CURRENT_WORKSPACE) {
-		if (v == view || v->minimized || !output_is_usable(v->output)) {
-			continue;
-		}
-
-		uint32_t edges_visible = ignore_hidden ? v->edges_visible :
-			WLR_EDGE_TOP | WLR_EDGE_LEFT
-				| WLR_EDGE_BOTTOM | WLR_EDGE_RIGHT;
-
-		if (edges_visible == 0) {
-			continue;
-		}
-
-		if (output && output != v->output && !view_on_output(v, output)) {
-			continue;
-		}
-
-		/* Both view and v must share a common output */
-		if (view->output != v->output && !(view->outputs & v->outputs)) {
-			continue;
-		}
+	struct server *server = view->server;
+	if (!server->edge_index || !server->edge_index->valid) {
+		index_rebuild(server);
+	}
 
-		struct border border = ssd_get_margin(v->ssd);
+	struct neighbor_search search = {
+		.nearest_edges = nearest_edges,
+		.view = view,
+		.view_edges = view_edges,
+		.target_edges = target_edges,
+		.output = output,
+		.validator = validator,
+		.ignore_hidden = ignore_hidden,
+	};
 
-		struct border win_edges = {
-			.top = v->current.y - border.top,
-			.left = v->current.x - border.left,
-			.bottom = v->current.y + border.bottom
-				+ view_effective_height(v, /* use_pending */ false),
-			.right = v->current.x + v->current.width + border.right,
-		};
+	/*
+	 * A moving left or right edge can only encounter left or right
+	 * edges of other views, a moving top or bottom edge only top or
+	 * bottom edges.
+	 */
+	struct edge_index *index = server->edge_index;
+	search_axis(&search, index, INDEX_LEFT, INDEX_RIGHT,
+		view_edges.left, target_edges.left);
+	search_axis(&search, index, INDEX_LEFT, INDEX_RIGHT,
+		view_edges.right, target_edges.right);
+	search_axis(&search, index, INDEX_TOP, INDEX_BOTTOM,
+		view_edges.top, target_edges.top);
+	search_axis(&search, index, INDEX_TOP, INDEX_BOTTOM,
+		view_edges.bottom, target_edges.bottom);
+}
 
-		validate_edges(nearest_edges, view_edges,
-			target_edges, win_edges, edges_visible, validator);
+static void
+check_output(struct border *nearest_edges, struct border view_edges,
+		struct border target_edges, struct wlr_box origin,
+		struct wlr_box target, struct wlr_box usable,
+		edge_validator_t validator)
+{
+	struct wlr_box ol;
+	if (!wlr_box_intersection(&ol, &origin, &usable) &&
+			!wlr_box_intersection(&ol, &target, &usable)) {
+		return;
 	}
+
+	validate_output_edges(nearest_edges,
+		view_edges, target_edges, usable, validator);
 }
 
 void
@@ -453,6 +1035,22 @@ edges_find_outputs(struct border *nearest_edges, struct view *view,
 	edges_for_target_geometry(&view_edges, view, origin);
 	edges_for_target_geometry(&target_edges, view, target);
 
+	struct edge_index *index = view->server->edge_index;
+	if (index && index->grabbed == view) {
+		if (!index->outputs_valid) {
+			outputs_rebuild(index, view->server);
+		}
+		struct session_output *entry;
+		wl_array_for_each(entry, &index->outputs) {
+			if (output && entry->output != output) {
+				continue;
+			}
+			check_output(nearest_edges, view_edges, target_edges,
+				origin, target, entry->usable, validator);
+		}
+		return;
+	}
+
 	struct output *o;
 	wl_list_for_each(o, &view->server->outputs, link) {
 		if (!output_is_usable(o)) {
@@ -463,17 +1061,9 @@ edges_find_outputs(struct border *nearest_edges, struct view *view,
 			continue;
 		}
 
-		struct wlr_box usable =
-			output_usable_area_in_layout_coords(o);
-
-		struct wlr_box ol;
-		if (!wlr_box_intersection(&ol, &origin, &usable) &&
-				!wlr_box_intersection(&ol, &target, &usable)) {
-			continue;
-		}
-
-		validate_output_edges(nearest_edges,
-			view_edges, target_edges, usable, validator);
+		check_output(nearest_edges, view_edges, target_edges,
+			origin, target, output_usable_area_in_layout_coords(o),
+			validator);
 	}
 }
 
@@ -507,7 +1097,7 @@ edges_adjust_move_coords(struct view *view, struct border edges,
 {
 	assert(view);
 
-	struct border border = ssd_get_margin(view->ssd);
+	struct border border = ssd_get_margin(view);
 	struct wlr_box *view_geom =
 		use_pending ? &view->pending : &view->current;
 
@@ -537,7 +1127,7 @@ edges_adjust_resize_geom(struct view *view, struct border edges,
 {
 	assert(view);
 
-	struct border border = ssd_get_margin(view->ssd);
+	struct border border = ssd_get_margin(view);
 	struct wlr_box *view_geom =
 		use_pending ? &view->pending : &view->current;
 
@@ -0,0 +1,339 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/util/log.h>
+#include "common/macros.h"
+#include "common/time-helpers.h"
+#include "flight-recorder.h"
+#include "labwc.h"
+
+/* 128 KiB, must be a power of two */
+#define FLIGHT_RING_SIZE 4096
+#define FLIGHT_ALT_STACK_SIZE (64 * 1024)
+#define FLIGHT_MAX_STRINGS 256
+
+struct flight_event {
+	int64_t nsec;
+	uint32_t type;
+	uint32_t a;
+	uint64_t b;
+	uint64_t c;
+};
+
+/*
+ * How the fields of each type are written: 'd' decimal, 'x' hex, 's' an
+ * index into strings[], '-' unused
+ */
+static const struct {
+	const char *name;
+	const char *labels[3];
+	const char *format;
+} event_types[FLIGHT_EVENT_COUNT] = {
+	[FLIGHT_EVENT_INPUT] = { "input",
+		{ "device", "time_msec", NULL }, "dd-" },
+	[FLIGHT_EVENT_ACTION] = { "action",
+		{ "type", "view", "name" }, "dxs" },
+	[FLIGHT_EVENT_CONFIGURE_SENT] = { "configure-sent",
+		{ NULL, "view", NULL }, "-x-" },
+	[FLIGHT_EVENT_CONFIGURE_ACKED] = { "configure-acked",
+		{ NULL, "view", "usec" }, "-xd" },
+	[FLIGHT_EVENT_CONFIGURE_TIMEOUT] = { "configure-timeout",
+		{ NULL, "view", "msec" }, "-xd" },
+	[FLIGHT_EVENT_OUTPUT_COMMIT] = { "output-commit",
+		{ "output", "build_usec", "commit_usec" }, "ddd" },
+	[FLIGHT_EVENT_VIEW_MAP] = { "view-map",
+		{ NULL, "view", NULL }, "-x-" },
+	[FLIGHT_EVENT_VIEW_UNMAP] = { "view-unmap",
+		{ NULL, "view", NULL }, "-x-" },
+	[FLIGHT_EVENT_PHASE] = { "phase",
+		{ NULL, "operation", "phase" }, "-ss" },
+	[FLIGHT_EVENT_STALL] = { "stall",
+		{ NULL, "usec", NULL }, "-d-" },
+};
+
+static struct flight_event ring[FLIGHT_RING_SIZE];
+/*
+ * Names recorded by flight_recorder_string(). Entries are never changed
+ * once nr_strings has been raised past them, so that a torn event can
+ * at worst print the wrong name.
+ */
+static const char *strings[FLIGHT_MAX_STRINGS];
+static _Atomic uint32_t nr_strings;
+/* Total number of events recorded, the next one goes to head % size */
+static _Atomic uint64_t head;
+static bool disabled;
+static char dump_path[256];
+static struct wl_event_source *sigusr1_source;
+
+static const int crash_signals[] = {
+	SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT,
+};
+
+void
+flight_record(enum flight_event_type type, uint32_t a, uint64_t b,
+		uint64_t c)
+{
+	if (disabled) {
+		return;
+	}
+	/* Claims a slot, so that worker threads may record as well */
+	uint64_t i = atomic_fetch_add_explicit(&head, 1, memory_order_relaxed);
+	struct flight_event *event = &ring[i & (FLIGHT_RING_SIZE - 1)];
+	event->nsec = time_now_nsec();
+	event->type = type;
+	event->a = a;
+	event->b = b;
+	event->c = c;
+}
+
+uint32_t
+flight_recorder_string(const char *literal)
+{
+	if (disabled) {
+		return FLIGHT_STRING_NONE;
+	}
+	uint32_t nr = atomic_load_explicit(&nr_strings, memory_order_relaxed);
+	for (uint32_t i = 0; i < nr; i++) {
+		if (strings[i] == literal || !strcmp(strings[i], literal)) {
+			return i;
+		}
+	}
+	if (nr == FLIGHT_MAX_STRINGS) {
+		return FLIGHT_STRING_NONE;
+	}
+	strings[nr] = literal;
+	atomic_store_explicit(&nr_strings, nr + 1, memory_order_release);
+	return nr;
+}
+
+/* Only async-signal-safe functions from here to flight_recorder_dump() */
+
+struct dump_buf {
+	int fd;
+	size_t len;
+	char data[4096];
+};
+
+static void
+dump_flush(struct dump_buf *out)
+{
+	size_t written = 0;
+	while (written < out->len) {
+		ssize_t ret = write(out->fd, out->data + written,
+			out->len - written);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		written += ret;
+	}
+	out->len = 0;
+}
+
+static void
+dump_char(struct dump_buf *out, char c)
+{
+	if (out->len == sizeof(out->data)) {
+		dump_flush(out);
+	}
+	out->data[out->len++] = c;
+}
+
+static void
+dump_str(struct dump_buf *out, const char *str)
+{
+	while (*str) {
+		dump_char(out, *str++);
+	}
+}
+
+static void
+dump_uint(struct dump_buf *out, uint64_t value, unsigned int base,
+		int min_digits)
+{
+	char digits[24];
+	int nr = 0;
+	do {
+		digits[nr++] = "0123456789abcdef"[value % base];
+		value /= base;
+	} while (value || nr < min_digits);
+	while (nr) {
+		dump_char(out, digits[--nr]);
+	}
+}
+
+static void
+dump_time(struct dump_buf *out, int64_t nsec)
+{
+	dump_uint(out, nsec / 1000000000, 10, 1);
+	dump_char(out, '.');
+	dump_uint(out, nsec % 1000000000 / 1000, 10, 6);
+}
+
+static void
+dump_event(struct dump_buf *out, const struct flight_event *event,
+		uint32_t nr_valid_strings)
+{
+	dump_time(out, event->nsec);
+	if (event->type >= FLIGHT_EVENT_COUNT) {
+		dump_str(out, " ?\n");
+		return;
+	}
+	dump_char(out, ' ');
+	dump_str(out, event_types[event->type].name);
+
+	uint64_t values[] = { event->a, event->b, event->c };
+	for (size_t i = 0; i < ARRAY_SIZE(values); i++) {
+		char format = event_types[event->type].format[i];
+		if (format == '-') {
+			continue;
+		}
+		dump_char(out, ' ');
+		dump_str(out, event_types[event->type].labels[i]);
+		dump_char(out, '=');
+		if (format == 'd') {
+			dump_uint(out, values[i], 10, 1);
+		} else if (format == 'x') {
+			dump_str(out, "0x");
+			dump_uint(out, values[i], 16, 1);
+		} else if (values[i] < nr_valid_strings) {
+			dump_str(out, strings[values[i]]);
+		} else {
+			dump_char(out, '?');
+		}
+	}
+	dump_char(out, '\n');
+}
+
+static bool
+write_dump(const char *reason)
+{
+	if (disabled || !dump_path[0]) {
+		return false;
+	}
+	struct dump_buf out = { 0 };
+	out.fd = open(dump_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+		0600);
+	if (out.fd < 0) {
+		return false;
+	}
+
+	uint32_t nr_valid_strings =
+		atomic_load_explicit(&nr_strings, memory_order_acquire);
+	uint64_t end = atomic_load(&head);
+	uint64_t start = end > FLIGHT_RING_SIZE ? end - FLIGHT_RING_SIZE : 0;
+	dump_str(&out, "# labwc flight recorder, ");
+	dump_str(&out, reason);
+	dump_str(&out, " at ");
+	dump_time(&out, time_now_nsec());
+	dump_str(&out, ", ");
+	dump_uint(&out, end - start, 10, 1);
+	dump_str(&out, " of ");
+	dump_uint(&out, end, 10, 1);
+	dump_str(&out, " events\n");
+
+	/* Events recorded meanwhile may show up torn */
+	for (uint64_t i = start; i < end; i++) {
+		dump_event(&out, &ring[i & (FLIGHT_RING_SIZE - 1)],
+			nr_valid_strings);
+	}
+	dump_flush(&out);
+	close(out.fd);
+	return true;
+}
+
+void
+flight_recorder_dump(const char *reason)
+{
+	int saved_errno = errno;
+	write_dump(reason);
+	errno = saved_errno;
+}
+
+static void
+handle_crash(int signal)
+{
+	flight_recorder_dump("crash");
+	/* The default action was restored by SA_RESETHAND */
+	raise(signal);
+}
+
+static void
+install_crash_handlers(void)
+{
+	/* Also dump on stack overflows */
+	static char alt_stack[FLIGHT_ALT_STACK_SIZE];
+	stack_t stack = {
+		.ss_sp = alt_stack,
+		.ss_size = sizeof(alt_stack),
+	};
+	sigaltstack(&stack, NULL);
+
+	struct sigaction sa = {
+		.sa_handler = handle_crash,
+		.sa_flags = SA_RESETHAND | SA_ONSTACK,
+	};
+	sigemptyset(&sa.sa_mask);
+	for (size_t i = 0; i < ARRAY_SIZE(crash_signals); i++) {
+		sigaction(crash_signals[i], &sa, NULL);
+	}
+}
+
+static int
+handle_sigusr1(int signal, void *data)
+{
+	flight_recorder_save("SIGUSR1");
+	return 0;
+}
+
+void
+flight_recorder_init(struct server *server)
+{
+	const char *env = getenv("LABWC_FLIGHT_RECORDER");
+	if (env && (!strcmp(env, "off") || !strcmp(env, "0"))) {
+		disabled = true;
+		return;
+	}
+	if (env && *env) {
+		snprintf(dump_path, sizeof(dump_path), "%s", env);
+	} else {
+		const char *dir = getenv("XDG_RUNTIME_DIR");
+		snprintf(dump_path, sizeof(dump_path),
+			"%s/labwc-flight-recorder.%d", dir ? dir : "/tmp",
+			(int)getpid());
+	}
+
+	install_crash_handlers();
+	sigusr1_source = wl_event_loop_add_signal(server->wl_event_loop,
+		SIGUSR1, handle_sigusr1, NULL);
+}
+
+void
+flight_recorder_save(const char *reason)
+{
+	if (write_dump(reason)) {
+		wlr_log(WLR_INFO, "flight recorder written to %s", dump_path);
+	} else if (!disabled) {
+		wlr_log_errno(WLR_ERROR, "cannot write %s", dump_path);
+	}
+}
+
+void
+flight_recorder_finish(void)
+{
+	if (sigusr1_source) {
+		wl_event_source_remove(sigusr1_source);
+		sigusr1_source = NULL;
+	}
+}
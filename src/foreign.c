@@ -62,6 +62,11 @@ handle_destroy(struct wl_listener *listener, void *data)
 	wl_list_remove(&toplevel->activate.link);
 	wl_list_remove(&toplevel->close.link);
 	wl_list_remove(&toplevel->destroy.link);
+	if (toplevel->idle) {
+		wl_event_source_remove(toplevel->idle);
+		toplevel->idle = NULL;
+	}
+	toplevel->pending_updates = 0;
 	toplevel->handle = NULL;
 }
 
@@ -100,6 +105,9 @@ foreign_toplevel_handle_create(struct view *view)
 
 	toplevel->destroy.notify = handle_destroy;
 	wl_signal_add(&toplevel->handle->events.destroy, &toplevel->destroy);
+
+	/* Also covers state set before the handle existed */
+	foreign_toplevel_schedule_update(view, LAB_TOPLEVEL_UPDATE_ALL);
 }
 
 /*
@@ -109,11 +117,9 @@ foreign_toplevel_handle_create(struct view *view)
  * destroy events so its fine to just relay the current state and let
  * wlr_foreign_toplevel handle the rest.
  */
-void
-foreign_toplevel_update_outputs(struct view *view)
+static void
+update_outputs(struct view *view)
 {
-	assert(view->toplevel.handle);
-
 	struct output *output;
 	wl_list_for_each(output, &view->server->outputs, link) {
 		if (view_on_output(view, output)) {
@@ -125,3 +131,61 @@ foreign_toplevel_update_outputs(struct view *view)
 		}
 	}
 }
+
+static void
+handle_idle(void *data)
+{
+	struct view *view = data;
+	struct foreign_toplevel *toplevel = &view->toplevel;
+	struct wlr_foreign_toplevel_handle_v1 *handle = toplevel->handle;
+	uint32_t updates = toplevel->pending_updates;
+	toplevel->pending_updates = 0;
+	toplevel->idle = NULL;
+
+	/* wlroots sends a single done event for all of these */
+	if (updates & LAB_TOPLEVEL_UPDATE_TITLE) {
+		const char *title = view_get_string_prop(view, "title");
+		if (title) {
+			wlr_foreign_toplevel_handle_v1_set_title(handle, title);
+		}
+	}
+	if (updates & LAB_TOPLEVEL_UPDATE_APP_ID) {
+		const char *app_id = view_get_string_prop(view, "app_id");
+		if (app_id) {
+			wlr_foreign_toplevel_handle_v1_set_app_id(handle, app_id);
+		}
+	}
+	if (updates & LAB_TOPLEVEL_UPDATE_OUTPUTS) {
+		update_outputs(view);
+	}
+	if (updates & LAB_TOPLEVEL_UPDATE_ACTIVATED) {
+		wlr_foreign_toplevel_handle_v1_set_activated(handle,
+			toplevel->activated);
+	}
+	if (updates & LAB_TOPLEVEL_UPDATE_MINIMIZED) {
+		wlr_foreign_toplevel_handle_v1_set_minimized(handle,
+			view->minimized);
+	}
+	if (updates & LAB_TOPLEVEL_UPDATE_MAXIMIZED) {
+		wlr_foreign_toplevel_handle_v1_set_maximized(handle,
+			view->maximized == VIEW_AXIS_BOTH);
+	}
+	if (updates & LAB_TOPLEVEL_UPDATE_FULLSCREEN) {
+		wlr_foreign_toplevel_handle_v1_set_fullscreen(handle,
+			view->fullscreen);
+	}
+}
+
+void
+foreign_toplevel_schedule_update(struct view *view, uint32_t updates)
+{
+	struct foreign_toplevel *toplevel = &view->toplevel;
+	if (!toplevel->handle) {
+		return;
+	}
+	toplevel->pending_updates |= updates;
+	if (!toplevel->idle) {
+		toplevel->idle = wl_event_loop_add_idle(
+			view->server->wl_event_loop, handle_idle, view);
+	}
+}
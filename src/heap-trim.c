@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include "config.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/util/log.h>
+#include "config/rcxml.h"
+#include "heap-trim.h"
+#include "labwc.h"
+#if HAVE_MALLOC_TRIM
+#include <malloc.h>
+#endif
+
+#define HEAP_TRIM_DELAY_MS 3000
+
+static struct wl_event_source *timer;
+static struct heap_trim_stats stats;
+
+#if HAVE_MALLOC_TRIM
+static size_t
+resident_bytes(void)
+{
+	FILE *statm = fopen("/proc/self/statm", "r");
+	if (!statm) {
+		return 0;
+	}
+	unsigned long size, resident;
+	int ret = fscanf(statm, "%lu %lu", &size, &resident);
+	fclose(statm);
+	return ret == 2 ? resident * sysconf(_SC_PAGESIZE) : 0;
+}
+
+static int
+handle_timer(void *data)
+{
+	size_t before = resident_bytes();
+	malloc_trim(0);
+	size_t after = resident_bytes();
+
+	size_t reclaimed = before > after ? before - after : 0;
+	stats.runs++;
+	stats.reclaimed_bytes += reclaimed;
+	wlr_log(WLR_DEBUG, "heap trim reclaimed %zu KiB", reclaimed / 1024);
+	return 0;
+}
+#endif
+
+void
+heap_trim_schedule(struct server *server)
+{
+#if HAVE_MALLOC_TRIM
+	if (!rc.trim_heap) {
+		return;
+	}
+	if (!timer) {
+		timer = wl_event_loop_add_timer(server->wl_event_loop,
+			handle_timer, NULL);
+	}
+	wl_event_source_timer_update(timer, HEAP_TRIM_DELAY_MS);
+#endif
+}
+
+void
+heap_trim_get_stats(struct heap_trim_stats *out)
+{
+	*out = stats;
+}
+
+void
+heap_trim_finish(void)
+{
+	if (timer) {
+		wl_event_source_remove(timer);
+		timer = NULL;
+	}
+}
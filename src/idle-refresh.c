@@ -0,0 +1,303 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_damage_ring.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/util/log.h>
+#include "common/macros.h"
+#include "common/time-helpers.h"
+#include "config/rcxml.h"
+#include "idle-refresh.h"
+#include "labwc.h"
+
+#define POWER_SUPPLY_PATH "/sys/class/power_supply"
+
+static struct {
+	struct server *server;
+	struct wl_event_source *timer;
+	bool timer_armed;
+} idle;
+
+static bool
+read_attribute(const char *supply, const char *attr, char *buf, size_t size)
+{
+	char path[256];
+	snprintf(path, sizeof(path), POWER_SUPPLY_PATH "/%s/%s", supply, attr);
+	FILE *f = fopen(path, "r");
+	if (!f) {
+		return false;
+	}
+	bool ok = fgets(buf, size, f);
+	fclose(f);
+	if (ok) {
+		buf[strcspn(buf, "\n")] = '\0';
+	}
+	return ok;
+}
+
+/*
+ * Only checked once an output has been idle for long enough, so that
+ * there are no extra wakeups just to follow the power supply.
+ */
+static bool
+on_battery(void)
+{
+	DIR *dir = opendir(POWER_SUPPLY_PATH);
+	if (!dir) {
+		return false;
+	}
+	bool discharging = false;
+	bool mains_online = false;
+	char buf[32];
+	struct dirent *entry;
+	while ((entry = readdir(dir))) {
+		if (entry->d_name[0] == '.'
+				|| !read_attribute(entry->d_name, "type",
+					buf, sizeof(buf))) {
+			continue;
+		}
+		if (!strcmp(buf, "Mains")) {
+			if (read_attribute(entry->d_name, "online",
+					buf, sizeof(buf)) && !strcmp(buf, "1")) {
+				mains_online = true;
+			}
+		} else if (!strcmp(buf, "Battery")) {
+			if (read_attribute(entry->d_name, "status",
+					buf, sizeof(buf))
+					&& !strcmp(buf, "Discharging")) {
+				discharging = true;
+			}
+		}
+	}
+	closedir(dir);
+	return discharging && !mains_online;
+}
+
+/* The mode of the same size with the lowest refresh rate at or above rate */
+static struct wlr_output_mode *
+find_idle_mode(struct wlr_output *wlr_output)
+{
+	struct wlr_output_mode *current = wlr_output->current_mode;
+	int32_t min_refresh = rc.idle_refresh_rate * 1000;
+	struct wlr_output_mode *best = NULL;
+	struct wlr_output_mode *mode;
+	wl_list_for_each(mode, &wlr_output->modes, link) {
+		if (mode->width != current->width
+				|| mode->height != current->height
+				|| mode->refresh >= current->refresh
+				|| mode->refresh < min_refresh - 500) {
+			continue;
+		}
+		if (!best || mode->refresh < best->refresh) {
+			best = mode;
+		}
+	}
+	return best;
+}
+
+static bool
+can_lower(struct output *output)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+	return output_is_usable(output) && output->scene_output
+		&& !output->idle_refresh.full_mode
+		&& !output->idle_refresh.unsupported
+		/* Virtual outputs have their own rate cap */
+		&& !output->render_on_damage_only
+		&& wlr_output->current_mode
+		&& wlr_output->adaptive_sync_status
+			!= WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED;
+}
+
+static void
+request_mode(struct output *output, struct wlr_output_mode *mode)
+{
+	output->idle_refresh.pending_mode = mode;
+	/* Make sure that the next frame is committed */
+	wlr_damage_ring_add_whole(&output->scene_output->damage_ring);
+	wlr_output_schedule_frame(output->wlr_output);
+}
+
+static void
+lower_rate(struct output *output)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+	struct wlr_output_mode *mode = find_idle_mode(wlr_output);
+	if (!mode) {
+		output->idle_refresh.unsupported = true;
+		return;
+	}
+
+	/* The mode is only committed with the next frame, so test it now */
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+	wlr_output_state_set_mode(&state, mode);
+	bool ok = wlr_output_test_state(wlr_output, &state);
+	wlr_output_state_finish(&state);
+	if (!ok) {
+		wlr_log(WLR_DEBUG, "cannot lower refresh rate of output %s",
+			wlr_output->name);
+		output->idle_refresh.unsupported = true;
+		return;
+	}
+
+	output->idle_refresh.full_mode = wlr_output->current_mode;
+	request_mode(output, mode);
+}
+
+static void
+raise_rate(struct output *output)
+{
+	struct output_idle_refresh *state = &output->idle_refresh;
+	if (state->full_mode && state->pending_mode != state->full_mode
+			&& output->scene_output) {
+		request_mode(output, state->full_mode);
+	}
+}
+
+static void
+arm_timer(int msec)
+{
+	wl_event_source_timer_update(idle.timer, MAX(msec, 1));
+	idle.timer_armed = true;
+}
+
+static int
+handle_timer(void *data)
+{
+	idle.timer_armed = false;
+	if (!rc.idle_refresh_rate) {
+		return 0;
+	}
+
+	int64_t now = time_now_nsec();
+	int64_t delay = (int64_t)rc.idle_refresh_delay * 1000000;
+	int64_t next = 0;
+	bool battery_checked = false;
+
+	struct output *output;
+	wl_list_for_each(output, &idle.server->outputs, link) {
+		if (!can_lower(output)) {
+			continue;
+		}
+		int64_t remaining = output->idle_refresh.last_damage_nsec
+			+ delay - now;
+		if (remaining > 0) {
+			next = next ? MIN(next, remaining) : remaining;
+			continue;
+		}
+		if (rc.idle_refresh_battery_only && !battery_checked) {
+			battery_checked = true;
+			if (!on_battery()) {
+				/* Look again once the delay has passed */
+				arm_timer(rc.idle_refresh_delay);
+				return 0;
+			}
+		}
+		lower_rate(output);
+	}
+	if (next) {
+		arm_timer((next + 999999) / 1000000);
+	}
+	return 0;
+}
+
+void
+idle_refresh_init(struct server *server)
+{
+	idle.server = server;
+	idle.timer = wl_event_loop_add_timer(server->wl_event_loop,
+		handle_timer, NULL);
+}
+
+void
+idle_refresh_record_frame(struct output *output, bool damaged)
+{
+	if (!rc.idle_refresh_rate || !damaged || !idle.timer) {
+		return;
+	}
+	/*
+	 * The frame which commits a new mode is damaged by request_mode()
+	 * itself, which must not count as activity
+	 */
+	if (output->idle_refresh.pending_mode) {
+		return;
+	}
+	output->idle_refresh.last_damage_nsec = time_now_nsec();
+	raise_rate(output);
+	if (!idle.timer_armed) {
+		arm_timer(rc.idle_refresh_delay);
+	}
+}
+
+void
+idle_refresh_apply(struct output *output)
+{
+	struct output_idle_refresh *state = &output->idle_refresh;
+	struct wlr_output_mode *mode = state->pending_mode;
+	if (!mode) {
+		return;
+	}
+	state->pending_mode = NULL;
+	wlr_output_set_mode(output->wlr_output, mode);
+	if (mode == state->full_mode) {
+		state->full_mode = NULL;
+	}
+	wlr_log(WLR_DEBUG, "refresh rate of output %s set to %.3f Hz",
+		output->wlr_output->name, mode->refresh / 1000.0);
+}
+
+void
+idle_refresh_notify_activity(void)
+{
+	if (!idle.server || !rc.idle_refresh_rate) {
+		return;
+	}
+	int64_t now = time_now_nsec();
+	struct output *output;
+	wl_list_for_each(output, &idle.server->outputs, link) {
+		output->idle_refresh.last_damage_nsec = now;
+		raise_rate(output);
+	}
+	if (!idle.timer_armed) {
+		arm_timer(rc.idle_refresh_delay);
+	}
+}
+
+void
+idle_refresh_reset(struct output *output)
+{
+	output->idle_refresh = (struct output_idle_refresh){
+		.last_damage_nsec = time_now_nsec(),
+	};
+}
+
+void
+idle_refresh_reconfigure(struct server *server)
+{
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		/* The rate or the outputs on battery may have changed */
+		output->idle_refresh.unsupported = false;
+		if (!rc.idle_refresh_rate) {
+			raise_rate(output);
+		}
+	}
+	if (rc.idle_refresh_rate && idle.timer) {
+		arm_timer(rc.idle_refresh_delay);
+	}
+}
+
+void
+idle_refresh_finish(void)
+{
+	if (idle.timer) {
+		wl_event_source_remove(idle.timer);
+		idle.timer = NULL;
+	}
+	idle.server = NULL;
+}
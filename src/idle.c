@@ -5,7 +5,19 @@
 #include <wlr/types/wlr_idle_notify_v1.h>
 #include <wlr/types/wlr_idle_inhibit_v1.h>
 #include "common/mem.h"
+#include "common/time-helpers.h"
 #include "idle.h"
+#include "idle-refresh.h"
+
+/*
+ * Input devices may report events thousands of times per second and each
+ * activity notification re-arms the timers of all idle clients, so repeated
+ * activity is only forwarded this often. The first event after a quiet
+ * period is always forwarded straight away, so resuming from idle is not
+ * delayed. Idle timeouts are thereby counted from up to this long before
+ * the last input event.
+ */
+#define ACTIVITY_INTERVAL_NSEC (200 * 1000 * 1000)
 
 struct lab_idle_inhibitor {
 	struct wlr_idle_inhibitor_v1 *wlr_inhibitor;
@@ -19,10 +31,12 @@ struct lab_idle_manager {
 		struct wl_listener on_new_inhibitor;
 	} inhibitor;
 	struct wlr_seat *wlr_seat;
+	int64_t last_activity_nsec;
 	struct wl_listener on_display_destroy;
 };
 
 static struct lab_idle_manager *manager;
+static uint64_t activity_count;
 
 static void
 handle_idle_inhibitor_destroy(struct wl_listener *listener, void *data)
@@ -90,6 +104,8 @@ idle_manager_create(struct wl_display *display, struct wlr_seat *wlr_seat)
 void
 idle_manager_notify_activity(struct wlr_seat *seat)
 {
+	activity_count++;
+
 	/*
 	 * The display destroy event might have been triggered
 	 * already and thus the manager would be NULL. Due to
@@ -100,5 +116,20 @@ idle_manager_notify_activity(struct wlr_seat *seat)
 		return;
 	}
 
+	/* There is only one seat, so one timestamp will do */
+	int64_t now = time_now_nsec();
+	if (manager->last_activity_nsec
+			&& now - manager->last_activity_nsec < ACTIVITY_INTERVAL_NSEC) {
+		return;
+	}
+	manager->last_activity_nsec = now;
+
 	wlr_idle_notifier_v1_notify_activity(manager->ext, seat);
+	idle_refresh_notify_activity();
+}
+
+uint64_t
+idle_manager_get_activity_count(void)
+{
+	return activity_count;
 }
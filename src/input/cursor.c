@@ -2,20 +2,25 @@
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
 #include <linux/input-event-codes.h>
+#include <string.h>
 #include <sys/time.h>
 #include <time.h>
 #include <wlr/types/wlr_cursor_shape_v1.h>
 #include <wlr/types/wlr_primary_selection.h>
 #include <wlr/util/region.h>
 #include "action.h"
+#include "common/hash.h"
+#include "common/log.h"
 #include "common/macros.h"
 #include "common/mem.h"
 #include "common/scene-helpers.h"
 #include "common/surface-helpers.h"
+#include "common/trace.h"
 #include "config/mousebind.h"
 #include "dnd.h"
 #include "idle.h"
 #include "input/gestures.h"
+#include "input/latency.h"
 #include "input/touch.h"
 #include "labwc.h"
 #include "layers.h"
@@ -23,12 +28,17 @@
 #include "regions.h"
 #include "resistance.h"
 #include "ssd.h"
+#include "surface-map.h"
 #include "view.h"
 
 #define LAB_CURSOR_SHAPE_V1_VERSION 1
 
 static const char * const *cursor_names = NULL;
 
+/* What seat->xcursor_manager was created from */
+static char *loaded_xcursor_theme;
+static uint32_t loaded_xcursor_size;
+
 /* Usual cursor names */
 static const char * const cursors_xdg[] = {
 	NULL,
@@ -107,6 +117,12 @@ cursor_get_from_ssd(enum ssd_part_type view_area)
 static struct wlr_surface *
 get_toplevel(struct wlr_surface *surface)
 {
+	/* Surfaces of mapped views, including subsurfaces and popups */
+	struct view *view = surface ? surface_map_get_view(surface, NULL) : NULL;
+	if (view) {
+		return view->surface;
+	}
+
 	while (surface) {
 		struct wlr_xdg_surface *xdg_surface =
 			wlr_xdg_surface_try_from_wlr_surface(surface);
@@ -162,6 +178,7 @@ request_cursor_notify(struct wl_listener *listener, void *data)
 
 		wlr_cursor_set_surface(seat->cursor, event->surface,
 			event->hotspot_x, event->hotspot_y);
+		cursor_check_hardware(seat, "client cursor surface");
 	}
 }
 
@@ -188,7 +205,7 @@ request_set_shape_notify(struct wl_listener *listener, void *data)
 		return;
 	}
 
-	wlr_log(WLR_DEBUG, "set xcursor to shape %s", shape_name);
+	lab_log_debug("set xcursor to shape %s", shape_name);
 	wlr_cursor_set_xcursor(seat->cursor, seat->xcursor_manager, shape_name);
 }
 
@@ -224,6 +241,7 @@ process_cursor_move(struct server *server, uint32_t time)
 	dy += server->grab_box.y;
 	resistance_move_apply(view, &dx, &dy);
 	view_move(view, dx, dy);
+	ssd_prerender_nearby_scales(view->ssd);
 
 	overlay_update(&server->seat);
 }
@@ -268,6 +286,17 @@ process_cursor_resize(struct server *server, uint32_t time)
 			server->grab_box.width - new_view_geo.width;
 	}
 
+	/*
+	 * Keep at most one configure in flight. Further motion only
+	 * updates the geometry which is sent when the client commits.
+	 */
+	if (rc.resize_pacing && view->pending_configure_timeout) {
+		server->resize_pending = true;
+		server->resize_pending_geo = new_view_geo;
+		return;
+	}
+
+	server->resize_pending = false;
 	view_move_resize(view, new_view_geo);
 }
 
@@ -286,9 +315,74 @@ cursor_set(struct seat *seat, enum lab_cursors cursor)
 	seat->server_cursor = cursor;
 }
 
+static uint64_t
+get_cursor_image_key(struct server *server)
+{
+	/* Over the usable outputs and their scales */
+	uint64_t hash = HASH_INIT;
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (!output_is_usable(output)) {
+			continue;
+		}
+		uint32_t scale;
+		memcpy(&scale, &output->wlr_output->scale, sizeof(scale));
+		hash = hash_value(hash, (uintptr_t)output->wlr_output);
+		hash = hash_value(hash, scale);
+	}
+	return hash;
+}
+
+/*
+ * wlroots silently falls back to compositing the cursor into the frames
+ * when the cursor plane of an output cannot show the image, for example
+ * because it is too large. Every pointer motion then damages the output,
+ * so the fallback is logged along with what caused it.
+ */
+void
+cursor_check_hardware(struct seat *seat, const char *cause)
+{
+	struct output *output;
+	wl_list_for_each(output, &seat->server->outputs, link) {
+		if (!output_is_usable(output)) {
+			continue;
+		}
+		struct wlr_output *wlr_output = output->wlr_output;
+		struct wlr_output_cursor *cursor =
+			output_get_software_cursor(output);
+		if (!!cursor == output->software_cursor) {
+			continue;
+		}
+		output->software_cursor = cursor;
+		if (!cursor) {
+			wlr_log(WLR_DEBUG, "hardware cursor restored on output %s",
+				wlr_output->name);
+			continue;
+		}
+		const char *reason = wlr_output->software_cursor_locks
+			? "hardware cursors are disabled"
+			: "the cursor plane rejected the image";
+		wlr_log(WLR_INFO, "software cursor on output %s after %s: "
+			"%s (%ux%u buffer, output scale %.2f)", wlr_output->name,
+			cause, reason, cursor->width, cursor->height,
+			wlr_output->scale);
+	}
+}
+
+/*
+ * Re-sets the cursor image so that it is shown on new outputs and at new
+ * scales. This runs on every output layout change, so nothing is done
+ * unless the usable outputs or their scales changed since the last time.
+ */
 void
 cursor_update_image(struct seat *seat)
 {
+	uint64_t key = get_cursor_image_key(seat->server);
+	if (key == seat->cursor_image_key) {
+		return;
+	}
+	seat->cursor_image_key = key;
+
 	enum lab_cursors cursor = seat->server_cursor;
 	if (cursor == LAB_CURSOR_CLIENT) {
 		/*
@@ -302,6 +396,7 @@ cursor_update_image(struct seat *seat)
 			wlr_cursor_set_xcursor(seat->cursor, seat->xcursor_manager, "");
 			cursor_update_focus(seat->server);
 		}
+		cursor_check_hardware(seat, "output change");
 		return;
 	}
 	/*
@@ -313,6 +408,7 @@ cursor_update_image(struct seat *seat)
 	wlr_cursor_unset_image(seat->cursor);
 	wlr_cursor_set_xcursor(seat->cursor, seat->xcursor_manager,
 		cursor_names[cursor]);
+	cursor_check_hardware(seat, "output change");
 }
 
 bool
@@ -400,7 +496,16 @@ cursor_update_common(struct server *server, struct cursor_context *ctx,
 	struct seat *seat = &server->seat;
 	struct wlr_seat *wlr_seat = seat->seat;
 
-	ssd_update_button_hover(ctx->node, server->ssd_hover_state);
+	/*
+	 * A context served from the cursor context cache is the same node
+	 * as the last lookup, so the hovered button can only change
+	 * after a new lookup.
+	 */
+	uint32_t serial = server->cursor_context_cache.lookup_serial;
+	if (serial != seat->hover_lookup_serial) {
+		seat->hover_lookup_serial = serial;
+		ssd_update_button_hover(ctx->node, server->ssd_hover_state);
+	}
 
 	if (server->input_mode != LAB_INPUT_STATE_PASSTHROUGH) {
 		/*
@@ -498,6 +603,7 @@ cursor_get_resize_edges(struct wlr_cursor *cursor, struct cursor_context *ctx)
 static void
 process_cursor_motion(struct server *server, uint32_t time)
 {
+	TRACE_FUNC();
 	/* If the mode is non-passthrough, delegate to those functions. */
 	if (server->input_mode == LAB_INPUT_STATE_MOVE) {
 		process_cursor_move(server, time);
@@ -552,9 +658,15 @@ msec(const struct timespec *t)
 	return t->tv_sec * 1000 + t->tv_nsec / 1000000;
 }
 
+/* Prevents recursion via view_move_to_front() */
+static bool updating_focus;
+
 static void
-_cursor_update_focus(struct server *server)
+update_focus(void *data)
 {
+	struct server *server = data;
+	updating_focus = true;
+
 	struct timespec now;
 	clock_gettime(CLOCK_MONOTONIC, &now);
 
@@ -571,20 +683,24 @@ _cursor_update_focus(struct server *server)
 
 	cursor_update_common(server, &ctx, msec(&now),
 		/*cursor_has_moved*/ false);
+	updating_focus = false;
 }
 
 void
 cursor_update_focus(struct server *server)
 {
-	/* Prevent recursion via view_move_to_front() */
-	static bool updating_focus = false;
 	if (!updating_focus) {
-		updating_focus = true;
-		_cursor_update_focus(server);
-		updating_focus = false;
+		defer_schedule(&server->seat.focus_update,
+			server->wl_event_loop, update_focus, server);
 	}
 }
 
+void
+cursor_settle_focus(struct server *server)
+{
+	defer_flush(&server->seat.focus_update);
+}
+
 static void
 warp_cursor_to_constraint_hint(struct seat *seat,
 		struct wlr_pointer_constraint_v1 *constraint)
@@ -712,6 +828,31 @@ apply_constraint(struct seat *seat, struct wlr_pointer *pointer, double *x, doub
 	*y = sy_confined - sy;
 }
 
+static void flush_axis(struct seat *seat);
+
+/*
+ * With <mouse><coalesceMotion>, defer processing of motion to the next
+ * frame of the output the cursor is on. The cursor itself must have
+ * been moved already. Returns false if the motion has to be processed
+ * right away.
+ */
+static bool
+defer_motion(struct seat *seat, uint32_t time_msec)
+{
+	if (!rc.coalesce_motion) {
+		return false;
+	}
+	struct wlr_output *output = wlr_output_layout_output_at(
+		seat->server->output_layout, seat->cursor->x, seat->cursor->y);
+	if (!output) {
+		return false;
+	}
+	seat->motion_pending = true;
+	seat->motion_pending_msec = time_msec;
+	wlr_output_schedule_frame(output);
+	return true;
+}
+
 static bool
 cursor_locked(struct seat *seat, struct wlr_pointer *pointer)
 {
@@ -724,9 +865,8 @@ static void
 preprocess_cursor_motion(struct seat *seat, struct wlr_pointer *pointer,
 		uint32_t time_msec, double dx, double dy)
 {
-	if (cursor_locked(seat, pointer)) {
-		return;
-	}
+	assert(!cursor_locked(seat, pointer));
+	flush_axis(seat);
 	apply_constraint(seat, pointer, &dx, &dy);
 
 	/*
@@ -738,7 +878,29 @@ preprocess_cursor_motion(struct seat *seat, struct wlr_pointer *pointer,
 	 * without any input.
 	 */
 	wlr_cursor_move(seat->cursor, &pointer->base, dx, dy);
-	process_cursor_motion(seat->server, time_msec);
+
+	if (!defer_motion(seat, time_msec)) {
+		process_cursor_motion(seat->server, time_msec);
+	}
+}
+
+static void
+flush_pending_motion(struct seat *seat)
+{
+	if (!seat->motion_pending) {
+		return;
+	}
+	seat->motion_pending = false;
+	process_cursor_motion(seat->server, seat->motion_pending_msec);
+	/* The frame event of the device was held back, see cursor_frame() */
+	wlr_seat_pointer_notify_frame(seat->seat);
+}
+
+void
+cursor_flush_motion(struct seat *seat)
+{
+	flush_axis(seat);
+	flush_pending_motion(seat);
 }
 
 static void
@@ -752,6 +914,7 @@ cursor_motion(struct wl_listener *listener, void *data)
 	struct server *server = seat->server;
 	struct wlr_pointer_motion_event *event = data;
 	idle_manager_notify_activity(seat->seat);
+	latency_input_event(&event->pointer->base, event->time_msec);
 
 	wlr_relative_pointer_manager_v1_send_relative_motion(
 		server->relative_pointer_manager,
@@ -759,6 +922,16 @@ cursor_motion(struct wl_listener *listener, void *data)
 		event->delta_x, event->delta_y, event->unaccel_dx,
 		event->unaccel_dy);
 
+	/*
+	 * With a locked pointer, typically held by a game, the relative
+	 * motion above is all the client gets. The cursor does not move,
+	 * so there is nothing to hit-test and no decoration to update.
+	 * High polling rate mice make this by far the most frequent path.
+	 */
+	if (cursor_locked(seat, event->pointer)) {
+		return;
+	}
+
 	preprocess_cursor_motion(seat, event->pointer,
 		event->time_msec, event->delta_x, event->delta_y);
 }
@@ -778,6 +951,7 @@ cursor_motion_absolute(struct wl_listener *listener, void *data)
 		listener, seat, cursor_motion_absolute);
 	struct wlr_pointer_motion_absolute_event *event = data;
 	idle_manager_notify_activity(seat->seat);
+	latency_input_event(&event->pointer->base, event->time_msec);
 
 	double lx, ly;
 	wlr_cursor_absolute_to_layout_coords(seat->cursor,
@@ -791,6 +965,10 @@ cursor_motion_absolute(struct wl_listener *listener, void *data)
 		seat->seat, (uint64_t)event->time_msec * 1000,
 		dx, dy, dx, dy);
 
+	if (cursor_locked(seat, event->pointer)) {
+		return;
+	}
+
 	preprocess_cursor_motion(seat, event->pointer,
 		event->time_msec, dx, dy);
 }
@@ -803,16 +981,16 @@ handle_release_mousebinding(struct server *server,
 		return false;
 	}
 
-	struct mousebind *mousebind;
+	struct mousebind **bind;
 	bool consumed_by_frame_context = false;
 
 	uint32_t modifiers = wlr_keyboard_get_modifiers(
 			&server->seat.keyboard_group->keyboard);
 
-	wl_list_for_each(mousebind, &rc.mousebinds, link) {
-		if (ssd_part_contains(mousebind->context, ctx->type)
-				&& mousebind->button == button
-				&& modifiers == mousebind->modifiers) {
+	struct wl_array *binds = mousebind_lookup(ctx->type, button, modifiers);
+	if (binds) {
+		wl_array_for_each(bind, binds) {
+			struct mousebind *mousebind = *bind;
 			switch (mousebind->mouse_event) {
 			case MOUSE_ACTION_RELEASE:
 				break;
@@ -843,9 +1021,10 @@ handle_release_mousebinding(struct server *server,
 	 * Clear "pressed" status for all bindings of this mouse button,
 	 * regardless of whether handled or not
 	 */
-	wl_list_for_each(mousebind, &rc.mousebinds, link) {
-		if (mousebind->button == button) {
-			mousebind->pressed_in_context = false;
+	binds = mousebind_lookup_button(button);
+	if (binds) {
+		wl_array_for_each(bind, binds) {
+			(*bind)->pressed_in_context = false;
 		}
 	}
 	return consumed_by_frame_context;
@@ -893,17 +1072,17 @@ handle_press_mousebinding(struct server *server, struct cursor_context *ctx,
 		return false;
 	}
 
-	struct mousebind *mousebind;
+	struct mousebind **bind;
 	bool double_click = is_double_click(rc.doubleclick_time, button, ctx);
 	bool consumed_by_frame_context = false;
 
 	uint32_t modifiers = wlr_keyboard_get_modifiers(
 			&server->seat.keyboard_group->keyboard);
 
-	wl_list_for_each(mousebind, &rc.mousebinds, link) {
-		if (ssd_part_contains(mousebind->context, ctx->type)
-				&& mousebind->button == button
-				&& modifiers == mousebind->modifiers) {
+	struct wl_array *binds = mousebind_lookup(ctx->type, button, modifiers);
+	if (binds) {
+		wl_array_for_each(bind, binds) {
+			struct mousebind *mousebind = *bind;
 			switch (mousebind->mouse_event) {
 			case MOUSE_ACTION_DRAG: /* fallthrough */
 			case MOUSE_ACTION_CLICK:
@@ -975,14 +1154,14 @@ cursor_button_press(struct seat *seat, uint32_t button,
 	 * the Focus action (used for normal views) does not work.
 	 */
 	if (ctx.type == LAB_SSD_LAYER_SURFACE) {
-		wlr_log(WLR_DEBUG, "press on layer-surface");
+		lab_log_debug("press on layer-surface");
 		struct wlr_layer_surface_v1 *layer =
 			wlr_layer_surface_v1_try_from_wlr_surface(ctx.surface);
 		if (layer && layer->current.keyboard_interactive) {
 			layer_try_set_focus(seat, layer);
 		}
 	} else if (ctx.type == LAB_SSD_LAYER_SUBSURFACE) {
-		wlr_log(WLR_DEBUG, "press on layer-subsurface");
+		lab_log_debug("press on layer-subsurface");
 		struct wlr_layer_surface_v1 *layer =
 			subsurface_parent_layer(ctx.surface);
 		if (layer && layer->current.keyboard_interactive) {
@@ -1088,6 +1267,8 @@ cursor_button(struct wl_listener *listener, void *data)
 	struct seat *seat = wl_container_of(listener, seat, cursor_button);
 	struct wlr_pointer_button_event *event = data;
 	idle_manager_notify_activity(seat->seat);
+	latency_input_event(&event->pointer->base, event->time_msec);
+	cursor_flush_motion(seat);
 
 	switch (event->state) {
 	case WLR_BUTTON_PRESSED:
@@ -1113,7 +1294,7 @@ cursor_emulate_move_absolute(struct seat *seat, struct wlr_input_device *device,
 	double dy = ly - seat->cursor->y;
 
 	if (!dx && !dy) {
-		wlr_log(WLR_DEBUG, "dropping useless cursor_emulate: %.10f,%.10f", dx, dy);
+		lab_log_debug("dropping useless cursor_emulate: %.10f,%.10f", dx, dy);
 		return;
 	}
 
@@ -1122,7 +1303,12 @@ cursor_emulate_move_absolute(struct seat *seat, struct wlr_input_device *device,
 		seat->seat, (uint64_t)time_msec * 1000,
 		dx, dy, dx, dy);
 
+	flush_axis(seat);
 	wlr_cursor_move(seat->cursor, device, dx, dy);
+	/* Tablets report at several hundred Hz, so this matters here too */
+	if (defer_motion(seat, time_msec)) {
+		return;
+	}
 	process_cursor_motion(seat->server, time_msec);
 	wlr_seat_pointer_notify_frame(seat->seat);
 }
@@ -1132,6 +1318,7 @@ cursor_emulate_button(struct seat *seat, uint32_t button,
 		enum wlr_button_state state, uint32_t time_msec)
 {
 	idle_manager_notify_activity(seat->seat);
+	cursor_flush_motion(seat);
 
 	switch (state) {
 	case WLR_BUTTON_PRESSED:
@@ -1179,7 +1366,7 @@ static bool
 handle_cursor_axis(struct server *server, struct cursor_context *ctx,
 		struct wlr_pointer_axis_event *event)
 {
-	struct mousebind *mousebind;
+	struct mousebind **bind;
 	bool handled = false;
 
 	uint32_t modifiers = wlr_keyboard_get_modifiers(
@@ -1208,19 +1395,96 @@ handle_cursor_axis(struct server *server, struct cursor_context *ctx,
 		return false;
 	}
 
-	wl_list_for_each(mousebind, &rc.mousebinds, link) {
-		if (ssd_part_contains(mousebind->context, ctx->type)
-				&& mousebind->direction == direction
-				&& modifiers == mousebind->modifiers
-				&& mousebind->mouse_event == MOUSE_ACTION_SCROLL) {
+	struct wl_array *binds =
+		mousebind_lookup_scroll(ctx->type, direction, modifiers);
+	if (binds) {
+		wl_array_for_each(bind, binds) {
 			handled = true;
-			actions_run(ctx->view, server, &mousebind->actions, /*resize_edges*/ 0);
+			actions_run(ctx->view, server, &(*bind)->actions,
+				/*resize_edges*/ 0);
 		}
 	}
 
 	return handled;
 }
 
+static bool
+axis_is_pending(struct seat *seat)
+{
+	return seat->axis_pending[WLR_AXIS_ORIENTATION_VERTICAL].pending
+		|| seat->axis_pending[WLR_AXIS_ORIENTATION_HORIZONTAL].pending;
+}
+
+static void
+flush_axis(struct seat *seat)
+{
+	if (!axis_is_pending(seat)) {
+		return;
+	}
+	struct wlr_surface *focused = seat->seat->pointer_state.focused_surface;
+	for (size_t i = 0; i < ARRAY_SIZE(seat->axis_pending); i++) {
+		struct pending_axis *pending = &seat->axis_pending[i];
+		if (!pending->pending) {
+			continue;
+		}
+		pending->pending = false;
+		if (pending->surface != focused) {
+			continue;
+		}
+		wlr_seat_pointer_notify_axis(seat->seat, pending->time_msec, i,
+			rc.scroll_factor * pending->delta,
+			round(rc.scroll_factor * pending->delta_discrete),
+			pending->source);
+	}
+	/* The frame event of the device was held back, see cursor_frame() */
+	wlr_seat_pointer_notify_frame(seat->seat);
+}
+
+/*
+ * With <mouse><coalesceMotion>, axis events for clients are summed up
+ * and sent once per output frame like pointer motion. High resolution
+ * wheels and touchpads report many small deltas, so this saves a lot of
+ * client wakeups while scrolling. Returns false if @event has to be sent
+ * right away, e.g. because it marks the end of a scroll sequence.
+ */
+static bool
+queue_axis(struct seat *seat, struct wlr_pointer_axis_event *event)
+{
+	if (!rc.coalesce_motion || event->delta == 0.0) {
+		return false;
+	}
+	struct wlr_output *output = wlr_output_layout_output_at(
+		seat->server->output_layout, seat->cursor->x, seat->cursor->y);
+	if (!output) {
+		return false;
+	}
+
+	/* Deltas from another source or for another surface go first */
+	struct wlr_surface *focused = seat->seat->pointer_state.focused_surface;
+	for (size_t i = 0; i < ARRAY_SIZE(seat->axis_pending); i++) {
+		struct pending_axis *pending = &seat->axis_pending[i];
+		if (pending->pending && (pending->source != event->source
+				|| pending->surface != focused)) {
+			flush_axis(seat);
+			break;
+		}
+	}
+
+	struct pending_axis *pending = &seat->axis_pending[event->orientation];
+	if (!pending->pending) {
+		*pending = (struct pending_axis){
+			.pending = true,
+			.source = event->source,
+			.surface = focused,
+		};
+	}
+	pending->time_msec = event->time_msec;
+	pending->delta += event->delta;
+	pending->delta_discrete += event->delta_discrete;
+	wlr_output_schedule_frame(output);
+	return true;
+}
+
 static void
 cursor_axis(struct wl_listener *listener, void *data)
 {
@@ -1231,8 +1495,29 @@ cursor_axis(struct wl_listener *listener, void *data)
 	struct seat *seat = wl_container_of(listener, seat, cursor_axis);
 	struct wlr_pointer_axis_event *event = data;
 	struct server *server = seat->server;
+	/* Pending axis events are combined with this one, if possible */
+	flush_pending_motion(seat);
 	struct cursor_context ctx = get_cursor_context(server);
 	idle_manager_notify_activity(seat->seat);
+	latency_input_event(&event->pointer->base, event->time_msec);
+
+	if (ctx.type == LAB_SSD_MENU) {
+		flush_axis(seat);
+		/* Scroll menus which don't fit on the output */
+		if (event->orientation == WLR_AXIS_ORIENTATION_VERTICAL) {
+			int rel = compare_delta(event,
+				&server->seat.smooth_scroll_offset.y);
+			if (rel) {
+				menu_process_scroll(ctx.node, rel);
+				/* Hover the item now under the cursor */
+				ctx = get_cursor_context(server);
+				if (ctx.type == LAB_SSD_MENU) {
+					menu_process_cursor_motion(ctx.node);
+				}
+			}
+		}
+		return;
+	}
 
 	/* Bindings swallow mouse events if activated */
 	bool handled = handle_cursor_axis(server, &ctx, event);
@@ -1241,11 +1526,18 @@ cursor_axis(struct wl_listener *listener, void *data)
 		/* Make sure we are sending the events to the surface under the cursor */
 		cursor_update_common(server, &ctx, event->time_msec, false);
 
+		if (queue_axis(seat, event)) {
+			return;
+		}
+		flush_axis(seat);
+
 		/* Notify the client with pointer focus of the axis event. */
 		wlr_seat_pointer_notify_axis(seat->seat, event->time_msec,
 			event->orientation, rc.scroll_factor * event->delta,
 			round(rc.scroll_factor * event->delta_discrete),
 			event->source);
+	} else {
+		flush_axis(seat);
 	}
 }
 
@@ -1260,10 +1552,27 @@ cursor_frame(struct wl_listener *listener, void *data)
 	 * between.
 	 */
 	struct seat *seat = wl_container_of(listener, seat, cursor_frame);
+
+	/* Sent along with the motion or axis events once they are processed */
+	if (seat->motion_pending || axis_is_pending(seat)) {
+		return;
+	}
+
 	/* Notify the client with pointer focus of the frame event. */
 	wlr_seat_pointer_notify_frame(seat->seat);
 }
 
+void
+cursor_load_output_scales(struct seat *seat)
+{
+	/* Does nothing for scales which are already loaded */
+	struct output *output;
+	wl_list_for_each(output, &seat->server->outputs, link) {
+		wlr_xcursor_manager_load(seat->xcursor_manager,
+			output->wlr_output->scale);
+	}
+}
+
 static void
 cursor_load(struct seat *seat)
 {
@@ -1271,11 +1580,32 @@ cursor_load(struct seat *seat)
 	const char *xcursor_size = getenv("XCURSOR_SIZE");
 	uint32_t size = xcursor_size ? atoi(xcursor_size) : 24;
 
+	/*
+	 * Loading a theme reads all its cursor files for each scale, so
+	 * keep the loaded one across reconfigures unless it changed.
+	 */
+	bool same_theme = xcursor_theme && loaded_xcursor_theme
+		? !strcmp(xcursor_theme, loaded_xcursor_theme)
+		: xcursor_theme == loaded_xcursor_theme;
+	if (seat->xcursor_manager && same_theme
+			&& size == loaded_xcursor_size) {
+		cursor_load_output_scales(seat);
+		return;
+	}
 	if (seat->xcursor_manager) {
 		wlr_xcursor_manager_destroy(seat->xcursor_manager);
 	}
 	seat->xcursor_manager = wlr_xcursor_manager_create(xcursor_theme, size);
+	zfree(loaded_xcursor_theme);
+	loaded_xcursor_theme = xcursor_theme ? xstrdup(xcursor_theme) : NULL;
+	loaded_xcursor_size = size;
+
+	/*
+	 * Load the scales of all outputs up front, rather than lazily
+	 * when the cursor first enters an output with another scale.
+	 */
 	wlr_xcursor_manager_load(seat->xcursor_manager, 1);
+	cursor_load_output_scales(seat);
 
 	/*
 	 * Wlroots provides integrated fallback cursor icons using
@@ -1314,6 +1644,8 @@ void
 cursor_reload(struct seat *seat)
 {
 	cursor_load(seat);
+	/* The theme or size may have changed */
+	seat->cursor_image_key = 0;
 	cursor_update_image(seat);
 }
 
@@ -1371,6 +1703,8 @@ void cursor_finish(struct seat *seat)
 {
 	/* TODO: either clean up all the listeners or none of them */
 
+	defer_cancel(&seat->focus_update);
+
 	wl_list_remove(&seat->cursor_motion.link);
 	wl_list_remove(&seat->cursor_motion_absolute.link);
 	wl_list_remove(&seat->cursor_button.link);
@@ -1385,6 +1719,8 @@ void cursor_finish(struct seat *seat)
 	wl_list_remove(&seat->request_set_selection.link);
 
 	wlr_xcursor_manager_destroy(seat->xcursor_manager);
+	seat->xcursor_manager = NULL;
+	zfree(loaded_xcursor_theme);
 	wlr_cursor_destroy(seat->cursor);
 
 	dnd_finish(seat);
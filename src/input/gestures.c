@@ -1,7 +1,9 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include <wlr/types/wlr_pointer_gestures_v1.h>
+#include "config/rcxml.h"
 #include "input/gestures.h"
 #include "labwc.h"
+#include "workspaces.h"
 
 static void
 handle_pointer_pinch_begin(struct wl_listener *listener, void *data)
@@ -36,6 +38,15 @@ handle_pointer_swipe_begin(struct wl_listener *listener, void *data)
 {
 	struct seat *seat = wl_container_of(listener, seat, swipe_begin);
 	struct wlr_pointer_swipe_begin_event *event = data;
+
+	/* Swipes with the configured number of fingers are ours */
+	seat->swipe_switches_workspace = rc.workspace_config.swipe_fingers
+		&& event->fingers == (uint32_t)rc.workspace_config.swipe_fingers
+		&& seat->server->input_mode == LAB_INPUT_STATE_PASSTHROUGH
+		&& workspaces_swipe_begin(seat->server);
+	if (seat->swipe_switches_workspace) {
+		return;
+	}
 	wlr_pointer_gestures_v1_send_swipe_begin(seat->pointer_gestures,
 		seat->seat, event->time_msec, event->fingers);
 }
@@ -45,6 +56,10 @@ handle_pointer_swipe_update(struct wl_listener *listener, void *data)
 {
 	struct seat *seat = wl_container_of(listener, seat, swipe_update);
 	struct wlr_pointer_swipe_update_event *event = data;
+	if (seat->swipe_switches_workspace) {
+		workspaces_swipe_update(seat->server, event->dx);
+		return;
+	}
 	wlr_pointer_gestures_v1_send_swipe_update(seat->pointer_gestures,
 		seat->seat, event->time_msec, event->dx, event->dy);
 }
@@ -54,6 +69,11 @@ handle_pointer_swipe_end(struct wl_listener *listener, void *data)
 {
 	struct seat *seat = wl_container_of(listener, seat, swipe_end);
 	struct wlr_pointer_swipe_end_event *event = data;
+	if (seat->swipe_switches_workspace) {
+		seat->swipe_switches_workspace = false;
+		workspaces_swipe_end(seat->server, event->cancelled);
+		return;
+	}
 	wlr_pointer_gestures_v1_send_swipe_end(seat->pointer_gestures,
 		seat->seat, event->time_msec, event->cancelled);
 }
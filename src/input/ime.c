@@ -207,17 +207,47 @@ update_popup_position(struct input_method_relay *relay)
 	} else {
 		cursor_rect = (struct wlr_box){0};
 	}
-
-	struct output *output =
-		output_nearest_to(server, cursor_rect.x, cursor_rect.y);
-	if (!output_is_usable(output)) {
-		wlr_log(WLR_ERROR,
-			"Cannot position IME popup (unusable output)");
+	int width = relay->popup_surface->surface->current.width;
+	int height = relay->popup_surface->surface->current.height;
+
+	/* Input methods commit at keystroke rate, mostly without any change */
+	struct wlr_box *output_box = &relay->popup_placement.output_box;
+	bool same_layout = relay->popup_placement.valid
+		&& relay->popup_placement.usable_area_generation
+			== server->usable_area_generation;
+	if (same_layout
+			&& relay->popup_placement.focused_surface
+				== relay->focused_surface
+			&& wlr_box_equal(&relay->popup_placement.cursor_rect,
+				&cursor_rect)
+			&& relay->popup_placement.width == width
+			&& relay->popup_placement.height == height) {
+		/* Trees created since then may have ended up above it */
+		wlr_scene_node_raise_to_top(&relay->popup_tree->node);
 		return;
 	}
-	struct wlr_box output_box;
-	wlr_output_layout_get_box(
-		server->output_layout, output->wlr_output, &output_box);
+
+	/* The output only has to be looked up again if the cursor left it */
+	if (!same_layout || !wlr_box_contains_point(output_box,
+			cursor_rect.x, cursor_rect.y)) {
+		struct output *output =
+			output_nearest_to(server, cursor_rect.x, cursor_rect.y);
+		if (!output_is_usable(output)) {
+			wlr_log(WLR_ERROR,
+				"Cannot position IME popup (unusable output)");
+			relay->popup_placement.valid = false;
+			return;
+		}
+		wlr_output_layout_get_box(server->output_layout,
+			output->wlr_output, output_box);
+	}
+	relay->popup_placement.valid = true;
+	relay->popup_placement.focused_surface = relay->focused_surface;
+	relay->popup_placement.cursor_rect = cursor_rect;
+	relay->popup_placement.width = width;
+	relay->popup_placement.height = height;
+	relay->popup_placement.usable_area_generation =
+		server->usable_area_generation;
 
 	/* Use xdg-positioner utilities to position popup */
 	struct wlr_xdg_positioner_rules rules = {
@@ -225,8 +255,8 @@ update_popup_position(struct input_method_relay *relay)
 		.anchor = XDG_POSITIONER_ANCHOR_BOTTOM_LEFT,
 		.gravity = XDG_POSITIONER_GRAVITY_BOTTOM_RIGHT,
 		.size = {
-			.width = relay->popup_surface->surface->current.width,
-			.height = relay->popup_surface->surface->current.height,
+			.width = width,
+			.height = height,
 		},
 		.constraint_adjustment =
 			XDG_POSITIONER_CONSTRAINT_ADJUSTMENT_FLIP_Y
@@ -235,7 +265,7 @@ update_popup_position(struct input_method_relay *relay)
 
 	struct wlr_box popup_box;
 	wlr_xdg_positioner_rules_get_geometry(&rules, &popup_box);
-	wlr_xdg_positioner_rules_unconstrain_box(&rules, &output_box, &popup_box);
+	wlr_xdg_positioner_rules_unconstrain_box(&rules, output_box, &popup_box);
 
 	wlr_scene_node_set_position(
 		&relay->popup_tree->node, popup_box.x, popup_box.y);
@@ -348,6 +378,7 @@ handle_popup_surface_destroy(struct wl_listener *listener, void *data)
 	wl_list_remove(&relay->popup_surface_commit.link);
 	relay->popup_surface = NULL;
 	relay->popup_tree = NULL;
+	relay->popup_placement.valid = false;
 }
 
 static void
@@ -1,75 +1,91 @@
 // SPDX-License-Identifier: GPL-2.0-only
+#include <linux/input-event-codes.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
 #include <wlr/util/log.h>
 #include "input/key-state.h"
 
-#define MAX_PRESSED_KEYS (16)
+/*
+ * Sets of evdev keycodes, which are all below KEY_CNT (768). Adding,
+ * removing and testing a key is a single bit operation, independent of
+ * how many keys are held down.
+ */
+#define KEYSET_WORDS ((KEY_CNT + 63) / 64)
 
-struct key_array {
-	uint32_t keys[MAX_PRESSED_KEYS];
-	int nr_keys;
+/* Like the key array of wlr_keyboard (WLR_KEYBOARD_KEYS_CAP) */
+#define MAX_PRESSED_SENT_KEYS (32)
+
+struct keyset {
+	uint64_t words[KEYSET_WORDS];
 };
 
-static struct key_array pressed, pressed_mods, bound, pressed_sent;
+static struct keyset pressed, pressed_mods, bound;
+static uint32_t pressed_sent[MAX_PRESSED_SENT_KEYS];
+static int nr_pressed_sent;
 
-static void
-report(struct key_array *array, const char *msg)
+static bool
+key_present(struct keyset *set, uint32_t keycode)
 {
-	static char *should_print;
-	static bool has_run;
-
-	if (!has_run) {
-		should_print = getenv("LABWC_DEBUG_KEY_STATE");
-		has_run = true;
+	if (keycode >= KEY_CNT) {
+		return false;
 	}
-	if (!should_print) {
-		return;
+	return set->words[keycode / 64] & (1ull << (keycode % 64));
+}
+
+static void
+remove_key(struct keyset *set, uint32_t keycode)
+{
+	if (keycode < KEY_CNT) {
+		set->words[keycode / 64] &= ~(1ull << (keycode % 64));
 	}
-	printf("%s", msg);
-	for (int i = 0; i < array->nr_keys; ++i) {
-		printf("%d,", array->keys[i]);
+}
+
+static void
+add_key(struct keyset *set, uint32_t keycode)
+{
+	if (keycode < KEY_CNT) {
+		set->words[keycode / 64] |= 1ull << (keycode % 64);
 	}
-	printf("\n");
 }
 
-static bool
-key_present(struct key_array *array, uint32_t keycode)
+static int
+count_keys(struct keyset *set)
 {
-	for (int i = 0; i < array->nr_keys; ++i) {
-		if (array->keys[i] == keycode) {
-			return true;
-		}
+	int count = 0;
+	for (int i = 0; i < KEYSET_WORDS; ++i) {
+		count += __builtin_popcountll(set->words[i]);
 	}
-	return false;
+	return count;
 }
 
-static void
-remove_key(struct key_array *array, uint32_t keycode)
+static bool
+should_report(void)
 {
-	bool shifting = false;
+	static char *should_print;
+	static bool has_run;
 
-	for (int i = 0; i < MAX_PRESSED_KEYS; ++i) {
-		if (array->keys[i] == keycode) {
-			--array->nr_keys;
-			shifting = true;
-		}
-		if (shifting) {
-			array->keys[i] = i < MAX_PRESSED_KEYS - 1
-				? array->keys[i + 1] : 0;
-		}
+	if (!has_run) {
+		should_print = getenv("LABWC_DEBUG_KEY_STATE");
+		has_run = true;
 	}
+	return should_print;
 }
 
 static void
-add_key(struct key_array *array, uint32_t keycode)
+report(struct keyset *set, const char *msg)
 {
-	if (!key_present(array, keycode) && array->nr_keys < MAX_PRESSED_KEYS) {
-		array->keys[array->nr_keys++] = keycode;
+	if (!should_report()) {
+		return;
+	}
+	printf("%s", msg);
+	for (uint32_t keycode = 0; keycode < KEY_CNT; ++keycode) {
+		if (key_present(set, keycode)) {
+			printf("%d,", keycode);
+		}
 	}
+	printf("\n");
 }
 
 uint32_t *
@@ -79,20 +95,32 @@ key_state_pressed_sent_keycodes(void)
 	report(&bound, "before - bound:");
 
 	/* pressed_sent = pressed - bound */
-	pressed_sent = pressed;
-	for (int i = 0; i < bound.nr_keys; ++i) {
-		remove_key(&pressed_sent, bound.keys[i]);
+	nr_pressed_sent = 0;
+	for (int i = 0; i < KEYSET_WORDS; ++i) {
+		uint64_t word = pressed.words[i] & ~bound.words[i];
+		while (word && nr_pressed_sent < MAX_PRESSED_SENT_KEYS) {
+			pressed_sent[nr_pressed_sent++] =
+				i * 64 + __builtin_ctzll(word);
+			/* Clear the lowest set bit */
+			word &= word - 1;
+		}
 	}
 
-	report(&pressed_sent, "after - pressed_sent:");
+	if (should_report()) {
+		printf("after - pressed_sent:");
+		for (int i = 0; i < nr_pressed_sent; ++i) {
+			printf("%d,", pressed_sent[i]);
+		}
+		printf("\n");
+	}
 
-	return pressed_sent.keys;
+	return pressed_sent;
 }
 
 int
 key_state_nr_pressed_sent_keycodes(void)
 {
-	return pressed_sent.nr_keys;
+	return nr_pressed_sent;
 }
 
 void
@@ -119,8 +147,8 @@ key_state_store_pressed_key_as_bound(uint32_t keycode)
 	 * a modifier key that was part of a keybinding (e.g. Firefox
 	 * displays its menu bar for a lone Alt press + release).
 	 */
-	for (int i = 0; i < pressed_mods.nr_keys; ++i) {
-		add_key(&bound, pressed_mods.keys[i]);
+	for (int i = 0; i < KEYSET_WORDS; ++i) {
+		bound.words[i] |= pressed_mods.words[i];
 	}
 }
 
@@ -139,11 +167,11 @@ key_state_bound_key_remove(uint32_t keycode)
 int
 key_state_nr_bound_keys(void)
 {
-	return bound.nr_keys;
+	return count_keys(&bound);
 }
 
 int
 key_state_nr_pressed_keys(void)
 {
-	return pressed.nr_keys;
+	return count_keys(&pressed);
 }
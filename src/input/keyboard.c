@@ -2,14 +2,21 @@
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wlr/backend/multi.h>
 #include <wlr/backend/session.h>
 #include <wlr/interfaces/wlr_keyboard.h>
 #include "action.h"
+#include "common/buf.h"
+#include "common/log.h"
+#include "common/macros.h"
+#include "common/mem.h"
+#include "common/trace.h"
 #include "idle.h"
 #include "input/ime.h"
 #include "input/keyboard.h"
 #include "input/key-state.h"
+#include "input/latency.h"
 #include "labwc.h"
 #include "menu/menu.h"
 #include "osd.h"
@@ -108,38 +115,12 @@ keyboard_modifiers_notify(struct wl_listener *listener, void *data)
 	}
 }
 
-static struct keybind *
-match_keybinding_for_sym(struct server *server, uint32_t modifiers,
-		xkb_keysym_t sym, xkb_keycode_t xkb_keycode)
+static bool
+keybinds_inhibited(struct server *server)
 {
-	struct keybind *keybind;
-	wl_list_for_each(keybind, &rc.keybinds, link) {
-		if (modifiers ^ keybind->modifiers) {
-			continue;
-		}
-		if (server->seat.nr_inhibited_keybind_views
-				&& server->active_view
-				&& server->active_view->inhibits_keybinds
-				&& !actions_contain_toggle_keybinds(&keybind->actions)) {
-			continue;
-		}
-		if (sym == XKB_KEY_NoSymbol) {
-			/* Use keycodes */
-			for (size_t i = 0; i < keybind->keycodes_len; i++) {
-				if (keybind->keycodes[i] == xkb_keycode) {
-					return keybind;
-				}
-			}
-		} else {
-			/* Use syms */
-			for (size_t i = 0; i < keybind->keysyms_len; i++) {
-				if (xkb_keysym_to_lower(sym) == keybind->keysyms[i]) {
-					return keybind;
-				}
-			}
-		}
-	}
-	return NULL;
+	return server->seat.nr_inhibited_keybind_views
+		&& server->active_view
+		&& server->active_view->inhibits_keybinds;
 }
 
 /*
@@ -168,38 +149,57 @@ match_keybinding_for_sym(struct server *server, uint32_t modifiers,
  * the raw keysym fallback.
  */
 static struct keybind *
-match_keybinding(struct server *server, struct keyinfo *keyinfo,
-		bool is_virtual)
+match_keybinding(struct server *server, struct wlr_keyboard *wlr_keyboard,
+		struct keyinfo *keyinfo, bool is_virtual)
 {
+	bool inhibited = keybinds_inhibited(server);
 	if (is_virtual) {
 		goto process_syms;
 	}
 
+	/*
+	 * Most key presses, e.g. plain typing, cannot match any keybind.
+	 * Virtual keyboards have their own keymaps which the prefilter
+	 * does not cover.
+	 */
+	if (!keybind_may_match(keyinfo->modifiers, keyinfo->xkb_keycode)) {
+		return NULL;
+	}
+
 	/* First try keycodes */
-	struct keybind *keybind = match_keybinding_for_sym(server,
-		keyinfo->modifiers, XKB_KEY_NoSymbol, keyinfo->xkb_keycode);
+	struct keybind *keybind = keybind_lookup(keyinfo->modifiers,
+		XKB_KEY_NoSymbol, keyinfo->xkb_keycode, inhibited);
 	if (keybind) {
-		wlr_log(WLR_DEBUG, "keycode matched");
+		lab_log_debug("keycode matched");
 		return keybind;
 	}
 
 process_syms:
 	/* Then fall back to keysyms */
 	for (int i = 0; i < keyinfo->translated.nr_syms; i++) {
-		keybind = match_keybinding_for_sym(server, keyinfo->modifiers,
-			keyinfo->translated.syms[i], keyinfo->xkb_keycode);
+		keybind = keybind_lookup(keyinfo->modifiers,
+			keyinfo->translated.syms[i], keyinfo->xkb_keycode,
+			inhibited);
 		if (keybind) {
-			wlr_log(WLR_DEBUG, "translated keysym matched");
+			lab_log_debug("translated keysym matched");
 			return keybind;
 		}
 	}
 
-	/* And finally test for keysyms without modifier */
+	/*
+	 * And finally test for keysyms without modifier. For example, get
+	 * Shift+1 rather than Shift+! (with US keyboard layout).
+	 */
+	xkb_layout_index_t layout_index = xkb_state_key_get_layout(
+		wlr_keyboard->xkb_state, keyinfo->xkb_keycode);
+	keyinfo->raw.nr_syms = xkb_keymap_key_get_syms_by_level(
+		wlr_keyboard->keymap, keyinfo->xkb_keycode, layout_index, 0,
+		&keyinfo->raw.syms);
 	for (int i = 0; i < keyinfo->raw.nr_syms; i++) {
-		keybind = match_keybinding_for_sym(server, keyinfo->modifiers,
-			keyinfo->raw.syms[i], keyinfo->xkb_keycode);
+		keybind = keybind_lookup(keyinfo->modifiers,
+			keyinfo->raw.syms[i], keyinfo->xkb_keycode, inhibited);
 		if (keybind) {
-			wlr_log(WLR_DEBUG, "raw keysym matched");
+			lab_log_debug("raw keysym matched");
 			return keybind;
 		}
 	}
@@ -239,16 +239,7 @@ get_keyinfo(struct wlr_keyboard *wlr_keyboard, uint32_t evdev_keycode)
 		wlr_keyboard->xkb_state, keyinfo.xkb_keycode,
 		&keyinfo.translated.syms);
 
-	/*
-	 * Get keysyms from the keyboard as if there was no modifier
-	 * translations. For example, get Shift+1 rather than Shift+!
-	 * (with US keyboard layout).
-	 */
-	xkb_layout_index_t layout_index = xkb_state_key_get_layout(
-		wlr_keyboard->xkb_state, keyinfo.xkb_keycode);
-	keyinfo.raw.nr_syms = xkb_keymap_key_get_syms_by_level(
-		wlr_keyboard->keymap, keyinfo.xkb_keycode, layout_index, 0,
-		&keyinfo.raw.syms);
+	/* Raw keysyms are only looked up by match_keybinding() */
 
 	/*
 	 * keyboard_key_notify() is called before keyboard_key_modifier(),
@@ -353,9 +344,17 @@ handle_menu_keys(struct server *server, struct keysyms *syms)
 			menu_close_root(server);
 			cursor_update_focus(server);
 			break;
-		default:
+		default: {
+			/* Printable characters jump to matching items */
+			char text[8];
+			if (xkb_keysym_to_utf8(syms->syms[i], text, sizeof(text)) > 1
+					&& (unsigned char)text[0] >= 0x20 && text[0] != 0x7f) {
+				menu_type_ahead(server, text);
+				break;
+			}
 			continue;
 		}
+		}
 		break;
 	}
 }
@@ -372,25 +371,39 @@ handle_cycle_view_key(struct server *server, struct keyinfo *keyinfo)
 		}
 	}
 
-	/* cycle to next */
-	if (!keyinfo->is_modifier) {
-		bool back_key = false;
+	if (keyinfo->is_modifier) {
+		return;
+	}
+
+	if (rc.window_switcher.filter) {
 		for (int i = 0; i < keyinfo->translated.nr_syms; i++) {
-			if (keyinfo->translated.syms[i] == XKB_KEY_Up
-					|| keyinfo->translated.syms[i] == XKB_KEY_Left) {
-				back_key = true;
-				break;
+			xkb_keysym_t sym = keyinfo->translated.syms[i];
+			if (sym == XKB_KEY_BackSpace) {
+				osd_filter_backspace(server);
+				return;
+			}
+			/* Printable characters narrow down the listed views */
+			char text[8];
+			if (xkb_keysym_to_utf8(sym, text, sizeof(text)) > 1
+					&& (unsigned char)text[0] >= 0x20
+					&& text[0] != 0x7f) {
+				osd_filter_append(server, text);
+				return;
 			}
 		}
-		bool backwards = (keyinfo->modifiers & WLR_MODIFIER_SHIFT) || back_key;
+	}
 
-		enum lab_cycle_dir dir = backwards
-			? LAB_CYCLE_DIR_BACKWARD
-			: LAB_CYCLE_DIR_FORWARD;
-		server->osd_state.cycle_view = desktop_cycle_view(server,
-			server->osd_state.cycle_view, dir);
-		osd_update(server);
+	/* cycle to next */
+	bool back_key = false;
+	for (int i = 0; i < keyinfo->translated.nr_syms; i++) {
+		if (keyinfo->translated.syms[i] == XKB_KEY_Up
+				|| keyinfo->translated.syms[i] == XKB_KEY_Left) {
+			back_key = true;
+			break;
+		}
 	}
+	bool backwards = (keyinfo->modifiers & WLR_MODIFIER_SHIFT) || back_key;
+	osd_cycle(server, !backwards);
 }
 
 static enum lab_key_handled
@@ -451,7 +464,8 @@ handle_compositor_keybindings(struct keyboard *keyboard,
 	 * Handle compositor keybinds
 	 */
 	struct keybind *keybind =
-		match_keybinding(server, &keyinfo, keyboard->is_virtual);
+		match_keybinding(server, wlr_keyboard, &keyinfo,
+			keyboard->is_virtual);
 	if (keybind) {
 		/*
 		 * Update key-state before action_run() because the action
@@ -517,12 +531,14 @@ keyboard_cancel_keybind_repeat(struct keyboard *keyboard)
 static void
 keyboard_key_notify(struct wl_listener *listener, void *data)
 {
+	TRACE_FUNC();
 	/* This event is raised when a key is pressed or released. */
 	struct keyboard *keyboard = wl_container_of(listener, keyboard, key);
 	struct seat *seat = keyboard->base.seat;
 	struct wlr_keyboard_key_event *event = data;
 	struct wlr_seat *wlr_seat = seat->seat;
 	idle_manager_notify_activity(seat->seat);
+	latency_input_event(&keyboard->wlr_keyboard->base, event->time_msec);
 
 	/* any new press/release cancels current keybind repeat */
 	keyboard_cancel_keybind_repeat(keyboard);
@@ -577,6 +593,11 @@ keyboard_update_layout(struct seat *seat, xkb_layout_index_t layout)
 {
 	assert(seat);
 
+	/* The group follows its members, nothing to do on most focus changes */
+	if (seat->keyboard_group->keyboard.modifiers.group == layout) {
+		return;
+	}
+
 	struct input *input;
 	struct keyboard *keyboard;
 	struct wlr_keyboard *kb = NULL;
@@ -617,18 +638,83 @@ reset_window_keyboard_layout_groups(struct server *server)
 	/*
 	 * Technically it would be possible to reconcile previous group indices
 	 * to new group ones if particular layouts exist in both old and new,
-	 * but let's keep it simple for now and just reset them all.
+	 * but let's keep it simple for now and just reset them all. Views
+	 * notice the new generation when they are activated next.
 	 */
-	struct view *view;
-	for_each_view(view, &server->views, LAB_VIEW_CRITERIA_NONE) {
-		view->keyboard_layout = 0;
-	}
+	server->seat.keyboard_layout_generation++;
 
-	struct view *active_view = server->active_view;
-	if (!active_view) {
+	if (!server->active_view) {
 		return;
 	}
-	keyboard_update_layout(&server->seat, active_view->keyboard_layout);
+	keyboard_update_layout(&server->seat, 0);
+}
+
+/*
+ * The keymap compiled from the XKB_DEFAULT_* environment variables is
+ * shared by the keyboard group and all physical keyboards. Compiling a
+ * keymap is expensive, so it is only redone when the variables change.
+ */
+static struct {
+	struct xkb_context *context;
+	struct xkb_keymap *keymap;
+	char *names; /* RMLVO the keymap was compiled from */
+} keymap_cache;
+
+static char *
+keymap_names_from_env(void)
+{
+	static const char * const vars[] = {
+		"XKB_DEFAULT_RULES",
+		"XKB_DEFAULT_MODEL",
+		"XKB_DEFAULT_LAYOUT",
+		"XKB_DEFAULT_VARIANT",
+		"XKB_DEFAULT_OPTIONS",
+	};
+	struct buf names = BUF_INIT;
+	for (size_t i = 0; i < ARRAY_SIZE(vars); i++) {
+		const char *value = getenv(vars[i]);
+		buf_add(&names, value ? value : "");
+		buf_add_char(&names, '\n');
+	}
+	return names.data;
+}
+
+/* Returns a borrowed reference, valid until the next call */
+static struct xkb_keymap *
+keymap_from_env(void)
+{
+	char *names = keymap_names_from_env();
+	if (keymap_cache.keymap && !strcmp(names, keymap_cache.names)) {
+		free(names);
+		return keymap_cache.keymap;
+	}
+
+	if (!keymap_cache.context) {
+		keymap_cache.context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+	}
+	struct xkb_rule_names rules = { 0 };
+	struct xkb_keymap *keymap = xkb_map_new_from_names(
+		keymap_cache.context, &rules, XKB_KEYMAP_COMPILE_NO_FLAGS);
+	if (!keymap) {
+		free(names);
+		return NULL;
+	}
+
+	xkb_keymap_unref(keymap_cache.keymap);
+	free(keymap_cache.names);
+	keymap_cache.keymap = keymap;
+	keymap_cache.names = names;
+	return keymap;
+}
+
+static void
+keymap_cache_finish(void)
+{
+	xkb_keymap_unref(keymap_cache.keymap);
+	xkb_context_unref(keymap_cache.context);
+	zfree(keymap_cache.names);
+	keymap_cache.keymap = NULL;
+	keymap_cache.context = NULL;
 }
 
 /*
@@ -640,16 +726,13 @@ set_layout(struct server *server, struct wlr_keyboard *kb)
 {
 	static bool fallback_mode;
 
-	struct xkb_rule_names rules = { 0 };
-	struct xkb_context *context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
-	struct xkb_keymap *keymap = xkb_map_new_from_names(context, &rules,
-		XKB_KEYMAP_COMPILE_NO_FLAGS);
+	struct xkb_keymap *keymap = keymap_from_env();
 	if (keymap) {
-		if (!wlr_keyboard_keymaps_match(kb->keymap, keymap)) {
+		if (kb->keymap != keymap
+				&& !wlr_keyboard_keymaps_match(kb->keymap, keymap)) {
 			wlr_keyboard_set_keymap(kb, keymap);
 			reset_window_keyboard_layout_groups(server);
 		}
-		xkb_keymap_unref(keymap);
 	} else {
 		wlr_log(WLR_ERROR, "failed to create xkb keymap for layout '%s'",
 			getenv("XKB_DEFAULT_LAYOUT"));
@@ -660,7 +743,6 @@ set_layout(struct server *server, struct wlr_keyboard *kb)
 			set_layout(server, kb);
 		}
 	}
-	xkb_context_unref(context);
 }
 
 void
@@ -706,4 +788,5 @@ keyboard_group_finish(struct seat *seat)
 		wlr_keyboard_group_destroy(seat->keyboard_group);
 		seat->keyboard_group = NULL;
 	}
+	keymap_cache_finish();
 }
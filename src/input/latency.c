@@ -0,0 +1,198 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/types/wlr_input_device.h>
+#include <wlr/types/wlr_output.h>
+#include "common/histogram.h"
+#include "common/list.h"
+#include "common/mem.h"
+#include "common/time-helpers.h"
+#include "debug.h"
+#include "flight-recorder.h"
+#include "input/latency.h"
+
+/* Ignore timestamps which are obviously not from CLOCK_MONOTONIC */
+#define MAX_EVENT_AGE_MSEC 10000
+
+/*
+ * Devices are identified by name so that statistics survive unplugging
+ * and reconnecting the same device.
+ */
+struct latency_device {
+	char *name;
+	enum wlr_input_device_type type;
+
+	/* Durations in microseconds from the input event */
+	struct histogram to_commit;
+	struct histogram to_present;
+
+	/* Oldest event not yet rendered */
+	int64_t pending_nsec;
+
+	/* Event rendered by the last commit of awaiting_output */
+	int64_t committed_nsec;
+	/* Only used for comparison, never dereferenced */
+	struct output *awaiting_output;
+
+	struct wl_list link;
+};
+
+static struct wl_list devices = { &devices, &devices };
+
+bool
+latency_tracing_enabled(void)
+{
+	static int enabled = -1;
+	if (enabled < 0) {
+		const char *env = getenv("LABWC_DEBUG_LATENCY");
+		enabled = env && strcmp(env, "0");
+	}
+	return enabled;
+}
+
+static struct latency_device *
+get_device(struct wlr_input_device *input)
+{
+	const char *name = input->name ? input->name : "unknown";
+	struct latency_device *device;
+	wl_list_for_each(device, &devices, link) {
+		if (device->type == input->type && !strcmp(device->name, name)) {
+			return device;
+		}
+	}
+	device = znew(*device);
+	device->name = xstrdup(name);
+	device->type = input->type;
+	wl_list_append(&devices, &device->link);
+	return device;
+}
+
+void
+latency_input_event(struct wlr_input_device *input, uint32_t time_msec)
+{
+	flight_record(FLIGHT_EVENT_INPUT, input ? input->type : 0, time_msec, 0);
+	if (!latency_tracing_enabled() || !input) {
+		return;
+	}
+
+	/*
+	 * Event timestamps are CLOCK_MONOTONIC milliseconds truncated to
+	 * 32 bits, so unsigned subtraction yields the age of the event.
+	 */
+	int64_t now = time_now_nsec();
+	uint32_t age_msec = (uint32_t)(now / 1000000) - time_msec;
+	if (age_msec > MAX_EVENT_AGE_MSEC) {
+		return;
+	}
+
+	struct latency_device *device = get_device(input);
+	if (!device->pending_nsec) {
+		device->pending_nsec = now - (int64_t)age_msec * 1000000;
+	}
+}
+
+void
+latency_output_commit(struct output *output)
+{
+	if (!latency_tracing_enabled()) {
+		return;
+	}
+	int64_t now = time_now_nsec();
+	struct latency_device *device;
+	wl_list_for_each(device, &devices, link) {
+		if (!device->pending_nsec) {
+			continue;
+		}
+		histogram_add(&device->to_commit,
+			nsec_to_usec(now - device->pending_nsec));
+		device->committed_nsec = device->pending_nsec;
+		device->awaiting_output = output;
+		device->pending_nsec = 0;
+	}
+}
+
+/*
+ * Only one page-flip is in flight per output and the next commit waits
+ * for its frame event, so the first presentation event following a
+ * commit belongs to that commit.
+ */
+void
+latency_output_present(struct output *output,
+		struct wlr_output_event_present *event)
+{
+	if (!latency_tracing_enabled()) {
+		return;
+	}
+	struct latency_device *device;
+	wl_list_for_each(device, &devices, link) {
+		if (device->awaiting_output != output) {
+			continue;
+		}
+		if (event->presented && event->when) {
+			histogram_add(&device->to_present, nsec_to_usec(
+				timespec_to_nsec(event->when)
+				- device->committed_nsec));
+		}
+		device->awaiting_output = NULL;
+		device->committed_nsec = 0;
+	}
+}
+
+void
+latency_output_destroy(struct output *output)
+{
+	struct latency_device *device;
+	wl_list_for_each(device, &devices, link) {
+		if (device->awaiting_output == output) {
+			device->awaiting_output = NULL;
+			device->committed_nsec = 0;
+		}
+	}
+}
+
+static const char *
+device_type_name(enum wlr_input_device_type type)
+{
+	switch (type) {
+	case WLR_INPUT_DEVICE_KEYBOARD:
+		return "keyboard";
+	case WLR_INPUT_DEVICE_POINTER:
+		return "pointer";
+	case WLR_INPUT_DEVICE_TOUCH:
+		return "touch";
+	case WLR_INPUT_DEVICE_TABLET_TOOL:
+		return "tablet";
+	default:
+		return "other";
+	}
+}
+
+void
+latency_dump(void)
+{
+	if (!latency_tracing_enabled()) {
+		return;
+	}
+	struct latency_device *device;
+	wl_list_for_each(device, &devices, link) {
+		printf(" %s (%s): input latency\n", device->name,
+			device_type_name(device->type));
+		debug_dump_histogram_header("usec");
+		debug_dump_histogram("to-commit", &device->to_commit);
+		debug_dump_histogram("to-present", &device->to_present);
+	}
+	printf("\n");
+}
+
+void
+latency_finish(void)
+{
+	struct latency_device *device, *tmp;
+	wl_list_for_each_safe(device, tmp, &devices, link) {
+		wl_list_remove(&device->link);
+		zfree(device->name);
+		zfree(device);
+	}
+}
@@ -9,6 +9,7 @@
 #include "common/mem.h"
 #include "config/rcxml.h"
 #include "input/cursor.h"
+#include "input/latency.h"
 #include "input/tablet.h"
 
 static void
@@ -68,6 +69,7 @@ handle_axis(struct wl_listener *listener, void *data)
 {
 	struct wlr_tablet_tool_axis_event *ev = data;
 	struct drawing_tablet *tablet = ev->tablet->data;
+	latency_input_event(&ev->tablet->base, ev->time_msec);
 	if (ev->updated_axes & (WLR_TABLET_TOOL_AXIS_X | WLR_TABLET_TOOL_AXIS_Y)) {
 		if (ev->updated_axes & WLR_TABLET_TOOL_AXIS_X) {
 			tablet->x = ev->x;
@@ -91,6 +93,7 @@ handle_tip(struct wl_listener *listener, void *data)
 {
 	struct wlr_tablet_tool_tip_event *ev = data;
 	struct drawing_tablet *tablet = ev->tablet->data;
+	latency_input_event(&ev->tablet->base, ev->time_msec);
 
 	uint32_t button = tablet_get_mapped_button(BTN_TOOL_PEN);
 	if (!button) {
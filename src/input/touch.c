@@ -5,36 +5,53 @@
 #include "common/mem.h"
 #include "common/scene-helpers.h"
 #include "idle.h"
+#include "input/latency.h"
 #include "input/touch.h"
 #include "labwc.h"
 #include "config/mousebind.h"
 #include "action.h"
+#include "surface-map.h"
 #include "view.h"
 
-/* Holds layout -> surface offsets to report motion events in relative coords */
+/*
+ * Holds the mapping from the device's [0, 1] range to surface coords, so
+ * that motion events are reported without converting coordinates through
+ * the cursor and output layout again. The mapping is resolved once when
+ * the touch point goes down and kept for its lifetime.
+ */
 struct touch_point {
 	int32_t touch_id;
-	uint32_t x_offset;
-	uint32_t y_offset;
+	double x_scale, y_scale;
+	double x_offset, y_offset;
 	struct wlr_surface *surface;
 	struct wl_list link; /* seat.touch_points */
 };
 
 static struct wlr_surface*
 touch_get_coords(struct seat *seat, struct wlr_touch *touch, double x, double y,
-		double *x_offset, double *y_offset)
+		struct touch_point *touch_point)
 {
-	/* Convert coordinates: first [0, 1] => layout, then layout => surface */
-	double lx, ly;
+	/*
+	 * The mapping of the device to the layout is a linear transform
+	 * which wlr_cursor does not expose, so derive it from two corners.
+	 */
+	double x0, y0, x1, y1;
+	wlr_cursor_absolute_to_layout_coords(seat->cursor, &touch->base,
+		0, 0, &x0, &y0);
 	wlr_cursor_absolute_to_layout_coords(seat->cursor, &touch->base,
-		x, y, &lx, &ly);
+		1, 1, &x1, &y1);
+	double lx = x0 + x * (x1 - x0);
+	double ly = y0 + y * (y1 - y0);
 
 	double sx, sy;
 	struct wlr_scene_node *node =
 		wlr_scene_node_at(&seat->server->scene->tree.node, lx, ly, &sx, &sy);
 
-	*x_offset = lx - sx;
-	*y_offset = ly - sy;
+	/* [0, 1] => layout => surface */
+	touch_point->x_scale = x1 - x0;
+	touch_point->y_scale = y1 - y0;
+	touch_point->x_offset = x0 - (lx - sx);
+	touch_point->y_offset = y0 - (ly - sy);
 
 	/* Find the surface and return it if it accepts touch events */
 	struct wlr_surface *surface = lab_wlr_surface_from_node(node);
@@ -51,21 +68,16 @@ touch_motion(struct wl_listener *listener, void *data)
 	struct seat *seat = wl_container_of(listener, seat, touch_motion);
 	struct wlr_touch_motion_event *event = data;
 	idle_manager_notify_activity(seat->seat);
+	latency_input_event(&event->touch->base, event->time_msec);
 
-	/* Find existing touch point to determine initial offsets to subtract */
 	struct touch_point *touch_point;
 	wl_list_for_each(touch_point, &seat->touch_points, link) {
 		if (touch_point->touch_id == event->touch_id) {
 			if (touch_point->surface) {
-				/* Convert coordinates: first [0, 1] => layout */
-				double lx, ly;
-				wlr_cursor_absolute_to_layout_coords(seat->cursor,
-					&event->touch->base, event->x, event->y, &lx, &ly);
-
-				/* Apply offsets to get surface coords before reporting event */
-				double sx = lx - touch_point->x_offset;
-				double sy = ly - touch_point->y_offset;
-
+				double sx = touch_point->x_offset
+					+ event->x * touch_point->x_scale;
+				double sy = touch_point->y_offset
+					+ event->y * touch_point->y_scale;
 				wlr_seat_touch_notify_motion(seat->seat, event->time_msec,
 					event->touch_id, sx, sy);
 			} else {
@@ -90,29 +102,24 @@ touch_down(struct wl_listener *listener, void *data)
 {
 	struct seat *seat = wl_container_of(listener, seat, touch_down);
 	struct wlr_touch_down_event *event = data;
+	latency_input_event(&event->touch->base, event->time_msec);
 
-	/* Compute layout => surface offset and save for this touch point */
+	/* Resolve the surface and coordinate mapping for this touch point */
 	struct touch_point *touch_point = znew(*touch_point);
-	double x_offset, y_offset;
 	touch_point->surface = touch_get_coords(seat, event->touch,
-			event->x, event->y, &x_offset, &y_offset);
+			event->x, event->y, touch_point);
 	touch_point->touch_id = event->touch_id;
-	touch_point->x_offset = x_offset;
-	touch_point->y_offset = y_offset;
 
 	wl_list_insert(&seat->touch_points, &touch_point->link);
 
 	if (touch_point->surface) {
-		/* Convert coordinates: first [0, 1] => layout */
-		double lx, ly;
-		wlr_cursor_absolute_to_layout_coords(seat->cursor,
-			&event->touch->base, event->x, event->y, &lx, &ly);
-
-		/* Apply offsets to get surface coords before reporting event */
-		double sx = lx - x_offset;
-		double sy = ly - y_offset;
+		double sx = touch_point->x_offset
+			+ event->x * touch_point->x_scale;
+		double sy = touch_point->y_offset
+			+ event->y * touch_point->y_scale;
 
-		struct view *view = view_from_wlr_surface(touch_point->surface);
+		struct view *view = surface_map_get_view(touch_point->surface,
+			NULL);
 		struct mousebind *mousebind;
 		wl_list_for_each(mousebind, &rc.mousebinds, link) {
 			if (mousebind->mouse_event == MOUSE_ACTION_PRESS
@@ -4,6 +4,7 @@
 #include "labwc.h"
 #include "regions.h"
 #include "resize_indicator.h"
+#include "scale-debounce.h"
 #include "snap.h"
 #include "view.h"
 #include "window-rules.h"
@@ -38,7 +39,8 @@ interactive_begin(struct view *view, enum input_mode mode, uint32_t edges)
 	}
 
 	/* Prevent moving/resizing fixed-position and panel-like views */
-	if (window_rules_get_property(view, "fixedPosition") == LAB_PROP_TRUE
+	if (window_rules_get_property(view,
+			LAB_WINDOW_RULE_PROP_FIXED_POSITION) == LAB_PROP_TRUE
 			|| view_has_strut_partial(view)) {
 		return;
 	}
@@ -122,12 +124,17 @@ interactive_begin(struct view *view, enum input_mode mode, uint32_t edges)
 	server->grab_y = seat->cursor->y;
 	server->grab_box = geometry;
 	server->resize_edges = edges;
+	server->resize_pending = false;
 	if (rc.resize_indicator) {
 		resize_indicator_show(view);
 	}
 	if (rc.window_edge_strength) {
 		edges_calculate_visibility(server, view);
 	}
+	edges_begin_session(view);
+	if (mode == LAB_INPUT_STATE_MOVE) {
+		scale_debounce_begin(view);
+	}
 }
 
 enum view_edge
@@ -221,15 +228,41 @@ interactive_finish(struct view *view)
 		return;
 	}
 
+	/* Snapping needs the output the view has been moved to */
+	view_flush_move_update(view->server);
 	if (view->server->input_mode == LAB_INPUT_STATE_MOVE) {
 		if (!snap_to_region(view)) {
 			snap_to_edge(view);
 		}
+	} else if (view->server->resize_pending) {
+		/* Make sure the final size is not lost while throttled */
+		view_move_resize(view, view->server->resize_pending_geo);
 	}
 
 	interactive_cancel(view);
 }
 
+/*
+ * Sends the resize geometry held back by process_cursor_resize() once the
+ * client has caught up with the previous configure. Called from the commit
+ * and configure-timeout handlers of xdg-shell and XWayland views.
+ */
+void
+interactive_resize_flush(struct view *view)
+{
+	struct server *server = view->server;
+	if (server->grabbed_view != view || !server->resize_pending
+			|| server->input_mode != LAB_INPUT_STATE_RESIZE) {
+		return;
+	}
+	if (view->pending_configure_timeout) {
+		/* Still waiting for the client */
+		return;
+	}
+	server->resize_pending = false;
+	view_move_resize(view, server->resize_pending_geo);
+}
+
 /*
  * Cancels interactive move/resize without changing the state of the of
  * the view in any way. This may leave the tiled state inconsistent with
@@ -242,12 +275,16 @@ interactive_cancel(struct view *view)
 		return;
 	}
 
+	view_flush_move_update(view->server);
+	scale_debounce_end(view);
 	overlay_hide(&view->server->seat);
 
 	resize_indicator_hide(view);
 
 	view->server->input_mode = LAB_INPUT_STATE_PASSTHROUGH;
 	view->server->grabbed_view = NULL;
+	view->server->resize_pending = false;
+	edges_end_session(view->server);
 
 	/* Update focus/cursor image */
 	cursor_update_focus(view->server);
@@ -13,6 +13,7 @@
 #include <strings.h>
 #include <wayland-server.h>
 #include <wlr/types/wlr_layer_shell_v1.h>
+#include <wlr/util/box.h>
 #include <wlr/util/log.h>
 #include "common/macros.h"
 #include "common/mem.h"
@@ -53,10 +54,30 @@ arrange_one_layer(const struct wlr_box *full_area, struct wlr_box *usable_area,
 	}
 }
 
+static void
+mark_layer_changed(struct output *output, enum zwlr_layer_shell_v1_layer layer)
+{
+	output->layers_changed |= 1u << layer;
+}
+
+static void
+mark_surface_changed(struct wlr_layer_surface_v1 *layer_surface)
+{
+	if (layer_surface->output) {
+		mark_layer_changed(layer_surface->output->data,
+			layer_surface->current.layer);
+	}
+}
+
 /*
  * To ensure outputs/views are left in a consistent state, this
  * function should be called ONLY from output_update_usable_area()
  * or output_update_all_usable_areas().
+ *
+ * Only layers marked in output->layers_changed are arranged, along with
+ * the layers whose area they affect: the exclusive-zone clients of the
+ * layers below, and all non-exclusive-zone clients if the final usable
+ * area changed.
  */
 void
 layers_arrange(struct output *output)
@@ -77,7 +98,27 @@ layers_arrange(struct output *output)
 		return;
 	}
 
-	for (int i = ARRAY_SIZE(output->layer_tree) - 1; i >= 0; i--) {
+	struct output_layers_cache *cache = &output->layers_cache;
+	uint32_t changed = output->layers_changed;
+	output->layers_changed = 0;
+	if (!changed || !wlr_box_equal(&full_area, &cache->full_area)
+			|| !wlr_box_equal(&usable_area, &cache->base_area)) {
+		changed = (1u << ARRAY_SIZE(output->layer_tree)) - 1;
+	}
+	cache->full_area = full_area;
+	cache->base_area = usable_area;
+
+	int top = ARRAY_SIZE(output->layer_tree) - 1;
+	while (!(changed & (1u << top))) {
+		top--;
+	}
+	int bottom = __builtin_ctz(changed);
+	if (top < (int)ARRAY_SIZE(output->layer_tree) - 1) {
+		usable_area = cache->usable_area[top + 1];
+	}
+	struct wlr_box old_usable_area = cache->usable_area[0];
+
+	for (int i = top; i >= 0; i--) {
 		struct wlr_scene_tree *layer = output->layer_tree[i];
 
 		/*
@@ -95,11 +136,26 @@ layers_arrange(struct output *output)
 		 * than the usable area.
 		 */
 		arrange_one_layer(&full_area, &usable_area, layer, /* exclusive */ true);
+
+		/*
+		 * Below the changed layers, exclusive-zone clients given
+		 * the same area as last time end up where they were.
+		 */
+		bool same = wlr_box_equal(&usable_area, &cache->usable_area[i]);
+		cache->usable_area[i] = usable_area;
+		if (same && i <= bottom) {
+			usable_area = cache->usable_area[0];
+			break;
+		}
 	}
 
+	bool usable_area_changed = !wlr_box_equal(&usable_area, &old_usable_area);
 	for (size_t i = 0; i < ARRAY_SIZE(output->layer_tree); i++) {
 		struct wlr_scene_tree *layer = output->layer_tree[i];
-		arrange_one_layer(&full_area, &usable_area, layer, /* exclusive */ false);
+		if (usable_area_changed || (changed & (1u << i))) {
+			arrange_one_layer(&full_area, &usable_area, layer,
+				/* exclusive */ false);
+		}
 
 		/* Set node position to account for output layout change */
 		wlr_scene_node_set_position(&layer->node, scene_output->x,
@@ -235,6 +291,27 @@ is_on_demand(struct wlr_layer_surface_v1 *layer_surface)
 		ZWLR_LAYER_SURFACE_V1_KEYBOARD_INTERACTIVITY_ON_DEMAND;
 }
 
+/*
+ * Clients of animated panels commit a new buffer every frame, often
+ * re-sending unchanged state along with it, so compare the state which
+ * affects the layout rather than relying on the committed bits.
+ */
+static bool
+layout_state_changed(const struct wlr_layer_surface_v1_state *old,
+		const struct wlr_layer_surface_v1_state *state)
+{
+	return state->anchor != old->anchor
+		|| state->exclusive_zone != old->exclusive_zone
+		|| state->margin.top != old->margin.top
+		|| state->margin.right != old->margin.right
+		|| state->margin.bottom != old->margin.bottom
+		|| state->margin.left != old->margin.left
+		|| state->desired_width != old->desired_width
+		|| state->desired_height != old->desired_height
+		|| state->layer != old->layer
+		|| state->keyboard_interactive != old->keyboard_interactive;
+}
+
 static void
 handle_surface_commit(struct wl_listener *listener, void *data)
 {
@@ -249,16 +326,33 @@ handle_surface_commit(struct wl_listener *listener, void *data)
 		return;
 	}
 
-	uint32_t committed = layer_surface->current.committed;
 	struct output *output = (struct output *)wlr_output->data;
+	struct wlr_layer_surface_v1_state *old = &layer->arranged_state;
+	struct wlr_layer_surface_v1_state *state = &layer_surface->current;
+	/*
+	 * Any committed state is still honoured before the surface is
+	 * mapped, so that the initial commit is always configured.
+	 */
+	bool changed = layout_state_changed(old, state)
+		|| (state->committed && !layer_surface->surface->mapped);
+	bool interactivity_changed =
+		state->keyboard_interactive != old->keyboard_interactive;
+	*old = *state;
 
 	/* Process layer change */
-	if (committed & WLR_LAYER_SURFACE_V1_STATE_LAYER) {
-		wlr_scene_node_reparent(&layer->scene_layer_surface->tree->node,
-			output->layer_tree[layer_surface->current.layer]);
+	struct wlr_scene_node *node = &layer->scene_layer_surface->tree->node;
+	struct wlr_scene_tree *layer_tree = output->layer_tree[state->layer];
+	if (node->parent != layer_tree) {
+		for (size_t i = 0; i < ARRAY_SIZE(output->layer_tree); i++) {
+			if (node->parent == output->layer_tree[i]) {
+				mark_layer_changed(output, i);
+			}
+		}
+		wlr_scene_node_reparent(node, layer_tree);
+		changed = true;
 	}
 	/* Process keyboard-interactivity change */
-	if (committed & WLR_LAYER_SURFACE_V1_STATE_KEYBOARD_INTERACTIVITY) {
+	if (interactivity_changed) {
 		/*
 		 * On-demand interactivity should only be honoured through
 		 * normal focus semantics (for example by surface receiving
@@ -282,8 +376,9 @@ handle_surface_commit(struct wl_listener *listener, void *data)
 	}
 out:
 
-	if (committed || layer->mapped != layer_surface->surface->mapped) {
+	if (changed || layer->mapped != layer_surface->surface->mapped) {
 		layer->mapped = layer_surface->surface->mapped;
+		mark_layer_changed(output, layer_surface->current.layer);
 		output_update_usable_area(output);
 		/*
 		 * Update cursor focus here to ensure we
@@ -320,6 +415,7 @@ handle_unmap(struct wl_listener *listener, void *data)
 	struct wlr_layer_surface_v1 *layer_surface =
 		layer->scene_layer_surface->layer_surface;
 	if (layer_surface->output) {
+		mark_surface_changed(layer_surface);
 		output_update_usable_area(layer_surface->output->data);
 	}
 	struct seat *seat = &layer->server->seat;
@@ -335,6 +431,7 @@ handle_map(struct wl_listener *listener, void *data)
 	struct wlr_output *wlr_output =
 		layer->scene_layer_surface->layer_surface->output;
 	if (wlr_output) {
+		mark_surface_changed(layer->scene_layer_surface->layer_surface);
 		output_update_usable_area(wlr_output->data);
 	}
 
@@ -586,6 +683,8 @@ handle_new_layer_surface(struct wl_listener *listener, void *data)
 	 */
 	struct wlr_layer_surface_v1_state old_state = layer_surface->current;
 	layer_surface->current = layer_surface->pending;
+	surface->arranged_state = layer_surface->current;
+	mark_surface_changed(layer_surface);
 	output_update_usable_area(output);
 	layer_surface->current = old_state;
 }
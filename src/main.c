@@ -3,10 +3,14 @@
 #include <signal.h>
 #include <string.h>
 #include <unistd.h>
+#include "buffer.h"
 #include "common/dir.h"
 #include "common/fd_util.h"
 #include "common/font.h"
 #include "common/mem.h"
+#include "common/phase-timer.h"
+#include "common/prefetch.h"
+#include "common/scaled_font_buffer.h"
 #include "common/spawn.h"
 #include "config/session.h"
 #include "labwc.h"
@@ -80,6 +84,46 @@ send_signal_to_labwc_pid(int signal)
 	kill(pid, signal);
 }
 
+static void
+add_paths(struct wl_array *array, struct wl_list *paths)
+{
+	struct path *path;
+	wl_list_for_each(path, paths, link) {
+		const char **slot = wl_array_add(array, sizeof(*slot));
+		*slot = path->string;
+	}
+}
+
+/*
+ * Read the theme directories, including button images, and the menu
+ * files while the backend is started. They are parsed after that.
+ */
+static void
+prefetch_theme_and_menu(void)
+{
+	struct wl_list theme_paths, override_paths, menu_paths;
+	wl_list_init(&theme_paths);
+	if (rc.theme_name) {
+		paths_theme_create(&theme_paths, rc.theme_name, "");
+	}
+	paths_config_create(&override_paths, "themerc-override");
+	paths_config_create(&menu_paths, "menu.xml");
+
+	struct wl_array array;
+	wl_array_init(&array);
+	add_paths(&array, &theme_paths);
+	add_paths(&array, &override_paths);
+	add_paths(&array, &menu_paths);
+	const char **end = wl_array_add(&array, sizeof(*end));
+	*end = NULL;
+	prefetch_start(array.data);
+
+	wl_array_release(&array);
+	paths_destroy(&theme_paths);
+	paths_destroy(&override_paths);
+	paths_destroy(&menu_paths);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -143,8 +187,15 @@ main(int argc, char *argv[])
 
 	die_on_detecting_suid();
 
+	/* Fork the launcher helper while the process is still small */
+	spawn_helper_init();
+
+	phase_timer_begin("startup");
 	session_environment_init();
+	phase_timer_mark("environment");
 	rcxml_read(rc.config_file);
+	phase_timer_mark("rc.xml");
+	prefetch_theme_and_menu();
 
 	/*
 	 * Set environment variable LABWC_PID to the pid of the compositor
@@ -167,15 +218,20 @@ main(int argc, char *argv[])
 	increase_nofile_limit();
 
 	struct server server = { 0 };
+	phase_timer_mark("process setup");
 	server_init(&server);
 	server_start(&server);
+	prefetch_finish();
+	phase_timer_mark("prefetch");
 
 	struct theme theme = { 0 };
 	theme_init(&theme, &server, rc.theme_name);
 	rc.theme = &theme;
 	server.theme = &theme;
+	phase_timer_mark("theme");
 
 	menu_init(&server);
+	phase_timer_mark("menus");
 
 	/* Start session-manager if one is specified by -S|--session */
 	if (primary_client) {
@@ -191,8 +247,10 @@ main(int argc, char *argv[])
 	if (startup_cmd) {
 		spawn_async_no_shell(startup_cmd);
 	}
+	phase_timer_mark("autostart");
+	phase_timer_end();
 
-	wl_display_run(server.wl_display);
+	server_run(&server);
 
 out:
 	session_shutdown(&server);
@@ -200,8 +258,11 @@ out:
 	server_finish(&server);
 
 	menu_finish(&server);
+	scaled_font_buffer_finish_cache();
 	theme_finish(&theme);
 	rcxml_finish();
 	font_finish();
+	buffer_pool_finish();
+	spawn_helper_finish();
 	return 0;
 }
@@ -0,0 +1,183 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/util/log.h>
+#include "common/font.h"
+#include "common/scaled_scene_buffer.h"
+#include "common/time-helpers.h"
+#include "config/rcxml.h"
+#include "heap-trim.h"
+#include "labwc.h"
+#include "memory-pressure.h"
+#include "menu/menu.h"
+#include "view.h"
+
+#define PSI_PATH "/proc/pressure/memory"
+/*
+ * Stalled for 150 ms within 2 s. Unprivileged processes may only use
+ * windows which are a multiple of 2 s.
+ */
+#define PSI_DEFAULT_TRIGGER "some 150000 2000000"
+/* The caches are not dropped more than once within this time */
+#define SHED_INTERVAL_NSEC (10 * 1000000000LL)
+
+static int psi_fd = -1;
+static int epoll_fd = -1;
+static struct wl_event_source *event_source;
+static int64_t last_shed_nsec;
+static struct memory_pressure_stats stats;
+
+static void
+shed_caches(struct server *server)
+{
+	size_t nr_views = 0;
+	struct view *view;
+	wl_list_for_each(view, &server->views, link) {
+		nr_views += view_trim_if_hidden(view);
+	}
+	size_t bytes = scaled_scene_buffer_shed_cache();
+	size_t nr_menus = menu_shed_scenes(server);
+	font_shed_caches();
+
+	stats.shed_bytes += bytes;
+	wlr_log(WLR_INFO, "memory pressure: trimmed %zu hidden views, "
+		"%zu menus and %zu KiB of cached buffers",
+		nr_views, nr_menus, bytes / 1024);
+
+	/* Hand what was freed back to the system */
+	heap_trim_schedule(server);
+}
+
+static void
+close_fds(void)
+{
+	if (event_source) {
+		wl_event_source_remove(event_source);
+		event_source = NULL;
+	}
+	if (epoll_fd >= 0) {
+		close(epoll_fd);
+		epoll_fd = -1;
+	}
+	if (psi_fd >= 0) {
+		close(psi_fd);
+		psi_fd = -1;
+	}
+}
+
+static int
+handle_epoll(int fd, uint32_t mask, void *data)
+{
+	struct server *server = data;
+	struct epoll_event event;
+	if (epoll_wait(epoll_fd, &event, 1, 0) != 1) {
+		return 0;
+	}
+	if (event.events & EPOLLERR) {
+		/* The cgroup was removed or pressure is no longer tracked */
+		wlr_log(WLR_INFO, "memory pressure notifications stopped");
+		close_fds();
+		return 0;
+	}
+	if (!(event.events & EPOLLPRI)) {
+		return 0;
+	}
+
+	stats.events++;
+	int64_t now = time_now_nsec();
+	if (last_shed_nsec && now - last_shed_nsec < SHED_INTERVAL_NSEC) {
+		return 0;
+	}
+	last_shed_nsec = now;
+	shed_caches(server);
+	return 0;
+}
+
+/*
+ * systemd passes the file to watch and the trigger to write to it, base64
+ * encoded, with MemoryPressureWatch=. A watch of /dev/null means that the
+ * service is configured to not watch at all.
+ */
+static bool
+open_trigger(void)
+{
+	const char *path = PSI_PATH;
+	guchar *trigger = NULL;
+	gsize len = 0;
+
+	const char *watch = getenv("MEMORY_PRESSURE_WATCH");
+	if (watch && *watch) {
+		if (!strcmp(watch, "/dev/null")) {
+			return false;
+		}
+		path = watch;
+		const char *encoded = getenv("MEMORY_PRESSURE_WRITE");
+		if (encoded && *encoded) {
+			trigger = g_base64_decode(encoded, &len);
+		}
+	}
+	if (!trigger) {
+		trigger = (guchar *)g_strdup(PSI_DEFAULT_TRIGGER);
+		/* The kernel expects the terminating NUL as well */
+		len = sizeof(PSI_DEFAULT_TRIGGER);
+	}
+
+	psi_fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if (psi_fd < 0) {
+		wlr_log_errno(WLR_INFO, "cannot open %s", path);
+		g_free(trigger);
+		return false;
+	}
+	if (len && write(psi_fd, trigger, len) < 0) {
+		wlr_log_errno(WLR_INFO, "cannot set memory pressure trigger");
+		g_free(trigger);
+		close_fds();
+		return false;
+	}
+	g_free(trigger);
+	return true;
+}
+
+void
+memory_pressure_init(struct server *server)
+{
+	if (!rc.memory_pressure || psi_fd >= 0 || !open_trigger()) {
+		return;
+	}
+
+	/*
+	 * Pressure events are signaled as EPOLLPRI, which wl_event_loop does
+	 * not listen for. A nested epoll instance turns them into the
+	 * readability of its own fd.
+	 */
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	struct epoll_event event = { .events = EPOLLPRI };
+	if (epoll_fd < 0
+			|| epoll_ctl(epoll_fd, EPOLL_CTL_ADD, psi_fd, &event) < 0) {
+		wlr_log_errno(WLR_ERROR, "cannot watch memory pressure");
+		close_fds();
+		return;
+	}
+	event_source = wl_event_loop_add_fd(server->wl_event_loop, epoll_fd,
+		WL_EVENT_READABLE, handle_epoll, server);
+	wlr_log(WLR_INFO, "watching memory pressure");
+}
+
+void
+memory_pressure_get_stats(struct memory_pressure_stats *out)
+{
+	*out = stats;
+}
+
+void
+memory_pressure_finish(void)
+{
+	close_fds();
+}
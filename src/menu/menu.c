@@ -3,31 +3,44 @@
 #include <assert.h>
 #include <libxml/parser.h>
 #include <libxml/tree.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 #include <wayland-server-core.h>
 #include <wlr/util/log.h>
 #include "action.h"
 #include "common/buf.h"
 #include "common/dir.h"
 #include "common/font.h"
+#include "common/hash.h"
+#include "common/int-map.h"
 #include "common/list.h"
+#include "common/macros.h"
 #include "common/mem.h"
 #include "common/nodename.h"
 #include "common/scaled_font_buffer.h"
 #include "common/scene-helpers.h"
 #include "common/spawn.h"
 #include "common/string-helpers.h"
+#include "common/time-helpers.h"
+#include "common/trace.h"
+#include "heap-trim.h"
 #include "labwc.h"
 #include "menu/menu.h"
 #include "node.h"
 #include "theme.h"
 
 #define PIPEMENU_MAX_BUF_SIZE 1048576  /* 1 MiB */
+/* Output from which parsing leaves enough garbage to trim the heap */
+#define PIPEMENU_TRIM_SIZE 65536
 #define PIPEMENU_TIMEOUT_IN_MS 4000    /* 4 seconds */
+#define MENU_SCROLL_MARGIN 4           /* items kept around the view */
+#define MENU_TYPE_AHEAD_TIMEOUT_NSEC 1000000000 /* 1 second */
 
 /* state-machine variables for processing <item></item> */
 static bool in_item;
@@ -40,6 +53,46 @@ static struct menu *current_menu;
 static bool waiting_for_pipe_menu;
 static struct menuitem *selected_item;
 
+/* What the current menus were built from, to skip unneeded reconfigures */
+static uint64_t menu_files_hash;
+static uint64_t menu_style_hash;
+
+/* Text typed for type-ahead search in type_ahead_menu */
+static struct {
+	char text[64];
+	size_t len;
+	struct menu *menu;
+	int64_t last_nsec;
+} type_ahead;
+
+/*
+ * Output of pipemenus with a cacheTime="" attribute, keyed by command.
+ * Stale output is still shown right away while it is refreshed in the
+ * background.
+ */
+struct pipemenu_cache_entry {
+	char *execute;
+	struct buf buf;
+	int64_t updated_nsec;
+	bool refreshing;
+	struct wl_list link; /* pipemenu_cache */
+};
+
+static struct wl_list pipemenu_cache;
+
+/* A label measured off the main thread, see pipemenu_parse_job */
+struct measured_label {
+	char *text;
+	int width;
+	struct wl_list link; /* pipemenu_parse_job.labels */
+};
+
+/* Labels of the pipemenu being installed, keyed by hash_label() */
+static struct int_map *measured_labels;
+
+static void prefetch_pipemenus(struct menu *menu);
+static void pipemenu_abort(void);
+
 /* TODO: split this whole file into parser.c and actions.c*/
 
 static bool
@@ -71,12 +124,27 @@ menu_create(struct server *server, const char *id, const char *label)
 	menu->server = server;
 	menu->is_pipemenu = waiting_for_pipe_menu;
 	menu->size.width = server->theme->menu_min_width;
-	/* menu->size.height will be kept up to date by adding items */
-	menu->scene_tree = wlr_scene_tree_create(server->menu_tree);
-	wlr_scene_node_set_enabled(&menu->scene_tree->node, false);
+	/*
+	 * menu->size.height will be kept up to date by adding items.
+	 * The scene tree is only created once the menu is first shown,
+	 * see menu_configure().
+	 */
 	return menu;
 }
 
+static bool
+menu_is_open(struct menu *menu)
+{
+	return menu->scene_tree && menu->scene_tree->node.enabled;
+}
+
+static void
+menu_search_index_invalidate(struct menu *menu)
+{
+	zfree(menu->search_index);
+	menu->search_index_len = 0;
+}
+
 struct menu *
 menu_get_by_id(struct server *server, const char *id)
 {
@@ -106,15 +174,23 @@ menu_update_width(struct menu *menu)
 				? item->native_width : theme->menu_max_width;
 		}
 	}
-	menu->size.width = max_width + 2 * theme->menu_item_padding_x;
+	int width = max_width + 2 * theme->menu_item_padding_x;
+	if (width == menu->size.width) {
+		/* Items with scene nodes already have the right size */
+		return;
+	}
+	menu->size.width = width;
 
-	/* Update all items for the new size */
+	/* Update all items with scene nodes for the new size */
 	wl_list_for_each(item, &menu->menuitems, link) {
+		if (!item->tree) {
+			continue;
+		}
 		wlr_scene_rect_set_size(
 			wlr_scene_rect_from_node(item->normal.background),
 			menu->size.width, item->height);
 
-		if (!item->selected.background) {
+		if (!item->text) {
 			/* This is a separator. They don't have a selected background. */
 			wlr_scene_rect_set_size(
 				wlr_scene_rect_from_node(item->normal.text),
@@ -135,15 +211,6 @@ menu_update_width(struct menu *menu)
 	}
 }
 
-static void
-post_processing(struct server *server)
-{
-	struct menu *menu;
-	wl_list_for_each(menu, &server->menus, link) {
-		menu_update_width(menu);
-	}
-}
-
 static void
 validate_menu(struct menu *menu)
 {
@@ -160,12 +227,68 @@ validate_menu(struct menu *menu)
 	}
 }
 
+/*
+ * Set the width and drop invalid actions of menus which had items added or
+ * re-measured since the last call, so that adding a pipemenu does not
+ * process all other menus again.
+ */
 static void
-validate(struct server *server)
+post_processing(struct server *server)
 {
 	struct menu *menu;
 	wl_list_for_each(menu, &server->menus, link) {
+		if (!menu->needs_post_processing) {
+			continue;
+		}
+		menu_update_width(menu);
 		validate_menu(menu);
+		menu->needs_post_processing = false;
+	}
+}
+
+static uint64_t
+hash_label(const char *text)
+{
+	return hash_str(HASH_INIT, text);
+}
+
+static int
+label_width(const char *text)
+{
+	if (measured_labels) {
+		struct measured_label *label =
+			int_map_lookup(measured_labels, hash_label(text));
+		if (label && !strcmp(label->text, text)) {
+			return label->width;
+		}
+	}
+	return font_width(&rc.font_menuitem, text);
+}
+
+/* Set the size of an item from its label and the current theme and font */
+static void
+item_measure(struct menuitem *item)
+{
+	struct menu *menu = item->parent;
+	struct theme *theme = menu->server->theme;
+	menu->needs_post_processing = true;
+
+	if (!item->text) {
+		/* Separator */
+		item->height = theme->menu_separator_line_thickness +
+			2 * theme->menu_separator_padding_height;
+		return;
+	}
+
+	if (!menu->item_height) {
+		menu->item_height = font_height(&rc.font_menuitem)
+			+ 2 * theme->menu_item_padding_y;
+	}
+	item->height = menu->item_height;
+
+	item->native_width = label_width(item->text);
+	if (item->arrow) {
+		item->native_width += font_width(&rc.font_menuitem, "›");
 	}
 }
 
@@ -178,125 +301,267 @@ item_create(struct menu *menu, const char *text, bool show_arrow)
 	struct menuitem *menuitem = znew(*menuitem);
 	menuitem->parent = menu;
 	menuitem->selectable = true;
-	struct server *server = menu->server;
-	struct theme *theme = server->theme;
+	menuitem->text = xstrdup(text);
+	menuitem->arrow = show_arrow;
+	item_measure(menuitem);
 
-	const char *arrow = show_arrow ? "›" : NULL;
+	/*
+	 * Scene nodes are only created once the item comes into view,
+	 * see menu_update_view()
+	 */
+	menuitem->y = menu->size.height;
 
-	if (!menu->item_height) {
-		menu->item_height = font_height(&rc.font_menuitem)
-			+ 2 * theme->menu_item_padding_y;
-	}
-	menuitem->height = menu->item_height;
+	/* Update menu extents */
+	menu->size.height += menuitem->height;
+
+	menu_search_index_invalidate(menu);
+	wl_list_append(&menu->menuitems, &menuitem->link);
+	wl_list_init(&menuitem->actions);
+	return menuitem;
+}
+
+static struct menuitem *
+separator_create(struct menu *menu, const char *label)
+{
+	struct menuitem *menuitem = znew(*menuitem);
+	menuitem->parent = menu;
+	menuitem->selectable = false;
+	item_measure(menuitem);
 
-	int x, y;
-	menuitem->native_width = font_width(&rc.font_menuitem, text);
-	if (arrow) {
-		menuitem->native_width += font_width(&rc.font_menuitem, arrow);
+	menuitem->y = menu->size.height;
+	menu->size.height += menuitem->height;
+	wl_list_append(&menu->menuitems, &menuitem->link);
+	wl_list_init(&menuitem->actions);
+	return menuitem;
+}
+
+static int
+item_label_width(struct menuitem *item)
+{
+	struct menu *menu = item->parent;
+	int max_width = menu->size.width
+		- 2 * menu->server->theme->menu_item_padding_x;
+	if (item->native_width > max_width || item->submenu || item->execute) {
+		return max_width;
 	}
+	return item->native_width;
+}
+
+static void
+item_update_text(struct menuitem *item)
+{
+	struct menu *menu = item->parent;
+	struct theme *theme = menu->server->theme;
+	const char *arrow = item->arrow ? "›" : NULL;
+	int max_width = item_label_width(item);
+
+	scaled_font_buffer_update(item->normal.buffer, item->text, max_width,
+		&rc.font_menuitem, theme->menu_items_text_color,
+		theme->menu_items_bg_color, arrow);
+	scaled_font_buffer_update(item->selected.buffer, item->text, max_width,
+		&rc.font_menuitem, theme->menu_items_active_text_color,
+		theme->menu_items_active_bg_color, arrow);
+
+	/* Center font nodes */
+	int x = theme->menu_item_padding_x;
+	int y = (menu->item_height - item->normal.buffer->height) / 2;
+	wlr_scene_node_set_position(item->normal.text, x, y);
+	y = (menu->item_height - item->selected.buffer->height) / 2;
+	wlr_scene_node_set_position(item->selected.text, x, y);
+}
+
+static void
+separator_create_scene(struct menuitem *item)
+{
+	struct menu *menu = item->parent;
+	struct theme *theme = menu->server->theme;
+
+	item->normal.background = &wlr_scene_rect_create(
+		item->normal.tree,
+		menu->size.width, item->height,
+		theme->menu_items_bg_color)->node;
+
+	int width = menu->size.width - 2 * theme->menu_separator_padding_width;
+	item->normal.text = &wlr_scene_rect_create(
+		item->normal.tree,
+		width > 0 ? width : 0,
+		theme->menu_separator_line_thickness,
+		theme->menu_separator_color)->node;
+
+	/* Vertically center-align separator line */
+	wlr_scene_node_set_position(item->normal.text,
+		theme->menu_separator_padding_width,
+		theme->menu_separator_padding_height);
+}
+
+static bool
+item_create_scene(struct menuitem *item)
+{
+	struct menu *menu = item->parent;
+	struct theme *theme = menu->server->theme;
 
 	/* Menu item root node */
-	menuitem->tree = wlr_scene_tree_create(menu->scene_tree);
-	node_descriptor_create(&menuitem->tree->node,
-		LAB_NODE_DESC_MENUITEM, menuitem);
+	item->tree = wlr_scene_tree_create(menu->scene_tree);
+	node_descriptor_create(&item->tree->node,
+		LAB_NODE_DESC_MENUITEM, item);
 
 	/* Tree for each state to hold background and text buffer */
-	menuitem->normal.tree = wlr_scene_tree_create(menuitem->tree);
-	menuitem->selected.tree = wlr_scene_tree_create(menuitem->tree);
+	item->normal.tree = wlr_scene_tree_create(item->tree);
+	if (!item->text) {
+		separator_create_scene(item);
+		return true;
+	}
+	item->selected.tree = wlr_scene_tree_create(item->tree);
 
 	/* Item background nodes */
-	menuitem->normal.background = &wlr_scene_rect_create(
-		menuitem->normal.tree,
+	item->normal.background = &wlr_scene_rect_create(
+		item->normal.tree,
 		menu->size.width, menu->item_height,
 		theme->menu_items_bg_color)->node;
-	menuitem->selected.background = &wlr_scene_rect_create(
-		menuitem->selected.tree,
+	item->selected.background = &wlr_scene_rect_create(
+		item->selected.tree,
 		menu->size.width, menu->item_height,
 		theme->menu_items_active_bg_color)->node;
 
-	/* Font nodes */
-	menuitem->normal.buffer = scaled_font_buffer_create(menuitem->normal.tree);
-	menuitem->selected.buffer = scaled_font_buffer_create(menuitem->selected.tree);
-	if (!menuitem->normal.buffer || !menuitem->selected.buffer) {
-		wlr_log(WLR_ERROR, "Failed to create menu item '%s'", text);
+	/* Font nodes, only rendered once the menu is shown */
+	int text_height = MAX(1, menu->item_height - 2 * theme->menu_item_padding_y);
+	item->normal.buffer = scaled_font_buffer_create_lazy(
+		item->normal.tree, text_height);
+	item->selected.buffer = scaled_font_buffer_create_lazy(
+		item->selected.tree, text_height);
+	if (!item->normal.buffer || !item->selected.buffer) {
+		wlr_log(WLR_ERROR, "Failed to create menu item '%s'", item->text);
 		/*
 		 * Destroying the root node will destroy everything,
 		 * including the node descriptor and scaled_font_buffers.
 		 */
-		wlr_scene_node_destroy(&menuitem->tree->node);
-		free(menuitem);
-		return NULL;
+		wlr_scene_node_destroy(&item->tree->node);
+		item->tree = NULL;
+		item->normal = (struct menu_scene){0};
+		item->selected = (struct menu_scene){0};
+		return false;
 	}
-	menuitem->normal.text = &menuitem->normal.buffer->scene_buffer->node;
-	menuitem->selected.text = &menuitem->selected.buffer->scene_buffer->node;
+	item->normal.text = &item->normal.buffer->scene_buffer->node;
+	item->selected.text = &item->selected.buffer->scene_buffer->node;
 
-	/* Font buffers */
-	scaled_font_buffer_update(menuitem->normal.buffer, text, menuitem->native_width,
-		&rc.font_menuitem, theme->menu_items_text_color,
-		theme->menu_items_bg_color, arrow);
-	scaled_font_buffer_update(menuitem->selected.buffer, text, menuitem->native_width,
-		&rc.font_menuitem, theme->menu_items_active_text_color,
-		theme->menu_items_active_bg_color, arrow);
-
-	/* Center font nodes */
-	x = theme->menu_item_padding_x;
-	y = (menu->item_height - menuitem->normal.buffer->height) / 2;
-	wlr_scene_node_set_position(menuitem->normal.text, x, y);
-	y = (menu->item_height - menuitem->selected.buffer->height) / 2;
-	wlr_scene_node_set_position(menuitem->selected.text, x, y);
-
-	/* Position the item in relation to its menu */
-	wlr_scene_node_set_position(&menuitem->tree->node, 0, menu->size.height);
+	item_update_text(item);
 
 	/* Hide selected state */
-	wlr_scene_node_set_enabled(&menuitem->selected.tree->node, false);
-
-	/* Update menu extents */
-	menu->size.height += menuitem->height;
+	wlr_scene_node_set_enabled(&item->selected.tree->node, false);
+	return true;
+}
 
-	wl_list_append(&menu->menuitems, &menuitem->link);
-	wl_list_init(&menuitem->actions);
-	return menuitem;
+static void
+item_destroy_scene(struct menuitem *item)
+{
+	if (!item->tree) {
+		return;
+	}
+	/* Also destroys the node descriptor and scaled_font_buffers */
+	wlr_scene_node_destroy(&item->tree->node);
+	item->tree = NULL;
+	item->normal = (struct menu_scene){0};
+	item->selected = (struct menu_scene){0};
 }
 
-static struct menuitem *
-separator_create(struct menu *menu, const char *label)
+/* Hand over the scene nodes of @from, which went out of view, to @item */
+static void
+item_recycle_scene(struct menuitem *item, struct menuitem *from)
 {
-	struct menuitem *menuitem = znew(*menuitem);
-	menuitem->parent = menu;
-	menuitem->selectable = false;
-	struct server *server = menu->server;
-	struct theme *theme = server->theme;
-	menuitem->height = theme->menu_separator_line_thickness +
-			2 * theme->menu_separator_padding_height;
+	assert(!item->text == !from->text);
+	item->tree = from->tree;
+	item->normal = from->normal;
+	item->selected = from->selected;
+	from->tree = NULL;
+	from->normal = (struct menu_scene){0};
+	from->selected = (struct menu_scene){0};
+
+	struct node_descriptor *node_descriptor = item->tree->node.data;
+	node_descriptor->data = item;
+	if (item->text) {
+		item_update_text(item);
+	}
+}
 
-	menuitem->tree = wlr_scene_tree_create(menu->scene_tree);
-	node_descriptor_create(&menuitem->tree->node,
-		LAB_NODE_DESC_MENUITEM, menuitem);
-	menuitem->normal.tree = wlr_scene_tree_create(menuitem->tree);
-	menuitem->normal.background = &wlr_scene_rect_create(
-		menuitem->normal.tree,
-		menu->size.width, menuitem->height,
-		theme->menu_items_bg_color)->node;
+static bool
+item_in_view(struct menuitem *item)
+{
+	struct menu *menu = item->parent;
+	if (!menu->scroll.height) {
+		return true;
+	}
+	return item->y >= menu->scroll.offset
+		&& item->y + item->height
+			<= menu->scroll.offset + menu->scroll.height;
+}
 
-	int width = menu->size.width - 2 * theme->menu_separator_padding_width;
-	menuitem->normal.text = &wlr_scene_rect_create(
-		menuitem->normal.tree,
-		width > 0 ? width : 0,
-		theme->menu_separator_line_thickness,
-		theme->menu_separator_color)->node;
+/*
+ * Make sure the items in view have scene nodes and position them. Items
+ * more than MENU_SCROLL_MARGIN items away from the view lose their nodes,
+ * which are reused for items coming into view where possible.
+ */
+static void
+menu_update_view(struct menu *menu)
+{
+	/* Index range of the items to keep nodes for */
+	int first = -1, last = -1, i = 0;
+	struct menuitem *item;
+	wl_list_for_each(item, &menu->menuitems, link) {
+		if (item_in_view(item)) {
+			if (first < 0) {
+				first = i;
+			}
+			last = i;
+		}
+		i++;
+	}
+	first -= MENU_SCROLL_MARGIN;
+	last += MENU_SCROLL_MARGIN;
 
-	wlr_scene_node_set_position(&menuitem->tree->node, 0, menu->size.height);
+	/* Collect nodes of items too far out of view */
+	struct menuitem **spare = NULL;
+	int nr_spare = 0;
+	i = 0;
+	wl_list_for_each(item, &menu->menuitems, link) {
+		if (item->tree && (i < first || i > last)) {
+			spare = xrealloc(spare, (nr_spare + 1) * sizeof(*spare));
+			spare[nr_spare++] = item;
+		}
+		i++;
+	}
 
-	/* Vertically center-align separator line */
-	wlr_scene_node_set_position(menuitem->normal.text,
-		theme->menu_separator_padding_width,
-		theme->menu_separator_padding_height);
+	i = 0;
+	wl_list_for_each(item, &menu->menuitems, link) {
+		bool keep = i >= first && i <= last;
+		i++;
+		if (!keep) {
+			continue;
+		}
+		if (!item->tree) {
+			for (int j = 0; j < nr_spare; j++) {
+				if (spare[j]->tree && !spare[j]->text == !item->text) {
+					item_recycle_scene(item, spare[j]);
+					break;
+				}
+			}
+		}
+		if (!item->tree && !item_create_scene(item)) {
+			continue;
+		}
+		wlr_scene_node_set_position(&item->tree->node, 0,
+			item->y - menu->scroll.offset);
+		wlr_scene_node_set_enabled(&item->tree->node, item_in_view(item));
+		if (item->text) {
+			bool selected = menu->selection.item == item;
+			wlr_scene_node_set_enabled(&item->normal.tree->node, !selected);
+			wlr_scene_node_set_enabled(&item->selected.tree->node, selected);
+		}
+	}
 
-	menu->size.height += menuitem->height;
-	wl_list_append(&menu->menuitems, &menuitem->link);
-	wl_list_init(&menuitem->actions);
-	return menuitem;
+	for (int j = 0; j < nr_spare; j++) {
+		item_destroy_scene(spare[j]);
+	}
+	free(spare);
 }
 
 /*
@@ -331,7 +596,7 @@ fill_item(char *nodename, char *content)
 		 * logging errors if a menu.xml file contains icon="" entries.
 		 */
 	} else if (!strcmp(nodename, "name.action")) {
-		current_item_action = action_create(content);
+		current_item_action = action_create(NULL, content);
 		if (current_item_action) {
 			wl_list_append(&current_item->actions,
 				&current_item_action->link);
@@ -348,8 +613,10 @@ static void
 item_destroy(struct menuitem *item)
 {
 	wl_list_remove(&item->link);
+	menu_search_index_invalidate(item->parent);
 	action_list_free(&item->actions);
-	wlr_scene_node_destroy(&item->tree->node);
+	item_destroy_scene(item);
+	free(item->text);
 	free(item->execute);
 	free(item->id);
 	free(item);
@@ -503,6 +770,7 @@ handle_menu_element(xmlNode *n, struct server *server)
 	char *label = (char *)xmlGetProp(n, (const xmlChar *)"label");
 	char *execute = (char *)xmlGetProp(n, (const xmlChar *)"execute");
 	char *id = (char *)xmlGetProp(n, (const xmlChar *)"id");
+	char *cache_time = (char *)xmlGetProp(n, (const xmlChar *)"cacheTime");
 
 	if (execute && label && id) {
 		wlr_log(WLR_DEBUG, "pipemenu '%s:%s:%s'", id, label, execute);
@@ -510,6 +778,9 @@ handle_menu_element(xmlNode *n, struct server *server)
 		current_item_action = NULL;
 		current_item->execute = xstrdup(execute);
 		current_item->id = xstrdup(id);
+		if (cache_time) {
+			current_item->cache_time = MAX(0, atoi(cache_time));
+		}
 	} else if ((label && id) || is_toplevel_static_menu_definition(n, id)) {
 		/*
 		 * (label && id) refers to <menu id="" label=""> which is an
@@ -578,6 +849,7 @@ error:
 	free(label);
 	free(execute);
 	free(id);
+	free(cache_time);
 }
 
 /* This can be one of <separator> and <separator label=""> */
@@ -624,7 +896,6 @@ parse_buf(struct server *server, struct buf *buf)
 	}
 	xml_tree_walk(xmlDocGetRootElement(d), server);
 	xmlFreeDoc(d);
-	xmlCleanupParser();
 	return true;
 }
 
@@ -678,6 +949,83 @@ parse_xml(const char *filename, struct server *server)
 	paths_destroy(&paths);
 }
 
+/*
+ * Hash the content of the menu files the same way parse_xml() reads them,
+ * along with the other settings the parsed menus depend on.
+ */
+static uint64_t
+hash_menu_files(const char *filename)
+{
+	uint64_t hash = HASH_INIT;
+	bool single_workspace =
+		wl_list_length(&rc.workspace_config.workspaces) == 1;
+	hash = hash_bytes(hash, &single_workspace, sizeof(single_workspace));
+
+	struct wl_list paths;
+	paths_config_create(&paths, filename);
+
+	bool should_merge_config = rc.merge_config;
+	hash = hash_bytes(hash, &should_merge_config, sizeof(should_merge_config));
+	struct wl_list *(*iter)(struct wl_list *list);
+	iter = should_merge_config ? paths_get_prev : paths_get_next;
+
+	for (struct wl_list *elm = iter(&paths); elm != &paths; elm = iter(elm)) {
+		struct path *path = wl_container_of(elm, path, link);
+		FILE *stream = fopen(path->string, "r");
+		if (!stream) {
+			break;
+		}
+		/* Include the terminator to tell paths and content apart */
+		hash = hash_bytes(hash, path->string, strlen(path->string) + 1);
+		char data[4096];
+		size_t size;
+		while ((size = fread(data, 1, sizeof(data), stream)) > 0) {
+			hash = hash_bytes(hash, data, size);
+		}
+		fclose(stream);
+		if (!should_merge_config) {
+			break;
+		}
+	}
+	paths_destroy(&paths);
+	return hash;
+}
+
+/* Hash the theme and font settings which item scene nodes are built from */
+static uint64_t
+hash_menu_style(struct theme *theme)
+{
+	uint64_t hash = HASH_INIT;
+	struct font *font = &rc.font_menuitem;
+	if (font->name) {
+		hash = hash_bytes(hash, font->name, strlen(font->name) + 1);
+	}
+	hash = hash_bytes(hash, &font->size, sizeof(font->size));
+	hash = hash_bytes(hash, &font->slant, sizeof(font->slant));
+	hash = hash_bytes(hash, &font->weight, sizeof(font->weight));
+
+	int metrics[] = {
+		theme->menu_item_padding_x,
+		theme->menu_item_padding_y,
+		theme->menu_min_width,
+		theme->menu_max_width,
+		theme->menu_separator_line_thickness,
+		theme->menu_separator_padding_width,
+		theme->menu_separator_padding_height,
+	};
+	hash = hash_bytes(hash, metrics, sizeof(metrics));
+	hash = hash_bytes(hash, theme->menu_items_bg_color,
+		sizeof(theme->menu_items_bg_color));
+	hash = hash_bytes(hash, theme->menu_items_text_color,
+		sizeof(theme->menu_items_text_color));
+	hash = hash_bytes(hash, theme->menu_items_active_bg_color,
+		sizeof(theme->menu_items_active_bg_color));
+	hash = hash_bytes(hash, theme->menu_items_active_text_color,
+		sizeof(theme->menu_items_active_text_color));
+	return hash_bytes(hash, theme->menu_separator_color,
+		sizeof(theme->menu_separator_color));
+}
+
 static int
 menu_get_full_width(struct menu *menu)
 {
@@ -711,16 +1059,51 @@ get_submenu_position(struct menuitem *item, enum menu_align align)
 	} else {
 		pos.x = lx;
 	}
-	int rel_y = item->tree->node.y;
+	int rel_y = item->y - menu->scroll.offset;
 	pos.y = ly + rel_y - theme->menu_overlap_y;
 	return pos;
 }
 
+static void menu_configure(struct menu *menu, int lx, int ly,
+	enum menu_align align);
+
+/*
+ * Position the submenu of @item next to it. Submenus are only configured,
+ * and thereby get their scene nodes, when they are opened.
+ */
+static void
+menu_configure_submenu(struct menuitem *item)
+{
+	struct menu *menu = item->parent;
+	struct wlr_box pos = get_submenu_position(item, menu->align);
+	menu_configure(item->submenu, pos.x, pos.y, menu->align);
+}
+
+/* Snap @offset to the top of an item without scrolling past the last one */
+static int
+menu_clamp_scroll_offset(struct menu *menu, int offset)
+{
+	struct menuitem *item;
+	wl_list_for_each(item, &menu->menuitems, link) {
+		if (item->y >= offset
+				|| menu->size.height - item->y <= menu->scroll.height) {
+			return item->y;
+		}
+	}
+	return 0;
+}
+
 static void
 menu_configure(struct menu *menu, int lx, int ly, enum menu_align align)
 {
+	TRACE_FUNC();
 	struct theme *theme = menu->server->theme;
 
+	if (!menu->scene_tree) {
+		menu->scene_tree = wlr_scene_tree_create(menu->server->menu_tree);
+		wlr_scene_node_set_enabled(&menu->scene_tree->node, false);
+	}
+
 	/* Get output local coordinates + output usable area */
 	double ox = lx;
 	double oy = ly;
@@ -732,6 +1115,7 @@ menu_configure(struct menu *menu, int lx, int ly, enum menu_align align)
 		wlr_log(WLR_ERROR,
 			"Failed to position menu %s (%s) and its submenus: "
 			"Not enough screen space", menu->id, menu->label);
+		menu_update_view(menu);
 		return;
 	}
 	wlr_output_layout_output_coords(menu->server->output_layout,
@@ -746,10 +1130,22 @@ menu_configure(struct menu *menu, int lx, int ly, enum menu_align align)
 		}
 	}
 
-	if (oy + menu->size.height > output->usable_area.height) {
+	if (menu->size.height > output->usable_area.height) {
+		/* Too tall for the output, fill its height and scroll */
+		menu->scroll.height = output->usable_area.height;
+		menu->scroll.offset =
+			menu_clamp_scroll_offset(menu, menu->scroll.offset);
+		ly += output->usable_area.y - (int)oy;
+		align &= ~LAB_MENU_OPEN_TOP;
+		align |= LAB_MENU_OPEN_BOTTOM;
+	} else if (oy + menu->size.height > output->usable_area.height) {
+		menu->scroll.height = 0;
+		menu->scroll.offset = 0;
 		align &= ~LAB_MENU_OPEN_BOTTOM;
 		align |= LAB_MENU_OPEN_TOP;
 	} else {
+		menu->scroll.height = 0;
+		menu->scroll.offset = 0;
 		align &= ~LAB_MENU_OPEN_TOP;
 		align |= LAB_MENU_OPEN_BOTTOM;
 	}
@@ -766,17 +1162,10 @@ menu_configure(struct menu *menu, int lx, int ly, enum menu_align align)
 	}
 	wlr_scene_node_set_position(&menu->scene_tree->node, lx, ly);
 
-	/* Needed for pipemenus to inherit alignment */
+	/* Needed for submenus and pipemenus to inherit alignment */
 	menu->align = align;
 
-	struct menuitem *item;
-	wl_list_for_each(item, &menu->menuitems, link) {
-		if (!item->submenu) {
-			continue;
-		}
-		struct wlr_box pos = get_submenu_position(item, align);
-		menu_configure(item->submenu, pos.x, pos.y, align);
-	}
+	menu_update_view(menu);
 }
 
 static void
@@ -801,10 +1190,10 @@ menu_hide_submenu(struct server *server, const char *id)
 			continue;
 		}
 		/* Re-position items vertically */
+		menu->needs_post_processing = true;
 		menu->size.height = 0;
 		wl_list_for_each(item, &menu->menuitems, link) {
-			wlr_scene_node_set_position(&item->tree->node, 0,
-				menu->size.height);
+			item->y = menu->size.height;
 			menu->size.height += item->height;
 		}
 	}
@@ -885,11 +1274,13 @@ void
 menu_init(struct server *server)
 {
 	wl_list_init(&server->menus);
+	wl_list_init(&pipemenu_cache);
+	menu_files_hash = hash_menu_files("menu.xml");
+	menu_style_hash = hash_menu_style(server->theme);
 	parse_xml("menu.xml", server);
 	init_rootmenu(server);
 	init_windowmenu(server);
 	post_processing(server);
-	validate(server);
 }
 
 static void
@@ -930,8 +1321,13 @@ menu_free(struct menu *menu)
 	 * Destroying the root node will destroy everything,
 	 * including node descriptors and scaled_font_buffers.
 	 */
-	wlr_scene_node_destroy(&menu->scene_tree->node);
+	if (menu->scene_tree) {
+		wlr_scene_node_destroy(&menu->scene_tree->node);
+	}
 	wl_list_remove(&menu->link);
+	if (type_ahead.menu == menu) {
+		type_ahead.menu = NULL;
+	}
 	zfree(menu);
 }
 
@@ -959,7 +1355,9 @@ menu_free_from(struct server *server, struct menu *from)
 void
 menu_finish(struct server *server)
 {
+	pipemenu_abort();
 	menu_free_from(server, NULL);
+	pipemenu_cache_finish();
 
 	/* Reset state vars for starting fresh when Reload is triggered */
 	current_item = NULL;
@@ -967,19 +1365,40 @@ menu_finish(struct server *server)
 	current_menu = NULL;
 }
 
+size_t
+menu_shed_scenes(struct server *server)
+{
+	size_t nr_menus = 0;
+	struct menu *menu;
+	wl_list_for_each(menu, &server->menus, link) {
+		if (!menu->scene_tree || menu_is_open(menu)) {
+			continue;
+		}
+		struct menuitem *item;
+		wl_list_for_each(item, &menu->menuitems, link) {
+			item_destroy_scene(item);
+		}
+		/* Created again by menu_configure() */
+		wlr_scene_node_destroy(&menu->scene_tree->node);
+		menu->scene_tree = NULL;
+		nr_menus++;
+	}
+	return nr_menus;
+}
+
 /* Sets selection (or clears selection if passing NULL) */
 static void
 menu_set_selection(struct menu *menu, struct menuitem *item)
 {
-	/* Clear old selection */
-	if (menu->selection.item) {
+	/* Clear old selection, items out of view may have no scene nodes */
+	if (menu->selection.item && menu->selection.item->tree) {
 		wlr_scene_node_set_enabled(
 			&menu->selection.item->normal.tree->node, true);
 		wlr_scene_node_set_enabled(
 			&menu->selection.item->selected.tree->node, false);
 	}
 	/* Set new selection */
-	if (item) {
+	if (item && item->tree) {
 		wlr_scene_node_set_enabled(&item->normal.tree->node, false);
 		wlr_scene_node_set_enabled(&item->selected.tree->node, true);
 	}
@@ -991,7 +1410,7 @@ close_all_submenus(struct menu *menu)
 {
 	struct menuitem *item;
 	wl_list_for_each(item, &menu->menuitems, link) {
-		if (item->submenu) {
+		if (item->submenu && item->submenu->scene_tree) {
 			wlr_scene_node_set_enabled(
 				&item->submenu->scene_tree->node, false);
 			close_all_submenus(item->submenu);
@@ -1012,6 +1431,9 @@ destroy_pipemenus(struct server *server)
 	wlr_log(WLR_DEBUG, "number of menus before close=%d",
 		wl_list_length(&server->menus));
 
+	/* A pipemenu still being streamed would be left dangling */
+	pipemenu_abort();
+
 	struct menu *iter, *tmp;
 	wl_list_for_each_safe(iter, tmp, &server->menus, link) {
 		if (iter->is_pipemenu) {
@@ -1026,7 +1448,9 @@ destroy_pipemenus(struct server *server)
 static void
 _close(struct menu *menu)
 {
-	wlr_scene_node_set_enabled(&menu->scene_tree->node, false);
+	if (menu->scene_tree) {
+		wlr_scene_node_set_enabled(&menu->scene_tree->node, false);
+	}
 	menu_set_selection(menu, NULL);
 	if (menu->selection.menu) {
 		_close(menu->selection.menu);
@@ -1044,6 +1468,51 @@ menu_close(struct menu *menu)
 	_close(menu);
 }
 
+static void
+menu_scroll_to(struct menu *menu, int offset)
+{
+	offset = menu_clamp_scroll_offset(menu, offset);
+	if (offset == menu->scroll.offset) {
+		return;
+	}
+	menu->scroll.offset = offset;
+
+	/* Don't leave the submenu of a selected item behind */
+	struct menuitem *selection = menu->selection.item;
+	if (selection && !item_in_view(selection)) {
+		pipemenu_abort();
+		if (menu->selection.menu) {
+			menu_close(menu->selection.menu);
+			menu->selection.menu = NULL;
+		}
+		menu_set_selection(menu, NULL);
+		selected_item = NULL;
+	}
+
+	menu_update_view(menu);
+	/* Move the chain of open submenus along */
+	while (menu->selection.menu && menu->selection.item
+			&& menu->selection.item->submenu) {
+		menu_configure_submenu(menu->selection.item);
+		menu = menu->selection.item->submenu;
+	}
+}
+
+static void
+menu_scroll_into_view(struct menuitem *item)
+{
+	struct menu *menu = item->parent;
+	if (item_in_view(item)) {
+		return;
+	}
+	if (item->y < menu->scroll.offset) {
+		menu_scroll_to(menu, item->y);
+	} else {
+		menu_scroll_to(menu,
+			item->y + item->height - menu->scroll.height);
+	}
+}
+
 void
 menu_open_root(struct menu *menu, int x, int y)
 {
@@ -1054,63 +1523,108 @@ menu_open_root(struct menu *menu, int x, int y)
 	}
 	close_all_submenus(menu);
 	menu_set_selection(menu, NULL);
+
+	/* Start at the top of menus which have been scrolled before */
+	struct menu *iter;
+	wl_list_for_each(iter, &menu->server->menus, link) {
+		iter->scroll.offset = 0;
+	}
 	menu_configure(menu, x, y, LAB_MENU_OPEN_AUTO);
 	wlr_scene_node_set_enabled(&menu->scene_tree->node, true);
 	menu->server->menu_current = menu;
 	menu->server->input_mode = LAB_INPUT_STATE_MENU;
 	selected_item = NULL;
+	prefetch_pipemenus(menu);
 }
 
 struct pipe_context {
 	struct server *server;
-	struct menuitem *item;
+	struct menuitem *item; /* NULL when refreshing the cache */
+	char *execute;
 	struct buf buf;
+
+	/* Items are created as the output arrives */
+	xmlParserCtxtPtr parser;
+	struct menu *menu; /* NULL until the first complete element */
+
 	struct wl_event_source *event_read;
 	struct wl_event_source *event_timeout;
-	pid_t pid;
+	struct spawn_piped_child *child;
 	int pipe_fd;
 };
 
+static struct pipemenu_cache_entry *
+pipemenu_cache_find(const char *execute)
+{
+	struct pipemenu_cache_entry *entry;
+	wl_list_for_each(entry, &pipemenu_cache, link) {
+		if (!strcmp(entry->execute, execute)) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+static bool
+pipemenu_cache_is_stale(struct pipemenu_cache_entry *entry, int cache_time)
+{
+	return time_now_nsec() - entry->updated_nsec
+		> (int64_t)cache_time * 1000000000;
+}
+
 static void
-create_pipe_menu(struct pipe_context *ctx)
+pipemenu_cache_finish(void)
 {
-	struct menu *pipe_parent = ctx->item->parent;
-	if (!pipe_parent) {
-		wlr_log(WLR_ERROR, "[pipemenu %ld] invalid parent",
-			(long)ctx->pid);
+	if (!pipemenu_cache.next) {
 		return;
 	}
-	if (!pipe_parent->scene_tree->node.enabled) {
-		wlr_log(WLR_ERROR, "[pipemenu %ld] parent menu already closed",
-			(long)ctx->pid);
-		return;
+	struct pipemenu_cache_entry *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &pipemenu_cache, link) {
+		wl_list_remove(&entry->link);
+		buf_reset(&entry->buf);
+		free(entry->execute);
+		free(entry);
+	}
+}
+
+static struct menu *
+pipe_menu_create(struct server *server, struct menuitem *item)
+{
+	struct menu *pipe_parent = item->parent;
+	if (!pipe_parent) {
+		wlr_log(WLR_ERROR, "[pipemenu %s] invalid parent", item->id);
+		return NULL;
+	}
+	if (!menu_is_open(pipe_parent)) {
+		wlr_log(WLR_ERROR, "[pipemenu %s] parent menu already closed",
+			item->id);
+		return NULL;
 	}
 
 	/*
 	 * Pipemenus do not contain a toplevel <menu> element so we have to
 	 * create that first `struct menu`.
 	 */
-	struct menu *pipe_menu = menu_create(ctx->server, ctx->item->id, /*label*/ NULL);
+	struct menu *pipe_menu = menu_create(server, item->id, /*label*/ NULL);
 	pipe_menu->is_pipemenu = true;
 	pipe_menu->triggered_by_view = pipe_parent->triggered_by_view;
 	pipe_menu->parent = pipe_parent;
+	item->submenu = pipe_menu;
+	return pipe_menu;
+}
 
-	menu_level++;
-	current_menu = pipe_menu;
-	if (!parse_buf(ctx->server, &ctx->buf)) {
-		menu_free(pipe_menu);
-		ctx->item->submenu = NULL;
-		goto restore_menus;
-	}
-	ctx->item->submenu = pipe_menu;
+/* Lay out a pipemenu, also called again when streamed items are added */
+static void
+pipe_menu_show(struct server *server, struct menuitem *item)
+{
+	struct menu *pipe_parent = item->parent;
+	struct menu *pipe_menu = item->submenu;
 
 	/*
-	 * TODO: refactor validate() and post_processing() to only
-	 * operate from current point onwards
+	 * Set menu-widths before configuring. Only the menus of this
+	 * pipemenu have new items.
 	 */
-
-	/* Set menu-widths before configuring */
-	post_processing(ctx->server);
+	post_processing(server);
 
 	/*
 	 * TODO:
@@ -1118,34 +1632,296 @@ create_pipe_menu(struct pipe_context *ctx)
 	 *     and/or menu_configure()
 	 * (2) Take into account menu_overlap_{x,y}
 	 */
-	enum menu_align align = ctx->item->parent->align;
+	enum menu_align align = item->parent->align;
 	int x = pipe_parent->scene_tree->node.x;
-	int y = pipe_parent->scene_tree->node.y + ctx->item->tree->node.y;
+	int y = pipe_parent->scene_tree->node.y + item->y
+		- pipe_parent->scroll.offset;
 	if (align & LAB_MENU_OPEN_RIGHT) {
 		x += pipe_parent->size.width;
 	}
 	menu_configure(pipe_menu, x, y, align);
 
-	validate(ctx->server);
-
 	/* Finally open the new submenu tree */
 	wlr_scene_node_set_enabled(&pipe_menu->scene_tree->node, true);
 	pipe_parent->selection.menu = pipe_menu;
+}
+
+/*
+ * Set up the parser state for adding items to @pipe_menu. Menus created
+ * while parsing are marked as pipemenus so they are destroyed with it.
+ */
+static bool
+pipe_menu_begin(struct menu *pipe_menu)
+{
+	bool was_waiting = waiting_for_pipe_menu;
+	waiting_for_pipe_menu = true;
+	menu_level++;
+	current_menu = pipe_menu;
+	return was_waiting;
+}
 
-restore_menus:
-	current_menu = pipe_parent;
+static void
+pipe_menu_end(struct menu *pipe_menu, bool was_waiting)
+{
+	current_menu = pipe_menu->parent;
 	menu_level--;
+	waiting_for_pipe_menu = was_waiting;
+}
+
+/*
+ * Cached pipemenu output can be large, so it is parsed and its labels are
+ * measured on a worker thread. The main thread only walks the finished
+ * document to create the items, and menu selection is blocked meanwhile
+ * like for a running pipemenu command.
+ */
+struct pipemenu_parse_job {
+	struct server *server;
+	struct menuitem *item;
+
+	/* Copies, as the worker must not look at anything else */
+	struct buf buf;
+	struct font font;
+
+	/* Results of the worker */
+	xmlDoc *doc;
+	struct int_map labels_by_hash;
+	struct wl_list labels;
+
+	pthread_t thread;
+	int done_fd;
+	struct wl_event_source *event_done;
+};
+
+static struct pipemenu_parse_job *active_parse_job;
+
+static void
+collect_labels(struct pipemenu_parse_job *job, xmlNode *node)
+{
+	for (xmlNode *n = node; n; n = n->next) {
+		if (n->type != XML_ELEMENT_NODE) {
+			continue;
+		}
+		char *text = (char *)xmlGetProp(n, (const xmlChar *)"label");
+		if (text) {
+			uint64_t hash = hash_label(text);
+			if (!int_map_lookup(&job->labels_by_hash, hash)) {
+				struct measured_label *label = znew(*label);
+				label->text = xstrdup(text);
+				int_map_insert(&job->labels_by_hash, hash, label);
+				wl_list_append(&job->labels, &label->link);
+			}
+			xmlFree(text);
+		}
+		collect_labels(job, n->children);
+	}
+}
+
+/* Runs on the worker thread, or on the main one if it cannot be started */
+static void
+parse_job_run(struct pipemenu_parse_job *job)
+{
+	job->doc = xmlReadMemory(job->buf.data, job->buf.len, NULL, NULL, 0);
+	if (!job->doc) {
+		return;
+	}
+	collect_labels(job, xmlDocGetRootElement(job->doc));
+
+	size_t nr = wl_list_length(&job->labels);
+	const char **texts = znew_n(const char *, nr);
+	int *widths = znew_n(int, nr);
+	struct measured_label *label;
+	size_t i = 0;
+	wl_list_for_each(label, &job->labels, link) {
+		texts[i++] = label->text;
+	}
+	font_measure_widths(&job->font, texts, nr, widths);
+	i = 0;
+	wl_list_for_each(label, &job->labels, link) {
+		label->width = widths[i++];
+	}
+	free(texts);
+	free(widths);
+}
+
+static void *
+parse_job_thread(void *data)
+{
+	struct pipemenu_parse_job *job = data;
+	parse_job_run(job);
+	uint64_t one = 1;
+	if (write(job->done_fd, &one, sizeof(one)) != sizeof(one)) {
+		wlr_log_errno(WLR_ERROR, "cannot signal parsed pipemenu");
+	}
+	return NULL;
+}
+
+static void
+parse_job_destroy(struct pipemenu_parse_job *job)
+{
+	if (job->event_done) {
+		wl_event_source_remove(job->event_done);
+	}
+	if (job->done_fd >= 0) {
+		close(job->done_fd);
+	}
+	if (job->doc) {
+		xmlFreeDoc(job->doc);
+	}
+	struct measured_label *label, *tmp;
+	wl_list_for_each_safe(label, tmp, &job->labels, link) {
+		free(label->text);
+		free(label);
+	}
+	int_map_finish(&job->labels_by_hash);
+	if (job->buf.len >= PIPEMENU_TRIM_SIZE) {
+		heap_trim_schedule(job->server);
+	}
+	buf_reset(&job->buf);
+	free(job->font.name);
+	free(job);
+}
+
+/* Create the menus from the parsed document, on the main thread */
+static void
+parse_job_install(struct pipemenu_parse_job *job)
+{
+	struct menuitem *item = job->item;
+	if (!job->doc) {
+		wlr_log(WLR_ERROR, "[pipemenu %s] invalid xml from %s",
+			item->id, item->execute);
+		return;
+	}
+	struct menu *pipe_menu = pipe_menu_create(job->server, item);
+	if (!pipe_menu) {
+		return;
+	}
+
+	measured_labels = &job->labels_by_hash;
+	bool was_waiting = pipe_menu_begin(pipe_menu);
+	xml_tree_walk(xmlDocGetRootElement(job->doc), job->server);
+	pipe_menu_end(pipe_menu, was_waiting);
+	measured_labels = NULL;
+
+	pipe_menu_show(job->server, item);
+	prefetch_pipemenus(pipe_menu);
+}
+
+static int
+handle_parse_job_done(int fd, uint32_t mask, void *data)
+{
+	struct pipemenu_parse_job *job = data;
+	assert(job == active_parse_job);
+	pthread_join(job->thread, NULL);
+	active_parse_job = NULL;
+	waiting_for_pipe_menu = false;
+
+	parse_job_install(job);
+	parse_job_destroy(job);
+	return 0;
+}
+
+static bool
+parse_job_start(struct pipemenu_parse_job *job)
+{
+	job->done_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (job->done_fd < 0) {
+		wlr_log_errno(WLR_ERROR, "cannot create eventfd");
+		return false;
+	}
+
+	/* libxml2 sets up its global state on first use otherwise */
+	xmlInitParser();
+
+	/* Signals are handled by the event loop of the main thread */
+	sigset_t mask, old_mask;
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, &old_mask);
+	int ret = pthread_create(&job->thread, NULL, parse_job_thread, job);
+	pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+	if (ret) {
+		wlr_log(WLR_ERROR, "failed to start pipemenu parser thread: %s",
+			strerror(ret));
+		return false;
+	}
+	job->event_done = wl_event_loop_add_fd(job->server->wl_event_loop,
+		job->done_fd, WL_EVENT_READABLE, handle_parse_job_done, job);
+	return true;
+}
+
+/* Wait for the worker and drop its results as the menu has been closed */
+static void
+parse_job_abort(void)
+{
+	struct pipemenu_parse_job *job = active_parse_job;
+	if (!job) {
+		return;
+	}
+	pthread_join(job->thread, NULL);
+	active_parse_job = NULL;
+	waiting_for_pipe_menu = false;
+	parse_job_destroy(job);
 }
 
+static void
+create_pipe_menu(struct server *server, struct menuitem *item,
+		struct buf *buf)
+{
+	if (!menu_is_open(item->parent)) {
+		wlr_log(WLR_ERROR, "[pipemenu %s] parent menu already closed",
+			item->id);
+		return;
+	}
+
+	struct pipemenu_parse_job *job = znew(*job);
+	job->server = server;
+	job->item = item;
+	job->buf = BUF_INIT;
+	buf_add(&job->buf, buf->data);
+	job->font = rc.font_menuitem;
+	job->font.name = xstrdup(rc.font_menuitem.name);
+	wl_list_init(&job->labels);
+	job->done_fd = -1;
+
+	if (!parse_job_start(job)) {
+		/* Do the same work right away */
+		parse_job_run(job);
+		parse_job_install(job);
+		parse_job_destroy(job);
+		return;
+	}
+	active_parse_job = job;
+	waiting_for_pipe_menu = true;
+}
+
+/* The foreground pipemenu, if any, which blocks menu selection */
+static struct pipe_context *active_pipe_ctx;
+
 static void
 pipemenu_ctx_destroy(struct pipe_context *ctx)
 {
 	wl_event_source_remove(ctx->event_read);
 	wl_event_source_remove(ctx->event_timeout);
-	spawn_piped_close(ctx->pid, ctx->pipe_fd);
+	spawn_piped_close(ctx->child, ctx->pipe_fd);
+	if (ctx->parser) {
+		xmlFreeDoc(ctx->parser->myDoc);
+		xmlFreeParserCtxt(ctx->parser);
+	}
+	if (ctx->item) {
+		waiting_for_pipe_menu = false;
+		active_pipe_ctx = NULL;
+	} else {
+		struct pipemenu_cache_entry *entry =
+			pipemenu_cache_find(ctx->execute);
+		if (entry) {
+			entry->refreshing = false;
+		}
+	}
+	if (ctx->buf.len >= PIPEMENU_TRIM_SIZE) {
+		heap_trim_schedule(ctx->server);
+	}
 	buf_reset(&ctx->buf);
+	free(ctx->execute);
 	free(ctx);
-	waiting_for_pipe_menu = false;
 }
 
 static int
@@ -1153,18 +1929,122 @@ handle_pipemenu_timeout(void *_ctx)
 {
 	struct pipe_context *ctx = _ctx;
 	wlr_log(WLR_ERROR, "[pipemenu %ld] timeout reached, killing %s",
-		(long)ctx->pid, ctx->item->execute);
-	kill(ctx->pid, SIGTERM);
+		(long)spawn_piped_pid(ctx->child), ctx->execute);
+	spawn_piped_kill(ctx->child, SIGTERM);
 	pipemenu_ctx_destroy(ctx);
 	return 0;
 }
 
+static void
+pipemenu_abort(void)
+{
+	parse_job_abort();
+
+	struct pipe_context *ctx = active_pipe_ctx;
+	if (!ctx) {
+		return;
+	}
+	wlr_log(WLR_DEBUG, "[pipemenu %ld] menu closed, killing %s",
+		(long)spawn_piped_pid(ctx->child), ctx->execute);
+	spawn_piped_kill(ctx->child, SIGTERM);
+	pipemenu_ctx_destroy(ctx);
+}
+
 static bool
 starts_with_less_than(const char *s)
 {
 	return (s + strspn(s, " \t\r\n"))[0] == '<';
 }
 
+/*
+ * Create items for the elements below <openbox_pipe_menu> which have been
+ * parsed completely and drop them from the document. The last child is
+ * still being parsed unless the parser is back at the root element.
+ */
+static bool
+pipemenu_stream_update(struct pipe_context *ctx, bool done)
+{
+	xmlDoc *doc = ctx->parser->myDoc;
+	xmlNode *root = doc ? xmlDocGetRootElement(doc) : NULL;
+	if (!root) {
+		return true;
+	}
+
+	bool added = false;
+	xmlNode *n, *next;
+	for (n = root->children; n; n = next) {
+		next = n->next;
+		bool complete = next || done || (ctx->parser->node == root
+			&& n->type != XML_TEXT_NODE);
+		if (!complete) {
+			break;
+		}
+		xmlUnlinkNode(n);
+		if (n->type == XML_ELEMENT_NODE) {
+			if (!ctx->menu) {
+				ctx->menu = pipe_menu_create(ctx->server, ctx->item);
+				if (!ctx->menu) {
+					xmlFreeNode(n);
+					return false;
+				}
+			}
+			bool was_waiting = pipe_menu_begin(ctx->menu);
+			xml_tree_walk(n, ctx->server);
+			pipe_menu_end(ctx->menu, was_waiting);
+			added = true;
+		}
+		xmlFreeNode(n);
+	}
+
+	if (done && !ctx->menu) {
+		/* Well-formed but empty */
+		ctx->menu = pipe_menu_create(ctx->server, ctx->item);
+		added = !!ctx->menu;
+	}
+	if (added) {
+		if (!menu_is_open(ctx->item->parent)) {
+			wlr_log(WLR_ERROR, "[pipemenu %s] parent menu already closed",
+				ctx->item->id);
+			return false;
+		}
+		pipe_menu_show(ctx->server, ctx->item);
+	}
+	return true;
+}
+
+/* Feed @size bytes of @data to the push parser, NULL to finish parsing */
+static bool
+pipemenu_stream(struct pipe_context *ctx, const char *data, ssize_t size)
+{
+	if (!ctx->parser) {
+		/* Wait for the first non-whitespace character */
+		if (data && !ctx->buf.data[strspn(ctx->buf.data, " \t\r\n")]) {
+			return true;
+		}
+		/* Guard against badly formed data such as binary input */
+		if (!starts_with_less_than(ctx->buf.data)) {
+			wlr_log(WLR_ERROR, "expect xml data to start with '<'; abort pipemenu");
+			return false;
+		}
+		ctx->parser = xmlCreatePushParserCtxt(NULL, NULL, NULL, 0, NULL);
+		if (!ctx->parser) {
+			wlr_log(WLR_ERROR, "xmlCreatePushParserCtxt()");
+			return false;
+		}
+		/* Start with everything read so far */
+		data = ctx->buf.data;
+		size = ctx->buf.len;
+	}
+
+	bool done = !data;
+	if (xmlParseChunk(ctx->parser, data, done ? 0 : size, done)) {
+		wlr_log(WLR_ERROR, "[pipemenu %ld] invalid xml from %s",
+			(long)spawn_piped_pid(ctx->child), ctx->execute);
+		return false;
+	}
+	return pipemenu_stream_update(ctx, done);
+}
+
 static int
 handle_pipemenu_readable(int fd, uint32_t mask, void *_ctx)
 {
@@ -1180,60 +2060,91 @@ handle_pipemenu_readable(int fd, uint32_t mask, void *_ctx)
 
 	if (size == -1) {
 		wlr_log_errno(WLR_ERROR, "[pipemenu %ld] failed to read data (%s)",
-			(long)ctx->pid, ctx->item->execute);
+			(long)spawn_piped_pid(ctx->child), ctx->execute);
 		goto clean_up;
 	}
 
 	/* Limit pipemenu buffer to 1 MiB for safety */
 	if (ctx->buf.len + size > PIPEMENU_MAX_BUF_SIZE) {
 		wlr_log(WLR_ERROR, "[pipemenu %ld] too big (> %d bytes); killing %s",
-			(long)ctx->pid, PIPEMENU_MAX_BUF_SIZE, ctx->item->execute);
-		kill(ctx->pid, SIGTERM);
+			(long)spawn_piped_pid(ctx->child), PIPEMENU_MAX_BUF_SIZE,
+			ctx->execute);
+		spawn_piped_kill(ctx->child, SIGTERM);
 		goto clean_up;
 	}
 
-	wlr_log(WLR_DEBUG, "[pipemenu %ld] read %ld bytes of data", (long)ctx->pid, size);
+	wlr_log(WLR_DEBUG, "[pipemenu %ld] read %ld bytes of data",
+		(long)spawn_piped_pid(ctx->child), size);
 	if (size) {
 		data[size] = '\0';
 		buf_add(&ctx->buf, data);
+		if (!ctx->item) {
+			return 0;
+		}
+		if (!pipemenu_stream(ctx, data, size)) {
+			spawn_piped_kill(ctx->child, SIGTERM);
+			goto clean_up;
+		}
+		/* Only give up on generators which stop producing output */
+		wl_event_source_timer_update(ctx->event_timeout,
+			PIPEMENU_TIMEOUT_IN_MS);
 		return 0;
 	}
 
-	/* Guard against badly formed data such as binary input */
-	if (!starts_with_less_than(ctx->buf.data)) {
+	if (ctx->item) {
+		if (!pipemenu_stream(ctx, NULL, 0)) {
+			goto clean_up;
+		}
+	} else if (!starts_with_less_than(ctx->buf.data)) {
+		/* Guard against badly formed data such as binary input */
 		wlr_log(WLR_ERROR, "expect xml data to start with '<'; abort pipemenu");
 		goto clean_up;
 	}
 
-	create_pipe_menu(ctx);
+	if (!ctx->item || ctx->item->cache_time) {
+		struct pipemenu_cache_entry *entry =
+			pipemenu_cache_find(ctx->execute);
+		if (!entry) {
+			entry = znew(*entry);
+			entry->execute = xstrdup(ctx->execute);
+			entry->buf = BUF_INIT;
+			wl_list_insert(&pipemenu_cache, &entry->link);
+		}
+		buf_clear(&entry->buf);
+		buf_add(&entry->buf, ctx->buf.data);
+		entry->updated_nsec = time_now_nsec();
+	}
+	if (ctx->menu) {
+		prefetch_pipemenus(ctx->menu);
+	}
 
 clean_up:
 	pipemenu_ctx_destroy(ctx);
 	return 0;
 }
 
-static void
-parse_pipemenu(struct menuitem *item)
+/* Spawn the pipemenu command, @item is NULL to only update the cache */
+static bool
+spawn_pipemenu(struct server *server, struct menuitem *item,
+		const char *execute)
 {
-	if (!is_unique_id(item->parent->server, item->id)) {
-		wlr_log(WLR_ERROR, "duplicate id '%s'; abort pipemenu", item->id);
-		return;
-	}
-
 	int pipe_fd = 0;
-	pid_t pid = spawn_piped(item->execute, &pipe_fd);
-	if (pid <= 0) {
-		wlr_log(WLR_ERROR, "Failed to spawn pipe menu process %s", item->execute);
-		return;
+	struct spawn_piped_child *child = spawn_piped(execute, &pipe_fd);
+	if (!child) {
+		wlr_log(WLR_ERROR, "Failed to spawn pipe menu process %s", execute);
+		return false;
 	}
 
-	waiting_for_pipe_menu = true;
 	struct pipe_context *ctx = znew(*ctx);
-	ctx->server = item->parent->server;
+	ctx->server = server;
 	ctx->item = item;
-	ctx->pid = pid;
+	ctx->execute = xstrdup(execute);
+	ctx->child = child;
 	ctx->pipe_fd = pipe_fd;
 	ctx->buf = BUF_INIT;
+	if (item) {
+		active_pipe_ctx = ctx;
+	}
 
 	ctx->event_read = wl_event_loop_add_fd(ctx->server->wl_event_loop,
 		pipe_fd, WL_EVENT_READABLE, handle_pipemenu_readable, ctx);
@@ -1242,7 +2153,72 @@ parse_pipemenu(struct menuitem *item)
 		handle_pipemenu_timeout, ctx);
 	wl_event_source_timer_update(ctx->event_timeout, PIPEMENU_TIMEOUT_IN_MS);
 
-	wlr_log(WLR_DEBUG, "[pipemenu %ld] executed: %s", (long)ctx->pid, ctx->item->execute);
+	wlr_log(WLR_DEBUG, "[pipemenu %ld] executed: %s",
+		(long)spawn_piped_pid(ctx->child), ctx->execute);
+	return true;
+}
+
+static void
+refresh_pipemenu(struct server *server, const char *execute)
+{
+	struct pipemenu_cache_entry *entry = pipemenu_cache_find(execute);
+	if (entry && entry->refreshing) {
+		return;
+	}
+	if (!spawn_pipemenu(server, /* item */ NULL, execute)) {
+		return;
+	}
+	if (!entry) {
+		/* Placeholder, only used once the output has been read */
+		entry = znew(*entry);
+		entry->execute = xstrdup(execute);
+		entry->buf = BUF_INIT;
+		wl_list_insert(&pipemenu_cache, &entry->link);
+	}
+	entry->refreshing = true;
+}
+
+/* Run cached pipemenus of a menu that was just opened ahead of time */
+static void
+prefetch_pipemenus(struct menu *menu)
+{
+	struct menuitem *item;
+	wl_list_for_each(item, &menu->menuitems, link) {
+		if (!item->execute || item->submenu || !item->cache_time) {
+			continue;
+		}
+		struct pipemenu_cache_entry *entry =
+			pipemenu_cache_find(item->execute);
+		if (!entry || pipemenu_cache_is_stale(entry, item->cache_time)) {
+			refresh_pipemenu(menu->server, item->execute);
+		}
+	}
+}
+
+static void
+parse_pipemenu(struct menuitem *item)
+{
+	struct server *server = item->parent->server;
+	if (!is_unique_id(server, item->id)) {
+		wlr_log(WLR_ERROR, "duplicate id '%s'; abort pipemenu", item->id);
+		return;
+	}
+
+	if (item->cache_time) {
+		struct pipemenu_cache_entry *entry =
+			pipemenu_cache_find(item->execute);
+		if (entry && entry->updated_nsec) {
+			if (pipemenu_cache_is_stale(entry, item->cache_time)) {
+				refresh_pipemenu(server, item->execute);
+			}
+			create_pipe_menu(server, item, &entry->buf);
+			return;
+		}
+	}
+
+	if (spawn_pipemenu(server, item, item->execute)) {
+		waiting_for_pipe_menu = true;
+	}
 }
 
 static void
@@ -1258,6 +2234,9 @@ menu_process_item_selection(struct menuitem *item)
 	if (waiting_for_pipe_menu) {
 		return;
 	}
+
+	/* Keyboard navigation may select items out of view */
+	menu_scroll_into_view(item);
 	selected_item = item;
 
 	if (!item->selectable) {
@@ -1284,8 +2263,10 @@ menu_process_item_selection(struct menuitem *item)
 		/* Ensure the submenu has its parent set correctly */
 		item->submenu->parent = item->parent;
 		/* And open the new submenu tree */
+		menu_configure_submenu(item);
 		wlr_scene_node_set_enabled(
 			&item->submenu->scene_tree->node, true);
+		prefetch_pipemenus(item->submenu);
 	}
 
 	item->parent->selection.menu = item->submenu;
@@ -1388,6 +2369,127 @@ menu_item_select_previous(struct server *server)
 	menu_item_select(server, /* forward */ false);
 }
 
+static int
+compare_search_entries(const void *a, const void *b)
+{
+	const struct menuitem *item_a = *(struct menuitem *const *)a;
+	const struct menuitem *item_b = *(struct menuitem *const *)b;
+	int ret = strcasecmp(item_a->text, item_b->text);
+	/* Keep items with the same label in menu order */
+	return ret ? ret : (item_a->y > item_b->y) - (item_a->y < item_b->y);
+}
+
+static void
+menu_build_search_index(struct menu *menu)
+{
+	menu->search_index = znew_n(*menu->search_index,
+		wl_list_length(&menu->menuitems));
+	menu->search_index_len = 0;
+	struct menuitem *item;
+	wl_list_for_each(item, &menu->menuitems, link) {
+		if (item->selectable && item->text) {
+			menu->search_index[menu->search_index_len++] = item;
+		}
+	}
+	qsort(menu->search_index, menu->search_index_len,
+		sizeof(*menu->search_index), compare_search_entries);
+}
+
+/*
+ * Find the first item at or after @start_y (wrapping around) whose label
+ * starts with @len bytes of @prefix. Matching labels are adjacent in the
+ * search index, so only those are looked at.
+ */
+static struct menuitem *
+menu_search(struct menu *menu, const char *prefix, size_t len, int start_y)
+{
+	if (!menu->search_index) {
+		menu_build_search_index(menu);
+	}
+
+	/* Lower bound of the matching labels */
+	int lo = 0, hi = menu->search_index_len;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (strncasecmp(menu->search_index[mid]->text, prefix, len) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	struct menuitem *best = NULL;
+	int best_distance = 0;
+	for (int i = lo; i < menu->search_index_len; i++) {
+		struct menuitem *item = menu->search_index[i];
+		if (strncasecmp(item->text, prefix, len)) {
+			break;
+		}
+		int distance = item->y - start_y;
+		if (distance < 0) {
+			distance += menu->size.height;
+		}
+		if (!best || distance < best_distance) {
+			best = item;
+			best_distance = distance;
+		}
+	}
+	return best;
+}
+
+void
+menu_type_ahead(struct server *server, const char *text)
+{
+	struct menu *menu = get_selection_leaf(server);
+	size_t len = strlen(text);
+	if (!menu || !len) {
+		return;
+	}
+
+	int64_t now = time_now_nsec();
+	if (menu != type_ahead.menu
+			|| now - type_ahead.last_nsec > MENU_TYPE_AHEAD_TIMEOUT_NSEC) {
+		type_ahead.len = 0;
+		type_ahead.menu = menu;
+	}
+	type_ahead.last_nsec = now;
+	if (type_ahead.len + len >= sizeof(type_ahead.text)) {
+		return;
+	}
+	memcpy(type_ahead.text + type_ahead.len, text, len + 1);
+	type_ahead.len += len;
+
+	/*
+	 * Typing the same character again cycles through the items
+	 * starting with it, otherwise the selection is kept while it
+	 * still matches.
+	 */
+	struct menuitem *selection = menu->selection.item;
+	int start_y = selection ? selection->y : 0;
+	const char *prefix = type_ahead.text;
+	size_t prefix_len = type_ahead.len;
+	bool repeated = true;
+	for (size_t i = len; i < type_ahead.len; i++) {
+		if (type_ahead.text[i] != type_ahead.text[i % len]) {
+			repeated = false;
+			break;
+		}
+	}
+	if (repeated && type_ahead.len > len) {
+		prefix_len = len;
+		start_y += 1;
+	}
+
+	struct menuitem *item = menu_search(menu, prefix, prefix_len, start_y);
+	if (!item) {
+		/* Forget the text which did not match anything */
+		type_ahead.len -= len;
+		type_ahead.text[type_ahead.len] = '\0';
+		return;
+	}
+	menu_process_item_selection(item);
+}
+
 bool
 menu_call_selected_actions(struct server *server)
 {
@@ -1443,6 +2545,33 @@ menu_process_cursor_motion(struct wlr_scene_node *node)
 	menu_process_item_selection(item);
 }
 
+void
+menu_process_scroll(struct wlr_scene_node *node, int delta)
+{
+	assert(node && node->data);
+	struct menu *menu = node_menuitem_from_node(node)->parent;
+	if (!menu->scroll.height) {
+		return;
+	}
+
+	/* Scroll by whole items, starting from the first one in view */
+	struct menuitem *item;
+	wl_list_for_each(item, &menu->menuitems, link) {
+		if (item->y >= menu->scroll.offset) {
+			break;
+		}
+	}
+	struct wl_list *link = &item->link;
+	for (; delta > 0 && link->next != &menu->menuitems; delta--) {
+		link = link->next;
+	}
+	for (; delta < 0 && link->prev != &menu->menuitems; delta++) {
+		link = link->prev;
+	}
+	item = wl_container_of(link, item, link);
+	menu_scroll_to(menu, item->y);
+}
+
 bool
 menu_call_actions(struct wlr_scene_node *node)
 {
@@ -1464,9 +2593,45 @@ menu_close_root(struct server *server)
 	server->input_mode = LAB_INPUT_STATE_PASSTHROUGH;
 }
 
+/* Re-measure all items and drop their scene nodes for a new theme or font */
+static void
+menu_relayout(struct server *server)
+{
+	struct menu *menu;
+	wl_list_for_each(menu, &server->menus, link) {
+		menu->item_height = 0;
+		menu->size.height = 0;
+		menu->scroll.offset = 0;
+		struct menuitem *item;
+		wl_list_for_each(item, &menu->menuitems, link) {
+			item_destroy_scene(item);
+			item_measure(item);
+			item->y = menu->size.height;
+			menu->size.height += item->height;
+		}
+	}
+	post_processing(server);
+}
+
 void
 menu_reconfigure(struct server *server)
 {
+	/*
+	 * Menus parsed from unchanged files are kept. Their items only
+	 * need new scene nodes if the theme or font changed, and those
+	 * are created once the menus are shown again.
+	 */
+	if (!server->menu_current
+			&& hash_menu_files("menu.xml") == menu_files_hash) {
+		uint64_t style_hash = hash_menu_style(server->theme);
+		if (style_hash != menu_style_hash) {
+			menu_relayout(server);
+			menu_style_hash = style_hash;
+		}
+		wlr_log(WLR_DEBUG, "menu files unchanged, not parsing them again");
+		return;
+	}
+
 	menu_finish(server);
 	server->menu_current = NULL;
 	menu_init(server);
@@ -1,9 +1,11 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include <assert.h>
 #include <stdlib.h>
-#include "common/mem.h"
+#include "common/pool.h"
 #include "node.h"
 
+static struct pool descriptors = POOL_INIT(struct node_descriptor);
+
 static void
 descriptor_destroy(struct node_descriptor *node_descriptor)
 {
@@ -11,7 +13,7 @@ descriptor_destroy(struct node_descriptor *node_descriptor)
 		return;
 	}
 	wl_list_remove(&node_descriptor->destroy.link);
-	free(node_descriptor);
+	pool_free(&descriptors, node_descriptor);
 }
 
 static void
@@ -26,7 +28,7 @@ void
 node_descriptor_create(struct wlr_scene_node *scene_node,
 		enum node_descriptor_type type, void *data)
 {
-	struct node_descriptor *node_descriptor = znew(*node_descriptor);
+	struct node_descriptor *node_descriptor = pool_alloc(&descriptors);
 	node_descriptor->type = type;
 	node_descriptor->data = data;
 	node_descriptor->destroy.notify = destroy_notify;
@@ -79,3 +81,9 @@ node_ssd_button_from_node(struct wlr_scene_node *wlr_scene_node)
 	assert(node_descriptor->type == LAB_NODE_DESC_SSD_BUTTON);
 	return (struct ssd_button *)node_descriptor->data;
 }
+
+void
+node_descriptors_finish(void)
+{
+	pool_finish(&descriptors);
+}
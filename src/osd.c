@@ -2,8 +2,10 @@
 #include "config.h"
 #include <assert.h>
 #include <cairo.h>
+#include <ctype.h>
 #include <drm_fourcc.h>
 #include <pango/pangocairo.h>
+#include <string.h>
 #include <wlr/util/log.h>
 #include <wlr/util/box.h>
 #include "buffer.h"
@@ -11,8 +13,12 @@
 #include "common/buf.h"
 #include "common/font.h"
 #include "common/graphic-helpers.h"
+#include "common/macros.h"
+#include "common/mem.h"
 #include "common/scene-helpers.h"
+#include "common/trace.h"
 #include "config/rcxml.h"
+#include "heap-trim.h"
 #include "labwc.h"
 #include "node.h"
 #include "osd.h"
@@ -21,6 +27,12 @@
 #include "window-rules.h"
 #include "workspaces.h"
 
+/* Maximum size of the cells of the thumbnail strip */
+#define OSD_THUMBNAIL_SIZE 160
+#define OSD_THUMBNAIL_MIN_SIZE 16
+#define OSD_THUMBNAIL_MARGIN(theme) \
+	(2 * (theme)->osd_window_switcher_item_active_border_width)
+
 static void
 destroy_osd_nodes(struct output *output)
 {
@@ -29,6 +41,9 @@ destroy_osd_nodes(struct output *output)
 	wl_list_for_each_safe(child, next, children, link) {
 		wlr_scene_node_destroy(child);
 	}
+	output->osd_highlight = NULL;
+	output->osd_thumbnail_highlight = NULL;
+	zfree(output->osd_content);
 }
 
 static void
@@ -52,6 +67,7 @@ osd_update_preview_outlines(struct view *view)
 	struct wlr_box geo = ssd_max_extents(view);
 	multi_rect_set_size(rect, geo.width, geo.height);
 	wlr_scene_node_set_position(&rect->tree->node, geo.x, geo.y);
+	wlr_scene_node_set_enabled(&rect->tree->node, true);
 }
 
 void
@@ -102,6 +118,16 @@ osd_on_view_destroy(struct view *view)
 	}
 }
 
+void
+osd_reconfigure(struct server *server)
+{
+	/* Recreated with the new theme on the next window cycle */
+	if (server->osd_state.preview_outline) {
+		wlr_scene_node_destroy(&server->osd_state.preview_outline->tree->node);
+		server->osd_state.preview_outline = NULL;
+	}
+}
+
 void
 osd_finish(struct server *server)
 {
@@ -114,13 +140,20 @@ osd_finish(struct server *server)
 		wlr_scene_node_set_enabled(&output->osd_tree->node, false);
 	}
 	if (server->osd_state.preview_outline) {
-		/* Destroy the whole multi_rect so we can easily react to new themes */
-		wlr_scene_node_destroy(&server->osd_state.preview_outline->tree->node);
-		server->osd_state.preview_outline = NULL;
+		/* Kept for the next window cycle, see osd_reconfigure() */
+		wlr_scene_node_set_enabled(
+			&server->osd_state.preview_outline->tree->node, false);
 	}
 
 	/* Hiding OSD may need a cursor change */
 	cursor_update_focus(server);
+	cursor_settle_focus(server);
+
+	wl_array_release(&server->osd_state.views);
+	wl_array_init(&server->osd_state.views);
+	server->osd_state.filter[0] = '\0';
+	/* Rendering the switcher and its thumbnails leaves freed memory */
+	heap_trim_schedule(server);
 
 	/*
 	 * We delay resetting cycle_view until after cursor_update_focus()
@@ -158,6 +191,21 @@ osd_preview_restore(struct server *server)
 	}
 }
 
+/*
+ * Raising the selected window above a fullscreen game or video would
+ * take that output off direct scanout just for a preview, so it is only
+ * outlined there.
+ */
+static bool
+preview_allowed(struct view *view)
+{
+	if (!output_is_usable(view->output)) {
+		return true;
+	}
+	struct view *fullscreen = output_get_fullscreen_view(view->output);
+	return !fullscreen || fullscreen == view || !view_shows_media(fullscreen);
+}
+
 static void
 preview_cycled_view(struct view *view)
 {
@@ -201,10 +249,8 @@ preview_cycled_view(struct view *view)
 
 static void
 render_osd(struct server *server, cairo_t *cairo, int w, int h,
-		bool show_workspace, const char *workspace_name,
-		struct wl_array *views)
+		const char *header, struct wl_array *views)
 {
-	struct view *cycle_view = server->osd_state.cycle_view;
 	struct theme *theme = server->theme;
 
 	cairo_surface_t *surf = cairo_get_target(cairo);
@@ -234,16 +280,16 @@ render_osd(struct server *server, cairo_t *cairo, int w, int h,
 
 	int y = theme->osd_border_width + theme->osd_window_switcher_padding;
 
-	/* Draw workspace indicator */
-	if (show_workspace) {
-		/* Center workspace indicator on the x axis */
-		int x = font_width(&rc.font_osd, workspace_name);
+	/* Draw workspace indicator or filter */
+	if (header) {
+		/* Center it on the x axis */
+		int x = font_width(&rc.font_osd, header);
 		x = (w - x) / 2;
 		cairo_move_to(cairo, x, y + theme->osd_window_switcher_item_active_border_width);
 		PangoWeight weight = pango_font_description_get_weight(desc);
 		pango_font_description_set_weight(desc, PANGO_WEIGHT_BOLD);
 		pango_layout_set_font_description(layout, desc);
-		pango_layout_set_text(layout, workspace_name, -1);
+		pango_layout_set_text(layout, header, -1);
 		pango_cairo_show_layout(cairo, layout);
 		pango_font_description_set_weight(desc, weight);
 		pango_layout_set_font_description(layout, desc);
@@ -301,21 +347,6 @@ render_osd(struct server *server, cairo_t *cairo, int w, int h,
 			x += field_width + theme->osd_window_switcher_item_padding_x;
 		}
 
-		if (*view == cycle_view) {
-			/* Highlight current window */
-			struct wlr_fbox fbox = {
-				.x = theme->osd_border_width + theme->osd_window_switcher_padding,
-				.y = y,
-				.width = w
-					- 2 * theme->osd_border_width
-					- 2 * theme->osd_window_switcher_padding,
-				.height = theme->osd_window_switcher_item_height,
-			};
-			draw_cairo_border(cairo, fbox,
-				theme->osd_window_switcher_item_active_border_width);
-			cairo_stroke(cairo);
-		}
-
 		y += theme->osd_window_switcher_item_height;
 	}
 	buf_reset(&buf);
@@ -324,13 +355,204 @@ render_osd(struct server *server, cairo_t *cairo, int w, int h,
 	cairo_surface_flush(surf);
 }
 
+static void
+render_highlight(struct theme *theme, cairo_t *cairo, int w, int h)
+{
+	set_cairo_color(cairo, theme->osd_label_text_color);
+	struct wlr_fbox fbox = {
+		.width = w,
+		.height = h,
+	};
+	draw_cairo_border(cairo, fbox,
+		theme->osd_window_switcher_item_active_border_width);
+	cairo_surface_flush(cairo_get_target(cairo));
+}
+
+/*
+ * Everything the rows are rendered from. Cycling only changes which row
+ * is highlighted, so the rows are only rendered again if this changes.
+ * Outputs with the same content share their buffers.
+ */
+static void
+get_osd_content(struct buf *buf, struct output *output, int w, int h,
+		const char *header, struct wl_array *views)
+{
+	char geometry[64];
+	snprintf(geometry, sizeof(geometry), "%d %d %d %f\n", w, h,
+		output->usable_area.width, output->wlr_output->scale);
+	buf_add(buf, geometry);
+	if (header) {
+		buf_add(buf, header);
+		buf_add_char(buf, '\n');
+	}
+
+	struct buf field_buf = BUF_INIT;
+	struct view **view;
+	wl_array_for_each(view, views) {
+		struct window_switcher_field *field;
+		wl_list_for_each(field, &rc.window_switcher.fields, link) {
+			buf_clear(&field_buf);
+			osd_field_get_content(field, &field_buf, *view);
+			buf_add(buf, field_buf.data);
+			buf_add_char(buf, '\t');
+		}
+		buf_add_char(buf, '\n');
+	}
+	buf_reset(&field_buf);
+}
+
+/* Rendered rows other outputs could use instead of rendering them again */
+static struct output *
+find_osd_content(struct server *server, const char *content)
+{
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (output->osd_content && output->osd_buffer
+				&& !strcmp(output->osd_content, content)) {
+			return output;
+		}
+	}
+	return NULL;
+}
+
+/* Each output holds a lock on the buffers it shows */
+static void
+set_osd_buffers(struct output *output, struct lab_data_buffer *buffer,
+		struct lab_data_buffer *highlight_buffer)
+{
+	if (buffer) {
+		wlr_buffer_lock(&buffer->base);
+	}
+	if (highlight_buffer) {
+		wlr_buffer_lock(&highlight_buffer->base);
+	}
+	if (output->osd_buffer) {
+		wlr_buffer_unlock(&output->osd_buffer->base);
+	}
+	if (output->osd_highlight_buffer) {
+		wlr_buffer_unlock(&output->osd_highlight_buffer->base);
+	}
+	output->osd_buffer = buffer;
+	output->osd_highlight_buffer = highlight_buffer;
+}
+
+/* Returns the size of a thumbnail cell or 0 if there are too many views */
+static int
+thumbnail_cell_size(struct output *output, int nr_views)
+{
+	struct theme *theme = output->server->theme;
+	int available = output->usable_area.width
+		- 2 * theme->osd_border_width
+		- 2 * theme->osd_window_switcher_padding;
+	int size = MIN(OSD_THUMBNAIL_SIZE, available / MAX(1, nr_views));
+	if (size < 2 * OSD_THUMBNAIL_MARGIN(theme) + OSD_THUMBNAIL_MIN_SIZE) {
+		return 0;
+	}
+	return size;
+}
+
+/*
+ * Adds a strip of live thumbnails above the switcher. The highlight
+ * behind the selected thumbnail is positioned by move_highlight().
+ */
+static void
+create_thumbnails(struct output *output, struct wlr_scene_tree *parent,
+		struct wl_array *views, int osd_width)
+{
+	struct theme *theme = output->server->theme;
+	int nr_views = wl_array_len(views);
+	int cell = thumbnail_cell_size(output, nr_views);
+	if (!cell) {
+		return;
+	}
+
+	int border = theme->osd_border_width;
+	int padding = theme->osd_window_switcher_padding;
+	int width = nr_views * cell + 2 * padding + 2 * border;
+	int height = cell + 2 * padding + 2 * border;
+
+	struct wlr_scene_tree *tree = wlr_scene_tree_create(parent);
+	wlr_scene_node_set_position(&tree->node,
+		(osd_width - width) / 2, -height - padding);
+
+	wlr_scene_rect_create(tree, width, height, theme->osd_border_color);
+	struct wlr_scene_rect *bg = wlr_scene_rect_create(tree,
+		width - 2 * border, height - 2 * border, theme->osd_bg_color);
+	wlr_scene_node_set_position(&bg->node, border, border);
+
+	int active_border = theme->osd_window_switcher_item_active_border_width;
+	struct wlr_scene_tree *highlight = wlr_scene_tree_create(tree);
+	wlr_scene_rect_create(highlight, cell, cell,
+		theme->osd_label_text_color);
+	struct wlr_scene_rect *inner = wlr_scene_rect_create(highlight,
+		cell - 2 * active_border, cell - 2 * active_border,
+		theme->osd_bg_color);
+	wlr_scene_node_set_position(&inner->node, active_border, active_border);
+	output->osd_thumbnail_highlight = highlight;
+
+	int margin = OSD_THUMBNAIL_MARGIN(theme);
+	int x = border + padding + margin;
+	struct view **view;
+	wl_array_for_each(view, views) {
+		struct wlr_scene_tree *cell_tree = wlr_scene_tree_create(tree);
+		wlr_scene_node_set_position(&cell_tree->node,
+			x, border + padding + margin);
+		osd_thumbnail_create(cell_tree, *view,
+			cell - 2 * margin, cell - 2 * margin);
+		x += cell;
+	}
+}
+
+static void
+move_highlight(struct output *output, struct wl_array *views,
+		bool show_header)
+{
+	struct theme *theme = output->server->theme;
+	struct view *cycle_view = output->server->osd_state.cycle_view;
+	struct wlr_scene_node *osd_node = &output->osd_highlight->node;
+	struct wlr_scene_node *thumbnail_node = output->osd_thumbnail_highlight
+		? &output->osd_thumbnail_highlight->node : NULL;
+
+	int index = 0;
+	struct view **view;
+	wl_array_for_each(view, views) {
+		if (*view == cycle_view) {
+			break;
+		}
+		index++;
+	}
+	bool found = index < (int)wl_array_len(views);
+	wlr_scene_node_set_enabled(osd_node, found);
+	if (thumbnail_node) {
+		wlr_scene_node_set_enabled(thumbnail_node, found);
+	}
+	if (!found) {
+		return;
+	}
+
+	int offset = theme->osd_border_width + theme->osd_window_switcher_padding;
+	int row = show_header ? index + 1 : index;
+	wlr_scene_node_set_position(osd_node, offset,
+		offset + row * theme->osd_window_switcher_item_height);
+	if (thumbnail_node) {
+		int cell = thumbnail_cell_size(output, wl_array_len(views));
+		wlr_scene_node_set_position(thumbnail_node,
+			offset + index * cell, offset);
+	}
+}
+
 static void
 display_osd(struct output *output, struct wl_array *views)
 {
 	struct server *server = output->server;
 	struct theme *theme = server->theme;
-	bool show_workspace = wl_list_length(&rc.workspace_config.workspaces) > 1;
-	const char *workspace_name = server->workspace_current->name;
+	/* The filter replaces the workspace indicator while typed */
+	const char *header = NULL;
+	if (server->osd_state.filter[0]) {
+		header = server->osd_state.filter;
+	} else if (wl_list_length(&rc.workspace_config.workspaces) > 1) {
+		header = server->workspace_current->name;
+	}
 
 	float scale = output->wlr_output->scale;
 	int w = theme->osd_window_switcher_width;
@@ -341,29 +563,11 @@ display_osd(struct output *output, struct wl_array *views)
 	int h = wl_array_len(views) * rc.theme->osd_window_switcher_item_height
 		+ 2 * rc.theme->osd_border_width
 		+ 2 * rc.theme->osd_window_switcher_padding;
-	if (show_workspace) {
-		/* workspace indicator */
+	if (header) {
+		/* workspace indicator or filter */
 		h += theme->osd_window_switcher_item_height;
 	}
 
-	/* Reset buffer */
-	if (output->osd_buffer) {
-		wlr_buffer_drop(&output->osd_buffer->base);
-	}
-	output->osd_buffer = buffer_create_cairo(w, h, scale, true);
-	if (!output->osd_buffer) {
-		wlr_log(WLR_ERROR, "Failed to allocate cairo buffer for the window switcher");
-		return;
-	}
-
-	/* Render OSD image */
-	cairo_t *cairo = output->osd_buffer->cairo;
-	render_osd(server, cairo, w, h, show_workspace, workspace_name, views);
-
-	struct wlr_scene_buffer *scene_buffer = wlr_scene_buffer_create(
-		output->osd_tree, &output->osd_buffer->base);
-	wlr_scene_buffer_set_dest_size(scene_buffer, w, h);
-
 	/* Center OSD */
 	struct wlr_box output_box;
 	wlr_output_layout_get_box(output->server->output_layout,
@@ -372,46 +576,280 @@ display_osd(struct output *output, struct wl_array *views)
 		- w / 2 + output_box.x;
 	int ly = output->usable_area.y + output->usable_area.height / 2
 		- h / 2 + output_box.y;
-	wlr_scene_node_set_position(&scene_buffer->node, lx, ly);
+
+	struct buf content = BUF_INIT;
+	get_osd_content(&content, output, w, h, header, views);
+	if (output->osd_content && !strcmp(output->osd_content, content.data)) {
+		/* Only the selection changed */
+		buf_reset(&content);
+		wlr_scene_node_set_position(&output->osd_highlight->node.parent->node,
+			lx, ly);
+		move_highlight(output, views, header != NULL);
+		return;
+	}
+	destroy_osd_nodes(output);
+
+	int highlight_width = w - 2 * theme->osd_border_width
+		- 2 * theme->osd_window_switcher_padding;
+	int highlight_height = theme->osd_window_switcher_item_height;
+
+	struct output *other = find_osd_content(server, content.data);
+	if (other) {
+		set_osd_buffers(output, other->osd_buffer,
+			other->osd_highlight_buffer);
+	} else {
+		struct lab_data_buffer *buffer =
+			buffer_create_cairo(w, h, scale, true);
+		struct lab_data_buffer *highlight_buffer = buffer_create_cairo(
+			highlight_width, highlight_height, scale, true);
+		if (!buffer || !highlight_buffer) {
+			wlr_log(WLR_ERROR, "Failed to allocate window switcher buffers");
+			if (buffer) {
+				wlr_buffer_drop(&buffer->base);
+			}
+			if (highlight_buffer) {
+				wlr_buffer_drop(&highlight_buffer->base);
+			}
+			buf_reset(&content);
+			return;
+		}
+
+		/* Render OSD image */
+		render_osd(server, buffer->cairo, w, h, header, views);
+		if (theme->osd_bg_color[3] > 0.999f
+				&& theme->osd_border_color[3] > 0.999f) {
+			pixman_region32_union_rect(&buffer->opaque_region,
+				&buffer->opaque_region, 0, 0, w, h);
+		}
+		render_highlight(theme, highlight_buffer->cairo,
+			highlight_width, highlight_height);
+
+		set_osd_buffers(output, buffer, highlight_buffer);
+		wlr_buffer_drop(&buffer->base);
+		wlr_buffer_drop(&highlight_buffer->base);
+	}
+	output->osd_content = xstrdup(content.data);
+	buf_reset(&content);
+
+	struct wlr_scene_tree *tree = wlr_scene_tree_create(output->osd_tree);
+	wlr_scene_node_set_position(&tree->node, lx, ly);
+
+	struct wlr_scene_buffer *scene_buffer = wlr_scene_buffer_create(
+		tree, &output->osd_buffer->base);
+	wlr_scene_buffer_set_dest_size(scene_buffer, w, h);
+	wlr_scene_buffer_set_opaque_region(scene_buffer,
+		&output->osd_buffer->opaque_region);
+
+	output->osd_highlight = wlr_scene_buffer_create(
+		tree, &output->osd_highlight_buffer->base);
+	wlr_scene_buffer_set_dest_size(output->osd_highlight,
+		highlight_width, highlight_height);
+	if (rc.window_switcher.thumbnails) {
+		create_thumbnails(output, tree, views, w);
+	}
+	move_highlight(output, views, header != NULL);
+
 	wlr_scene_node_set_enabled(&output->osd_tree->node, true);
 
 	/* Update cursor, in case it is within the area covered by OSD */
 	cursor_update_focus(server);
 }
 
-void
-osd_update(struct server *server)
+/* Whether @filter is a subsequence of the search key of @view */
+static bool
+view_matches_filter(struct view *view, const char *filter)
 {
-	struct wl_array views;
-	wl_array_init(&views);
-	view_array_append(server, &views, rc.window_switcher.criteria);
+	const char *key = osd_field_get_search_key(view);
+	for (; *filter; filter++) {
+		key = strchr(key, *filter);
+		if (!key) {
+			return false;
+		}
+		key++;
+	}
+	return true;
+}
 
-	if (!wl_array_len(&views) || !server->osd_state.cycle_view) {
-		osd_finish(server);
-		goto out;
+/* Removes the views not matching @filter, returns the number left */
+static size_t
+filter_views(struct wl_array *views, const char *filter)
+{
+	struct view **listed = views->data;
+	size_t len = wl_array_len(views);
+	size_t matches = 0;
+	for (size_t i = 0; i < len; i++) {
+		if (view_matches_filter(listed[i], filter)) {
+			listed[matches++] = listed[i];
+		}
+	}
+	views->size = matches * sizeof(*listed);
+	return matches;
+}
+
+static void
+update_views(struct server *server)
+{
+	struct osd_state *osd_state = &server->osd_state;
+	wl_array_release(&osd_state->views);
+	wl_array_init(&osd_state->views);
+	if (rc.window_switcher.order == LAB_WINDOW_SWITCHER_ORDER_FOCUS) {
+		view_array_append_focus_history(server, &osd_state->views,
+			rc.window_switcher.criteria);
+	} else {
+		view_array_append(server, &osd_state->views,
+			rc.window_switcher.criteria);
+	}
+	if (!osd_state->filter[0]) {
+		return;
+	}
+
+	/* Views may have been closed or renamed since the filter was typed */
+	struct wl_array all;
+	wl_array_init(&all);
+	wl_array_copy(&all, &osd_state->views);
+	if (!filter_views(&osd_state->views, osd_state->filter)) {
+		osd_state->filter[0] = '\0';
+		wl_array_release(&osd_state->views);
+		osd_state->views = all;
+		return;
+	}
+	wl_array_release(&all);
+}
+
+/* Keeps the selection within the listed views */
+static void
+select_listed_view(struct server *server)
+{
+	struct osd_state *osd_state = &server->osd_state;
+	struct view **view;
+	wl_array_for_each(view, &osd_state->views) {
+		if (*view == osd_state->cycle_view) {
+			return;
+		}
 	}
+	view = osd_state->views.data;
+	osd_state->cycle_view = wl_array_len(&osd_state->views) ? *view : NULL;
+}
 
+static void
+show_osd(struct server *server)
+{
+	struct osd_state *osd_state = &server->osd_state;
 	if (rc.window_switcher.show && rc.theme->osd_window_switcher_width > 0) {
 		/* Display the actual OSD */
 		struct output *output;
 		wl_list_for_each(output, &server->outputs, link) {
-			destroy_osd_nodes(output);
 			if (output_is_usable(output)) {
-				display_osd(output, &views);
+				display_osd(output, &osd_state->views);
+			} else {
+				destroy_osd_nodes(output);
 			}
 		}
 	}
 
 	/* Outline current window */
 	if (rc.window_switcher.outlines) {
-		if (view_is_focusable(server->osd_state.cycle_view)) {
-			osd_update_preview_outlines(server->osd_state.cycle_view);
+		if (view_is_focusable(osd_state->cycle_view)) {
+			osd_update_preview_outlines(osd_state->cycle_view);
 		}
 	}
 
-	if (rc.window_switcher.preview) {
-		preview_cycled_view(server->osd_state.cycle_view);
+	if (rc.window_switcher.preview
+			&& preview_allowed(osd_state->cycle_view)) {
+		preview_cycled_view(osd_state->cycle_view);
+	} else {
+		osd_preview_restore(server);
+	}
+}
+
+void
+osd_update(struct server *server)
+{
+	TRACE_FUNC();
+	update_views(server);
+	if (!wl_array_len(&server->osd_state.views)
+			|| !server->osd_state.cycle_view) {
+		osd_finish(server);
+		return;
+	}
+	if (server->osd_state.filter[0]) {
+		select_listed_view(server);
+	}
+	show_osd(server);
+}
+
+void
+osd_cycle(struct server *server, bool forwards)
+{
+	struct osd_state *osd_state = &server->osd_state;
+	if (!osd_state->filter[0]) {
+		osd_state->cycle_view = desktop_cycle_view(server,
+			osd_state->cycle_view, forwards
+				? LAB_CYCLE_DIR_FORWARD : LAB_CYCLE_DIR_BACKWARD);
+		osd_update(server);
+		return;
+	}
+
+	/* Only the views matching the filter are cycled through */
+	struct view **views = osd_state->views.data;
+	size_t len = wl_array_len(&osd_state->views);
+	size_t index = 0;
+	while (index < len && views[index] != osd_state->cycle_view) {
+		index++;
+	}
+	if (index == len) {
+		index = 0;
+	} else {
+		index = (index + (forwards ? 1 : len - 1)) % len;
+	}
+	osd_state->cycle_view = views[index];
+	show_osd(server);
+}
+
+void
+osd_filter_append(struct server *server, const char *text)
+{
+	struct osd_state *osd_state = &server->osd_state;
+	size_t len = strlen(osd_state->filter);
+	if (len + strlen(text) >= sizeof(osd_state->filter)) {
+		return;
 	}
-out:
-	wl_array_release(&views);
+	char filter[sizeof(osd_state->filter)];
+	memcpy(filter, osd_state->filter, len);
+	for (const char *p = text; *p; p++) {
+		filter[len++] = tolower((unsigned char)*p);
+	}
+	filter[len] = '\0';
+
+	/* Views not matching the current filter cannot match a longer one */
+	struct wl_array views;
+	wl_array_init(&views);
+	wl_array_copy(&views, &osd_state->views);
+	if (!filter_views(&views, filter)) {
+		wl_array_release(&views);
+		return;
+	}
+	wl_array_release(&osd_state->views);
+	osd_state->views = views;
+	memcpy(osd_state->filter, filter, len + 1);
+	select_listed_view(server);
+	show_osd(server);
+}
+
+void
+osd_filter_backspace(struct server *server)
+{
+	char *filter = server->osd_state.filter;
+	size_t len = strlen(filter);
+	if (!len) {
+		return;
+	}
+	/* Remove the last UTF-8 sequence */
+	while (len > 1 && (filter[len - 1] & 0xc0) == 0x80) {
+		len--;
+	}
+	filter[len - 1] = '\0';
+
+	/* Views dropped by the longer filter are listed again */
+	osd_update(server);
 }
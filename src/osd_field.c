@@ -2,6 +2,7 @@
 #include <assert.h>
 #include <ctype.h>
 #include <wlr/util/log.h>
+#include "common/arena.h"
 #include "common/mem.h"
 #include "config/rcxml.h"
 #include "view.h"
@@ -21,6 +22,10 @@ struct field_converter {
 };
 
 static const struct field_converter field_converter[];
+static void clear_cache(struct osd_field_cache *cache);
+
+/* Bumped to drop the field caches of all views */
+static uint32_t cache_generation = 1;
 
 /* Internal helpers */
 
@@ -274,15 +279,16 @@ static const struct field_converter field_converter[LAB_FIELD_COUNT] = {
 };
 
 struct window_switcher_field *
-osd_field_create(void)
+osd_field_create(struct arena *arena)
 {
-	struct window_switcher_field *field = znew(*field);
+	struct window_switcher_field *field = arena_new(arena, *field);
 	return field;
 }
 
 void
-osd_field_arg_from_xml_node(struct window_switcher_field *field,
-		const char *nodename, const char *content)
+osd_field_arg_from_xml_node(struct arena *arena,
+		struct window_switcher_field *field, const char *nodename,
+		const char *content)
 {
 	if (!strcmp(nodename, "content")) {
 		if (!strcmp(content, "type")) {
@@ -312,8 +318,7 @@ osd_field_arg_from_xml_node(struct window_switcher_field *field,
 			wlr_log(WLR_ERROR, "bad windowSwitcher field '%s'", content);
 		}
 	} else if (!strcmp(nodename, "format")) {
-		zfree(field->format);
-		field->format = xstrdup(content);
+		field->format = arena_strdup(arena, content);
 	} else if (!strcmp(nodename, "width") && !strchr(content, '%')) {
 		wlr_log(WLR_ERROR, "Invalid osd field width: %s, misses trailing %%", content);
 	} else if (!strcmp(nodename, "width")) {
@@ -342,6 +347,40 @@ osd_field_validate(struct window_switcher_field *field)
 	return true;
 }
 
+static struct osd_field_cache *
+get_cache(struct view *view)
+{
+	struct osd_field_cache *cache = &view->osd_fields;
+	if (cache->generation != cache_generation) {
+		clear_cache(cache);
+		size_t nr_fields = wl_list_length(&rc.window_switcher.fields);
+		if (nr_fields != cache->nr_fields) {
+			zfree(cache->contents);
+			cache->contents = znew_n(char *, nr_fields);
+			cache->nr_fields = nr_fields;
+		}
+		cache->generation = cache_generation;
+	}
+	return cache;
+}
+
+/* Returns the cache slot of @field, or NULL if it is not configured */
+static char **
+get_cached_content(struct window_switcher_field *field, struct view *view)
+{
+	struct osd_field_cache *cache = get_cache(view);
+	size_t index = 0;
+	struct window_switcher_field *candidate;
+	wl_list_for_each(candidate, &rc.window_switcher.fields, link) {
+		if (candidate == field) {
+			return index < cache->nr_fields
+				? &cache->contents[index] : NULL;
+		}
+		index++;
+	}
+	return NULL;
+}
+
 void
 osd_field_get_content(struct window_switcher_field *field,
 		struct buf *buf, struct view *view)
@@ -352,12 +391,72 @@ osd_field_get_content(struct window_switcher_field *field,
 	}
 	assert(field->content < LAB_FIELD_COUNT && field_converter[field->content].fn);
 
-	field_converter[field->content].fn(buf, view, field->format);
+	char **content = get_cached_content(field, view);
+	if (!content) {
+		field_converter[field->content].fn(buf, view, field->format);
+		return;
+	}
+	if (!*content) {
+		struct buf field_buf = BUF_INIT;
+		field_converter[field->content].fn(&field_buf, view,
+			field->format);
+		*content = xstrdup(field_buf.data);
+		buf_reset(&field_buf);
+	}
+	buf_add(buf, *content);
+}
+
+const char *
+osd_field_get_search_key(struct view *view)
+{
+	struct osd_field_cache *cache = get_cache(view);
+	if (!cache->search_key) {
+		const char *app_id = get_app_id_or_class(view, /*trim*/ false);
+		const char *title = get_title(view);
+		struct buf buf = BUF_INIT;
+		buf_add(&buf, app_id ? app_id : "");
+		buf_add_char(&buf, ' ');
+		buf_add(&buf, title ? title : "");
+		for (char *p = buf.data; *p; p++) {
+			*p = tolower((unsigned char)*p);
+		}
+		cache->search_key = xstrdup(buf.data);
+		buf_reset(&buf);
+	}
+	return cache->search_key;
+}
+
+static void
+clear_cache(struct osd_field_cache *cache)
+{
+	for (size_t i = 0; i < cache->nr_fields; i++) {
+		zfree(cache->contents[i]);
+	}
+	zfree(cache->search_key);
+}
+
+void
+osd_field_invalidate(struct view *view)
+{
+	assert(view);
+	view->osd_fields.generation = 0;
+}
+
+void
+osd_field_invalidate_all(void)
+{
+	if (!++cache_generation) {
+		cache_generation = 1;
+	}
 }
 
 void
-osd_field_free(struct window_switcher_field *field)
+osd_field_view_finish(struct view *view)
 {
-	zfree(field->format);
-	zfree(field);
+	assert(view);
+	struct osd_field_cache *cache = &view->osd_fields;
+	clear_cache(cache);
+	zfree(cache->contents);
+	cache->nr_fields = 0;
+	cache->generation = 0;
 }
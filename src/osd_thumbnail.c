@@ -0,0 +1,183 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <assert.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_scene.h>
+#include "common/macros.h"
+#include "common/mem.h"
+#include "osd.h"
+#include "view.h"
+
+/*
+ * A thumbnail does not copy any pixels. It consists of additional scene
+ * buffers referencing the buffers of the view's surfaces, so rendering it
+ * re-uses the textures already uploaded for the view itself.
+ */
+struct osd_thumbnail {
+	struct wlr_scene_tree *tree;
+	struct view *view;
+	struct wlr_surface *surface;
+	int max_width;
+	int max_height;
+
+	struct wl_listener commit;
+	struct wl_listener surface_destroy;
+	struct wl_listener destroy;
+};
+
+struct add_context {
+	struct osd_thumbnail *thumbnail;
+	double scale;
+};
+
+static void
+add_buffer(struct wlr_scene_buffer *buffer, int sx, int sy,
+		struct add_context *ctx)
+{
+	if (!buffer->buffer) {
+		return;
+	}
+
+	int width = buffer->dst_width;
+	int height = buffer->dst_height;
+	if (!width || !height) {
+		width = buffer->buffer->width;
+		height = buffer->buffer->height;
+	}
+
+	struct wlr_scene_buffer *ref = wlr_scene_buffer_create(
+		ctx->thumbnail->tree, buffer->buffer);
+	if (!ref) {
+		return;
+	}
+	wlr_scene_buffer_set_source_box(ref, &buffer->src_box);
+	wlr_scene_buffer_set_transform(ref, buffer->transform);
+	wlr_scene_buffer_set_dest_size(ref,
+		MAX(1, width * ctx->scale), MAX(1, height * ctx->scale));
+	wlr_scene_node_set_position(&ref->node,
+		sx * ctx->scale, sy * ctx->scale);
+}
+
+/*
+ * Like wlr_scene_node_for_each_buffer(), but also descends into disabled
+ * nodes: the surface tree of a shaded view is disabled and would
+ * otherwise leave an empty thumbnail.
+ */
+static void
+add_buffers(struct wlr_scene_node *node, int x, int y,
+		struct add_context *ctx)
+{
+	x += node->x;
+	y += node->y;
+	if (node->type == WLR_SCENE_NODE_BUFFER) {
+		add_buffer(wlr_scene_buffer_from_node(node), x, y, ctx);
+	} else if (node->type == WLR_SCENE_NODE_TREE) {
+		struct wlr_scene_tree *tree = wlr_scene_tree_from_node(node);
+		struct wlr_scene_node *child;
+		wl_list_for_each(child, &tree->children, link) {
+			add_buffers(child, x, y, ctx);
+		}
+	}
+}
+
+static void
+thumbnail_update(struct osd_thumbnail *thumbnail)
+{
+	struct wlr_scene_node *child, *tmp;
+	wl_list_for_each_safe(child, tmp, &thumbnail->tree->children, link) {
+		wlr_scene_node_destroy(child);
+	}
+
+	struct view *view = thumbnail->view;
+	if (!view->surface || !view->scene_node) {
+		return;
+	}
+	struct wlr_box geo = view->current;
+	if (geo.width <= 0 || geo.height <= 0) {
+		return;
+	}
+
+	/* Never scale up, tiny windows stay tiny */
+	double scale = MIN(1.0, MIN(
+		(double)thumbnail->max_width / geo.width,
+		(double)thumbnail->max_height / geo.height));
+
+	/* Center the thumbnail in the available space */
+	wlr_scene_node_set_position(&thumbnail->tree->node,
+		(thumbnail->max_width - geo.width * scale) / 2,
+		(thumbnail->max_height - geo.height * scale) / 2);
+
+	struct add_context ctx = {
+		.thumbnail = thumbnail,
+		.scale = scale,
+	};
+	/* Positions include the offset of view->scene_node itself */
+	add_buffers(view->scene_node, 0, 0, &ctx);
+}
+
+static void
+handle_commit(struct wl_listener *listener, void *data)
+{
+	struct osd_thumbnail *thumbnail =
+		wl_container_of(listener, thumbnail, commit);
+	thumbnail_update(thumbnail);
+}
+
+static void
+remove_surface_listeners(struct osd_thumbnail *thumbnail)
+{
+	if (!thumbnail->surface) {
+		return;
+	}
+	wl_list_remove(&thumbnail->commit.link);
+	wl_list_remove(&thumbnail->surface_destroy.link);
+	thumbnail->surface = NULL;
+}
+
+static void
+handle_surface_destroy(struct wl_listener *listener, void *data)
+{
+	struct osd_thumbnail *thumbnail =
+		wl_container_of(listener, thumbnail, surface_destroy);
+	remove_surface_listeners(thumbnail);
+}
+
+static void
+handle_destroy(struct wl_listener *listener, void *data)
+{
+	struct osd_thumbnail *thumbnail =
+		wl_container_of(listener, thumbnail, destroy);
+	remove_surface_listeners(thumbnail);
+	wl_list_remove(&thumbnail->destroy.link);
+	free(thumbnail);
+}
+
+struct wlr_scene_tree *
+osd_thumbnail_create(struct wlr_scene_tree *parent, struct view *view,
+		int max_width, int max_height)
+{
+	assert(parent);
+	assert(view);
+
+	struct osd_thumbnail *thumbnail = znew(*thumbnail);
+	thumbnail->tree = wlr_scene_tree_create(parent);
+	thumbnail->view = view;
+	thumbnail->max_width = max_width;
+	thumbnail->max_height = max_height;
+
+	thumbnail->destroy.notify = handle_destroy;
+	wl_signal_add(&thumbnail->tree->node.events.destroy,
+		&thumbnail->destroy);
+
+	/* Follow the client's buffers while the switcher is shown */
+	if (view->surface) {
+		thumbnail->surface = view->surface;
+		thumbnail->commit.notify = handle_commit;
+		wl_signal_add(&view->surface->events.commit, &thumbnail->commit);
+		thumbnail->surface_destroy.notify = handle_surface_destroy;
+		wl_signal_add(&view->surface->events.destroy,
+			&thumbnail->surface_destroy);
+	}
+
+	thumbnail_update(thumbnail);
+	return thumbnail->tree;
+}
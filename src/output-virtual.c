@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <wlr/backend/headless.h>
 #include <wlr/types/wlr_output.h>
+#include "common/macros.h"
 #include "common/string-helpers.h"
 #include "labwc.h"
 #include "output-virtual.h"
@@ -11,6 +12,7 @@ static struct wlr_output *fallback_output = NULL;
 
 void
 output_virtual_add(struct server *server, const char *output_name,
+		int max_refresh, bool render_on_damage_only,
 		struct wlr_output **store_wlr_output)
 {
 	if (output_name) {
@@ -71,6 +73,12 @@ output_virtual_add(struct server *server, const char *output_name,
 		server->new_output.notify(&server->new_output, wlr_output);
 	}
 
+	struct output *output = output_from_wlr_output(server, wlr_output);
+	if (output) {
+		output->max_refresh = MAX(max_refresh, 0);
+		output->render_on_damage_only = render_on_damage_only;
+	}
+
 restore_handler:
 	/* And finally restore output notifications */
 	wl_signal_add(&server->backend->events.new_output, &server->new_output);
@@ -116,7 +124,9 @@ output_virtual_update_fallback(struct server *server)
 			&& !string_null_or_empty(fallback_output_name)) {
 		wlr_log(WLR_DEBUG, "adding fallback output %s", fallback_output_name);
 
-		output_virtual_add(server, fallback_output_name, &fallback_output);
+		output_virtual_add(server, fallback_output_name,
+			/*max_refresh*/ 0, /*render_on_damage_only*/ false,
+			&fallback_output);
 	} else if (fallback_output && (wl_list_length(layout_outputs) > 1
 			|| string_null_or_empty(fallback_output_name))) {
 		wlr_log(WLR_DEBUG, "destroying fallback output %s",
@@ -8,6 +8,8 @@
 
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
+#include <float.h>
+#include <string.h>
 #include <strings.h>
 #include <wlr/backend/drm.h>
 #include <wlr/backend/wayland.h>
@@ -18,68 +20,358 @@
 #include <wlr/types/wlr_scene.h>
 #include <wlr/util/region.h>
 #include <wlr/util/log.h>
+#include "buffer.h"
+#include "client-stats.h"
+#include "common/buf.h"
 #include "common/macros.h"
 #include "common/mem.h"
 #include "common/scene-helpers.h"
+#include "common/time-helpers.h"
+#include "common/trace.h"
+#include "debug.h"
+#include "edges.h"
+#include "flight-recorder.h"
+#include "idle-refresh.h"
+#include "input/latency.h"
 #include "labwc.h"
 #include "layers.h"
 #include "node.h"
+#include "osd.h"
 #include "output-virtual.h"
+#include "perf-hud.h"
 #include "regions.h"
+#include "ssd.h"
+#include "transaction.h"
 #include "view.h"
+#include "window-rules.h"
+#include "workspaces.h"
 #include "xwayland.h"
 
+/* Tests if @name is an element of the comma or space separated @list */
+static bool
+name_in_list(const char *list, const char *name)
+{
+	size_t len = strlen(name);
+	for (const char *p = list; (p = strstr(p, name)); p += len) {
+		bool start = p == list || p[-1] == ',' || p[-1] == ' ';
+		bool end = p[len] == '\0' || p[len] == ',' || p[len] == ' ';
+		if (start && end) {
+			return true;
+		}
+	}
+	return false;
+}
+
 static bool
 get_tearing_preference(struct output *output)
 {
 	struct server *server = output->server;
 
 	/* Never allow tearing when disabled */
-	if (!rc.allow_tearing) {
+	if (rc.allow_tearing == LAB_TEARING_DISABLED) {
 		return false;
 	}
 
-	/* Tearing is only allowed for the output with the active view */
-	if (!server->active_view || server->active_view->output != output) {
+	/* Only allow tearing on the configured outputs */
+	if (rc.tearing_outputs
+			&& !name_in_list(rc.tearing_outputs, output->wlr_output->name)) {
+		return false;
+	}
+
+	/*
+	 * Automatically allow tearing for fullscreen views which are
+	 * scanned out directly, i.e. with nothing rendered on top.
+	 */
+	struct view *view = output_get_fullscreen_view(output);
+	if (rc.allow_tearing == LAB_TEARING_FULLSCREEN && view
+			&& output->scene_output->prev_scanout
+			&& window_rules_get_property(view,
+				LAB_WINDOW_RULE_PROP_ALLOW_TEARING) != LAB_PROP_FALSE) {
+		return true;
+	}
+
+	/* Otherwise tearing is only allowed for the output with the active view */
+	view = server->active_view;
+	if (!view || view->output != output) {
 		return false;
 	}
 
-	/* If the active view requests tearing, or it is toggled on with action, allow it */
-	return server->active_view->tearing_hint;
+	/*
+	 * If the active view requests tearing, it is toggled on with action,
+	 * a window rule asks for it or the client hints at game content,
+	 * allow it unless a rule forbids it.
+	 */
+	enum property rule = window_rules_get_property(view,
+		LAB_WINDOW_RULE_PROP_ALLOW_TEARING);
+	if (rule == LAB_PROP_FALSE) {
+		return false;
+	}
+	return view->tearing_hint || rule == LAB_PROP_TRUE
+		|| view->content_type == LAB_CONTENT_TYPE_GAME;
 }
 
+/*
+ * After a successful commit the backend sends the next frame event on
+ * the following page-flip, so if the interval between two frame events
+ * spans more than one refresh cycle we have missed at least one vblank.
+ */
 static void
-output_frame_notify(struct wl_listener *listener, void *data)
+frame_stats_begin(struct output *output, int64_t now)
+{
+	struct output_frame_stats *stats = &output->frame_stats;
+	int32_t refresh = output->wlr_output->refresh;
+
+	if (stats->last_frame_committed && refresh > 0) {
+		int64_t period = 1000000000000LL / refresh;
+		int64_t interval = now - stats->last_frame_nsec;
+		if (interval > period + period / 2) {
+			stats->missed_vblanks += (interval + period / 2) / period - 1;
+		}
+	}
+	stats->last_frame_nsec = now;
+	stats->last_frame_committed = false;
+}
+
+static void
+frame_stats_record_commit(struct output *output,
+		struct lab_scene_commit_timing *timing)
 {
+	struct output_frame_stats *stats = &output->frame_stats;
+	histogram_add(&stats->build_state,
+		nsec_to_usec(timing->build_state_nsec));
+	histogram_add(&stats->commit, nsec_to_usec(timing->commit_nsec));
+	stats->frames_committed++;
+	stats->last_frame_committed = true;
+	flight_record(FLIGHT_EVENT_OUTPUT_COMMIT, output->scene_output->index,
+		nsec_to_usec(timing->build_state_nsec),
+		nsec_to_usec(timing->commit_nsec));
+	latency_output_commit(output);
+	perf_hud_record_commit(output, timing);
+}
+
+/*
+ * Count whether frames showing a fullscreen view went through direct
+ * scanout and, whenever that changes, log why scanout was not possible.
+ */
+static void
+update_scanout_stats(struct output *output)
+{
+	struct output_frame_stats *stats = &output->frame_stats;
+	struct view *view = output_get_fullscreen_view(output);
+	if (!view) {
+		stats->last_fullscreen_view = NULL;
+		return;
+	}
+
 	/*
-	 * This function is called every time an output is ready to display a
-	 * frame - which is typically at 60 Hz.
+	 * wlr_scene does not export the composition path, but keeps
+	 * track of it in prev_scanout after building the output state.
 	 */
-	struct output *output = wl_container_of(listener, output, frame);
-	if (!output_is_usable(output)) {
+	bool scanout = output->scene_output->prev_scanout;
+	if (scanout) {
+		stats->frames_scanout++;
+	} else {
+		stats->frames_composited++;
+	}
+	if (view == stats->last_fullscreen_view
+			&& scanout == stats->last_scanout) {
 		return;
 	}
+	stats->last_fullscreen_view = view;
+	stats->last_scanout = scanout;
 
-	if (!output->scene_output) {
-		/*
-		 * TODO: This is a short term fix for issue #1667,
-		 *       a proper fix would require restructuring
-		 *       the life cycle of scene outputs, e.g.
-		 *       creating them on new_output_notify() only.
-		 */
-		wlr_log(WLR_INFO, "Failed to render new frame: no scene-output");
+	const char *name = output->wlr_output->name;
+	if (scanout) {
+		wlr_log(WLR_DEBUG, "direct scanout enabled on %s", name);
+		return;
+	}
+	struct buf blockers = BUF_INIT;
+	debug_get_scanout_blockers(output, view, &blockers);
+	if (blockers.len) {
+		wlr_log(WLR_INFO, "direct scanout on %s blocked by: %s",
+			name, blockers.data);
+	} else {
+		wlr_log(WLR_INFO, "direct scanout on %s rejected by backend "
+			"(e.g. buffer format or size)", name);
+	}
+	buf_reset(&blockers);
+}
+
+static uint64_t
+region_area(pixman_region32_t *region)
+{
+	uint64_t area = 0;
+	int nrects = 0;
+	pixman_box32_t *rects = pixman_region32_rectangles(region, &nrects);
+	for (int i = 0; i < nrects; i++) {
+		area += (uint64_t)(rects[i].x2 - rects[i].x1)
+			* (rects[i].y2 - rects[i].y1);
+	}
+	return area;
+}
+
+/*
+ * Record the damaged area of the upcoming frame. The damage ring is in
+ * transformed output coordinates, so only scale it to output-local logical
+ * ones to make it comparable with the layout (and the highlights).
+ */
+static void
+record_damage(struct output *output)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+	pixman_region32_t *current = &output->scene_output->damage_ring.current;
+	if (!pixman_region32_not_empty(current)) {
 		return;
 	}
 
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+	wlr_region_scale(&damage, current, 1.0f / wlr_output->scale);
+
+	perf_hud_record_damage(output, &damage);
+	debug_highlight_damage(output, &damage);
+
+	int width, height;
+	wlr_output_effective_resolution(wlr_output, &width, &height);
+	uint64_t area = region_area(&damage);
+	struct output_frame_stats *stats = &output->frame_stats;
+	histogram_add(&stats->damage_area, MIN(area, UINT32_MAX));
+	if (area >= (uint64_t)width * height) {
+		stats->frames_fully_damaged++;
+	}
+	pixman_region32_fini(&damage);
+}
+
+static void
+update_render_time_estimate(struct output *output,
+		struct lab_scene_commit_timing *timing)
+{
+	/*
+	 * Follow increases immediately but let the estimate decay slowly
+	 * so that a single fast frame does not make us start too late.
+	 */
+	int64_t sample = timing->build_state_nsec + timing->commit_nsec;
+	int64_t estimate = output->render_time_estimate_nsec;
+	estimate -= estimate / 16;
+	output->render_time_estimate_nsec = MAX(estimate, sample);
+}
+
+static int
+get_max_render_time_msec(struct output *output)
+{
+	if (rc.max_render_time != LAB_MAX_RENDER_TIME_AUTO) {
+		return rc.max_render_time;
+	}
+	/* Round up to full milliseconds and add 1ms safety margin */
+	return (output->render_time_estimate_nsec + 999999) / 1000000 + 1;
+}
+
+/*
+ * Returns the number of milliseconds by which rendering can be delayed
+ * while still hitting the next predicted vblank. Delaying rendering lets
+ * client input that arrives after the frame event make it to the screen
+ * one refresh cycle earlier.
+ */
+static int
+get_render_delay_msec(struct output *output)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+	if (!rc.max_render_time || !output->refresh_nsec
+			|| !output->last_present_nsec) {
+		return 0;
+	}
+	/* With variable refresh rate or tearing there is no vblank to aim at */
+	if (wlr_output->adaptive_sync_status == WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED
+			|| get_tearing_preference(output)) {
+		return 0;
+	}
+
+	struct timespec now;
+	clock_gettime(wlr_backend_get_presentation_clock(
+		output->server->backend), &now);
+	int64_t nsec_until_refresh = output->last_present_nsec
+		+ output->refresh_nsec - timespec_to_nsec(&now);
+	if (nsec_until_refresh <= 0) {
+		return 0;
+	}
+	int max_render_time = MIN(get_max_render_time_msec(output),
+		output->refresh_nsec / 1000000);
+
+	/* Floor the time until refresh to avoid delaying too much */
+	return nsec_until_refresh / 1000000 - max_render_time;
+}
+
+/*
+ * Returns the number of milliseconds rendering has to be delayed to
+ * stay below the refresh cap of a virtual output.
+ */
+static int
+get_refresh_cap_delay_msec(struct output *output, int64_t now)
+{
+	if (!output->max_refresh || !output->last_repaint_nsec) {
+		return 0;
+	}
+	int64_t period = 1000000000LL / output->max_refresh;
+	int64_t remaining = output->last_repaint_nsec + period - now;
+	if (remaining <= 0) {
+		return 0;
+	}
+	return (remaining + 999999) / 1000000;
+}
+
+static bool
+output_has_damage(struct output *output)
+{
+	return output->wlr_output->needs_frame || pixman_region32_not_empty(
+		&output->scene_output->damage_ring.current);
+}
+
+/* Adds the adaptive sync change to the pending state of the frame */
+static void
+apply_adaptive_sync(struct output *output)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+	bool enabled = output->adaptive_sync_wanted;
+	output->adaptive_sync_pending = false;
+
+	wlr_output_enable_adaptive_sync(wlr_output, enabled);
+	if (enabled && output->adaptive_sync_support
+			== LAB_ADAPTIVE_SYNC_SUPPORT_UNKNOWN) {
+		/* Test commits are expensive, so this is only done once */
+		if (wlr_output_test(wlr_output)) {
+			output->adaptive_sync_support = LAB_ADAPTIVE_SYNC_SUPPORTED;
+		} else {
+			output->adaptive_sync_support =
+				LAB_ADAPTIVE_SYNC_UNSUPPORTED;
+			wlr_output_enable_adaptive_sync(wlr_output, false);
+			wlr_log(WLR_DEBUG, "failed to enable adaptive sync "
+				"for output %s", wlr_output->name);
+			return;
+		}
+	}
+	wlr_log(WLR_INFO, "adaptive sync %sabled for output %s",
+		enabled ? "en" : "dis", wlr_output->name);
+}
+
+static void
+output_repaint(struct output *output)
+{
 	struct wlr_output *wlr_output = output->wlr_output;
 	struct server *server = output->server;
 
+	output->last_repaint_nsec = time_now_nsec();
+
+	record_damage(output);
+
 	if (output->gamma_lut_changed) {
 		struct wlr_output_state pending;
 		wlr_output_state_init(&pending);
+		struct lab_scene_commit_timing timing = {0};
+		int64_t start = time_now_nsec();
 		if (!wlr_scene_output_build_state(output->scene_output, &pending, NULL)) {
 			return;
 		}
+		timing.build_state_nsec = time_now_nsec() - start;
 		output->gamma_lut_changed = false;
 		struct wlr_gamma_control_v1 *gamma_control =
 			wlr_gamma_control_manager_v1_get_control(
@@ -89,24 +381,363 @@ output_frame_notify(struct wl_listener *listener, void *data)
 			return;
 		}
 
+		start = time_now_nsec();
 		if (!wlr_output_commit_state(output->wlr_output, &pending)) {
 			wlr_gamma_control_v1_send_failed_and_destroy(gamma_control);
 			wlr_output_state_finish(&pending);
 			return;
 		}
+		timing.commit_nsec = time_now_nsec() - start;
+		frame_stats_record_commit(output, &timing);
 
 		wlr_damage_ring_rotate(&output->scene_output->damage_ring);
 		wlr_output_state_finish(&pending);
 		return;
 	}
 
-	output->wlr_output->pending.tearing_page_flip =
-		get_tearing_preference(output);
-	lab_wlr_scene_output_commit(output->scene_output);
+	if (output->adaptive_sync_pending) {
+		apply_adaptive_sync(output);
+	}
+	idle_refresh_apply(output);
+
+	bool tearing = get_tearing_preference(output);
+	output->wlr_output->pending.tearing_page_flip = tearing;
+	struct lab_scene_commit_timing timing;
+	if (lab_wlr_scene_output_commit(output->scene_output, &timing)) {
+		frame_stats_record_commit(output, &timing);
+		output->frame_stats.last_commit_tearing = tearing;
+		if (tearing) {
+			output->frame_stats.frames_tearing++;
+		}
+		update_render_time_estimate(output, &timing);
+		update_scanout_stats(output);
+		if (output_get_software_cursor(output)) {
+			output->frame_stats.frames_software_cursor++;
+		}
+	}
+}
+
+/* Used by window rules with throttleFrames="yes" if no rate is configured */
+#define DEFAULT_BACKGROUND_FRAME_RATE 30
+/* Used by window rules with limitCommitRate="yes" if no limit is configured */
+#define DEFAULT_COMMIT_RATE_LIMIT 60
+
+struct frame_done_state {
+	struct wlr_scene_output *scene_output;
+	struct timespec *when;
+	int64_t now;
+	/* Only throttled views are due, off the vblank */
+	bool catch_up;
+	/* When the next throttled view is due, 0 if none was skipped */
+	int64_t next_due;
+};
+
+static struct view *
+view_from_scene_buffer(struct wlr_scene_buffer *buffer)
+{
+	struct wlr_scene_node *node = &buffer->node;
+	while (node) {
+		struct node_descriptor *desc = node->data;
+		if (desc && (desc->type == LAB_NODE_DESC_VIEW
+				|| desc->type == LAB_NODE_DESC_XDG_POPUP)) {
+			return desc->data;
+		}
+		/* node->parent is always a *wlr_scene_tree */
+		node = node->parent ? &node->parent->node : NULL;
+	}
+	return NULL;
+}
+
+/*
+ * Frame callbacks allowed per second for a non-active @view because its
+ * client commits too often, 0 if it is not limited
+ */
+static int
+get_commit_rate_limit(struct view *view)
+{
+	int limit = rc.commit_rate_limit;
+	switch (window_rules_get_property(view,
+			LAB_WINDOW_RULE_PROP_LIMIT_COMMIT_RATE)) {
+	case LAB_PROP_FALSE:
+		return 0;
+	case LAB_PROP_TRUE:
+		if (!limit) {
+			limit = DEFAULT_COMMIT_RATE_LIMIT;
+		}
+		/* The commits of X11 clients cannot be told apart */
+		if (view->type == LAB_XWAYLAND_VIEW) {
+			view->commit_rate_exceeded = true;
+		}
+		break;
+	default:
+		break;
+	}
+	if (!limit) {
+		return 0;
+	}
+
+	/* Sticks until the view is activated to avoid oscillating */
+	if (!view->commit_rate_exceeded && view->type != LAB_XWAYLAND_VIEW
+			&& view->surface && view->surface->resource) {
+		struct wl_client *client =
+			wl_resource_get_client(view->surface->resource);
+		uint32_t rate = client_stats_get_commit_rate(client);
+		if (rate > (uint32_t)limit) {
+			wlr_log(WLR_DEBUG, "limiting %s to %d Hz (%u commits/s)",
+				view_get_string_prop(view, "app_id"), limit, rate);
+			view->commit_rate_exceeded = true;
+		}
+	}
+	return view->commit_rate_exceeded ? limit : 0;
+}
+
+/* Minimum interval between frame-done events for @view, 0 if unthrottled */
+static int64_t
+get_frame_done_interval_nsec(struct view *view)
+{
+	if (view == view->server->active_view) {
+		view->commit_rate_exceeded = false;
+		return 0;
+	}
+	int limit = get_commit_rate_limit(view);
+	int rate = rc.background_frame_rate;
+	switch (window_rules_get_property(view,
+			LAB_WINDOW_RULE_PROP_THROTTLE_FRAMES)) {
+	case LAB_PROP_FALSE:
+		rate = 0;
+		break;
+	case LAB_PROP_TRUE:
+		if (!rate) {
+			rate = DEFAULT_BACKGROUND_FRAME_RATE;
+		}
+		break;
+	default:
+		break;
+	}
+	if (limit && (rate <= 0 || limit < rate)) {
+		rate = limit;
+	}
+	return rate > 0 ? 1000000000LL / rate : 0;
+}
+
+static void
+send_frame_done_iterator(struct wlr_scene_buffer *buffer,
+		int sx, int sy, void *data)
+{
+	struct frame_done_state *state = data;
+	if (buffer->primary_output != state->scene_output) {
+		return;
+	}
+
+	struct view *view = view_from_scene_buffer(buffer);
+	if (!view && state->catch_up) {
+		return;
+	}
+	if (view) {
+		int64_t interval = get_frame_done_interval_nsec(view);
+		if (!interval && state->catch_up) {
+			/* Gets frame-done with the next frame event */
+			return;
+		}
+		int64_t due = view->last_frame_done_nsec + interval;
+		/* All surfaces of a view are sent frame-done together */
+		if (interval && view->last_frame_done_nsec != state->now
+				&& due > state->now) {
+			if (!state->next_due || due < state->next_due) {
+				state->next_due = due;
+			}
+			return;
+		}
+		view->last_frame_done_nsec = state->now;
+	}
+	wlr_scene_buffer_send_frame_done(buffer, state->when);
+}
 
+/*
+ * Like wlr_scene_output_send_frame_done(), but non-active views are
+ * sent frame-done at most <core><backgroundFrameRate> times a second.
+ * Throttled views are caught up by frame_done_timer, as they do not
+ * draw and hence do not cause new frames while waiting. Only those are
+ * sent frame-done by the timer with @catch_up, so that other clients do
+ * not draw more than once per refresh.
+ */
+static void
+send_frame_done(struct output *output, bool catch_up)
+{
 	struct timespec now = { 0 };
 	clock_gettime(CLOCK_MONOTONIC, &now);
-	wlr_scene_output_send_frame_done(output->scene_output, &now);
+	struct frame_done_state state = {
+		.scene_output = output->scene_output,
+		.when = &now,
+		.now = timespec_to_nsec(&now),
+		.catch_up = catch_up,
+	};
+	wlr_scene_output_for_each_buffer(output->scene_output,
+		send_frame_done_iterator, &state);
+
+	int delay = 0;
+	if (state.next_due) {
+		delay = MAX((state.next_due - state.now + 999999) / 1000000, 1);
+	}
+	/* A delay of 0 disarms the timer */
+	wl_event_source_timer_update(output->frame_done_timer, delay);
+
+	histogram_add(&output->frame_stats.frame_done,
+		nsec_to_usec(time_now_nsec() - state.now));
+}
+
+static void
+output_send_frame_done(struct output *output)
+{
+	send_frame_done(output, /* catch_up */ false);
+}
+
+static bool
+output_can_render(struct output *output)
+{
+	if (!output_is_usable(output)) {
+		return false;
+	}
+
+	if (!output->scene_output) {
+		/*
+		 * TODO: This is a short term fix for issue #1667,
+		 *       a proper fix would require restructuring
+		 *       the life cycle of scene outputs, e.g.
+		 *       creating them on new_output_notify() only.
+		 */
+		wlr_log(WLR_INFO, "Failed to render new frame: no scene-output");
+		return false;
+	}
+	return true;
+}
+
+static int
+handle_frame_done_timer(void *data)
+{
+	struct output *output = data;
+	if (output_can_render(output)) {
+		send_frame_done(output, /* catch_up */ true);
+	}
+	return 0;
+}
+
+static int
+handle_repaint_timer(void *data)
+{
+	struct output *output = data;
+
+	output->repaint_delayed = false;
+
+	/* Pick up pointer motion and ssd changes which arrived while waiting */
+	cursor_flush_motion(&output->server->seat);
+	view_flush_move_update(output->server);
+	workspaces_flush_swipe(output->server);
+	ssd_flush_geometry_updates(output->server);
+	ssd_flush_title_updates(output->server);
+
+	if (output_can_render(output) && (output->session_lock_pending
+			|| !transaction_is_blocking(output->server))) {
+		output_repaint(output);
+	}
+	return 0;
+}
+
+/*
+ * Outputs are rendered one after the other on the event loop thread.
+ * The wlroots 0.17 scene graph, renderer and allocator are not thread
+ * safe (the GLES renderer has a single EGL context), so the scene cannot
+ * be built or composited on per-output render threads. The frame events
+ * of different outputs are independent though, so an expensive output
+ * only delays others while it is actually rendering; <core><maxRenderTime>
+ * and the frame_stats histograms are the tools to keep that short.
+ */
+static void
+output_frame_notify(struct wl_listener *listener, void *data)
+{
+	TRACE_FUNC();
+	/*
+	 * This function is called every time an output is ready to display a
+	 * frame - which is typically at 60 Hz.
+	 */
+	struct output *output = wl_container_of(listener, output, frame);
+
+	/* Scheduled frames are rendered by the pending delayed repaint */
+	if (output->repaint_delayed) {
+		return;
+	}
+
+	/* Process coalesced pointer motion and ssd updates before rendering */
+	cursor_flush_motion(&output->server->seat);
+	view_flush_move_update(output->server);
+	workspaces_flush_swipe(output->server);
+	ssd_flush_geometry_updates(output->server);
+	ssd_flush_title_updates(output->server);
+
+	if (!output_can_render(output)) {
+		return;
+	}
+	idle_refresh_record_frame(output, output_has_damage(output));
+
+	/*
+	 * Hold back half-updated layouts while a transaction waits for
+	 * clients. They are still sent frame-done events so that those
+	 * which throttle on frame callbacks can draw their new size.
+	 */
+	if (transaction_is_blocking(output->server)
+			&& !output->session_lock_pending) {
+		output_send_frame_done(output);
+		return;
+	}
+
+	/*
+	 * Don't even send frame-done events if nothing changed, so that
+	 * idle clients on e.g. streamed virtual outputs stop drawing.
+	 */
+	if (output->render_on_damage_only && !output_has_damage(output)
+			&& !output->gamma_lut_changed) {
+		return;
+	}
+
+	int64_t now = time_now_nsec();
+	frame_stats_begin(output, now);
+
+	int delay = MAX(get_render_delay_msec(output),
+		get_refresh_cap_delay_msec(output, now));
+	if (delay < 1 || output->session_lock_pending) {
+		output_repaint(output);
+		output_send_frame_done(output);
+		return;
+	}
+
+	/*
+	 * Ignore further frame events until the delayed repaint has
+	 * happened. Clients are sent frame-done straight away so that they
+	 * can draw in the meantime.
+	 */
+	output->repaint_delayed = true;
+	wl_event_source_timer_update(output->repaint_timer, delay);
+	output_send_frame_done(output);
+}
+
+static void
+output_present_notify(struct wl_listener *listener, void *data)
+{
+	struct output *output = wl_container_of(listener, output, present);
+	struct wlr_output_event_present *event = data;
+	latency_output_present(output, event);
+	if (!event->presented || !event->when) {
+		return;
+	}
+	output->last_present_nsec = timespec_to_nsec(event->when);
+	output->refresh_nsec = event->refresh;
+
+	/* Async page-flips are presented without the vsync flag */
+	struct output_frame_stats *stats = &output->frame_stats;
+	if (stats->last_commit_tearing
+			&& !(event->flags & WLR_OUTPUT_PRESENT_VSYNC)) {
+		stats->frames_torn++;
+	}
 }
 
 static void
@@ -114,15 +745,25 @@ output_destroy_notify(struct wl_listener *listener, void *data)
 {
 	struct output *output = wl_container_of(listener, output, destroy);
 	struct seat *seat = &output->server->seat;
+	/* Drop the output from output_index */
+	output->server->usable_area_generation++;
+	desktop_forget_output(output);
 	regions_evacuate_output(output);
 	regions_destroy(seat, &output->regions);
+	regions_grid_finish(&output->region_grid);
+	latency_output_destroy(output);
+	perf_hud_output_destroy(output);
 	if (seat->overlay.active.output == output) {
 		overlay_hide(seat);
 	}
 	wl_list_remove(&output->link);
+	osd_field_invalidate_all();
 	wl_list_remove(&output->frame.link);
 	wl_list_remove(&output->destroy.link);
 	wl_list_remove(&output->request_state.link);
+	wl_list_remove(&output->present.link);
+	wl_event_source_remove(output->repaint_timer);
+	wl_event_source_remove(output->frame_done_timer);
 	seat_output_layout_changed(seat);
 
 	for (size_t i = 0; i < ARRAY_SIZE(output->layer_tree); i++) {
@@ -130,18 +771,25 @@ output_destroy_notify(struct wl_listener *listener, void *data)
 	}
 	wlr_scene_node_destroy(&output->layer_popup_tree->node);
 	wlr_scene_node_destroy(&output->osd_tree->node);
+	output->osd_highlight = NULL;
+	output->osd_thumbnail_highlight = NULL;
+	zfree(output->osd_content);
+	/* Buffers of the window switcher may be shared with other outputs */
+	if (output->osd_buffer) {
+		wlr_buffer_unlock(&output->osd_buffer->base);
+	}
+	if (output->osd_highlight_buffer) {
+		wlr_buffer_unlock(&output->osd_highlight_buffer->base);
+	}
 	wlr_scene_node_destroy(&output->session_lock_tree->node);
 	if (output->workspace_osd) {
 		wlr_scene_node_destroy(&output->workspace_osd->node);
 		output->workspace_osd = NULL;
 	}
 
-	struct view *view;
-	struct server *server = output->server;
-	wl_list_for_each(view, &server->views, link) {
-		if (view->output == output) {
-			view_on_output_destroy(view);
-		}
+	struct view *view, *tmp;
+	wl_list_for_each_safe(view, tmp, &output->views, output_link) {
+		view_on_output_destroy(view);
 	}
 
 	/*
@@ -197,6 +845,7 @@ output_request_state_notify(struct wl_listener *listener, void *data)
 }
 
 static void do_output_layout_change(struct server *server);
+static void apply_output_layout_change(struct server *server);
 
 static bool
 can_reuse_mode(struct wlr_output *wlr_output)
@@ -334,6 +983,7 @@ new_output_notify(struct wl_listener *listener, void *data)
 	wlr_output_effective_resolution(wlr_output,
 		&output->usable_area.width, &output->usable_area.height);
 	wl_list_insert(&server->outputs, &output->link);
+	osd_field_invalidate_all();
 
 	output->destroy.notify = output_destroy_notify;
 	wl_signal_add(&wlr_output->events.destroy, &output->destroy);
@@ -343,7 +993,17 @@ new_output_notify(struct wl_listener *listener, void *data)
 	output->request_state.notify = output_request_state_notify;
 	wl_signal_add(&wlr_output->events.request_state, &output->request_state);
 
+	output->present.notify = output_present_notify;
+	wl_signal_add(&wlr_output->events.present, &output->present);
+	output->repaint_timer = wl_event_loop_add_timer(server->wl_event_loop,
+		handle_repaint_timer, output);
+	output->frame_done_timer = wl_event_loop_add_timer(server->wl_event_loop,
+		handle_frame_done_timer, output);
+	idle_refresh_reset(output);
+
 	wl_list_init(&output->regions);
+	wl_list_init(&output->views);
+	wl_list_init(&output->damage_highlights);
 
 	/*
 	 * Create layer-trees (background, bottom, top and overlay) and
@@ -434,6 +1094,7 @@ output_init(struct server *server)
 		server->output_layout);
 
 	wl_list_init(&server->outputs);
+	server->usable_area_generation = 1;
 
 	output_manager_init(server);
 }
@@ -443,6 +1104,9 @@ output_update_for_layout_change(struct server *server)
 {
 	output_update_all_usable_areas(server, /*layout_changed*/ true);
 	session_lock_update_for_layout_change();
+	edges_invalidate_all(server);
+	/* Avoids loading cursors on the first motion onto a new output */
+	cursor_load_output_scales(&server->seat);
 
 	/*
 	 * "Move" each wlr_output_cursor (in per-output coordinates) to
@@ -453,86 +1117,224 @@ output_update_for_layout_change(struct server *server)
 	cursor_update_image(&server->seat);
 }
 
+/* Per-head state of an output configuration transaction */
+struct output_head_commit {
+	struct output *output;
+	struct wlr_output_configuration_head_v1 *head;
+	struct wlr_output_state pending;
+	struct wlr_output_state previous;
+	bool was_enabled;
+	bool committed;
+};
+
+static void
+output_state_from_head(struct wlr_output_state *state, struct output *output,
+		struct wlr_output_configuration_head_v1 *head)
+{
+	bool enabled = head->state.enabled && !output->leased;
+	wlr_output_state_set_enabled(state, enabled);
+	if (!enabled) {
+		return;
+	}
+	if (head->state.mode) {
+		wlr_output_state_set_mode(state, head->state.mode);
+	} else {
+		wlr_output_state_set_custom_mode(state,
+			head->state.custom_mode.width,
+			head->state.custom_mode.height,
+			head->state.custom_mode.refresh);
+	}
+	wlr_output_state_set_scale(state, head->state.scale);
+	wlr_output_state_set_transform(state, head->state.transform);
+	wlr_output_state_set_adaptive_sync_enabled(state,
+		head->state.adaptive_sync_enabled);
+}
+
+/* Used to roll back outputs which were committed before a failure */
+static void
+output_state_from_current(struct wlr_output_state *state,
+		struct wlr_output *wlr_output)
+{
+	wlr_output_state_set_enabled(state, wlr_output->enabled);
+	if (!wlr_output->enabled) {
+		return;
+	}
+	if (wlr_output->current_mode) {
+		wlr_output_state_set_mode(state, wlr_output->current_mode);
+	} else {
+		wlr_output_state_set_custom_mode(state, wlr_output->width,
+			wlr_output->height, wlr_output->refresh);
+	}
+	wlr_output_state_set_scale(state, wlr_output->scale);
+	wlr_output_state_set_transform(state, wlr_output->transform);
+	wlr_output_state_set_adaptive_sync_enabled(state,
+		wlr_output->adaptive_sync_status
+			== WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED);
+}
+
+static bool
+output_head_commit_test(struct output_head_commit *commit)
+{
+	struct wlr_output *o = commit->output->wlr_output;
+	if (wlr_output_test_state(o, &commit->pending)) {
+		return true;
+	}
+	if (commit->head->state.enabled
+			&& commit->head->state.adaptive_sync_enabled) {
+		/* Same fallback as output_enable_adaptive_sync() */
+		wlr_log(WLR_DEBUG,
+			"failed to enable adaptive sync for output %s", o->name);
+		wlr_output_state_set_adaptive_sync_enabled(&commit->pending,
+			false);
+		return wlr_output_test_state(o, &commit->pending);
+	}
+	return false;
+}
+
+/*
+ * Update the layout for an output which was just (re-)configured.
+ * Only called once all outputs were committed successfully.
+ */
+static void
+output_head_commit_apply_layout(struct server *server,
+		struct output_head_commit *commit)
+{
+	struct wlr_output *o = commit->output->wlr_output;
+	struct output *output = commit->output;
+	bool need_to_add = o->enabled && !commit->was_enabled;
+
+	/* Support for adaptive sync may depend on the mode */
+	output->adaptive_sync_support = LAB_ADAPTIVE_SYNC_SUPPORT_UNKNOWN;
+	/* The configured mode is the new full rate */
+	idle_refresh_reset(output);
+	bool need_to_remove = !o->enabled && commit->was_enabled;
+
+	if (need_to_add) {
+		add_output_to_layout(server, output);
+	}
+
+	if (o->enabled) {
+		struct wlr_box pos = {0};
+		wlr_output_layout_get_box(server->output_layout, o, &pos);
+		if (pos.x != commit->head->state.x
+				|| pos.y != commit->head->state.y) {
+			/*
+			 * This overrides the automatic layout
+			 *
+			 * wlr_output_layout_add() in fact means _move()
+			 */
+			wlr_output_layout_add(server->output_layout, o,
+				commit->head->state.x, commit->head->state.y);
+		}
+	}
+
+	if (need_to_remove) {
+		regions_evacuate_output(output);
+		/*
+		 * At time of writing, wlr_output_layout_remove()
+		 * indirectly destroys the wlr_scene_output, but
+		 * this behavior may change in future. To remove
+		 * doubt and avoid either a leak or double-free,
+		 * explicitly destroy the wlr_scene_output before
+		 * calling wlr_output_layout_remove().
+		 */
+		wlr_scene_output_destroy(output->scene_output);
+		wlr_output_layout_remove(server->output_layout, o);
+		output->scene_output = NULL;
+	}
+}
+
+/*
+ * Apply an output configuration as a single transaction: the new state
+ * of every output is tested before any of them is touched, and if a
+ * commit fails nonetheless, the outputs committed so far are rolled back.
+ * The layout is only updated once all outputs have been committed.
+ *
+ * wlroots 0.17 cannot commit several outputs at once, so outputs which
+ * get disabled are committed first to release their CRTCs and bandwidth
+ * for the others.
+ */
 static bool
 output_config_apply(struct server *server,
 		struct wlr_output_configuration_v1 *config)
 {
-	bool success = true;
+	bool success = false;
 	server->pending_output_layout_change++;
 
+	size_t nr_commits = wl_list_length(&config->heads);
+	struct output_head_commit *commits = znew_n(*commits, nr_commits);
+
+	size_t i = 0;
 	struct wlr_output_configuration_head_v1 *head;
 	wl_list_for_each(head, &config->heads, link) {
+		struct output_head_commit *commit = &commits[i++];
 		struct wlr_output *o = head->state.output;
-		struct output *output = output_from_wlr_output(server, o);
-		bool output_enabled = head->state.enabled && !output->leased;
-		bool need_to_add = output_enabled && !o->enabled;
-		bool need_to_remove = !output_enabled && o->enabled;
-
-		wlr_output_enable(o, output_enabled);
-		if (output_enabled) {
-			/* Output specific actions only */
-			if (head->state.mode) {
-				wlr_output_set_mode(o, head->state.mode);
-			} else {
-				int32_t width = head->state.custom_mode.width;
-				int32_t height = head->state.custom_mode.height;
-				int32_t refresh = head->state.custom_mode.refresh;
-				wlr_output_set_custom_mode(o, width,
-					height, refresh);
-			}
-			wlr_output_set_scale(o, head->state.scale);
-			wlr_output_set_transform(o, head->state.transform);
-			output_enable_adaptive_sync(o, head->state.adaptive_sync_enabled);
-		}
-		if (!wlr_output_commit(o)) {
-			/*
-			 * FIXME: This is only part of the story, we should revert
-			 *        all previously commited outputs as well here.
-			 *
-			 *        See https://github.com/labwc/labwc/pull/1528
-			 */
-			wlr_log(WLR_INFO, "Output config commit failed: %s", o->name);
-			success = false;
-			break;
-		}
+		commit->output = output_from_wlr_output(server, o);
+		commit->head = head;
+		commit->was_enabled = o->enabled;
+		wlr_output_state_init(&commit->pending);
+		wlr_output_state_init(&commit->previous);
+		output_state_from_head(&commit->pending, commit->output, head);
+		output_state_from_current(&commit->previous, o);
+	}
 
-		/* Only do Layout specific actions if the commit went trough */
-		if (need_to_add) {
-			add_output_to_layout(server, output);
+	for (i = 0; i < nr_commits; i++) {
+		if (!output_head_commit_test(&commits[i])) {
+			wlr_log(WLR_INFO, "Output config test failed: %s",
+				commits[i].output->wlr_output->name);
+			goto out;
 		}
+	}
 
-		if (output_enabled) {
-			struct wlr_box pos = {0};
-			wlr_output_layout_get_box(server->output_layout, o, &pos);
-			if (pos.x != head->state.x || pos.y != head->state.y) {
-				/*
-				 * This overrides the automatic layout
-				 *
-				 * wlr_output_layout_add() in fact means _move()
-				 */
-				wlr_output_layout_add(server->output_layout, o,
-					head->state.x, head->state.y);
+	/* Disable outputs first, then commit everything else */
+	for (int pass = 0; pass < 2; pass++) {
+		bool disabling = pass == 0;
+		for (i = 0; i < nr_commits; i++) {
+			struct output_head_commit *commit = &commits[i];
+			if (commit->pending.enabled == disabling) {
+				continue;
 			}
+			struct wlr_output *o = commit->output->wlr_output;
+			if (!wlr_output_commit_state(o, &commit->pending)) {
+				wlr_log(WLR_INFO, "Output config commit failed: %s",
+					o->name);
+				goto rollback;
+			}
+			commit->committed = true;
 		}
+	}
 
-		if (need_to_remove) {
-			regions_evacuate_output(output);
-			/*
-			 * At time of writing, wlr_output_layout_remove()
-			 * indirectly destroys the wlr_scene_output, but
-			 * this behavior may change in future. To remove
-			 * doubt and avoid either a leak or double-free,
-			 * explicitly destroy the wlr_scene_output before
-			 * calling wlr_output_layout_remove().
-			 */
-			wlr_scene_output_destroy(output->scene_output);
-			wlr_output_layout_remove(server->output_layout, o);
-			output->scene_output = NULL;
+	for (i = 0; i < nr_commits; i++) {
+		output_head_commit_apply_layout(server, &commits[i]);
+	}
+	success = true;
+	goto out;
+
+rollback:
+	for (i = nr_commits; i-- > 0;) {
+		struct output_head_commit *commit = &commits[i];
+		if (commit->committed && !wlr_output_commit_state(
+				commit->output->wlr_output, &commit->previous)) {
+			wlr_log(WLR_ERROR, "Failed to restore output %s",
+				commit->output->wlr_output->name);
 		}
 	}
 
+out:
+	for (i = 0; i < nr_commits; i++) {
+		wlr_output_state_finish(&commits[i].pending);
+		wlr_output_state_finish(&commits[i].previous);
+	}
+	free(commits);
+
+	/*
+	 * The layout change is applied right away, as configurations
+	 * requested by clients do not come in bursts.
+	 */
 	server->pending_output_layout_change--;
-	do_output_layout_change(server);
+	if (!server->pending_output_layout_change) {
+		apply_output_layout_change(server);
+	}
 	return success;
 }
 
@@ -638,11 +1440,7 @@ handle_output_manager_apply(struct wl_listener *listener, void *data)
 		wlr_output_configuration_v1_send_failed(config);
 	}
 	wlr_output_configuration_v1_destroy(config);
-	struct output *output;
-	wl_list_for_each(output, &server->outputs, link) {
-		wlr_xcursor_manager_load(server->seat.xcursor_manager,
-			output->wlr_output->scale);
-	}
+	cursor_load_output_scales(&server->seat);
 
 	/* Re-set cursor image in case scale changed */
 	cursor_update_focus(server);
@@ -689,20 +1487,46 @@ wlr_output_configuration_v1 *create_output_config(struct server *server)
 }
 
 static void
-do_output_layout_change(struct server *server)
+apply_output_layout_change(struct server *server)
+{
+	/* Cancel a deferred change, it is covered by this one */
+	wl_event_source_timer_update(server->output_layout_change_timer, 0);
+
+	struct wlr_output_configuration_v1 *config =
+		create_output_config(server);
+	if (config) {
+		wlr_output_manager_v1_set_configuration(
+			server->output_manager, config);
+	} else {
+		wlr_log(WLR_ERROR,
+			"wlr_output_manager_v1_set_configuration()");
+	}
+	output_update_for_layout_change(server);
+}
+
+static int
+handle_output_layout_change_timer(void *data)
 {
+	struct server *server = data;
 	if (!server->pending_output_layout_change) {
-		struct wlr_output_configuration_v1 *config =
-			create_output_config(server);
-		if (config) {
-			wlr_output_manager_v1_set_configuration(
-				server->output_manager, config);
-		} else {
-			wlr_log(WLR_ERROR,
-				"wlr_output_manager_v1_set_configuration()");
-		}
-		output_update_for_layout_change(server);
+		apply_output_layout_change(server);
 	}
+	return 0;
+}
+
+static void
+do_output_layout_change(struct server *server)
+{
+	if (server->pending_output_layout_change) {
+		return;
+	}
+	if (rc.output_change_delay > 0) {
+		/* Each change restarts the timer, merging bursts into one */
+		wl_event_source_timer_update(server->output_layout_change_timer,
+			rc.output_change_delay);
+		return;
+	}
+	apply_output_layout_change(server);
 }
 
 static void
@@ -711,6 +1535,9 @@ handle_output_layout_change(struct wl_listener *listener, void *data)
 	struct server *server =
 		wl_container_of(listener, server, output_layout_change);
 
+	/* Invalidate cached output geometry even if the change is deferred */
+	server->usable_area_generation++;
+
 	/* Prevents unnecessary layout recalculations */
 	server->pending_output_layout_change++;
 	output_virtual_update_fallback(server);
@@ -741,6 +1568,8 @@ output_manager_init(struct server *server)
 	server->output_layout_change.notify = handle_output_layout_change;
 	wl_signal_add(&server->output_layout->events.change,
 		&server->output_layout_change);
+	server->output_layout_change_timer = wl_event_loop_add_timer(
+		server->wl_event_loop, handle_output_layout_change_timer, server);
 
 	server->output_manager_apply.notify = handle_output_manager_apply;
 	wl_signal_add(&server->output_manager->events.apply,
@@ -782,16 +1611,58 @@ output_from_name(struct server *server, const char *name)
 	return NULL;
 }
 
+static void
+output_index_update(struct server *server)
+{
+	struct output_index *index = &server->output_index;
+	if (index->generation == server->usable_area_generation) {
+		return;
+	}
+	index->generation = server->usable_area_generation;
+	index->count = 0;
+
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (!wlr_output_layout_get(server->output_layout,
+				output->wlr_output)) {
+			continue;
+		}
+		if (index->count == index->capacity) {
+			index->capacity = index->capacity ? 2 * index->capacity : 8;
+			index->outputs = xrealloc(index->outputs,
+				index->capacity * sizeof(*index->outputs));
+			index->boxes = xrealloc(index->boxes,
+				index->capacity * sizeof(*index->boxes));
+		}
+		wlr_output_layout_get_box(server->output_layout,
+			output->wlr_output, &index->boxes[index->count]);
+		index->outputs[index->count++] = output;
+	}
+}
+
 struct output *
 output_nearest_to(struct server *server, int lx, int ly)
 {
-	double closest_x, closest_y;
-	wlr_output_layout_closest_point(server->output_layout, NULL, lx, ly,
-		&closest_x, &closest_y);
-
-	return output_from_wlr_output(server,
-		wlr_output_layout_output_at(server->output_layout,
-			closest_x, closest_y));
+	output_index_update(server);
+	struct output_index *index = &server->output_index;
+
+	/* Same result as wlr_output_layout_closest_point() and _output_at() */
+	struct output *nearest = NULL;
+	double min_distance = DBL_MAX;
+	for (size_t i = 0; i < index->count; i++) {
+		struct wlr_box *box = &index->boxes[i];
+		if (wlr_box_contains_point(box, lx, ly)) {
+			return index->outputs[i];
+		}
+		double x, y;
+		wlr_box_closest_point(box, lx, ly, &x, &y);
+		double distance = (x - lx) * (x - lx) + (y - ly) * (y - ly);
+		if (distance < min_distance) {
+			min_distance = distance;
+			nearest = index->outputs[i];
+		}
+	}
+	return nearest;
 }
 
 struct output *
@@ -808,6 +1679,20 @@ output_is_usable(struct output *output)
 	return output && output->wlr_output->enabled && !output->leased;
 }
 
+struct view *
+output_get_fullscreen_view(struct output *output)
+{
+	struct view *view;
+	enum lab_view_criteria criteria =
+		LAB_VIEW_CRITERIA_CURRENT_WORKSPACE | LAB_VIEW_CRITERIA_FULLSCREEN;
+	for_each_view_on_output(view, output, criteria) {
+		if (!view->minimized) {
+			return view;
+		}
+	}
+	return NULL;
+}
+
 /* returns true if usable area changed */
 static bool
 update_usable_area(struct output *output)
@@ -825,7 +1710,27 @@ update_usable_area(struct output *output)
 		}
 	}
 #endif
-	return !wlr_box_equal(&old, &output->usable_area);
+	if (wlr_box_equal(&old, &output->usable_area)) {
+		return false;
+	}
+	output->usable_area_generation++;
+	output->server->usable_area_generation++;
+	return true;
+}
+
+/* returns true if the output was moved or resized in the layout */
+static bool
+update_layout_box(struct output *output)
+{
+	struct wlr_box box;
+	wlr_output_layout_get_box(output->server->output_layout,
+		output->wlr_output, &box);
+	if (wlr_box_equal(&box, &output->usable_area_layout_box)) {
+		return false;
+	}
+	output->usable_area_layout_box = box;
+	output->usable_area_generation++;
+	return true;
 }
 
 void
@@ -833,10 +1738,11 @@ output_update_usable_area(struct output *output)
 {
 	if (update_usable_area(output)) {
 		regions_update_geometry(output);
+		edges_invalidate_outputs(output->server);
 #if HAVE_XWAYLAND
 		xwayland_update_workarea(output->server);
 #endif
-		desktop_arrange_all_views(output->server);
+		desktop_arrange_changed_views(output->server);
 	}
 }
 
@@ -846,11 +1752,17 @@ output_update_all_usable_areas(struct server *server, bool layout_changed)
 	bool usable_area_changed = false;
 	struct output *output;
 
+	if (layout_changed) {
+		server->usable_area_generation++;
+	}
 	wl_list_for_each(output, &server->outputs, link) {
 		if (update_usable_area(output)) {
 			usable_area_changed = true;
+			update_layout_box(output);
 			regions_update_geometry(output);
-		} else if (layout_changed) {
+			edges_invalidate_outputs(server);
+		} else if (layout_changed && update_layout_box(output)) {
+			/* Other outputs keep their regions */
 			regions_update_geometry(output);
 		}
 	}
@@ -858,7 +1770,7 @@ output_update_all_usable_areas(struct server *server, bool layout_changed)
 #if HAVE_XWAYLAND
 		xwayland_update_workarea(server);
 #endif
-		desktop_arrange_all_views(server);
+		desktop_arrange_changed_views(server);
 	}
 }
 
@@ -868,12 +1780,18 @@ output_usable_area_in_layout_coords(struct output *output)
 	if (!output) {
 		return (struct wlr_box){0};
 	}
+	uint64_t generation = output->server->usable_area_generation;
+	if (output->usable_area_in_layout_generation == generation) {
+		return output->usable_area_in_layout;
+	}
 	struct wlr_box box = output->usable_area;
 	double ox = 0, oy = 0;
 	wlr_output_layout_output_coords(output->server->output_layout,
 		output->wlr_output, &ox, &oy);
 	box.x -= ox;
 	box.y -= oy;
+	output->usable_area_in_layout = box;
+	output->usable_area_in_layout_generation = generation;
 	return box;
 }
 
@@ -895,6 +1813,100 @@ output_usable_area_scaled(struct output *output)
 	return usable;
 }
 
+static enum wlr_direction
+edge_direction(enum view_edge edge)
+{
+	switch (edge) {
+	case VIEW_EDGE_LEFT:
+		return WLR_DIRECTION_LEFT;
+	case VIEW_EDGE_RIGHT:
+		return WLR_DIRECTION_RIGHT;
+	case VIEW_EDGE_DOWN:
+		return WLR_DIRECTION_DOWN;
+	default:
+		return WLR_DIRECTION_UP;
+	}
+}
+
+static void
+update_edge_snap(struct output *output)
+{
+	struct output_edge_snap *snap = &output->edge_snap;
+	struct wlr_box usable = output_usable_area_in_layout_coords(output);
+	struct wlr_box scaled = output_usable_area_scaled(output);
+	int gap = rc.gap;
+	snap->adjacent = 0;
+
+	for (enum view_edge edge = VIEW_EDGE_LEFT; edge <= VIEW_EDGE_CENTER;
+			edge++) {
+		/* Half of the usable area for the overlay */
+		struct wlr_box box = usable;
+		switch (edge) {
+		case VIEW_EDGE_RIGHT:
+			box.x += box.width / 2;
+			/* fallthrough */
+		case VIEW_EDGE_LEFT:
+			box.width /= 2;
+			break;
+		case VIEW_EDGE_DOWN:
+			box.y += box.height / 2;
+			/* fallthrough */
+		case VIEW_EDGE_UP:
+			box.height /= 2;
+			break;
+		default:
+			/* <topMaximize> */
+			break;
+		}
+		snap->overlay[edge] = box;
+
+		/* The same with gaps for snapped views */
+		box.x = scaled.x + (edge == VIEW_EDGE_RIGHT
+			? (scaled.width + gap) / 2 : gap);
+		box.y = scaled.y + (edge == VIEW_EDGE_DOWN
+			? (scaled.height + gap) / 2 : gap);
+		switch (edge) {
+		case VIEW_EDGE_LEFT:
+		case VIEW_EDGE_RIGHT:
+			box.width = (scaled.width - 3 * gap) / 2;
+			box.height = scaled.height - 2 * gap;
+			break;
+		case VIEW_EDGE_UP:
+		case VIEW_EDGE_DOWN:
+			box.width = scaled.width - 2 * gap;
+			box.height = (scaled.height - 3 * gap) / 2;
+			break;
+		default:
+			box.width = scaled.width - 2 * gap;
+			box.height = scaled.height - 2 * gap;
+			break;
+		}
+		snap->target[edge] = box;
+
+		/* Whether there is an output does not depend on the ref point */
+		if (wlr_output_layout_adjacent_output(
+				output->server->output_layout,
+				edge_direction(edge), output->wlr_output,
+				usable.x, usable.y)) {
+			snap->adjacent |= 1u << edge;
+		}
+	}
+	snap->generation = output->server->usable_area_generation;
+	snap->gap = gap;
+}
+
+const struct output_edge_snap *
+output_get_edge_snap(struct output *output)
+{
+	assert(output);
+	if (output->edge_snap.generation
+			!= output->server->usable_area_generation
+			|| output->edge_snap.gap != rc.gap) {
+		update_edge_snap(output);
+	}
+	return &output->edge_snap;
+}
+
 void
 handle_output_power_manager_set_mode(struct wl_listener *listener, void *data)
 {
@@ -916,12 +1928,53 @@ handle_output_power_manager_set_mode(struct wl_listener *listener, void *data)
 		/*
 		 * Re-set the cursor image so that the cursor
 		 * isn't invisible on the newly enabled output.
+		 * The output may not have been seen disabled.
 		 */
+		server->seat.cursor_image_key = 0;
 		cursor_update_image(&server->seat);
 		break;
 	}
 }
 
+struct wlr_output_cursor *
+output_get_software_cursor(struct output *output)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+	struct wlr_output_cursor *cursor;
+	wl_list_for_each(cursor, &wlr_output->cursors, link) {
+		if (cursor->enabled && cursor->visible
+				&& cursor != wlr_output->hardware_cursor) {
+			return cursor;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Used for fullscreen-only adaptive sync. The change is committed along
+ * with the next frame, and only if it differs from the current state.
+ */
+void
+output_set_adaptive_sync(struct output *output, bool enabled)
+{
+	if (!output_is_usable(output)) {
+		return;
+	}
+	struct wlr_output *wlr_output = output->wlr_output;
+	bool current = wlr_output->adaptive_sync_status
+		== WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED;
+	if (enabled == current || (enabled && output->adaptive_sync_support
+			== LAB_ADAPTIVE_SYNC_UNSUPPORTED)) {
+		output->adaptive_sync_pending = false;
+		return;
+	}
+	output->adaptive_sync_pending = true;
+	output->adaptive_sync_wanted = enabled;
+	/* Make sure that the next frame is committed */
+	wlr_damage_ring_add_whole(&output->scene_output->damage_ring);
+	wlr_output_schedule_frame(wlr_output);
+}
+
 void
 output_enable_adaptive_sync(struct wlr_output *output, bool enabled)
 {
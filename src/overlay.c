@@ -108,31 +108,10 @@ show_region_overlay(struct seat *seat, struct region *region)
 	show_overlay(seat, &seat->overlay.region_rect, &region->geo);
 }
 
-/* TODO: share logic with view_get_edge_snap_box() */
 static struct wlr_box get_edge_snap_box(enum view_edge edge, struct output *output)
 {
-	struct wlr_box box = output_usable_area_in_layout_coords(output);
-	switch (edge) {
-	case VIEW_EDGE_RIGHT:
-		box.x += box.width / 2;
-		/* fallthrough */
-	case VIEW_EDGE_LEFT:
-		box.width /= 2;
-		break;
-	case VIEW_EDGE_DOWN:
-		box.y += box.height / 2;
-		/* fallthrough */
-	case VIEW_EDGE_UP:
-		box.height /= 2;
-		break;
-	case VIEW_EDGE_CENTER:
-		/* <topMaximize> */
-		break;
-	default:
-		/* not reached */
-		assert(false);
-	}
-	return box;
+	assert(edge >= VIEW_EDGE_LEFT && edge <= VIEW_EDGE_CENTER);
+	return output_get_edge_snap(output)->overlay[edge];
 }
 
 static int
@@ -147,33 +126,10 @@ handle_edge_overlay_timeout(void *data)
 	return 0;
 }
 
-static enum wlr_direction
-get_wlr_direction(enum view_edge edge)
-{
-	switch (edge) {
-	case VIEW_EDGE_LEFT:
-		return WLR_DIRECTION_LEFT;
-	case VIEW_EDGE_RIGHT:
-		return WLR_DIRECTION_RIGHT;
-	case VIEW_EDGE_UP:
-	case VIEW_EDGE_CENTER:
-		return WLR_DIRECTION_UP;
-	case VIEW_EDGE_DOWN:
-		return WLR_DIRECTION_DOWN;
-	default:
-		/* not reached */
-		assert(false);
-		return 0;
-	}
-}
-
 static bool
-edge_has_adjacent_output_from_cursor(struct seat *seat, struct output *output,
-		enum view_edge edge)
+edge_has_adjacent_output(struct output *output, enum view_edge edge)
 {
-	return wlr_output_layout_adjacent_output(
-		seat->server->output_layout, get_wlr_direction(edge),
-		output->wlr_output, seat->cursor->x, seat->cursor->y);
+	return output_get_edge_snap(output)->adjacent & (1u << edge);
 }
 
 static void
@@ -192,7 +148,7 @@ show_edge_overlay(struct seat *seat, enum view_edge edge,
 	seat->overlay.active.output = output;
 
 	int delay;
-	if (edge_has_adjacent_output_from_cursor(seat, output, edge)) {
+	if (edge_has_adjacent_output(output, edge)) {
 		delay = rc.snap_overlay_delay_inner;
 	} else {
 		delay = rc.snap_overlay_delay_outer;
@@ -0,0 +1,336 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <cairo.h>
+#include <pango/pangocairo.h>
+#include <stdio.h>
+#include <wlr/types/wlr_output_layout.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/util/box.h>
+#include <wlr/util/log.h>
+#include "buffer.h"
+#include "common/font.h"
+#include "common/glyph-cache.h"
+#include "common/graphic-helpers.h"
+#include "common/macros.h"
+#include "common/mem.h"
+#include "common/scene-helpers.h"
+#include "common/time-helpers.h"
+#include "labwc.h"
+#include "perf-hud.h"
+#include "theme.h"
+
+#define HUD_UPDATE_MSEC 250
+#define HUD_SAMPLES_PER_SEC (1000 / HUD_UPDATE_MSEC)
+/* 12 seconds of samples in the sparkline */
+#define HUD_HISTORY 48
+#define HUD_MARGIN 8
+#define HUD_PADDING 4
+#define HUD_BAR_WIDTH 3
+#define HUD_SPARKLINE_HEIGHT 24
+#define HUD_TEXT_LINES 3
+
+/* Frames committed during one update interval */
+struct hud_sample {
+	uint32_t frames;
+	uint32_t missed_vblanks;
+	/* Sums over all frames, in microseconds */
+	uint64_t frame_usec;
+	uint64_t commit_usec;
+	uint32_t max_frame_usec;
+	/* Sum over all frames, in logical pixels */
+	uint64_t damage_area;
+};
+
+struct perf_hud {
+	struct wlr_scene_buffer *scene_buffer;
+	/* Output-local position and size of the overlay */
+	struct wlr_box box;
+
+	struct hud_sample pending;
+	struct hud_sample history[HUD_HISTORY];
+	size_t next; /* the oldest sample, overwritten next */
+	/* frame_stats.missed_vblanks at the last update */
+	uint64_t missed_vblanks;
+	/* Set while the upcoming frame only repaints the overlay */
+	bool own_frame;
+	bool drawn;
+	bool drawn_idle;
+};
+
+static const float dropped_color[4] = { 0.8f, 0.1f, 0.1f, 1.0f };
+
+static bool enabled;
+static struct wl_event_source *timer;
+
+static void
+draw_text(cairo_t *cairo, struct theme *theme, const char *text,
+		int x, int y, int width, double scale)
+{
+	PangoLayout *layout = pango_cairo_create_layout(cairo);
+	pango_layout_set_width(layout, width * PANGO_SCALE);
+	pango_layout_set_ellipsize(layout, PANGO_ELLIPSIZE_END);
+	pango_layout_set_text(layout, text, -1);
+
+	/* Cached glyphs are rendered without subpixel antialiasing */
+	cairo_font_options_t *opts = cairo_font_options_create();
+	cairo_font_options_set_antialias(opts, CAIRO_ANTIALIAS_GRAY);
+	pango_cairo_context_set_font_options(pango_layout_get_context(layout),
+		opts);
+	cairo_font_options_destroy(opts);
+
+	PangoFontDescription *desc = font_to_pango_desc(&rc.font_osd);
+	pango_layout_set_font_description(layout, desc);
+	pango_font_description_free(desc);
+	pango_cairo_update_layout(cairo, layout);
+
+	cairo_move_to(cairo, x, y);
+	glyph_cache_show_layout(cairo, layout, theme->osd_label_text_color,
+		scale);
+	g_object_unref(layout);
+}
+
+static void
+hud_draw(struct output *output)
+{
+	struct perf_hud *hud = output->perf_hud;
+	struct theme *theme = output->server->theme;
+	struct wlr_output *wlr_output = output->wlr_output;
+
+	/* Numbers are shown for the last second */
+	struct hud_sample sum = {0};
+	for (size_t i = 1; i <= HUD_SAMPLES_PER_SEC; i++) {
+		struct hud_sample *sample =
+			&hud->history[(hud->next + HUD_HISTORY - i) % HUD_HISTORY];
+		sum.frames += sample->frames;
+		sum.missed_vblanks += sample->missed_vblanks;
+		sum.frame_usec += sample->frame_usec;
+		sum.commit_usec += sample->commit_usec;
+		sum.damage_area += sample->damage_area;
+	}
+	int output_width, output_height;
+	wlr_output_effective_resolution(wlr_output,
+		&output_width, &output_height);
+	uint64_t output_area = (uint64_t)output_width * output_height;
+	double frame_msec = 0, commit_msec = 0;
+	unsigned int damage_percent = 0;
+	if (sum.frames) {
+		frame_msec = sum.frame_usec / 1000.0 / sum.frames;
+		commit_msec = sum.commit_usec / 1000.0 / sum.frames;
+		if (output_area) {
+			damage_percent = sum.damage_area * 100
+				/ (output_area * sum.frames);
+		}
+	}
+	char text[128];
+	snprintf(text, sizeof(text),
+		"%u fps, %u dropped\nframe %.1f ms, commit %.1f ms\ndamage %u%%",
+		sum.frames, sum.missed_vblanks, frame_msec, commit_msec,
+		damage_percent);
+
+	/* Sized for typical values so that the overlay does not jump */
+	int padding = theme->osd_border_width + HUD_PADDING;
+	int text_width = font_width(&rc.font_osd,
+		"frame 00.0 ms, commit 00.0 ms");
+	int text_height = HUD_TEXT_LINES * font_height(&rc.font_osd);
+	int content_width = MAX(text_width, HUD_HISTORY * HUD_BAR_WIDTH);
+	int width = content_width + 2 * padding;
+	int height = text_height + HUD_PADDING + HUD_SPARKLINE_HEIGHT
+		+ 2 * padding;
+
+	float scale = wlr_output->scale;
+	struct lab_data_buffer *buffer =
+		buffer_create_cairo(width, height, scale, true);
+	if (!buffer) {
+		wlr_log(WLR_ERROR, "Failed to allocate buffer for performance HUD");
+		return;
+	}
+	cairo_t *cairo = buffer->cairo;
+
+	set_cairo_color(cairo, theme->osd_bg_color);
+	cairo_paint(cairo);
+	set_cairo_color(cairo, theme->osd_border_color);
+	struct wlr_fbox fbox = {
+		.width = width,
+		.height = height,
+	};
+	draw_cairo_border(cairo, fbox, theme->osd_border_width);
+	if (theme->osd_bg_color[3] > 0.999f
+			&& theme->osd_border_color[3] > 0.999f) {
+		pixman_region32_union_rect(&buffer->opaque_region,
+			&buffer->opaque_region, 0, 0, width, height);
+	}
+
+	draw_text(cairo, theme, text, padding, padding, content_width, scale);
+
+	/* Slowest frame of each interval, full height is one refresh cycle */
+	int64_t period_usec = wlr_output->refresh > 0
+		? 1000000000LL / wlr_output->refresh : 16667;
+	int sparkline_y = padding + text_height + HUD_PADDING;
+	for (size_t i = 0; i < HUD_HISTORY; i++) {
+		/* Oldest first */
+		struct hud_sample *sample =
+			&hud->history[(hud->next + i) % HUD_HISTORY];
+		if (!sample->frames) {
+			continue;
+		}
+		double fraction = MIN((double)sample->max_frame_usec
+			/ period_usec, 1.0);
+		int bar_height = MAX(1, (int)(fraction * HUD_SPARKLINE_HEIGHT));
+		set_cairo_color(cairo, sample->missed_vblanks
+			? dropped_color : theme->osd_label_text_color);
+		cairo_rectangle(cairo, padding + i * HUD_BAR_WIDTH,
+			sparkline_y + HUD_SPARKLINE_HEIGHT - bar_height,
+			HUD_BAR_WIDTH - 1, bar_height);
+		cairo_fill(cairo);
+	}
+	cairo_surface_flush(cairo_get_target(cairo));
+
+	wlr_scene_buffer_set_buffer(hud->scene_buffer, &buffer->base);
+	wlr_scene_buffer_set_dest_size(hud->scene_buffer, width, height);
+	wlr_scene_buffer_set_opaque_region(hud->scene_buffer,
+		&buffer->opaque_region);
+	wlr_buffer_drop(&buffer->base);
+	hud->box.width = width;
+	hud->box.height = height;
+}
+
+static void
+hud_update(struct output *output)
+{
+	struct perf_hud *hud = output->perf_hud;
+	uint64_t missed_vblanks = output->frame_stats.missed_vblanks;
+
+	hud->pending.missed_vblanks = missed_vblanks - hud->missed_vblanks;
+	hud->missed_vblanks = missed_vblanks;
+	hud->history[hud->next] = hud->pending;
+	hud->next = (hud->next + 1) % HUD_HISTORY;
+	hud->pending = (struct hud_sample){0};
+
+	struct wlr_box output_box;
+	wlr_output_layout_get_box(output->server->output_layout,
+		output->wlr_output, &output_box);
+	hud->box.x = HUD_MARGIN;
+	hud->box.y = HUD_MARGIN;
+	wlr_scene_node_set_position(&hud->scene_buffer->node,
+		output_box.x + hud->box.x, output_box.y + hud->box.y);
+
+	/* Shifting a sparkline without any bars would not change anything */
+	bool idle = true;
+	for (size_t i = 0; i < HUD_HISTORY; i++) {
+		if (hud->history[i].frames || hud->history[i].missed_vblanks) {
+			idle = false;
+			break;
+		}
+	}
+	if (hud->drawn && idle && hud->drawn_idle) {
+		return;
+	}
+	hud_draw(output);
+	hud->drawn = true;
+	hud->drawn_idle = idle;
+}
+
+static int
+handle_update_timer(void *data)
+{
+	struct server *server = data;
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (!output_is_usable(output)) {
+			continue;
+		}
+		if (!output->perf_hud) {
+			struct perf_hud *hud = znew(*hud);
+			hud->scene_buffer = wlr_scene_buffer_create(
+				&server->scene->tree, NULL);
+			/* Not shown on top of the lock screen */
+			wlr_scene_node_place_below(&hud->scene_buffer->node,
+				&output->session_lock_tree->node);
+			hud->missed_vblanks = output->frame_stats.missed_vblanks;
+			output->perf_hud = hud;
+		}
+		hud_update(output);
+	}
+	wl_event_source_timer_update(timer, HUD_UPDATE_MSEC);
+	return 0;
+}
+
+void
+perf_hud_toggle(struct server *server)
+{
+	enabled = !enabled;
+	if (enabled) {
+		if (!timer) {
+			timer = wl_event_loop_add_timer(server->wl_event_loop,
+				handle_update_timer, server);
+		}
+		handle_update_timer(server);
+		return;
+	}
+
+	wl_event_source_timer_update(timer, 0);
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		perf_hud_output_destroy(output);
+	}
+}
+
+void
+perf_hud_record_damage(struct output *output, pixman_region32_t *damage)
+{
+	struct perf_hud *hud = output->perf_hud;
+	if (!hud) {
+		return;
+	}
+	pixman_region32_subtract_rect(damage, damage, hud->box.x, hud->box.y,
+		hud->box.width, hud->box.height);
+	hud->own_frame = !pixman_region32_not_empty(damage);
+
+	int nrects = 0;
+	pixman_box32_t *rects = pixman_region32_rectangles(damage, &nrects);
+	for (int i = 0; i < nrects; i++) {
+		hud->pending.damage_area += (uint64_t)(rects[i].x2 - rects[i].x1)
+			* (rects[i].y2 - rects[i].y1);
+	}
+}
+
+void
+perf_hud_record_commit(struct output *output,
+		struct lab_scene_commit_timing *timing)
+{
+	struct perf_hud *hud = output->perf_hud;
+	if (!hud) {
+		return;
+	}
+	if (hud->own_frame) {
+		hud->own_frame = false;
+		return;
+	}
+	uint32_t frame_usec = nsec_to_usec(timing->build_state_nsec
+		+ timing->commit_nsec);
+	hud->pending.frames++;
+	hud->pending.frame_usec += frame_usec;
+	hud->pending.commit_usec += nsec_to_usec(timing->commit_nsec);
+	hud->pending.max_frame_usec =
+		MAX(hud->pending.max_frame_usec, frame_usec);
+}
+
+void
+perf_hud_output_destroy(struct output *output)
+{
+	if (!output->perf_hud) {
+		return;
+	}
+	wlr_scene_node_destroy(&output->perf_hud->scene_buffer->node);
+	zfree(output->perf_hud);
+}
+
+void
+perf_hud_finish(void)
+{
+	if (timer) {
+		wl_event_source_remove(timer);
+		timer = NULL;
+	}
+	enabled = false;
+}
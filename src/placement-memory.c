@@ -0,0 +1,310 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/util/log.h>
+#include "common/buf.h"
+#include "common/hash.h"
+#include "common/int-map.h"
+#include "common/mem.h"
+#include "labwc.h"
+#include "placement.h"
+#include "ssd.h"
+#include "view.h"
+
+/* Changes are written out once no window has been closed for a while */
+#define PLACEMENT_MEMORY_WRITE_DELAY_MS 5000
+
+/* Position of the last window of an app, relative to its output */
+struct remembered {
+	char *app_id;
+	char *output_name;
+	int x, y;
+	uint64_t hash;
+	struct wl_list link; /* memory.entries, most recently used first */
+};
+
+static struct {
+	bool loaded;
+	bool dirty;
+	struct int_map by_hash;
+	struct wl_list entries;
+	int nr_entries;
+	struct wl_event_source *write_timer;
+} memory;
+
+static char *
+get_path(void)
+{
+	const char *state_home = getenv("XDG_STATE_HOME");
+	if (state_home && *state_home) {
+		return strdup_printf("%s/labwc/placement", state_home);
+	}
+	const char *home = getenv("HOME");
+	if (!home) {
+		return NULL;
+	}
+	return strdup_printf("%s/.local/state/labwc/placement", home);
+}
+
+static void
+entry_destroy(struct remembered *entry)
+{
+	int_map_remove(&memory.by_hash, entry->hash);
+	wl_list_remove(&entry->link);
+	free(entry->app_id);
+	free(entry->output_name);
+	free(entry);
+	memory.nr_entries--;
+}
+
+static void
+trim(int max_entries)
+{
+	while (memory.nr_entries > max_entries) {
+		struct remembered *oldest = wl_container_of(memory.entries.prev,
+			oldest, link);
+		entry_destroy(oldest);
+	}
+}
+
+static struct remembered *
+lookup(const char *app_id)
+{
+	struct remembered *entry =
+		int_map_lookup(&memory.by_hash, hash_str(HASH_INIT, app_id));
+	return entry && !strcmp(entry->app_id, app_id) ? entry : NULL;
+}
+
+/* Adds or updates the entry of @app_id and marks it most recently used */
+static struct remembered *
+remember(const char *app_id, const char *output_name, int x, int y)
+{
+	uint64_t hash = hash_str(HASH_INIT, app_id);
+	struct remembered *entry = int_map_lookup(&memory.by_hash, hash);
+	if (entry && strcmp(entry->app_id, app_id)) {
+		/* Hash collision, the older app is forgotten */
+		entry_destroy(entry);
+		entry = NULL;
+	}
+	if (!entry) {
+		entry = znew(*entry);
+		entry->app_id = xstrdup(app_id);
+		entry->hash = hash;
+		int_map_insert(&memory.by_hash, hash, entry);
+		wl_list_insert(&memory.entries, &entry->link);
+		memory.nr_entries++;
+	} else {
+		wl_list_remove(&entry->link);
+		wl_list_insert(&memory.entries, &entry->link);
+	}
+	if (!entry->output_name || strcmp(entry->output_name, output_name)) {
+		free(entry->output_name);
+		entry->output_name = xstrdup(output_name);
+	}
+	entry->x = x;
+	entry->y = y;
+	return entry;
+}
+
+/*
+ * One line per app, most recently used first:
+ * <x> <y>\t<output name>\t<app_id>
+ */
+static void
+load(void)
+{
+	memory.loaded = true;
+	wl_list_init(&memory.entries);
+
+	char *path = get_path();
+	FILE *file = path ? fopen(path, "r") : NULL;
+	free(path);
+	if (!file) {
+		return;
+	}
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+	while ((len = getline(&line, &size, file)) > 0
+			&& memory.nr_entries < rc.placement_memory_size) {
+		if (line[len - 1] == '\n') {
+			line[len - 1] = '\0';
+		}
+		int x, y, consumed = 0;
+		if (sscanf(line, "%d %d\t%n", &x, &y, &consumed) != 2
+				|| !consumed) {
+			continue;
+		}
+		char *output_name = line + consumed;
+		char *app_id = strchr(output_name, '\t');
+		if (!app_id || !*++app_id) {
+			continue;
+		}
+		app_id[-1] = '\0';
+		if (lookup(app_id)) {
+			continue;
+		}
+		/* Appending keeps the order of the file */
+		struct remembered *entry = remember(app_id, output_name, x, y);
+		wl_list_remove(&entry->link);
+		wl_list_insert(memory.entries.prev, &entry->link);
+	}
+	free(line);
+	fclose(file);
+}
+
+static void
+save(void)
+{
+	memory.dirty = false;
+	char *path = get_path();
+	if (!path) {
+		return;
+	}
+	char *dir = g_path_get_dirname(path);
+	g_mkdir_with_parents(dir, 0700);
+	g_free(dir);
+
+	struct buf buf = BUF_INIT;
+	struct remembered *entry;
+	wl_list_for_each(entry, &memory.entries, link) {
+		char position[32];
+		snprintf(position, sizeof(position), "%d %d\t",
+			entry->x, entry->y);
+		buf_add(&buf, position);
+		buf_add(&buf, entry->output_name);
+		buf_add_char(&buf, '\t');
+		buf_add(&buf, entry->app_id);
+		buf_add_char(&buf, '\n');
+	}
+	/* Written to a temporary file and renamed, so it is never partial */
+	GError *err = NULL;
+	if (!g_file_set_contents(path, buf.data, buf.len, &err)) {
+		wlr_log(WLR_ERROR, "failed to save window positions: %s",
+			err->message);
+		g_error_free(err);
+	}
+	buf_reset(&buf);
+	free(path);
+}
+
+static int
+handle_write_timer(void *data)
+{
+	save();
+	return 0;
+}
+
+static bool
+ensure_loaded(void)
+{
+	if (rc.placement_memory_size <= 0) {
+		return false;
+	}
+	if (!memory.loaded) {
+		load();
+	}
+	return true;
+}
+
+static const char *
+get_app_id(struct view *view)
+{
+	const char *app_id = view_get_string_prop(view, "app_id");
+	return app_id && *app_id && !strpbrk(app_id, "\t\n") ? app_id : NULL;
+}
+
+bool
+placement_memory_place(struct view *view)
+{
+	const char *app_id = get_app_id(view);
+	if (!app_id || !view_is_floating(view) || view_get_root(view) != view
+			|| !ensure_loaded()) {
+		return false;
+	}
+	struct remembered *entry = lookup(app_id);
+	if (!entry) {
+		return false;
+	}
+	struct output *output = output_from_name(view->server,
+		entry->output_name);
+	if (!output) {
+		return false;
+	}
+
+	/* Only if the window fits where it was, in its current size */
+	struct wlr_box usable = output_usable_area_in_layout_coords(output);
+	struct wlr_box layout_box;
+	wlr_output_layout_get_box(view->server->output_layout,
+		output->wlr_output, &layout_box);
+	struct border margin = ssd_get_margin(view);
+	struct wlr_box box = {
+		.x = layout_box.x + entry->x - margin.left,
+		.y = layout_box.y + entry->y - margin.top,
+		.width = view->pending.width + margin.left + margin.right,
+		.height = view->pending.height + margin.top + margin.bottom,
+	};
+	if (box.x < usable.x || box.y < usable.y
+			|| box.x + box.width > usable.x + usable.width
+			|| box.y + box.height > usable.y + usable.height) {
+		return false;
+	}
+
+	view_set_output(view, output);
+	view_move(view, layout_box.x + entry->x, layout_box.y + entry->y);
+	return true;
+}
+
+void
+placement_memory_record(struct view *view)
+{
+	const char *app_id = get_app_id(view);
+	if (!app_id || !ensure_loaded() || view_get_root(view) != view
+			|| !output_is_usable(view->output)
+			|| !view->output->wlr_output->name) {
+		return;
+	}
+	struct wlr_box geometry = view_is_floating(view)
+		? view->pending : view->natural_geometry;
+	if (wlr_box_empty(&geometry)) {
+		return;
+	}
+	struct wlr_box layout_box;
+	wlr_output_layout_get_box(view->server->output_layout,
+		view->output->wlr_output, &layout_box);
+	remember(app_id, view->output->wlr_output->name,
+		geometry.x - layout_box.x, geometry.y - layout_box.y);
+	trim(rc.placement_memory_size);
+
+	memory.dirty = true;
+	if (!memory.write_timer) {
+		memory.write_timer = wl_event_loop_add_timer(
+			view->server->wl_event_loop, handle_write_timer, NULL);
+	}
+	wl_event_source_timer_update(memory.write_timer,
+		PLACEMENT_MEMORY_WRITE_DELAY_MS);
+}
+
+void
+placement_memory_finish(void)
+{
+	if (memory.write_timer) {
+		wl_event_source_remove(memory.write_timer);
+		memory.write_timer = NULL;
+	}
+	if (!memory.loaded) {
+		return;
+	}
+	if (memory.dirty) {
+		save();
+	}
+	struct remembered *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &memory.entries, link) {
+		entry_destroy(entry);
+	}
+	int_map_finish(&memory.by_hash);
+	memory.loaded = false;
+}
@@ -1,8 +1,9 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include <assert.h>
-#include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include "common/macros.h"
 #include "common/mem.h"
 #include "labwc.h"
@@ -11,7 +12,11 @@
 #include "view.h"
 
 #define overlap_bitmap_index(bmp, i, j) \
-	(bmp)->grid[i * ((bmp)->nr_cols - 1) + j]
+	(bmp)->grid[(i) * ((bmp)->nr_cols - 1) + (j)]
+
+/* Summed-area table entries live on grid points, not intervals */
+#define overlap_sum_index(bmp, i, j) \
+	(bmp)->sums[(i) * (bmp)->nr_cols + (j)]
 
 struct overlap_bitmap {
 	int nr_rows;
@@ -19,6 +24,26 @@ struct overlap_bitmap {
 	int *rows;
 	int *cols;
 	int *grid;
+	/*
+	 * sums(i, j) is the overlap (area times overlap count) of the
+	 * region spanned by grid points [0, j] x [0, i]
+	 */
+	int64_t *sums;
+};
+
+/*
+ * Several views mapping within the same event loop iteration (as when a
+ * session is restored) would each rebuild the same grid. Instead, the grid
+ * is kept until the loop goes idle and each placed view is added to it.
+ * The grid is only reused if the views it was built from are unchanged,
+ * which is checked against an order-independent hash of their extents.
+ */
+struct placement_cache {
+	struct overlap_bitmap bmp;
+	struct output *output;
+	struct wlr_box usable;
+	uint64_t views_hash;
+	struct wl_event_source *idle;
 };
 
 static int
@@ -35,19 +60,67 @@ destroy_bitmap(struct overlap_bitmap *bmp)
 	zfree(bmp->rows);
 	zfree(bmp->cols);
 	zfree(bmp->grid);
+	zfree(bmp->sums);
 
 	bmp->nr_rows = 0;
 	bmp->nr_cols = 0;
 }
 
+/* Outer extents of a view, including decorations */
+static struct border
+view_extents(struct view *v)
+{
+	struct border margin = ssd_get_margin(v);
+	return (struct border){
+		.left = v->pending.x - margin.left,
+		.top = v->pending.y - margin.top,
+		.right = v->pending.x + margin.right + v->pending.width,
+		.bottom = v->pending.y + margin.bottom
+			+ view_effective_height(v, /* use_pending */ true),
+	};
+}
+
+static uint64_t
+mix_hash(uint64_t x)
+{
+	/* splitmix64 finalizer */
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+	return x ^ (x >> 31);
+}
+
+static uint64_t
+hash_view(struct view *v, struct border extents)
+{
+	uint64_t h = mix_hash((uintptr_t)v);
+	h = mix_hash(h ^ (uint32_t)extents.left);
+	h = mix_hash(h ^ (uint32_t)extents.top);
+	h = mix_hash(h ^ (uint32_t)extents.right);
+	return mix_hash(h ^ (uint32_t)extents.bottom);
+}
+
+/* Hash all views on view->output, excluding *view itself, in any order */
+static uint64_t
+hash_views(struct view *view)
+{
+	uint64_t hash = 0;
+	struct view *v;
+	for_each_view_on_output(v, view->output,
+			LAB_VIEW_CRITERIA_CURRENT_WORKSPACE) {
+		if (v == view) {
+			continue;
+		}
+		hash += hash_view(v, view_extents(v));
+	}
+	return hash;
+}
+
 /* Count the number of views on view->output, excluding *view itself */
 static int
 count_views(struct view *view)
 {
 	assert(view);
 
-	struct server *server = view->server;
-
 	struct output *output = view->output;
 	if (!output_is_usable(output)) {
 		return 0;
@@ -56,9 +129,9 @@ count_views(struct view *view)
 	int nviews = 0;
 
 	struct view *v;
-	for_each_view(v, &server->views, LAB_VIEW_CRITERIA_CURRENT_WORKSPACE) {
-		/* Ignore the target view or anything on a different output */
-		if (v == view || v->output != output) {
+	for_each_view_on_output(v, output, LAB_VIEW_CRITERIA_CURRENT_WORKSPACE) {
+		/* Ignore the target view */
+		if (v == view) {
 			continue;
 		}
 
@@ -105,8 +178,6 @@ build_grid(struct overlap_bitmap *bmp, struct view *view)
 	assert(bmp);
 	assert(view);
 
-	struct server *server = view->server;
-
 	/* Always start with a fresh bitmap */
 	destroy_bitmap(bmp);
 
@@ -145,14 +216,14 @@ build_grid(struct overlap_bitmap *bmp, struct view *view)
 	int nr_cols = 2;
 
 	struct view *v;
-	for_each_view(v, &server->views, LAB_VIEW_CRITERIA_CURRENT_WORKSPACE) {
-		if (v == view || v->output != output) {
+	for_each_view_on_output(v, output, LAB_VIEW_CRITERIA_CURRENT_WORKSPACE) {
+		if (v == view) {
 			continue;
 		}
 
-		struct border margin = ssd_get_margin(v->ssd);
-		int x = v->pending.x - margin.left;
-		int y = v->pending.y - margin.top;
+		struct border extents = view_extents(v);
+		int x = extents.left;
+		int y = extents.top;
 
 		/* Add a column if the left view edge is in the usable region */
 		if (x > usable.x && x < usable_right) {
@@ -166,9 +237,8 @@ build_grid(struct overlap_bitmap *bmp, struct view *view)
 			bmp->rows[nr_rows++] = y;
 		}
 
-		x = v->pending.x + margin.right + v->pending.width;
-		y = v->pending.y + margin.bottom
-			+ view_effective_height(v, /* use_pending */ true);
+		x = extents.right;
+		y = extents.bottom;
 
 		/* Add a column if the right view edge is in the usable region */
 		if (x > usable.x && x < usable_right) {
@@ -189,7 +259,8 @@ build_grid(struct overlap_bitmap *bmp, struct view *view)
 	int grid_size = (bmp->nr_rows - 1) * (bmp->nr_cols - 1);
 
 	bmp->grid = xzalloc(grid_size * sizeof(int));
-	if (!bmp->grid) {
+	bmp->sums = xzalloc(bmp->nr_rows * bmp->nr_cols * sizeof(int64_t));
+	if (!bmp->grid || !bmp->sums) {
 		destroy_bitmap(bmp);
 		return;
 	}
@@ -224,11 +295,40 @@ find_interval(int *edges, int nedges, double val)
 	return r - 1;
 }
 
+/* Build the summed-area table of weighted interval areas */
+static void
+build_sums(struct overlap_bitmap *bmp)
+{
+	int nri = bmp->nr_rows - 1;
+	int nci = bmp->nr_cols - 1;
+
+	for (int j = 0; j < bmp->nr_cols; ++j) {
+		overlap_sum_index(bmp, 0, j) = 0;
+	}
+	for (int i = 0; i < nri; ++i) {
+		int rh = bmp->rows[i + 1] - bmp->rows[i];
+		overlap_sum_index(bmp, i + 1, 0) = 0;
+		for (int j = 0; j < nci; ++j) {
+			int cw = bmp->cols[j + 1] - bmp->cols[j];
+			overlap_sum_index(bmp, i + 1, j + 1) =
+				(int64_t)overlap_bitmap_index(bmp, i, j) * rh * cw
+				+ overlap_sum_index(bmp, i, j + 1)
+				+ overlap_sum_index(bmp, i + 1, j)
+				- overlap_sum_index(bmp, i, j);
+		}
+	}
+}
+
 /*
  * Construct an overlap bitmap for the irregular grid, computed by
  * build_grid(), that spans view->output. The overlap bitmap maps
  * each interval to the number of views on the output (excluding *view)
  * that overlap that interval.
+ *
+ * Views are first recorded as corner increments, which are then turned
+ * into overlap counts by a 2-D prefix sum. A second prefix sum, weighted
+ * by interval areas, yields the summed-area table used by
+ * compute_overlap().
  */
 static void
 build_overlap(struct overlap_bitmap *bmp, struct view *view)
@@ -236,8 +336,6 @@ build_overlap(struct overlap_bitmap *bmp, struct view *view)
 	assert(bmp);
 	assert(view);
 
-	struct server *server = view->server;
-
 	if (bmp->nr_rows < 1 || bmp->nr_cols < 1) {
 		return;
 	}
@@ -248,18 +346,17 @@ build_overlap(struct overlap_bitmap *bmp, struct view *view)
 	}
 
 	struct view *v;
-	for_each_view(v, &server->views, LAB_VIEW_CRITERIA_CURRENT_WORKSPACE) {
-		if (v == view || v->output != output) {
+	for_each_view_on_output(v, output, LAB_VIEW_CRITERIA_CURRENT_WORKSPACE) {
+		if (v == view) {
 			continue;
 		}
 
 		/* Find boundaries of the window */
-		struct border margin = ssd_get_margin(v->ssd);
-		int lx = v->pending.x - margin.left;
-		int ly = v->pending.y - margin.top;
-		int hx = v->pending.x + margin.right + v->pending.width;
-		int hy = v->pending.y + margin.bottom
-			+ view_effective_height(v, /* use_pending */ true);
+		struct border extents = view_extents(v);
+		int lx = extents.left;
+		int ly = extents.top;
+		int hx = extents.right;
+		int hy = extents.bottom;
 
 		/*
 		 * Find the first and last row and column intervals spanned by
@@ -295,103 +392,233 @@ build_overlap(struct overlap_bitmap *bmp, struct view *view)
 
 		/*
 		 * Every interval in the region [fr, lr) x [fc, lc) is
-		 * completely covered by the view. Increment the overlap
-		 * counters these intervals to account for the view.
+		 * completely covered by the view. Mark its corners so the
+		 * prefix sum below increments the overlap counters of all
+		 * these intervals.
 		 */
-		for (int i = fr; i < lr; ++i) {
-			for (int j = fc; j < lc; ++j) {
-				overlap_bitmap_index(bmp, i, j) += 1;
+		if (fr >= lr || fc >= lc) {
+			continue;
+		}
+		overlap_sum_index(bmp, fr, fc) += 1;
+		overlap_sum_index(bmp, fr, lc) -= 1;
+		overlap_sum_index(bmp, lr, fc) -= 1;
+		overlap_sum_index(bmp, lr, lc) += 1;
+	}
+
+	int nri = bmp->nr_rows - 1;
+	int nci = bmp->nr_cols - 1;
+
+	/* Resolve corner increments into per-interval overlap counts */
+	for (int i = 0; i < nri; ++i) {
+		for (int j = 0; j < nci; ++j) {
+			int count = overlap_sum_index(bmp, i, j);
+			if (i > 0) {
+				count += overlap_bitmap_index(bmp, i - 1, j);
+			}
+			if (j > 0) {
+				count += overlap_bitmap_index(bmp, i, j - 1);
 			}
+			if (i > 0 && j > 0) {
+				count -= overlap_bitmap_index(bmp, i - 1, j - 1);
+			}
+			overlap_bitmap_index(bmp, i, j) = count;
 		}
 	}
+
+	build_sums(bmp);
 }
 
 /*
- * Find the total overlap of an arbitrary region of a given width and height
- * with intervals in a pre-computed overlap bitmap. The starting interval for
- * the region is (i, j) in the bitmap grid. If the region is larger than
- * interval (i, j), neighboring regions will be considered width-wise rightward
- * (when right is true) or leftward (otherwise) and height-wise downward (when
- * down is true) or upward (otherwise).
- *
- * If the region would extend beyond the edges of the grid (i.e., beyond the
- * usable region of an output) in the prescribed directions, an overlap of
- * INT_MAX is returned. Otherwise, the overlap is the sum of the areas of each
- * interval covered by the region multiplied by its overlap count. For example,
- * an interval currently covered by three windows will be triply counted in the
- * overlap sum.
+ * Return the overlap of the region spanned by (cols[0], rows[0]) and the
+ * point (x, y), which must lie within the grid. Overlap counts are constant
+ * within an interval, so the summed-area table can be interpolated exactly
+ * for points that are not grid points.
  */
-static int
-compute_overlap(struct overlap_bitmap *bmp, int i, int j,
-		int width, int height, bool right, bool down, bool *single)
+static int64_t
+overlap_at(struct overlap_bitmap *bmp, int x, int y)
 {
-	/*
-	 * The number of row or column intervals is one less than corresponding
-	 * number of row or column grid points.
-	 */
 	int nri = bmp->nr_rows - 1;
 	int nci = bmp->nr_cols - 1;
 
-	int i_incr = down ? 1 : -1;
-	int j_incr = right ? 1 : -1;
+	/* Interval containing the point; the far grid edge maps to the last */
+	int j = MIN(find_interval(bmp->cols, bmp->nr_cols, x), nci - 1);
+	int i = MIN(find_interval(bmp->rows, bmp->nr_rows, y), nri - 1);
 
-	int overlap = 0;
-	int count = 0;
+	int dx = x - bmp->cols[j];
+	int dy = y - bmp->rows[i];
+	int cw = bmp->cols[j + 1] - bmp->cols[j];
+	int rh = bmp->rows[i + 1] - bmp->rows[i];
 
-	/* Walk up or down along rows according to preference */
-	for (int ii = i; ii >= 0 && ii < nri && height > 0; ii += i_incr) {
-		/* Height of this row */
-		int rh = bmp->rows[ii + 1] - bmp->rows[ii];
+	int64_t base = overlap_sum_index(bmp, i, j);
+	/* Overlap of the column strip above and the row strip left of (i, j) */
+	int64_t above = overlap_sum_index(bmp, i, j + 1) - base;
+	int64_t left = overlap_sum_index(bmp, i + 1, j) - base;
 
-		/* Height of overlap between this row and test region */
-		int mh = MAX(0, MIN(height, rh));
-
-		/* Remaining height to consider for next row */
-		height -= rh;
-
-		/* Walk left or right along columns according to preference */
-		int ww = width;
-		for (int jj = j; jj >= 0 && jj < nci && ww > 0; jj += j_incr) {
-			/* Width of this column */
-			int cw = bmp->cols[jj + 1] - bmp->cols[jj];
-
-			/* Width of overlap between this column and test region */
-			int mw = MAX(0, MIN(ww, cw));
-
-			/* Add overlap contribution for this interval */
-			overlap += overlap_bitmap_index(bmp, ii, jj) * mh * mw;
-
-			/* Count the number of overlapping intervals */
-			count++;
+	/* Both strips are multiples of the interval width and height */
+	return base + above / cw * dx + left / rh * dy
+		+ (int64_t)overlap_bitmap_index(bmp, i, j) * dx * dy;
+}
 
-			/* Remaining width to consider for next column */
-			ww -= cw;
-		}
+/* Merge the edges of an interval into a 1-D grid within [low, high] */
+static int *
+merge_grid(int *edges, int *nedges, int lesser, int greater, int low,
+		int high)
+{
+	int *merged = znew_n(int, *nedges + 2);
+	memcpy(merged, edges, *nedges * sizeof(int));
+	int n = *nedges;
+	if (lesser > low && lesser < high) {
+		merged[n++] = lesser;
+	}
+	if (greater > low && greater < high) {
+		merged[n++] = greater;
+	}
+	*nedges = order_grid(merged, n);
+	return merged;
+}
 
-		/*
-		 * If there is width left to consider after walking columns,
-		 * the region extends out of bounds and placement is invalid.
-		 */
-		if (ww > 0) {
-			overlap = INT_MAX;
-			break;
+/*
+ * Add a view with the given extents to an existing overlap bitmap, with the
+ * same result as if build_grid() and build_overlap() had included it. New
+ * intervals split off an existing one inherit its overlap count.
+ */
+static void
+grid_add_view(struct overlap_bitmap *bmp, struct wlr_box usable,
+		struct border extents)
+{
+	if (bmp->nr_rows < 2 || bmp->nr_cols < 2) {
+		/* The grid is empty when there were no other views */
+		if (wlr_box_empty(&usable)) {
+			return;
 		}
+		destroy_bitmap(bmp);
+		bmp->rows = znew_n(int, 2);
+		bmp->cols = znew_n(int, 2);
+		bmp->rows[0] = usable.y;
+		bmp->rows[1] = usable.y + usable.height;
+		bmp->cols[0] = usable.x;
+		bmp->cols[1] = usable.x + usable.width;
+		bmp->nr_rows = 2;
+		bmp->nr_cols = 2;
+		bmp->grid = znew_n(int, 1);
 	}
 
+	int nr_rows = bmp->nr_rows;
+	int nr_cols = bmp->nr_cols;
+	int *rows = merge_grid(bmp->rows, &nr_rows, extents.top,
+		extents.bottom, usable.y, usable.y + usable.height);
+	int *cols = merge_grid(bmp->cols, &nr_cols, extents.left,
+		extents.right, usable.x, usable.x + usable.width);
+
 	/*
-	 * If there is height left ot consider after walking rows, the region
-	 * extends out of bounds and placement is invalid.
+	 * Map every new interval to the old interval containing it and
+	 * note whether the view covers it, perturbing by 0.5 units as in
+	 * build_overlap() to search in the interior of old intervals.
 	 */
-	if (height > 0) {
-		overlap = INT_MAX;
+	int *row_src = znew_n(int, nr_rows - 1);
+	bool *row_covered = znew_n(bool, nr_rows - 1);
+	for (int i = 0; i < nr_rows - 1; ++i) {
+		row_src[i] = find_interval(bmp->rows, bmp->nr_rows,
+			rows[i] + 0.5);
+		row_covered[i] = rows[i] >= extents.top
+			&& rows[i + 1] <= extents.bottom;
+	}
+	int *col_src = znew_n(int, nr_cols - 1);
+	bool *col_covered = znew_n(bool, nr_cols - 1);
+	for (int j = 0; j < nr_cols - 1; ++j) {
+		col_src[j] = find_interval(bmp->cols, bmp->nr_cols,
+			cols[j] + 0.5);
+		col_covered[j] = cols[j] >= extents.left
+			&& cols[j + 1] <= extents.right;
 	}
 
+	int *grid = znew_n(int, (nr_rows - 1) * (nr_cols - 1));
+	for (int i = 0; i < nr_rows - 1; ++i) {
+		for (int j = 0; j < nr_cols - 1; ++j) {
+			grid[i * (nr_cols - 1) + j] =
+				overlap_bitmap_index(bmp, row_src[i], col_src[j])
+				+ (row_covered[i] && col_covered[j]);
+		}
+	}
+	free(row_src);
+	free(row_covered);
+	free(col_src);
+	free(col_covered);
+
+	destroy_bitmap(bmp);
+	bmp->rows = rows;
+	bmp->cols = cols;
+	bmp->grid = grid;
+	bmp->nr_rows = nr_rows;
+	bmp->nr_cols = nr_cols;
+	bmp->sums = znew_n(int64_t, nr_rows * nr_cols);
+	build_sums(bmp);
+}
+
+/*
+ * Find the total overlap of an arbitrary region of a given width and height
+ * with intervals in a pre-computed overlap bitmap. The starting interval for
+ * the region is (i, j) in the bitmap grid. If the region is larger than
+ * interval (i, j), neighboring regions will be considered width-wise rightward
+ * (when right is true) or leftward (otherwise) and height-wise downward (when
+ * down is true) or upward (otherwise).
+ *
+ * If the region would extend beyond the edges of the grid (i.e., beyond the
+ * usable region of an output) in the prescribed directions, an overlap of
+ * INT64_MAX is returned. Otherwise, the overlap is the sum of the areas of
+ * each interval covered by the region multiplied by its overlap count. For
+ * example, an interval currently covered by three windows will be triply
+ * counted in the overlap sum.
+ *
+ * The overlap is looked up from the summed-area table in constant time.
+ */
+static int64_t
+compute_overlap(struct overlap_bitmap *bmp, int i, int j,
+		int width, int height, bool right, bool down, bool *single)
+{
+	int x1 = right ? bmp->cols[j] : bmp->cols[j + 1] - width;
+	int y1 = down ? bmp->rows[i] : bmp->rows[i + 1] - height;
+	int x2 = x1 + width;
+	int y2 = y1 + height;
+
 	/* Indicate whether overlap is confined to a single region */
 	if (single) {
-		*single = (count == 1);
+		*single = width <= bmp->cols[j + 1] - bmp->cols[j]
+			&& height <= bmp->rows[i + 1] - bmp->rows[i];
+	}
+
+	/* Placement is invalid if the region extends out of bounds */
+	if (x1 < bmp->cols[0] || x2 > bmp->cols[bmp->nr_cols - 1]
+			|| y1 < bmp->rows[0] || y2 > bmp->rows[bmp->nr_rows - 1]) {
+		return INT64_MAX;
 	}
 
-	return overlap;
+	return overlap_at(bmp, x2, y2) - overlap_at(bmp, x1, y2)
+		- overlap_at(bmp, x2, y1) + overlap_at(bmp, x1, y1);
+}
+
+static void
+handle_cache_idle(void *data)
+{
+	struct placement_cache *cache = data;
+	cache->idle = NULL;
+	cache->output = NULL;
+	destroy_bitmap(&cache->bmp);
+}
+
+static struct placement_cache *
+get_cache(struct server *server)
+{
+	if (!server->placement_cache) {
+		server->placement_cache = znew(*server->placement_cache);
+	}
+	struct placement_cache *cache = server->placement_cache;
+	if (!cache->idle) {
+		/* Only keep the grid for the current event loop iteration */
+		cache->idle = wl_event_loop_add_idle(server->wl_event_loop,
+			handle_cache_idle, cache);
+	}
+	return cache;
 }
 
 /*
@@ -405,7 +632,7 @@ placement_find_best(struct view *view, struct wlr_box *geometry)
 {
 	assert(view);
 
-	struct border margin = ssd_get_margin(view->ssd);
+	struct border margin = ssd_get_margin(view);
 
 	struct output *output = view->output;
 	if (!output_is_usable(output)) {
@@ -417,10 +644,18 @@ placement_find_best(struct view *view, struct wlr_box *geometry)
 	geometry->x = usable.x + margin.left + rc.gap;
 	geometry->y = usable.y + margin.top + rc.gap;
 
-	/* Build the placement grid and overlap bitmap */
-	struct overlap_bitmap bmp = { 0 };
-	build_grid(&bmp, view);
-	build_overlap(&bmp, view);
+	/* Build the placement grid and overlap bitmap, or reuse the last one */
+	struct placement_cache *cache = get_cache(view->server);
+	uint64_t views_hash = hash_views(view);
+	if (cache->output != output || !wlr_box_equal(&cache->usable, &usable)
+			|| cache->views_hash != views_hash) {
+		build_grid(&cache->bmp, view);
+		build_overlap(&cache->bmp, view);
+		cache->output = output;
+		cache->usable = usable;
+		cache->views_hash = views_hash;
+	}
+	struct overlap_bitmap *bmp = &cache->bmp;
 
 	/* Dimensions include gap along all edges to ensure proper separation */
 	int height = geometry->height + margin.top + margin.bottom + 2 * rc.gap;
@@ -433,10 +668,10 @@ placement_find_best(struct view *view, struct wlr_box *geometry)
 	int offset_x = margin.left + rc.gap;
 	int offset_y = margin.top + rc.gap;
 
-	int min_overlap = INT_MAX;
+	int64_t min_overlap = INT64_MAX;
 
-	int nri = bmp.nr_rows - 1;
-	int nci = bmp.nr_cols - 1;
+	int nri = bmp->nr_rows - 1;
+	int nci = bmp->nr_cols - 1;
 
 	/*
 	 * Convolve the view region with the overlap grid to determine the
@@ -477,7 +712,7 @@ placement_find_best(struct view *view, struct wlr_box *geometry)
 				bool single = false;
 
 				/* Compute overlap in specified direction */
-				int overlap = compute_overlap(&bmp, i, j,
+				int64_t overlap = compute_overlap(bmp, i, j,
 					width, height, rt, dn, &single);
 
 				/* Move on if overlap isn't reduced */
@@ -490,20 +725,20 @@ placement_find_best(struct view *view, struct wlr_box *geometry)
 
 				if (rt) {
 					/* Extend window right from left edge */
-					geometry->x = bmp.cols[j] + offset_x;
+					geometry->x = bmp->cols[j] + offset_x;
 				} else {
 					/* Extend window left from right edge */
 					geometry->x =
-						bmp.cols[j + 1] - width + offset_x;
+						bmp->cols[j + 1] - width + offset_x;
 				}
 
 				if (dn) {
 					/* Extend window down from top edge */
-					geometry->y = bmp.rows[i] + offset_y;
+					geometry->y = bmp->rows[i] + offset_y;
 				} else {
 					/* Extend window up from bottom edge */
 					geometry->y =
-						bmp.rows[i + 1] - height + offset_y;
+						bmp->rows[i + 1] - height + offset_y;
 				}
 
 				/* If there is no overlap, the search is done. */
@@ -523,6 +758,32 @@ placement_find_best(struct view *view, struct wlr_box *geometry)
 	}
 
 final_placement:
-	destroy_bitmap(&bmp);
+	/*
+	 * The view is expected to end up at the chosen position, so have it
+	 * covered when the next view is placed in this iteration. If it does
+	 * not, the hash will not match and the grid is rebuilt.
+	 */
+	struct border placed = {
+		.left = geometry->x - margin.left,
+		.top = geometry->y - margin.top,
+		.right = geometry->x + margin.right + geometry->width,
+		.bottom = geometry->y + margin.bottom + geometry->height,
+	};
+	grid_add_view(bmp, usable, placed);
+	cache->views_hash += hash_view(view, placed);
 	return true;
 }
+
+void
+placement_finish(struct server *server)
+{
+	struct placement_cache *cache = server->placement_cache;
+	if (!cache) {
+		return;
+	}
+	if (cache->idle) {
+		wl_event_source_remove(cache->idle);
+	}
+	destroy_bitmap(&cache->bmp);
+	zfree(server->placement_cache);
+}
@@ -3,12 +3,12 @@
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
 #include <float.h>
-#include <math.h>
 #include <string.h>
 #include <wlr/types/wlr_scene.h>
 #include <wlr/util/box.h>
 #include <wlr/util/log.h>
 #include "common/list.h"
+#include "common/macros.h"
 #include "common/mem.h"
 #include "input/keyboard.h"
 #include "labwc.h"
@@ -56,14 +56,25 @@ regions_from_cursor(struct server *server)
 		return NULL;
 	}
 
+	struct region_grid *grid = &output->region_grid;
+	if (!grid->cell_start || !wlr_box_contains_point(&grid->box, lx, ly)) {
+		return NULL;
+	}
+	int col = (int)(lx - grid->box.x) * grid->cols / grid->box.width;
+	int row = (int)(ly - grid->box.y) * grid->rows / grid->box.height;
+	int cell = row * grid->cols + col;
+
 	double dist;
 	double dist_min = DBL_MAX;
 	struct region *closest_region = NULL;
-	struct region *region;
-	wl_list_for_each(region, &output->regions, link) {
+	for (uint32_t i = grid->cell_start[cell];
+			i < grid->cell_start[cell + 1]; i++) {
+		struct region *region = grid->candidates[i];
 		if (wlr_box_contains_point(&region->geo, lx, ly)) {
 			/* No need for sqrt((x1 - x2)^2 + (y1 - y2)^2) as we just compare */
-			dist = pow(region->center.x - lx, 2) + pow(region->center.y - ly, 2);
+			double dx = region->center.x - lx;
+			double dy = region->center.y - ly;
+			dist = dx * dx + dy * dy;
 			if (dist < dist_min) {
 				closest_region = region;
 				dist_min = dist;
@@ -73,6 +84,103 @@ regions_from_cursor(struct server *server)
 	return closest_region;
 }
 
+/* Cells along each axis, enough to keep a handful of regions per cell */
+#define REGION_GRID_SIZE 16
+
+/* Range of cells covered by @geo along one axis, in [@first, @last] */
+static void
+grid_cell_range(int start, int length, int grid_start, int grid_length,
+		int cells, int *first, int *last)
+{
+	*first = (start - grid_start) * cells / grid_length;
+	*last = (start + length - 1 - grid_start) * cells / grid_length;
+}
+
+static void
+grid_update(struct output *output)
+{
+	struct region_grid *grid = &output->region_grid;
+	grid->box = (struct wlr_box){0};
+
+	struct region *region;
+	wl_list_for_each(region, &output->regions, link) {
+		if (wlr_box_empty(&region->geo)) {
+			continue;
+		}
+		if (wlr_box_empty(&grid->box)) {
+			grid->box = region->geo;
+			continue;
+		}
+		int x2 = MAX(grid->box.x + grid->box.width,
+			region->geo.x + region->geo.width);
+		int y2 = MAX(grid->box.y + grid->box.height,
+			region->geo.y + region->geo.height);
+		grid->box.x = MIN(grid->box.x, region->geo.x);
+		grid->box.y = MIN(grid->box.y, region->geo.y);
+		grid->box.width = x2 - grid->box.x;
+		grid->box.height = y2 - grid->box.y;
+	}
+	if (wlr_box_empty(&grid->box)) {
+		regions_grid_finish(grid);
+		return;
+	}
+	grid->cols = MIN(REGION_GRID_SIZE, grid->box.width);
+	grid->rows = MIN(REGION_GRID_SIZE, grid->box.height);
+	int nr_cells = grid->cols * grid->rows;
+
+	/* Count the candidates of each cell, then fill them in list order */
+	free(grid->cell_start);
+	grid->cell_start = znew_n(uint32_t, nr_cells + 1);
+	uint32_t nr_candidates = 0;
+	for (int pass = 0; pass < 2; pass++) {
+		wl_list_for_each(region, &output->regions, link) {
+			if (wlr_box_empty(&region->geo)) {
+				continue;
+			}
+			int col_first, col_last, row_first, row_last;
+			grid_cell_range(region->geo.x, region->geo.width,
+				grid->box.x, grid->box.width, grid->cols,
+				&col_first, &col_last);
+			grid_cell_range(region->geo.y, region->geo.height,
+				grid->box.y, grid->box.height, grid->rows,
+				&row_first, &row_last);
+			for (int row = row_first; row <= row_last; row++) {
+				for (int col = col_first; col <= col_last; col++) {
+					int cell = row * grid->cols + col;
+					if (pass == 0) {
+						grid->cell_start[cell + 1]++;
+					} else {
+						grid->candidates[grid->cell_start[cell]++] =
+							region;
+					}
+				}
+			}
+		}
+		if (pass == 0) {
+			for (int i = 0; i < nr_cells; i++) {
+				grid->cell_start[i + 1] += grid->cell_start[i];
+			}
+			nr_candidates = grid->cell_start[nr_cells];
+			free(grid->candidates);
+			grid->candidates = znew_n(struct region *,
+				MAX(nr_candidates, 1));
+		}
+	}
+	/* Filling advanced each start to the start of the next cell */
+	for (int i = nr_cells; i > 0; i--) {
+		grid->cell_start[i] = grid->cell_start[i - 1];
+	}
+	grid->cell_start[0] = 0;
+}
+
+void
+regions_grid_finish(struct region_grid *grid)
+{
+	zfree(grid->cell_start);
+	zfree(grid->candidates);
+	*grid = (struct region_grid){0};
+}
+
 void
 regions_reconfigure_output(struct output *output)
 {
@@ -142,6 +250,8 @@ regions_update_geometry(struct output *output)
 		region->center.x = geo->x + geo->width / 2;
 		region->center.y = geo->y + geo->height / 2;
 	}
+
+	grid_update(output);
 }
 
 void
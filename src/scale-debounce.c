@@ -0,0 +1,193 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * wlroots notifies surfaces about output and scale changes from listeners
+ * of each wlr_scene_surface on its scene buffer. Those listeners are taken
+ * off the signals of the buffers of the grabbed view for the duration of
+ * the move, and what they would have sent is replayed from here.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <stdlib.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_fractional_scale_v1.h>
+#include <wlr/types/wlr_scene.h>
+#include "common/mem.h"
+#include "labwc.h"
+#include "scale-debounce.h"
+#include "view.h"
+
+#define SCALE_SETTLE_MS 250
+
+struct held_surface {
+	struct wlr_scene_surface *scene_surface;
+	/* What the client has been told */
+	uint64_t sent_outputs;
+	double sent_scale;
+	/* State at the last update, to tell whether it settled */
+	uint64_t seen_outputs;
+	struct wlr_scene_output *seen_primary;
+	struct wl_listener destroy;
+	struct wl_list link; /* hold.surfaces */
+};
+
+static struct {
+	struct view *view;
+	struct wl_list surfaces;
+	struct wl_event_source *settle_timer;
+} hold = {
+	.surfaces = { &hold.surfaces, &hold.surfaces },
+};
+
+static double
+primary_scale(struct wlr_scene_buffer *buffer)
+{
+	return buffer->primary_output ? buffer->primary_output->output->scale : 0;
+}
+
+static void
+held_surface_destroy(struct held_surface *held)
+{
+	wl_list_remove(&held->destroy.link);
+	wl_list_remove(&held->link);
+	free(held);
+}
+
+static void
+handle_destroy(struct wl_listener *listener, void *data)
+{
+	struct held_surface *held = wl_container_of(listener, held, destroy);
+	held_surface_destroy(held);
+}
+
+static void
+flush_surface(struct held_surface *held, struct wlr_scene *scene)
+{
+	struct wlr_scene_buffer *buffer = held->scene_surface->buffer;
+	struct wlr_surface *surface = held->scene_surface->surface;
+	uint64_t active = buffer->active_outputs;
+
+	struct wlr_scene_output *scene_output;
+	wl_list_for_each(scene_output, &scene->outputs, link) {
+		uint64_t mask = (uint64_t)1 << scene_output->index;
+		if ((active & mask) && !(held->sent_outputs & mask)) {
+			wlr_surface_send_enter(surface, scene_output->output);
+		} else if (!(active & mask) && (held->sent_outputs & mask)) {
+			wlr_surface_send_leave(surface, scene_output->output);
+		}
+	}
+	held->sent_outputs = active;
+
+	double scale = primary_scale(buffer);
+	if (scale && scale != held->sent_scale) {
+		wlr_fractional_scale_v1_notify_scale(surface, scale);
+		held->sent_scale = scale;
+	}
+}
+
+static void
+flush(void)
+{
+	struct held_surface *held;
+	wl_list_for_each(held, &hold.surfaces, link) {
+		flush_surface(held, hold.view->server->scene);
+	}
+}
+
+static int
+handle_settle_timer(void *data)
+{
+	flush();
+	return 0;
+}
+
+static void
+hold_buffer(struct wlr_scene_buffer *buffer, int sx, int sy, void *data)
+{
+	struct wlr_scene_surface *scene_surface =
+		wlr_scene_surface_try_from_buffer(buffer);
+	if (!scene_surface) {
+		return;
+	}
+
+	struct held_surface *held = znew(*held);
+	held->scene_surface = scene_surface;
+	held->sent_outputs = buffer->active_outputs;
+	held->sent_scale = primary_scale(buffer);
+	held->seen_outputs = buffer->active_outputs;
+	held->seen_primary = buffer->primary_output;
+	held->destroy.notify = handle_destroy;
+	wl_signal_add(&buffer->node.events.destroy, &held->destroy);
+	wl_list_insert(&hold.surfaces, &held->link);
+
+	/* Left initialized so that destroying the scene surface still works */
+	wl_list_remove(&scene_surface->outputs_update.link);
+	wl_list_init(&scene_surface->outputs_update.link);
+	wl_list_remove(&scene_surface->output_enter.link);
+	wl_list_init(&scene_surface->output_enter.link);
+	wl_list_remove(&scene_surface->output_leave.link);
+	wl_list_init(&scene_surface->output_leave.link);
+}
+
+void
+scale_debounce_begin(struct view *view)
+{
+	assert(view);
+	if (hold.view) {
+		scale_debounce_end(hold.view);
+	}
+	hold.view = view;
+	if (!hold.settle_timer) {
+		hold.settle_timer = wl_event_loop_add_timer(
+			view->server->wl_event_loop, handle_settle_timer, NULL);
+	}
+	wlr_scene_node_for_each_buffer(&view->scene_tree->node,
+		hold_buffer, NULL);
+}
+
+void
+scale_debounce_update(struct view *view)
+{
+	if (hold.view != view) {
+		return;
+	}
+	bool changed = false;
+	struct held_surface *held;
+	wl_list_for_each(held, &hold.surfaces, link) {
+		struct wlr_scene_buffer *buffer = held->scene_surface->buffer;
+		if (buffer->active_outputs != held->seen_outputs
+				|| buffer->primary_output != held->seen_primary) {
+			held->seen_outputs = buffer->active_outputs;
+			held->seen_primary = buffer->primary_output;
+			changed = true;
+		}
+	}
+	if (changed) {
+		wl_event_source_timer_update(hold.settle_timer,
+			SCALE_SETTLE_MS);
+	}
+}
+
+void
+scale_debounce_end(struct view *view)
+{
+	if (hold.view != view) {
+		return;
+	}
+	wl_event_source_timer_update(hold.settle_timer, 0);
+	flush();
+
+	struct held_surface *held, *tmp;
+	wl_list_for_each_safe(held, tmp, &hold.surfaces, link) {
+		struct wlr_scene_surface *scene_surface = held->scene_surface;
+		struct wlr_scene_buffer *buffer = scene_surface->buffer;
+		wl_signal_add(&buffer->events.outputs_update,
+			&scene_surface->outputs_update);
+		wl_signal_add(&buffer->events.output_enter,
+			&scene_surface->output_enter);
+		wl_signal_add(&buffer->events.output_leave,
+			&scene_surface->output_leave);
+		held_surface_destroy(held);
+	}
+	hold.view = NULL;
+}
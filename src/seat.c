@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include <assert.h>
 #include <stdbool.h>
+#include <string.h>
 #include <strings.h>
 #include <wlr/backend/libinput.h>
 #include <wlr/types/wlr_input_device.h>
@@ -45,6 +46,7 @@ input_device_destroy(struct wl_listener *listener, void *data)
 				&input->seat->keyboard_group->keyboard);
 		}
 	}
+	free(input->libinput);
 	free(input);
 }
 
@@ -78,7 +80,8 @@ device_type_from_wlr_device(struct wlr_input_device *wlr_input_device)
  * those two criteria we fallback on 'default'.
  */
 static struct libinput_category *
-get_category(struct wlr_input_device *device)
+get_category(struct wlr_input_device *device,
+		enum lab_libinput_device_type type)
 {
 	/* By name */
 	struct libinput_category *category;
@@ -91,7 +94,6 @@ get_category(struct wlr_input_device *device)
 	}
 
 	/* By type */
-	enum lab_libinput_device_type type = device_type_from_wlr_device(device);
 	wl_list_for_each_reverse(category, &rc.libinput_categories, link) {
 		if (category->type == type) {
 			return category;
@@ -102,9 +104,46 @@ get_category(struct wlr_input_device *device)
 	return libinput_category_get_default();
 }
 
+/* The libinput configuration last applied to a device */
+struct libinput_state {
+	/* Resolved once, as it involves querying the device */
+	enum lab_libinput_device_type type;
+	bool applied;
+	struct libinput_category config;
+};
+
+static bool
+libinput_config_equal(struct libinput_category *a,
+		struct libinput_category *b)
+{
+	if (a->have_calibration_matrix != b->have_calibration_matrix
+			|| (a->have_calibration_matrix && memcmp(
+				a->calibration_matrix, b->calibration_matrix,
+				sizeof(a->calibration_matrix)))) {
+		return false;
+	}
+	return a->pointer_speed == b->pointer_speed
+		&& a->natural_scroll == b->natural_scroll
+		&& a->left_handed == b->left_handed
+		&& a->tap == b->tap
+		&& a->tap_button_map == b->tap_button_map
+		&& a->tap_and_drag == b->tap_and_drag
+		&& a->drag_lock == b->drag_lock
+		&& a->accel_profile == b->accel_profile
+		&& a->middle_emu == b->middle_emu
+		&& a->dwt == b->dwt
+		&& a->click_method == b->click_method
+		&& a->send_events_mode == b->send_events_mode;
+}
+
+/*
+ * Only settings which differ from those applied before are set again, as
+ * setting some of them resets state of the device, like its acceleration.
+ */
 static void
-configure_libinput(struct wlr_input_device *wlr_input_device)
+configure_libinput(struct input *input)
 {
+	struct wlr_input_device *wlr_input_device = input->wlr_input_device;
 	/*
 	 * TODO: We do not check any return values for the various
 	 *       libinput_device_config_*_set_*() calls. It would
@@ -138,7 +177,14 @@ configure_libinput(struct wlr_input_device *wlr_input_device)
 		return;
 	}
 
-	struct libinput_category *dc = get_category(wlr_input_device);
+	struct libinput_state *state = input->libinput;
+	if (!state) {
+		state = znew(*state);
+		state->type = device_type_from_wlr_device(wlr_input_device);
+		input->libinput = state;
+	}
+	struct libinput_category *dc =
+		get_category(wlr_input_device, state->type);
 
 	/*
 	 * The above logic should have always matched SOME category
@@ -146,13 +192,27 @@ configure_libinput(struct wlr_input_device *wlr_input_device)
 	 */
 	assert(dc);
 
+	if (state->applied && libinput_config_equal(dc, &state->config)) {
+		wlr_log(WLR_DEBUG, "libinput config of %s unchanged",
+			wlr_input_device->name);
+		return;
+	}
+	/* NULL if nothing has been applied yet */
+	struct libinput_category *old = state->applied ? &state->config : NULL;
+#define CHANGED(field) (!old || old->field != dc->field)
+
 	if (libinput_device_config_tap_get_finger_count(libinput_dev) <= 0) {
 		wlr_log(WLR_INFO, "tap unavailable");
 	} else {
 		wlr_log(WLR_INFO, "tap configured");
-		libinput_device_config_tap_set_enabled(libinput_dev, dc->tap);
-		libinput_device_config_tap_set_button_map(libinput_dev,
-			dc->tap_button_map);
+		if (CHANGED(tap)) {
+			libinput_device_config_tap_set_enabled(libinput_dev,
+				dc->tap);
+		}
+		if (CHANGED(tap_button_map)) {
+			libinput_device_config_tap_set_button_map(libinput_dev,
+				dc->tap_button_map);
+		}
 	}
 
 	if (libinput_device_config_tap_get_finger_count(libinput_dev) <= 0
@@ -160,8 +220,10 @@ configure_libinput(struct wlr_input_device *wlr_input_device)
 		wlr_log(WLR_INFO, "tap-and-drag not configured");
 	} else {
 		wlr_log(WLR_INFO, "tap-and-drag configured");
-		libinput_device_config_tap_set_drag_enabled(
-			libinput_dev, dc->tap_and_drag);
+		if (CHANGED(tap_and_drag)) {
+			libinput_device_config_tap_set_drag_enabled(
+				libinput_dev, dc->tap_and_drag);
+		}
 	}
 
 	if (libinput_device_config_tap_get_finger_count(libinput_dev) <= 0
@@ -169,8 +231,10 @@ configure_libinput(struct wlr_input_device *wlr_input_device)
 		wlr_log(WLR_INFO, "drag lock not configured");
 	} else {
 		wlr_log(WLR_INFO, "drag lock configured");
-		libinput_device_config_tap_set_drag_lock_enabled(
-			libinput_dev, dc->drag_lock);
+		if (CHANGED(drag_lock)) {
+			libinput_device_config_tap_set_drag_lock_enabled(
+				libinput_dev, dc->drag_lock);
+		}
 	}
 
 	if (libinput_device_config_scroll_has_natural_scroll(libinput_dev) <= 0
@@ -178,8 +242,10 @@ configure_libinput(struct wlr_input_device *wlr_input_device)
 		wlr_log(WLR_INFO, "natural scroll not configured");
 	} else {
 		wlr_log(WLR_INFO, "natural scroll configured");
-		libinput_device_config_scroll_set_natural_scroll_enabled(
-			libinput_dev, dc->natural_scroll);
+		if (CHANGED(natural_scroll)) {
+			libinput_device_config_scroll_set_natural_scroll_enabled(
+				libinput_dev, dc->natural_scroll);
+		}
 	}
 
 	if (libinput_device_config_left_handed_is_available(libinput_dev) <= 0
@@ -187,31 +253,35 @@ configure_libinput(struct wlr_input_device *wlr_input_device)
 		wlr_log(WLR_INFO, "left-handed mode not configured");
 	} else {
 		wlr_log(WLR_INFO, "left-handed mode configured");
-		libinput_device_config_left_handed_set(libinput_dev,
-			dc->left_handed);
+		if (CHANGED(left_handed)) {
+			libinput_device_config_left_handed_set(libinput_dev,
+				dc->left_handed);
+		}
 	}
 
 	if (libinput_device_config_accel_is_available(libinput_dev) == 0) {
 		wlr_log(WLR_INFO, "pointer acceleration unavailable");
 	} else {
 		wlr_log(WLR_INFO, "pointer acceleration configured");
-		if (dc->pointer_speed > -1) {
+		if (dc->pointer_speed > -1 && CHANGED(pointer_speed)) {
 			libinput_device_config_accel_set_speed(libinput_dev,
 				dc->pointer_speed);
 		}
-		if (dc->accel_profile > 0) {
+		if (dc->accel_profile > 0 && CHANGED(accel_profile)) {
 			libinput_device_config_accel_set_profile(libinput_dev,
 				dc->accel_profile);
 		}
 	}
 
 	if (libinput_device_config_middle_emulation_is_available(libinput_dev)
-			== 0 || dc->middle_emu < 0)  {
+			== 0 || dc->middle_emu < 0) {
 		wlr_log(WLR_INFO, "middle emulation not configured");
 	} else {
 		wlr_log(WLR_INFO, "middle emulation configured");
-		libinput_device_config_middle_emulation_set_enabled(
-			libinput_dev, dc->middle_emu);
+		if (CHANGED(middle_emu)) {
+			libinput_device_config_middle_emulation_set_enabled(
+				libinput_dev, dc->middle_emu);
+		}
 	}
 
 	if (libinput_device_config_dwt_is_available(libinput_dev) == 0
@@ -219,7 +289,9 @@ configure_libinput(struct wlr_input_device *wlr_input_device)
 		wlr_log(WLR_INFO, "dwt not configured");
 	} else {
 		wlr_log(WLR_INFO, "dwt configured");
-		libinput_device_config_dwt_set_enabled(libinput_dev, dc->dwt);
+		if (CHANGED(dwt)) {
+			libinput_device_config_dwt_set_enabled(libinput_dev, dc->dwt);
+		}
 	}
 
 	if ((dc->click_method != LIBINPUT_CONFIG_CLICK_METHOD_NONE
@@ -239,7 +311,9 @@ configure_libinput(struct wlr_input_device *wlr_input_device)
 		 * issues.
 		 */
 
-		libinput_device_config_click_set_method(libinput_dev, dc->click_method);
+		if (CHANGED(click_method)) {
+			libinput_device_config_click_set_method(libinput_dev, dc->click_method);
+		}
 	}
 
 	if ((dc->send_events_mode != LIBINPUT_CONFIG_SEND_EVENTS_ENABLED
@@ -249,7 +323,9 @@ configure_libinput(struct wlr_input_device *wlr_input_device)
 		wlr_log(WLR_INFO, "send events mode not configured");
 	} else {
 		wlr_log(WLR_INFO, "send events mode configured");
-		libinput_device_config_send_events_set_mode(libinput_dev, dc->send_events_mode);
+		if (CHANGED(send_events_mode)) {
+			libinput_device_config_send_events_set_mode(libinput_dev, dc->send_events_mode);
+		}
 	}
 
 	/* Non-zero if the device can be calibrated, zero otherwise. */
@@ -258,8 +334,21 @@ configure_libinput(struct wlr_input_device *wlr_input_device)
 		wlr_log(WLR_INFO, "calibration matrix not configured");
 	} else {
 		wlr_log(WLR_INFO, "calibration matrix configured");
-		libinput_device_config_calibration_set_matrix(libinput_dev, dc->calibration_matrix);
+		if (!old || !old->have_calibration_matrix
+				|| memcmp(old->calibration_matrix,
+					dc->calibration_matrix,
+					sizeof(dc->calibration_matrix))) {
+			libinput_device_config_calibration_set_matrix(
+				libinput_dev, dc->calibration_matrix);
+		}
 	}
+#undef CHANGED
+
+	state->config = *dc;
+	/* Owned by rc, which is freed on reconfigure */
+	state->config.name = NULL;
+	state->config.link = (struct wl_list){0};
+	state->applied = true;
 }
 
 static struct wlr_output *
@@ -299,7 +388,7 @@ new_pointer(struct seat *seat, struct wlr_input_device *dev)
 {
 	struct input *input = znew(*input);
 	input->wlr_input_device = dev;
-	configure_libinput(dev);
+	configure_libinput(input);
 	wlr_cursor_attach_input_device(seat->cursor, dev);
 
 	/* In support of running with WLR_WL_OUTPUTS set to >=2 */
@@ -367,7 +456,7 @@ new_touch(struct seat *seat, struct wlr_input_device *dev)
 {
 	struct input *input = znew(*input);
 	input->wlr_input_device = dev;
-	configure_libinput(dev);
+	configure_libinput(input);
 	wlr_cursor_attach_input_device(seat->cursor, dev);
 	/* In support of running with WLR_WL_OUTPUTS set to >=2 */
 	map_touch_to_output(seat, dev);
@@ -608,11 +697,11 @@ seat_reconfigure(struct server *server)
 			configure_keyboard(seat, input);
 			break;
 		case WLR_INPUT_DEVICE_POINTER:
-			configure_libinput(input->wlr_input_device);
+			configure_libinput(input);
 			map_pointer_to_output(seat, input->wlr_input_device);
 			break;
 		case WLR_INPUT_DEVICE_TOUCH:
-			configure_libinput(input->wlr_input_device);
+			configure_libinput(input);
 			map_touch_to_output(seat, input->wlr_input_device);
 			break;
 		case WLR_INPUT_DEVICE_TABLET_TOOL:
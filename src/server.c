@@ -1,16 +1,22 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #define _POSIX_C_SOURCE 200809L
 #include "config.h"
+#include <errno.h>
+#include <poll.h>
 #include <signal.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/wait.h>
 #include <wlr/backend/headless.h>
 #include <wlr/backend/multi.h>
+#include <wlr/types/wlr_content_type_v1.h>
 #include <wlr/types/wlr_data_control_v1.h>
+#include <wlr/types/wlr_drm.h>
 #include <wlr/types/wlr_export_dmabuf_v1.h>
 #include <wlr/types/wlr_fractional_scale_v1.h>
 #include <wlr/types/wlr_gamma_control_v1.h>
 #include <wlr/types/wlr_input_inhibitor.h>
+#include <wlr/types/wlr_linux_dmabuf_v1.h>
 #include <wlr/types/wlr_presentation_time.h>
 #include <wlr/types/wlr_primary_selection_v1.h>
 #include <wlr/types/wlr_screencopy_v1.h>
@@ -21,49 +27,152 @@
 #include "xwayland-shell-v1-protocol.h"
 #endif
 #include "drm-lease-v1-protocol.h"
+#include "client-stats.h"
+#include "common/mem.h"
+#include "common/phase-timer.h"
+#include "common/spawn.h"
 #include "config/rcxml.h"
 #include "config/session.h"
+#include "configure-stats.h"
 #include "decorations.h"
+#include "edges.h"
+#include "flight-recorder.h"
+#include "heap-trim.h"
 #include "idle.h"
+#include "idle-refresh.h"
+#include "input/latency.h"
 #include "labwc.h"
 #include "layers.h"
+#include "memory-pressure.h"
 #include "menu/menu.h"
+#include "node.h"
 #include "output-virtual.h"
+#include "osd.h"
+#include "perf-hud.h"
+#include "placement.h"
 #include "regions.h"
+#include "surface-map.h"
 #include "resize_indicator.h"
+#include "ssd.h"
+#include "stats-socket.h"
 #include "theme.h"
+#include "transaction.h"
 #include "view.h"
+#include "watchdog.h"
 #include "workspaces.h"
 #include "xwayland.h"
 
 #define LAB_WLR_COMPOSITOR_VERSION 5
 #define LAB_WLR_FRACTIONAL_SCALE_V1_VERSION 1
+#define LAB_WLR_LINUX_DMABUF_VERSION 4
+
+#define SIGCHLD_RETRY_MSEC 100
 
 static struct wlr_compositor *compositor;
 static struct wl_event_source *sighup_source;
 static struct wl_event_source *sigint_source;
 static struct wl_event_source *sigterm_source;
 static struct wl_event_source *sigchld_source;
+/* Reaps the children left behind a waitable Xwayland, see handle_sigchld() */
+static struct wl_event_source *sigchld_retry;
+/* Set by server_terminate() */
+static bool terminating;
+
+static bool
+env_changed(const char *name, const char *old_value)
+{
+	const char *value = getenv(name);
+	return !old_value != !value || (value && strcmp(old_value, value));
+}
 
+/*
+ * Only the subsystems set up from parts of the config or theme which
+ * actually changed are reconfigured, so that e.g. changing a keybind
+ * doesn't re-render the decorations of all windows.
+ */
 static void
 reload_config_and_theme(struct server *server)
 {
+	phase_timer_begin("reconfigure");
+
+	/* Keep what the current state was built from for comparison */
+	uint64_t old_sections[LAB_RC_SECTION_COUNT];
+	memcpy(old_sections, rc.section_hashes, sizeof(old_sections));
+	struct theme *old_theme = xmalloc(sizeof(*old_theme));
+	memcpy(old_theme, server->theme, sizeof(*old_theme));
+	char *old_cursor_theme = getenv("XCURSOR_THEME")
+		? xstrdup(getenv("XCURSOR_THEME")) : NULL;
+	char *old_cursor_size = getenv("XCURSOR_SIZE")
+		? xstrdup(getenv("XCURSOR_SIZE")) : NULL;
+
+	session_environment_init();
+	bool cursor_changed = env_changed("XCURSOR_THEME", old_cursor_theme)
+		|| env_changed("XCURSOR_SIZE", old_cursor_size);
+	free(old_cursor_theme);
+	free(old_cursor_size);
+	phase_timer_mark("environment");
+
 	rcxml_finish();
 	rcxml_read(rc.config_file);
+	phase_timer_mark("rc.xml");
+
 	theme_finish(server->theme);
 	theme_init(server->theme, server, rc.theme_name);
+	phase_timer_mark("theme");
 
-	struct view *view;
-	wl_list_for_each(view, &server->views, link) {
-		view_reload_ssd(view);
+	bool changed[LAB_RC_SECTION_COUNT];
+	for (size_t i = 0; i < LAB_RC_SECTION_COUNT; i++) {
+		changed[i] = old_sections[i] != rc.section_hashes[i];
+	}
+	/* The <theme> element also holds the fonts */
+	bool theme_changed = changed[LAB_RC_SECTION_THEME]
+		|| !theme_settings_equal(old_theme, server->theme);
+	free(old_theme);
+
+	if (theme_changed) {
+		struct view *view;
+		wl_list_for_each(view, &server->views, link) {
+			view_reload_ssd(view);
+		}
+		phase_timer_mark("decorations");
 	}
 
 	menu_reconfigure(server);
-	seat_reconfigure(server);
-	regions_reconfigure(server);
-	resize_indicator_reconfigure(server);
-	kde_server_decoration_update_default();
-	workspaces_reconfigure(server);
+	phase_timer_mark("menus");
+
+	if (theme_changed || cursor_changed
+			|| changed[LAB_RC_SECTION_KEYBOARD]
+			|| changed[LAB_RC_SECTION_MOUSE]
+			|| changed[LAB_RC_SECTION_LIBINPUT]
+			|| changed[LAB_RC_SECTION_TOUCH]
+			|| changed[LAB_RC_SECTION_TABLET]
+			|| changed[LAB_RC_SECTION_SNAPPING]) {
+		seat_reconfigure(server);
+		phase_timer_mark("seat");
+	}
+	if (changed[LAB_RC_SECTION_REGIONS] || changed[LAB_RC_SECTION_CORE]) {
+		regions_reconfigure(server);
+		phase_timer_mark("regions");
+	}
+	if (theme_changed) {
+		osd_reconfigure(server);
+	}
+	if (theme_changed || changed[LAB_RC_SECTION_RESIZE]) {
+		resize_indicator_reconfigure(server);
+		phase_timer_mark("resize indicators");
+	}
+	if (changed[LAB_RC_SECTION_CORE]) {
+		kde_server_decoration_update_default();
+		idle_refresh_reconfigure(server);
+	}
+	if (theme_changed || changed[LAB_RC_SECTION_DESKTOPS]) {
+		workspaces_reconfigure(server);
+		phase_timer_mark("workspaces");
+	}
+
+	/* The old config and theme have been freed */
+	heap_trim_schedule(server);
+	phase_timer_end();
 }
 
 static int
@@ -71,7 +180,6 @@ handle_sighup(int signal, void *data)
 {
 	struct server *server = data;
 
-	session_environment_init();
 	reload_config_and_theme(server);
 	output_virtual_update_fallback(server);
 	return 0;
@@ -80,43 +188,31 @@ handle_sighup(int signal, void *data)
 static int
 handle_sigterm(int signal, void *data)
 {
-	struct wl_display *display = data;
+	struct server *server = data;
 
-	wl_display_terminate(display);
+	server_terminate(server);
 	return 0;
 }
 
+#if HAVE_XWAYLAND
+static int handle_sigchld(int signal, void *data);
+
 static int
-handle_sigchld(int signal, void *data)
+handle_sigchld_retry(void *data)
 {
-	siginfo_t info;
-	info.si_pid = 0;
-	struct server *server = data;
-
-	/* First call waitid() with NOWAIT which doesn't consume the zombie */
-	if (waitid(P_ALL, /*id*/ 0, &info, WEXITED | WNOHANG | WNOWAIT) == -1) {
-		return 0;
-	}
-
-	if (info.si_pid == 0) {
-		/* No children in waitable state */
-		return 0;
-	}
-
-#if HAVE_XWAYLAND
-	/* Ensure that we do not break xwayland lazy initialization */
-	if (server->xwayland && server->xwayland->server
-			&& info.si_pid == server->xwayland->server->pid) {
-		return 0;
-	}
+	return handle_sigchld(SIGCHLD, data);
+}
 #endif
 
-	/* And then do the actual (consuming) lookup again */
-	int ret = waitid(P_PID, info.si_pid, &info, WEXITED);
+static void
+reap_child(struct server *server, pid_t pid)
+{
+	siginfo_t info;
+	int ret = waitid(P_PID, pid, &info, WEXITED);
 	if (ret == -1) {
 		wlr_log(WLR_ERROR, "blocking waitid() for %ld failed: %d",
-			(long)info.si_pid, ret);
-		return 0;
+			(long)pid, ret);
+		return;
 	}
 
 	switch (info.si_code) {
@@ -142,10 +238,55 @@ handle_sigchld(int signal, void *data)
 
 	if (info.si_pid == server->primary_client_pid) {
 		wlr_log(WLR_INFO, "primary client %ld exited", (long)info.si_pid);
-		wl_display_terminate(server->wl_display);
+		server_terminate(server);
 	}
+}
 
-	return 0;
+/*
+ * SIGCHLD is coalesced, so reap every waitable child. Spawned commands and
+ * pipemenus are direct children, several of which may exit together.
+ */
+static int
+handle_sigchld(int signal, void *data)
+{
+	struct server *server = data;
+
+	while (true) {
+		siginfo_t info;
+		info.si_pid = 0;
+
+		/* First call waitid() with NOWAIT which doesn't consume the zombie */
+		if (waitid(P_ALL, /*id*/ 0, &info,
+				WEXITED | WNOHANG | WNOWAIT) == -1) {
+			return 0;
+		}
+		if (info.si_pid == 0) {
+			/* No children in waitable state */
+			return 0;
+		}
+
+#if HAVE_XWAYLAND
+		/*
+		 * Ensure that we do not break xwayland lazy initialization.
+		 * Xwayland is reaped by wlroots, but hides any other waitable
+		 * children from waitid(P_ALL) until then, so look again later.
+		 */
+		if (server->xwayland && server->xwayland->server
+				&& info.si_pid == server->xwayland->server->pid) {
+			if (!sigchld_retry) {
+				sigchld_retry = wl_event_loop_add_timer(
+					server->wl_event_loop,
+					handle_sigchld_retry, server);
+			}
+			wl_event_source_timer_update(sigchld_retry,
+				SIGCHLD_RETRY_MSEC);
+			return 0;
+		}
+#endif
+
+		/* And then do the actual (consuming) lookup again */
+		reap_child(server, info.si_pid);
+	}
 }
 
 static void
@@ -311,12 +452,13 @@ server_init(struct server *server)
 	sighup_source = wl_event_loop_add_signal(
 		event_loop, SIGHUP, handle_sighup, server);
 	sigint_source = wl_event_loop_add_signal(
-		event_loop, SIGINT, handle_sigterm, server->wl_display);
+		event_loop, SIGINT, handle_sigterm, server);
 	sigterm_source = wl_event_loop_add_signal(
-		event_loop, SIGTERM, handle_sigterm, server->wl_display);
+		event_loop, SIGTERM, handle_sigterm, server);
 	sigchld_source = wl_event_loop_add_signal(
 		event_loop, SIGCHLD, handle_sigchld, server);
 	server->wl_event_loop = event_loop;
+	spawn_helper_attach(event_loop);
 
 	/*
 	 * Prevent wayland clients that request the X11 clipboard but closing
@@ -379,7 +521,22 @@ server_init(struct server *server)
 		exit(EXIT_FAILURE);
 	}
 
-	wlr_renderer_init_wl_display(server->renderer, server->wl_display);
+	/*
+	 * Instead of wlr_renderer_init_wl_display() so that we keep the
+	 * linux-dmabuf global for per-surface feedback, see below.
+	 */
+	if (!wlr_renderer_init_wl_shm(server->renderer, server->wl_display)) {
+		wlr_log(WLR_ERROR, "unable to initialize wl_shm");
+		exit(EXIT_FAILURE);
+	}
+	if (wlr_renderer_get_dmabuf_texture_formats(server->renderer)) {
+		if (wlr_renderer_get_drm_fd(server->renderer) >= 0) {
+			wlr_drm_create(server->wl_display, server->renderer);
+		}
+		server->linux_dmabuf = wlr_linux_dmabuf_v1_create_with_renderer(
+			server->wl_display, LAB_WLR_LINUX_DMABUF_VERSION,
+			server->renderer);
+	}
 
 	/*
 	 * Autocreates an allocator for us. The allocator is the bridge between
@@ -392,11 +549,17 @@ server_init(struct server *server)
 		wlr_log(WLR_ERROR, "unable to create allocator");
 		exit(EXIT_FAILURE);
 	}
+	phase_timer_mark("backend and renderer");
 
 	wl_list_init(&server->views);
+	wl_list_init(&server->views_always_on_top);
+	wl_list_init(&server->views_focus_history);
 	wl_list_init(&server->unmanaged_surfaces);
+	wl_list_init(&server->unmanaged_focus_candidates);
 
 	server->ssd_hover_state = ssd_hover_state_new();
+	wl_list_init(&server->ssd_title_updates);
+	wl_list_init(&server->ssd_geometry_updates);
 
 	server->scene = wlr_scene_create();
 	if (!server->scene) {
@@ -404,6 +567,17 @@ server_init(struct server *server)
 		exit(EXIT_FAILURE);
 	}
 
+	/*
+	 * Let the scene send per-surface dmabuf feedback. Surfaces which
+	 * could be scanned out directly - typically fullscreen views on a
+	 * DRM output - get a tranche with the formats and modifiers of the
+	 * output's primary plane, so that clients can allocate buffers
+	 * which avoid composition.
+	 */
+	if (server->linux_dmabuf) {
+		wlr_scene_set_linux_dmabuf_v1(server->scene, server->linux_dmabuf);
+	}
+
 	/*
 	 * The order in which the scene-trees below are created determines the
 	 * z-order for nodes which cover the whole work-area.  For per-output
@@ -452,6 +626,7 @@ server_init(struct server *server)
 		exit(EXIT_FAILURE);
 	}
 	wlr_subcompositor_create(server->wl_display);
+	client_stats_init(compositor);
 
 	struct wlr_data_device_manager *device_manager = NULL;
 	device_manager = wlr_data_device_manager_create(server->wl_display);
@@ -490,6 +665,13 @@ server_init(struct server *server)
 	wlr_scene_set_presentation(server->scene, presentation);
 
 	wlr_export_dmabuf_manager_v1_create(server->wl_display);
+	/*
+	 * Screencopy clients should use copy_with_damage: the frame is then
+	 * only completed once the output has new damage and carries the
+	 * damaged regions, which wlr_scene_output_build_state() provides for
+	 * every frame we commit. The ext-image-copy-capture protocols with
+	 * per-toplevel capture sources need wlroots 0.19.
+	 */
 	wlr_screencopy_manager_v1_create(server->wl_display);
 	wlr_data_control_manager_v1_create(server->wl_display);
 	wlr_viewporter_create(server->wl_display);
@@ -498,6 +680,7 @@ server_init(struct server *server)
 		LAB_WLR_FRACTIONAL_SCALE_V1_VERSION);
 
 	idle_manager_create(server->wl_display, server->seat.seat);
+	idle_refresh_init(server);
 
 	server->relative_pointer_manager = wlr_relative_pointer_manager_v1_create(
 		server->wl_display);
@@ -550,10 +733,15 @@ server_init(struct server *server)
 	server->tearing_new_object.notify = new_tearing_hint;
 	wl_signal_add(&server->tearing_control->events.new_object, &server->tearing_new_object);
 
+	server->content_type_manager =
+		wlr_content_type_manager_v1_create(server->wl_display, 1);
+
 	layers_init(server);
+	phase_timer_mark("protocols");
 
 #if HAVE_XWAYLAND
 	xwayland_server_init(server, compositor);
+	phase_timer_mark("xwayland");
 #endif
 }
 
@@ -578,6 +766,11 @@ server_start(struct server *server)
 
 	/* Potentially set up the initial fallback output */
 	output_virtual_update_fallback(server);
+	phase_timer_mark("backend start");
+
+	stats_socket_init(server);
+	memory_pressure_init(server);
+	flight_recorder_init(server);
 
 	if (setenv("WAYLAND_DISPLAY", socket, true) < 0) {
 		wlr_log_errno(WLR_ERROR, "unable to set WAYLAND_DISPLAY");
@@ -586,6 +779,44 @@ server_start(struct server *server)
 	}
 }
 
+/*
+ * Like wl_display_run(), but waiting for events is separated from
+ * dispatching them so that the watchdog can time the latter
+ */
+void
+server_run(struct server *server)
+{
+	struct wl_event_loop *loop = server->wl_event_loop;
+	struct pollfd pfd = {
+		.fd = wl_event_loop_get_fd(loop),
+		.events = POLLIN,
+	};
+
+	watchdog_init();
+	/* Dispatches end with the idle sources, except for those from startup */
+	wl_event_loop_dispatch_idle(loop);
+	while (!terminating) {
+		wl_display_flush_clients(server->wl_display);
+		if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+			wlr_log_errno(WLR_ERROR, "poll failed");
+			break;
+		}
+
+		watchdog_dispatch_begin();
+		wl_event_loop_dispatch(loop, 0);
+		watchdog_dispatch_end();
+	}
+	watchdog_finish();
+}
+
+void
+server_terminate(struct server *server)
+{
+	terminating = true;
+	/* Wakes up server_run() */
+	wl_display_terminate(server->wl_display);
+}
+
 void
 server_finish(struct server *server)
 {
@@ -595,13 +826,39 @@ server_finish(struct server *server)
 	if (sighup_source) {
 		wl_event_source_remove(sighup_source);
 	}
+	if (sigchld_retry) {
+		wl_event_source_remove(sigchld_retry);
+		sigchld_retry = NULL;
+	}
 	wl_display_destroy_clients(server->wl_display);
 
 	seat_finish(server);
 	wlr_output_layout_destroy(server->output_layout);
 
+	defer_cancel(&server->occlusion_update);
+	defer_cancel(&server->top_layer_update);
+	transaction_finish(server);
+	edges_finish(server);
+	placement_finish(server);
+	placement_memory_finish();
+	surface_map_finish();
+	stats_socket_finish(server);
+	latency_finish();
+	configure_stats_finish();
+	client_stats_finish();
+	perf_hud_finish();
+	heap_trim_finish();
+	memory_pressure_finish();
+	idle_refresh_finish();
+	flight_recorder_finish();
+	spawn_helper_detach();
+
 	wl_display_destroy(server->wl_display);
 
 	/* TODO: clean up various scene_tree nodes */
 	workspaces_destroy(server);
+
+	/* After the scene nodes which give their objects back */
+	ssd_finish();
+	node_descriptors_finish();
 }
@@ -118,6 +118,7 @@ found_lock_output:
 static void
 session_lock_output_destroy(struct session_lock_output *output)
 {
+	output->output->session_lock_pending = false;
 	if (output->surface) {
 		refocus_output(output);
 		wl_list_remove(&output->surface_destroy.link);
@@ -146,6 +147,9 @@ handle_commit(struct wl_listener *listener, void *data)
 	if (event->state->committed & require_reconfigure) {
 		lock_output_reconfigure(output);
 	}
+	if (event->state->committed & WLR_OUTPUT_STATE_BUFFER) {
+		output->output->session_lock_pending = false;
+	}
 }
 
 static void
@@ -201,6 +205,13 @@ session_lock_output_create(struct session_lock *lock, struct output *output)
 
 	lock_output_reconfigure(lock_output);
 
+	/*
+	 * Show the blanked output in the next refresh rather than waiting
+	 * for the lock client, which may take a while to draw its surface.
+	 */
+	output->session_lock_pending = true;
+	wlr_output_schedule_frame(output->wlr_output);
+
 	wl_list_insert(&lock->session_lock_outputs, &lock_output->link);
 	return;
 
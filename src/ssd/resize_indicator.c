@@ -1,5 +1,6 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include <assert.h>
+#include <string.h>
 #include <wlr/types/wlr_scene.h>
 #include <wlr/util/box.h>
 #include <wlr/util/log.h>
@@ -30,6 +31,9 @@ resize_indicator_reconfigure_view(struct resize_indicator *indicator)
 	/* Colors */
 	wlr_scene_rect_set_color(indicator->border, theme->osd_border_color);
 	wlr_scene_rect_set_color(indicator->background, theme->osd_bg_color);
+
+	/* Font or colors may have changed */
+	indicator->label[0] = '\0';
 }
 
 static void
@@ -157,7 +161,8 @@ resize_indicator_update(struct view *view)
 		resize_indicator_show(view);
 	}
 
-	char text[32]; /* 12345 x 12345 would be 13 chars + 1 null byte */
+	/* 12345 x 12345 would be 13 chars + 1 null byte */
+	char text[sizeof(indicator->label)];
 
 	int eff_height = view_effective_height(view, /* use_pending */ false);
 	int eff_width = view->current.width;
@@ -174,7 +179,7 @@ resize_indicator_update(struct view *view)
 		break;
 	case LAB_INPUT_STATE_MOVE:
 		; /* works around "a label can only be part of a statement" */
-		struct border margin = ssd_get_margin(view->ssd);
+		struct border margin = ssd_get_margin(view);
 		snprintf(text, sizeof(text), "%d , %d",
 			view->current.x - margin.left,
 			view->current.y - margin.top);
@@ -185,22 +190,29 @@ resize_indicator_update(struct view *view)
 		return;
 	}
 
-	/* Let the indicator change width as required by the content */
-	int width = font_width(&rc.font_osd, text);
+	/*
+	 * Most motion events don't change the label, e.g. when resizing
+	 * terminals by character cells, so avoid the Pango layouts below.
+	 */
+	if (strcmp(text, indicator->label)) {
+		/* Let the indicator change width as required by the content */
+		int width = font_width(&rc.font_osd, text);
+
+		/* font_extents() adds 4 pixels to the calculated width */
+		width -= 4;
 
-	/* font_extents() adds 4 pixels to the calculated width */
-	width -= 4;
+		resize_indicator_set_size(indicator, width);
 
-	resize_indicator_set_size(indicator, width);
+		scaled_font_buffer_update(indicator->text, text, width,
+			&rc.font_osd, rc.theme->osd_label_text_color,
+			rc.theme->osd_bg_color, NULL /* const char *arrow */);
+		snprintf(indicator->label, sizeof(indicator->label), "%s", text);
+	}
 
 	/* Center the indicator in the window */
 	wlr_scene_node_set_position(&indicator->tree->node,
 		(eff_width - indicator->width) / 2,
 		(eff_height - indicator->height) / 2);
-
-	scaled_font_buffer_update(indicator->text, text, width, &rc.font_osd,
-		rc.theme->osd_label_text_color, rc.theme->osd_bg_color,
-		NULL /* const char *arrow */);
 }
 
 void
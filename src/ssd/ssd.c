@@ -7,8 +7,11 @@
  */
 
 #include <assert.h>
+#include <wlr/types/wlr_output_layout.h>
 #include "common/mem.h"
+#include "common/scaled_scene_buffer.h"
 #include "common/scene-helpers.h"
+#include "common/trace.h"
 #include "labwc.h"
 #include "ssd-internal.h"
 #include "theme.h"
@@ -185,6 +188,9 @@ ssd_create(struct view *view, bool active)
 	ssd->tree = wlr_scene_tree_create(view->scene_tree);
 	wlr_scene_node_lower_to_bottom(&ssd->tree->node);
 	ssd->titlebar.height = view->server->theme->title_height;
+	ssd->state.active = active;
+	wl_list_init(&ssd->title_update_link);
+	wl_list_init(&ssd->geometry_update_link);
 	ssd_shadow_create(ssd);
 	ssd_extents_create(ssd);
 	ssd_border_create(ssd);
@@ -201,10 +207,15 @@ ssd_create(struct view *view, bool active)
 	return ssd;
 }
 
+/*
+ * The decoration of views on hidden workspaces is only created once the
+ * workspace is shown, so fall back to the theme-based thickness.
+ */
 struct border
-ssd_get_margin(const struct ssd *ssd)
+ssd_get_margin(struct view *view)
 {
-	return ssd ? ssd->margin : (struct border){ 0 };
+	assert(view);
+	return view->ssd ? view->ssd->margin : ssd_thickness(view);
 }
 
 void
@@ -216,13 +227,9 @@ ssd_update_margin(struct ssd *ssd)
 	ssd->margin = ssd_thickness(ssd->view);
 }
 
-void
-ssd_update_geometry(struct ssd *ssd)
+static void
+update_geometry(struct ssd *ssd)
 {
-	if (!ssd) {
-		return;
-	}
-
 	struct wlr_box cached = ssd->state.geometry;
 	struct wlr_box current = ssd->view->current;
 
@@ -266,6 +273,43 @@ ssd_update_geometry(struct ssd *ssd)
 	ssd->state.geometry = current;
 }
 
+/*
+ * A view may be committed, moved and (un)maximized several times before the
+ * next frame. Only resize the decoration once, from the frame handler of any
+ * output, right before the scene is rendered.
+ */
+void
+ssd_update_geometry(struct ssd *ssd)
+{
+	TRACE_FUNC();
+	if (!ssd || ssd->geometry_update_pending) {
+		return;
+	}
+	struct view *view = ssd->view;
+	if (!view->output || !output_is_usable(view->output)) {
+		/* No frame to wait for */
+		update_geometry(ssd);
+		return;
+	}
+	ssd->geometry_update_pending = true;
+	wl_list_insert(&view->server->ssd_geometry_updates,
+		&ssd->geometry_update_link);
+	wlr_output_schedule_frame(view->output->wlr_output);
+}
+
+void
+ssd_flush_geometry_updates(struct server *server)
+{
+	struct ssd *ssd, *tmp;
+	wl_list_for_each_safe(ssd, tmp, &server->ssd_geometry_updates,
+			geometry_update_link) {
+		wl_list_remove(&ssd->geometry_update_link);
+		wl_list_init(&ssd->geometry_update_link);
+		ssd->geometry_update_pending = false;
+		update_geometry(ssd);
+	}
+}
+
 void
 ssd_titlebar_hide(struct ssd *ssd)
 {
@@ -280,6 +324,59 @@ ssd_titlebar_hide(struct ssd *ssd)
 	ssd->margin = ssd_thickness(ssd->view);
 }
 
+/* How close a moving view has to get to an output to prepare its scale */
+#define SSD_PRERENDER_DISTANCE 100
+
+static void
+handle_prerender_idle(void *data)
+{
+	struct ssd *ssd = data;
+	ssd->prerender_idle = NULL;
+	scaled_scene_buffer_prerender_tree(ssd->tree, ssd->prerender_scale);
+}
+
+/*
+ * Titles and corners are rendered for a new scale from the output_enter
+ * signal, which stalls a view being dragged onto an output with a
+ * different scale. Called while moving a view, this renders them on an
+ * idle callback while the view is still approaching the output.
+ */
+void
+ssd_prerender_nearby_scales(struct ssd *ssd)
+{
+	if (!ssd || ssd->prerender_idle) {
+		return;
+	}
+	struct view *view = ssd->view;
+	struct server *server = view->server;
+	double current = view->output ? view->output->wlr_output->scale : 1;
+
+	struct wlr_box box = ssd_max_extents(view);
+	box.x -= SSD_PRERENDER_DISTANCE;
+	box.y -= SSD_PRERENDER_DISTANCE;
+	box.width += 2 * SSD_PRERENDER_DISTANCE;
+	box.height += 2 * SSD_PRERENDER_DISTANCE;
+
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		double scale = output->wlr_output->scale;
+		if (!output_is_usable(output) || scale == current
+				|| scale == ssd->prerender_scale) {
+			continue;
+		}
+		struct wlr_box output_box, intersection;
+		wlr_output_layout_get_box(server->output_layout,
+			output->wlr_output, &output_box);
+		if (!wlr_box_intersection(&intersection, &box, &output_box)) {
+			continue;
+		}
+		ssd->prerender_scale = scale;
+		ssd->prerender_idle = wl_event_loop_add_idle(
+			server->wl_event_loop, handle_prerender_idle, ssd);
+		return;
+	}
+}
+
 void
 ssd_destroy(struct ssd *ssd)
 {
@@ -296,6 +393,12 @@ ssd_destroy(struct ssd *ssd)
 		hover_state->button = NULL;
 	}
 
+	wl_list_remove(&ssd->title_update_link);
+	wl_list_remove(&ssd->geometry_update_link);
+	if (ssd->prerender_idle) {
+		wl_event_source_remove(ssd->prerender_idle);
+	}
+
 	/* Destroy subcomponents */
 	ssd_titlebar_destroy(ssd);
 	ssd_border_destroy(ssd);
@@ -350,6 +453,13 @@ ssd_set_active(struct ssd *ssd, bool active)
 	if (!ssd) {
 		return;
 	}
+	if (ssd->state.active != active) {
+		ssd->state.active = active;
+		struct ssd_state_title *title = &ssd->state.title;
+		if (active ? title->active.stale : title->inactive.stale) {
+			ssd_update_title(ssd);
+		}
+	}
 	wlr_scene_node_set_enabled(&ssd->border.active.tree->node, active);
 	wlr_scene_node_set_enabled(&ssd->titlebar.active.tree->node, active);
 	if (ssd->shadow.active.tree) {
@@ -418,6 +528,15 @@ ssd_debug_is_root_node(const struct ssd *ssd, struct wlr_scene_node *node)
 	return node == &ssd->tree->node;
 }
 
+bool
+ssd_debug_is_shadow_node(const struct ssd *ssd, struct wlr_scene_node *node)
+{
+	if (!ssd || !node || !ssd->shadow.tree) {
+		return false;
+	}
+	return node == &ssd->shadow.tree->node;
+}
+
 const char *
 ssd_debug_get_node_name(const struct ssd *ssd, struct wlr_scene_node *node)
 {
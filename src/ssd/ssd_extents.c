@@ -86,6 +86,49 @@ ssd_extents_create(struct ssd *ssd)
 	ssd_extents_update(ssd);
 }
 
+/*
+ * Union of the usable areas of all outputs a view is on. All views on the
+ * same outputs share it, which in particular avoids rebuilding it on each
+ * motion event while dragging a view.
+ */
+static struct {
+	bool valid;
+	uint64_t generation;
+	struct bitset outputs;
+	pixman_region32_t region;
+} usable_cache;
+
+static pixman_region32_t *
+get_usable_region(struct view *view)
+{
+	struct server *server = view->server;
+	if (usable_cache.valid
+			&& usable_cache.generation == server->usable_area_generation
+			&& bitset_equal(&usable_cache.outputs, &view->outputs)) {
+		return &usable_cache.region;
+	}
+	if (!usable_cache.valid) {
+		pixman_region32_init(&usable_cache.region);
+		usable_cache.valid = true;
+	}
+	usable_cache.generation = server->usable_area_generation;
+	bitset_copy(&usable_cache.outputs, &view->outputs);
+
+	pixman_region32_clear(&usable_cache.region);
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (!view_on_output(view, output)) {
+			continue;
+		}
+		struct wlr_box usable_area =
+			output_usable_area_in_layout_coords(output);
+		pixman_region32_union_rect(&usable_cache.region,
+			&usable_cache.region, usable_area.x, usable_area.y,
+			usable_area.width, usable_area.height);
+	}
+	return &usable_cache.region;
+}
+
 void
 ssd_extents_update(struct ssd *ssd)
 {
@@ -123,30 +166,28 @@ ssd_extents_update(struct ssd *ssd)
 		-(theme->border_width + extended_area),
 		-(ssd->titlebar.height + theme->border_width + extended_area));
 
-	/*
-	 * Convert all output usable areas that the
-	 * view is currently on into a pixman region
-	 */
 	int nrects;
-	pixman_region32_t usable;
 	pixman_region32_t intersection;
-	pixman_region32_init(&usable);
 	pixman_region32_init(&intersection);
-	struct output *output;
-	wl_list_for_each(output, &view->server->outputs, link) {
-		if (!view_on_output(view, output)) {
-			continue;
-		}
-		struct wlr_box usable_area =
-			output_usable_area_in_layout_coords(output);
-		pixman_region32_union_rect(&usable, &usable, usable_area.x,
-			usable_area.y, usable_area.width, usable_area.height);
-	}
+	pixman_region32_t *usable = get_usable_region(view);
 
 	/* Remember base layout coordinates */
 	int base_x, base_y;
 	wlr_scene_node_coords(&ssd->extents.tree->node, &base_x, &base_y);
 
+	/*
+	 * Usually the extents lie within the usable area of a single
+	 * output, so none of the parts needs to be constrained.
+	 */
+	pixman_box32_t extents_box = {
+		.x1 = base_x,
+		.y1 = base_y,
+		.x2 = base_x + full_width + extended_area * 2,
+		.y2 = base_y + full_height + extended_area * 2,
+	};
+	bool inside = pixman_region32_contains_rectangle(usable, &extents_box)
+		== PIXMAN_REGION_IN;
+
 	struct wlr_box *target;
 	wl_list_for_each(part, &ssd->extents.parts, link) {
 		rect = wlr_scene_rect_from_node(part->node);
@@ -186,9 +227,13 @@ ssd_extents_update(struct ssd *ssd)
 		part_box.width = target->width;
 		part_box.height = target->height;
 
+		if (inside) {
+			goto fully_visible;
+		}
+
 		/* Constrain part to output->usable_area */
 		pixman_region32_clear(&intersection);
-		pixman_region32_intersect_rect(&intersection, &usable,
+		pixman_region32_intersect_rect(&intersection, usable,
 			part_box.x, part_box.y, part_box.width, part_box.height);
 		const pixman_box32_t *inter_rects =
 			pixman_region32_rectangles(&intersection, &nrects);
@@ -235,7 +280,10 @@ ssd_extents_update(struct ssd *ssd)
 			continue;
 		}
 
-		/* Fully visible */
+fully_visible:
+		if (!part->node->enabled) {
+			wlr_scene_node_set_enabled(part->node, true);
+		}
 		if (target->x != part->node->x
 				|| target->y != part->node->y) {
 			wlr_scene_node_set_position(part->node, target->x, target->y);
@@ -245,7 +293,6 @@ ssd_extents_update(struct ssd *ssd)
 		}
 	}
 	pixman_region32_fini(&intersection);
-	pixman_region32_fini(&usable);
 }
 
 void
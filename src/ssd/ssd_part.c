@@ -1,11 +1,19 @@
 // SPDX-License-Identifier: GPL-2.0-only
 
 #include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "buffer.h"
 #include "common/list.h"
-#include "common/mem.h"
+#include "common/pool.h"
+#include "common/scaled_scene_buffer.h"
 #include "labwc.h"
 #include "node.h"
 #include "ssd-internal.h"
+#include "theme.h"
+
+static struct pool parts = POOL_INIT(struct ssd_part);
+static struct pool buttons = POOL_INIT(struct ssd_button);
 
 /* Internal helpers */
 static void
@@ -13,7 +21,7 @@ ssd_button_destroy_notify(struct wl_listener *listener, void *data)
 {
 	struct ssd_button *button = wl_container_of(listener, button, destroy);
 	wl_list_remove(&button->destroy.link);
-	free(button);
+	pool_free(&buttons, button);
 }
 
 /*
@@ -25,7 +33,7 @@ static struct ssd_button *
 ssd_button_descriptor_create(struct wlr_scene_node *node)
 {
 	/* Create new ssd_button */
-	struct ssd_button *button = znew(*button);
+	struct ssd_button *button = pool_alloc(&buttons);
 
 	/* Let it destroy automatically when the scene node destroys */
 	button->destroy.notify = ssd_button_destroy_notify;
@@ -36,11 +44,18 @@ ssd_button_descriptor_create(struct wlr_scene_node *node)
 	return button;
 }
 
+void
+ssd_finish(void)
+{
+	pool_finish(&parts);
+	pool_finish(&buttons);
+}
+
 /* Internal API */
 struct ssd_part *
 add_scene_part(struct wl_list *part_list, enum ssd_part_type type)
 {
-	struct ssd_part *part = znew(*part);
+	struct ssd_part *part = pool_alloc(&parts);
 	part->type = type;
 	wl_list_append(part_list, &part->link);
 	return part;
@@ -73,15 +88,27 @@ add_scene_buffer(struct wl_list *list, enum ssd_part_type type,
 	int x, int y)
 {
 	struct ssd_part *part = add_scene_part(list, type);
-	part->node = &wlr_scene_buffer_create(parent, buffer)->node;
+	part->node = &wlr_scene_buffer_create(parent,
+		buffer_get_shared(buffer))->node;
 	wlr_scene_node_set_position(part->node, x, y);
 	return part;
 }
 
+static struct lab_data_buffer *
+corner_create_buffer(struct scaled_scene_buffer *scaled_buffer, double scale)
+{
+	enum theme_corner corner = (uintptr_t)scaled_buffer->data;
+	return theme_get_corner(rc.theme, corner, scale);
+}
+
+static const struct scaled_scene_buffer_impl corner_impl = {
+	.create_buffer = corner_create_buffer,
+};
+
 struct ssd_part *
 add_scene_button_corner(struct wl_list *part_list, enum ssd_part_type type,
 		enum ssd_part_type corner_type, struct wlr_scene_tree *parent,
-		struct wlr_buffer *corner_buffer, struct wlr_buffer *icon_buffer,
+		enum theme_corner corner, struct wlr_buffer *icon_buffer,
 		struct wlr_buffer *hover_buffer, int x, struct view *view)
 {
 	int offset_x;
@@ -104,10 +131,19 @@ add_scene_button_corner(struct wl_list *part_list, enum ssd_part_type type,
 
 	/*
 	 * Background, x and y adjusted for border_width which is
-	 * already included in rendered theme.c / corner_buffer
+	 * already included in rendered theme.c / corner_buffer.
+	 * Rendered for the scale of the output(s) it is shown on.
 	 */
-	add_scene_buffer(part_list, corner_type, parent, corner_buffer,
-		-offset_x, -rc.theme->border_width);
+	struct ssd_part *corner_part = add_scene_part(part_list, corner_type);
+	struct scaled_scene_buffer *corner_buffer = scaled_scene_buffer_create(
+		parent, &corner_impl, /* drop_buffer */ false);
+	if (corner_buffer) {
+		corner_buffer->data = (void *)(uintptr_t)corner;
+		scaled_scene_buffer_invalidate_cache(corner_buffer);
+		corner_part->node = &corner_buffer->scene_buffer->node;
+		wlr_scene_node_set_position(corner_part->node,
+			-offset_x, -rc.theme->border_width);
+	}
 
 	/* Finally just put a usual theme button on top, using an invisible hitbox */
 	add_scene_button(part_list, type, parent, invisible, icon_buffer, hover_buffer, 0, view);
@@ -140,6 +176,49 @@ get_scale_box(struct wlr_buffer *buffer, double container_width,
 	return icon_geo;
 }
 
+static struct lab_data_buffer *
+button_create_buffer(struct scaled_scene_buffer *scaled_buffer, double scale)
+{
+	return theme_get_button(rc.theme, scaled_buffer->data, scale);
+}
+
+static const struct scaled_scene_buffer_impl button_impl = {
+	.create_buffer = button_create_buffer,
+};
+
+/* Centered in the button and rendered for the output scale if possible */
+static struct ssd_part *
+add_scene_icon(struct wl_list *part_list, enum ssd_part_type type,
+		struct wlr_scene_tree *parent, struct wlr_buffer *buffer)
+{
+	struct wlr_box geo = get_scale_box(buffer,
+		SSD_BUTTON_WIDTH, rc.theme->title_height);
+
+	struct lab_data_buffer *button =
+		wl_container_of(buffer, button, base);
+	if (theme_button_is_scalable(rc.theme, button)) {
+		struct scaled_scene_buffer *scaled_buffer =
+			scaled_scene_buffer_create(parent, &button_impl,
+				/* drop_buffer */ false);
+		if (scaled_buffer) {
+			struct ssd_part *part = add_scene_part(part_list, type);
+			scaled_buffer->data = button;
+			scaled_scene_buffer_invalidate_cache(scaled_buffer);
+			part->node = &scaled_buffer->scene_buffer->node;
+			wlr_scene_node_set_position(part->node, geo.x, geo.y);
+			return part;
+		}
+	}
+
+	struct ssd_part *part = add_scene_buffer(part_list, type, parent,
+		buffer, geo.x, geo.y);
+
+	/* Make sure big icons are scaled down if necessary */
+	wlr_scene_buffer_set_dest_size(wlr_scene_buffer_from_node(part->node),
+		geo.width, geo.height);
+	return part;
+}
+
 struct ssd_part *
 add_scene_button(struct wl_list *part_list, enum ssd_part_type type,
 		struct wlr_scene_tree *parent, float *bg_color,
@@ -157,28 +236,14 @@ add_scene_button(struct wl_list *part_list, enum ssd_part_type type,
 
 	/* Icon */
 	struct wlr_scene_tree *icon_tree = wlr_scene_tree_create(parent);
-	struct wlr_box icon_geo = get_scale_box(icon_buffer,
-		SSD_BUTTON_WIDTH, rc.theme->title_height);
-	struct ssd_part *icon_part = add_scene_buffer(part_list, type,
-		icon_tree, icon_buffer, icon_geo.x, icon_geo.y);
-
-	/* Make sure big icons are scaled down if necessary */
-	wlr_scene_buffer_set_dest_size(
-		wlr_scene_buffer_from_node(icon_part->node),
-		icon_geo.width, icon_geo.height);
+	struct ssd_part *icon_part = add_scene_icon(part_list, type,
+		icon_tree, icon_buffer);
 
 	/* Hover icon */
 	struct wlr_scene_tree *hover_tree = wlr_scene_tree_create(parent);
 	wlr_scene_node_set_enabled(&hover_tree->node, false);
-	struct wlr_box hover_geo = get_scale_box(hover_buffer,
-		SSD_BUTTON_WIDTH, rc.theme->title_height);
-	struct ssd_part *hover_part = add_scene_buffer(part_list, type,
-		hover_tree, hover_buffer, hover_geo.x, hover_geo.y);
-
-	/* Make sure big icons are scaled down if necessary */
-	wlr_scene_buffer_set_dest_size(
-		wlr_scene_buffer_from_node(hover_part->node),
-		hover_geo.width, hover_geo.height);
+	struct ssd_part *hover_part = add_scene_icon(part_list, type,
+		hover_tree, hover_buffer);
 
 	struct ssd_button *button = ssd_button_descriptor_create(button_root->node);
 	button->type = type;
@@ -199,27 +264,12 @@ add_toggled_icon(struct ssd_button *button, struct wl_list *part_list,
 		struct wlr_buffer *hover_buffer)
 {
 	/* Alternate icon */
-	struct wlr_box icon_geo = get_scale_box(icon_buffer,
-		SSD_BUTTON_WIDTH, rc.theme->title_height);
-
-	struct ssd_part *alticon_part = add_scene_buffer(part_list, type,
-		button->icon_tree, icon_buffer, icon_geo.x, icon_geo.y);
-
-	wlr_scene_buffer_set_dest_size(
-		wlr_scene_buffer_from_node(alticon_part->node),
-		icon_geo.width, icon_geo.height);
-
+	struct ssd_part *alticon_part = add_scene_icon(part_list, type,
+		button->icon_tree, icon_buffer);
 	wlr_scene_node_set_enabled(alticon_part->node, false);
 
-	struct wlr_box hover_geo = get_scale_box(hover_buffer,
-		SSD_BUTTON_WIDTH, rc.theme->title_height);
-	struct ssd_part *althover_part = add_scene_buffer(part_list, type,
-		button->hover_tree, hover_buffer, hover_geo.x, hover_geo.y);
-
-	wlr_scene_buffer_set_dest_size(
-		wlr_scene_buffer_from_node(althover_part->node),
-		hover_geo.width, hover_geo.height);
-
+	struct ssd_part *althover_part = add_scene_icon(part_list, type,
+		button->hover_tree, hover_buffer);
 	wlr_scene_node_set_enabled(althover_part->node, false);
 
 	button->toggled = alticon_part->node;
@@ -238,23 +288,29 @@ ssd_get_part(struct wl_list *part_list, enum ssd_part_type type)
 	return NULL;
 }
 
+void
+ssd_destroy_part(struct ssd_part *part)
+{
+	if (part->node) {
+		wlr_scene_node_destroy(part->node);
+		part->node = NULL;
+	}
+	/* part->buffer will free itself along the scene_buffer node */
+	part->buffer = NULL;
+	if (part->geometry) {
+		free(part->geometry);
+		part->geometry = NULL;
+	}
+	wl_list_remove(&part->link);
+	pool_free(&parts, part);
+}
+
 void
 ssd_destroy_parts(struct wl_list *list)
 {
 	struct ssd_part *part, *tmp;
 	wl_list_for_each_reverse_safe(part, tmp, list, link) {
-		if (part->node) {
-			wlr_scene_node_destroy(part->node);
-			part->node = NULL;
-		}
-		/* part->buffer will free itself along the scene_buffer node */
-		part->buffer = NULL;
-		if (part->geometry) {
-			free(part->geometry);
-			part->geometry = NULL;
-		}
-		wl_list_remove(&part->link);
-		free(part);
+		ssd_destroy_part(part);
 	}
 	assert(wl_list_empty(list));
 }
@@ -4,7 +4,7 @@
 #include <assert.h>
 #include <string.h>
 #include "buffer.h"
-#include "common/mem.h"
+#include "common/intern.h"
 #include "common/scaled_font_buffer.h"
 #include "common/scene-helpers.h"
 #include "common/string-helpers.h"
@@ -21,17 +21,35 @@
 static void set_squared_corners(struct ssd *ssd, bool enable);
 static void set_maximize_alt_icon(struct ssd *ssd, bool enable);
 
+static struct ssd_titlebar_parts *
+get_parts(struct ssd *ssd, struct ssd_sub_tree *subtree)
+{
+	return subtree == &ssd->titlebar.active
+		? &ssd->titlebar.active_parts : &ssd->titlebar.inactive_parts;
+}
+
+static void
+compute_layout(struct ssd_titlebar_layout *layout, int width)
+{
+	layout->width = width;
+	layout->title_bg_width = width - SSD_BUTTON_WIDTH * SSD_BUTTON_COUNT;
+	layout->iconify_x = width - SSD_BUTTON_WIDTH * 3;
+	layout->maximize_x = width - SSD_BUTTON_WIDTH * 2;
+	layout->close_x = width - SSD_BUTTON_WIDTH * 1;
+}
+
 void
 ssd_titlebar_create(struct ssd *ssd)
 {
 	struct view *view = ssd->view;
 	struct theme *theme = view->server->theme;
-	int width = view->current.width;
+	struct ssd_titlebar_layout *layout = &ssd->titlebar.layout;
+	compute_layout(layout, view->current.width);
 
 	float *color;
 	struct wlr_scene_tree *parent;
-	struct wlr_buffer *corner_top_left;
-	struct wlr_buffer *corner_top_right;
+	enum theme_corner corner_top_left;
+	enum theme_corner corner_top_right;
 
 	struct wlr_buffer *menu_button_unpressed;
 	struct wlr_buffer *iconify_button_unpressed;
@@ -54,8 +72,8 @@ ssd_titlebar_create(struct ssd *ssd)
 		wlr_scene_node_set_position(&parent->node, 0, -theme->title_height);
 		if (subtree == &ssd->titlebar.active) {
 			color = theme->window_active_title_bg_color;
-			corner_top_left = &theme->corner_top_left_active_normal->base;
-			corner_top_right = &theme->corner_top_right_active_normal->base;
+			corner_top_left = THEME_CORNER_TOP_LEFT_ACTIVE;
+			corner_top_right = THEME_CORNER_TOP_RIGHT_ACTIVE;
 			menu_button_unpressed = &theme->button_menu_active_unpressed->base;
 			iconify_button_unpressed = &theme->button_iconify_active_unpressed->base;
 			close_button_unpressed = &theme->button_close_active_unpressed->base;
@@ -69,8 +87,8 @@ ssd_titlebar_create(struct ssd *ssd)
 			restore_button_hover = &theme->button_restore_active_hover->base;
 		} else {
 			color = theme->window_inactive_title_bg_color;
-			corner_top_left = &theme->corner_top_left_inactive_normal->base;
-			corner_top_right = &theme->corner_top_right_inactive_normal->base;
+			corner_top_left = THEME_CORNER_TOP_LEFT_INACTIVE;
+			corner_top_right = THEME_CORNER_TOP_RIGHT_INACTIVE;
 			menu_button_unpressed = &theme->button_menu_inactive_unpressed->base;
 			iconify_button_unpressed = &theme->button_iconify_inactive_unpressed->base;
 			maximize_button_unpressed =
@@ -87,32 +105,37 @@ ssd_titlebar_create(struct ssd *ssd)
 			wlr_scene_node_set_enabled(&parent->node, false);
 		}
 		wl_list_init(&subtree->parts);
+		struct ssd_titlebar_parts *parts = get_parts(ssd, subtree);
+		*parts = (struct ssd_titlebar_parts){0};
 
 		/* Title */
-		add_scene_rect(&subtree->parts, LAB_SSD_PART_TITLEBAR, parent,
-			width - SSD_BUTTON_WIDTH * SSD_BUTTON_COUNT, theme->title_height,
-			SSD_BUTTON_WIDTH, 0, color);
+		struct ssd_part *title_bg = add_scene_rect(&subtree->parts,
+			LAB_SSD_PART_TITLEBAR, parent, layout->title_bg_width,
+			theme->title_height, SSD_BUTTON_WIDTH, 0, color);
+		parts->title_bg = wlr_scene_rect_from_node(title_bg->node);
 		/* Buttons */
 		add_scene_button_corner(&subtree->parts,
 			LAB_SSD_BUTTON_WINDOW_MENU, LAB_SSD_PART_CORNER_TOP_LEFT, parent,
 			corner_top_left, menu_button_unpressed, menu_button_hover, 0, view);
-		add_scene_button(&subtree->parts, LAB_SSD_BUTTON_ICONIFY, parent,
-			color, iconify_button_unpressed, iconify_button_hover,
-			width - SSD_BUTTON_WIDTH * 3, view);
+		parts->iconify = add_scene_button(&subtree->parts,
+			LAB_SSD_BUTTON_ICONIFY, parent, color,
+			iconify_button_unpressed, iconify_button_hover,
+			layout->iconify_x, view)->node;
 
 		/* Maximize button has an alternate state when maximized */
 		struct ssd_part *btn_max_root = add_scene_button(
 			&subtree->parts, LAB_SSD_BUTTON_MAXIMIZE, parent,
 			color, maximize_button_unpressed, maximize_button_hover,
-			width - SSD_BUTTON_WIDTH * 2, view);
+			layout->maximize_x, view);
 		struct ssd_button *btn_max = node_ssd_button_from_node(btn_max_root->node);
 		add_toggled_icon(btn_max, &subtree->parts, LAB_SSD_BUTTON_MAXIMIZE,
 			restore_button_unpressed, restore_button_hover);
+		parts->maximize = btn_max_root->node;
 
-		add_scene_button_corner(&subtree->parts,
+		parts->close = add_scene_button_corner(&subtree->parts,
 			LAB_SSD_BUTTON_CLOSE, LAB_SSD_PART_CORNER_TOP_RIGHT, parent,
 			corner_top_right, close_button_unpressed, close_button_hover,
-			width - SSD_BUTTON_WIDTH * 1, view);
+			layout->close_x, view)->node;
 	} FOR_EACH_END
 
 	ssd_update_title(ssd);
@@ -124,12 +147,6 @@ ssd_titlebar_create(struct ssd *ssd)
 	}
 }
 
-static bool
-is_direct_child(struct wlr_scene_node *node, struct ssd_sub_tree *subtree)
-{
-	return node->parent == subtree->tree;
-}
-
 static void
 set_squared_corners(struct ssd *ssd, bool enable)
 {
@@ -184,8 +201,8 @@ void
 ssd_titlebar_update(struct ssd *ssd)
 {
 	struct view *view = ssd->view;
-	int width = view->current.width;
 	struct theme *theme = view->server->theme;
+	struct ssd_titlebar_layout *layout = &ssd->titlebar.layout;
 
 	bool maximized = (view->maximized == VIEW_AXIS_BOTH);
 	if (ssd->state.was_maximized != maximized) {
@@ -194,43 +211,19 @@ ssd_titlebar_update(struct ssd *ssd)
 		ssd->state.was_maximized = maximized;
 	}
 
-	if (width == ssd->state.geometry.width) {
+	if (view->current.width == layout->width) {
 		return;
 	}
+	compute_layout(layout, view->current.width);
 
-	struct ssd_part *part;
 	struct ssd_sub_tree *subtree;
 	FOR_EACH_STATE(ssd, subtree) {
-		wl_list_for_each(part, &subtree->parts, link) {
-			switch (part->type) {
-			case LAB_SSD_PART_TITLEBAR:
-				wlr_scene_rect_set_size(
-					wlr_scene_rect_from_node(part->node),
-					width - SSD_BUTTON_WIDTH * SSD_BUTTON_COUNT,
-					theme->title_height);
-				continue;
-			case LAB_SSD_BUTTON_ICONIFY:
-				if (is_direct_child(part->node, subtree)) {
-					wlr_scene_node_set_position(part->node,
-						width - SSD_BUTTON_WIDTH * 3, 0);
-				}
-				continue;
-			case LAB_SSD_BUTTON_MAXIMIZE:
-				if (is_direct_child(part->node, subtree)) {
-					wlr_scene_node_set_position(part->node,
-						width - SSD_BUTTON_WIDTH * 2, 0);
-				}
-				continue;
-			case LAB_SSD_PART_CORNER_TOP_RIGHT:
-				if (is_direct_child(part->node, subtree)) {
-					wlr_scene_node_set_position(part->node,
-						width - SSD_BUTTON_WIDTH * 1, 0);
-				}
-				continue;
-			default:
-				continue;
-			}
-		}
+		struct ssd_titlebar_parts *parts = get_parts(ssd, subtree);
+		wlr_scene_rect_set_size(parts->title_bg,
+			layout->title_bg_width, theme->title_height);
+		wlr_scene_node_set_position(parts->iconify, layout->iconify_x, 0);
+		wlr_scene_node_set_position(parts->maximize, layout->maximize_x, 0);
+		wlr_scene_node_set_position(parts->close, layout->close_x, 0);
 	} FOR_EACH_END
 	ssd_update_title(ssd);
 }
@@ -247,22 +240,23 @@ ssd_titlebar_destroy(struct ssd *ssd)
 		ssd_destroy_parts(&subtree->parts);
 		wlr_scene_node_destroy(&subtree->tree->node);
 		subtree->tree = NULL;
+		*get_parts(ssd, subtree) = (struct ssd_titlebar_parts){0};
 	} FOR_EACH_END
+	ssd->titlebar.layout = (struct ssd_titlebar_layout){0};
 
-	if (ssd->state.title.text) {
-		free(ssd->state.title.text);
-		ssd->state.title.text = NULL;
-	}
+	intern_release(ssd->state.title.text);
+	ssd->state.title.text = NULL;
 
 	wlr_scene_node_destroy(&ssd->titlebar.tree->node);
 	ssd->titlebar.tree = NULL;
 }
 
 /*
- * For ssd_update_title* we do not early out because
- * .active and .inactive may result in different sizes
+ * For ssd_update_title* we do not early out for both states at once
+ * because .active and .inactive may result in different sizes
  * of the title (font family/size) or background of
- * the title (different button/border width).
+ * the title (different button/border width). Each state is only
+ * re-positioned if its title buffer or the space for it changed.
  *
  * Both, wlr_scene_node_set_enabled() and wlr_scene_node_set_position()
  * check for actual changes and return early if there is no change in state.
@@ -283,7 +277,7 @@ ssd_update_title_positions(struct ssd *ssd)
 	struct ssd_part *part;
 	struct ssd_sub_tree *subtree;
 	FOR_EACH_STATE(ssd, subtree) {
-		part = ssd_get_part(&subtree->parts, LAB_SSD_PART_TITLE);
+		part = get_parts(ssd, subtree)->title;
 		if (!part || !part->node) {
 			/* view->surface never been mapped */
 			/* Or we somehow failed to allocate a scaled titlebar buffer */
@@ -292,6 +286,21 @@ ssd_update_title_positions(struct ssd *ssd)
 
 		buffer_width = part->buffer ? part->buffer->width : 0;
 		buffer_height = part->buffer ? part->buffer->height : 0;
+
+		/* Only moves if the title or the space for it changed */
+		struct ssd_state_title_width *dstate =
+			subtree == &ssd->titlebar.active
+				? &ssd->state.title.active
+				: &ssd->state.title.inactive;
+		if (dstate->positioned_bg_width == title_bg_width
+				&& dstate->positioned_buffer_width == buffer_width
+				&& dstate->positioned_buffer_height == buffer_height) {
+			continue;
+		}
+		dstate->positioned_bg_width = title_bg_width;
+		dstate->positioned_buffer_width = buffer_width;
+		dstate->positioned_buffer_height = buffer_height;
+
 		x = SSD_BUTTON_WIDTH;
 		y = (theme->title_height - buffer_height) / 2;
 
@@ -329,6 +338,11 @@ ssd_update_title(struct ssd *ssd)
 		return;
 	}
 
+	if (ssd->state.trimmed) {
+		/* Re-rendered by ssd_set_trimmed() once shown again */
+		return;
+	}
+
 	struct view *view = ssd->view;
 	char *title = (char *)view_get_string_prop(view, "title");
 	if (string_null_or_empty(title)) {
@@ -337,7 +351,8 @@ ssd_update_title(struct ssd *ssd)
 
 	struct theme *theme = view->server->theme;
 	struct ssd_state_title *state = &ssd->state.title;
-	bool title_unchanged = state->text && !strcmp(title, state->text);
+	const char *interned = intern_string(title);
+	bool title_unchanged = interned == state->text;
 
 	const float *text_color;
 	const float *bg_color;
@@ -349,7 +364,8 @@ ssd_update_title(struct ssd *ssd)
 		- SSD_BUTTON_WIDTH * SSD_BUTTON_COUNT;
 
 	FOR_EACH_STATE(ssd, subtree) {
-		if (subtree == &ssd->titlebar.active) {
+		bool is_active = subtree == &ssd->titlebar.active;
+		if (is_active) {
 			dstate = &state->active;
 			text_color = theme->window_active_label_text_color;
 			bg_color = theme->window_active_title_bg_color;
@@ -366,13 +382,19 @@ ssd_update_title(struct ssd *ssd)
 			continue;
 		}
 
-		if (title_unchanged
+		if (is_active != ssd->state.active) {
+			/* Not shown, render once ssd_set_active() switches to it */
+			dstate->stale = true;
+			continue;
+		}
+
+		if (title_unchanged && !dstate->stale
 				&& !dstate->truncated && dstate->width < title_bg_width) {
 			/* title the same + we don't need to resize title */
 			continue;
 		}
 
-		part = ssd_get_part(&subtree->parts, LAB_SSD_PART_TITLE);
+		part = get_parts(ssd, subtree)->title;
 		if (!part) {
 			/* Initialize part and wlr_scene_buffer without attaching a buffer */
 			part = add_scene_part(&subtree->parts, LAB_SSD_PART_TITLE);
@@ -382,6 +404,9 @@ ssd_update_title(struct ssd *ssd)
 			} else {
 				wlr_log(WLR_ERROR, "Failed to create title node");
 			}
+			get_parts(ssd, subtree)->title = part;
+			/* A new node, not positioned yet */
+			dstate->positioned_bg_width = -1;
 		}
 
 		if (part->buffer) {
@@ -393,18 +418,88 @@ ssd_update_title(struct ssd *ssd)
 		/* And finally update the cache */
 		dstate->width = part->buffer ? part->buffer->width : 0;
 		dstate->truncated = title_bg_width <= dstate->width;
+		dstate->stale = false;
 
 	} FOR_EACH_END
 
-	if (!title_unchanged) {
-		if (state->text) {
-			free(state->text);
-		}
-		state->text = xstrdup(title);
-	}
+	/* Keep one reference, the old one or the new one */
+	intern_release(title_unchanged ? interned : state->text);
+	state->text = interned;
 	ssd_update_title_positions(ssd);
 }
 
+/*
+ * Clients like terminals and browsers may change their title many times
+ * per second. Re-render at most once per output frame instead: the titles
+ * are flushed from the frame handler of any output.
+ */
+void
+ssd_schedule_title_update(struct ssd *ssd)
+{
+	if (!ssd || ssd->title_update_pending) {
+		return;
+	}
+	struct view *view = ssd->view;
+	if (!view->output || !output_is_usable(view->output)) {
+		/* No frame to wait for */
+		ssd_update_title(ssd);
+		return;
+	}
+	ssd->title_update_pending = true;
+	wl_list_insert(&view->server->ssd_title_updates,
+		&ssd->title_update_link);
+	wlr_output_schedule_frame(view->output->wlr_output);
+}
+
+void
+ssd_flush_title_updates(struct server *server)
+{
+	struct ssd *ssd, *tmp;
+	wl_list_for_each_safe(ssd, tmp, &server->ssd_title_updates,
+			title_update_link) {
+		wl_list_remove(&ssd->title_update_link);
+		wl_list_init(&ssd->title_update_link);
+		ssd->title_update_pending = false;
+		ssd_update_title(ssd);
+	}
+}
+
+/*
+ * The rendered titles are the only per-view buffers of the decoration,
+ * everything else is shared with the theme. Drop them while the view is
+ * hidden and render them again when it becomes visible.
+ */
+void
+ssd_set_trimmed(struct ssd *ssd, bool trimmed)
+{
+	if (!ssd || ssd->state.trimmed == trimmed) {
+		return;
+	}
+	ssd->state.trimmed = trimmed;
+	if (!trimmed) {
+		ssd_update_title(ssd);
+		return;
+	}
+
+	struct ssd_part *part;
+	struct ssd_sub_tree *subtree;
+	FOR_EACH_STATE(ssd, subtree) {
+		struct ssd_titlebar_parts *parts = get_parts(ssd, subtree);
+		if (parts->title) {
+			ssd_destroy_part(parts->title);
+			parts->title = NULL;
+		}
+	} FOR_EACH_END
+	ssd->state.title.active.stale = true;
+	ssd->state.title.inactive.stale = true;
+}
+
+bool
+ssd_is_trimmed(struct ssd *ssd)
+{
+	return ssd && ssd->state.trimmed;
+}
+
 static void
 ssd_button_set_hover(struct ssd_button *button, bool enabled)
 {
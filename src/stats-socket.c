@@ -0,0 +1,380 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _GNU_SOURCE
+#include <errno.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/util/log.h>
+#include "buffer.h"
+#include "client-stats.h"
+#include "common/buf.h"
+#include "common/histogram.h"
+#include "common/list.h"
+#include "common/mem.h"
+#include "common/scaled_scene_buffer.h"
+#include "configure-stats.h"
+#include "debug.h"
+#include "heap-trim.h"
+#include "idle.h"
+#include "labwc.h"
+#include "memory-pressure.h"
+#include "stats-socket.h"
+#include "view.h"
+
+struct stats_client {
+	int fd;
+	struct buf json;
+	int written;
+	struct wl_event_source *source;
+	struct wl_list link;
+};
+
+static int listen_fd = -1;
+static char *socket_path;
+static ino_t socket_ino; /* to leave a socket bound by someone else alone */
+static struct wl_event_source *listen_source;
+static struct wl_list clients = { &clients, &clients };
+
+static void
+add_fmt(struct buf *json, const char *fmt, ...)
+{
+	char tmp[256];
+	va_list ap;
+	va_start(ap, fmt);
+	vsnprintf(tmp, sizeof(tmp), fmt, ap);
+	va_end(ap);
+	buf_add(json, tmp);
+}
+
+static void
+add_string(struct buf *json, const char *str)
+{
+	buf_add_char(json, '"');
+	for (const char *p = str ? str : ""; *p; p++) {
+		if (*p == '"' || *p == '\\') {
+			buf_add_char(json, '\\');
+			buf_add_char(json, *p);
+		} else if ((unsigned char)*p < 0x20) {
+			add_fmt(json, "\\u%04x", (unsigned char)*p);
+		} else {
+			buf_add_char(json, *p);
+		}
+	}
+	buf_add_char(json, '"');
+}
+
+static void
+add_histogram(struct buf *json, const char *name, struct histogram *hist)
+{
+	add_fmt(json, "\"%s\":{\"count\":%" PRIu64, name, hist->count);
+	if (hist->count) {
+		add_fmt(json, ",\"avg\":%" PRIu64 ",\"p50\":%" PRIu32
+			",\"p99\":%" PRIu32 ",\"max\":%" PRIu32,
+			hist->sum / hist->count,
+			histogram_percentile(hist, 50),
+			histogram_percentile(hist, 99), hist->max);
+	}
+	buf_add_char(json, '}');
+}
+
+static void
+add_configure_stats(const char *name, struct histogram *response,
+		uint64_t timeouts, void *data)
+{
+	struct buf *json = data;
+	if (json->data[json->len - 1] != '[') {
+		buf_add_char(json, ',');
+	}
+	buf_add(json, "{\"name\":");
+	add_string(json, name);
+	add_fmt(json, ",\"timeouts\":%" PRIu64 ",", timeouts);
+	add_histogram(json, "response_usec", response);
+	buf_add_char(json, '}');
+}
+
+static void
+add_client_stats(const struct client_stats_info *info, void *data)
+{
+	struct buf *json = data;
+	if (json->data[json->len - 1] != '[') {
+		buf_add_char(json, ',');
+	}
+	buf_add(json, "{\"name\":");
+	add_string(json, info->name);
+	add_fmt(json, ",\"pid\":%d,\"commits\":%" PRIu64
+		",\"commit_rate\":%" PRIu32 ",\"peak_commit_rate\":%" PRIu32
+		",\"damage_pixels\":%" PRIu64,
+		(int)info->pid, info->commits, info->commit_rate,
+		info->peak_commit_rate, info->damage_pixels);
+	add_fmt(json, ",\"buffer_bytes\":%zu,\"peak_buffer_bytes\":%zu"
+		",\"surfaces\":%" PRIu32 ",\"popups\":%" PRIu32 ",",
+		info->buffer_bytes, info->peak_buffer_bytes,
+		info->surfaces, info->popups);
+	add_histogram(json, "configure_usec", info->configure);
+	buf_add_char(json, '}');
+}
+
+static void
+build_json(struct server *server, struct buf *json)
+{
+	buf_add(json, "{\"outputs\":[");
+	struct output *output;
+	bool first = true;
+	wl_list_for_each(output, &server->outputs, link) {
+		struct output_frame_stats *stats = &output->frame_stats;
+		if (!first) {
+			buf_add_char(json, ',');
+		}
+		first = false;
+		buf_add(json, "{\"name\":");
+		add_string(json, output->wlr_output->name);
+		add_fmt(json, ",\"frames_committed\":%" PRIu64
+			",\"missed_vblanks\":%" PRIu64
+			",\"frames_fully_damaged\":%" PRIu64
+			",\"frames_scanout\":%" PRIu64
+			",\"frames_composited\":%" PRIu64
+			",\"frames_tearing\":%" PRIu64
+			",\"frames_torn\":%" PRIu64 ",",
+			stats->frames_committed, stats->missed_vblanks,
+			stats->frames_fully_damaged, stats->frames_scanout,
+			stats->frames_composited, stats->frames_tearing,
+			stats->frames_torn);
+		add_histogram(json, "build_state_usec", &stats->build_state);
+		buf_add_char(json, ',');
+		add_histogram(json, "commit_usec", &stats->commit);
+		buf_add_char(json, ',');
+		add_histogram(json, "frame_done_usec", &stats->frame_done);
+		buf_add_char(json, ',');
+		add_histogram(json, "damage_area", &stats->damage_area);
+		buf_add_char(json, '}');
+	}
+	buf_add(json, "],");
+
+	int views = 0, mapped = 0;
+	struct view *view;
+	wl_list_for_each(view, &server->views, link) {
+		views++;
+		mapped += view->mapped;
+	}
+	add_fmt(json, "\"views\":{\"total\":%d,\"mapped\":%d},",
+		views, mapped);
+
+	struct debug_scene_stats scene;
+	debug_get_scene_stats(server, &scene);
+	add_fmt(json, "\"scene\":{\"trees\":%" PRIu32 ",\"rects\":%" PRIu32
+		",\"buffers\":%" PRIu32 ",\"surfaces\":%" PRIu32
+		",\"buffer_bytes\":%" PRIu64 "},",
+		scene.trees, scene.rects, scene.buffers, scene.surfaces,
+		scene.buffer_bytes);
+
+	struct buffer_stats buffers;
+	buffer_get_stats(&buffers);
+	add_fmt(json, "\"data_buffers\":{\"count\":%zu,\"bytes\":%zu"
+		",\"peak_bytes\":%zu},",
+		buffers.count, buffers.bytes, buffers.peak_bytes);
+
+	struct scaled_scene_buffer_stats scaled;
+	scaled_scene_buffer_get_stats(&scaled);
+	add_fmt(json, "\"scaled_buffers\":{\"bytes\":%zu,\"hits\":%" PRIu64
+		",\"misses\":%" PRIu64 ",\"evictions\":%" PRIu64 "},",
+		scaled.bytes, scaled.hits, scaled.misses, scaled.evictions);
+
+	struct heap_trim_stats trim;
+	heap_trim_get_stats(&trim);
+	add_fmt(json, "\"heap_trim\":{\"runs\":%" PRIu64
+		",\"reclaimed_bytes\":%zu},", trim.runs, trim.reclaimed_bytes);
+
+	struct memory_pressure_stats pressure;
+	memory_pressure_get_stats(&pressure);
+	add_fmt(json, "\"memory_pressure\":{\"events\":%" PRIu64
+		",\"shed_bytes\":%zu},", pressure.events, pressure.shed_bytes);
+
+	buf_add(json, "\"configure\":[");
+	configure_stats_for_each(add_configure_stats, json);
+	buf_add(json, "],");
+
+	buf_add(json, "\"clients\":[");
+	client_stats_for_each(add_client_stats, json);
+	buf_add(json, "],");
+
+	add_fmt(json, "\"input_events\":%" PRIu64 "}\n",
+		idle_manager_get_activity_count());
+}
+
+static void
+client_destroy(struct stats_client *client)
+{
+	if (client->source) {
+		wl_event_source_remove(client->source);
+	}
+	close(client->fd);
+	buf_reset(&client->json);
+	wl_list_remove(&client->link);
+	free(client);
+}
+
+/* Return true once everything has been written or writing failed */
+static bool
+client_write(struct stats_client *client)
+{
+	while (client->written < client->json.len) {
+		ssize_t ret = write(client->fd,
+			client->json.data + client->written,
+			client->json.len - client->written);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return errno != EAGAIN && errno != EWOULDBLOCK;
+		}
+		client->written += ret;
+	}
+	return true;
+}
+
+static int
+handle_client_writable(int fd, uint32_t mask, void *data)
+{
+	struct stats_client *client = data;
+	if ((mask & (WL_EVENT_HANGUP | WL_EVENT_ERROR))
+			|| client_write(client)) {
+		client_destroy(client);
+	}
+	return 0;
+}
+
+static int
+handle_connection(int fd, uint32_t mask, void *data)
+{
+	struct server *server = data;
+
+	int client_fd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if (client_fd < 0) {
+		wlr_log_errno(WLR_ERROR, "stats socket: accept failed");
+		return 0;
+	}
+
+	struct stats_client *client = znew(*client);
+	client->fd = client_fd;
+	client->json = BUF_INIT;
+	wl_list_insert(&clients, &client->link);
+	build_json(server, &client->json);
+
+	if (client_write(client)) {
+		client_destroy(client);
+		return 0;
+	}
+	/* Socket buffer full, finish once the client has read some */
+	client->source = wl_event_loop_add_fd(server->wl_event_loop,
+		client_fd, WL_EVENT_WRITABLE, handle_client_writable, client);
+	return 0;
+}
+
+/*
+ * Remove a socket left behind by a compositor which did not exit cleanly.
+ * Returns false if @path is something else or still has a listener.
+ */
+static bool
+remove_stale_socket(const struct sockaddr_un *addr)
+{
+	const char *path = addr->sun_path;
+	struct stat st;
+	if (lstat(path, &st) < 0) {
+		return errno == ENOENT;
+	}
+	if (!S_ISSOCK(st.st_mode) || st.st_uid != getuid()) {
+		wlr_log(WLR_ERROR, "stats socket: %s exists and is not "
+			"a socket of this user", path);
+		return false;
+	}
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		wlr_log_errno(WLR_ERROR, "stats socket: socket failed");
+		return false;
+	}
+	int ret = connect(fd, (const struct sockaddr *)addr, sizeof(*addr));
+	int err = errno;
+	close(fd);
+	if (ret == 0 || err != ECONNREFUSED) {
+		wlr_log(WLR_ERROR, "stats socket: %s is in use", path);
+		return false;
+	}
+	if (unlink(path) < 0 && errno != ENOENT) {
+		wlr_log_errno(WLR_ERROR, "stats socket: cannot remove %s", path);
+		return false;
+	}
+	return true;
+}
+
+void
+stats_socket_init(struct server *server)
+{
+	const char *path = getenv("LABWC_STATS_SOCKET");
+	if (!path || !*path) {
+		return;
+	}
+
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		wlr_log(WLR_ERROR, "stats socket: path too long: %s", path);
+		return;
+	}
+	strcpy(addr.sun_path, path);
+
+	if (!remove_stale_socket(&addr)) {
+		return;
+	}
+
+	listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (listen_fd < 0) {
+		wlr_log_errno(WLR_ERROR, "stats socket: socket failed");
+		return;
+	}
+	if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0
+			|| listen(listen_fd, 4) < 0) {
+		wlr_log_errno(WLR_ERROR, "stats socket: cannot listen on %s", path);
+		close(listen_fd);
+		listen_fd = -1;
+		return;
+	}
+
+	struct stat st;
+	socket_ino = stat(path, &st) == 0 ? st.st_ino : 0;
+	socket_path = xstrdup(path);
+	listen_source = wl_event_loop_add_fd(server->wl_event_loop, listen_fd,
+		WL_EVENT_READABLE, handle_connection, server);
+	wlr_log(WLR_INFO, "stats socket listening on %s", path);
+}
+
+void
+stats_socket_finish(struct server *server)
+{
+	struct stats_client *client, *tmp;
+	wl_list_for_each_safe(client, tmp, &clients, link) {
+		client_destroy(client);
+	}
+	if (listen_source) {
+		wl_event_source_remove(listen_source);
+		listen_source = NULL;
+	}
+	if (listen_fd >= 0) {
+		close(listen_fd);
+		listen_fd = -1;
+	}
+	if (socket_path) {
+		struct stat st;
+		if (lstat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode)
+				&& st.st_ino == socket_ino) {
+			unlink(socket_path);
+		}
+		zfree(socket_path);
+	}
+}
@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <assert.h>
+#include <stdlib.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_subcompositor.h>
+#include "common/int-map.h"
+#include "common/mem.h"
+#include "surface-map.h"
+#include "view.h"
+
+struct surface_owner {
+	struct wlr_surface *surface;
+	struct view *view;
+	bool is_main;
+	struct wl_list link; /* view.owned_surfaces */
+
+	struct wl_listener destroy;
+	struct wl_listener new_subsurface;
+};
+
+/* Keyed by wlr_surface pointer */
+static struct int_map owners;
+
+static void add_surface(struct view *view, struct wlr_surface *surface,
+	bool is_main);
+
+static void
+owner_destroy(struct surface_owner *owner)
+{
+	int_map_remove(&owners, (uintptr_t)owner->surface);
+	wl_list_remove(&owner->link);
+	wl_list_remove(&owner->destroy.link);
+	wl_list_remove(&owner->new_subsurface.link);
+	free(owner);
+}
+
+static void
+handle_destroy(struct wl_listener *listener, void *data)
+{
+	struct surface_owner *owner = wl_container_of(listener, owner, destroy);
+	owner_destroy(owner);
+}
+
+static void
+handle_new_subsurface(struct wl_listener *listener, void *data)
+{
+	struct surface_owner *owner =
+		wl_container_of(listener, owner, new_subsurface);
+	struct wlr_subsurface *subsurface = data;
+	add_surface(owner->view, subsurface->surface, /* is_main */ false);
+}
+
+static void
+add_surface(struct view *view, struct wlr_surface *surface, bool is_main)
+{
+	struct surface_owner *owner = znew(*owner);
+	if (!int_map_insert(&owners, (uintptr_t)surface, owner)) {
+		/* Already known, e.g. a subsurface seen by both paths */
+		free(owner);
+		return;
+	}
+	owner->surface = surface;
+	owner->view = view;
+	owner->is_main = is_main;
+	if (!view->owned_surfaces.next) {
+		wl_list_init(&view->owned_surfaces);
+	}
+	wl_list_insert(&view->owned_surfaces, &owner->link);
+
+	owner->destroy.notify = handle_destroy;
+	wl_signal_add(&surface->events.destroy, &owner->destroy);
+	owner->new_subsurface.notify = handle_new_subsurface;
+	wl_signal_add(&surface->events.new_subsurface, &owner->new_subsurface);
+}
+
+struct add_context {
+	struct view *view;
+	struct wlr_surface *main;
+};
+
+static void
+add_iter(struct wlr_surface *surface, int sx, int sy, void *data)
+{
+	struct add_context *ctx = data;
+	add_surface(ctx->view, surface, surface == ctx->main);
+}
+
+static void
+add_tree(struct view *view, struct wlr_surface *root, bool is_main)
+{
+	struct add_context ctx = {
+		.view = view,
+		.main = is_main ? root : NULL,
+	};
+	/* Existing subsurfaces; new ones are caught by new_subsurface */
+	wlr_surface_for_each_surface(root, add_iter, &ctx);
+}
+
+void
+surface_map_add_view(struct view *view)
+{
+	assert(view);
+	if (view->surface) {
+		add_tree(view, view->surface, /* is_main */ true);
+	}
+}
+
+void
+surface_map_add_popup(struct view *view, struct wlr_surface *surface)
+{
+	assert(view);
+	assert(surface);
+	add_tree(view, surface, /* is_main */ false);
+}
+
+void
+surface_map_remove_view(struct view *view)
+{
+	assert(view);
+	if (!view->owned_surfaces.next) {
+		return;
+	}
+	struct surface_owner *owner, *tmp;
+	wl_list_for_each_safe(owner, tmp, &view->owned_surfaces, link) {
+		owner_destroy(owner);
+	}
+}
+
+struct view *
+surface_map_get_view(struct wlr_surface *surface, bool *is_main)
+{
+	struct surface_owner *owner = int_map_lookup(&owners, (uintptr_t)surface);
+	if (is_main) {
+		*is_main = owner && owner->is_main;
+	}
+	return owner ? owner->view : NULL;
+}
+
+void
+surface_map_finish(void)
+{
+	/* All views and their surfaces are gone at this point */
+	int_map_finish(&owners);
+}
@@ -11,7 +11,9 @@
 #include <cairo.h>
 #include <drm_fourcc.h>
 #include <glib.h>
+#include <math.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -64,6 +66,7 @@ struct rounded_corner_ctx {
 	float *fill_color;
 	float *border_color;
 	enum corner corner;
+	double scale;
 };
 
 static struct lab_data_buffer *rounded_rect(struct rounded_corner_ctx *ctx);
@@ -97,7 +100,7 @@ corner_from_icon_name(const char *icon_name)
 static void
 create_hover_fallback(struct theme *theme, const char *icon_name,
 		struct lab_data_buffer **hover_buffer,
-		struct lab_data_buffer *icon_buffer)
+		struct lab_data_buffer *icon_buffer, double scale)
 {
 	assert(icon_name);
 	assert(icon_buffer);
@@ -105,8 +108,8 @@ create_hover_fallback(struct theme *theme, const char *icon_name,
 
 	struct surface_context icon =
 		get_cairo_surface_from_lab_data_buffer(icon_buffer);
-	int icon_width = cairo_image_surface_get_width(icon.surface);
-	int icon_height = cairo_image_surface_get_height(icon.surface);
+	int icon_width = icon_buffer->unscaled_width;
+	int icon_height = icon_buffer->unscaled_height;
 
 	int width = SSD_BUTTON_WIDTH;
 	int height = theme->title_height;
@@ -129,7 +132,7 @@ create_hover_fallback(struct theme *theme, const char *icon_name,
 		}
 	}
 
-	*hover_buffer = buffer_create_cairo(width, height, 1.0, true);
+	*hover_buffer = buffer_create_cairo(width, height, scale, true);
 
 	cairo_t *cairo = (*hover_buffer)->cairo;
 	cairo_surface_t *surf = cairo_get_target(cairo);
@@ -154,7 +157,8 @@ create_hover_fallback(struct theme *theme, const char *icon_name,
 			.line_width = theme->border_width,
 			.fill_color = overlay_color,
 			.border_color = overlay_color,
-			.corner = corner
+			.corner = corner,
+			.scale = scale,
 		};
 		struct lab_data_buffer *overlay_buffer = rounded_rect(&rounded_ctx);
 		cairo_set_source_surface(cairo,
@@ -169,6 +173,107 @@ create_hover_fallback(struct theme *theme, const char *icon_name,
 	}
 }
 
+/*
+ * Buttons rendered from SVG files and the hover fallbacks drawn on top of
+ * them. Their buffers are for scale 1, other scales are rendered on demand.
+ */
+struct scalable_button {
+	struct lab_data_buffer *buffer;
+	/* SVG file and size, or the icon a hover fallback is drawn from */
+	char name[64];
+	int size;
+	struct lab_data_buffer *hover_base;
+};
+
+struct scaled_button {
+	struct lab_data_buffer *base;
+	double scale;
+	struct lab_data_buffer *buffer;
+};
+
+static struct scalable_button *
+find_scalable_button(struct theme *theme, struct lab_data_buffer *buffer)
+{
+	struct scalable_button *scalable;
+	wl_array_for_each(scalable, &theme->scalable_buttons) {
+		if (scalable->buffer == buffer) {
+			return scalable;
+		}
+	}
+	return NULL;
+}
+
+static void
+add_hover_fallback(struct theme *theme, const char *icon_name,
+		struct lab_data_buffer **hover_buffer,
+		struct lab_data_buffer *icon_buffer)
+{
+	create_hover_fallback(theme, icon_name, hover_buffer, icon_buffer, 1);
+	if (!*hover_buffer || !find_scalable_button(theme, icon_buffer)) {
+		return;
+	}
+	struct scalable_button *scalable = wl_array_add(
+		&theme->scalable_buttons, sizeof(*scalable));
+	if (scalable) {
+		*scalable = (struct scalable_button){
+			.buffer = *hover_buffer,
+			.hover_base = icon_buffer,
+		};
+		snprintf(scalable->name, sizeof(scalable->name), "%s", icon_name);
+	}
+}
+
+bool
+theme_button_is_scalable(struct theme *theme, struct lab_data_buffer *button)
+{
+	return find_scalable_button(theme, button);
+}
+
+struct lab_data_buffer *
+theme_get_button(struct theme *theme, struct lab_data_buffer *button,
+		double scale)
+{
+	struct scalable_button *scalable = find_scalable_button(theme, button);
+	if (!scalable || scale == 1) {
+		return button;
+	}
+
+	struct scaled_button *scaled;
+	wl_array_for_each(scaled, &theme->scaled_buttons) {
+		if (scaled->base == button && scaled->scale == scale) {
+			return scaled->buffer ? scaled->buffer : button;
+		}
+	}
+
+	/* First view shown at this scale, render the button for it */
+	struct lab_data_buffer *buffer = NULL;
+	if (scalable->hover_base) {
+		struct lab_data_buffer *icon =
+			theme_get_button(theme, scalable->hover_base, scale);
+		create_hover_fallback(theme, scalable->name, &buffer, icon,
+			scale);
+	} else {
+#if HAVE_RSVG
+		button_svg_load(scalable->name, &buffer, scalable->size, scale);
+#endif
+	}
+	if (buffer) {
+		buffer_share_texture(&buffer->base, theme->renderer);
+	}
+
+	scaled = wl_array_add(&theme->scaled_buttons, sizeof(*scaled));
+	if (!scaled) {
+		zdrop(&buffer);
+		return button;
+	}
+	*scaled = (struct scaled_button){
+		.base = button,
+		.scale = scale,
+		.buffer = buffer,
+	};
+	return buffer ? buffer : button;
+}
+
 /*
  * We use the following button filename schema: "BUTTON [TOGGLED] [STATE]"
  * with the words separated by underscore, and the following meaning:
@@ -275,6 +380,12 @@ load_buttons(struct theme *theme)
 		.inactive.rgba = theme->window_inactive_button_close_unpressed_image_color,
 	}, };
 
+#if HAVE_RSVG
+	struct button_svg_job svg_jobs[2 * ARRAY_SIZE(buttons)];
+	size_t nr_svg_jobs = 0;
+	int size = theme->title_height - 2 * theme->padding_height;
+#endif
+
 	char filename[4096] = {0};
 	for (size_t i = 0; i < ARRAY_SIZE(buttons); ++i) {
 		struct button *b = &buttons[i];
@@ -289,17 +400,54 @@ load_buttons(struct theme *theme)
 		button_png_load(filename, b->inactive.buffer);
 
 #if HAVE_RSVG
-		/* SVG */
-		int size = theme->title_height - 2 * theme->padding_height;
+		/* SVG, rendered in parallel below */
 		if (!*b->active.buffer) {
-			snprintf(filename, sizeof(filename), "%s-active.svg", b->name);
-			button_svg_load(filename, b->active.buffer, size);
+			struct button_svg_job *job = &svg_jobs[nr_svg_jobs++];
+			snprintf(job->name, sizeof(job->name), "%s-active.svg", b->name);
+			job->buffer = b->active.buffer;
+			job->size = size;
 		}
 		if (!*b->inactive.buffer) {
-			snprintf(filename, sizeof(filename), "%s-inactive.svg", b->name);
-			button_svg_load(filename, b->inactive.buffer, size);
+			struct button_svg_job *job = &svg_jobs[nr_svg_jobs++];
+			snprintf(job->name, sizeof(job->name), "%s-inactive.svg", b->name);
+			job->buffer = b->inactive.buffer;
+			job->size = size;
 		}
 #endif
+	}
+
+	/* Released by theme_finish() */
+	wl_array_init(&theme->scalable_buttons);
+	wl_array_init(&theme->scaled_buttons);
+
+#if HAVE_RSVG
+	/* librsvg is by far the slowest loader, spread it over a few threads */
+	for (size_t i = 0; i < nr_svg_jobs; i++) {
+		svg_jobs[i].scale = 1;
+	}
+	button_svg_load_all(svg_jobs, nr_svg_jobs);
+
+	/* Rendered again for other output scales, see theme_get_button() */
+	for (size_t i = 0; i < nr_svg_jobs; i++) {
+		struct button_svg_job *job = &svg_jobs[i];
+		if (!*job->buffer) {
+			continue;
+		}
+		struct scalable_button *scalable = wl_array_add(
+			&theme->scalable_buttons, sizeof(*scalable));
+		if (scalable) {
+			*scalable = (struct scalable_button){
+				.buffer = *job->buffer,
+				.size = job->size,
+			};
+			snprintf(scalable->name, sizeof(scalable->name), "%s",
+				job->name);
+		}
+	}
+#endif
+
+	for (size_t i = 0; i < ARRAY_SIZE(buttons); ++i) {
+		struct button *b = &buttons[i];
 
 		/* XBM */
 		snprintf(filename, sizeof(filename), "%s.xbm", b->name);
@@ -364,12 +512,12 @@ load_buttons(struct theme *theme)
 			struct button *base = &buttons[j];
 			if (!strcmp(basename, base->name)) {
 				if (!*hover_button->active.buffer) {
-					create_hover_fallback(theme, basename,
+					add_hover_fallback(theme, basename,
 						hover_button->active.buffer,
 						*base->active.buffer);
 				}
 				if (!*hover_button->inactive.buffer) {
-					create_hover_fallback(theme, basename,
+					add_hover_fallback(theme, basename,
 						hover_button->inactive.buffer,
 						*base->inactive.buffer);
 				}
@@ -453,6 +601,24 @@ parse_justification(const char *str)
 	}
 }
 
+/*
+ * <core><reducedEffects> trades visual effects for fewer blended pixels,
+ * each of which is costly for the pixman renderer.
+ */
+static bool
+reduced_effects(struct server *server)
+{
+	switch (rc.reduced_effects) {
+	case LAB_REDUCED_EFFECTS_ENABLED:
+		return true;
+	case LAB_REDUCED_EFFECTS_DISABLED:
+		return false;
+	case LAB_REDUCED_EFFECTS_AUTO:
+		break;
+	}
+	return wlr_renderer_is_pixman(server->renderer);
+}
+
 /*
  * We generally use Openbox defaults, but if no theme file can be found it's
  * better to populate the theme variables with some sane values as no-one
@@ -546,7 +712,7 @@ theme_builtin(struct theme *theme, struct server *server)
 	theme->osd_border_color[0] = FLT_MIN;
 	theme->osd_label_text_color[0] = FLT_MIN;
 
-	if (wlr_renderer_is_pixman(server->renderer)) {
+	if (reduced_effects(server)) {
 		/* Draw only outlined overlay by default to save CPU resource */
 		theme->snapping_overlay_region.bg_enabled = false;
 		theme->snapping_overlay_edge.bg_enabled = false;
@@ -583,64 +749,70 @@ entry(struct theme *theme, const char *key, const char *value)
 	/*
 	 * Note that in order for the pattern match to apply to more than just
 	 * the first instance, "else if" cannot be used throughout this function
+	 *
+	 * Most keys do not contain wildcards, so classify the key once and
+	 * only fall back to fnmatch() for actual glob patterns.
 	 */
-	if (match_glob(key, "border.width")) {
+	struct match_pattern pattern;
+	match_pattern_compile(&pattern, key);
+
+	if (match_pattern(&pattern, "border.width")) {
 		theme->border_width = atoi(value);
 	}
-	if (match_glob(key, "padding.height")) {
+	if (match_pattern(&pattern, "padding.height")) {
 		theme->padding_height = atoi(value);
 	}
-	if (match_glob(key, "titlebar.height")) {
+	if (match_pattern(&pattern, "titlebar.height")) {
 		theme->title_height = atoi(value);
 	}
-	if (match_glob(key, "menu.items.padding.x")) {
+	if (match_pattern(&pattern, "menu.items.padding.x")) {
 		theme->menu_item_padding_x = atoi(value);
 	}
-	if (match_glob(key, "menu.items.padding.y")) {
+	if (match_pattern(&pattern, "menu.items.padding.y")) {
 		theme->menu_item_padding_y = atoi(value);
 	}
-	if (match_glob(key, "menu.overlap.x")) {
+	if (match_pattern(&pattern, "menu.overlap.x")) {
 		theme->menu_overlap_x = atoi(value);
 	}
-	if (match_glob(key, "menu.overlap.y")) {
+	if (match_pattern(&pattern, "menu.overlap.y")) {
 		theme->menu_overlap_y = atoi(value);
 	}
 
-	if (match_glob(key, "window.active.border.color")) {
+	if (match_pattern(&pattern, "window.active.border.color")) {
 		parse_hexstr(value, theme->window_active_border_color);
 	}
-	if (match_glob(key, "window.inactive.border.color")) {
+	if (match_pattern(&pattern, "window.inactive.border.color")) {
 		parse_hexstr(value, theme->window_inactive_border_color);
 	}
 	/* border.color is obsolete, but handled for backward compatibility */
-	if (match_glob(key, "border.color")) {
+	if (match_pattern(&pattern, "border.color")) {
 		parse_hexstr(value, theme->window_active_border_color);
 		parse_hexstr(value, theme->window_inactive_border_color);
 	}
 
-	if (match_glob(key, "window.active.indicator.toggled-keybind.color")) {
+	if (match_pattern(&pattern, "window.active.indicator.toggled-keybind.color")) {
 		parse_hexstr(value, theme->window_toggled_keybinds_color);
 	}
 
-	if (match_glob(key, "window.active.title.bg.color")) {
+	if (match_pattern(&pattern, "window.active.title.bg.color")) {
 		parse_hexstr(value, theme->window_active_title_bg_color);
 	}
-	if (match_glob(key, "window.inactive.title.bg.color")) {
+	if (match_pattern(&pattern, "window.inactive.title.bg.color")) {
 		parse_hexstr(value, theme->window_inactive_title_bg_color);
 	}
 
-	if (match_glob(key, "window.active.label.text.color")) {
+	if (match_pattern(&pattern, "window.active.label.text.color")) {
 		parse_hexstr(value, theme->window_active_label_text_color);
 	}
-	if (match_glob(key, "window.inactive.label.text.color")) {
+	if (match_pattern(&pattern, "window.inactive.label.text.color")) {
 		parse_hexstr(value, theme->window_inactive_label_text_color);
 	}
-	if (match_glob(key, "window.label.text.justify")) {
+	if (match_pattern(&pattern, "window.label.text.justify")) {
 		theme->window_label_text_justify = parse_justification(value);
 	}
 
 	/* universal button */
-	if (match_glob(key, "window.active.button.unpressed.image.color")) {
+	if (match_pattern(&pattern, "window.active.button.unpressed.image.color")) {
 		parse_hexstr(value,
 			theme->window_active_button_menu_unpressed_image_color);
 		parse_hexstr(value,
@@ -650,7 +822,7 @@ entry(struct theme *theme, const char *key, const char *value)
 		parse_hexstr(value,
 			theme->window_active_button_close_unpressed_image_color);
 	}
-	if (match_glob(key, "window.inactive.button.unpressed.image.color")) {
+	if (match_pattern(&pattern, "window.inactive.button.unpressed.image.color")) {
 		parse_hexstr(value,
 			theme->window_inactive_button_menu_unpressed_image_color);
 		parse_hexstr(value,
@@ -662,41 +834,41 @@ entry(struct theme *theme, const char *key, const char *value)
 	}
 
 	/* individual buttons */
-	if (match_glob(key, "window.active.button.menu.unpressed.image.color")) {
+	if (match_pattern(&pattern, "window.active.button.menu.unpressed.image.color")) {
 		parse_hexstr(value,
 			theme->window_active_button_menu_unpressed_image_color);
 	}
-	if (match_glob(key, "window.active.button.iconify.unpressed.image.color")) {
+	if (match_pattern(&pattern, "window.active.button.iconify.unpressed.image.color")) {
 		parse_hexstr(value,
 			theme->window_active_button_iconify_unpressed_image_color);
 	}
-	if (match_glob(key, "window.active.button.max.unpressed.image.color")) {
+	if (match_pattern(&pattern, "window.active.button.max.unpressed.image.color")) {
 		parse_hexstr(value,
 			theme->window_active_button_max_unpressed_image_color);
 	}
-	if (match_glob(key, "window.active.button.close.unpressed.image.color")) {
+	if (match_pattern(&pattern, "window.active.button.close.unpressed.image.color")) {
 		parse_hexstr(value,
 			theme->window_active_button_close_unpressed_image_color);
 	}
-	if (match_glob(key, "window.inactive.button.menu.unpressed.image.color")) {
+	if (match_pattern(&pattern, "window.inactive.button.menu.unpressed.image.color")) {
 		parse_hexstr(value,
 			theme->window_inactive_button_menu_unpressed_image_color);
 	}
-	if (match_glob(key, "window.inactive.button.iconify.unpressed.image.color")) {
+	if (match_pattern(&pattern, "window.inactive.button.iconify.unpressed.image.color")) {
 		parse_hexstr(value,
 			theme->window_inactive_button_iconify_unpressed_image_color);
 	}
-	if (match_glob(key, "window.inactive.button.max.unpressed.image.color")) {
+	if (match_pattern(&pattern, "window.inactive.button.max.unpressed.image.color")) {
 		parse_hexstr(value,
 			theme->window_inactive_button_max_unpressed_image_color);
 	}
-	if (match_glob(key, "window.inactive.button.close.unpressed.image.color")) {
+	if (match_pattern(&pattern, "window.inactive.button.close.unpressed.image.color")) {
 		parse_hexstr(value,
 			theme->window_inactive_button_close_unpressed_image_color);
 	}
 
 	/* window drop-shadows */
-	if (match_glob(key, "window.active.shadow.size")) {
+	if (match_pattern(&pattern, "window.active.shadow.size")) {
 		theme->window_active_shadow_size = atoi(value);
 		if (theme->window_active_shadow_size < 0) {
 			wlr_log(WLR_ERROR, "window.active.shadow.size cannot "
@@ -704,7 +876,7 @@ entry(struct theme *theme, const char *key, const char *value)
 			theme->window_active_shadow_size = 0;
 		}
 	}
-	if (match_glob(key, "window.inactive.shadow.size")) {
+	if (match_pattern(&pattern, "window.inactive.shadow.size")) {
 		theme->window_inactive_shadow_size = atoi(value);
 		if (theme->window_inactive_shadow_size < 0) {
 			wlr_log(WLR_ERROR, "window.inactive.shadow.size cannot "
@@ -712,56 +884,56 @@ entry(struct theme *theme, const char *key, const char *value)
 			theme->window_inactive_shadow_size = 0;
 		}
 	}
-	if (match_glob(key, "window.active.shadow.color")) {
+	if (match_pattern(&pattern, "window.active.shadow.color")) {
 		parse_hexstr(value, theme->window_active_shadow_color);
 	}
-	if (match_glob(key, "window.inactive.shadow.color")) {
+	if (match_pattern(&pattern, "window.inactive.shadow.color")) {
 		parse_hexstr(value, theme->window_inactive_shadow_color);
 	}
 
-	if (match_glob(key, "menu.width.min")) {
+	if (match_pattern(&pattern, "menu.width.min")) {
 		theme->menu_min_width = atoi(value);
 	}
-	if (match_glob(key, "menu.width.max")) {
+	if (match_pattern(&pattern, "menu.width.max")) {
 		theme->menu_max_width = atoi(value);
 	}
 
-	if (match_glob(key, "menu.items.bg.color")) {
+	if (match_pattern(&pattern, "menu.items.bg.color")) {
 		parse_hexstr(value, theme->menu_items_bg_color);
 	}
-	if (match_glob(key, "menu.items.text.color")) {
+	if (match_pattern(&pattern, "menu.items.text.color")) {
 		parse_hexstr(value, theme->menu_items_text_color);
 	}
-	if (match_glob(key, "menu.items.active.bg.color")) {
+	if (match_pattern(&pattern, "menu.items.active.bg.color")) {
 		parse_hexstr(value, theme->menu_items_active_bg_color);
 	}
-	if (match_glob(key, "menu.items.active.text.color")) {
+	if (match_pattern(&pattern, "menu.items.active.text.color")) {
 		parse_hexstr(value, theme->menu_items_active_text_color);
 	}
 
-	if (match_glob(key, "menu.separator.width")) {
+	if (match_pattern(&pattern, "menu.separator.width")) {
 		theme->menu_separator_line_thickness = atoi(value);
 	}
-	if (match_glob(key, "menu.separator.padding.width")) {
+	if (match_pattern(&pattern, "menu.separator.padding.width")) {
 		theme->menu_separator_padding_width = atoi(value);
 	}
-	if (match_glob(key, "menu.separator.padding.height")) {
+	if (match_pattern(&pattern, "menu.separator.padding.height")) {
 		theme->menu_separator_padding_height = atoi(value);
 	}
-	if (match_glob(key, "menu.separator.color")) {
+	if (match_pattern(&pattern, "menu.separator.color")) {
 		parse_hexstr(value, theme->menu_separator_color);
 	}
 
-	if (match_glob(key, "osd.bg.color")) {
+	if (match_pattern(&pattern, "osd.bg.color")) {
 		parse_hexstr(value, theme->osd_bg_color);
 	}
-	if (match_glob(key, "osd.border.width")) {
+	if (match_pattern(&pattern, "osd.border.width")) {
 		theme->osd_border_width = atoi(value);
 	}
-	if (match_glob(key, "osd.border.color")) {
+	if (match_pattern(&pattern, "osd.border.color")) {
 		parse_hexstr(value, theme->osd_border_color);
 	}
-	if (match_glob(key, "osd.window-switcher.width")) {
+	if (match_pattern(&pattern, "osd.window-switcher.width")) {
 		if (strrchr(value, '%')) {
 			theme->osd_window_switcher_width_is_percent = true;
 		} else {
@@ -769,61 +941,61 @@ entry(struct theme *theme, const char *key, const char *value)
 		}
 		theme->osd_window_switcher_width = MAX(atoi(value), 0);
 	}
-	if (match_glob(key, "osd.window-switcher.padding")) {
+	if (match_pattern(&pattern, "osd.window-switcher.padding")) {
 		theme->osd_window_switcher_padding = atoi(value);
 	}
-	if (match_glob(key, "osd.window-switcher.item.padding.x")) {
+	if (match_pattern(&pattern, "osd.window-switcher.item.padding.x")) {
 		theme->osd_window_switcher_item_padding_x = atoi(value);
 	}
-	if (match_glob(key, "osd.window-switcher.item.padding.y")) {
+	if (match_pattern(&pattern, "osd.window-switcher.item.padding.y")) {
 		theme->osd_window_switcher_item_padding_y = atoi(value);
 	}
-	if (match_glob(key, "osd.window-switcher.item.active.border.width")) {
+	if (match_pattern(&pattern, "osd.window-switcher.item.active.border.width")) {
 		theme->osd_window_switcher_item_active_border_width = atoi(value);
 	}
-	if (match_glob(key, "osd.window-switcher.preview.border.width")) {
+	if (match_pattern(&pattern, "osd.window-switcher.preview.border.width")) {
 		theme->osd_window_switcher_preview_border_width = atoi(value);
 	}
-	if (match_glob(key, "osd.window-switcher.preview.border.color")) {
+	if (match_pattern(&pattern, "osd.window-switcher.preview.border.color")) {
 		parse_hexstrs(value, theme->osd_window_switcher_preview_border_color);
 	}
-	if (match_glob(key, "osd.workspace-switcher.boxes.width")) {
+	if (match_pattern(&pattern, "osd.workspace-switcher.boxes.width")) {
 		theme->osd_workspace_switcher_boxes_width = atoi(value);
 	}
-	if (match_glob(key, "osd.workspace-switcher.boxes.height")) {
+	if (match_pattern(&pattern, "osd.workspace-switcher.boxes.height")) {
 		theme->osd_workspace_switcher_boxes_height = atoi(value);
 	}
-	if (match_glob(key, "osd.label.text.color")) {
+	if (match_pattern(&pattern, "osd.label.text.color")) {
 		parse_hexstr(value, theme->osd_label_text_color);
 	}
-	if (match_glob(key, "snapping.overlay.region.bg.enabled")) {
+	if (match_pattern(&pattern, "snapping.overlay.region.bg.enabled")) {
 		set_bool(value, &theme->snapping_overlay_region.bg_enabled);
 	}
-	if (match_glob(key, "snapping.overlay.edge.bg.enabled")) {
+	if (match_pattern(&pattern, "snapping.overlay.edge.bg.enabled")) {
 		set_bool(value, &theme->snapping_overlay_edge.bg_enabled);
 	}
-	if (match_glob(key, "snapping.overlay.region.border.enabled")) {
+	if (match_pattern(&pattern, "snapping.overlay.region.border.enabled")) {
 		set_bool(value, &theme->snapping_overlay_region.border_enabled);
 	}
-	if (match_glob(key, "snapping.overlay.edge.border.enabled")) {
+	if (match_pattern(&pattern, "snapping.overlay.edge.border.enabled")) {
 		set_bool(value, &theme->snapping_overlay_edge.border_enabled);
 	}
-	if (match_glob(key, "snapping.overlay.region.bg.color")) {
+	if (match_pattern(&pattern, "snapping.overlay.region.bg.color")) {
 		parse_hexstr(value, theme->snapping_overlay_region.bg_color);
 	}
-	if (match_glob(key, "snapping.overlay.edge.bg.color")) {
+	if (match_pattern(&pattern, "snapping.overlay.edge.bg.color")) {
 		parse_hexstr(value, theme->snapping_overlay_edge.bg_color);
 	}
-	if (match_glob(key, "snapping.overlay.region.border.width")) {
+	if (match_pattern(&pattern, "snapping.overlay.region.border.width")) {
 		theme->snapping_overlay_region.border_width = atoi(value);
 	}
-	if (match_glob(key, "snapping.overlay.edge.border.width")) {
+	if (match_pattern(&pattern, "snapping.overlay.edge.border.width")) {
 		theme->snapping_overlay_edge.border_width = atoi(value);
 	}
-	if (match_glob(key, "snapping.overlay.region.border.color")) {
+	if (match_pattern(&pattern, "snapping.overlay.region.border.color")) {
 		parse_hexstrs(value, theme->snapping_overlay_region.border_color);
 	}
-	if (match_glob(key, "snapping.overlay.edge.border.color")) {
+	if (match_pattern(&pattern, "snapping.overlay.edge.border.color")) {
 		parse_hexstrs(value, theme->snapping_overlay_edge.border_color);
 	}
 }
@@ -899,8 +1071,7 @@ rounded_rect(struct rounded_corner_ctx *ctx)
 	double r = ctx->radius;
 
 	struct lab_data_buffer *buffer;
-	/* TODO: scale */
-	buffer = buffer_create_cairo(w, h, 1, /*free_on_destroy*/ true);
+	buffer = buffer_create_cairo(w, h, ctx->scale, /*free_on_destroy*/ true);
 
 	cairo_t *cairo = buffer->cairo;
 	cairo_surface_t *surf = cairo_get_target(cairo);
@@ -1046,11 +1217,35 @@ rounded_rect(struct rounded_corner_ctx *ctx)
 out:
 	cairo_surface_flush(surf);
 
+	/* Everything but the area outside of the arc is opaque */
+	if (ctx->fill_color[3] > 0.999f && ctx->border_color[3] > 0.999f) {
+		int ri = ceil(r);
+		int x = ctx->corner == LAB_CORNER_TOP_LEFT ? ri : 0;
+		pixman_region32_union_rect(&buffer->opaque_region,
+			&buffer->opaque_region, x, 0, w - ri, h);
+		pixman_region32_union_rect(&buffer->opaque_region,
+			&buffer->opaque_region, 0, ri, w, h - ri);
+	}
+
 	return buffer;
 }
 
+/*
+ * Solid parts of the decorations are wlr_scene_rects, which the renderer
+ * draws without any buffer. Only shapes the wlroots 0.17 render pass
+ * cannot express (it draws rectangles and textures only), i.e. rounded
+ * corners and shadow gradients, are rasterized with cairo. They are
+ * small, rendered once per theme and scale, and uploaded once as shared
+ * textures, so drawing them on the GPU would not save anything.
+ */
+struct scaled_corners {
+	double scale;
+	struct lab_data_buffer *buffers[THEME_CORNER_COUNT];
+};
+
 static void
-create_corners(struct theme *theme)
+render_corners(struct theme *theme, double scale,
+		struct lab_data_buffer *buffers[static THEME_CORNER_COUNT])
 {
 	struct wlr_box box = {
 		.x = 0,
@@ -1066,74 +1261,149 @@ create_corners(struct theme *theme)
 		.fill_color = theme->window_active_title_bg_color,
 		.border_color = theme->window_active_border_color,
 		.corner = LAB_CORNER_TOP_LEFT,
+		.scale = scale,
 	};
-	theme->corner_top_left_active_normal = rounded_rect(&ctx);
+	buffers[THEME_CORNER_TOP_LEFT_ACTIVE] = rounded_rect(&ctx);
 
 	ctx.fill_color = theme->window_inactive_title_bg_color,
 	ctx.border_color = theme->window_inactive_border_color,
-	theme->corner_top_left_inactive_normal = rounded_rect(&ctx);
+	buffers[THEME_CORNER_TOP_LEFT_INACTIVE] = rounded_rect(&ctx);
 
 	ctx.corner = LAB_CORNER_TOP_RIGHT;
 	ctx.fill_color = theme->window_active_title_bg_color,
 	ctx.border_color = theme->window_active_border_color,
-	theme->corner_top_right_active_normal = rounded_rect(&ctx);
+	buffers[THEME_CORNER_TOP_RIGHT_ACTIVE] = rounded_rect(&ctx);
 
 	ctx.fill_color = theme->window_inactive_title_bg_color,
 	ctx.border_color = theme->window_inactive_border_color,
-	theme->corner_top_right_inactive_normal = rounded_rect(&ctx);
+	buffers[THEME_CORNER_TOP_RIGHT_INACTIVE] = rounded_rect(&ctx);
+}
+
+static void
+create_corners(struct theme *theme)
+{
+	struct lab_data_buffer *buffers[THEME_CORNER_COUNT];
+	render_corners(theme, 1, buffers);
+	theme->corner_top_left_active_normal =
+		buffers[THEME_CORNER_TOP_LEFT_ACTIVE];
+	theme->corner_top_left_inactive_normal =
+		buffers[THEME_CORNER_TOP_LEFT_INACTIVE];
+	theme->corner_top_right_active_normal =
+		buffers[THEME_CORNER_TOP_RIGHT_ACTIVE];
+	theme->corner_top_right_inactive_normal =
+		buffers[THEME_CORNER_TOP_RIGHT_INACTIVE];
+	wl_array_init(&theme->scaled_corners);
+}
+
+struct lab_data_buffer *
+theme_get_corner(struct theme *theme, enum theme_corner corner, double scale)
+{
+	assert(corner < THEME_CORNER_COUNT);
+	if (scale == 1) {
+		struct lab_data_buffer *buffers[THEME_CORNER_COUNT] = {
+			[THEME_CORNER_TOP_LEFT_ACTIVE] =
+				theme->corner_top_left_active_normal,
+			[THEME_CORNER_TOP_RIGHT_ACTIVE] =
+				theme->corner_top_right_active_normal,
+			[THEME_CORNER_TOP_LEFT_INACTIVE] =
+				theme->corner_top_left_inactive_normal,
+			[THEME_CORNER_TOP_RIGHT_INACTIVE] =
+				theme->corner_top_right_inactive_normal,
+		};
+		return buffers[corner];
+	}
+
+	struct scaled_corners *corners;
+	wl_array_for_each(corners, &theme->scaled_corners) {
+		if (corners->scale == scale) {
+			return corners->buffers[corner];
+		}
+	}
+
+	/* First view shown at this scale, render all corners for it */
+	corners = wl_array_add(&theme->scaled_corners, sizeof(*corners));
+	if (!corners) {
+		return NULL;
+	}
+	corners->scale = scale;
+	render_corners(theme, scale, corners->buffers);
+	for (size_t i = 0; i < THEME_CORNER_COUNT; i++) {
+		if (corners->buffers[i]) {
+			buffer_share_texture(&corners->buffers[i]->base,
+				theme->renderer);
+		}
+	}
+	return corners->buffers[corner];
 }
 
 /*
- * Draw the buffer used to render the edges of window drop-shadows. The buffer
- * is 1 pixel tall and `visible_size` pixels wide and can be rotated and scaled for the
- * different edges.  The buffer is drawn as would be found at the right-hand
- * edge of a window. The gradient has a color of `start_color` at its left edge
- * fading to clear at its right edge.
+ * Gaussian drop-off along one axis of a shadow, sampled at each pixel
+ * offset from the window edge. The 2d corner gradient is the outer
+ * product of this profile with itself, so exp() is only evaluated
+ * total_size times per buffer.
  */
-static void
-shadow_edge_gradient(struct lab_data_buffer *buffer,
-		int visible_size, int total_size, float start_color[4])
+static double *
+shadow_profile(int total_size)
 {
-	if (!buffer) {
-		/* This type of shadow is disabled, do nothing */
-		return;
+	/* Standard deviation normalised against the shadow width, squared */
+	double variance = 0.3 * 0.3;
+
+	double *profile = znew_n(*profile, total_size);
+	for (int i = 0; i < total_size; i++) {
+		/* i normalised against total shadow width */
+		double norm = (double)i / (double)total_size;
+		profile[i] = exp(-(norm * norm) / variance);
 	}
+	return profile;
+}
 
-	assert(buffer->format == DRM_FORMAT_ARGB8888);
-	uint8_t *pixels = buffer->data;
+/*
+ * Shadows are a single color with varying alpha, so their shape is
+ * computed once as an 8-bit alpha mask per size and then colored in. The
+ * masks only live while the buffers are created.
+ */
+struct shadow_mask {
+	int width, height;
+	uint8_t *alpha;
+};
+
+/*
+ * Compute the mask used to render the edges of window drop-shadows. The
+ * mask is 1 pixel tall and `visible_size` pixels wide and can be rotated
+ * and scaled for the different edges. It is laid out as would be found at
+ * the right-hand edge of a window and fades from opaque at its left edge
+ * to clear at its right edge.
+ */
+static void
+shadow_edge_mask(struct shadow_mask *mask, int visible_size, int total_size)
+{
+	mask->width = visible_size;
+	mask->height = 1;
+	mask->alpha = znew_n(*mask->alpha, visible_size);
 
 	/* Inset portion which is obscured */
 	int inset = total_size - visible_size;
 
-	/* Standard deviation normalised against the shadow width, squared */
-	double variance = 0.3 * 0.3;
+	double *profile = shadow_profile(total_size);
 
 	for (int x = 0; x < visible_size; x++) {
 		/*
-		 * x normalised against total shadow width. We add on inset here
-		 * because we don't bother drawing inset for the edge shadow
-		 * buffers but still need the pattern to line up with the corner
-		 * shadow buffers which do have inset drawn.
+		 * We add on inset here because we don't bother drawing inset
+		 * for the edge shadow buffers but still need the pattern to
+		 * line up with the corner shadow buffers which do have inset
+		 * drawn.
 		 */
-		double xn = (double)(x + inset) / (double)total_size;
-
-		/* Gausian dropoff */
-		double alpha = exp(-(xn * xn) / variance);
-
-		/* RGBA values are all pre-multiplied */
-		pixels[4 * x] = start_color[2] * alpha * 255;
-		pixels[4 * x + 1] = start_color[1] * alpha * 255;
-		pixels[4 * x + 2] = start_color[0] * alpha * 255;
-		pixels[4 * x + 3] = start_color[3] * alpha * 255;
+		mask->alpha[x] = profile[x + inset] * 255;
 	}
+	free(profile);
 }
 
 /*
- * Draw the buffer used to render the corners of window drop-shadows.  The
- * shadow looks better if the buffer is inset behind the window, so the buffer
- * is square with a size of radius+inset.  The buffer is drawn for the
- * bottom-right corner but can be rotated for other corners.  The gradient fades
- * from `start_color` at the top-left to clear at the opposite edge.
+ * Compute the mask used to render the corners of window drop-shadows. The
+ * shadow looks better if the buffer is inset behind the window, so the mask
+ * is square with a size of radius+inset. It is laid out for the
+ * bottom-right corner but can be rotated for other corners and fades from
+ * opaque at the top-left to clear at the opposite edge.
  *
  * If the window is translucent we don't want the shadow to be visible through
  * it.  For the bottom corners of the window this is easy, we just erase the
@@ -1144,37 +1414,20 @@ shadow_edge_gradient(struct lab_data_buffer *buffer,
  * the window.
  */
 static void
-shadow_corner_gradient(struct lab_data_buffer *buffer, int visible_size,
-	int total_size, int titlebar_height, float start_color[4])
+shadow_corner_mask(struct shadow_mask *mask, int visible_size,
+		int total_size, int titlebar_height)
 {
-	if (!buffer) {
-		/* This type of shadow is disabled, do nothing */
-		return;
-	}
-
-	assert(buffer->format == DRM_FORMAT_ARGB8888);
-	uint8_t *pixels = buffer->data;
-
-	/* Standard deviation normalised against the shadow width, squared */
-	double variance = 0.3 * 0.3;
+	mask->width = total_size;
+	mask->height = total_size;
+	mask->alpha = znew_n(*mask->alpha, total_size * total_size);
 
 	int inset = total_size - visible_size;
 
+	double *profile = shadow_profile(total_size);
+
 	for (int y = 0; y < total_size; y++) {
-		uint8_t *pixel_row = &pixels[y * buffer->stride];
+		uint8_t *row = &mask->alpha[y * total_size];
 		for (int x = 0; x < total_size; x++) {
-			/* x and y normalised against total shadow width */
-			double x_norm = (double)(x) / (double)total_size;
-			double y_norm = (double)(y) / (double)total_size;
-			/*
-			 * For Gaussian drop-off in 2d you can just calculate
-			 * the outer product of the horizontal and vertical
-			 * profiles.
-			 */
-			double gauss_x = exp(-(x_norm * x_norm) / variance);
-			double gauss_y = exp(-(y_norm * y_norm) / variance);
-			double alpha = gauss_x * gauss_y;
-
 			/*
 			 * Erase the L-shaped region which could be visible
 			 * through a transparent window but not obscured by the
@@ -1185,81 +1438,100 @@ shadow_corner_gradient(struct lab_data_buffer *buffer, int visible_size,
 			bool in1 = x < inset && y < inset - titlebar_height;
 			bool in2 = x < inset - titlebar_height && y < inset;
 			if (in1 || in2) {
-				alpha = 0.0;
+				continue;
 			}
 
-			/* RGBA values are all pre-multiplied */
-			pixel_row[4 * x] = start_color[2] * alpha * 255;
-			pixel_row[4 * x + 1] = start_color[1] * alpha * 255;
-			pixel_row[4 * x + 2] = start_color[0] * alpha * 255;
-			pixel_row[4 * x + 3] = start_color[3] * alpha * 255;
+			/*
+			 * For Gaussian drop-off in 2d you can just calculate
+			 * the outer product of the horizontal and vertical
+			 * profiles.
+			 */
+			row[x] = profile[x] * profile[y] * 255;
 		}
 	}
+	free(profile);
 }
 
-static void
-create_shadows(struct theme *theme)
+/* Create a buffer filled with `color` (pre-multiplied) weighted by `mask` */
+static struct lab_data_buffer *
+shadow_buffer_from_mask(const struct shadow_mask *mask, const float color[4])
+{
+	struct lab_data_buffer *buffer = buffer_create_cairo(
+		mask->width, mask->height, 1.0, true);
+	if (!buffer) {
+		return NULL;
+	}
+	assert(buffer->format == DRM_FORMAT_ARGB8888);
+
+	/* Same for every pixel, so only converted once */
+	uint8_t bgra[4] = {
+		color[2] * 255, color[1] * 255, color[0] * 255, color[3] * 255,
+	};
+	for (int y = 0; y < mask->height; y++) {
+		uint8_t *pixel_row = (uint8_t *)buffer->data + y * buffer->stride;
+		const uint8_t *alpha = &mask->alpha[y * mask->width];
+		for (int x = 0; x < mask->width; x++) {
+			for (int i = 0; i < 4; i++) {
+				pixel_row[4 * x + i] = bgra[i] * alpha[x] / 255;
+			}
+		}
+	}
+	return buffer;
+}
+
+static bool
+create_shadow_buffers(int visible_size, int titlebar_height,
+		const float color[4], struct lab_data_buffer **edge,
+		struct lab_data_buffer **corner_top,
+		struct lab_data_buffer **corner_bottom)
 {
-	/* Size of shadow visible extending beyond the window */
-	int visible_active_size = theme->window_active_shadow_size;
-	int visible_inactive_size = theme->window_inactive_shadow_size;
+	if (visible_size <= 0) {
+		/* This type of shadow is disabled, do nothing */
+		return true;
+	}
 	/* How far inside the window the shadow inset begins */
-	int inset_active = (double)visible_active_size * SSD_SHADOW_INSET;
-	int inset_inactive = (double)visible_inactive_size * SSD_SHADOW_INSET;
+	int inset = (double)visible_size * SSD_SHADOW_INSET;
 	/* Total width including visible and obscured portion */
-	int total_active_size = visible_active_size + inset_active;
-	int total_inactive_size = visible_inactive_size + inset_inactive;
+	int total_size = visible_size + inset;
 
 	/*
 	 * Edge shadows don't need to be inset so the buffers are sized just for
 	 * the visible width.  Corners are inset so the buffers are larger for
 	 * this.
 	 */
-	if (visible_active_size > 0) {
-		theme->shadow_edge_active = buffer_create_cairo(
-			visible_active_size, 1, 1.0, true);
-		theme->shadow_corner_top_active = buffer_create_cairo(
-			total_active_size, total_active_size, 1.0, true);
-		theme->shadow_corner_bottom_active = buffer_create_cairo(
-			total_active_size, total_active_size, 1.0, true);
-		if (!theme->shadow_corner_top_active
-				|| !theme->shadow_corner_bottom_active
-				|| !theme->shadow_edge_active) {
-			wlr_log(WLR_ERROR, "Failed to allocate shadow buffer");
-			return;
-		}
-	}
-	if (visible_inactive_size > 0) {
-		theme->shadow_edge_inactive = buffer_create_cairo(
-			visible_inactive_size, 1, 1.0, true);
-		theme->shadow_corner_top_inactive = buffer_create_cairo(
-			total_inactive_size, total_inactive_size, 1.0, true);
-		theme->shadow_corner_bottom_inactive = buffer_create_cairo(
-			total_inactive_size, total_inactive_size, 1.0, true);
-		if (!theme->shadow_corner_top_inactive
-				|| !theme->shadow_corner_bottom_inactive
-				|| !theme->shadow_edge_inactive) {
-			wlr_log(WLR_ERROR, "Failed to allocate shadow buffer");
-			return;
-		}
-	}
+	struct shadow_mask mask;
+	shadow_edge_mask(&mask, visible_size, total_size);
+	*edge = shadow_buffer_from_mask(&mask, color);
+	free(mask.alpha);
 
-	shadow_edge_gradient(theme->shadow_edge_active, visible_active_size,
-		total_active_size, theme->window_active_shadow_color);
-	shadow_edge_gradient(theme->shadow_edge_inactive, visible_inactive_size,
-		total_inactive_size, theme->window_inactive_shadow_color);
-	shadow_corner_gradient(theme->shadow_corner_top_active,
-		visible_active_size, total_active_size,
-		theme->title_height, theme->window_active_shadow_color);
-	shadow_corner_gradient(theme->shadow_corner_bottom_active,
-		visible_active_size, total_active_size, 0,
-		theme->window_active_shadow_color);
-	shadow_corner_gradient(theme->shadow_corner_top_inactive,
-		visible_inactive_size, total_inactive_size,
-		theme->title_height, theme->window_inactive_shadow_color);
-	shadow_corner_gradient(theme->shadow_corner_bottom_inactive,
-		visible_inactive_size, total_inactive_size, 0,
-		theme->window_inactive_shadow_color);
+	shadow_corner_mask(&mask, visible_size, total_size, titlebar_height);
+	*corner_top = shadow_buffer_from_mask(&mask, color);
+	free(mask.alpha);
+
+	shadow_corner_mask(&mask, visible_size, total_size, 0);
+	*corner_bottom = shadow_buffer_from_mask(&mask, color);
+	free(mask.alpha);
+
+	return *edge && *corner_top && *corner_bottom;
+}
+
+static void
+create_shadows(struct theme *theme)
+{
+	if (!create_shadow_buffers(theme->window_active_shadow_size,
+			theme->title_height, theme->window_active_shadow_color,
+			&theme->shadow_edge_active,
+			&theme->shadow_corner_top_active,
+			&theme->shadow_corner_bottom_active)
+			|| !create_shadow_buffers(
+				theme->window_inactive_shadow_size,
+				theme->title_height,
+				theme->window_inactive_shadow_color,
+				&theme->shadow_edge_inactive,
+				&theme->shadow_corner_top_inactive,
+				&theme->shadow_corner_bottom_inactive)) {
+		wlr_log(WLR_ERROR, "Failed to allocate shadow buffer");
+	}
 }
 
 static void
@@ -1270,6 +1542,28 @@ fill_colors_with_osd_theme(struct theme *theme, float colors[3][4])
 	memcpy(colors[2], theme->osd_bg_color, sizeof(colors[2]));
 }
 
+static void
+make_opaque(float *color)
+{
+	/* Colors are premultiplied, see parse_hexstr() */
+	if (color[3] > 0.0f) {
+		for (int i = 0; i < 3; i++) {
+			color[i] /= color[3];
+		}
+	}
+	color[3] = 1.0f;
+}
+
+static void
+apply_reduced_effects(struct theme *theme)
+{
+	rc.shadows_enabled = false;
+	rc.corner_radius = 0;
+	rc.window_switcher.preview = false;
+	make_opaque(theme->osd_bg_color);
+	make_opaque(theme->osd_border_color);
+}
+
 static void
 post_processing(struct theme *theme)
 {
@@ -1358,6 +1652,62 @@ post_processing(struct theme *theme)
 	}
 }
 
+/*
+ * Every decorated view shows the same button, corner and shadow buffers.
+ * Upload each of them only once instead of once per scene node.
+ */
+static void
+share_textures(struct theme *theme, struct wlr_renderer *renderer)
+{
+	struct lab_data_buffer *buffers[] = {
+		theme->button_close_active_unpressed,
+		theme->button_maximize_active_unpressed,
+		theme->button_restore_active_unpressed,
+		theme->button_iconify_active_unpressed,
+		theme->button_menu_active_unpressed,
+		theme->button_close_inactive_unpressed,
+		theme->button_maximize_inactive_unpressed,
+		theme->button_restore_inactive_unpressed,
+		theme->button_iconify_inactive_unpressed,
+		theme->button_menu_inactive_unpressed,
+		theme->button_close_active_hover,
+		theme->button_maximize_active_hover,
+		theme->button_restore_active_hover,
+		theme->button_iconify_active_hover,
+		theme->button_menu_active_hover,
+		theme->button_close_inactive_hover,
+		theme->button_maximize_inactive_hover,
+		theme->button_restore_inactive_hover,
+		theme->button_iconify_inactive_hover,
+		theme->button_menu_inactive_hover,
+		theme->corner_top_left_active_normal,
+		theme->corner_top_right_active_normal,
+		theme->corner_top_left_inactive_normal,
+		theme->corner_top_right_inactive_normal,
+	};
+	for (size_t i = 0; i < ARRAY_SIZE(buffers); i++) {
+		if (buffers[i]) {
+			buffer_share_texture(&buffers[i]->base, renderer);
+		}
+	}
+
+	/*
+	 * Shadows are only ever shown through their shared textures, so
+	 * their pixels are not kept around once uploaded.
+	 */
+	struct lab_data_buffer *shadows[] = {
+		theme->shadow_corner_top_active,
+		theme->shadow_corner_bottom_active,
+		theme->shadow_edge_active,
+		theme->shadow_corner_top_inactive,
+		theme->shadow_corner_bottom_inactive,
+		theme->shadow_edge_inactive,
+	};
+	for (size_t i = 0; i < ARRAY_SIZE(shadows); i++) {
+		buffer_share_texture_only(shadows[i], renderer);
+	}
+}
+
 void
 theme_init(struct theme *theme, struct server *server, const char *theme_name)
 {
@@ -1379,9 +1729,21 @@ theme_init(struct theme *theme, struct server *server, const char *theme_name)
 	paths_destroy(&paths);
 
 	post_processing(theme);
+	if (reduced_effects(server)) {
+		apply_reduced_effects(theme);
+	}
 	create_corners(theme);
 	load_buttons(theme);
 	create_shadows(theme);
+	theme->renderer = server->renderer;
+	share_textures(theme, server->renderer);
+}
+
+bool
+theme_settings_equal(const struct theme *a, const struct theme *b)
+{
+	/* The settings are the plain values before the first texture */
+	return !memcmp(a, b, offsetof(struct theme, button_close_active_unpressed));
 }
 
 void
@@ -1391,6 +1753,22 @@ theme_finish(struct theme *theme)
 	zdrop(&theme->corner_top_left_inactive_normal);
 	zdrop(&theme->corner_top_right_active_normal);
 	zdrop(&theme->corner_top_right_inactive_normal);
+	struct scaled_corners *corners;
+	wl_array_for_each(corners, &theme->scaled_corners) {
+		for (size_t i = 0; i < THEME_CORNER_COUNT; i++) {
+			zdrop(&corners->buffers[i]);
+		}
+	}
+	wl_array_release(&theme->scaled_corners);
+	wl_array_init(&theme->scaled_corners);
+	struct scaled_button *scaled;
+	wl_array_for_each(scaled, &theme->scaled_buttons) {
+		zdrop(&scaled->buffer);
+	}
+	wl_array_release(&theme->scaled_buttons);
+	wl_array_init(&theme->scaled_buttons);
+	wl_array_release(&theme->scalable_buttons);
+	wl_array_init(&theme->scalable_buttons);
 	zdrop(&theme->shadow_corner_top_active);
 	zdrop(&theme->shadow_corner_bottom_active);
 	zdrop(&theme->shadow_edge_active);
@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <assert.h>
+#include <wlr/util/log.h>
+#include "common/macros.h"
+#include "common/time-helpers.h"
+#include "labwc.h"
+#include "transaction.h"
+#include "view.h"
+
+#define TRANSACTION_TIMEOUT_MS 200
+/* Limit for transactions extended by further ones, e.g. with key repeat */
+#define TRANSACTION_MAX_HOLD_MS 500
+
+static void
+transaction_apply(struct server *server)
+{
+	struct transaction *txn = &server->transaction;
+	if (txn->timeout) {
+		wl_event_source_remove(txn->timeout);
+		txn->timeout = NULL;
+	}
+	txn->nr_pending = 0;
+	txn->hold_start_nsec = 0;
+
+	struct view *view;
+	wl_list_for_each(view, &server->views, link) {
+		view->transaction_pending = false;
+	}
+
+	/* Present the complete layout */
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (output_is_usable(output)) {
+			wlr_output_schedule_frame(output->wlr_output);
+		}
+	}
+}
+
+static int
+handle_transaction_timeout(void *data)
+{
+	struct server *server = data;
+	wlr_log(WLR_DEBUG, "transaction timed out with %d view(s) pending",
+		server->transaction.nr_pending);
+	transaction_apply(server);
+	return 0; /* ignored per wl_event_loop docs */
+}
+
+void
+transaction_begin(struct server *server)
+{
+	server->transaction.depth++;
+}
+
+void
+transaction_end(struct server *server)
+{
+	struct transaction *txn = &server->transaction;
+	assert(txn->depth > 0);
+	if (--txn->depth > 0) {
+		return;
+	}
+
+	/* Wait for every view which has been sent a new size meanwhile */
+	bool added = false;
+	struct view *view;
+	wl_list_for_each(view, &server->views, link) {
+		if (!view->transaction_configured) {
+			continue;
+		}
+		view->transaction_configured = false;
+		if (view->mapped && view->pending_configure_timeout
+				&& !view->transaction_pending) {
+			view->transaction_pending = true;
+			txn->nr_pending++;
+			added = true;
+		}
+	}
+	if (!added) {
+		return;
+	}
+
+	int64_t now = time_now_nsec();
+	if (!txn->hold_start_nsec) {
+		txn->hold_start_nsec = now;
+	}
+	int held_ms = (now - txn->hold_start_nsec) / 1000000;
+	int timeout_ms = MIN(TRANSACTION_TIMEOUT_MS,
+		TRANSACTION_MAX_HOLD_MS - held_ms);
+	if (timeout_ms <= 0) {
+		transaction_apply(server);
+		return;
+	}
+
+	if (!txn->timeout) {
+		txn->timeout = wl_event_loop_add_timer(server->wl_event_loop,
+			handle_transaction_timeout, server);
+	}
+	wl_event_source_timer_update(txn->timeout, timeout_ms);
+}
+
+void
+transaction_view_configured(struct view *view)
+{
+	if (view->server->transaction.depth > 0) {
+		view->transaction_configured = true;
+	}
+}
+
+static void
+remove_view(struct view *view)
+{
+	view->transaction_pending = false;
+
+	struct server *server = view->server;
+	assert(server->transaction.nr_pending > 0);
+	if (--server->transaction.nr_pending == 0) {
+		transaction_apply(server);
+	}
+}
+
+void
+transaction_view_ready(struct view *view)
+{
+	if (view->transaction_pending && !view->pending_configure_timeout) {
+		remove_view(view);
+	}
+}
+
+void
+transaction_view_destroy(struct view *view)
+{
+	view->transaction_configured = false;
+	if (view->transaction_pending) {
+		remove_view(view);
+	}
+}
+
+bool
+transaction_is_blocking(struct server *server)
+{
+	return server->transaction.nr_pending > 0;
+}
+
+void
+transaction_finish(struct server *server)
+{
+	if (server->transaction.timeout) {
+		wl_event_source_remove(server->transaction.timeout);
+		server->transaction.timeout = NULL;
+	}
+}
@@ -3,7 +3,11 @@
 #include <stdio.h>
 #include <strings.h>
 #include "common/list.h"
+#include "edges.h"
+#include "flight-recorder.h"
 #include "labwc.h"
+#include "placement.h"
+#include "surface-map.h"
 #include "view.h"
 #include "view-impl-common.h"
 #include "window-rules.h"
@@ -11,22 +15,25 @@
 void
 view_impl_move_to_front(struct view *view)
 {
-	wl_list_remove(&view->link);
-	wl_list_insert(&view->server->views, &view->link);
+	view_stack_raise(view);
 	wlr_scene_node_raise_to_top(&view->scene_tree->node);
 }
 
 void
 view_impl_move_to_back(struct view *view)
 {
-	wl_list_remove(&view->link);
-	wl_list_append(&view->server->views, &view->link);
+	view_stack_lower(view);
 	wlr_scene_node_lower_to_bottom(&view->scene_tree->node);
 }
 
 void
 view_impl_map(struct view *view)
 {
+	flight_record(FLIGHT_EVENT_VIEW_MAP, 0, (uintptr_t)view, 0);
+	view_update_family(view);
+	surface_map_add_view(view);
+	view_stack_update_mapped(view);
+	view_focus_history_add(view);
 	desktop_focus_view(view, /*raise*/ true);
 	view_update_title(view);
 	view_update_app_id(view);
@@ -39,7 +46,8 @@ view_impl_map(struct view *view)
 	 * map handlers, but the app_id/title might not have been set at that
 	 * point, so it's safer to process the property here
 	 */
-	enum property ret = window_rules_get_property(view, "skipTaskbar");
+	enum property ret = window_rules_get_property(view,
+		LAB_WINDOW_RULE_PROP_SKIP_TASKBAR);
 	if (ret == LAB_PROP_TRUE) {
 		if (view->toplevel.handle) {
 			wlr_foreign_toplevel_handle_v1_destroy(view->toplevel.handle);
@@ -51,6 +59,8 @@ view_impl_map(struct view *view)
 	 * fullscreen before mapping.
 	 */
 	desktop_update_top_layer_visiblity(view->server);
+	desktop_update_occlusion(view->server);
+	edges_invalidate_view(view);
 
 	wlr_log(WLR_DEBUG, "[map] identifier=%s, title=%s\n",
 		view_get_string_prop(view, "app_id"),
@@ -61,12 +71,19 @@ void
 view_impl_unmap(struct view *view)
 {
 	struct server *server = view->server;
+	flight_record(FLIGHT_EVENT_VIEW_UNMAP, 0, (uintptr_t)view, 0);
+	placement_memory_record(view);
+	view_stack_update_mapped(view);
+	view_focus_history_remove(view);
 	if (view == server->active_view) {
 		desktop_focus_topmost_view(server);
 	}
 	if (view == server->last_raised_view) {
 		server->last_raised_view = NULL;
 	}
+	desktop_update_occlusion(server);
+	edges_invalidate_view(view);
+	surface_map_remove_view(view);
 }
 
 static bool
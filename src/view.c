@@ -2,11 +2,14 @@
 #include <assert.h>
 #include <stdio.h>
 #include <strings.h>
+#include <wlr/types/wlr_content_type_v1.h>
 #include <wlr/types/wlr_output_layout.h>
 #include "common/macros.h"
 #include "common/match.h"
 #include "common/mem.h"
 #include "common/scene-helpers.h"
+#include "common/trace.h"
+#include "edges.h"
 #include "input/keyboard.h"
 #include "labwc.h"
 #include "menu/menu.h"
@@ -14,9 +17,12 @@
 #include "placement.h"
 #include "regions.h"
 #include "resize_indicator.h"
+#include "scale-debounce.h"
 #include "snap-constraints.h"
 #include "snap.h"
 #include "ssd.h"
+#include "surface-map.h"
+#include "transaction.h"
 #include "view.h"
 #include "window-rules.h"
 #include "workspaces.h"
@@ -33,6 +39,14 @@ struct view *
 view_from_wlr_surface(struct wlr_surface *surface)
 {
 	assert(surface);
+
+	/* Fast path for mapped views */
+	bool is_main = false;
+	struct view *view = surface_map_get_view(surface, &is_main);
+	if (is_main) {
+		return view;
+	}
+
 	/*
 	 * TODO:
 	 * - find a way to get rid of xdg/xwayland-specific stuff
@@ -62,25 +76,115 @@ view_query_free(struct view_query *query)
 	free(query);
 }
 
-bool
-view_matches_query(struct view *view, struct view_query *query)
+/*
+ * View queries are numbered on first use to index the per-view result
+ * bitmaps. The numbering starts over with a new generation whenever the
+ * queries are replaced on reconfigure.
+ */
+static struct {
+	uint32_t generation; /* never zero */
+	uint32_t nr_queries;
+} queries = { .generation = 1 };
+
+void
+view_queries_reset(void)
+{
+	queries.generation++;
+	if (!queries.generation) {
+		queries.generation++;
+	}
+	queries.nr_queries = 0;
+}
+
+static void
+view_query_compile(struct view_query *query)
+{
+	if (query->generation == queries.generation) {
+		return;
+	}
+	if (query->identifier) {
+		match_pattern_compile(&query->identifier_match, query->identifier);
+	}
+	if (query->title) {
+		match_pattern_compile(&query->title_match, query->title);
+	}
+	query->generation = queries.generation;
+	query->index = queries.nr_queries++;
+}
+
+static void
+view_query_cache_invalidate(struct view *view)
+{
+	struct view_query_cache *cache = &view->queries;
+	for (size_t w = 0; w < cache->nr_words; w++) {
+		cache->known[w] = 0;
+	}
+}
+
+static void
+view_query_cache_finish(struct view *view)
+{
+	zfree(view->queries.known);
+	zfree(view->queries.matches);
+	view->queries.nr_words = 0;
+}
+
+static bool
+query_matches(struct view *view, struct view_query *query)
 {
-	bool match = true;
 	bool empty = true;
 
-	const char *identifier = view_get_string_prop(view, "app_id");
-	if (match && query->identifier) {
+	if (query->identifier) {
 		empty = false;
-		match &= match_glob(query->identifier, identifier);
+		const char *identifier = view_get_string_prop(view, "app_id");
+		if (!identifier || !match_pattern(&query->identifier_match, identifier)) {
+			return false;
+		}
 	}
 
-	const char *title = view_get_string_prop(view, "title");
-	if (match && query->title) {
+	if (query->title) {
 		empty = false;
-		match &= match_glob(query->title, title);
+		const char *title = view_get_string_prop(view, "title");
+		if (!title || !match_pattern(&query->title_match, title)) {
+			return false;
+		}
 	}
 
-	return !empty && match;
+	return !empty;
+}
+
+bool
+view_matches_query(struct view *view, struct view_query *query)
+{
+	view_query_compile(query);
+
+	struct view_query_cache *cache = &view->queries;
+	if (cache->generation != queries.generation) {
+		view_query_cache_invalidate(view);
+		cache->generation = queries.generation;
+	}
+
+	size_t word = query->index / 64;
+	uint64_t bit = 1ull << (query->index % 64);
+	if (word >= cache->nr_words) {
+		size_t nr_words = (queries.nr_queries + 63) / 64;
+		cache->known = xrealloc(cache->known, nr_words * sizeof(uint64_t));
+		cache->matches = xrealloc(cache->matches, nr_words * sizeof(uint64_t));
+		for (size_t w = cache->nr_words; w < nr_words; w++) {
+			cache->known[w] = 0;
+		}
+		cache->nr_words = nr_words;
+	}
+
+	if (!(cache->known[word] & bit)) {
+		cache->known[word] |= bit;
+		if (query_matches(view, query)) {
+			cache->matches[word] |= bit;
+		} else {
+			cache->matches[word] &= ~bit;
+		}
+	}
+	return cache->matches[word] & bit;
 }
 
 static bool
@@ -95,7 +199,8 @@ matches_criteria(struct view *view, enum lab_view_criteria criteria)
 		 * special in that they live in a different tree.
 		 */
 		struct server *server = view->server;
-		if (view->scene_tree->node.parent != server->workspace_current->tree
+		if (view->scene_tree->node.parent
+					!= server->workspace_current->tree
 				&& !view_is_always_on_top(view)) {
 			return false;
 		}
@@ -121,18 +226,248 @@ matches_criteria(struct view *view, enum lab_view_criteria criteria)
 		}
 	}
 	if (criteria & LAB_VIEW_CRITERIA_NO_SKIP_WINDOW_SWITCHER) {
-		if (window_rules_get_property(view, "skipWindowSwitcher") == LAB_PROP_TRUE) {
+		if (window_rules_get_property(view,
+				LAB_WINDOW_RULE_PROP_SKIP_WINDOW_SWITCHER)
+				== LAB_PROP_TRUE) {
 			return false;
 		}
 	}
 	return true;
 }
 
+/*
+ * Besides server->views, each view is kept in the list of its workspace (or
+ * server->views_always_on_top) and in the list of its output. All lists are
+ * in the same order, which is recorded in view->stack_seq: it decreases
+ * along server->views, so a view raised to the front gets the highest value
+ * handed out so far and a view lowered to the back the lowest.
+ */
+static void
+insert_workspace_link(struct wl_list *list, struct view *view)
+{
+	struct view *v;
+	wl_list_for_each(v, list, workspace_link) {
+		if (v->stack_seq < view->stack_seq) {
+			break;
+		}
+	}
+	/* Insert before v, or at the end of the list if none was found */
+	wl_list_insert(v->workspace_link.prev, &view->workspace_link);
+}
+
+static void
+insert_mapped_link(struct wl_list *list, struct view *view)
+{
+	struct view *v;
+	wl_list_for_each(v, list, mapped_link) {
+		if (v->stack_seq < view->stack_seq) {
+			break;
+		}
+	}
+	wl_list_insert(v->mapped_link.prev, &view->mapped_link);
+}
+
+static void
+insert_output_link(struct wl_list *list, struct view *view)
+{
+	struct view *v;
+	wl_list_for_each(v, list, output_link) {
+		if (v->stack_seq < view->stack_seq) {
+			break;
+		}
+	}
+	wl_list_insert(v->output_link.prev, &view->output_link);
+}
+
+/* Keep view->workspace_link in sync after a workspace or tree change */
+static void
+update_workspace_link(struct view *view)
+{
+	struct wl_list *list = NULL;
+	if (view_is_always_on_top(view)) {
+		list = &view->server->views_always_on_top;
+	} else if (!view_is_always_on_bottom(view)) {
+		list = &view->workspace->views;
+	}
+	if (list != view->workspace_list) {
+		wl_list_remove(&view->workspace_link);
+		wl_list_init(&view->workspace_link);
+		view->workspace_list = list;
+		if (list) {
+			insert_workspace_link(list, view);
+		}
+	}
+	view_stack_update_mapped(view);
+}
+
+/*
+ * Mapped views in a workspace list are also in the mapped_views list of
+ * that workspace, which lets desktop_topmost_focusable_view() skip
+ * unmapped and minimized views.
+ */
+void
+view_stack_update_mapped(struct view *view)
+{
+	struct wl_list *list = NULL;
+	if (view->mapped && view->workspace_list == &view->workspace->views) {
+		list = &view->workspace->mapped_views;
+	}
+	if (list == view->mapped_list) {
+		return;
+	}
+	wl_list_remove(&view->mapped_link);
+	wl_list_init(&view->mapped_link);
+	view->mapped_list = list;
+	if (list) {
+		insert_mapped_link(list, view);
+	}
+}
+
+static void
+set_output(struct view *view, struct output *output)
+{
+	if (view->output == output) {
+		return;
+	}
+	wl_list_remove(&view->output_link);
+	wl_list_init(&view->output_link);
+	view->output = output;
+	if (output) {
+		insert_output_link(&output->views, view);
+	}
+	osd_field_invalidate(view);
+}
+
+void
+view_stack_add(struct view *view)
+{
+	struct server *server = view->server;
+	view->stack_seq = ++server->view_stack_top;
+	wl_list_insert(&server->views, &view->link);
+	window_rules_view_add(view);
+	wl_list_init(&view->workspace_link);
+	wl_list_init(&view->output_link);
+	wl_list_init(&view->focus_link);
+	wl_list_init(&view->mapped_link);
+	wl_list_init(&view->family);
+	wl_list_init(&view->family_link);
+	update_workspace_link(view);
+	if (view->output) {
+		insert_output_link(&view->output->views, view);
+	}
+}
+
+void
+view_stack_raise(struct view *view)
+{
+	struct server *server = view->server;
+	view->stack_seq = ++server->view_stack_top;
+	wl_list_remove(&view->link);
+	wl_list_insert(&server->views, &view->link);
+	if (view->workspace_list) {
+		wl_list_remove(&view->workspace_link);
+		wl_list_insert(view->workspace_list, &view->workspace_link);
+	}
+	if (view->mapped_list) {
+		wl_list_remove(&view->mapped_link);
+		wl_list_insert(view->mapped_list, &view->mapped_link);
+	}
+	if (view->output) {
+		wl_list_remove(&view->output_link);
+		wl_list_insert(&view->output->views, &view->output_link);
+	}
+}
+
+void
+view_stack_lower(struct view *view)
+{
+	struct server *server = view->server;
+	view->stack_seq = --server->view_stack_bottom;
+	wl_list_remove(&view->link);
+	wl_list_append(&server->views, &view->link);
+	if (view->workspace_list) {
+		wl_list_remove(&view->workspace_link);
+		wl_list_append(view->workspace_list, &view->workspace_link);
+	}
+	if (view->mapped_list) {
+		wl_list_remove(&view->mapped_link);
+		wl_list_append(view->mapped_list, &view->mapped_link);
+	}
+	if (view->output) {
+		wl_list_remove(&view->output_link);
+		wl_list_append(&view->output->views, &view->output_link);
+	}
+}
+
+static void
+stack_remove(struct view *view)
+{
+	wl_list_remove(&view->link);
+	wl_list_remove(&view->workspace_link);
+	wl_list_remove(&view->output_link);
+	wl_list_remove(&view->focus_link);
+	wl_list_remove(&view->mapped_link);
+}
+
+/*
+ * Returns the first view in @list (linked through workspace_link) after
+ * @view in stacking order, or NULL. @view may or may not be in @list.
+ */
+static struct view *
+workspace_list_next(struct wl_list *list, struct view *view)
+{
+	struct wl_list *elm = list->next;
+	if (view && view->workspace_list == list) {
+		elm = view->workspace_link.next;
+	} else if (view) {
+		for (; elm != list; elm = elm->next) {
+			struct view *v = wl_container_of(elm, v, workspace_link);
+			if (v->stack_seq < view->stack_seq) {
+				break;
+			}
+		}
+	}
+	if (elm == list) {
+		return NULL;
+	}
+	struct view *next = wl_container_of(elm, next, workspace_link);
+	return next;
+}
+
+/*
+ * Views on the current workspace are those in its list and the always-on-top
+ * ones. Merge both lists by stacking order instead of filtering all views.
+ */
+static struct view *
+next_on_current_workspace(struct server *server, struct view *view,
+		enum lab_view_criteria criteria)
+{
+	struct wl_list *workspace = &server->workspace_current->views;
+	struct wl_list *always_on_top = &server->views_always_on_top;
+
+	do {
+		struct view *a = workspace_list_next(workspace, view);
+		struct view *b = workspace_list_next(always_on_top, view);
+		if (!a || (b && b->stack_seq > a->stack_seq)) {
+			a = b;
+		}
+		view = a;
+	} while (view && !matches_criteria(view, criteria));
+
+	return view;
+}
+
 struct view *
 view_next(struct wl_list *head, struct view *view, enum lab_view_criteria criteria)
 {
 	assert(head);
 
+	if (criteria & LAB_VIEW_CRITERIA_CURRENT_WORKSPACE) {
+		/* All callers iterate over server->views */
+		struct server *server = wl_container_of(head, server, views);
+		return next_on_current_workspace(server, view, criteria);
+	}
+
 	struct wl_list *elm = view ? &view->link : head;
 
 	for (elm = elm->next; elm != head; elm = elm->next) {
@@ -186,6 +521,90 @@ view_prev_no_head_stop(struct wl_list *head, struct view *from,
 	return from;
 }
 
+struct view *
+view_next_on_output(struct output *output, struct view *view,
+		enum lab_view_criteria criteria)
+{
+	assert(output);
+
+	struct wl_list *elm = output->views.next;
+	if (view && view->output == output) {
+		elm = view->output_link.next;
+	} else if (view) {
+		for (; elm != &output->views; elm = elm->next) {
+			struct view *v = wl_container_of(elm, v, output_link);
+			if (v->stack_seq < view->stack_seq) {
+				break;
+			}
+		}
+	}
+
+	for (; elm != &output->views; elm = elm->next) {
+		view = wl_container_of(elm, view, output_link);
+		if (matches_criteria(view, criteria)) {
+			return view;
+		}
+	}
+	return NULL;
+}
+
+void
+view_focus_history_add(struct view *view)
+{
+	/* Mapped but not yet focused views are the least recent ones */
+	if (wl_list_empty(&view->focus_link)) {
+		wl_list_append(&view->server->views_focus_history,
+			&view->focus_link);
+	}
+}
+
+void
+view_focus_history_remove(struct view *view)
+{
+	wl_list_remove(&view->focus_link);
+	wl_list_init(&view->focus_link);
+}
+
+struct view *
+view_cycle_focus_history(struct server *server, struct view *from,
+		enum lab_view_criteria criteria, bool forwards)
+{
+	struct wl_list *head = &server->views_focus_history;
+	struct wl_list *elm = from && !wl_list_empty(&from->focus_link)
+		? &from->focus_link : head;
+
+	struct wl_list *end = elm;
+	for (elm = forwards ? elm->next : elm->prev; elm != end;
+			elm = forwards ? elm->next : elm->prev) {
+		if (elm == head) {
+			continue;
+		}
+		struct view *view = wl_container_of(elm, view, focus_link);
+		if (matches_criteria(view, criteria)) {
+			return view;
+		}
+	}
+	return from;
+}
+
+void
+view_array_append_focus_history(struct server *server,
+		struct wl_array *views, enum lab_view_criteria criteria)
+{
+	struct view *view;
+	wl_list_for_each(view, &server->views_focus_history, focus_link) {
+		if (!matches_criteria(view, criteria)) {
+			continue;
+		}
+		struct view **entry = wl_array_add(views, sizeof(*entry));
+		if (!entry) {
+			wlr_log(WLR_ERROR, "wl_array_add(): out of memory");
+			continue;
+		}
+		*entry = view;
+	}
+}
+
 void
 view_array_append(struct server *server, struct wl_array *views,
 		enum lab_view_criteria criteria)
@@ -273,37 +692,17 @@ static struct wlr_box
 view_get_edge_snap_box(struct view *view, struct output *output,
 		enum view_edge edge)
 {
-	struct wlr_box usable = output_usable_area_scaled(output);
-	int x_offset = edge == VIEW_EDGE_RIGHT
-		? (usable.width + rc.gap) / 2 : rc.gap;
-	int y_offset = edge == VIEW_EDGE_DOWN
-		? (usable.height + rc.gap) / 2 : rc.gap;
-
-	int base_width, base_height;
-	switch (edge) {
-	case VIEW_EDGE_LEFT:
-	case VIEW_EDGE_RIGHT:
-		base_width = (usable.width - 3 * rc.gap) / 2;
-		base_height = usable.height - 2 * rc.gap;
-		break;
-	case VIEW_EDGE_UP:
-	case VIEW_EDGE_DOWN:
-		base_width = usable.width - 2 * rc.gap;
-		base_height = (usable.height - 3 * rc.gap) / 2;
-		break;
-	default:
-	case VIEW_EDGE_CENTER:
-		base_width = usable.width - 2 * rc.gap;
-		base_height = usable.height - 2 * rc.gap;
-		break;
+	if (edge < VIEW_EDGE_LEFT || edge > VIEW_EDGE_CENTER) {
+		edge = VIEW_EDGE_CENTER;
 	}
+	struct wlr_box base = output_get_edge_snap(output)->target[edge];
 
-	struct border margin = ssd_get_margin(view->ssd);
+	struct border margin = ssd_get_margin(view);
 	struct wlr_box dst = {
-		.x = x_offset + usable.x + margin.left,
-		.y = y_offset + usable.y + margin.top,
-		.width = base_width - margin.left - margin.right,
-		.height = base_height - margin.top - margin.bottom,
+		.x = base.x + margin.left,
+		.y = base.y + margin.top,
+		.width = base.width - margin.left - margin.right,
+		.height = base.height - margin.top - margin.bottom,
 	};
 
 	return dst;
@@ -325,7 +724,7 @@ view_discover_output(struct view *view, struct wlr_box *geometry)
 			geometry->y + geometry->height / 2);
 
 	if (output && output != view->output) {
-		view->output = output;
+		set_output(view, output);
 		return true;
 	}
 
@@ -335,12 +734,20 @@ view_discover_output(struct view *view, struct wlr_box *geometry)
 static void
 set_adaptive_sync_fullscreen(struct view *view)
 {
-	if (rc.adaptive_sync != LAB_ADAPTIVE_SYNC_FULLSCREEN) {
+	bool enabled;
+	switch (rc.adaptive_sync) {
+	case LAB_ADAPTIVE_SYNC_FULLSCREEN:
+		/* Enable adaptive sync if view is fullscreen */
+		enabled = view->fullscreen;
+		break;
+	case LAB_ADAPTIVE_SYNC_CONTENT:
+		/* Only if the fullscreen view is a game or video */
+		enabled = view->fullscreen && view_shows_media(view);
+		break;
+	default:
 		return;
 	}
-	/* Enable adaptive sync if view is fullscreen */
-	output_enable_adaptive_sync(view->output->wlr_output, view->fullscreen);
-	wlr_output_commit(view->output->wlr_output);
+	output_set_adaptive_sync(view->output, enabled);
 }
 
 void
@@ -351,19 +758,30 @@ view_set_activated(struct view *view, bool activated)
 	if (view->impl->set_activated) {
 		view->impl->set_activated(view, activated);
 	}
-	if (view->toplevel.handle) {
-		wlr_foreign_toplevel_handle_v1_set_activated(
-			view->toplevel.handle, activated);
+	view->toplevel.activated = activated;
+	foreign_toplevel_schedule_update(view, LAB_TOPLEVEL_UPDATE_ACTIVATED);
+
+	/* Only mapped views are in the focus history */
+	if (activated && !wl_list_empty(&view->focus_link)) {
+		wl_list_remove(&view->focus_link);
+		wl_list_insert(&view->server->views_focus_history,
+			&view->focus_link);
 	}
 
 	if (rc.kb_layout_per_window) {
+		struct seat *seat = &view->server->seat;
 		if (!activated) {
 			/* Store configured keyboard layout per view */
 			view->keyboard_layout =
-				view->server->seat.keyboard_group->keyboard.modifiers.group;
+				seat->keyboard_group->keyboard.modifiers.group;
+			view->keyboard_layout_generation =
+				seat->keyboard_layout_generation;
 		} else {
 			/* Switch to previously stored keyboard layout */
-			keyboard_update_layout(&view->server->seat, view->keyboard_layout);
+			bool stored = view->keyboard_layout_generation
+				== seat->keyboard_layout_generation;
+			keyboard_update_layout(seat,
+				stored ? view->keyboard_layout : 0);
 		}
 	}
 	set_adaptive_sync_fullscreen(view);
@@ -378,7 +796,7 @@ view_set_output(struct view *view, struct output *output)
 		wlr_log(WLR_ERROR, "invalid output set for view");
 		return;
 	}
-	view->output = output;
+	set_output(view, output);
 }
 
 void
@@ -390,23 +808,38 @@ view_close(struct view *view)
 	}
 }
 
-static void
-view_update_outputs(struct view *view)
+/* Returns true if the set of outputs the view is on has changed */
+static bool
+update_outputs(struct view *view)
 {
 	struct output *output;
 	struct wlr_output_layout *layout = view->server->output_layout;
+	struct bitset outputs = {0};
 
-	view->outputs = 0;
 	wl_list_for_each(output, &view->server->outputs, link) {
 		if (output_is_usable(output) && wlr_output_layout_intersects(
 				layout, output->wlr_output, &view->current)) {
-			view->outputs |= (1ull << output->scene_output->index);
+			bitset_set(&outputs, output->scene_output->index);
 		}
 	}
 
-	if (view->toplevel.handle) {
-		foreign_toplevel_update_outputs(view);
+	bool changed = !bitset_equal(&outputs, &view->outputs);
+	if (changed) {
+		bitset_copy(&view->outputs, &outputs);
 	}
+	bitset_finish(&outputs);
+	return changed;
+}
+
+static void
+view_update_outputs(struct view *view)
+{
+	/*
+	 * Scene output indices are reused, so the same set may stand for
+	 * different outputs after a layout change. Always tell clients.
+	 */
+	update_outputs(view);
+	foreign_toplevel_schedule_update(view, LAB_TOPLEVEL_UPDATE_OUTPUTS);
 }
 
 bool
@@ -415,7 +848,7 @@ view_on_output(struct view *view, struct output *output)
 	assert(view);
 	assert(output);
 	return output->scene_output
-			&& (view->outputs & (1ull << output->scene_output->index));
+		&& bitset_test(&view->outputs, output->scene_output->index);
 }
 
 void
@@ -429,12 +862,9 @@ view_move(struct view *view, int x, int y)
 	});
 }
 
-void
-view_moved(struct view *view)
+static void
+update_moved(struct view *view)
 {
-	assert(view);
-	wlr_scene_node_set_position(&view->scene_tree->node,
-		view->current.x, view->current.y);
 	/*
 	 * Only floating views change output when moved. Non-floating
 	 * views (maximized/tiled/fullscreen) are tied to a particular
@@ -443,11 +873,56 @@ view_moved(struct view *view)
 	if (view_is_floating(view)) {
 		view_discover_output(view, NULL);
 	}
-	view_update_outputs(view);
+	if (update_outputs(view)) {
+		foreign_toplevel_schedule_update(view,
+			LAB_TOPLEVEL_UPDATE_OUTPUTS);
+	}
+	edges_update_view(view);
+	if (view->server->grabbed_view == view) {
+		scale_debounce_update(view);
+		if (rc.resize_indicator) {
+			resize_indicator_update(view);
+		}
+	}
+}
+
+void
+view_moved(struct view *view)
+{
+	TRACE_FUNC();
+	assert(view);
+	struct server *server = view->server;
+	wlr_scene_node_set_position(&view->scene_tree->node,
+		view->current.x, view->current.y);
+
+	/*
+	 * Pointer motion may move the grabbed view several times per
+	 * frame, only the position has to follow every event
+	 */
+	if (server->grabbed_view == view
+			&& server->input_mode == LAB_INPUT_STATE_MOVE
+			&& view->output && output_is_usable(view->output)) {
+		if (!server->move_update_pending) {
+			server->move_update_pending = true;
+			wlr_output_schedule_frame(view->output->wlr_output);
+		}
+	} else {
+		update_moved(view);
+	}
 	ssd_update_geometry(view->ssd);
-	cursor_update_focus(view->server);
-	if (rc.resize_indicator && view->server->grabbed_view == view) {
-		resize_indicator_update(view);
+	desktop_update_occlusion(server);
+	cursor_update_focus(server);
+}
+
+void
+view_flush_move_update(struct server *server)
+{
+	if (!server->move_update_pending) {
+		return;
+	}
+	server->move_update_pending = false;
+	if (server->grabbed_view) {
+		update_moved(server->grabbed_view);
 	}
 }
 
@@ -609,14 +1084,12 @@ _minimize(struct view *view, bool minimized)
 	if (view->minimized == minimized) {
 		return;
 	}
-	if (view->toplevel.handle) {
-		wlr_foreign_toplevel_handle_v1_set_minimized(
-			view->toplevel.handle, minimized);
-	}
+	foreign_toplevel_schedule_update(view, LAB_TOPLEVEL_UPDATE_MINIMIZED);
 	if (view->impl->minimize) {
 		view->impl->minimize(view, minimized);
 	}
 	view->minimized = minimized;
+	osd_field_invalidate(view);
 	if (minimized) {
 		view->impl->unmap(view, /* client_request */ false);
 	} else {
@@ -678,7 +1151,7 @@ view_compute_centered_position(struct view *view, const struct wlr_box *ref,
 		return false;
 	}
 
-	struct border margin = ssd_get_margin(view->ssd);
+	struct border margin = ssd_get_margin(view);
 	struct wlr_box usable = output_usable_area_in_layout_coords(view->output);
 	int width = w + margin.left + margin.right;
 	int height = h + margin.top + margin.bottom;
@@ -716,7 +1189,8 @@ adjust_floating_geometry(struct view *view, struct wlr_box *geometry,
 	}
 
 	/* Avoid moving panels out of their own reserved area ("strut") */
-	if (window_rules_get_property(view, "fixedPosition") == LAB_PROP_TRUE
+	if (window_rules_get_property(view,
+			LAB_WINDOW_RULE_PROP_FIXED_POSITION) == LAB_PROP_TRUE
 			|| view_has_strut_partial(view)) {
 		return false;
 	}
@@ -726,7 +1200,7 @@ adjust_floating_geometry(struct view *view, struct wlr_box *geometry,
 	if (wlr_output_layout_intersects(view->server->output_layout,
 			view->output->wlr_output, geometry)) {
 		/* Always make sure the titlebar starts within the usable area */
-		struct border margin = ssd_get_margin(view->ssd);
+		struct border margin = ssd_get_margin(view);
 		struct wlr_box usable =
 			output_usable_area_in_layout_coords(view->output);
 
@@ -858,7 +1332,7 @@ view_constrain_size_to_that_of_usable_area(struct view *view)
 
 	struct wlr_box usable_area =
 			output_usable_area_in_layout_coords(view->output);
-	struct border margin = ssd_get_margin(view->ssd);
+	struct border margin = ssd_get_margin(view);
 
 	int available_width = usable_area.width - margin.left - margin.right;
 	int available_height = usable_area.height - margin.top - margin.bottom;
@@ -967,7 +1441,7 @@ view_apply_region_geometry(struct view *view)
 	}
 
 	/* And adjust for current view */
-	struct border margin = ssd_get_margin(view->ssd);
+	struct border margin = ssd_get_margin(view);
 	geo.x += margin.left;
 	geo.y += margin.top;
 	geo.width -= margin.left + margin.right;
@@ -1089,11 +1563,9 @@ set_maximized(struct view *view, enum view_axis maximized)
 	if (view->impl->maximize) {
 		view->impl->maximize(view, (maximized == VIEW_AXIS_BOTH));
 	}
-	if (view->toplevel.handle) {
-		wlr_foreign_toplevel_handle_v1_set_maximized(
-			view->toplevel.handle, (maximized == VIEW_AXIS_BOTH));
-	}
+	foreign_toplevel_schedule_update(view, LAB_TOPLEVEL_UPDATE_MAXIMIZED);
 	view->maximized = maximized;
+	osd_field_invalidate(view);
 
 	/*
 	 * Ensure that follow-up actions like SnapToEdge / SnapToRegion
@@ -1238,6 +1710,7 @@ view_toggle_decorations(struct view *view)
 		if (!view_is_floating(view)) {
 			view_apply_special_geometry(view);
 		}
+		edges_invalidate_view(view);
 		return;
 	}
 	view_set_decorations(view, !view->ssd_enabled);
@@ -1258,11 +1731,14 @@ view_toggle_always_on_top(struct view *view)
 	if (view_is_always_on_top(view)) {
 		view->workspace = view->server->workspace_current;
 		wlr_scene_node_reparent(&view->scene_tree->node,
-			view->workspace->tree);
+			workspaces_get_tree(view->workspace));
 	} else {
 		wlr_scene_node_reparent(&view->scene_tree->node,
 			view->server->view_tree_always_on_top);
 	}
+	update_workspace_link(view);
+	desktop_update_occlusion(view->server);
+	edges_invalidate_view(view);
 }
 
 bool
@@ -1280,11 +1756,14 @@ view_toggle_always_on_bottom(struct view *view)
 	if (view_is_always_on_bottom(view)) {
 		view->workspace = view->server->workspace_current;
 		wlr_scene_node_reparent(&view->scene_tree->node,
-			view->workspace->tree);
+			workspaces_get_tree(view->workspace));
 	} else {
 		wlr_scene_node_reparent(&view->scene_tree->node,
 			view->server->view_tree_always_on_bottom);
 	}
+	update_workspace_link(view);
+	desktop_update_occlusion(view->server);
+	edges_invalidate_view(view);
 }
 
 void
@@ -1294,25 +1773,24 @@ view_toggle_visible_on_all_workspaces(struct view *view)
 	view->visible_on_all_workspaces = !view->visible_on_all_workspaces;
 }
 
-void
-view_move_to_workspace(struct view *view, struct workspace *workspace)
+static bool
+on_hidden_workspace(struct view *view)
 {
-	assert(view);
-	assert(workspace);
-	if (view->workspace != workspace) {
-		view->workspace = workspace;
-		wlr_scene_node_reparent(&view->scene_tree->node,
-			workspace->tree);
-	}
+	return view->workspace != view->server->workspace_current
+		&& !view->visible_on_all_workspaces;
 }
 
 static void
 decorate(struct view *view)
 {
-	if (!view->ssd) {
-		view->ssd = ssd_create(view,
-			view == view->server->active_view);
+	if (view->ssd) {
+		return;
+	}
+	if (on_hidden_workspace(view)) {
+		/* Created once the view is shown, see view_set_hidden() */
+		return;
 	}
+	view->ssd = ssd_create(view, view == view->server->active_view);
 }
 
 static void
@@ -1322,6 +1800,62 @@ undecorate(struct view *view)
 	view->ssd = NULL;
 }
 
+static void
+move_to_workspace(struct view *view, struct workspace *workspace)
+{
+	view->workspace = workspace;
+	wlr_scene_node_reparent(&view->scene_tree->node,
+		workspaces_get_tree(workspace));
+	update_workspace_link(view);
+	osd_field_invalidate(view);
+
+	/* Stack it among the views of the workspace, not above all of them */
+	if (view->workspace_list == &workspace->views) {
+		struct view *below = workspace_list_next(&workspace->views, view);
+		if (below) {
+			wlr_scene_node_place_above(&view->scene_tree->node,
+				&below->scene_tree->node);
+		} else {
+			wlr_scene_node_lower_to_bottom(&view->scene_tree->node);
+		}
+	}
+
+	if (on_hidden_workspace(view)) {
+		if (!view->been_mapped) {
+			/* Sent away by a window rule while mapping */
+			undecorate(view);
+		}
+	} else if (view->mapped && !view->minimized) {
+		view_set_hidden(view, false);
+	}
+}
+
+/*
+ * Omnipresent views are moved to the new workspace on every switch, with
+ * view_follow_workspace_switch(), see workspaces_switch_to()
+ */
+void
+view_move_to_workspace(struct view *view, struct workspace *workspace)
+{
+	assert(view);
+	assert(workspace);
+	if (view->workspace != workspace) {
+		move_to_workspace(view, workspace);
+		desktop_update_occlusion(view->server);
+		edges_invalidate_view(view);
+	}
+}
+
+void
+view_follow_workspace_switch(struct view *view, struct workspace *workspace)
+{
+	assert(view);
+	assert(workspace);
+	if (view->workspace != workspace) {
+		move_to_workspace(view, workspace);
+	}
+}
+
 void
 view_set_decorations(struct view *view, bool decorations)
 {
@@ -1342,6 +1876,7 @@ view_set_decorations(struct view *view, bool decorations)
 		if (!view_is_floating(view)) {
 			view_apply_special_geometry(view);
 		}
+		edges_invalidate_view(view);
 	}
 }
 
@@ -1370,11 +1905,9 @@ set_fullscreen(struct view *view, bool fullscreen)
 	if (view->impl->set_fullscreen) {
 		view->impl->set_fullscreen(view, fullscreen);
 	}
-	if (view->toplevel.handle) {
-		wlr_foreign_toplevel_handle_v1_set_fullscreen(
-			view->toplevel.handle, fullscreen);
-	}
+	foreign_toplevel_schedule_update(view, LAB_TOPLEVEL_UPDATE_FULLSCREEN);
 	view->fullscreen = fullscreen;
+	osd_field_invalidate(view);
 
 	/* Re-show decorations when no longer fullscreen */
 	if (!fullscreen && view->ssd_enabled) {
@@ -1418,6 +1951,81 @@ view_set_fullscreen(struct view *view, bool fullscreen)
 	set_adaptive_sync_fullscreen(view);
 }
 
+void
+view_set_suspended(struct view *view, bool suspended)
+{
+	assert(view);
+	if (view->suspended == suspended) {
+		return;
+	}
+	view->suspended = suspended;
+	if (view->impl->set_suspended) {
+		view->impl->set_suspended(view, suspended);
+	}
+}
+
+static int
+handle_trim_timer(void *data)
+{
+	struct view *view = data;
+	wl_event_source_remove(view->trim_timer);
+	view->trim_timer = NULL;
+	ssd_set_trimmed(view->ssd, true);
+	return 0;
+}
+
+/*
+ * Called for minimized views and views on other workspaces. Once a view
+ * has been hidden for <core><trimHiddenViews> seconds its decoration
+ * buffers are released; they are rebuilt when the view is shown again.
+ * Views mapped on a hidden workspace get their decoration created here.
+ */
+void
+view_set_hidden(struct view *view, bool hidden)
+{
+	assert(view);
+	if (!hidden) {
+		if (view->trim_timer) {
+			wl_event_source_remove(view->trim_timer);
+			view->trim_timer = NULL;
+		}
+		if (view->ssd_enabled && !view->fullscreen) {
+			decorate(view);
+		}
+		ssd_set_trimmed(view->ssd, false);
+		return;
+	}
+	if (!rc.trim_hidden_views || !view->ssd || view->trim_timer
+			|| ssd_is_trimmed(view->ssd)) {
+		return;
+	}
+	view->trim_timer = wl_event_loop_add_timer(view->server->wl_event_loop,
+		handle_trim_timer, view);
+	wl_event_source_timer_update(view->trim_timer,
+		rc.trim_hidden_views * 1000);
+}
+
+bool
+view_trim_if_hidden(struct view *view)
+{
+	assert(view);
+	if ((!view->mapped && !view->minimized) || !view->ssd
+			|| ssd_is_trimmed(view->ssd)) {
+		return false;
+	}
+	int lx, ly;
+	if (!view->minimized && wlr_scene_node_coords(&view->scene_tree->node,
+			&lx, &ly)) {
+		return false;
+	}
+	if (view->trim_timer) {
+		wl_event_source_remove(view->trim_timer);
+		view->trim_timer = NULL;
+	}
+	ssd_set_trimmed(view->ssd, true);
+	return true;
+}
+
 static bool
 last_layout_geometry_is_valid(struct view *view)
 {
@@ -1578,7 +2186,7 @@ view_on_output_destroy(struct view *view)
 	 * view. We expect view_adjust_for_layout_change() to be called
 	 * shortly afterward, which will exit fullscreen.
 	 */
-	view->output = NULL;
+	set_output(view, NULL);
 }
 
 static enum wlr_direction
@@ -1734,7 +2342,7 @@ view_move_to_edge(struct view *view, enum view_edge direction, bool snap_to_wind
 
 	/* When jumping to next output, attach to edge nearest the motion */
 	struct wlr_box usable = output_usable_area_in_layout_coords(output);
-	struct border margin = ssd_get_margin(view->ssd);
+	struct border margin = ssd_get_margin(view);
 
 	/* Bounds of the possible placement zone in this output */
 	int left = usable.x + rc.gap + margin.left;
@@ -2000,6 +2608,7 @@ move_to_front(struct view *view)
 	if (view->impl->move_to_front) {
 		view->impl->move_to_front(view);
 	}
+	edges_invalidate_view(view);
 	view->server->last_raised_view = view;
 }
 
@@ -2009,6 +2618,7 @@ move_to_back(struct view *view)
 	if (view->impl->move_to_back) {
 		view->impl->move_to_back(view);
 	}
+	edges_invalidate_view(view);
 	if (view == view->server->last_raised_view) {
 		view->server->last_raised_view = NULL;
 	}
@@ -2046,6 +2656,7 @@ view_move_to_front(struct view *view)
 	}
 
 	cursor_update_focus(view->server);
+	desktop_update_occlusion(view->server);
 }
 
 void
@@ -2059,6 +2670,7 @@ view_move_to_back(struct view *view)
 	move_to_back(root);
 
 	cursor_update_focus(view->server);
+	desktop_update_occlusion(view->server);
 }
 
 struct view *
@@ -2071,12 +2683,83 @@ view_get_root(struct view *view)
 	return view;
 }
 
+static struct view *
+family_root_of(struct view *view)
+{
+	struct view *root = view_get_root(view);
+	/* The root may be on its way out, see view_destroy() */
+	return root ? root : view;
+}
+
+static void
+family_link(struct view *view, struct view *root)
+{
+	if (root == view) {
+		root = NULL;
+	}
+	if (view->family_root == root) {
+		return;
+	}
+	wl_list_remove(&view->family_link);
+	if (root) {
+		wl_list_insert(root->family.prev, &view->family_link);
+	} else {
+		wl_list_init(&view->family_link);
+	}
+	view->family_root = root;
+}
+
+void
+view_update_family(struct view *view)
+{
+	assert(view);
+	struct view *old_root = view->family_root;
+	struct view *root = family_root_of(view);
+	family_link(view, root);
+
+	struct view *member, *tmp;
+	if (root != view) {
+		/* No longer a root, hand the own family over */
+		wl_list_for_each_safe(member, tmp, &view->family, family_link) {
+			family_link(member, family_root_of(member));
+		}
+	}
+	if (old_root && old_root != root) {
+		/* Views below this one have left the old family as well */
+		wl_list_for_each_safe(member, tmp, &old_root->family, family_link) {
+			struct view *member_root = family_root_of(member);
+			if (member_root != old_root) {
+				family_link(member, member_root);
+			}
+		}
+	}
+}
+
 void
 view_append_children(struct view *view, struct wl_array *children)
 {
 	assert(view);
-	if (view->impl->append_children) {
-		view->impl->append_children(view, children);
+	size_t start = children->size / sizeof(struct view *);
+	struct view *member;
+	wl_list_for_each(member, &view->family, family_link) {
+		/*
+		 * XWayland views have no surface when never mapped or when
+		 * the client has requested an unmap
+		 */
+		if (!member->surface) {
+			continue;
+		}
+		if (!member->mapped && !member->minimized) {
+			continue;
+		}
+		/* Keep the array in stacking order, families are small */
+		struct view **slot = wl_array_add(children, sizeof(*slot));
+		struct view **first = (struct view **)children->data + start;
+		while (slot > first && slot[-1]->stack_seq > member->stack_seq) {
+			*slot = slot[-1];
+			slot--;
+		}
+		*slot = member;
 	}
 }
 
@@ -2099,28 +2782,61 @@ view_get_string_prop(struct view *view, const char *prop)
 	return "";
 }
 
+bool
+view_shows_media(struct view *view)
+{
+	return view->content_type == LAB_CONTENT_TYPE_GAME
+		|| view->content_type == LAB_CONTENT_TYPE_VIDEO;
+}
+
+void
+view_update_content_type(struct view *view)
+{
+	assert(view);
+	struct wlr_content_type_manager_v1 *manager =
+		view->server->content_type_manager;
+	if (!manager || !view->surface) {
+		return;
+	}
+	enum view_content_type type = (enum view_content_type)
+		wlr_surface_get_content_type_v1(manager, view->surface);
+	if (type == view->content_type) {
+		return;
+	}
+	view->content_type = type;
+	window_rules_invalidate(view);
+	if (view->fullscreen && view->output) {
+		set_adaptive_sync_fullscreen(view);
+	}
+}
+
 void
 view_update_title(struct view *view)
 {
 	assert(view);
+	window_rules_invalidate(view);
+	view_query_cache_invalidate(view);
+	osd_field_invalidate(view);
 	const char *title = view_get_string_prop(view, "title");
 	if (!view->toplevel.handle || !title) {
 		return;
 	}
-	ssd_update_title(view->ssd);
-	wlr_foreign_toplevel_handle_v1_set_title(view->toplevel.handle, title);
+	ssd_schedule_title_update(view->ssd);
+	foreign_toplevel_schedule_update(view, LAB_TOPLEVEL_UPDATE_TITLE);
 }
 
 void
 view_update_app_id(struct view *view)
 {
 	assert(view);
+	window_rules_invalidate(view);
+	view_query_cache_invalidate(view);
+	osd_field_invalidate(view);
 	const char *app_id = view_get_string_prop(view, "app_id");
 	if (!view->toplevel.handle || !app_id) {
 		return;
 	}
-	wlr_foreign_toplevel_handle_v1_set_app_id(
-		view->toplevel.handle, app_id);
+	foreign_toplevel_schedule_update(view, LAB_TOPLEVEL_UPDATE_APP_ID);
 }
 
 void
@@ -2225,6 +2941,8 @@ view_set_shade(struct view *view, bool shaded)
 	if (view->impl->shade) {
 		view->impl->shade(view, shaded);
 	}
+	desktop_update_occlusion(view->server);
+	edges_invalidate_view(view);
 }
 
 void
@@ -2234,6 +2952,8 @@ view_destroy(struct view *view)
 	struct server *server = view->server;
 
 	snap_constraints_invalidate(view);
+	transaction_view_destroy(view);
+	edges_invalidate_view(view);
 
 	if (view->mappable.connected) {
 		mappable_disconnect(&view->mappable);
@@ -2247,6 +2967,13 @@ view_destroy(struct view *view)
 	wl_list_remove(&view->set_title.link);
 	wl_list_remove(&view->destroy.link);
 
+	family_link(view, NULL);
+	struct view *member, *tmp;
+	wl_list_for_each_safe(member, tmp, &view->family, family_link) {
+		family_link(member, NULL);
+		family_link(member, family_root_of(member));
+	}
+
 	if (view->toplevel.handle) {
 		wlr_foreign_toplevel_handle_v1_destroy(view->toplevel.handle);
 	}
@@ -2255,6 +2982,7 @@ view_destroy(struct view *view)
 		/* Application got killed while moving around */
 		server->input_mode = LAB_INPUT_STATE_PASSTHROUGH;
 		server->grabbed_view = NULL;
+		edges_end_session(server);
 		overlay_hide(&server->seat);
 	}
 
@@ -2274,6 +3002,11 @@ view_destroy(struct view *view)
 		zfree(view->tiled_region_evacuate);
 	}
 
+	if (view->trim_timer) {
+		wl_event_source_remove(view->trim_timer);
+		view->trim_timer = NULL;
+	}
+
 	if (view->inhibits_keybinds) {
 		view->inhibits_keybinds = false;
 		server->seat.nr_inhibited_keybind_views--;
@@ -2290,9 +3023,7 @@ view_destroy(struct view *view)
 	if (view->fullscreen && view->output) {
 		view->fullscreen = false;
 		desktop_update_top_layer_visiblity(server);
-		if (rc.adaptive_sync == LAB_ADAPTIVE_SYNC_FULLSCREEN) {
-			set_adaptive_sync_fullscreen(view);
-		}
+		set_adaptive_sync_fullscreen(view);
 	}
 
 	/* If we spawned a window menu, close it */
@@ -2311,8 +3042,13 @@ view_destroy(struct view *view)
 		view->scene_tree = NULL;
 	}
 
-	/* Remove view from server->views */
-	wl_list_remove(&view->link);
+	/* Remove view from server->views and the per-workspace/output lists */
+	stack_remove(view);
+	surface_map_remove_view(view);
+	window_rules_view_finish(view);
+	view_query_cache_finish(view);
+	bitset_finish(&view->outputs);
+	osd_field_view_finish(view);
 	free(view);
 
 	cursor_update_focus(server);
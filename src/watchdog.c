@@ -0,0 +1,166 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include "config.h"
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "common/time-helpers.h"
+#include "flight-recorder.h"
+#include "watchdog.h"
+#if HAVE_BACKTRACE
+#include <execinfo.h>
+#endif
+
+#define WATCHDOG_SIGNAL SIGUSR2
+#if HAVE_BACKTRACE
+#define WATCHDOG_MAX_FRAMES 64
+#endif
+
+static bool enabled;
+static int64_t threshold_nsec;
+static pthread_t main_thread;
+static pthread_t thread;
+
+/* Start of the current dispatch, 0 while waiting for events */
+static _Atomic int64_t dispatch_start_nsec;
+/* Incremented for each dispatch, to report every stall only once */
+static _Atomic uint64_t dispatch_seq;
+static atomic_bool running;
+
+static void
+write_str(const char *str)
+{
+	/* Only async-signal-safe functions from here */
+	ssize_t ret = write(STDERR_FILENO, str, strlen(str));
+	(void)ret;
+}
+
+static void
+handle_signal(int signal)
+{
+	int saved_errno = errno;
+	write_str("labwc: event loop stalled, backtrace:\n");
+#if HAVE_BACKTRACE
+	void *frames[WATCHDOG_MAX_FRAMES];
+	int nr_frames = backtrace(frames, WATCHDOG_MAX_FRAMES);
+	backtrace_symbols_fd(frames, nr_frames, STDERR_FILENO);
+#else
+	write_str("  (not supported on this platform)\n");
+#endif
+	flight_recorder_dump("event loop stall");
+	errno = saved_errno;
+}
+
+static void *
+watchdog_thread(void *data)
+{
+	struct timespec interval = {
+		.tv_sec = threshold_nsec / 1000000000,
+		.tv_nsec = threshold_nsec % 1000000000,
+	};
+	uint64_t reported_seq = 0;
+
+	while (atomic_load(&running)) {
+		nanosleep(&interval, NULL);
+
+		uint64_t seq = atomic_load(&dispatch_seq);
+		int64_t start = atomic_load(&dispatch_start_nsec);
+		if (start && seq != reported_seq
+				&& time_now_nsec() - start > threshold_nsec) {
+			reported_seq = seq;
+			pthread_kill(main_thread, WATCHDOG_SIGNAL);
+		}
+	}
+	return NULL;
+}
+
+void
+watchdog_init(void)
+{
+	const char *env = getenv("LABWC_WATCHDOG");
+	if (!env || !*env) {
+		return;
+	}
+	int threshold_ms = atoi(env);
+	if (threshold_ms <= 0) {
+		wlr_log(WLR_ERROR, "ignoring invalid LABWC_WATCHDOG=%s", env);
+		return;
+	}
+	threshold_nsec = threshold_ms * 1000000LL;
+	main_thread = pthread_self();
+
+#if HAVE_BACKTRACE
+	/* The first call may allocate, which is not safe in the handler */
+	void *frame;
+	backtrace(&frame, 1);
+#endif
+	struct sigaction sa = { .sa_handler = handle_signal };
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+	sigaction(WATCHDOG_SIGNAL, &sa, NULL);
+
+	/* The helper thread must not take the signal itself */
+	sigset_t mask, old_mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, WATCHDOG_SIGNAL);
+	pthread_sigmask(SIG_BLOCK, &mask, &old_mask);
+	atomic_store(&running, true);
+	int ret = pthread_create(&thread, NULL, watchdog_thread, NULL);
+	pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+	if (ret) {
+		wlr_log(WLR_ERROR, "failed to start watchdog thread: %s",
+			strerror(ret));
+		atomic_store(&running, false);
+		signal(WATCHDOG_SIGNAL, SIG_DFL);
+		return;
+	}
+
+	enabled = true;
+	wlr_log(WLR_INFO, "watchdog enabled with a threshold of %d ms",
+		threshold_ms);
+}
+
+void
+watchdog_dispatch_begin(void)
+{
+	if (!enabled) {
+		return;
+	}
+	atomic_fetch_add(&dispatch_seq, 1);
+	atomic_store(&dispatch_start_nsec, time_now_nsec());
+}
+
+void
+watchdog_dispatch_end(void)
+{
+	if (!enabled) {
+		return;
+	}
+	int64_t start = atomic_exchange(&dispatch_start_nsec, 0);
+	int64_t elapsed = time_now_nsec() - start;
+	if (elapsed > threshold_nsec) {
+		flight_record(FLIGHT_EVENT_STALL, 0, elapsed / 1000, 0);
+		wlr_log(WLR_ERROR, "event loop dispatch took %lld ms",
+			(long long)(elapsed / 1000000));
+	}
+}
+
+void
+watchdog_finish(void)
+{
+	if (!enabled) {
+		return;
+	}
+	atomic_store(&running, false);
+	pthread_join(thread, NULL);
+	signal(WATCHDOG_SIGNAL, SIG_DFL);
+	enabled = false;
+}
@@ -2,30 +2,71 @@
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <cairo.h>
 #include <glib.h>
 #include <strings.h>
 #include <wlr/util/log.h>
 #include "action.h"
+#include "common/macros.h"
 #include "common/match.h"
+#include "common/mem.h"
 #include "config/rcxml.h"
 #include "labwc.h"
 #include "view.h"
 #include "window-rules.h"
 
+#define BITS_PER_WORD 64
+
+static_assert(LAB_WINDOW_RULE_PROP_COUNT <= 32, "resolved is a uint32_t");
+
+/*
+ * Rules indexed by their position in rc.window_rules and, for each
+ * property, a bitmap of the rules setting it. Combined with the per-view
+ * bitmap of matching rules, finding the rule which decides a property is
+ * a walk over a few words rather than a glob match per rule.
+ */
+static struct {
+	struct window_rule **rules;
+	size_t nr_rules;
+	size_t nr_words;
+	uint64_t *has_property[LAB_WINDOW_RULE_PROP_COUNT];
+	/*
+	 * Number of views in server->views matching each rule, for
+	 * 'matchOnce'. Only views whose cache.counted equals the current
+	 * generation are included; 'dirty' is set when a view may be
+	 * missing so the next lookup catches up.
+	 */
+	uint32_t *instances;
+	bool dirty;
+	/* Bumped whenever the rules change; never zero */
+	uint32_t generation;
+} compiled = { .generation = 1 };
+
+static void
+set_bit(uint64_t *bitmap, size_t i)
+{
+	bitmap[i / BITS_PER_WORD] |= 1ull << (i % BITS_PER_WORD);
+}
+
 static bool
-matches_criteria(struct window_rule *rule, struct view *view)
+test_bit(const uint64_t *bitmap, size_t i)
 {
-	const char *id = view_get_string_prop(view, "app_id");
-	const char *title = view_get_string_prop(view, "title");
+	return bitmap[i / BITS_PER_WORD] & (1ull << (i % BITS_PER_WORD));
+}
 
+static bool
+matches_criteria(struct window_rule *rule, struct view *view)
+{
 	if (rule->identifier) {
-		if (!id || !match_glob(rule->identifier, id)) {
+		const char *id = view_get_string_prop(view, "app_id");
+		if (!id || !match_pattern(&rule->identifier_match, id)) {
 			return false;
 		}
 	}
 	if (rule->title) {
-		if (!title || !match_glob(rule->title, title)) {
+		const char *title = view_get_string_prop(view, "title");
+		if (!title || !match_pattern(&rule->title_match, title)) {
 			return false;
 		}
 	}
@@ -34,50 +75,112 @@ matches_criteria(struct window_rule *rule, struct view *view)
 			return false;
 		}
 	}
+	if (rule->content_type >= 0) {
+		if (view->content_type != (enum view_content_type)rule->content_type) {
+			return false;
+		}
+	}
 	return true;
 }
 
-static bool
-other_instances_exist(struct window_rule *rule, struct view *self)
+/* Bitmap of rules matching @view, ignoring 'matchOnce' */
+static const uint64_t *
+view_matches(struct view *view)
 {
-	struct wl_list *views = &self->server->views;
-	struct view *view;
+	struct window_rule_cache *cache = &view->window_rules;
+	if (cache->generation == compiled.generation) {
+		return cache->matches;
+	}
+	cache->matches = xrealloc(cache->matches,
+		compiled.nr_words * sizeof(uint64_t));
+	for (size_t w = 0; w < compiled.nr_words; w++) {
+		cache->matches[w] = 0;
+	}
+	for (size_t i = 0; i < compiled.nr_rules; i++) {
+		if (matches_criteria(compiled.rules[i], view)) {
+			set_bit(cache->matches, i);
+		}
+	}
+	cache->generation = compiled.generation;
+	cache->resolved = 0;
+	return cache->matches;
+}
 
-	wl_list_for_each(view, views, link) {
-		if (view != self && matches_criteria(rule, view)) {
-			return true;
+static void
+count_view(struct view *view, int delta)
+{
+	const uint64_t *matches = view_matches(view);
+	for (size_t w = 0; w < compiled.nr_words; w++) {
+		uint64_t bits = matches[w];
+		while (bits) {
+			int bit = __builtin_ctzll(bits);
+			bits &= bits - 1;
+			compiled.instances[w * BITS_PER_WORD + bit] += delta;
 		}
 	}
-	return false;
 }
 
-static bool
-view_matches_criteria(struct window_rule *rule, struct view *view)
+static void
+uncount_view(struct view *view)
 {
-	if (rule->match_once && other_instances_exist(rule, view)) {
-		return false;
+	if (view->window_rules.counted == compiled.generation) {
+		count_view(view, -1);
 	}
-	return matches_criteria(rule, view);
+	view->window_rules.counted = 0;
+}
+
+static void
+update_instances(struct server *server)
+{
+	if (!compiled.dirty) {
+		return;
+	}
+	struct view *view;
+	wl_list_for_each(view, &server->views, link) {
+		if (view->window_rules.counted != compiled.generation) {
+			count_view(view, 1);
+			view->window_rules.counted = compiled.generation;
+		}
+	}
+	compiled.dirty = false;
+}
+
+/* Must only be called for rules matching @self */
+static bool
+other_instances_exist(struct window_rule *rule, struct view *self)
+{
+	update_instances(self->server);
+	return compiled.instances[rule->index] > 1;
 }
 
 void
 window_rules_apply(struct view *view, enum window_rule_event event)
 {
-	struct window_rule *rule;
-	wl_list_for_each(rule, &rc.window_rules, link) {
-		if (rule->event != event) {
+	const uint64_t *matches = view_matches(view);
+	for (size_t i = 0; i < compiled.nr_rules; i++) {
+		struct window_rule *rule = compiled.rules[i];
+		if (rule->event != event || !test_bit(matches, i)) {
 			continue;
 		}
-		if (view_matches_criteria(rule, view)) {
-			actions_run(view, view->server, &rule->actions, 0);
+		if (rule->match_once && other_instances_exist(rule, view)) {
+			continue;
 		}
+		actions_run(view, view->server, &rule->actions, 0);
+		/* Actions may have changed the title or app_id */
+		matches = view_matches(view);
 	}
 }
 
 enum property
-window_rules_get_property(struct view *view, const char *property)
+window_rules_get_property(struct view *view, enum window_rule_property property)
 {
-	assert(property);
+	assert(property < LAB_WINDOW_RULE_PROP_COUNT);
+
+	struct window_rule_cache *cache = &view->window_rules;
+	const uint64_t *matches = view_matches(view);
+	if (cache->resolved & (1u << property)) {
+		return cache->props[property];
+	}
 
 	/*
 	 * We iterate in reverse here because later items in list have higher
@@ -88,41 +191,115 @@ window_rules_get_property(struct view *view, const char *property)
 	 *       <windowRule identifier="*" serverDecoration="no"/>
 	 *       <windowRule identifier="foot" serverDecoration="default"/>
 	 *     </windowRules>
+	 *
+	 * Only rules which set the property (!= LAB_PROP_UNSPECIFIED) are
+	 * candidates, otherwise a <windowRule> which does not set a
+	 * particular property attribute would still return here if that
+	 * property was asked for.
+	 *
+	 * The result is kept until the cache is invalidated, unless a
+	 * 'matchOnce' rule was considered: that depends on other views.
 	 */
-	struct window_rule *rule;
-	wl_list_for_each_reverse(rule, &rc.window_rules, link) {
-		/*
-		 * Only return if property != LAB_PROP_UNSPECIFIED otherwise a
-		 * <windowRule> which does not set a particular property
-		 * attribute would still return here if that property was asked
-		 * for.
-		 */
-		if (view_matches_criteria(rule, view)) {
-			if (rule->server_decoration
-					&& !strcasecmp(property, "serverDecoration")) {
-				return rule->server_decoration;
-			}
-			if (rule->skip_taskbar
-					&& !strcasecmp(property, "skipTaskbar")) {
-				return rule->skip_taskbar;
-			}
-			if (rule->skip_window_switcher
-					&& !strcasecmp(property, "skipWindowSwitcher")) {
-				return rule->skip_window_switcher;
+	enum property ret = LAB_PROP_UNSPECIFIED;
+	bool depends_on_others = false;
+	const uint64_t *has_property = compiled.has_property[property];
+	for (size_t w = compiled.nr_words; w-- > 0 && !ret;) {
+		uint64_t candidates = matches[w] & has_property[w];
+		while (candidates) {
+			int bit = BITS_PER_WORD - 1 - __builtin_clzll(candidates);
+			candidates &= ~(1ull << bit);
+			struct window_rule *rule =
+				compiled.rules[w * BITS_PER_WORD + bit];
+			if (rule->match_once) {
+				depends_on_others = true;
+				if (other_instances_exist(rule, view)) {
+					continue;
+				}
 			}
-			if (rule->ignore_focus_request
-					&& !strcasecmp(property, "ignoreFocusRequest")) {
-				return rule->ignore_focus_request;
-			}
-			if (rule->ignore_configure_request
-					&& !strcasecmp(property, "ignoreConfigureRequest")) {
-				return rule->ignore_configure_request;
-			}
-			if (rule->fixed_position
-					&& !strcasecmp(property, "fixedPosition")) {
-				return rule->fixed_position;
+			ret = rule->properties[property];
+			break;
+		}
+	}
+	if (!depends_on_others) {
+		cache->props[property] = ret;
+		cache->resolved |= 1u << property;
+	}
+	return ret;
+}
+
+void
+window_rules_compile(void)
+{
+	window_rules_finish();
+
+	compiled.nr_rules = wl_list_length(&rc.window_rules);
+	compiled.nr_words = (compiled.nr_rules + BITS_PER_WORD - 1)
+		/ BITS_PER_WORD;
+	compiled.rules = znew_n(struct window_rule *, compiled.nr_rules);
+	compiled.instances = znew_n(uint32_t, compiled.nr_rules);
+	for (size_t prop = 0; prop < LAB_WINDOW_RULE_PROP_COUNT; prop++) {
+		compiled.has_property[prop] =
+			znew_n(uint64_t, compiled.nr_words);
+	}
+	compiled.dirty = true;
+
+	size_t i = 0;
+	struct window_rule *rule;
+	wl_list_for_each(rule, &rc.window_rules, link) {
+		rule->index = i;
+		compiled.rules[i] = rule;
+		if (rule->identifier) {
+			match_pattern_compile(&rule->identifier_match,
+				rule->identifier);
+		}
+		if (rule->title) {
+			match_pattern_compile(&rule->title_match, rule->title);
+		}
+		for (size_t prop = 0; prop < LAB_WINDOW_RULE_PROP_COUNT; prop++) {
+			if (rule->properties[prop]) {
+				set_bit(compiled.has_property[prop], i);
 			}
 		}
+		i++;
+	}
+}
+
+void
+window_rules_finish(void)
+{
+	zfree(compiled.rules);
+	zfree(compiled.instances);
+	for (size_t prop = 0; prop < LAB_WINDOW_RULE_PROP_COUNT; prop++) {
+		zfree(compiled.has_property[prop]);
+	}
+	compiled.nr_rules = 0;
+	compiled.nr_words = 0;
+
+	/* Invalidate the cache of all views */
+	if (!++compiled.generation) {
+		compiled.generation = 1;
 	}
-	return LAB_PROP_UNSPECIFIED;
+}
+
+void
+window_rules_view_add(struct view *view)
+{
+	view->window_rules.counted = 0;
+	compiled.dirty = true;
+}
+
+void
+window_rules_invalidate(struct view *view)
+{
+	uncount_view(view);
+	view->window_rules.generation = 0;
+	compiled.dirty = true;
+}
+
+void
+window_rules_view_finish(struct view *view)
+{
+	uncount_view(view);
+	zfree(view->window_rules.matches);
+	view->window_rules.generation = 0;
 }
@@ -2,23 +2,48 @@
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
 #include <cairo.h>
+#include <ctype.h>
 #include <pango/pangocairo.h>
 #include <errno.h>
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <wlr/types/wlr_output_layout.h>
 #include "config.h"
 #include "buffer.h"
 #include "common/font.h"
 #include "common/graphic-helpers.h"
+#include "common/hash.h"
+#include "common/int-map.h"
 #include "common/list.h"
+#include "common/macros.h"
 #include "common/mem.h"
+#include "edges.h"
 #include "input/keyboard.h"
 #include "labwc.h"
 #include "view.h"
 #include "workspaces.h"
 #include "xwayland.h"
 
+/* Layout pixels moved per unit of touchpad swipe motion */
+#define SWIPE_SPEED 2.0
+/* Part of the layout width to swipe past for switching */
+#define SWIPE_THRESHOLD 0.2
+
+/*
+ * State of a touchpad swipe between workspaces. The workspaces are moved
+ * by their scene tree positions only, once per frame.
+ */
+static struct workspace_swipe {
+	bool active;
+	bool update_pending;
+	int width;
+	double offset;
+	/* Shown next to the current workspace, NULL if there is none */
+	struct workspace *neighbor;
+} swipe;
+
 /* Internal helpers */
 static size_t
 parse_workspace_index(const char *name)
@@ -52,9 +77,68 @@ parse_workspace_index(const char *name)
 	return index;
 }
 
+/*
+ * Workspaces by number and by name, so that scripted GoToDesktop and
+ * SendToDesktop actions do not walk the list. Rebuilt whenever the list
+ * of workspaces changes.
+ */
+static struct {
+	struct int_map by_index;
+	struct int_map by_name;
+} lookup;
+
+static uint64_t
+hash_name(const char *name)
+{
+	/* Case-insensitive like the name comparison */
+	uint64_t hash = HASH_INIT;
+	for (; *name; name++) {
+		hash = hash_value(hash, tolower((unsigned char)*name));
+	}
+	return hash;
+}
+
 static void
-_osd_update(struct server *server)
+lookup_rebuild(struct server *server)
+{
+	int_map_finish(&lookup.by_index);
+	int_map_finish(&lookup.by_name);
+	size_t index = 0;
+	struct workspace *workspace;
+	wl_list_for_each(workspace, &server->workspaces, link) {
+		int_map_insert(&lookup.by_index, ++index, workspace);
+		/* Of workspaces with the same name, the first one is kept */
+		int_map_insert(&lookup.by_name, hash_name(workspace->name),
+			workspace);
+	}
+}
+
+static struct workspace *
+lookup_name(struct server *server, const char *name)
 {
+	struct workspace *workspace =
+		int_map_lookup(&lookup.by_name, hash_name(name));
+	if (!workspace || !strcasecmp(workspace->name, name)) {
+		return workspace;
+	}
+	/* Hash collision */
+	wl_list_for_each(workspace, &server->workspaces, link) {
+		if (!strcasecmp(workspace->name, name)) {
+			return workspace;
+		}
+	}
+	return NULL;
+}
+
+struct workspace_osd_buffer {
+	float scale;
+	struct lab_data_buffer *buffer;
+};
+
+static struct lab_data_buffer *
+_osd_render(struct workspace *current, float scale)
+{
+	struct server *server = current->server;
 	struct theme *theme = server->theme;
 
 	/* Settings */
@@ -75,77 +159,132 @@ _osd_update(struct server *server)
 	cairo_surface_t *surface;
 	struct workspace *workspace;
 
+	struct lab_data_buffer *buffer = buffer_create_cairo(width, height,
+		scale, true);
+	if (!buffer) {
+		wlr_log(WLR_ERROR, "Failed to allocate buffer for workspace OSD");
+		return NULL;
+	}
+
+	cairo = buffer->cairo;
+
+	/* Background */
+	set_cairo_color(cairo, theme->osd_bg_color);
+	cairo_rectangle(cairo, 0, 0, width, height);
+	cairo_fill(cairo);
+
+	/* Border */
+	set_cairo_color(cairo, theme->osd_border_color);
+	struct wlr_fbox fbox = {
+		.width = width,
+		.height = height,
+	};
+	draw_cairo_border(cairo, fbox, theme->osd_border_width);
+
+	/* Boxes */
+	uint16_t x;
+	if (!hide_boxes) {
+		x = (width - marker_width) / 2;
+		wl_list_for_each(workspace, &server->workspaces, link) {
+			bool active =  workspace == current;
+			set_cairo_color(cairo, server->theme->osd_label_text_color);
+			cairo_rectangle(cairo, x, margin,
+				rect_width - padding, rect_height);
+			cairo_stroke(cairo);
+			if (active) {
+				cairo_rectangle(cairo, x, margin,
+					rect_width - padding, rect_height);
+				cairo_fill(cairo);
+			}
+			x += rect_width + padding;
+		}
+	}
+
+	/* Text */
+	set_cairo_color(cairo, server->theme->osd_label_text_color);
+	PangoLayout *layout = pango_cairo_create_layout(cairo);
+	pango_layout_set_ellipsize(layout, PANGO_ELLIPSIZE_END);
+
+	/* Center workspace indicator on the x axis */
+	int req_width = font_width(&rc.font_osd, current->name);
+	req_width = MIN(req_width, width - 2 * margin);
+	x = (width - req_width) / 2;
+	if (!hide_boxes) {
+		cairo_move_to(cairo, x, margin * 2 + rect_height);
+	} else {
+		cairo_move_to(cairo, x, (height - font_height(&rc.font_osd)) / 2.0);
+	}
+	PangoFontDescription *desc = font_to_pango_desc(&rc.font_osd);
+	//pango_font_description_set_weight(desc, PANGO_WEIGHT_BOLD);
+	pango_layout_set_font_description(layout, desc);
+	pango_layout_set_width(layout, req_width * PANGO_SCALE);
+	pango_font_description_free(desc);
+	pango_layout_set_text(layout, current->name, -1);
+	pango_cairo_show_layout(cairo, layout);
+
+	g_object_unref(layout);
+	surface = cairo_get_target(cairo);
+	cairo_surface_flush(surface);
+
+	return buffer;
+}
+
+/*
+ * The OSD of a workspace only depends on the theme, the workspaces and
+ * the output scale, so it is rendered once per scale and kept until
+ * reconfigure.
+ */
+static struct lab_data_buffer *
+_osd_get_buffer(struct workspace *workspace, float scale)
+{
+	struct workspace_osd_buffer *cached;
+	wl_array_for_each(cached, &workspace->osd_buffers) {
+		if (cached->scale == scale) {
+			return cached->buffer;
+		}
+	}
+
+	struct lab_data_buffer *buffer = _osd_render(workspace, scale);
+	if (!buffer) {
+		return NULL;
+	}
+	cached = wl_array_add(&workspace->osd_buffers, sizeof(*cached));
+	if (!cached) {
+		wlr_buffer_drop(&buffer->base);
+		return NULL;
+	}
+	cached->scale = scale;
+	cached->buffer = buffer;
+	return buffer;
+}
+
+static void
+_osd_drop_buffers(struct workspace *workspace)
+{
+	struct workspace_osd_buffer *cached;
+	wl_array_for_each(cached, &workspace->osd_buffers) {
+		/* Kept alive by the scene while the OSD is shown */
+		wlr_buffer_drop(&cached->buffer->base);
+	}
+	wl_array_release(&workspace->osd_buffers);
+	wl_array_init(&workspace->osd_buffers);
+}
+
+static void
+_osd_update(struct server *server)
+{
 	struct output *output;
 	wl_list_for_each(output, &server->outputs, link) {
 		if (!output_is_usable(output)) {
 			continue;
 		}
-		struct lab_data_buffer *buffer = buffer_create_cairo(width, height,
-			output->wlr_output->scale, true);
+		struct lab_data_buffer *buffer = _osd_get_buffer(
+			server->workspace_current, output->wlr_output->scale);
 		if (!buffer) {
-			wlr_log(WLR_ERROR, "Failed to allocate buffer for workspace OSD");
 			continue;
 		}
-
-		cairo = buffer->cairo;
-
-		/* Background */
-		set_cairo_color(cairo, theme->osd_bg_color);
-		cairo_rectangle(cairo, 0, 0, width, height);
-		cairo_fill(cairo);
-
-		/* Border */
-		set_cairo_color(cairo, theme->osd_border_color);
-		struct wlr_fbox fbox = {
-			.width = width,
-			.height = height,
-		};
-		draw_cairo_border(cairo, fbox, theme->osd_border_width);
-
-		/* Boxes */
-		uint16_t x;
-		if (!hide_boxes) {
-			x = (width - marker_width) / 2;
-			wl_list_for_each(workspace, &server->workspaces, link) {
-				bool active =  workspace == server->workspace_current;
-				set_cairo_color(cairo, server->theme->osd_label_text_color);
-				cairo_rectangle(cairo, x, margin,
-					rect_width - padding, rect_height);
-				cairo_stroke(cairo);
-				if (active) {
-					cairo_rectangle(cairo, x, margin,
-						rect_width - padding, rect_height);
-					cairo_fill(cairo);
-				}
-				x += rect_width + padding;
-			}
-		}
-
-		/* Text */
-		set_cairo_color(cairo, server->theme->osd_label_text_color);
-		PangoLayout *layout = pango_cairo_create_layout(cairo);
-		pango_layout_set_ellipsize(layout, PANGO_ELLIPSIZE_END);
-
-		/* Center workspace indicator on the x axis */
-		int req_width = font_width(&rc.font_osd, server->workspace_current->name);
-		req_width = MIN(req_width, width - 2 * margin);
-		x = (width - req_width) / 2;
-		if (!hide_boxes) {
-			cairo_move_to(cairo, x, margin * 2 + rect_height);
-		} else {
-			cairo_move_to(cairo, x, (height - font_height(&rc.font_osd)) / 2.0);
-		}
-		PangoFontDescription *desc = font_to_pango_desc(&rc.font_osd);
-		//pango_font_description_set_weight(desc, PANGO_WEIGHT_BOLD);
-		pango_layout_set_font_description(layout, desc);
-		pango_layout_set_width(layout, req_width * PANGO_SCALE);
-		pango_font_description_free(desc);
-		pango_layout_set_text(layout, server->workspace_current->name, -1);
-		pango_cairo_show_layout(cairo, layout);
-
-		g_object_unref(layout);
-		surface = cairo_get_target(cairo);
-		cairo_surface_flush(surface);
+		int width = buffer->unscaled_width;
+		int height = buffer->unscaled_height;
 
 		if (!output->workspace_osd) {
 			output->workspace_osd = wlr_scene_buffer_create(
@@ -164,10 +303,7 @@ _osd_update(struct server *server)
 		wlr_scene_node_set_position(&output->workspace_osd->node, lx, ly);
 		wlr_scene_buffer_set_buffer(output->workspace_osd, &buffer->base);
 		wlr_scene_buffer_set_dest_size(output->workspace_osd,
-			buffer->unscaled_width, buffer->unscaled_height);
-
-		/* And finally drop the buffer so it will get destroyed on OSD hide */
-		wlr_buffer_drop(&buffer->base);
+			width, height);
 	}
 }
 
@@ -178,12 +314,12 @@ add_workspace(struct server *server, const char *name)
 	struct workspace *workspace = znew(*workspace);
 	workspace->server = server;
 	workspace->name = xstrdup(name);
-	workspace->tree = wlr_scene_tree_create(server->view_tree);
+	wl_list_init(&workspace->views);
+	wl_list_init(&workspace->mapped_views);
+	wl_array_init(&workspace->osd_buffers);
 	wl_list_append(&server->workspaces, &workspace->link);
 	if (!server->workspace_current) {
 		server->workspace_current = workspace;
-	} else {
-		wlr_scene_node_set_enabled(&workspace->tree->node, false);
 	}
 }
 
@@ -265,6 +401,24 @@ workspaces_init(struct server *server)
 	wl_list_for_each(conf, &rc.workspace_config.workspaces, link) {
 		add_workspace(server, conf->name);
 	}
+	lookup_rebuild(server);
+}
+
+/*
+ * The scene tree of a workspace is only created once a view is put on
+ * it or it is switched to, as many configured workspaces are never used.
+ */
+struct wlr_scene_tree *
+workspaces_get_tree(struct workspace *workspace)
+{
+	assert(workspace);
+	if (!workspace->tree) {
+		struct server *server = workspace->server;
+		workspace->tree = wlr_scene_tree_create(server->view_tree);
+		wlr_scene_node_set_enabled(&workspace->tree->node,
+			workspace == server->workspace_current);
+	}
+	return workspace->tree;
 }
 
 /*
@@ -272,38 +426,50 @@ workspaces_init(struct server *server)
  * when this function is called from desktop_focus_view(), in order to
  * avoid unnecessary extra focus changes and possible recursion.
  */
+static void swipe_reset(struct server *server);
+
 void
 workspaces_switch_to(struct workspace *target, bool update_focus)
 {
 	assert(target);
 	struct server *server = target->server;
+	swipe_reset(server);
 	if (target == server->workspace_current) {
 		return;
 	}
 
 	/* Disable the old workspace */
-	wlr_scene_node_set_enabled(
-		&server->workspace_current->tree->node, false);
-
-	/* Move Omnipresent views to new workspace */
-	struct view *view;
-	enum lab_view_criteria criteria =
-		LAB_VIEW_CRITERIA_CURRENT_WORKSPACE;
-	for_each_view(view, &server->views, criteria) {
-		if (view->visible_on_all_workspaces) {
-			view_move_to_workspace(view, target);
-		}
+	struct workspace *old = server->workspace_current;
+	if (old->tree) {
+		wlr_scene_node_set_enabled(&old->tree->node, false);
 	}
 
 	/* Enable the new workspace */
-	wlr_scene_node_set_enabled(&target->tree->node, true);
+	wlr_scene_node_set_enabled(&workspaces_get_tree(target)->node, true);
 
 	/* Save the last visited workspace */
-	server->workspace_last = server->workspace_current;
+	server->workspace_last = old;
 
 	/* Make sure new views will spawn on the new workspace */
 	server->workspace_current = target;
 
+	/*
+	 * Move omnipresent views to the new workspace. Occlusion and edges
+	 * are updated once for all of them below.
+	 */
+	struct view *view, *tmp;
+	wl_list_for_each_safe(view, tmp, &old->views, workspace_link) {
+		if (view->visible_on_all_workspaces) {
+			view_follow_workspace_switch(view, target);
+		}
+	}
+	wl_list_for_each(view, &target->views, workspace_link) {
+		if (view->mapped && !view->minimized) {
+			/* Create or restore the decoration before focusing */
+			view_set_hidden(view, false);
+		}
+	}
+
 	/*
 	 * Make sure we are focusing what the user sees.
 	 * Only refocus if the focus is not already on an always-on-top view.
@@ -330,6 +496,140 @@ workspaces_switch_to(struct workspace *target, bool update_focus)
 
 	/* Ensure that only currently visible fullscreen windows hide the top layer */
 	desktop_update_top_layer_visiblity(server);
+
+	/* Suspend views on the previous workspace and resume the new ones */
+	desktop_update_occlusion(server);
+	edges_invalidate_all(server);
+}
+
+static void
+swipe_set_neighbor(struct server *server, struct workspace *neighbor)
+{
+	if (swipe.neighbor == neighbor) {
+		return;
+	}
+	if (swipe.neighbor && swipe.neighbor->tree) {
+		wlr_scene_node_set_enabled(&swipe.neighbor->tree->node, false);
+		wlr_scene_node_set_position(&swipe.neighbor->tree->node, 0, 0);
+		/* Hide the views again unless it is switched to */
+		desktop_update_occlusion(server);
+	}
+	swipe.neighbor = neighbor;
+	if (!neighbor) {
+		return;
+	}
+	struct view *view;
+	wl_list_for_each(view, &neighbor->views, workspace_link) {
+		if (view->mapped && !view->minimized) {
+			/* Decorations of hidden workspaces may be trimmed */
+			view_set_hidden(view, false);
+		}
+	}
+	wlr_scene_node_set_enabled(&workspaces_get_tree(neighbor)->node, true);
+}
+
+/* Put the current workspace back where it was, without switching */
+static void
+swipe_reset(struct server *server)
+{
+	if (!swipe.active) {
+		return;
+	}
+	struct workspace *current = server->workspace_current;
+	if (current->tree) {
+		wlr_scene_node_set_position(&current->tree->node, 0, 0);
+	}
+	swipe_set_neighbor(server, NULL);
+	swipe = (struct workspace_swipe){0};
+}
+
+bool
+workspaces_swipe_begin(struct server *server)
+{
+	if (wl_list_length(&server->workspaces) < 2) {
+		return false;
+	}
+	swipe_reset(server);
+	struct wlr_box layout_box;
+	wlr_output_layout_get_box(server->output_layout, NULL, &layout_box);
+	if (wlr_box_empty(&layout_box)) {
+		return false;
+	}
+	swipe.active = true;
+	swipe.width = layout_box.width;
+	return true;
+}
+
+void
+workspaces_swipe_update(struct server *server, double dx)
+{
+	if (!swipe.active) {
+		return;
+	}
+	/* The workspaces follow the fingers */
+	struct workspace *current = server->workspace_current;
+	double offset = swipe.offset + dx * SWIPE_SPEED;
+	if ((offset < 0 && !get_next(current, &server->workspaces, false))
+			|| (offset > 0 && !get_prev(current, &server->workspaces,
+				false))) {
+		offset = 0;
+	}
+	swipe.offset = MAX(-swipe.width, MIN(offset, swipe.width));
+
+	/* Several swipe events may arrive per frame */
+	if (!swipe.update_pending) {
+		swipe.update_pending = true;
+		struct output *output;
+		wl_list_for_each(output, &server->outputs, link) {
+			if (output_is_usable(output)) {
+				wlr_output_schedule_frame(output->wlr_output);
+			}
+		}
+	}
+}
+
+void
+workspaces_flush_swipe(struct server *server)
+{
+	if (!swipe.update_pending) {
+		return;
+	}
+	swipe.update_pending = false;
+
+	struct workspace *current = server->workspace_current;
+	struct workspace *neighbor = NULL;
+	if (swipe.offset < 0) {
+		neighbor = get_next(current, &server->workspaces, false);
+	} else if (swipe.offset > 0) {
+		neighbor = get_prev(current, &server->workspaces, false);
+	}
+	swipe_set_neighbor(server, neighbor);
+
+	int x = (int)swipe.offset;
+	wlr_scene_node_set_position(&workspaces_get_tree(current)->node, x, 0);
+	if (neighbor) {
+		wlr_scene_node_set_position(&neighbor->tree->node,
+			x < 0 ? x + swipe.width : x - swipe.width, 0);
+	}
+}
+
+void
+workspaces_swipe_end(struct server *server, bool cancelled)
+{
+	if (!swipe.active) {
+		return;
+	}
+	struct workspace *current = server->workspace_current;
+	struct workspace *target = NULL;
+	if (!cancelled && fabs(swipe.offset) > swipe.width * SWIPE_THRESHOLD) {
+		target = swipe.offset < 0
+			? get_next(current, &server->workspaces, false)
+			: get_prev(current, &server->workspaces, false);
+	}
+	swipe_reset(server);
+	if (target) {
+		workspaces_switch_to(target, /* update_focus */ true);
+	}
 }
 
 void
@@ -358,17 +658,12 @@ workspaces_find(struct workspace *anchor, const char *name, bool wrap)
 	if (!name) {
 		return NULL;
 	}
-	size_t index = 0;
-	struct workspace *target;
+	struct workspace *target = NULL;
 	size_t wants_index = parse_workspace_index(name);
 	struct wl_list *workspaces = &anchor->server->workspaces;
 
 	if (wants_index) {
-		wl_list_for_each(target, workspaces, link) {
-			if (wants_index == ++index) {
-				return target;
-			}
-		}
+		target = int_map_lookup(&lookup.by_index, wants_index);
 	} else if (!strcasecmp(name, "current")) {
 		return anchor;
 	} else if (!strcasecmp(name, "last")) {
@@ -378,20 +673,21 @@ workspaces_find(struct workspace *anchor, const char *name, bool wrap)
 	} else if (!strcasecmp(name, "right")) {
 		return get_next(anchor, workspaces, wrap);
 	} else {
-		wl_list_for_each(target, workspaces, link) {
-			if (!strcasecmp(target->name, name)) {
-				return target;
-			}
-		}
+		target = lookup_name(anchor->server, name);
 	}
-	wlr_log(WLR_ERROR, "Workspace '%s' not found", name);
-	return NULL;
+	if (!target) {
+		wlr_log(WLR_ERROR, "Workspace '%s' not found", name);
+	}
+	return target;
 }
 
 static void
 destroy_workspace(struct workspace *workspace)
 {
-	wlr_scene_node_destroy(&workspace->tree->node);
+	if (workspace->tree) {
+		wlr_scene_node_destroy(&workspace->tree->node);
+	}
+	_osd_drop_buffers(workspace);
 	zfree(workspace->name);
 	wl_list_remove(&workspace->link);
 	free(workspace);
@@ -407,6 +703,15 @@ workspaces_reconfigure(struct server *server)
 	 *   - Destroy workspaces if fewer workspace are desired
 	 */
 
+	/* A workspace shown by a swipe may be destroyed */
+	swipe_reset(server);
+
+	/* The theme, font or number of workspaces may have changed */
+	struct workspace *workspace;
+	wl_list_for_each(workspace, &server->workspaces, link) {
+		_osd_drop_buffers(workspace);
+	}
+
 	struct wl_list *actual_workspace_link = server->workspaces.next;
 
 	struct workspace *configured_workspace;
@@ -433,6 +738,7 @@ workspaces_reconfigure(struct server *server)
 	}
 
 	if (actual_workspace_link == &server->workspaces) {
+		lookup_rebuild(server);
 		return;
 	}
 
@@ -466,6 +772,7 @@ workspaces_reconfigure(struct server *server)
 		actual_workspace_link = actual_workspace_link->next;
 		destroy_workspace(actual_workspace);
 	}
+	lookup_rebuild(server);
 }
 
 void
@@ -476,4 +783,6 @@ workspaces_destroy(struct server *server)
 		destroy_workspace(workspace);
 	}
 	assert(wl_list_empty(&server->workspaces));
+	int_map_finish(&lookup.by_index);
+	int_map_finish(&lookup.by_name);
 }
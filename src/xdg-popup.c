@@ -10,6 +10,7 @@
 #include "common/mem.h"
 #include "labwc.h"
 #include "node.h"
+#include "surface-map.h"
 #include "view.h"
 
 struct xdg_popup {
@@ -22,16 +23,35 @@ struct xdg_popup {
 	struct wl_listener reposition;
 };
 
+/*
+ * Completion lists and similar popups are repositioned on every key
+ * press, mostly within the same output. The usable area is kept in
+ * layout coordinates so that it stays valid when the view moves, and a
+ * popup inside of it is closest to the output it belongs to anyway.
+ */
+static struct wlr_box
+get_usable_area(struct view *view, int lx, int ly)
+{
+	struct server *server = view->server;
+	if (view->popup_usable_area_generation == server->usable_area_generation
+			&& wlr_box_contains_point(&view->popup_usable_area,
+				lx, ly)) {
+		return view->popup_usable_area;
+	}
+	struct output *output = output_nearest_to(server, lx, ly);
+	view->popup_usable_area = output_usable_area_in_layout_coords(output);
+	view->popup_usable_area_generation = server->usable_area_generation;
+	return view->popup_usable_area;
+}
+
 static void
 popup_unconstrain(struct xdg_popup *popup)
 {
 	struct view *view = popup->parent_view;
-	struct server *server = view->server;
 	struct wlr_box *popup_box = &popup->wlr_popup->current.geometry;
-	struct output *output = output_nearest_to(server,
+	struct wlr_box usable = get_usable_area(view,
 		view->current.x + popup_box->x,
 		view->current.y + popup_box->y);
-	struct wlr_box usable = output_usable_area_in_layout_coords(output);
 
 	struct wlr_box output_toplevel_box = {
 		.x = usable.x - view->current.x,
@@ -134,4 +154,6 @@ xdg_popup_create(struct view *view, struct wlr_xdg_popup *wlr_popup)
 		wlr_scene_xdg_surface_create(parent_tree, wlr_popup->base);
 	node_descriptor_create(wlr_popup->base->surface->data,
 		LAB_NODE_DESC_XDG_POPUP, view);
+
+	surface_map_add_popup(view, wlr_popup->base->surface);
 }
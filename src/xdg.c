@@ -3,19 +3,23 @@
 #include <assert.h>
 #include <wlr/types/wlr_fractional_scale_v1.h>
 
+#include "common/log.h"
 #include "common/macros.h"
 #include "common/mem.h"
+#include "common/trace.h"
+#include "configure-stats.h"
 #include "decorations.h"
 #include "labwc.h"
 #include "node.h"
+#include "placement.h"
 #include "snap-constraints.h"
+#include "transaction.h"
 #include "view.h"
 #include "view-impl-common.h"
 #include "window-rules.h"
 #include "workspaces.h"
 
-#define LAB_XDG_SHELL_VERSION (3)
-#define CONFIGURE_TIMEOUT_MS 100
+#define LAB_XDG_SHELL_VERSION (6)
 
 static struct xdg_toplevel_view *
 xdg_toplevel_view_from_view(struct view *view)
@@ -79,7 +83,8 @@ static bool
 has_ssd(struct view *view)
 {
 	/* Window-rules take priority if they exist for this view */
-	switch (window_rules_get_property(view, "serverDecoration")) {
+	switch (window_rules_get_property(view,
+			LAB_WINDOW_RULE_PROP_SERVER_DECORATION)) {
 	case LAB_PROP_TRUE:
 		return true;
 	case LAB_PROP_FALSE:
@@ -109,10 +114,13 @@ has_ssd(struct view *view)
 static void
 handle_commit(struct wl_listener *listener, void *data)
 {
+	TRACE_FUNC();
 	struct view *view = wl_container_of(listener, view, commit);
 	struct wlr_xdg_surface *xdg_surface = xdg_surface_from_view(view);
 	assert(view->surface);
 
+	view_update_content_type(view);
+
 	struct wlr_box size;
 	wlr_xdg_surface_get_geometry(xdg_surface, &size);
 
@@ -130,7 +138,7 @@ handle_commit(struct wl_listener *listener, void *data)
 		wlr_surface_get_extends(xdg_surface->surface, &extent);
 		if (extent.width == view->pending.width
 				&& extent.height == view->pending.height) {
-			wlr_log(WLR_DEBUG, "window geometry for client (%s) "
+			lab_log_debug("window geometry for client (%s) "
 				"appears to be incorrect - ignoring",
 				view_get_string_prop(view, "app_id"));
 			size = extent; /* Use surface extent instead */
@@ -144,6 +152,7 @@ handle_commit(struct wl_listener *listener, void *data)
 	uint32_t serial = view->pending_configure_serial;
 	if (serial > 0 && serial == xdg_surface->current.configure_serial) {
 		assert(view->pending_configure_timeout);
+		configure_stats_acked(view);
 		wl_event_source_remove(view->pending_configure_timeout);
 		view->pending_configure_serial = 0;
 		view->pending_configure_timeout = NULL;
@@ -191,6 +200,9 @@ handle_commit(struct wl_listener *listener, void *data)
 			toplevel->scheduled.height = view->current.height;
 		}
 	}
+
+	transaction_view_ready(view);
+	interactive_resize_flush(view);
 }
 
 static int
@@ -200,9 +212,10 @@ handle_configure_timeout(void *data)
 	assert(view->pending_configure_serial > 0);
 	assert(view->pending_configure_timeout);
 
+	int elapsed_ms = configure_stats_timed_out(view);
 	const char *app_id = view_get_string_prop(view, "app_id");
 	wlr_log(WLR_INFO, "client (%s) did not respond to configure request "
-		"in %d ms", app_id, CONFIGURE_TIMEOUT_MS);
+		"in %d ms", app_id, elapsed_ms);
 
 	wl_event_source_remove(view->pending_configure_timeout);
 	view->pending_configure_serial = 0;
@@ -215,6 +228,9 @@ handle_configure_timeout(void *data)
 	snap_constraints_update(view);
 	view->pending = view->current;
 
+	transaction_view_ready(view);
+	interactive_resize_flush(view);
+
 	return 0; /* ignored per wl_event_loop docs */
 }
 
@@ -228,7 +244,8 @@ set_pending_configure_serial(struct view *view, uint32_t serial)
 				handle_configure_timeout, view);
 	}
 	wl_event_source_timer_update(view->pending_configure_timeout,
-		CONFIGURE_TIMEOUT_MS);
+		configure_stats_sent(view));
+	transaction_view_configured(view);
 }
 
 static void
@@ -244,6 +261,7 @@ handle_destroy(struct wl_listener *listener, void *data)
 
 	/* Remove xdg-shell view specific listeners */
 	wl_list_remove(&xdg_toplevel_view->set_app_id.link);
+	wl_list_remove(&xdg_toplevel_view->set_parent.link);
 	wl_list_remove(&xdg_toplevel_view->new_popup.link);
 
 	if (view->pending_configure_timeout) {
@@ -347,6 +365,14 @@ handle_set_app_id(struct wl_listener *listener, void *data)
 	view_update_app_id(view);
 }
 
+static void
+handle_set_parent(struct wl_listener *listener, void *data)
+{
+	struct xdg_toplevel_view *xdg_toplevel_view =
+		wl_container_of(listener, xdg_toplevel_view, set_parent);
+	view_update_family(&xdg_toplevel_view->base);
+}
+
 static void
 xdg_toplevel_view_configure(struct view *view, struct wlr_box geo)
 {
@@ -412,31 +438,6 @@ xdg_toplevel_view_get_root(struct view *view)
 	return (struct view *)surface->data;
 }
 
-static void
-xdg_toplevel_view_append_children(struct view *self, struct wl_array *children)
-{
-	struct wlr_xdg_toplevel *toplevel = xdg_toplevel_from_view(self);
-	struct view *view;
-
-	wl_list_for_each_reverse(view, &self->server->views, link)
-	{
-		if (view == self) {
-			continue;
-		}
-		if (view->type != LAB_XDG_SHELL_VIEW) {
-			continue;
-		}
-		if (!view->mapped && !view->minimized) {
-			continue;
-		}
-		if (top_parent_of(view) != toplevel) {
-			continue;
-		}
-		struct view **child = wl_array_add(children, sizeof(*child));
-		*child = view;
-	}
-}
-
 static void
 xdg_toplevel_view_set_activated(struct view *view, bool activated)
 {
@@ -450,6 +451,13 @@ xdg_toplevel_view_set_fullscreen(struct view *view, bool fullscreen)
 		fullscreen);
 }
 
+static void
+xdg_toplevel_view_set_suspended(struct view *view, bool suspended)
+{
+	wlr_xdg_toplevel_set_suspended(xdg_toplevel_from_view(view),
+		suspended);
+}
+
 static void
 xdg_toplevel_view_notify_tiled(struct view *view)
 {
@@ -530,7 +538,9 @@ set_initial_position(struct view *view)
 	}
 
 	/* All other views are placed according to a configured strategy */
-	view_place_initial(view, /* allow_cursor */ true);
+	if (!placement_memory_place(view)) {
+		view_place_initial(view, /* allow_cursor */ true);
+	}
 }
 
 static const char *
@@ -680,6 +690,7 @@ static const struct view_impl xdg_toplevel_view_impl = {
 	.map = xdg_toplevel_view_map,
 	.set_activated = xdg_toplevel_view_set_activated,
 	.set_fullscreen = xdg_toplevel_view_set_fullscreen,
+	.set_suspended = xdg_toplevel_view_set_suspended,
 	.notify_tiled = xdg_toplevel_view_notify_tiled,
 	.unmap = xdg_toplevel_view_unmap,
 	.maximize = xdg_toplevel_view_maximize,
@@ -687,7 +698,6 @@ static const struct view_impl xdg_toplevel_view_impl = {
 	.move_to_front = view_impl_move_to_front,
 	.move_to_back = view_impl_move_to_back,
 	.get_root = xdg_toplevel_view_get_root,
-	.append_children = xdg_toplevel_view_append_children,
 	.contains_window_type = xdg_toplevel_view_contains_window_type,
 	.get_pid = xdg_view_get_pid,
 };
@@ -720,7 +730,8 @@ xdg_activation_handle_request(struct wl_listener *listener, void *data)
 	 * for the seat / serial being correct and then allow the request.
 	 */
 
-	if (window_rules_get_property(view, "ignoreFocusRequest") == LAB_PROP_TRUE) {
+	if (window_rules_get_property(view,
+			LAB_WINDOW_RULE_PROP_IGNORE_FOCUS_REQUEST) == LAB_PROP_TRUE) {
 		wlr_log(WLR_INFO, "Ignoring focus request due to window rule configuration");
 		return;
 	}
@@ -778,7 +789,8 @@ xdg_surface_new(struct wl_listener *listener, void *data)
 	}
 
 	view->workspace = server->workspace_current;
-	view->scene_tree = wlr_scene_tree_create(view->workspace->tree);
+	view->scene_tree = wlr_scene_tree_create(
+		workspaces_get_tree(view->workspace));
 	wlr_scene_node_set_enabled(&view->scene_tree->node, false);
 
 	struct wlr_scene_tree *tree = wlr_scene_xdg_surface_create(
@@ -835,9 +847,10 @@ xdg_surface_new(struct wl_listener *listener, void *data)
 
 	/* Events specific to XDG toplevel views */
 	CONNECT_SIGNAL(toplevel, xdg_toplevel_view, set_app_id);
+	CONNECT_SIGNAL(toplevel, xdg_toplevel_view, set_parent);
 	CONNECT_SIGNAL(xdg_surface, xdg_toplevel_view, new_popup);
 
-	wl_list_insert(&server->views, &view->link);
+	view_stack_add(view);
 }
 
 void
@@ -0,0 +1,435 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * _NET_WM_SYNC_REQUEST support for XWayland views
+ *
+ * Before a view is resized, a client supporting the protocol is sent a
+ * sync request with a new counter value. It sets its XSync counter to
+ * that value once it has redrawn at the new size, and an XSync alarm
+ * on the counter notifies us. The configure is considered acknowledged
+ * only then, so that interactive resizes keep one configure in flight
+ * like xdg-shell views do with configure serials.
+ *
+ * wlroots does not expose its window manager connection, so we use a
+ * connection of our own. It is opened when Xwayland has become ready,
+ * which is the only point where the blocking connection setup cannot
+ * wait on Xwayland waiting on us. Everything else is asynchronous: the
+ * replies are polled for from the event loop. Like the connection of
+ * the window manager, it does not keep a lazily started Xwayland from
+ * terminating.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/util/log.h>
+#include <wlr/xwayland.h>
+#include <xcb/sync.h>
+#include <xcb/xcb.h>
+#include <xcb/xfixes.h>
+#include "labwc.h"
+#include "xwayland.h"
+
+enum atom {
+	ATOM_WM_PROTOCOLS,
+	ATOM_NET_WM_SYNC_REQUEST,
+	ATOM_NET_WM_SYNC_REQUEST_COUNTER,
+	ATOM_COUNT,
+};
+
+static const char *const atom_names[] = {
+	[ATOM_WM_PROTOCOLS] = "WM_PROTOCOLS",
+	[ATOM_NET_WM_SYNC_REQUEST] = "_NET_WM_SYNC_REQUEST",
+	[ATOM_NET_WM_SYNC_REQUEST_COUNTER] = "_NET_WM_SYNC_REQUEST_COUNTER",
+};
+
+static struct {
+	xcb_connection_t *conn;
+	struct wl_event_source *event_source;
+	struct server *server;
+	xcb_atom_t atoms[ATOM_COUNT];
+	/* Sequence numbers of the setup replies still awaited, 0 if none */
+	unsigned int atom_requests[ATOM_COUNT];
+	unsigned int xfixes_request;
+	/* The atoms are known and SYNC can be used */
+	bool ready;
+	uint8_t first_event;
+} x11;
+
+static void
+reset_views(bool lost)
+{
+	struct xwayland_view *xwayland_view;
+	wl_list_for_each(xwayland_view, &x11.server->xwayland_stack,
+			stack_link) {
+		bool pending = xwayland_view->sync.pending;
+		xwayland_view->sync = (struct xwayland_sync){0};
+		if (lost && pending) {
+			/* No alarm is coming anymore */
+			xwayland_view_sync_done(&xwayland_view->base);
+		}
+	}
+}
+
+static void
+disconnect(bool lost)
+{
+	if (!x11.conn) {
+		return;
+	}
+	reset_views(lost);
+	if (x11.event_source) {
+		wl_event_source_remove(x11.event_source);
+		x11.event_source = NULL;
+	}
+	xcb_disconnect(x11.conn);
+	x11.conn = NULL;
+	x11.ready = false;
+}
+
+/*
+ * Returns false while the reply to @request has not arrived. Once it has,
+ * *@request is reset and *@reply set, to NULL if the request failed.
+ */
+static bool
+poll_reply(unsigned int *request, void **reply)
+{
+	xcb_generic_error_t *error = NULL;
+	*reply = NULL;
+	if (!xcb_poll_for_reply(x11.conn, *request, reply, &error)) {
+		return false;
+	}
+	free(error);
+	*request = 0;
+	return true;
+}
+
+static struct xwayland_view *
+view_from_alarm(xcb_sync_alarm_t alarm)
+{
+	struct xwayland_view *xwayland_view;
+	wl_list_for_each(xwayland_view, &x11.server->xwayland_stack,
+			stack_link) {
+		if (xwayland_view->sync.alarm == alarm) {
+			return xwayland_view;
+		}
+	}
+	return NULL;
+}
+
+static void
+handle_alarm_notify(xcb_sync_alarm_notify_event_t *event)
+{
+	struct xwayland_view *xwayland_view = view_from_alarm(event->alarm);
+	if (!xwayland_view || !xwayland_view->sync.pending) {
+		return;
+	}
+	uint64_t value = (uint64_t)(uint32_t)event->counter_value.hi << 32
+		| event->counter_value.lo;
+	if (value < xwayland_view->sync.value) {
+		/* Reached an earlier value, keep waiting */
+		return;
+	}
+	xwayland_view->sync.pending = false;
+	xwayland_view_sync_done(&xwayland_view->base);
+}
+
+static void
+create_alarm(struct xwayland_sync *sync)
+{
+	sync->alarm = xcb_generate_id(x11.conn);
+	xcb_sync_create_alarm_value_list_t values = {
+		.counter = sync->counter,
+		.valueType = XCB_SYNC_VALUETYPE_ABSOLUTE,
+		.value = {
+			.hi = sync->value >> 32,
+			.lo = sync->value & UINT32_MAX,
+		},
+		.testType = XCB_SYNC_TESTTYPE_POSITIVE_COMPARISON,
+		/* Inactive once triggered, until a new value is set */
+		.delta = { 0 },
+		.events = true,
+	};
+	xcb_sync_create_alarm_aux(x11.conn, sync->alarm,
+		XCB_SYNC_CA_COUNTER | XCB_SYNC_CA_VALUE_TYPE | XCB_SYNC_CA_VALUE
+			| XCB_SYNC_CA_TEST_TYPE | XCB_SYNC_CA_DELTA
+			| XCB_SYNC_CA_EVENTS,
+		&values);
+	xcb_flush(x11.conn);
+}
+
+/*
+ * A view first waits for its _NET_WM_SYNC_REQUEST_COUNTER property, then
+ * for the current value of the counter, which the alarm starts from.
+ * Returns true if a reply has been handled.
+ */
+static bool
+poll_view(struct xwayland_sync *sync)
+{
+	if (!sync->request) {
+		return false;
+	}
+
+	if (!sync->counter) {
+		xcb_get_property_reply_t *reply;
+		if (!poll_reply(&sync->request, (void **)&reply)) {
+			return false;
+		}
+		/* The first one is the basic counter, a second one is extended */
+		if (reply && reply->format == 32
+				&& xcb_get_property_value_length(reply) >= 4) {
+			sync->counter =
+				*(uint32_t *)xcb_get_property_value(reply);
+		}
+		free(reply);
+		if (sync->counter) {
+			sync->request = xcb_sync_query_counter(x11.conn,
+				sync->counter).sequence;
+			xcb_flush(x11.conn);
+		}
+		return true;
+	}
+
+	xcb_sync_query_counter_reply_t *reply;
+	if (!poll_reply(&sync->request, (void **)&reply)) {
+		return false;
+	}
+	if (!reply) {
+		sync->counter = XCB_NONE;
+		return true;
+	}
+	sync->value = (uint64_t)(uint32_t)reply->counter_value.hi << 32
+		| reply->counter_value.lo;
+	free(reply);
+	create_alarm(sync);
+	return true;
+}
+
+static bool
+poll_xfixes_version(void)
+{
+	xcb_xfixes_query_version_reply_t *reply;
+	if (!x11.xfixes_request
+			|| !poll_reply(&x11.xfixes_request, (void **)&reply)) {
+		return false;
+	}
+	if (reply && reply->major_version >= 6) {
+		xcb_xfixes_set_client_disconnect_mode(x11.conn,
+			XCB_XFIXES_CLIENT_DISCONNECT_FLAGS_TERMINATE);
+		xcb_flush(x11.conn);
+	} else {
+		wlr_log(WLR_INFO, "Xwayland lacks XFixes 6, the connection for "
+			"sync requests keeps it running");
+	}
+	free(reply);
+	return true;
+}
+
+/* Returns true once the atoms have been interned and SYNC checked */
+static bool
+poll_setup(void)
+{
+	for (size_t i = 0; i < ATOM_COUNT; i++) {
+		if (!x11.atom_requests[i]) {
+			continue;
+		}
+		xcb_intern_atom_reply_t *reply;
+		if (!poll_reply(&x11.atom_requests[i], (void **)&reply)) {
+			return false;
+		}
+		x11.atoms[i] = reply ? reply->atom : XCB_ATOM_NONE;
+		free(reply);
+	}
+
+	/*
+	 * The extensions were queried before the atoms were interned, so
+	 * their replies are in and this does not block.
+	 */
+	const xcb_query_extension_reply_t *ext =
+		xcb_get_extension_data(x11.conn, &xcb_sync_id);
+	if (!ext || !ext->present) {
+		wlr_log(WLR_INFO, "Xwayland lacks the SYNC extension");
+		disconnect(/*lost*/ false);
+		return false;
+	}
+	x11.first_event = ext->first_event;
+	xcb_discard_reply(x11.conn, xcb_sync_initialize(x11.conn,
+		XCB_SYNC_MAJOR_VERSION, XCB_SYNC_MINOR_VERSION).sequence);
+
+	ext = xcb_get_extension_data(x11.conn, &xcb_xfixes_id);
+	if (ext && ext->present) {
+		x11.xfixes_request = xcb_xfixes_query_version(x11.conn,
+			XCB_XFIXES_MAJOR_VERSION, XCB_XFIXES_MINOR_VERSION).sequence;
+	}
+	xcb_flush(x11.conn);
+	x11.ready = true;
+
+	/* Views mapped meanwhile */
+	struct xwayland_view *xwayland_view;
+	wl_list_for_each(xwayland_view, &x11.server->xwayland_stack,
+			stack_link) {
+		if (xwayland_view->base.mapped) {
+			xwayland_sync_init(xwayland_view);
+		}
+	}
+	return true;
+}
+
+static void
+poll_replies(void)
+{
+	if (!x11.ready && !poll_setup()) {
+		return;
+	}
+	/*
+	 * Polling for one reply may read others into the buffer of xcb,
+	 * which leaves no readable event behind. Keep going until none of
+	 * the replies has arrived.
+	 */
+	bool progress = true;
+	while (progress && x11.conn) {
+		progress = poll_xfixes_version();
+		struct xwayland_view *xwayland_view;
+		wl_list_for_each(xwayland_view, &x11.server->xwayland_stack,
+				stack_link) {
+			progress |= poll_view(&xwayland_view->sync);
+		}
+	}
+}
+
+static int
+handle_x11_event(int fd, uint32_t mask, void *data)
+{
+	if (mask & (WL_EVENT_HANGUP | WL_EVENT_ERROR)) {
+		wlr_log(WLR_INFO, "lost X11 connection for sync requests");
+		disconnect(/*lost*/ true);
+		return 0;
+	}
+
+	xcb_generic_event_t *event;
+	while ((event = xcb_poll_for_event(x11.conn))) {
+		uint8_t type = event->response_type & ~0x80;
+		if (x11.ready && type == x11.first_event + XCB_SYNC_ALARM_NOTIFY) {
+			handle_alarm_notify((xcb_sync_alarm_notify_event_t *)event);
+		}
+		free(event);
+	}
+	if (xcb_connection_has_error(x11.conn)) {
+		disconnect(/*lost*/ true);
+		return 0;
+	}
+	poll_replies();
+	return 0;
+}
+
+void
+xwayland_sync_connect(struct server *server)
+{
+	/* Xwayland has been restarted */
+	disconnect(/*lost*/ true);
+
+	x11.server = server;
+	x11.conn = xcb_connect(server->xwayland->display_name, NULL);
+	if (xcb_connection_has_error(x11.conn)) {
+		wlr_log(WLR_ERROR, "cannot connect to Xwayland for sync requests");
+		xcb_disconnect(x11.conn);
+		x11.conn = NULL;
+		return;
+	}
+
+	xcb_prefetch_extension_data(x11.conn, &xcb_sync_id);
+	xcb_prefetch_extension_data(x11.conn, &xcb_xfixes_id);
+	for (size_t i = 0; i < ATOM_COUNT; i++) {
+		x11.atom_requests[i] = xcb_intern_atom(x11.conn, false,
+			strlen(atom_names[i]), atom_names[i]).sequence;
+	}
+	xcb_flush(x11.conn);
+
+	x11.event_source = wl_event_loop_add_fd(server->wl_event_loop,
+		xcb_get_file_descriptor(x11.conn), WL_EVENT_READABLE,
+		handle_x11_event, NULL);
+}
+
+void
+xwayland_sync_disconnect(void)
+{
+	disconnect(/*lost*/ false);
+}
+
+static bool
+supports_sync_request(struct wlr_xwayland_surface *xsurface)
+{
+	for (size_t i = 0; i < xsurface->protocols_len; i++) {
+		if (xsurface->protocols[i] == x11.atoms[ATOM_NET_WM_SYNC_REQUEST]) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void
+xwayland_sync_init(struct xwayland_view *xwayland_view)
+{
+	struct xwayland_sync *sync = &xwayland_view->sync;
+	if (!x11.ready || sync->counter || sync->request) {
+		return;
+	}
+	struct wlr_xwayland_surface *xsurface = xwayland_view->xwayland_surface;
+	if (!supports_sync_request(xsurface)) {
+		return;
+	}
+	sync->request = xcb_get_property(x11.conn, false, xsurface->window_id,
+		x11.atoms[ATOM_NET_WM_SYNC_REQUEST_COUNTER],
+		XCB_ATOM_CARDINAL, 0, 2).sequence;
+	xcb_flush(x11.conn);
+}
+
+bool
+xwayland_sync_request(struct xwayland_view *xwayland_view)
+{
+	struct xwayland_sync *sync = &xwayland_view->sync;
+	if (!sync->alarm || !x11.conn) {
+		return false;
+	}
+	sync->value++;
+	sync->pending = true;
+
+	xcb_sync_change_alarm_value_list_t values = {
+		.value = {
+			.hi = sync->value >> 32,
+			.lo = sync->value & UINT32_MAX,
+		},
+	};
+	xcb_sync_change_alarm_aux(x11.conn, sync->alarm, XCB_SYNC_CA_VALUE,
+		&values);
+
+	xcb_client_message_event_t event = {
+		.response_type = XCB_CLIENT_MESSAGE,
+		.format = 32,
+		.window = xwayland_view->xwayland_surface->window_id,
+		.type = x11.atoms[ATOM_WM_PROTOCOLS],
+		.data.data32 = {
+			x11.atoms[ATOM_NET_WM_SYNC_REQUEST],
+			XCB_CURRENT_TIME,
+			sync->value & UINT32_MAX,
+			sync->value >> 32,
+		},
+	};
+	xcb_send_event(x11.conn, false, event.window, XCB_EVENT_MASK_NO_EVENT,
+		(const char *)&event);
+	/* Sent ahead of the ConfigureNotify from the window manager */
+	xcb_flush(x11.conn);
+	return true;
+}
+
+void
+xwayland_sync_finish(struct xwayland_view *xwayland_view)
+{
+	struct xwayland_sync *sync = &xwayland_view->sync;
+	if (x11.conn && sync->request) {
+		xcb_discard_reply(x11.conn, sync->request);
+	}
+	if (x11.conn && sync->alarm) {
+		xcb_sync_destroy_alarm(x11.conn, sync->alarm);
+		xcb_flush(x11.conn);
+	}
+	*sync = (struct xwayland_sync){0};
+}
@@ -7,6 +7,15 @@
 #include "labwc.h"
 #include "xwayland.h"
 
+static void
+add_focus_candidate(struct xwayland_unmanaged *unmanaged)
+{
+	if (wl_list_empty(&unmanaged->focus_link)) {
+		wl_list_append(&unmanaged->server->unmanaged_focus_candidates,
+			&unmanaged->focus_link);
+	}
+}
+
 static void
 handle_grab_focus(struct wl_listener *listener, void *data)
 {
@@ -15,6 +24,7 @@ handle_grab_focus(struct wl_listener *listener, void *data)
 
 	unmanaged->ever_grabbed_focus = true;
 	if (unmanaged->node) {
+		add_focus_candidate(unmanaged);
 		assert(unmanaged->xwayland_surface->surface);
 		seat_focus_surface(&unmanaged->server->seat,
 			unmanaged->xwayland_surface->surface);
@@ -63,6 +73,7 @@ handle_map(struct wl_listener *listener, void *data)
 
 	if (wlr_xwayland_or_surface_wants_focus(xsurface)
 			|| unmanaged->ever_grabbed_focus) {
+		add_focus_candidate(unmanaged);
 		seat_focus_surface(&unmanaged->server->seat, xsurface->surface);
 	}
 
@@ -77,16 +88,17 @@ handle_map(struct wl_listener *listener, void *data)
 static void
 focus_next_surface(struct server *server, struct wlr_xwayland_surface *xsurface)
 {
-	/* Try to focus on last created unmanaged xwayland surface */
-	struct xwayland_unmanaged *u;
-	struct wl_list *list = &server->unmanaged_surfaces;
-	wl_list_for_each_reverse(u, list, link) {
-		struct wlr_xwayland_surface *prev = u->xwayland_surface;
-		if (wlr_xwayland_or_surface_wants_focus(prev)
-				|| u->ever_grabbed_focus) {
-			seat_focus_surface(&server->seat, prev->surface);
-			return;
-		}
+	/*
+	 * Try to focus on the last mapped unmanaged xwayland surface which
+	 * wants focus. The candidates are kept in a separate list so this
+	 * does not scan all tooltips and popups.
+	 */
+	struct wl_list *list = &server->unmanaged_focus_candidates;
+	if (!wl_list_empty(list)) {
+		struct xwayland_unmanaged *u =
+			wl_container_of(list->prev, u, focus_link);
+		seat_focus_surface(&server->seat, u->xwayland_surface->surface);
+		return;
 	}
 
 	/*
@@ -107,6 +119,8 @@ handle_unmap(struct wl_listener *listener, void *data)
 	assert(unmanaged->node);
 
 	wl_list_remove(&unmanaged->link);
+	wl_list_remove(&unmanaged->focus_link);
+	wl_list_init(&unmanaged->focus_link);
 	wl_list_remove(&unmanaged->set_geometry.link);
 	wlr_scene_node_set_enabled(unmanaged->node, false);
 
@@ -231,6 +245,7 @@ xwayland_unmanaged_create(struct server *server,
 	struct xwayland_unmanaged *unmanaged = znew(*unmanaged);
 	unmanaged->server = server;
 	unmanaged->xwayland_surface = xsurface;
+	wl_list_init(&unmanaged->focus_link);
 	/*
 	 * xsurface->data is presumed to be a (struct view *) if set,
 	 * so it must be left NULL for an unmanaged surface (it should
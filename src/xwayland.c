@@ -1,20 +1,31 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 #include <wlr/xwayland.h>
 #include "common/array.h"
 #include "common/macros.h"
 #include "common/mem.h"
+#include "common/time-helpers.h"
+#include "common/trace.h"
+#include "configure-stats.h"
 #include "labwc.h"
 #include "node.h"
+#include "placement.h"
 #include "ssd.h"
+#include "transaction.h"
 #include "view.h"
 #include "view-impl-common.h"
 #include "window-rules.h"
 #include "workspaces.h"
 #include "xwayland.h"
 
+
 static void xwayland_view_unmap(struct view *view, bool client_request);
 
 static bool
@@ -184,7 +195,8 @@ want_deco(struct wlr_xwayland_surface *xwayland_surface)
 	struct view *view = (struct view *)xwayland_surface->data;
 
 	/* Window-rules take priority if they exist for this view */
-	switch (window_rules_get_property(view, "serverDecoration")) {
+	switch (window_rules_get_property(view,
+			LAB_WINDOW_RULE_PROP_SERVER_DECORATION)) {
 	case LAB_PROP_TRUE:
 		return true;
 	case LAB_PROP_FALSE:
@@ -197,12 +209,25 @@ want_deco(struct wlr_xwayland_surface *xwayland_surface)
 		WLR_XWAYLAND_SURFACE_DECORATIONS_ALL;
 }
 
+static void
+configure_acked(struct view *view)
+{
+	if (view->pending_configure_timeout) {
+		configure_stats_acked(view);
+		wl_event_source_remove(view->pending_configure_timeout);
+		view->pending_configure_timeout = NULL;
+	}
+}
+
 static void
 handle_commit(struct wl_listener *listener, void *data)
 {
+	TRACE_FUNC();
 	struct view *view = wl_container_of(listener, view, commit);
 	assert(data && data == view->surface);
 
+	view_update_content_type(view);
+
 	/* Must receive commit signal before accessing surface->current* */
 	struct wlr_surface_state *state = &view->surface->current;
 	struct wlr_box *current = &view->current;
@@ -215,9 +240,65 @@ handle_commit(struct wl_listener *listener, void *data)
 	 */
 	if (current->width != state->width || current->height != state->height) {
 		view_impl_apply_geometry(view, state->width, state->height);
+
+		/*
+		 * X11 has no configure serials, so unless the client
+		 * answers sync requests, treat any size change as the
+		 * response to the configure in flight (the client may
+		 * have picked a size other than the one requested).
+		 */
+		if (!xwayland_view_from_view(view)->sync.pending) {
+			configure_acked(view);
+		}
+		transaction_view_ready(view);
+		interactive_resize_flush(view);
 	}
 }
 
+/* Called once the client has redrawn after a sync request */
+void
+xwayland_view_sync_done(struct view *view)
+{
+	/* It may have kept its size, so there might be no commit to wait for */
+	configure_acked(view);
+	transaction_view_ready(view);
+	interactive_resize_flush(view);
+}
+
+static int
+handle_configure_timeout(void *data)
+{
+	struct view *view = data;
+	assert(view->pending_configure_timeout);
+
+	int elapsed_ms = configure_stats_timed_out(view);
+	const char *class = view_get_string_prop(view, "class");
+	wlr_log(WLR_INFO, "client (%s) did not respond to configure request "
+		"in %d ms", class, elapsed_ms);
+
+	wl_event_source_remove(view->pending_configure_timeout);
+	view->pending_configure_timeout = NULL;
+	xwayland_view_from_view(view)->sync.pending = false;
+
+	transaction_view_ready(view);
+	interactive_resize_flush(view);
+
+	return 0; /* ignored per wl_event_loop docs */
+}
+
+static void
+set_pending_configure_timeout(struct view *view)
+{
+	if (!view->pending_configure_timeout) {
+		view->pending_configure_timeout =
+			wl_event_loop_add_timer(view->server->wl_event_loop,
+				handle_configure_timeout, view);
+	}
+	wl_event_source_timer_update(view->pending_configure_timeout,
+		configure_stats_sent(view));
+	transaction_view_configured(view);
+}
+
 static void
 handle_request_move(struct wl_listener *listener, void *data)
 {
@@ -313,6 +394,7 @@ handle_destroy(struct wl_listener *listener, void *data)
 		wl_list_remove(&view->surface_destroy.link);
 	}
 	view->surface = NULL;
+	xwayland_sync_finish(xwayland_view);
 
 	/*
 	 * Break view <-> xsurface association.  Note that the xsurface
@@ -322,6 +404,7 @@ handle_destroy(struct wl_listener *listener, void *data)
 	 */
 	xwayland_view->xwayland_surface->data = NULL;
 	xwayland_view->xwayland_surface = NULL;
+	wl_list_remove(&xwayland_view->stack_link);
 
 	/* Remove XWayland view specific listeners */
 	wl_list_remove(&xwayland_view->associate.link);
@@ -331,11 +414,21 @@ handle_destroy(struct wl_listener *listener, void *data)
 	wl_list_remove(&xwayland_view->set_class.link);
 	wl_list_remove(&xwayland_view->set_decorations.link);
 	wl_list_remove(&xwayland_view->set_override_redirect.link);
+	wl_list_remove(&xwayland_view->set_parent.link);
 	wl_list_remove(&xwayland_view->set_strut_partial.link);
 	wl_list_remove(&xwayland_view->set_window_type.link);
 	wl_list_remove(&xwayland_view->focus_in.link);
 	wl_list_remove(&xwayland_view->map_request.link);
 
+	if (view->pending_configure_timeout) {
+		wl_event_source_remove(view->pending_configure_timeout);
+		view->pending_configure_timeout = NULL;
+	}
+	if (xwayland_view->configure_request_idle) {
+		wl_event_source_remove(xwayland_view->configure_request_idle);
+		xwayland_view->configure_request_idle = NULL;
+	}
+
 	view_destroy(view);
 }
 
@@ -343,8 +436,6 @@ static void
 xwayland_view_configure(struct view *view, struct wlr_box geo)
 {
 	view->pending = geo;
-	wlr_xwayland_surface_configure(xwayland_surface_from_view(view),
-		geo.x, geo.y, geo.width, geo.height);
 
 	/*
 	 * For unknown reasons, XWayland surfaces that are completely
@@ -357,29 +448,35 @@ xwayland_view_configure(struct view *view, struct wlr_box geo)
 		!wlr_output_layout_intersects(view->server->output_layout, NULL,
 			&view->current);
 
+	bool resizing = !is_offscreen && (view->current.width != geo.width
+		|| view->current.height != geo.height);
+	if (resizing && view->surface) {
+		xwayland_sync_request(xwayland_view_from_view(view));
+	}
+	wlr_xwayland_surface_configure(xwayland_surface_from_view(view),
+		geo.x, geo.y, geo.width, geo.height);
+
 	/* If not resizing, process the move immediately */
-	if (is_offscreen || (view->current.width == geo.width
-			&& view->current.height == geo.height)) {
+	if (!resizing) {
 		view->current.x = geo.x;
 		view->current.y = geo.y;
 		view_moved(view);
+	} else if (view->surface) {
+		/* Resizing, wait for the client to commit the new size */
+		set_pending_configure_timeout(view);
 	}
 }
 
 static void
-handle_request_configure(struct wl_listener *listener, void *data)
+apply_configure_request(struct xwayland_view *xwayland_view)
 {
-	struct xwayland_view *xwayland_view =
-		wl_container_of(listener, xwayland_view, request_configure);
 	struct view *view = &xwayland_view->base;
-	struct wlr_xwayland_surface_configure_event *event = data;
 	bool ignore_configure_requests = window_rules_get_property(
-		view, "ignoreConfigureRequest") == LAB_PROP_TRUE;
+		view, LAB_WINDOW_RULE_PROP_IGNORE_CONFIGURE_REQUEST) == LAB_PROP_TRUE;
 
 	if (view_is_floating(view) && !ignore_configure_requests) {
 		/* Honor client configure requests for floating views */
-		struct wlr_box box = {.x = event->x, .y = event->y,
-			.width = event->width, .height = event->height};
+		struct wlr_box box = xwayland_view->requested_geometry;
 		view_adjust_size(view, &box.width, &box.height);
 		xwayland_view_configure(view, box);
 	} else {
@@ -393,6 +490,51 @@ handle_request_configure(struct wl_listener *listener, void *data)
 	}
 }
 
+static void
+handle_configure_request_idle(void *data)
+{
+	struct xwayland_view *xwayland_view = data;
+	xwayland_view->configure_request_idle = NULL;
+	apply_configure_request(xwayland_view);
+}
+
+/* Applies a configure request still waiting for the idle callback */
+static void
+flush_configure_request(struct xwayland_view *xwayland_view)
+{
+	if (xwayland_view->configure_request_idle) {
+		wl_event_source_remove(xwayland_view->configure_request_idle);
+		xwayland_view->configure_request_idle = NULL;
+		apply_configure_request(xwayland_view);
+	}
+}
+
+static void
+handle_request_configure(struct wl_listener *listener, void *data)
+{
+	struct xwayland_view *xwayland_view =
+		wl_container_of(listener, xwayland_view, request_configure);
+	struct view *view = &xwayland_view->base;
+	struct wlr_xwayland_surface_configure_event *event = data;
+
+	/*
+	 * Some clients send dozens of requests per second while animating
+	 * or resizing. Only keep the latest one and apply it once the
+	 * events read so far have been processed.
+	 */
+	xwayland_view->requested_geometry = (struct wlr_box){
+		.x = event->x,
+		.y = event->y,
+		.width = event->width,
+		.height = event->height,
+	};
+	if (!xwayland_view->configure_request_idle) {
+		xwayland_view->configure_request_idle = wl_event_loop_add_idle(
+			view->server->wl_event_loop,
+			handle_configure_request_idle, xwayland_view);
+	}
+}
+
 static void
 handle_request_activate(struct wl_listener *listener, void *data)
 {
@@ -400,7 +542,8 @@ handle_request_activate(struct wl_listener *listener, void *data)
 		wl_container_of(listener, xwayland_view, request_activate);
 	struct view *view = &xwayland_view->base;
 
-	if (window_rules_get_property(view, "ignoreFocusRequest") == LAB_PROP_TRUE) {
+	if (window_rules_get_property(view,
+			LAB_WINDOW_RULE_PROP_IGNORE_FOCUS_REQUEST) == LAB_PROP_TRUE) {
 		wlr_log(WLR_INFO, "Ignoring focus request due to window rule configuration");
 		return;
 	}
@@ -510,7 +653,9 @@ handle_set_decorations(struct wl_listener *listener, void *data)
 static void
 handle_set_window_type(struct wl_listener *listener, void *data)
 {
-	/* Intentionally left blank */
+	struct xwayland_view *xwayland_view =
+		wl_container_of(listener, xwayland_view, set_window_type);
+	window_rules_invalidate(&xwayland_view->base);
 }
 
 static void
@@ -531,6 +676,14 @@ handle_set_override_redirect(struct wl_listener *listener, void *data)
 	xwayland_unmanaged_create(server, xsurface, mapped);
 }
 
+static void
+handle_set_parent(struct wl_listener *listener, void *data)
+{
+	struct xwayland_view *xwayland_view =
+		wl_container_of(listener, xwayland_view, set_parent);
+	view_update_family(&xwayland_view->base);
+}
+
 static void
 handle_set_strut_partial(struct wl_listener *listener, void *data)
 {
@@ -574,6 +727,9 @@ handle_map_request(struct wl_listener *listener, void *data)
 		return;
 	}
 
+	/* Initial geometry may have been requested just before mapping */
+	flush_configure_request(xwayland_view);
+
 	/* Keep the view invisible until actually mapped */
 	wlr_scene_node_set_enabled(&view->scene_tree->node, false);
 	ensure_initial_geometry_and_output(view);
@@ -622,7 +778,9 @@ set_initial_position(struct view *view,
 		view_constrain_size_to_that_of_usable_area(view);
 
 		if (view_is_floating(view)) {
-			view_place_initial(view, /* allow_cursor */ true);
+			if (!placement_memory_place(view)) {
+				view_place_initial(view, /* allow_cursor */ true);
+			}
 		} else {
 			/*
 			 * View is maximized/fullscreen. Center the
@@ -740,6 +898,7 @@ xwayland_view_map(struct view *view)
 	wl_signal_add(&xwayland_surface->surface->events.commit, &view->commit);
 	view->commit.notify = handle_commit;
 
+	xwayland_sync_init(xwayland_view);
 	view_impl_map(view);
 	view->been_mapped = true;
 
@@ -758,6 +917,7 @@ xwayland_view_unmap(struct view *view, bool client_request)
 	view->mapped = false;
 	wl_list_remove(&view->commit.link);
 	wlr_scene_node_set_enabled(&view->scene_tree->node, false);
+	xwayland_sync_finish(xwayland_view_from_view(view));
 	view_impl_unmap(view);
 
 	/* Update usable area to account for XWayland "struts" (panels) */
@@ -791,6 +951,25 @@ xwayland_view_minimize(struct view *view, bool minimized)
 		minimized);
 }
 
+/* Restack and keep server->xwayland_stack in sync */
+static void
+restack(struct xwayland_view *xwayland_view, struct xwayland_view *sibling,
+		enum xcb_stack_mode_t mode)
+{
+	struct wl_list *stack = &xwayland_view->base.server->xwayland_stack;
+	wlr_xwayland_surface_restack(xwayland_view->xwayland_surface,
+		sibling ? sibling->xwayland_surface : NULL, mode);
+
+	wl_list_remove(&xwayland_view->stack_link);
+	if (mode == XCB_STACK_MODE_ABOVE) {
+		struct wl_list *prev = sibling ? sibling->stack_link.prev : stack;
+		wl_list_insert(prev, &xwayland_view->stack_link);
+	} else {
+		struct wl_list *prev = sibling ? &sibling->stack_link : stack->prev;
+		wl_list_insert(prev, &xwayland_view->stack_link);
+	}
+}
+
 static void
 xwayland_view_move_to_front(struct view *view)
 {
@@ -812,8 +991,7 @@ xwayland_view_move_to_front(struct view *view)
 	 * the unmanaged surfaces afterward is ugly and still doesn't
 	 * account for always-on-top views.
 	 */
-	wlr_xwayland_surface_restack(xwayland_surface_from_view(view),
-		NULL, XCB_STACK_MODE_ABOVE);
+	restack(xwayland_view_from_view(view), NULL, XCB_STACK_MODE_ABOVE);
 
 	/* Restack unmanaged surfaces on top */
 	struct wl_list *list = &view->server->unmanaged_surfaces;
@@ -829,8 +1007,7 @@ xwayland_view_move_to_back(struct view *view)
 {
 	view_impl_move_to_back(view);
 	/* Update XWayland stacking order */
-	wlr_xwayland_surface_restack(xwayland_surface_from_view(view),
-		NULL, XCB_STACK_MODE_BELOW);
+	restack(xwayland_view_from_view(view), NULL, XCB_STACK_MODE_BELOW);
 }
 
 static struct view *
@@ -847,38 +1024,6 @@ xwayland_view_get_root(struct view *view)
 	return (root && root->data) ? (struct view *)root->data : view;
 }
 
-static void
-xwayland_view_append_children(struct view *self, struct wl_array *children)
-{
-	struct wlr_xwayland_surface *surface = xwayland_surface_from_view(self);
-	struct view *view;
-
-	wl_list_for_each_reverse(view, &self->server->views, link)
-	{
-		if (view == self) {
-			continue;
-		}
-		if (view->type != LAB_XWAYLAND_VIEW) {
-			continue;
-		}
-		/*
-		 * This happens when a view has never been mapped or when a
-		 * client has requested a `handle_unmap`.
-		 */
-		if (!view->surface) {
-			continue;
-		}
-		if (!view->mapped && !view->minimized) {
-			continue;
-		}
-		if (top_parent_of(view) != surface) {
-			continue;
-		}
-		struct view **child = wl_array_add(children, sizeof(*child));
-		*child = view;
-	}
-}
-
 static void
 xwayland_view_set_activated(struct view *view, bool activated)
 {
@@ -919,8 +1064,8 @@ xwayland_view_shade(struct view *view, bool shaded)
 
 	/* Ensure that clicks on some xwayland surface don't end up on the shaded one */
 	if (shaded) {
-		wlr_xwayland_surface_restack(xwayland_surface_from_view(view),
-			NULL, XCB_STACK_MODE_BELOW);
+		restack(xwayland_view_from_view(view), NULL,
+			XCB_STACK_MODE_BELOW);
 	} else {
 		xwayland_adjust_stacking_order(view->server);
 	}
@@ -940,7 +1085,6 @@ static const struct view_impl xwayland_view_impl = {
 	.move_to_back = xwayland_view_move_to_back,
 	.shade = xwayland_view_shade,
 	.get_root = xwayland_view_get_root,
-	.append_children = xwayland_view_append_children,
 	.get_size_hints = xwayland_view_get_size_hints,
 	.wants_focus = xwayland_view_wants_focus,
 	.offer_focus = xwayland_view_offer_focus,
@@ -969,9 +1113,12 @@ xwayland_view_create(struct server *server,
 	 */
 	xwayland_view->xwayland_surface = xsurface;
 	xsurface->data = view;
+	/* New X11 windows are created on top */
+	wl_list_insert(&server->xwayland_stack, &xwayland_view->stack_link);
 
 	view->workspace = server->workspace_current;
-	view->scene_tree = wlr_scene_tree_create(view->workspace->tree);
+	view->scene_tree = wlr_scene_tree_create(
+		workspaces_get_tree(view->workspace));
 	node_descriptor_create(&view->scene_tree->node, LAB_NODE_DESC_VIEW, view);
 
 	CONNECT_SIGNAL(xsurface, view, destroy);
@@ -990,12 +1137,13 @@ xwayland_view_create(struct server *server,
 	CONNECT_SIGNAL(xsurface, xwayland_view, set_class);
 	CONNECT_SIGNAL(xsurface, xwayland_view, set_decorations);
 	CONNECT_SIGNAL(xsurface, xwayland_view, set_override_redirect);
+	CONNECT_SIGNAL(xsurface, xwayland_view, set_parent);
 	CONNECT_SIGNAL(xsurface, xwayland_view, set_strut_partial);
 	CONNECT_SIGNAL(xsurface, xwayland_view, set_window_type);
 	CONNECT_SIGNAL(xsurface, xwayland_view, focus_in);
 	CONNECT_SIGNAL(xsurface, xwayland_view, map_request);
 
-	wl_list_insert(&view->server->views, &view->link);
+	view_stack_add(view);
 
 	if (xsurface->surface) {
 		handle_associate(&xwayland_view->associate, NULL);
@@ -1031,6 +1179,55 @@ handle_xwm_ready(struct wl_listener *listener, void *data)
 		wl_container_of(listener, server, xwayland_xwm_ready);
 	wlr_xwayland_set_seat(server->xwayland, server->seat.seat);
 	xwayland_update_workarea(server);
+	xwayland_sync_connect(server);
+
+	if (server->xwayland_start_nsec) {
+		wlr_log(WLR_INFO, "xwayland ready %.1f ms after it was started",
+			(time_now_nsec() - server->xwayland_start_nsec) / 1e6);
+		server->xwayland_start_nsec = 0;
+	}
+}
+
+static void
+handle_xwayland_server_start(struct wl_listener *listener, void *data)
+{
+	struct server *server =
+		wl_container_of(listener, server, xwayland_server_start);
+	server->xwayland_start_nsec = time_now_nsec();
+	wlr_log(WLR_INFO, "starting xwayland on first X11 connection");
+}
+
+/*
+ * Xwayland is started by wlroots once its X11 socket becomes readable.
+ * To start it before any X11 client needs it, connect to the socket and
+ * close the connection again straight away.
+ */
+static int
+handle_xwayland_prewarm(void *data)
+{
+	struct server *server = data;
+	wl_event_source_remove(server->xwayland_prewarm_timer);
+	server->xwayland_prewarm_timer = NULL;
+
+	struct wlr_xwayland_server *xserver = server->xwayland->server;
+	if (xserver->pid > 0 || xserver->ready) {
+		return 0;
+	}
+
+	wlr_log(WLR_INFO, "pre-warming xwayland");
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		wlr_log_errno(WLR_ERROR, "unable to pre-warm xwayland");
+		return 0;
+	}
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "/tmp/.X11-unix/X%d",
+		xserver->display);
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		wlr_log_errno(WLR_ERROR, "unable to pre-warm xwayland");
+	}
+	close(fd);
+	return 0;
 }
 
 void
@@ -1042,6 +1239,7 @@ xwayland_server_init(struct server *server, struct wlr_compositor *compositor)
 		wlr_log(WLR_ERROR, "cannot create xwayland server");
 		exit(EXIT_FAILURE);
 	}
+	wl_list_init(&server->xwayland_stack);
 	server->xwayland_new_surface.notify = handle_new_surface;
 	wl_signal_add(&server->xwayland->events.new_surface,
 		&server->xwayland_new_surface);
@@ -1050,6 +1248,20 @@ xwayland_server_init(struct server *server, struct wlr_compositor *compositor)
 	wl_signal_add(&server->xwayland->events.ready,
 		&server->xwayland_xwm_ready);
 
+	/*
+	 * Xwayland is only started when the first X11 client connects,
+	 * unless pre-warming is enabled with <core><xwaylandPrewarm>.
+	 */
+	server->xwayland_server_start.notify = handle_xwayland_server_start;
+	wl_signal_add(&server->xwayland->server->events.start,
+		&server->xwayland_server_start);
+	if (rc.xwayland_prewarm) {
+		server->xwayland_prewarm_timer = wl_event_loop_add_timer(
+			server->wl_event_loop, handle_xwayland_prewarm, server);
+		wl_event_source_timer_update(server->xwayland_prewarm_timer,
+			rc.xwayland_prewarm * 1000);
+	}
+
 	if (setenv("DISPLAY", server->xwayland->display_name, true) < 0) {
 		wlr_log_errno(WLR_ERROR, "unable to set DISPLAY for xwayland");
 	} else {
@@ -1087,32 +1299,134 @@ xwayland_server_init(struct server *server, struct wlr_compositor *compositor)
  * - start scrolling
  * - all scroll events should end up on the maximized window on the other workspace
  */
-void
-xwayland_adjust_stacking_order(struct server *server)
+static void
+append_visible(struct server *server, struct wl_array *views,
+		enum lab_view_criteria criteria)
 {
-	struct view **view;
-	struct wl_array views;
+	struct view *view;
+	for_each_view(view, &server->views, criteria) {
+		/* Shaded views are kept below, see xwayland_view_shade() */
+		if (view->type != LAB_XWAYLAND_VIEW || view->shaded) {
+			continue;
+		}
+		struct xwayland_view **entry = wl_array_add(views, sizeof(*entry));
+		if (!entry) {
+			wlr_log(WLR_ERROR, "wl_array_add(): out of memory");
+			continue;
+		}
+		*entry = xwayland_view_from_view(view);
+		(*entry)->stack_visible = true;
+	}
+}
 
+/*
+ * The X11 stacking order only needs changing where it differs from what
+ * we want: visible views on top in their stacking order, everything else
+ * below in any order. Rather than raising every view, either restack the
+ * visible views which are out of place or, if the visible views are in
+ * order already, lower the hidden views which are between them.
+ */
+static void
+adjust_stacking_order(void *data)
+{
+	struct server *server = data;
+	struct wl_array views;
 	wl_array_init(&views);
-	view_array_append(server, &views, LAB_VIEW_CRITERIA_ALWAYS_ON_TOP);
-	view_array_append(server, &views, LAB_VIEW_CRITERIA_CURRENT_WORKSPACE
+	append_visible(server, &views, LAB_VIEW_CRITERIA_ALWAYS_ON_TOP);
+	append_visible(server, &views, LAB_VIEW_CRITERIA_CURRENT_WORKSPACE
 		| LAB_VIEW_CRITERIA_NO_ALWAYS_ON_TOP);
 
+	struct xwayland_view **wanted = views.data;
+	size_t nr_wanted = views.size / sizeof(*wanted);
+	if (!nr_wanted) {
+		goto out;
+	}
+
+	/* Number of visible views already in place at the top */
+	size_t nr_in_place = 0;
+	struct xwayland_view *xwayland_view;
+	wl_list_for_each(xwayland_view, &server->xwayland_stack, stack_link) {
+		if (nr_in_place == nr_wanted
+				|| xwayland_view != wanted[nr_in_place]) {
+			break;
+		}
+		nr_in_place++;
+	}
+	if (nr_in_place == nr_wanted) {
+		goto out;
+	}
+
 	/*
-	 * view_array_append() provides top-most windows
-	 * first so we simply reverse the iteration here
+	 * Count the hidden views above the lowest visible view, or give up
+	 * on lowering them if the visible views are not in order.
 	 */
-	wl_array_for_each_reverse(view, &views) {
-		view_move_to_front(*view);
+	size_t nr_hidden = 0;
+	size_t next = 0;
+	wl_list_for_each(xwayland_view, &server->xwayland_stack, stack_link) {
+		if (next == nr_wanted) {
+			break;
+		}
+		if (xwayland_view == wanted[next]) {
+			next++;
+		} else if (xwayland_view->stack_visible) {
+			nr_hidden = SIZE_MAX;
+			break;
+		} else {
+			nr_hidden++;
+		}
 	}
 
+	struct xwayland_view *lowest = wanted[nr_wanted - 1];
+	if (nr_hidden < nr_wanted - nr_in_place) {
+		/* Bottom-up so that the hidden views keep their order */
+		struct wl_list *link = lowest->stack_link.prev;
+		while (link != &server->xwayland_stack) {
+			xwayland_view = wl_container_of(link, xwayland_view,
+				stack_link);
+			link = link->prev;
+			if (!xwayland_view->stack_visible) {
+				restack(xwayland_view, lowest, XCB_STACK_MODE_BELOW);
+			}
+		}
+	} else {
+		/* Keep unmanaged surfaces on top by not restacking to the top */
+		struct xwayland_view *top = wl_container_of(
+			server->xwayland_stack.next, top, stack_link);
+		for (size_t i = nr_in_place; i < nr_wanted; i++) {
+			if (i == 0) {
+				restack(wanted[i], top, XCB_STACK_MODE_ABOVE);
+			} else {
+				restack(wanted[i], wanted[i - 1],
+					XCB_STACK_MODE_BELOW);
+			}
+		}
+	}
+
+out:
+	for (size_t i = 0; i < nr_wanted; i++) {
+		wanted[i]->stack_visible = false;
+	}
 	wl_array_release(&views);
 }
 
+void
+xwayland_adjust_stacking_order(struct server *server)
+{
+	defer_schedule(&server->xwayland_stacking_update,
+		server->wl_event_loop, adjust_stacking_order, server);
+}
+
 void
 xwayland_server_finish(struct server *server)
 {
 	struct wlr_xwayland *xwayland = server->xwayland;
+	defer_cancel(&server->xwayland_stacking_update);
+	if (server->xwayland_prewarm_timer) {
+		wl_event_source_remove(server->xwayland_prewarm_timer);
+		server->xwayland_prewarm_timer = NULL;
+	}
+	wl_list_remove(&server->xwayland_server_start.link);
+	xwayland_sync_disconnect();
 	/*
 	 * Reset server->xwayland to NULL first to prevent callbacks (like
 	 * server_global_filter) from accessing it as it is destroyed